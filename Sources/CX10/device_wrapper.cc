@@ -120,6 +120,12 @@ struct DeviceList* getReplicationDevices() {
   return DeviceListFromStrings(xla::ComputationClient::GetReplicationDevices());
 }
 
+void precompileForReplicationDevices(struct DeviceList* device_list,
+                                     struct DeviceList* new_device_list) {
+  swift_xla::XLATensor::PrecompileForReplicaSet(
+      DeviceListToStrings(device_list), DeviceListToStrings(new_device_list));
+}
+
 void syncLiveTensorsForDevices(struct DeviceList* device_list) {
   const auto device_strings = DeviceListToStrings(device_list);
   xla::util::MultiWait mwait(device_strings.size());
@@ -148,3 +154,17 @@ void XLATensor_LazyTensorBarrier(const struct CDevice* device,
                                              /*wait=*/wait);
   swift_xla::XLATensor::MarkStep(converted_device);
 }
+
+int64_t createTraceContext() {
+  return swift_xla::XLATensor::CreateTraceContext();
+}
+
+void setTraceContext(int64_t trace_context) {
+  swift_xla::XLATensor::SetTraceContext(trace_context);
+}
+
+int64_t getTraceContext() { return swift_xla::XLATensor::GetTraceContext(); }
+
+int64_t getStepCount(const struct CDevice device) {
+  return swift_xla::XLATensor::GetStepCount(ConvertDevice(device));
+}
@@ -19,6 +19,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #if !defined(XLA_API)
 #define XLA_API
@@ -59,6 +60,11 @@ XLA_API void setReplicationDevices(struct DeviceList* device_list);
 // Get current device replication for cross-device gradient reduction.
 XLA_API struct DeviceList* getReplicationDevices();
 
+// Compiles, in the background, the graphs replicated across device_list for
+// the replica set new_device_list, ahead of a resize of the replica set.
+XLA_API void precompileForReplicationDevices(
+    struct DeviceList* device_list, struct DeviceList* new_device_list);
+
 // Execute outstanding operations for all live tensors across the provided
 // devices, in parallel.
 XLA_API void syncLiveTensorsForDevices(struct DeviceList* device_list);
@@ -69,6 +75,20 @@ XLA_API void XLATensor_LazyTensorBarrier(const struct CDevice* device,
                                          struct DeviceList* device_list,
                                          bool wait);
 
+// Creates a trace context, with its own live tensors, random seeds and step
+// counters, whose syncs do not wait on the ones of other trace contexts.
+XLA_API int64_t createTraceContext();
+
+// Sets the trace context of the calling thread, 0 being the default one.
+XLA_API void setTraceContext(int64_t trace_context);
+
+// Gets the trace context of the calling thread.
+XLA_API int64_t getTraceContext();
+
+// Gets the number of steps marked on the device within the trace context of
+// the calling thread.
+XLA_API int64_t getStepCount(const struct CDevice device);
+
 #ifdef __cplusplus
 }  // extern "C"
 
@@ -21,6 +21,13 @@
 #include "xla_tensor_wrapper.h"
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/computation.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
@@ -116,8 +123,14 @@ struct ExtraInputDiscovery {
   std::vector<Value> results;
 };
 
+xla::hash_t HashOfResults(absl::Span<const Value> results) {
+  xla::hash_t hash = 0;
+  for (auto& result : results)
+    hash = xla::util::HashCombine(hash, result.hash());
+  return hash;
+}
+
 std::vector<Value> DiscoverExtraInputs(absl::Span<const Value> results,
-                                       const Value& index_placeholder,
                                        absl::Span<const Value> placeholders) {
   ExtraInputDiscovery state;
   for (auto& result : results) {
@@ -127,7 +140,6 @@ std::vector<Value> DiscoverExtraInputs(absl::Span<const Value> results,
   for (auto& placeholder : placeholders) {
     state.PlaceholderVisit(placeholder.node.get());
   }
-  state.PlaceholderVisit(index_placeholder.node.get());
   state.WorkListPlaceholderVisit();
   for (auto& result : results) {
     state.BackRefVisitExtraSearch(result, result.node);
@@ -136,6 +148,25 @@ std::vector<Value> DiscoverExtraInputs(absl::Span<const Value> results,
   return std::move(state.results);
 }
 
+// The lowered condition and body of a while loop. Both only depend on the
+// structure of the body graph, as the loop invariant inputs, device data
+// included, are passed within the loop state.
+struct LoweredWhileLoop {
+  xla::XlaComputation cond;
+  xla::XlaComputation body;
+};
+
+using LoweredWhileLoopCache =
+    xla::util::Cache<xla::hash_t, LoweredWhileLoop, xla::util::HashReducer>;
+
+LoweredWhileLoopCache* GetLoweredWhileLoopCache() {
+  static const size_t kMaxCacheSize =
+      xla::sys_util::GetEnvInt("XLA_WHILE_LOOP_CACHE_SIZE", 256);
+  static LoweredWhileLoopCache* cache =
+      new LoweredWhileLoopCache(kMaxCacheSize);
+  return cache;
+}
+
 class XLAFunctionalWhileNode : public swift_xla::ir::Node {
  public:
   static std::vector<Value> BuildArgs(absl::Span<const Value> initial,
@@ -146,20 +177,21 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
     out.insert(out.end(), extras.begin(), extras.end());
     return out;
   }
-  static xla::hash_t HashOfResults(absl::Span<const Value> results) {
-    xla::hash_t hash = 0;
-    for (auto& result : results)
-      hash = xla::util::HashCombine(hash, result.hash());
-    return hash;
+  static std::vector<Value> BuildPlaceholders(
+      const Value& index_placeholder, absl::Span<const Value> placeholders) {
+    std::vector<Value> out(placeholders.begin(), placeholders.end());
+    out.push_back(index_placeholder);
+    return out;
   }
   XLAFunctionalWhileNode(absl::Span<const Value> initial, const Value& n,
                          const Value& index_placeholder,
                          absl::Span<const Value> placeholders,
                          absl::Span<const Value> results)
       : Node(swift_xla::ir::OpKind(at::aten::functional_while),
-             BuildArgs(
-                 initial, n,
-                 DiscoverExtraInputs(results, index_placeholder, placeholders)),
+             BuildArgs(initial, n,
+                       DiscoverExtraInputs(
+                           results, BuildPlaceholders(index_placeholder,
+                                                      placeholders))),
              ShapeOfXlaOpList(results), results.size(), HashOfResults(results)),
         index_placeholder_(index_placeholder),
         placeholders_(placeholders.begin(), placeholders.end()),
@@ -182,7 +214,6 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
   XlaOpVector Lower(LoweringContext* loctx) const {
     size_t last_i = placeholders_.size();
 
-    auto body_builder = loctx->builder()->CreateSubBuilder("loop_body");
     xla::XlaOp initial;
     {
       std::vector<xla::XlaOp> args;
@@ -200,6 +231,33 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
 
       initial = xla::Tuple(loctx->builder(), args);
     }
+    // Loops are usually rebuilt at every step, within graphs which otherwise
+    // differ, so reuse the lowered body of a structurally identical loop.
+    xla::Shape state_shape = swift_xla::XlaHelpers::ShapeOfXlaOp(initial);
+    xla::hash_t hash = xla::util::MHash(
+        HashOfResults(results_), xla::util::ShapeHash(state_shape),
+        xla::util::GetEnumValue(loctx->device().hw_type));
+    LoweredWhileLoopCache* cache = GetLoweredWhileLoopCache();
+    std::shared_ptr<LoweredWhileLoop> loop = cache->Get(hash);
+    if (loop == nullptr) {
+      XLA_COUNTER("WhileLoopLowerings", 1);
+      loop = cache->Add(hash, std::make_shared<LoweredWhileLoop>(
+                                  LowerLoop(loctx, state_shape)));
+    }
+    auto result = xla::While(loop->cond, loop->body, initial);
+
+    std::vector<xla::XlaOp> results;
+    for (size_t i = 0; i < last_i; ++i) {
+      results.push_back(xla::GetTupleElement(result, i));
+    }
+    return ReturnOps(results, loctx);
+  }
+
+  LoweredWhileLoop LowerLoop(LoweringContext* loctx,
+                             const xla::Shape& state_shape) const {
+    size_t last_i = placeholders_.size();
+
+    auto body_builder = loctx->builder()->CreateSubBuilder("loop_body");
     xla::XlaOp body_result;
     {
       auto* b = body_builder.get();
@@ -213,8 +271,7 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
       emap[index_placeholder_.node.get()] = swift_xla::ir::Util::kEmitted;
       swift_xla::ir::LoweringContext body_loctx(b, loctx->device(),
                                                 std::move(emap));
-      auto t = xla::Parameter(
-          b, 0, swift_xla::XlaHelpers::ShapeOfXlaOp(initial), "tuple");
+      auto t = xla::Parameter(b, 0, state_shape, "tuple");
       auto p1 = xla::GetTupleElement(t, last_i);
       auto p2 = xla::GetTupleElement(t, last_i + 1);
       for (size_t i = 0; i < placeholders_.size(); ++i) {
@@ -241,25 +298,113 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
     xla::XlaOp cond_result;
     {
       auto* b = cond_builder.get();
-      auto t = xla::Parameter(
-          b, 0, swift_xla::XlaHelpers::ShapeOfXlaOp(initial), "tuple");
+      auto t = xla::Parameter(b, 0, state_shape, "tuple");
       auto p1 = xla::GetTupleElement(t, last_i);
       auto p2 = xla::GetTupleElement(t, last_i + 1);
       cond_result = xla::Lt(p1, p2);
     }
 
-    auto result = xla::While(
-        cond_builder->Build(cond_result).ConsumeValueOrDie(),
-        body_builder->Build(body_result).ConsumeValueOrDie(), initial);
+    return {cond_builder->Build(cond_result).ConsumeValueOrDie(),
+            body_builder->Build(body_result).ConsumeValueOrDie()};
+  }
+
+  Value index_placeholder_;
+  std::vector<Value> placeholders_;
+  std::vector<Value> results_;
+};
+
+using LoweredCallCache = xla::util::Cache<xla::hash_t, swift_xla::Computation,
+                                          xla::util::HashReducer>;
+
+LoweredCallCache* GetLoweredCallCache() {
+  static const size_t kMaxCacheSize =
+      xla::sys_util::GetEnvInt("XLA_OUTLINED_CALL_CACHE_SIZE", 256);
+  static LoweredCallCache* cache = new LoweredCallCache(kMaxCacheSize);
+  return cache;
+}
+
+// Calls the computation of the body graph computing results from
+// placeholders, instead of inlining it, so that structurally identical bodies,
+// like the layers of a deep model, are lowered once and appear once in the
+// HLO of the step, see LoweringContext::CallComputation(). The values of the
+// body which do not depend on the placeholders, like the layer weights, are
+// computed outside of it and passed as extra arguments.
+class XLAOutlinedCallNode : public swift_xla::ir::Node {
+ public:
+  static std::vector<Value> BuildArgs(absl::Span<const Value> inputs,
+                                      absl::Span<const Value> extras) {
+    std::vector<Value> out(inputs.begin(), inputs.end());
+    out.insert(out.end(), extras.begin(), extras.end());
+    return out;
+  }
+  XLAOutlinedCallNode(absl::Span<const Value> inputs,
+                      absl::Span<const Value> placeholders,
+                      absl::Span<const Value> results)
+      : Node(swift_xla::ir::OpKind(at::aten::outlined_call),
+             BuildArgs(inputs, DiscoverExtraInputs(results, placeholders)),
+             ShapeOfXlaOpList(results), results.size(), HashOfResults(results)),
+        placeholders_(placeholders.begin(), placeholders.end()),
+        results_(results.begin(), results.end()) {
+    XLA_CHECK_EQ(inputs.size(), placeholders.size());
+  }
 
+  XlaOpVector Lower(LoweringContext* loctx) const override {
+    std::vector<xla::XlaOp> args;
+    std::vector<xla::Shape> arg_shapes;
+    xla::hash_t hash = xla::util::MHash(
+        HashOfResults(results_),
+        xla::util::GetEnumValue(loctx->device().hw_type));
+    for (const auto& operand : operands()) {
+      args.push_back(loctx->GetOutputOp(operand));
+      arg_shapes.push_back(swift_xla::XlaHelpers::ShapeOfXlaOp(args.back()));
+      hash = xla::util::HashCombine(hash,
+                                    xla::util::ShapeHash(arg_shapes.back()));
+    }
+    LoweredCallCache* cache = GetLoweredCallCache();
+    swift_xla::ComputationPtr body = cache->Get(hash);
+    if (body == nullptr) {
+      XLA_COUNTER("OutlinedCallLowerings", 1);
+      body = cache->Add(
+          hash, std::make_shared<swift_xla::Computation>(
+                    "outlined_body", LowerBody(loctx, arg_shapes)));
+    }
+    xla::XlaOp result = loctx->CallComputation(*body, args);
     std::vector<xla::XlaOp> results;
-    for (size_t i = 0; i < last_i; ++i) {
+    for (size_t i = 0; i < results_.size(); ++i) {
       results.push_back(xla::GetTupleElement(result, i));
     }
     return ReturnOps(results, loctx);
   }
 
-  Value index_placeholder_;
+  xla::XlaComputation LowerBody(LoweringContext* loctx,
+                                absl::Span<const xla::Shape> arg_shapes) const {
+    auto body_builder = loctx->builder()->CreateSubBuilder("outlined_body");
+    auto* b = body_builder.get();
+    swift_xla::ir::Util::EmissionMap emap;
+    for (const auto& placeholder : placeholders_) {
+      emap[placeholder.node.get()] = swift_xla::ir::Util::kEmitted;
+    }
+    for (size_t i = placeholders_.size(); i < operands().size(); ++i) {
+      emap[operand(i).node] = swift_xla::ir::Util::kEmitted;
+    }
+    swift_xla::ir::LoweringContext body_loctx(b, loctx->device(),
+                                              std::move(emap));
+    for (size_t i = 0; i < operands().size(); ++i) {
+      xla::XlaOp param =
+          xla::Parameter(b, i, arg_shapes[i], absl::StrCat("p", i));
+      if (i < placeholders_.size()) {
+        body_loctx.AssignOutputOp(placeholders_[i], param);
+      } else {
+        body_loctx.AssignOutputOp(operand(i), param);
+      }
+    }
+    std::vector<xla::XlaOp> outputs;
+    for (auto& result : results_) {
+      outputs.push_back(body_loctx.GetOutputOp(result));
+    }
+    return b->Build(xla::Tuple(b, outputs)).ConsumeValueOrDie();
+  }
+
   std::vector<Value> placeholders_;
   std::vector<Value> results_;
 };
@@ -313,6 +458,21 @@ OpaqueXLATensorArrayRef XLATensor_functional_while(
   return {opaque_tensors, count};
 }
 
+OpaqueXLATensorArrayRef XLATensor_outlined_call(
+    OpaqueXLATensorArrayRef inputs, OpaqueXLATensorArrayRef placeholders,
+    OpaqueXLATensorArrayRef results) {
+  auto result_node = swift_xla::ir::MakeNode<XLAOutlinedCallNode>(
+      UnpackIrValues(inputs), UnpackIrValues(placeholders),
+      UnpackIrValues(results));
+  size_t count = results.size;
+  auto opaque_tensors = new OpaqueXLATensor*[count];
+  for (size_t i = 0; i < count; ++i) {
+    opaque_tensors[i] = new XLATensor(
+        results.data[i]->CreateFrom(swift_xla::ir::Value(result_node, i)));
+  }
+  return {opaque_tensors, count};
+}
+
 OpaqueXLATensor* XLATensor_makePlaceholder(OpaqueXLATensor* t, int id) {
   return new XLATensor(t->CreateFrom(
       swift_xla::ir::MakeNode<XLAPlaceholderNode>(t->shape(), id)));
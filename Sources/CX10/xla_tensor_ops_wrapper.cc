@@ -19,6 +19,7 @@
 #endif
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
@@ -29,7 +30,10 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/matrix.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/nll_loss.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_create_conv_attrs.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/pooling.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/random.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/segment_reduction_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/softmax_builder.h"
@@ -42,7 +46,9 @@
 #include "tensorflow/compiler/xla/client/lib/prng.h"
 #include "tensorflow/compiler/xla/client/lib/qr.h"
 #include "tensorflow/compiler/xla/client/lib/svd.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/shape_inference.h"
 #include "xla_tensor_wrapper.h"
 
 namespace at {
@@ -321,12 +327,13 @@ xla::XlaOp BuildOneHot(xla::XlaOp indices, xla::XlaOp on_value,
 }
 
 xla::XlaOp LowerTfUnsortedSegmentSum(xla::XlaOp data, xla::XlaOp indices,
-                                     xla::int64 num_segments) {
+                                     xla::int64 num_segments,
+                                     bool indices_are_sorted) {
   const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
   xla::XlaOp init_value = xla::Zero(data.builder(), data_shape.element_type());
   auto combine = [](xla::XlaOp a, xla::XlaOp b) { return a + b; };
-  return UnsortedSegmentReduce(data, indices, init_value, num_segments,
-                               combine);
+  return SegmentReduce(data, indices, init_value, num_segments, combine,
+                       indices_are_sorted);
 }
 
 xla::BitGeneratorTy GetBestGenerator(LoweringContext* loctx = nullptr) {
@@ -342,20 +349,25 @@ xla::BitGeneratorTy GetBestGenerator(LoweringContext* loctx = nullptr) {
   return generator;
 }
 
+// Packs the two 32 bit seeds of the stateless random ops into the key of the
+// bit generator.
+xla::XlaOp MakeStatelessKey(xla::XlaOp seeds) {
+  xla::XlaOp seed0 = xla::Reshape(xla::Slice(seeds, {0}, {1}, {1}), {});
+  xla::XlaOp seed1 = xla::Reshape(xla::Slice(seeds, {1}, {2}, {1}), {});
+  return ConvertElementType(seed0, xla::U64) |
+         ShiftLeft(ConvertElementType(seed1, xla::U64),
+                   ConstantR0WithType(seeds.builder(), xla::U64, 32));
+}
+
 xla::XlaOp LowerTfStatelessRandomNormal(xla::Shape shape, xla::XlaOp seeds,
                                         at::ScalarType dtype,
                                         LoweringContext* loctx = nullptr) {
   auto generator = GetBestGenerator(loctx);
-  xla::XlaOp seed0 = xla::Reshape(xla::Slice(seeds, {0}, {1}, {1}), {});
-  xla::XlaOp seed1 = xla::Reshape(xla::Slice(seeds, {1}, {2}, {1}), {});
   xla::XlaOp initial_state =
       xla::ConstantR0WithType(seeds.builder(), xla::U64, 0);
-  xla::XlaOp key = ConvertElementType(seed0, xla::U64) |
-                   ShiftLeft(ConvertElementType(seed1, xla::U64),
-                             ConstantR0WithType(seeds.builder(), xla::U64, 32));
-  xla::XlaOp normal =
-      xla::NormalFloatingPointDistribution(key, initial_state, generator, shape)
-          .value;
+  xla::XlaOp normal = NormalDistribution(MakeStatelessKey(seeds),
+                                         initial_state, generator, shape)
+                          .value;
   return normal;
 }
 
@@ -363,11 +375,7 @@ xla::XlaOp LowerTfStatelessRandomUniform(xla::Shape shape, xla::XlaOp seeds,
                                          xla::XlaOp minval, xla::XlaOp maxval,
                                          LoweringContext* loctx = nullptr) {
   auto generator = GetBestGenerator(loctx);
-  xla::XlaOp seed0 = xla::Reshape(xla::Slice(seeds, {0}, {1}, {1}), {});
-  xla::XlaOp seed1 = xla::Reshape(xla::Slice(seeds, {1}, {2}, {1}), {});
-  xla::XlaOp key = ConvertElementType(seed0, xla::U64) |
-                   ShiftLeft(ConvertElementType(seed1, xla::U64),
-                             ConstantR0WithType(seeds.builder(), xla::U64, 32));
+  xla::XlaOp key = MakeStatelessKey(seeds);
   xla::XlaOp initial_state =
       xla::ConstantR0WithType(seeds.builder(), xla::U64, 0);
   xla::PrimitiveType type = shape.element_type();
@@ -393,6 +401,15 @@ xla::XlaOp LowerTfStatelessRandomUniform(xla::Shape shape, xla::XlaOp seeds,
   }
 }
 
+// Zeroes out the elements of the input with the given probability, and scales
+// the others so that the expected values are unchanged. The mask only depends
+// on the seeds and the shape, so the backward pass draws the same one again
+// instead of keeping it live.
+xla::XlaOp LowerFusedDropout(xla::XlaOp input, xla::XlaOp seeds,
+                             float probability) {
+  return BuildDropout(input, 1.0f - probability, MakeStatelessKey(seeds));
+}
+
 xla::XlaOp LowerNllLoss(xla::XlaOp logits, xla::XlaOp labels,
                         xla::int64 ignore_index) {
   return BuildNllLoss(logits, labels, absl::nullopt, ignore_index,
@@ -507,6 +524,17 @@ std::vector<xla::XlaOp> LowerSVD(xla::XlaOp input, bool compute_uv,
   return {svd_result.d, u, v};
 }
 
+std::vector<xla::XlaOp> LowerMoments(xla::XlaOp input,
+                                     absl::Span<const xla::int64> dimensions,
+                                     bool keep_reduced_dimensions) {
+  MomentsResult moments = BuildMoments(input, dimensions,
+                                       keep_reduced_dimensions,
+                                       /*unbiased=*/false);
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  return {xla::ConvertElementType(moments.mean, type),
+          xla::ConvertElementType(moments.variance, type)};
+}
+
 xla::Shape ShapeOfXlaOpList(absl::Span<const xla::XlaOp> ops) {
   xla::Shape result;
   result.set_element_type(xla::TUPLE);
@@ -518,6 +546,163 @@ xla::Shape ShapeOfXlaOpList(absl::Span<const xla::XlaOp> ops) {
   return result;
 }
 
+// The Shape*() functions below compute the output shapes of the hot ops in
+// closed form, instead of lowering them on a throwaway builder. They are only
+// used when AllStaticShapes() holds for the operands, since the builder is
+// still needed to propagate dynamic dimensions.
+bool AllStaticShapes() { return true; }
+
+template <typename... Args>
+bool AllStaticShapes(absl::Span<const Value> values, const Args&... args);
+
+template <typename... Args>
+bool AllStaticShapes(const Value& value, const Args&... args) {
+  return value.shape().is_static() && AllStaticShapes(args...);
+}
+
+template <typename... Args>
+bool AllStaticShapes(absl::Span<const Value> values, const Args&... args) {
+  for (const Value& value : values) {
+    if (!value.shape().is_static()) {
+      return false;
+    }
+  }
+  return AllStaticShapes(args...);
+}
+
+xla::Shape ShapeBinaryOp(const Value& lhs, const Value& rhs) {
+  return XlaHelpers::GetPromotedBinaryOpShape(lhs.shape(), rhs.shape());
+}
+
+xla::Shape ShapeComparisonOp(const Value& lhs, const Value& rhs) {
+  xla::Shape result = XlaHelpers::GetPromotedShape(lhs.shape(), rhs.shape());
+  result.set_element_type(xla::PrimitiveType::PRED);
+  return result;
+}
+
+xla::Shape ShapeReduce(const Value& input,
+                       absl::Span<const xla::int64> dimensions,
+                       bool keep_reduced_dimensions) {
+  const xla::Shape& input_shape = input.shape();
+  std::vector<xla::int64> new_dimensions;
+  for (xla::int64 i = 0; i < input_shape.rank(); ++i) {
+    if (std::find(dimensions.begin(), dimensions.end(), i) ==
+        dimensions.end()) {
+      new_dimensions.push_back(input_shape.dimensions(i));
+    } else if (keep_reduced_dimensions) {
+      new_dimensions.push_back(1);
+    }
+  }
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(),
+                                   new_dimensions);
+}
+
+xla::Shape ShapeReduceInDim(const Value& input, xla::int64 dim,
+                            bool keep_reduced_dimensions) {
+  return ShapeReduce(input, {dim}, keep_reduced_dimensions);
+}
+
+xla::Shape ShapeArgReduce(const Value& input, xla::int64 dim, bool keepdim) {
+  xla::PrimitiveType type =
+      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr);
+  if (dim < 0) {
+    // The input gets flattened before the reduction.
+    return keepdim ? xla::ShapeUtil::MakeShape(type, {1})
+                   : xla::ShapeUtil::MakeShape(type, {});
+  }
+  xla::Shape result = ShapeReduceInDim(input, dim, keepdim);
+  result.set_element_type(type);
+  return result;
+}
+
+xla::Shape ShapeMatMul(const Value& lhs, const Value& rhs) {
+  const xla::Shape& lhs_shape = lhs.shape();
+  const xla::Shape& rhs_shape = rhs.shape();
+  xla::PrimitiveType type = XlaHelpers::PromoteType(lhs_shape.element_type(),
+                                                    rhs_shape.element_type());
+  if (lhs_shape.rank() == 1 && rhs_shape.rank() == 1) {
+    return xla::ShapeUtil::MakeShape(type, {});
+  }
+  if (lhs_shape.rank() == 2 && rhs_shape.rank() == 1) {
+    return xla::ShapeUtil::MakeShape(type, {lhs_shape.dimensions(0)});
+  }
+  if (lhs_shape.rank() == 1 && rhs_shape.rank() == 2) {
+    return xla::ShapeUtil::MakeShape(type, {rhs_shape.dimensions(1)});
+  }
+  if (lhs_shape.rank() < 2 || rhs_shape.rank() < 2) {
+    // Vector against batched matrices, let the builder sort out the expansion.
+    xla::XlaBuilder b("InferOutputShape");
+    xla::XlaOp result = LowerBinaryValueOp<CreateMatMul>(
+        xla::Parameter(&b, 0, lhs_shape, "p0"),
+        xla::Parameter(&b, 1, rhs_shape, "p1"));
+    return XlaHelpers::ShapeOfXlaOp(result);
+  }
+  std::vector<xla::int64> dimensions = XlaHelpers::GetPromotedShape(
+      lhs_shape.dimensions().subspan(0, lhs_shape.rank() - 2),
+      rhs_shape.dimensions().subspan(0, rhs_shape.rank() - 2));
+  dimensions.push_back(lhs_shape.dimensions(lhs_shape.rank() - 2));
+  dimensions.push_back(rhs_shape.dimensions(rhs_shape.rank() - 1));
+  return xla::ShapeUtil::MakeShape(type, dimensions);
+}
+
+xla::Shape ShapeMm(const Value& lhs, const Value& rhs) {
+  const xla::Shape& lhs_shape = lhs.shape();
+  const xla::Shape& rhs_shape = rhs.shape();
+  XLA_CHECK_EQ(lhs_shape.rank(), 2) << lhs_shape;
+  XLA_CHECK_EQ(rhs_shape.rank(), 2) << rhs_shape;
+  return xla::ShapeUtil::MakeShape(
+      lhs_shape.element_type(),
+      {lhs_shape.dimensions(0), rhs_shape.dimensions(1)});
+}
+
+xla::Shape ShapeQuantizedMatMul(const Value& input, const Value& weight,
+                                const Value& scale) {
+  xla::Shape result = ShapeMatMul(input, weight);
+  result.set_element_type(input.shape().element_type());
+  return result;
+}
+
+xla::Shape ShapePermute(const Value& input, absl::Span<const xla::int64> dims) {
+  return ConsumeValue(
+      xla::ShapeInference::InferTransposeShape(input.shape(), dims));
+}
+
+xla::Shape ShapeSqueeze(const Value& input, xla::int64 dim) {
+  const xla::Shape& input_shape = input.shape();
+  if (dim != -1) {
+    XLA_CHECK_GE(dim, 0);
+    if (input_shape.dimensions(dim) != 1) {
+      return input_shape;
+    }
+  }
+  return xla::ShapeUtil::MakeShape(
+      input_shape.element_type(),
+      BuildSqueezedDimensions(input_shape.dimensions(), dim));
+}
+
+xla::Shape ShapeCat(absl::Span<const Value> inputs, xla::int64 dim) {
+  XLA_CHECK_GT(inputs.size(), 0);
+  xla::Shape result = inputs[0].shape();
+  for (size_t i = 1; i < inputs.size(); ++i) {
+    result.set_dimensions(
+        dim, result.dimensions(dim) + inputs[i].shape().dimensions(dim));
+  }
+  return result;
+}
+
+xla::Shape ShapeStack(absl::Span<const Value> inputs, xla::int64 dim) {
+  XLA_CHECK_GT(inputs.size(), 0);
+  const xla::Shape& input_shape = inputs[0].shape();
+  auto dimensions = xla::util::ToVector<xla::int64>(input_shape.dimensions());
+  dimensions.insert(dimensions.begin() + dim, inputs.size());
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(), dimensions);
+}
+
+xla::Shape ShapeExpand(const Value& input, absl::Span<const xla::int64> dims) {
+  XLA_CHECK_LE(input.shape().rank(), dims.size()) << input.shape();
+  return xla::ShapeUtil::MakeShape(input.shape().element_type(), dims);
+}
+
 xla::XlaOp BuildTfConv(xla::XlaOp input, xla::XlaOp filter, bool depthwise,
                        absl::Span<const xla::int64> strides,
                        tensorflow::Padding padding,
@@ -581,6 +766,189 @@ xla::XlaOp BuildTfConvBackpropInput(
       /*attrs=*/attrs, /*precision_config=*/&precision_config));
 }
 
+// Convolution followed by the bias and activation epilogue. Keeping the three
+// in a single IR node lets the backend fuse the epilogue into the convolution
+// output instead of materializing the pre-activation tensor.
+xla::XlaOp BuildTfConvBiasActivation(
+    xla::XlaOp input, xla::XlaOp filter, xla::XlaOp bias, bool depthwise,
+    absl::Span<const xla::int64> strides, tensorflow::Padding padding,
+    absl::Span<const xla::int64> explicit_paddings,
+    tensorflow::TensorFormat data_format,
+    absl::Span<const xla::int64> dilations, bool relu) {
+  xla::XlaOp conv =
+      BuildTfConv(input, filter, depthwise, strides, padding,
+                  explicit_paddings, data_format, dilations);
+  xla::Shape conv_shape = XlaHelpers::ShapeOfXlaOp(conv);
+  xla::int64 feature_dim =
+      tensorflow::GetTensorFeatureDimIndex(conv_shape.rank(), data_format);
+  xla::Shape bias_shape = XlaHelpers::ShapeOfXlaOp(bias);
+  XLA_CHECK_EQ(bias_shape.rank(), 1) << bias_shape;
+  XLA_CHECK_EQ(bias_shape.dimensions(0), conv_shape.dimensions(feature_dim))
+      << bias_shape << " vs. " << conv_shape;
+  xla::XlaOp result =
+      xla::Add(conv, xla::BroadcastInDim(bias, conv_shape.dimensions(),
+                                         {feature_dim}));
+  if (relu) {
+    result = xla::Max(
+        result, xla::Zero(conv.builder(), conv_shape.element_type()));
+  }
+  return result;
+}
+
+// Multiplies the output channels, along dim, by their dequantization scales.
+xla::XlaOp ScaleOutputChannels(xla::XlaOp output, xla::XlaOp scale,
+                               xla::int64 dim) {
+  xla::Shape output_shape = XlaHelpers::ShapeOfXlaOp(output);
+  xla::Shape scale_shape = XlaHelpers::ShapeOfXlaOp(scale);
+  XLA_CHECK_EQ(scale_shape.rank(), 1) << scale_shape;
+  XLA_CHECK_EQ(scale_shape.dimensions(0), output_shape.dimensions(dim))
+      << scale_shape << " vs. " << output_shape;
+  return xla::Mul(
+      output, xla::BroadcastInDim(
+                  xla::ConvertElementType(scale, output_shape.element_type()),
+                  output_shape.dimensions(), {dim}));
+}
+
+// Matmul with int8 weights quantized per output channel, the last dimension
+// of weight. The weights are converted to the input type inside the same
+// computation, which the backend fuses into the dot operand, so only the
+// int8 values are read from memory. Since the scales are constant along the
+// contracted dimension they are applied to the output, which has one row of
+// them instead of a whole weight matrix.
+xla::XlaOp BuildQuantizedMatMul(xla::XlaOp input, xla::XlaOp weight,
+                                xla::XlaOp scale) {
+  xla::Shape weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  XLA_CHECK_EQ(weight_shape.element_type(), xla::PrimitiveType::S8)
+      << weight_shape;
+  XLA_CHECK_GE(weight_shape.rank(), 2) << weight_shape;
+  xla::XlaOp product = CreateMatMul(
+      input, xla::ConvertElementType(weight, XlaHelpers::TypeOfXlaOp(input)));
+  xla::Shape product_shape = XlaHelpers::ShapeOfXlaOp(product);
+  return ScaleOutputChannels(product, scale, product_shape.rank() - 1);
+}
+
+// Same as BuildTfConv, with an int8 filter quantized per output channel.
+// Depthwise filters are quantized along their last two dimensions flattened,
+// which is the feature dimension of the output.
+xla::XlaOp BuildTfQuantizedConv(xla::XlaOp input, xla::XlaOp filter,
+                                xla::XlaOp scale, bool depthwise,
+                                absl::Span<const xla::int64> strides,
+                                tensorflow::Padding padding,
+                                absl::Span<const xla::int64> explicit_paddings,
+                                tensorflow::TensorFormat data_format,
+                                absl::Span<const xla::int64> dilations) {
+  xla::Shape filter_shape = XlaHelpers::ShapeOfXlaOp(filter);
+  XLA_CHECK_EQ(filter_shape.element_type(), xla::PrimitiveType::S8)
+      << filter_shape;
+  xla::XlaOp conv = BuildTfConv(
+      input, xla::ConvertElementType(filter, XlaHelpers::TypeOfXlaOp(input)),
+      depthwise, strides, padding, explicit_paddings, data_format, dilations);
+  xla::Shape conv_shape = XlaHelpers::ShapeOfXlaOp(conv);
+  return ScaleOutputChannels(
+      conv, scale,
+      tensorflow::GetTensorFeatureDimIndex(conv_shape.rank(), data_format));
+}
+
+xla::Shape ShapeTfConv(const Value& input, const Value& filter, bool depthwise,
+                       absl::Span<const xla::int64> strides,
+                       tensorflow::Padding padding,
+                       absl::Span<const xla::int64> explicit_paddings,
+                       tensorflow::TensorFormat data_format,
+                       absl::Span<const xla::int64> dilations) {
+  const xla::Shape& input_shape = input.shape();
+  const xla::Shape& filter_shape = filter.shape();
+  int num_dims = input_shape.rank();
+  int num_spatial_dims = num_dims - 2;
+  XLA_CHECK_EQ(filter_shape.rank(), num_dims) << filter_shape;
+  XLA_CHECK_EQ(strides.size(), num_dims);
+  XLA_CHECK_EQ(dilations.size(), num_dims);
+  std::vector<xla::int64> dimensions(num_dims);
+  dimensions[tensorflow::GetTensorBatchDimIndex(num_dims, data_format)] =
+      input_shape.dimensions(
+          tensorflow::GetTensorBatchDimIndex(num_dims, data_format));
+  // The filter is laid out as spatial dimensions, input depth, output depth.
+  xla::int64 output_depth = filter_shape.dimensions(num_spatial_dims + 1);
+  if (depthwise) {
+    output_depth *= filter_shape.dimensions(num_spatial_dims);
+  }
+  dimensions[tensorflow::GetTensorFeatureDimIndex(num_dims, data_format)] =
+      output_depth;
+  for (int i = 0; i < num_spatial_dims; ++i) {
+    int dim = tensorflow::GetTensorSpatialDimIndex(num_dims, data_format, i);
+    xla::int64 input_size = input_shape.dimensions(dim);
+    xla::int64 stride = strides[dim];
+    xla::int64 effective_filter_size =
+        (filter_shape.dimensions(i) - 1) * dilations[dim] + 1;
+    xla::int64 output_size = 0;
+    switch (padding) {
+      case tensorflow::VALID: {
+        output_size = (input_size - effective_filter_size + stride) / stride;
+        break;
+      }
+      case tensorflow::SAME: {
+        output_size = (input_size + stride - 1) / stride;
+        break;
+      }
+      case tensorflow::EXPLICIT: {
+        XLA_CHECK_EQ(explicit_paddings.size(), 2 * num_dims);
+        output_size = (input_size + explicit_paddings[2 * dim] +
+                       explicit_paddings[2 * dim + 1] - effective_filter_size +
+                       stride) /
+                      stride;
+        break;
+      }
+      default: {
+        XLA_ERROR() << "Invalid padding: " << padding;
+      }
+    }
+    dimensions[dim] = output_size;
+  }
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(), dimensions);
+}
+
+xla::Shape ShapeTfConvBiasActivation(
+    const Value& input, const Value& filter, const Value& bias, bool depthwise,
+    absl::Span<const xla::int64> strides, tensorflow::Padding padding,
+    absl::Span<const xla::int64> explicit_paddings,
+    tensorflow::TensorFormat data_format,
+    absl::Span<const xla::int64> dilations, bool relu) {
+  return ShapeTfConv(input, filter, depthwise, strides, padding,
+                     explicit_paddings, data_format, dilations);
+}
+
+xla::Shape ShapeTfQuantizedConv(
+    const Value& input, const Value& filter, const Value& scale,
+    bool depthwise, absl::Span<const xla::int64> strides,
+    tensorflow::Padding padding,
+    absl::Span<const xla::int64> explicit_paddings,
+    tensorflow::TensorFormat data_format,
+    absl::Span<const xla::int64> dilations) {
+  return ShapeTfConv(input, filter, depthwise, strides, padding,
+                     explicit_paddings, data_format, dilations);
+}
+
+xla::Shape ShapeTfConvBackpropFilter(
+    const Value& input, absl::Span<const xla::int64> filter_sizes,
+    const Value& out_backprop, bool depthwise,
+    absl::Span<const xla::int64> strides, tensorflow::Padding padding,
+    absl::Span<const xla::int64> explicit_paddings,
+    tensorflow::TensorFormat data_format,
+    absl::Span<const xla::int64> dilations) {
+  return xla::ShapeUtil::MakeShape(input.shape().element_type(),
+                                   filter_sizes);
+}
+
+xla::Shape ShapeTfConvBackpropInput(
+    absl::Span<const xla::int64> input_sizes, const Value& filter,
+    const Value& out_backprop, bool depthwise,
+    absl::Span<const xla::int64> strides, tensorflow::Padding padding,
+    absl::Span<const xla::int64> explicit_paddings,
+    tensorflow::TensorFormat data_format,
+    absl::Span<const xla::int64> dilations) {
+  return xla::ShapeUtil::MakeShape(filter.shape().element_type(),
+                                   input_sizes);
+}
+
 }  // namespace
 }  // namespace ops
 }  // namespace ir
@@ -634,4 +1002,702 @@ xla::PaddingConfig ToXLAPaddingConfig(PaddingConfig padding_config) {
 
 }  // namespace
 
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+// The views are composed at IR construction time, so that chains of them get
+// traced into a single transpose, reshape or slice, and no-op views vanish.
+Value ComposePermuteValue(const Value& input, std::vector<xla::int64> dims);
+Value ComposeResizeValue(const Value& input, std::vector<xla::int64> dims);
+Value ComposeSlice(const Value& input, xla::int64 dim, xla::int64 start,
+                   xla::int64 end, xla::int64 stride);
+
+// Likewise, the casts and broadcasts stacked by generic code are simplified
+// when they get traced: exact intermediate casts are skipped, no-op casts and
+// expands vanish, successive expands merge, and the sums and means over
+// broadcast dimensions become a scaling of the value before the broadcast.
+Value ComposeLogicalCast(const Value& input, at::ScalarType dest_type);
+Value ComposePhysicalCast(const Value& input, at::ScalarType dest_type);
+Value ComposeExpand(const Value& input, std::vector<xla::int64> dims);
+Value ComposeSum(const Value& input, std::vector<xla::int64> dims,
+                 bool keep_dims);
+Value ComposeMean(const Value& input, std::vector<xla::int64> dims,
+                  bool keep_dims);
+
+// The constant paddings of paddings merge, and the convolutions fold the zero
+// padding of their input into their window padding, so that the padded copy
+// of the activations is not materialized. The convolutions also run in the
+// preferred data format, see x10::PreferredDataFormat().
+Value ComposeConstantPadNd(const Value& input, std::vector<xla::int64> pad,
+                           at::Scalar value);
+Value ComposeXlaPad(const Value& input, at::Scalar padding_value,
+                    xla::PaddingConfig padding_config);
+Value ComposeTfConv(const Value& input, const Value& filter, bool depthwise,
+                    std::vector<xla::int64> strides,
+                    tensorflow::Padding padding,
+                    std::vector<xla::int64> explicit_paddings,
+                    tensorflow::TensorFormat data_format,
+                    std::vector<xla::int64> dilations);
+Value ComposeTfConvBiasActivation(const Value& input, const Value& filter,
+                                  const Value& bias, bool depthwise,
+                                  std::vector<xla::int64> strides,
+                                  tensorflow::Padding padding,
+                                  std::vector<xla::int64> explicit_paddings,
+                                  tensorflow::TensorFormat data_format,
+                                  std::vector<xla::int64> dilations,
+                                  bool relu);
+Value ComposeTfQuantizedConv(const Value& input, const Value& filter,
+                             const Value& scale, bool depthwise,
+                             std::vector<xla::int64> strides,
+                             tensorflow::Padding padding,
+                             std::vector<xla::int64> explicit_paddings,
+                             tensorflow::TensorFormat data_format,
+                             std::vector<xla::int64> dilations);
+Value ComposeTfConvBackpropFilter(const Value& input,
+                                  std::vector<xla::int64> filter_sizes,
+                                  const Value& out_backprop, bool depthwise,
+                                  std::vector<xla::int64> strides,
+                                  tensorflow::Padding padding,
+                                  std::vector<xla::int64> explicit_paddings,
+                                  tensorflow::TensorFormat data_format,
+                                  std::vector<xla::int64> dilations);
+Value ComposeTfConvBackpropInput(std::vector<xla::int64> input_sizes,
+                                 const Value& filter,
+                                 const Value& out_backprop, bool depthwise,
+                                 std::vector<xla::int64> strides,
+                                 tensorflow::Padding padding,
+                                 std::vector<xla::int64> explicit_paddings,
+                                 tensorflow::TensorFormat data_format,
+                                 std::vector<xla::int64> dilations);
+
+}  // namespace
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
+
 #include "xla_tensor_ops_wrapper_generated.cc.inc"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+Value FirstOperand(const Node* node) {
+  return Value(node->operand_nodes().at(0), node->operand(0).index);
+}
+
+bool IsIdentityPermutation(absl::Span<const xla::int64> dims) {
+  for (size_t i = 0; i < dims.size(); ++i) {
+    if (dims[i] != static_cast<xla::int64>(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns whether the permutation only moves around unit dimensions, in which
+// case the transpose does not change the order of the elements and is just a
+// reshape.
+bool IsBitcastPermutation(const xla::Shape& shape,
+                          absl::Span<const xla::int64> dims) {
+  xla::int64 last_dim = -1;
+  for (xla::int64 dim : dims) {
+    if (shape.dimensions(dim) != 1) {
+      if (dim < last_dim) {
+        return false;
+      }
+      last_dim = dim;
+    }
+  }
+  return true;
+}
+
+Value ComposePermuteValue(const Value& input, std::vector<xla::int64> dims) {
+  const xla::Shape& input_shape = input.shape();
+  if (input_shape.is_static() && dims.size() == input_shape.rank()) {
+    if (IsIdentityPermutation(dims)) {
+      return input;
+    }
+    const PermuteValue* permute =
+        NodeCast<PermuteValue>(input.node.get(), ir::OpKind(at::aten::permute));
+    if (permute != nullptr) {
+      std::vector<xla::int64> composed_dims;
+      composed_dims.reserve(dims.size());
+      for (xla::int64 dim : dims) {
+        composed_dims.push_back(permute->dims().at(dim));
+      }
+      return ComposePermuteValue(FirstOperand(permute),
+                                 std::move(composed_dims));
+    }
+    if (IsBitcastPermutation(input_shape, dims)) {
+      std::vector<xla::int64> sizes;
+      sizes.reserve(dims.size());
+      for (xla::int64 dim : dims) {
+        sizes.push_back(input_shape.dimensions(dim));
+      }
+      return ComposeResizeValue(input, std::move(sizes));
+    }
+  }
+  return Value(MakeNode<PermuteValue>(input, std::move(dims)), 0);
+}
+
+Value ComposeResizeValue(const Value& input, std::vector<xla::int64> dims) {
+  const xla::Shape& input_shape = input.shape();
+  // Only the resizes which preserve the number of elements are reshapes.
+  if (input_shape.is_static() && xla::ShapeUtil::ElementsIn(input_shape) ==
+                                     xla::util::Multiply<xla::int64>(dims)) {
+    if (input_shape.dimensions() == absl::Span<const xla::int64>(dims)) {
+      return input;
+    }
+    const ResizeValue* resize =
+        NodeCast<ResizeValue>(input.node.get(), ir::OpKind(at::aten::resize));
+    if (resize != nullptr) {
+      Value operand = FirstOperand(resize);
+      if (xla::ShapeUtil::ElementsIn(operand.shape()) ==
+          xla::ShapeUtil::ElementsIn(input_shape)) {
+        return ComposeResizeValue(operand, std::move(dims));
+      }
+    }
+    const PermuteValue* permute =
+        NodeCast<PermuteValue>(input.node.get(), ir::OpKind(at::aten::permute));
+    if (permute != nullptr) {
+      Value operand = FirstOperand(permute);
+      if (IsBitcastPermutation(operand.shape(), permute->dims())) {
+        return ComposeResizeValue(operand, std::move(dims));
+      }
+    }
+  }
+  return Value(MakeNode<ResizeValue>(input, std::move(dims)), 0);
+}
+
+Value ComposeSlice(const Value& input, xla::int64 dim, xla::int64 start,
+                   xla::int64 end, xla::int64 stride) {
+  const xla::Shape& input_shape = input.shape();
+  if (input_shape.is_static() && stride > 0 && start >= 0 && start < end &&
+      end <= input_shape.dimensions(dim)) {
+    if (start == 0 && stride == 1 && end == input_shape.dimensions(dim)) {
+      return input;
+    }
+    const Slice* slice =
+        NodeCast<Slice>(input.node.get(), ir::OpKind(at::aten::slice));
+    if (slice != nullptr && slice->dim() == dim && slice->stride() > 0) {
+      // Element i of this slice is element start + i * stride of the inner
+      // one, which is element slice->start() + (start + i * stride) *
+      // slice->stride() of its input.
+      xla::int64 size = (end - start + stride - 1) / stride;
+      xla::int64 composed_start = slice->start() + start * slice->stride();
+      xla::int64 composed_stride = stride * slice->stride();
+      xla::int64 composed_end =
+          composed_start + (size - 1) * composed_stride + 1;
+      return ComposeSlice(FirstOperand(slice), dim, composed_start,
+                          composed_end, composed_stride);
+    }
+  }
+  return Value(MakeNode<Slice>(input, dim, start, end, stride), 0);
+}
+
+// Returns whether every value of the from type is exactly representable in the
+// to type.
+bool IsExactConversion(xla::PrimitiveType from, xla::PrimitiveType to) {
+  if (from == to || from == xla::PrimitiveType::PRED) {
+    return true;
+  }
+  int from_bits = xla::primitive_util::BitWidth(from);
+  int to_bits = xla::primitive_util::BitWidth(to);
+  if (xla::primitive_util::IsIntegralType(from) &&
+      xla::primitive_util::IsIntegralType(to)) {
+    bool from_signed = xla::primitive_util::IsSignedIntegralType(from);
+    bool to_signed = xla::primitive_util::IsSignedIntegralType(to);
+    if (from_signed == to_signed) {
+      return to_bits >= from_bits;
+    }
+    return !from_signed && to_bits > from_bits;
+  }
+  if (xla::primitive_util::IsFloatingPointType(from) &&
+      xla::primitive_util::IsFloatingPointType(to)) {
+    // BF16 has a wider exponent range than F16.
+    return to_bits > from_bits && to != xla::PrimitiveType::F16;
+  }
+  if (xla::primitive_util::IsIntegralType(from)) {
+    switch (to) {
+      case xla::PrimitiveType::BF16:
+      case xla::PrimitiveType::F16:
+        return from_bits <= 8;
+      case xla::PrimitiveType::F32:
+        return from_bits <= 16;
+      case xla::PrimitiveType::F64:
+        return from_bits <= 32;
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
+bool IsIntegralOrPred(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::PRED ||
+         xla::primitive_util::IsIntegralType(type);
+}
+
+// Returns the destination type of a cast node, or nothing if the node is not a
+// cast.
+absl::optional<at::ScalarType> CastDestType(const Node* node) {
+  if (node->op() != ir::OpKind(xla_symbols::cast)) {
+    return absl::nullopt;
+  }
+  if (auto cast = dynamic_cast<const LogicalCast*>(node)) {
+    return cast->destType();
+  }
+  if (auto cast = dynamic_cast<const PhysicalCast*>(node)) {
+    return cast->destType();
+  }
+  return absl::nullopt;
+}
+
+// Returns whether the cast to dest_type lowers to nothing.
+bool IsNoOpCast(xla::PrimitiveType from, at::ScalarType dest_type) {
+  xla::PrimitiveType to = MakeXlaPrimitiveType(dest_type, /*device=*/nullptr);
+  xla::PrimitiveType raw_to = TensorTypeToRawXlaType(dest_type);
+  return from == to &&
+         (to == raw_to || !xla::primitive_util::IsIntegralType(to));
+}
+
+// Returns the value to cast to dest_type instead of input. When input is a
+// cast which does not change the values, the outer cast converts the same
+// values, so it can be applied to the input of the inner one, unless that
+// turns an integer conversion of floats into one of integers, which differ on
+// overflow.
+Value SkipExactCast(const Value& input, at::ScalarType dest_type) {
+  absl::optional<at::ScalarType> inner_type = CastDestType(input.node.get());
+  if (!inner_type) {
+    return input;
+  }
+  Value inner_input = FirstOperand(input.node.get());
+  xla::PrimitiveType from = inner_input.shape().element_type();
+  xla::PrimitiveType through = input.shape().element_type();
+  xla::PrimitiveType to = MakeXlaPrimitiveType(dest_type, /*device=*/nullptr);
+  if (!IsExactConversion(from, through) ||
+      !IsExactConversion(from, TensorTypeToRawXlaType(*inner_type)) ||
+      (IsIntegralOrPred(from) &&
+       xla::primitive_util::IsFloatingPointType(through) &&
+       IsIntegralOrPred(to))) {
+    return input;
+  }
+  return inner_input;
+}
+
+Value ComposeLogicalCast(const Value& input, at::ScalarType dest_type) {
+  Value cast_input = SkipExactCast(input, dest_type);
+  if (IsNoOpCast(cast_input.shape().element_type(), dest_type)) {
+    return cast_input;
+  }
+  return Value(MakeNode<LogicalCast>(cast_input, dest_type), 0);
+}
+
+Value ComposePhysicalCast(const Value& input, at::ScalarType dest_type) {
+  Value cast_input = SkipExactCast(input, dest_type);
+  if (IsNoOpCast(cast_input.shape().element_type(), dest_type)) {
+    return cast_input;
+  }
+  return Value(MakeNode<PhysicalCast>(cast_input, dest_type), 0);
+}
+
+Value ComposeExpand(const Value& input, std::vector<xla::int64> dims) {
+  const xla::Shape& input_shape = input.shape();
+  if (input_shape.is_static()) {
+    if (input_shape.dimensions() == absl::Span<const xla::int64>(dims)) {
+      return input;
+    }
+    // The expands of ir::ops and of the generated ops share the kind, and are
+    // both defined by their input and output shapes.
+    if (input.node->op() == ir::OpKind(at::aten::expand)) {
+      Value operand = FirstOperand(input.node.get());
+      if (operand.shape().is_static()) {
+        return ComposeExpand(operand, std::move(dims));
+      }
+    }
+  }
+  return Value(MakeNode<Expand>(input, std::move(dims)), 0);
+}
+
+// If all the dimensions reduced over have been broadcast by an expand, returns
+// the value before the expand, expanded to the reduced shape, and sets count to
+// the number of elements each result element is reduced from.
+absl::optional<Value> ReduceBroadcast(const Value& input,
+                                      absl::Span<const xla::int64> dims,
+                                      bool keep_dims, xla::int64* count) {
+  const xla::Shape& input_shape = input.shape();
+  if (dims.empty() || !input_shape.is_static() ||
+      input.node->op() != ir::OpKind(at::aten::expand)) {
+    return absl::nullopt;
+  }
+  Value operand = FirstOperand(input.node.get());
+  const xla::Shape& operand_shape = operand.shape();
+  if (!operand_shape.is_static()) {
+    return absl::nullopt;
+  }
+  xla::int64 rank = input_shape.rank();
+  xla::int64 offset = rank - operand_shape.rank();
+  std::vector<bool> reduced(rank, false);
+  for (xla::int64 dim : dims) {
+    reduced[dim] = true;
+  }
+  std::vector<xla::int64> operand_sizes;
+  std::vector<xla::int64> result_sizes;
+  *count = 1;
+  for (xla::int64 dim = 0; dim < rank; ++dim) {
+    xla::int64 operand_size =
+        dim < offset ? 1 : operand_shape.dimensions(dim - offset);
+    if (reduced[dim]) {
+      if (operand_size != 1) {
+        return absl::nullopt;
+      }
+      *count *= input_shape.dimensions(dim);
+      if (!keep_dims) {
+        continue;
+      }
+    }
+    operand_sizes.push_back(operand_size);
+    result_sizes.push_back(reduced[dim] ? 1 : input_shape.dimensions(dim));
+  }
+  return ComposeExpand(ComposeResizeValue(operand, std::move(operand_sizes)),
+                       std::move(result_sizes));
+}
+
+Value ComposeSum(const Value& input, std::vector<xla::int64> dims,
+                 bool keep_dims) {
+  xla::PrimitiveType type = input.shape().element_type();
+  xla::int64 count = 1;
+  absl::optional<Value> reduced =
+      type != xla::PrimitiveType::PRED &&
+              (xla::primitive_util::IsFloatingPointType(type) ||
+               xla::primitive_util::IsIntegralType(type))
+          ? ReduceBroadcast(input, dims, keep_dims, &count)
+          : absl::nullopt;
+  if (reduced) {
+    if (count == 1) {
+      return *reduced;
+    }
+    NodePtr scale = MakeNode<Scalar>(static_cast<int64_t>(count), type);
+    return Value(MakeNode<Mul>(*reduced, Value(scale, 0)), 0);
+  }
+  return Value(MakeNode<Sum>(input, std::move(dims), keep_dims), 0);
+}
+
+Value ComposeMean(const Value& input, std::vector<xla::int64> dims,
+                  bool keep_dims) {
+  xla::int64 count = 1;
+  absl::optional<Value> reduced =
+      xla::primitive_util::IsFloatingPointType(input.shape().element_type())
+          ? ReduceBroadcast(input, dims, keep_dims, &count)
+          : absl::nullopt;
+  if (reduced) {
+    return *reduced;
+  }
+  return Value(MakeNode<Mean>(input, std::move(dims), keep_dims), 0);
+}
+
+bool IsNoOpPadding(const xla::PaddingConfig& config) {
+  for (const auto& dimension : config.dimensions()) {
+    if (dimension.edge_padding_low() != 0 ||
+        dimension.edge_padding_high() != 0 ||
+        dimension.interior_padding() != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns whether the padding only grows the edges, which is what the window
+// padding of the convolutions and poolings can express.
+bool IsEdgeGrowthPadding(const xla::PaddingConfig& config) {
+  for (const auto& dimension : config.dimensions()) {
+    if (dimension.edge_padding_low() < 0 ||
+        dimension.edge_padding_high() < 0 ||
+        dimension.interior_padding() != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Folds a padding into the constant padding input is the result of, if they
+// pad with the same value. Returns nothing if the padding does not fold.
+absl::optional<Value> FoldPad(const Value& input, const at::Scalar& value,
+                              const xla::PaddingConfig& config) {
+  if (IsNoOpPadding(config)) {
+    return input;
+  }
+  absl::optional<x10::ConstantPad> inner = x10::MatchConstantPad(input);
+  if (!inner || inner->value.toDouble() != value.toDouble() ||
+      !IsEdgeGrowthPadding(inner->config) || !IsEdgeGrowthPadding(config)) {
+    return absl::nullopt;
+  }
+  xla::PaddingConfig merged = inner->config;
+  for (int i = 0; i < merged.dimensions_size(); ++i) {
+    auto* dimension = merged.mutable_dimensions(i);
+    dimension->set_edge_padding_low(dimension->edge_padding_low() +
+                                    config.dimensions(i).edge_padding_low());
+    dimension->set_edge_padding_high(dimension->edge_padding_high() +
+                                     config.dimensions(i).edge_padding_high());
+  }
+  return Value(MakeNode<XlaPad>(inner->input, value, std::move(merged)), 0);
+}
+
+Value ComposeConstantPadNd(const Value& input, std::vector<xla::int64> pad,
+                           at::Scalar value) {
+  absl::optional<Value> folded =
+      FoldPad(input, value, XlaHelpers::MakeXlaPaddingConfigFromNdPadding(pad));
+  if (folded) {
+    return *folded;
+  }
+  return Value(MakeNode<ConstantPadNd>(input, std::move(pad), value), 0);
+}
+
+Value ComposeXlaPad(const Value& input, at::Scalar padding_value,
+                    xla::PaddingConfig padding_config) {
+  absl::optional<Value> folded = FoldPad(input, padding_value, padding_config);
+  if (folded) {
+    return *folded;
+  }
+  return Value(
+      MakeNode<XlaPad>(input, padding_value, std::move(padding_config)), 0);
+}
+
+// If input is the zero padding of a value along its spatial dimensions, makes
+// the convolution read that value instead, with the padding added to its
+// window padding. The SAME window padding depends on the input size, so only
+// the VALID and EXPLICIT ones absorb the input padding.
+void FoldConvInputPad(Value* input, tensorflow::Padding* padding,
+                      std::vector<xla::int64>* explicit_paddings,
+                      tensorflow::TensorFormat data_format) {
+  if ((*padding != tensorflow::VALID && *padding != tensorflow::EXPLICIT) ||
+      (data_format != tensorflow::FORMAT_NHWC &&
+       data_format != tensorflow::FORMAT_NCHW)) {
+    return;
+  }
+  absl::optional<x10::ConstantPad> pad = x10::MatchConstantPad(*input);
+  if (!pad || pad->value.toDouble() != 0 ||
+      !IsEdgeGrowthPadding(pad->config)) {
+    return;
+  }
+  int num_dims = pad->config.dimensions_size();
+  std::vector<xla::int64> folded_paddings(2 * num_dims, 0);
+  if (*padding == tensorflow::EXPLICIT) {
+    if (explicit_paddings->size() != folded_paddings.size()) {
+      return;
+    }
+    folded_paddings = *explicit_paddings;
+  }
+  int batch_dim = tensorflow::GetTensorBatchDimIndex(num_dims, data_format);
+  int feature_dim = tensorflow::GetTensorFeatureDimIndex(num_dims, data_format);
+  for (int dim = 0; dim < num_dims; ++dim) {
+    const auto& dimension = pad->config.dimensions(dim);
+    if (dim == batch_dim || dim == feature_dim) {
+      if (dimension.edge_padding_low() != 0 ||
+          dimension.edge_padding_high() != 0) {
+        return;
+      }
+      continue;
+    }
+    folded_paddings[2 * dim] += dimension.edge_padding_low();
+    folded_paddings[2 * dim + 1] += dimension.edge_padding_high();
+  }
+  *input = pad->input;
+  *padding = tensorflow::EXPLICIT;
+  *explicit_paddings = std::move(folded_paddings);
+  XLA_COUNTER("FoldedConvPads", 1);
+}
+
+// If another data format than the one of a convolution is preferred, makes
+// it run in that format, by permuting its per dimension attributes into it.
+// Returns whether it did.
+bool UsePreferredConvFormat(int num_dims, tensorflow::TensorFormat* data_format,
+                            std::vector<xla::int64>* strides,
+                            std::vector<xla::int64>* explicit_paddings,
+                            std::vector<xla::int64>* dilations) {
+  absl::optional<tensorflow::TensorFormat> preferred =
+      x10::PreferredDataFormat();
+  if (!preferred || *preferred == *data_format ||
+      (*data_format != tensorflow::FORMAT_NHWC &&
+       *data_format != tensorflow::FORMAT_NCHW) ||
+      strides->size() != num_dims || dilations->size() != num_dims ||
+      (!explicit_paddings->empty() &&
+       explicit_paddings->size() != 2 * num_dims)) {
+    return false;
+  }
+  std::vector<xla::int64> dims =
+      x10::DataFormatPermutation(num_dims, *data_format, *preferred);
+  *strides = XlaHelpers::Permute(dims, *strides);
+  *dilations = XlaHelpers::Permute(dims, *dilations);
+  if (!explicit_paddings->empty()) {
+    std::vector<xla::int64> paddings;
+    paddings.reserve(explicit_paddings->size());
+    for (xla::int64 dim : dims) {
+      paddings.push_back((*explicit_paddings)[2 * dim]);
+      paddings.push_back((*explicit_paddings)[2 * dim + 1]);
+    }
+    *explicit_paddings = std::move(paddings);
+  }
+  *data_format = *preferred;
+  XLA_COUNTER("PreferredFormatOps", 1);
+  return true;
+}
+
+Value PermuteFormat(const Value& value, tensorflow::TensorFormat from,
+                    tensorflow::TensorFormat to) {
+  if (from == to) {
+    return value;
+  }
+  return ComposePermuteValue(
+      value, x10::DataFormatPermutation(value.shape().rank(), from, to));
+}
+
+Value ComposeTfConv(const Value& input, const Value& filter, bool depthwise,
+                    std::vector<xla::int64> strides,
+                    tensorflow::Padding padding,
+                    std::vector<xla::int64> explicit_paddings,
+                    tensorflow::TensorFormat data_format,
+                    std::vector<xla::int64> dilations) {
+  Value conv_input = input;
+  FoldConvInputPad(&conv_input, &padding, &explicit_paddings, data_format);
+  tensorflow::TensorFormat conv_format = data_format;
+  UsePreferredConvFormat(conv_input.shape().rank(), &conv_format, &strides,
+                         &explicit_paddings, &dilations);
+  Value result(MakeNode<TfConv>(PermuteFormat(conv_input, data_format,
+                                              conv_format),
+                                filter, depthwise, std::move(strides), padding,
+                                std::move(explicit_paddings), conv_format,
+                                std::move(dilations)),
+               0);
+  return PermuteFormat(result, conv_format, data_format);
+}
+
+Value ComposeTfConvBiasActivation(const Value& input, const Value& filter,
+                                  const Value& bias, bool depthwise,
+                                  std::vector<xla::int64> strides,
+                                  tensorflow::Padding padding,
+                                  std::vector<xla::int64> explicit_paddings,
+                                  tensorflow::TensorFormat data_format,
+                                  std::vector<xla::int64> dilations,
+                                  bool relu) {
+  Value conv_input = input;
+  FoldConvInputPad(&conv_input, &padding, &explicit_paddings, data_format);
+  tensorflow::TensorFormat conv_format = data_format;
+  UsePreferredConvFormat(conv_input.shape().rank(), &conv_format, &strides,
+                         &explicit_paddings, &dilations);
+  Value result(MakeNode<TfConvBiasActivation>(
+                   PermuteFormat(conv_input, data_format, conv_format), filter,
+                   bias, depthwise, std::move(strides), padding,
+                   std::move(explicit_paddings), conv_format,
+                   std::move(dilations), relu),
+               0);
+  return PermuteFormat(result, conv_format, data_format);
+}
+
+Value ComposeTfQuantizedConv(const Value& input, const Value& filter,
+                             const Value& scale, bool depthwise,
+                             std::vector<xla::int64> strides,
+                             tensorflow::Padding padding,
+                             std::vector<xla::int64> explicit_paddings,
+                             tensorflow::TensorFormat data_format,
+                             std::vector<xla::int64> dilations) {
+  Value conv_input = input;
+  FoldConvInputPad(&conv_input, &padding, &explicit_paddings, data_format);
+  tensorflow::TensorFormat conv_format = data_format;
+  UsePreferredConvFormat(conv_input.shape().rank(), &conv_format, &strides,
+                         &explicit_paddings, &dilations);
+  Value result(MakeNode<TfQuantizedConv>(
+                   PermuteFormat(conv_input, data_format, conv_format), filter,
+                   scale, depthwise, std::move(strides), padding,
+                   std::move(explicit_paddings), conv_format,
+                   std::move(dilations)),
+               0);
+  return PermuteFormat(result, conv_format, data_format);
+}
+
+Value ComposeTfConvBackpropFilter(const Value& input,
+                                  std::vector<xla::int64> filter_sizes,
+                                  const Value& out_backprop, bool depthwise,
+                                  std::vector<xla::int64> strides,
+                                  tensorflow::Padding padding,
+                                  std::vector<xla::int64> explicit_paddings,
+                                  tensorflow::TensorFormat data_format,
+                                  std::vector<xla::int64> dilations) {
+  // The filter layout does not depend on the data format.
+  tensorflow::TensorFormat conv_format = data_format;
+  UsePreferredConvFormat(input.shape().rank(), &conv_format, &strides,
+                         &explicit_paddings, &dilations);
+  return Value(MakeNode<TfConvBackpropFilter>(
+                   PermuteFormat(input, data_format, conv_format),
+                   std::move(filter_sizes),
+                   PermuteFormat(out_backprop, data_format, conv_format),
+                   depthwise, std::move(strides), padding,
+                   std::move(explicit_paddings), conv_format,
+                   std::move(dilations)),
+               0);
+}
+
+Value ComposeTfConvBackpropInput(std::vector<xla::int64> input_sizes,
+                                 const Value& filter,
+                                 const Value& out_backprop, bool depthwise,
+                                 std::vector<xla::int64> strides,
+                                 tensorflow::Padding padding,
+                                 std::vector<xla::int64> explicit_paddings,
+                                 tensorflow::TensorFormat data_format,
+                                 std::vector<xla::int64> dilations) {
+  tensorflow::TensorFormat conv_format = data_format;
+  if (input_sizes.size() == out_backprop.shape().rank() &&
+      UsePreferredConvFormat(input_sizes.size(), &conv_format, &strides,
+                             &explicit_paddings, &dilations)) {
+    input_sizes = XlaHelpers::Permute(
+        x10::DataFormatPermutation(input_sizes.size(), data_format,
+                                   conv_format),
+        input_sizes);
+  }
+  Value result(MakeNode<TfConvBackpropInput>(
+                   std::move(input_sizes), filter,
+                   PermuteFormat(out_backprop, data_format, conv_format),
+                   depthwise, std::move(strides), padding,
+                   std::move(explicit_paddings), conv_format,
+                   std::move(dilations)),
+               0);
+  return PermuteFormat(result, conv_format, data_format);
+}
+
+}  // namespace
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
+
+namespace x10 {
+
+absl::optional<ConstantPad> MatchConstantPad(
+    const swift_xla::ir::Value& value) {
+  namespace ops = swift_xla::ir::ops;
+  const swift_xla::ir::Node* node = value.node.get();
+  if (node->op() == swift_xla::ir::OpKind(at::aten::constant_pad_nd)) {
+    if (auto pad = dynamic_cast<const ops::ConstantPadNd*>(node)) {
+      return ConstantPad{
+          ops::FirstOperand(node),
+          swift_xla::XlaHelpers::MakeXlaPaddingConfigFromNdPadding(pad->pad()),
+          pad->value()};
+    }
+  } else if (node->op() == swift_xla::ir::OpKind(at::aten::xla_pad)) {
+    // The pads of ir::ops share the kind, but take the value as an operand.
+    if (auto pad = dynamic_cast<const ops::XlaPad*>(node)) {
+      return ConstantPad{ops::FirstOperand(node), pad->paddingConfig(),
+                         pad->paddingValue()};
+    }
+  }
+  return absl::nullopt;
+}
+
+swift_xla::ir::Value PermuteValue(const swift_xla::ir::Value& value,
+                                  std::vector<xla::int64> dims) {
+  return swift_xla::ir::ops::ComposePermuteValue(value, std::move(dims));
+}
+
+}  // namespace x10
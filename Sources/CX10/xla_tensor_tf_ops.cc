@@ -20,9 +20,13 @@
 
 #include "xla_tensor_tf_ops.h"
 
+#include <limits>
+
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/compiler/xla/client/lib/pooling.h"
+#include "tensorflow/compiler/xla/client/padding.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 
 using swift_xla::XlaHelpers;
 using swift_xla::XLATensor;
@@ -60,6 +64,75 @@ xla::Padding ToXLAPadding(TFPadding padding) {
   }
 }
 
+// If value is the padding of another tensor with padding_value, along its
+// spatial dimensions only, returns that tensor and stores the low and high
+// padding of every dimension into padding.
+absl::optional<XLATensor> MatchSpatialPad(
+    const XLATensor& value, const xla::TensorFormat& data_format,
+    double padding_value,
+    std::vector<std::pair<xla::int64, xla::int64>>* padding) {
+  swift_xla::ir::Value ir_value = value.CurrentIrValue();
+  if (!ir_value) {
+    return absl::nullopt;
+  }
+  absl::optional<x10::ConstantPad> pad = x10::MatchConstantPad(ir_value);
+  if (!pad || pad->value.toDouble() != padding_value) {
+    return absl::nullopt;
+  }
+  padding->clear();
+  for (int dim = 0; dim < pad->config.dimensions_size(); ++dim) {
+    const auto& dimension = pad->config.dimensions(dim);
+    if (dimension.edge_padding_low() < 0 ||
+        dimension.edge_padding_high() < 0 ||
+        dimension.interior_padding() != 0) {
+      return absl::nullopt;
+    }
+    padding->emplace_back(dimension.edge_padding_low(),
+                          dimension.edge_padding_high());
+  }
+  for (int dim : {data_format.batch_dimension(),
+                  data_format.feature_dimension()}) {
+    if ((*padding)[dim] != std::pair<xla::int64, xla::int64>(0, 0)) {
+      return absl::nullopt;
+    }
+  }
+  return value.CreateFrom(pad->input);
+}
+
+XLATensor PermuteFormat(const XLATensor& tensor, tensorflow::TensorFormat from,
+                        tensorflow::TensorFormat to) {
+  if (from == to) {
+    return tensor;
+  }
+  return tensor.CreateFrom(x10::PermuteValue(
+      tensor.GetIrValue(),
+      x10::DataFormatPermutation(tensor.shape().get().rank(), from, to)));
+}
+
+// If another data format than the one of a pooling is preferred, makes it run
+// in that format, by transposing its input and permuting its per dimension
+// attributes into it. Returns whether it did.
+bool UsePreferredPoolFormat(tensorflow::TensorFormat* data_format,
+                            XLATensor* input,
+                            std::vector<xla::int64>* kernel_size,
+                            std::vector<xla::int64>* stride) {
+  absl::optional<tensorflow::TensorFormat> preferred =
+      x10::PreferredDataFormat();
+  int num_dims = kernel_size->size();
+  if (!preferred || *preferred == *data_format ||
+      input->shape().get().rank() != num_dims || stride->size() != num_dims) {
+    return false;
+  }
+  std::vector<xla::int64> dims =
+      x10::DataFormatPermutation(num_dims, *data_format, *preferred);
+  *input = PermuteFormat(*input, *data_format, *preferred);
+  *kernel_size = XlaHelpers::Permute(dims, *kernel_size);
+  *stride = XlaHelpers::Permute(dims, *stride);
+  *data_format = *preferred;
+  XLA_COUNTER("PreferredFormatOps", 1);
+  return true;
+}
+
 at::ScalarType SumAccumulationType(at::ScalarType dtype) {
   // Upcast 16 bit sum reductions to 32 bit to reduce the precision loss from
   // repeated floating point additions.
@@ -77,8 +150,9 @@ OpaqueXLATensor* tf_AvgPool(OpaqueXLATensor* value, Int64ArrayRef ksize,
   const auto value_shape_ref = value->shape();
   int num_spatial_dims = (*value_shape_ref).rank() - 2;
   xla::Padding xla_padding = ToXLAPadding(padding);
+  tensorflow::TensorFormat tf_data_format = x10::ToTFFormat(data_format);
   xla::TensorFormat xla_data_format =
-      XlaTensorFormat(x10::ToTFFormat(data_format), num_spatial_dims);
+      XlaTensorFormat(tf_data_format, num_spatial_dims);
   auto kernel_size = XlaHelpers::I64List(ksize.slice());
   auto stride = XlaHelpers::I64List(strides.slice());
   auto spatial_padding = MakeSpatialPadding(
@@ -86,15 +160,37 @@ OpaqueXLATensor* tf_AvgPool(OpaqueXLATensor* value, Int64ArrayRef ksize,
       /*kernel_size=*/kernel_size,
       /*stride=*/stride, /*padding=*/xla_padding,
       /*data_format=*/xla_data_format);
+  XLATensor input = *value;
+  // The VALID pooling averages the zero padding of its input along the input
+  // values, like the window padding counted by the average.
+  std::vector<std::pair<xla::int64, xla::int64>> input_padding;
+  absl::optional<XLATensor> unpadded =
+      xla_padding == xla::Padding::kValid
+          ? MatchSpatialPad(input, xla_data_format, 0, &input_padding)
+          : absl::nullopt;
+  if (unpadded) {
+    input = *unpadded;
+    for (int i = 0; i < num_spatial_dims; ++i) {
+      spatial_padding[i] = input_padding[xla_data_format.spatial_dimension(i)];
+    }
+    XLA_COUNTER("FoldedPoolPads", 1);
+  }
+  // The spatial padding is ordered by spatial dimension, whatever the format.
+  tensorflow::TensorFormat pool_format = tf_data_format;
+  if (UsePreferredPoolFormat(&pool_format, &input, &kernel_size, &stride)) {
+    xla_data_format = XlaTensorFormat(pool_format, num_spatial_dims);
+  }
   at::ScalarType reduction_type = SumAccumulationType(value->dtype());
-  XLATensor upcast_input = XLATensor::to(*value, absl::nullopt, reduction_type);
+  XLATensor upcast_input = XLATensor::to(input, absl::nullopt, reduction_type);
   XLATensor avg_pool = XLATensor::xla_avg_pool(
       /*input=*/upcast_input,
       /*kernel_size=*/kernel_size,
       /*stride=*/stride,
       /*padding=*/spatial_padding, /*data_format=*/xla_data_format,
       /*counts_include_padding=*/xla_padding == xla::Padding::kValid);
-  return new XLATensor(XLATensor::to(avg_pool, absl::nullopt, value->dtype()));
+  return new XLATensor(PermuteFormat(
+      XLATensor::to(avg_pool, absl::nullopt, value->dtype()), pool_format,
+      tf_data_format));
 }
 
 OpaqueXLATensor* tf_AvgPoolGrad(Int64ArrayRef origInputShape,
@@ -103,25 +199,37 @@ OpaqueXLATensor* tf_AvgPoolGrad(Int64ArrayRef origInputShape,
                                 enum TFDataFormat data_format) {
   xla::Padding xla_padding = ToXLAPadding(padding);
   int num_spatial_dims = ksize.size - 2;
-  xla::TensorFormat xla_data_format =
-      XlaTensorFormat(x10::ToTFFormat(data_format), num_spatial_dims);
+  tensorflow::TensorFormat tf_data_format = x10::ToTFFormat(data_format);
   auto kernel_size = XlaHelpers::I64List(ksize.slice());
   auto stride = XlaHelpers::I64List(strides.slice());
+  auto gradients_size = XlaHelpers::I64List(origInputShape.slice());
+  XLATensor out_backprop = *grad;
+  tensorflow::TensorFormat pool_format = tf_data_format;
+  if (UsePreferredPoolFormat(&pool_format, &out_backprop, &kernel_size,
+                             &stride)) {
+    gradients_size = XlaHelpers::Permute(
+        x10::DataFormatPermutation(gradients_size.size(), tf_data_format,
+                                   pool_format),
+        gradients_size);
+  }
+  xla::TensorFormat xla_data_format =
+      XlaTensorFormat(pool_format, num_spatial_dims);
   auto padding_values = MakeSpatialPadding(
-      /*input_size=*/origInputShape.slice(), /*kernel_size=*/kernel_size,
+      /*input_size=*/gradients_size, /*kernel_size=*/kernel_size,
       /*stride=*/stride, /*padding=*/xla_padding,
       /*data_format=*/xla_data_format);
   at::ScalarType reduction_type = SumAccumulationType(grad->dtype());
   XLATensor converted_out_backprop =
-      XLATensor::to(*grad, absl::nullopt, reduction_type);
+      XLATensor::to(out_backprop, absl::nullopt, reduction_type);
   XLATensor in_backprop = XLATensor::xla_avg_pool_grad(
       /*out_backprop=*/converted_out_backprop,
-      /*gradients_size=*/origInputShape.slice(),
+      /*gradients_size=*/gradients_size,
       /*kernel_size=*/kernel_size, /*stride=*/stride,
       /*spatial_padding=*/padding_values, /*data_format=*/xla_data_format,
       /*counts_include_padding=*/xla_padding == xla::Padding::kValid);
-  return new XLATensor(
-      XLATensor::to(in_backprop, absl::nullopt, grad->dtype()));
+  return new XLATensor(PermuteFormat(
+      XLATensor::to(in_backprop, absl::nullopt, grad->dtype()), pool_format,
+      tf_data_format));
 }
 
 OpaqueXLATensor* tf_MaxPool(OpaqueXLATensor* input, Int64ArrayRef ksize,
@@ -129,23 +237,51 @@ OpaqueXLATensor* tf_MaxPool(OpaqueXLATensor* input, Int64ArrayRef ksize,
                             enum TFDataFormat data_format) {
   xla::Padding xla_padding = ToXLAPadding(padding);
   int num_spatial_dims = ksize.size - 2;
+  tensorflow::TensorFormat tf_data_format = x10::ToTFFormat(data_format);
   xla::TensorFormat xla_data_format =
-      XlaTensorFormat(x10::ToTFFormat(data_format), num_spatial_dims);
+      XlaTensorFormat(tf_data_format, num_spatial_dims);
   auto kernel_size = XlaHelpers::I64List(ksize.slice());
   auto stride = XlaHelpers::I64List(strides.slice());
-  return new XLATensor(XLATensor::xla_max_pool(
-      /*input=*/*input, /*kernel_size=*/kernel_size, /*stride=*/stride,
-      /*padding=*/xla_padding, /*data_format=*/xla_data_format));
+  XLATensor pool_input = *input;
+  // The max pooling only supports the SAME window padding, which pads with
+  // -inf, so the VALID pooling of an input padded with -inf folds when the
+  // input padding is the SAME one.
+  std::vector<std::pair<xla::int64, xla::int64>> input_padding;
+  absl::optional<XLATensor> unpadded =
+      xla_padding == xla::Padding::kValid
+          ? MatchSpatialPad(pool_input, xla_data_format,
+                            -std::numeric_limits<double>::infinity(),
+                            &input_padding)
+          : absl::nullopt;
+  if (unpadded && xla::MakePadding(unpadded->shape().get().dimensions(),
+                                   kernel_size, stride,
+                                   xla::Padding::kSame) == input_padding) {
+    pool_input = *unpadded;
+    xla_padding = xla::Padding::kSame;
+    XLA_COUNTER("FoldedPoolPads", 1);
+  }
+  tensorflow::TensorFormat pool_format = tf_data_format;
+  if (UsePreferredPoolFormat(&pool_format, &pool_input, &kernel_size,
+                             &stride)) {
+    xla_data_format = XlaTensorFormat(pool_format, num_spatial_dims);
+  }
+  return new XLATensor(PermuteFormat(
+      XLATensor::xla_max_pool(
+          /*input=*/pool_input, /*kernel_size=*/kernel_size,
+          /*stride=*/stride, /*padding=*/xla_padding,
+          /*data_format=*/xla_data_format),
+      pool_format, tf_data_format));
 }
 
-OpaqueXLATensor* tf_MaxPoolGrad(OpaqueXLATensor* input, OpaqueXLATensor* grad,
-                                Int64ArrayRef ksize, Int64ArrayRef strides,
-                                enum TFPadding padding) {
+OpaqueXLATensor* tf_MaxPoolGrad(OpaqueXLATensor* input, OpaqueXLATensor* output,
+                                OpaqueXLATensor* grad, Int64ArrayRef ksize,
+                                Int64ArrayRef strides, enum TFPadding padding) {
   xla::Padding xla_padding = ToXLAPadding(padding);
   auto kernel_size = XlaHelpers::I64List(ksize.slice());
   auto stride = XlaHelpers::I64List(strides.slice());
   return new XLATensor(XLATensor::xla_max_pool_grad(
-      /*input=*/*input, /*out_backprop=*/*grad, /*kernel_size=*/kernel_size,
+      /*input=*/*input, /*output=*/*output, /*out_backprop=*/*grad,
+      /*kernel_size=*/kernel_size,
       /*stride=*/stride,
       /*padding=*/xla_padding));
 }
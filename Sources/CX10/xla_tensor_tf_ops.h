@@ -45,6 +45,7 @@ XLA_API OpaqueXLATensor* tf_MaxPool(OpaqueXLATensor* input, Int64ArrayRef ksize,
                                     enum TFDataFormat data_format);
 
 XLA_API OpaqueXLATensor* tf_MaxPoolGrad(OpaqueXLATensor* input,
+                                        OpaqueXLATensor* output,
                                         OpaqueXLATensor* grad,
                                         Int64ArrayRef ksize,
                                         Int64ArrayRef strides,
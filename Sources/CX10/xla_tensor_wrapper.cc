@@ -20,6 +20,8 @@
 
 #include "xla_tensor_wrapper.h"
 
+#include <chrono>
+#include <future>
 #include <random>
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
@@ -27,9 +29,17 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_dump_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/token.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/shape_bucketing.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/strided_slice_helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/event_tracer.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/metrics_reader.h"
+#include "tensorflow/compiler/xla/xla_client/step_profiler.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/core/util/mirror_pad_mode.h"
 
 using swift_xla::XlaHelpers;
@@ -68,11 +78,67 @@ tensorflow::MirrorPadMode ToTFMirrorPadMode(TFMirrorPadMode mode) {
   }
 }
 
+swift_xla::EmbeddingBagMode ToEmbeddingBagMode(XLAEmbeddingBagMode mode) {
+  switch (mode) {
+    case XLAEmbeddingBagMode_SUM: {
+      return swift_xla::EmbeddingBagMode::kSum;
+    }
+    case XLAEmbeddingBagMode_MEAN: {
+      return swift_xla::EmbeddingBagMode::kMean;
+    }
+    case XLAEmbeddingBagMode_MAX: {
+      return swift_xla::EmbeddingBagMode::kMax;
+    }
+    default: {
+      LOG(FATAL) << "Invalid embedding bag mode: " << mode;
+    }
+  }
+}
+
+absl::optional<XLATensor> AsOptionalTensor(OpaqueXLATensor* tensor) {
+  if (tensor == nullptr) {
+    return absl::nullopt;
+  }
+  return *tensor;
+}
+
 XLATensor MakeEmpty(at::ScalarType scalar_type, swift_xla::Device device) {
   at::Tensor empty(at::AnyScalarBuffer::empty(scalar_type), {});
   return XLATensor::Create(empty, device);
 }
 
+// Returns new tensors with the values of the given ones, which in place updates
+// can be applied to without affecting the caller's tensors.
+std::vector<XLATensor> CopyTensorList(OpaqueXLATensorArrayRef tensors) {
+  std::vector<XLATensor> copies;
+  copies.reserve(tensors.size);
+  for (size_t i = 0; i < tensors.size; ++i) {
+    const XLATensor& tensor = *tensors.data[i];
+    copies.push_back(XLATensor::Create(tensor.GetIrValue(), tensor.GetDevice(),
+                                       tensor.dtype()));
+  }
+  return copies;
+}
+
+// Same as CopyTensorList(), but the tensors which only live in host memory are
+// copied there, instead of being uploaded.
+std::vector<XLATensor> CopyHostTensorList(OpaqueXLATensorArrayRef tensors) {
+  std::vector<XLATensor> copies;
+  copies.reserve(tensors.size);
+  for (size_t i = 0; i < tensors.size; ++i) {
+    const XLATensor& tensor = *tensors.data[i];
+    c10::optional<at::Tensor> tensor_data = tensor.CurrentTensorData();
+    if (tensor_data && tensor.CurrentXlaData() == nullptr &&
+        !tensor.CurrentIrValue()) {
+      copies.push_back(XLATensor::Create(*tensor_data, tensor.GetDevice()));
+    } else {
+      copies.push_back(XLATensor::Create(
+          tensor.GetIrValue(), tensor.GetDevice(), tensor.dtype()));
+    }
+  }
+  return copies;
+}
+
 OpaqueXLATensorArrayRef ConvertTensorList(
     const std::vector<XLATensor>& tensors) {
   size_t count = tensors.size();
@@ -90,6 +156,56 @@ Int64ArrayRef Int64ArrayRefFromCollection(const T& collection) {
   return {array, collection.size()};
 }
 
+swift_xla::FusedBatchNormOptions MakeFusedBatchNormOptions(
+    double eps, int64_t feature_index, bool relu, bool cross_replica) {
+  swift_xla::FusedBatchNormOptions options;
+  options.eps_value = eps;
+  options.feature_index = feature_index;
+  options.relu = relu;
+  options.cross_replica = cross_replica;
+  return options;
+}
+
+swift_xla::AllReduceOptions GetCrossReplicaSumOptions() {
+  swift_xla::AllReduceOptions options;
+  std::string wire_type =
+      xla::sys_util::GetEnvString("XLA_ALLREDUCE_WIRE_TYPE", "");
+  if (wire_type == "bf16") {
+    options.wire_type = xla::PrimitiveType::BF16;
+  } else if (wire_type == "f16") {
+    options.wire_type = xla::PrimitiveType::F16;
+  } else {
+    XLA_CHECK(wire_type.empty())
+        << "Invalid XLA_ALLREDUCE_WIRE_TYPE: " << wire_type;
+  }
+  options.wire_type_min_elements =
+      xla::sys_util::GetEnvInt("XLA_ALLREDUCE_WIRE_MIN_ELEMENTS", 4096);
+  return options;
+}
+
+// Splits tensors into consecutive groups of group_sizes tensors.
+std::vector<std::vector<swift_xla::XLATensor>> SplitTensorGroups(
+    OpaqueXLATensorArrayRef tensors, Int64ArrayRef group_sizes) {
+  std::vector<swift_xla::XLATensor> xtensors = tensors.array();
+  std::vector<std::vector<swift_xla::XLATensor>> groups;
+  auto group_begin = xtensors.begin();
+  for (xla::int64 group_size : group_sizes.slice()) {
+    groups.emplace_back(group_begin, group_begin + group_size);
+    group_begin += group_size;
+  }
+  XLA_CHECK(group_begin == xtensors.end());
+  return groups;
+}
+
+std::vector<const std::vector<swift_xla::XLATensor>*> GroupPointers(
+    const std::vector<std::vector<swift_xla::XLATensor>>& groups) {
+  std::vector<const std::vector<swift_xla::XLATensor>*> group_ptrs;
+  for (const auto& group : groups) {
+    group_ptrs.push_back(&group);
+  }
+  return group_ptrs;
+}
+
 }  // namespace
 
 at::Scalar atScalar(XLAScalar s) {
@@ -110,7 +226,8 @@ swift_xla::XLATensor* XLATensor_makeScalar(XLAScalar value,
       atScalar(value), ToScalarType(type), ConvertDevice(cdevice)));
 }
 
-// TODO(parkers): reduce copying here...
+// Callers which can keep value alive should use borrowTensor instead, which
+// skips the host copy.
 swift_xla::XLATensor* copyTensor(XLATensorScalarType type,
                                  const void* raw_value, size_t num_entries,
                                  const size_t* shape, size_t rank,
@@ -132,6 +249,279 @@ swift_xla::XLATensor* copyTensor(XLATensorScalarType type,
       LOG(FATAL) << "Invalid type: " << type;
   }
 }
+
+OpaqueXLATensor* borrowTensor(enum XLATensorScalarType type,
+                              const void* raw_value, size_t num_entries,
+                              const size_t* shape, size_t rank,
+                              const struct CDevice device,
+                              void (*release)(void* context),
+                              void* release_context) {
+  switch (type) {
+#define DEFINE_BORROW_CASE(name, aten_name, DType)                       \
+  case XLATensorScalarType_##name: {                                     \
+    auto buffer = std::make_unique<at::ReleasingAnyScalarBuffer<DType>>( \
+        reinterpret_cast<const DType*>(raw_value), num_entries, release, \
+        release_context);                                                \
+    std::vector<int64_t> dims(shape, shape + rank);                      \
+    at::Tensor t(std::move(buffer), std::move(dims));                    \
+    return new swift_xla::XLATensor(                                     \
+        swift_xla::XLATensor::Create(t, ConvertDevice(device)));         \
+  }
+    LIST_SCALAR_TYPES(DEFINE_BORROW_CASE)
+#undef DEFINE_BORROW_CASE
+    default:
+      LOG(FATAL) << "Invalid type: " << type;
+  }
+}
+
+OpaqueXLATensor* copyTensorAndPrefetch(enum XLATensorScalarType type,
+                                       const void* raw_value,
+                                       size_t num_entries, const size_t* shape,
+                                       size_t rank,
+                                       const struct CDevice cdevice) {
+  auto device = ConvertDevice(cdevice);
+  switch (type) {
+#define DEFINE_PREFETCH_CASE(name, aten_name, DType)                       \
+  case XLATensorScalarType_##name: {                                       \
+    auto* value = reinterpret_cast<const DType*>(raw_value);               \
+    std::unique_ptr<DType[]> data(new DType[num_entries]);                 \
+    memcpy(data.get(), value, num_entries * sizeof(DType));                \
+    std::vector<int64_t> dims(shape, shape + rank);                        \
+    at::Tensor t(std::move(data), std::move(dims));                        \
+    return new swift_xla::XLATensor(swift_xla::XLATensor::Create(          \
+        swift_xla::TensorToXlaDataAsync(t, device), t.scalar_type()));     \
+  }
+    LIST_SCALAR_TYPES(DEFINE_PREFETCH_CASE)
+#undef DEFINE_PREFETCH_CASE
+    default:
+      LOG(FATAL) << "Invalid type: " << type;
+  }
+}
+
+OpaqueXLATensor_pair copyTensorQuantized(const float* value,
+                                         size_t num_entries,
+                                         const size_t* shape, size_t rank,
+                                         int64_t channel_dim,
+                                         const struct CDevice cdevice) {
+  auto device = ConvertDevice(cdevice);
+  auto non_owned_buffer =
+      std::make_unique<at::NonOwnedAnyScalarBuffer<float>>(value, num_entries);
+  at::Tensor t(std::move(non_owned_buffer),
+               std::vector<int64_t>(shape, shape + rank));
+  auto xla_data = swift_xla::QuantizedTensorToXlaData(t, channel_dim, device);
+  OpaqueXLATensor_pair result;
+  result.x = new swift_xla::XLATensor(
+      swift_xla::XLATensor::Create(xla_data.first, at::ScalarType::Char));
+  result.y = new swift_xla::XLATensor(
+      swift_xla::XLATensor::Create(xla_data.second, at::ScalarType::Float));
+  return result;
+}
+
+OpaqueXLATensorArrayRef loadTensorsFromFile(
+    const char* path, enum XLATensorScalarType type, const size_t* offsets,
+    const size_t* shapes, const size_t* ranks, size_t count,
+    const struct CDevice cdevice) {
+  at::ScalarType scalar_type = ToScalarType(type);
+  std::vector<swift_xla::FileTensorSpec> specs(count);
+  for (size_t i = 0; i < count; ++i) {
+    specs[i].type = scalar_type;
+    specs[i].dims.assign(shapes, shapes + ranks[i]);
+    specs[i].offset = offsets[i];
+    shapes += ranks[i];
+  }
+  std::vector<xla::ComputationClient::DataPtr> xla_data =
+      swift_xla::FileToXlaData(path, specs, ConvertDevice(cdevice));
+  std::vector<swift_xla::XLATensor> tensors;
+  tensors.reserve(xla_data.size());
+  for (auto& data : xla_data) {
+    tensors.push_back(
+        swift_xla::XLATensor::Create(std::move(data), scalar_type));
+  }
+  return ConvertTensorList(tensors);
+}
+
+XLAAsyncCheckpoint* saveTensorsAsync(OpaqueXLATensorArrayRef tensors,
+                                     const char* path, int shard_index,
+                                     int num_shards) {
+  std::vector<swift_xla::XLATensor> xtensors = tensors.array();
+  return new XLAAsyncCheckpoint(
+      swift_xla::SaveTensorsAsync(&xtensors, path, shard_index, num_shards));
+}
+
+const size_t* AsyncCheckpoint_offsets(XLAAsyncCheckpoint* checkpoint,
+                                      size_t* count) {
+  const std::vector<size_t>& offsets = (*checkpoint)->offsets();
+  *count = offsets.size();
+  return offsets.data();
+}
+
+void AsyncCheckpoint_wait(XLAAsyncCheckpoint* checkpoint) {
+  (*checkpoint)->Wait();
+}
+
+void destroyAsyncCheckpoint(XLAAsyncCheckpoint* checkpoint) {
+  delete checkpoint;
+}
+
+void exportComputationBundle(OpaqueXLATensorArrayRef tensors,
+                             Int64ArrayRef group_sizes, const char* path) {
+  std::vector<std::vector<swift_xla::XLATensor>> groups =
+      SplitTensorGroups(tensors, group_sizes);
+  swift_xla::XLATensor::ExportTensorsGraphs(GroupPointers(groups),
+                                            /*devices=*/{},
+                                            /*sync_xla_data=*/true, path);
+}
+
+OpaqueXLATensor* makeWarmupTensor(enum XLATensorScalarType type,
+                                  const size_t* shape, size_t rank,
+                                  const struct CDevice device,
+                                  bool to_bucket) {
+  std::vector<xla::int64> dims(shape, shape + rank);
+  if (to_bucket) {
+    dims = swift_xla::GetBucketedDimensions(dims);
+  }
+  return new swift_xla::XLATensor(swift_xla::XLATensor::CreatePlaceholder(
+      ToScalarType(type), dims, ConvertDevice(device)));
+}
+
+void precompileGraphs(OpaqueXLATensorArrayRef tensors,
+                      Int64ArrayRef group_sizes) {
+  std::vector<std::vector<swift_xla::XLATensor>> groups =
+      SplitTensorGroups(tensors, group_sizes);
+  swift_xla::XLATensor::PrecompileTensorsGraphs(GroupPointers(groups),
+                                                /*devices=*/{},
+                                                /*sync_xla_data=*/true);
+}
+
+XLAInputPipeline* makeInputPipeline(const enum XLATensorScalarType* types,
+                                    const size_t* sample_dims,
+                                    const size_t* ranks, size_t count,
+                                    const struct CDevice device,
+                                    size_t depth) {
+  std::vector<swift_xla::InputPipeline::Field> fields(count);
+  for (size_t i = 0; i < count; ++i) {
+    fields[i].scalar_type = ToScalarType(types[i]);
+    fields[i].sample_dims.assign(sample_dims, sample_dims + ranks[i]);
+    sample_dims += ranks[i];
+  }
+  return new XLAInputPipeline(std::move(fields), ConvertDevice(device), depth);
+}
+
+void InputPipeline_enqueue(XLAInputPipeline* pipeline,
+                           const void* const* samples, size_t num_samples) {
+  pipeline->Enqueue(absl::Span<const void* const>(
+      samples, num_samples * pipeline->num_fields()));
+}
+
+OpaqueXLATensorArrayRef InputPipeline_dequeue(XLAInputPipeline* pipeline) {
+  return ConvertTensorList(pipeline->Dequeue());
+}
+
+void destroyInputPipeline(XLAInputPipeline* pipeline) { delete pipeline; }
+
+void loadComputationBundle(const char* path) {
+  swift_xla::XLATensor::LoadComputationBundle(path, /*devices=*/{});
+}
+
+OpaqueString* exportTensorData(OpaqueXLATensor* t) {
+  return new std::string(t->ExportDeviceData());
+}
+
+void unexportTensorData(const char* handle, const struct CDevice device) {
+  swift_xla::XLATensor::UnexportDeviceData(ConvertDevice(device), handle);
+}
+
+void freezeTensors(OpaqueXLATensorArrayRef tensors) {
+  std::vector<swift_xla::XLATensor> xtensors = tensors.array();
+  swift_xla::XLATensor::Freeze(&xtensors);
+}
+
+void keepTensorsHostData(OpaqueXLATensorArrayRef tensors) {
+  for (swift_xla::XLATensor& xtensor : tensors.array()) {
+    xtensor.KeepHostData();
+  }
+}
+
+OpaqueXLATensor* importTensorData(const char* handle,
+                                  enum XLATensorScalarType type,
+                                  Int64ArrayRef dims,
+                                  const struct CDevice device) {
+  return new swift_xla::XLATensor(swift_xla::XLATensor::ImportDeviceData(
+      handle, ToScalarType(type), dims.slice(), ConvertDevice(device)));
+}
+
+OpaqueXLATensor* copyTensorPadded(enum XLATensorScalarType type,
+                                  const void* raw_value, size_t num_entries,
+                                  const size_t* shape, size_t rank,
+                                  const size_t* padded_shape,
+                                  const struct CDevice device) {
+  std::vector<xla::int64> dims(shape, shape + rank);
+  std::vector<xla::int64> padded_dims(padded_shape, padded_shape + rank);
+  if (padded_dims == dims) {
+    return copyTensor(type, raw_value, num_entries, shape, rank, device);
+  }
+  switch (type) {
+#define DEFINE_PADDED_COPY_CASE(name, aten_name, DType)                     \
+  case XLATensorScalarType_##name: {                                        \
+    std::unique_ptr<DType[]> data(                                          \
+        new DType[xla::util::Multiply<xla::int64>(padded_dims)]);           \
+    swift_xla::PadToDimensions(raw_value, dims, data.get(), padded_dims,    \
+                               sizeof(DType));                              \
+    at::Tensor t(std::move(data), std::vector<int64_t>(padded_dims.begin(), \
+                                                       padded_dims.end())); \
+    return new swift_xla::XLATensor(                                        \
+        swift_xla::XLATensor::Create(t, ConvertDevice(device)));            \
+  }
+    LIST_SCALAR_TYPES(DEFINE_PADDED_COPY_CASE)
+#undef DEFINE_PADDED_COPY_CASE
+    default:
+      LOG(FATAL) << "Invalid type: " << type;
+  }
+}
+
+OpaqueXLATensor* copyTensorToBucket(enum XLATensorScalarType type,
+                                    const void* raw_value, size_t num_entries,
+                                    const size_t* shape, size_t rank,
+                                    const struct CDevice device,
+                                    size_t* bucketed_shape) {
+  std::vector<xla::int64> dims(shape, shape + rank);
+  std::vector<xla::int64> bucketed_dims =
+      swift_xla::GetBucketedDimensions(dims);
+  std::copy(bucketed_dims.begin(), bucketed_dims.end(), bucketed_shape);
+  return copyTensorPadded(type, raw_value, num_entries, shape, rank,
+                          bucketed_shape, device);
+}
+
+void copyTensors(size_t count, const enum XLATensorScalarType* types,
+                 const void* const* values, const size_t* num_entries,
+                 const size_t* const* shapes, const size_t* ranks,
+                 const struct CDevice device, OpaqueXLATensor** results) {
+  std::vector<at::Tensor> tensors;
+  tensors.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<int64_t> dims(shapes[i], shapes[i] + ranks[i]);
+    switch (types[i]) {
+#define DEFINE_COPY_MANY_CASE(name, aten_name, DType)              \
+  case XLATensorScalarType_##name: {                               \
+    std::unique_ptr<DType[]> data(new DType[num_entries[i]]);      \
+    memcpy(data.get(), values[i], num_entries[i] * sizeof(DType)); \
+    tensors.emplace_back(std::move(data), std::move(dims));        \
+    break;                                                         \
+  }
+      LIST_SCALAR_TYPES(DEFINE_COPY_MANY_CASE)
+#undef DEFINE_COPY_MANY_CASE
+      default:
+        LOG(FATAL) << "Invalid type: " << types[i];
+    }
+  }
+  std::vector<XLATensor> xla_tensors = XLATensor::CreateTensors(
+      tensors,
+      std::vector<std::string>(count, ConvertDevice(device).ToString()));
+  for (size_t i = 0; i < count; ++i) {
+    results[i] = new XLATensor(std::move(xla_tensors[i]));
+  }
+}
+
 OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type,
                                            const void* value,
                                            size_t num_entries,
@@ -164,9 +554,12 @@ OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type,
     xla::BorrowingLiteral literal(reinterpret_cast<const char*>(value),
                                   host_shape);
 
-    return new swift_xla::XLATensor(swift_xla::XLATensor::Create(
+    xla::ComputationClient::DataPtr data =
         xla::GetX10Device(device)->TransferToServer(std::move(literal),
-                                                    dest_shape)));
+                                                    dest_shape);
+    data->SetMemoryKind(xla::metrics::MemoryKind::kParameter);
+    return new swift_xla::XLATensor(
+        swift_xla::XLATensor::Create(std::move(data)));
   }
   return copyTensor(type, value, num_entries, shape, rank, cdevice);
 }
@@ -183,6 +576,45 @@ OpaqueMaterializedTensor* XLATensor_materialize(OpaqueXLATensor* t) {
   return new at::Tensor(t->ToTensor(/*detached=*/false));
 }
 
+void XLATensor_materialize_many(OpaqueXLATensor* const* tensors, size_t count,
+                                OpaqueMaterializedTensor** results) {
+  std::vector<XLATensor> pending;
+  std::vector<size_t> pending_indices;
+  for (size_t i = 0; i < count; ++i) {
+    auto current_tensor = tensors[i]->CurrentTensorData();
+    if (current_tensor) {
+      results[i] = new at::Tensor(std::move(*current_tensor));
+    } else {
+      pending.push_back(*tensors[i]);
+      pending_indices.push_back(i);
+    }
+  }
+  if (pending.empty()) return;
+  XLA_VALUE_METRIC("MaterializeManySize", pending.size());
+  std::vector<at::Tensor> values = XLATensor::GetTensors(&pending);
+  for (size_t i = 0; i < pending_indices.size(); ++i) {
+    results[pending_indices[i]] = new at::Tensor(std::move(values[i]));
+  }
+}
+
+OpaqueMaterializedTensorFuture* XLATensor_materialize_async(
+    OpaqueXLATensor* t) {
+  return new std::shared_future<at::Tensor>(t->ToTensorAsync());
+}
+
+bool MaterializedTensorFuture_isReady(OpaqueMaterializedTensorFuture* f) {
+  return f->wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+OpaqueMaterializedTensor* MaterializedTensorFuture_wait(
+    OpaqueMaterializedTensorFuture* f) {
+  return new at::Tensor(f->get());
+}
+
+void destroyMaterializedTensorFuture(OpaqueMaterializedTensorFuture* f) {
+  delete f;
+}
+
 enum XLATensorScalarType MaterializedTensor_getType(
     OpaqueMaterializedTensor* t) {
   return FromScalarType(t->scalar_type());
@@ -219,7 +651,18 @@ XLATensorScalarType FromScalarType(at::ScalarType type) {
 }
 
 void destroyTensor(swift_xla::XLATensor* t) { delete t; }
+void destroyTensors(OpaqueXLATensor* const* tensors, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    delete tensors[i];
+  }
+}
 void destroyMaterializedTensor(OpaqueMaterializedTensor* t) { delete t; }
+void destroyMaterializedTensors(OpaqueMaterializedTensor* const* tensors,
+                                size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    delete tensors[i];
+  }
+}
 void destroyXLAShape(xla::util::MaybeRef<xla::Shape>* s) { delete s; }
 
 xla::util::MaybeRef<xla::Shape>* fetchTensorShape(
@@ -246,7 +689,7 @@ static const CDevice& CheckedRef(const CDevice* device) {
 }
 
 XLAAnnotationScope* MakeAnnotationScope(const char* scope) {
-  return new tensorflow::profiler::TraceMe(scope);
+  return new XLAAnnotationScope(scope);
 }
 void DestroyAnnotationScope(XLAAnnotationScope* scope) {
   if (scope) delete scope;
@@ -268,8 +711,66 @@ tensorflow::TensorFormat ToTFFormat(TFDataFormat data_format) {
   }
 }
 
+namespace {
+
+// The data format of the innermost data format scope of the thread, if any.
+thread_local absl::optional<tensorflow::TensorFormat> g_scope_data_format;
+
+absl::optional<tensorflow::TensorFormat> EnvPreferredDataFormat() {
+  std::string name =
+      xla::sys_util::GetEnvString("XLA_PREFERRED_DATA_FORMAT", "");
+  if (name.empty()) {
+    return absl::nullopt;
+  }
+  tensorflow::TensorFormat data_format;
+  XLA_CHECK(tensorflow::FormatFromString(name, &data_format) &&
+            (data_format == tensorflow::FORMAT_NHWC ||
+             data_format == tensorflow::FORMAT_NCHW))
+      << "Invalid XLA_PREFERRED_DATA_FORMAT: " << name;
+  return data_format;
+}
+
+}  // namespace
+
+absl::optional<tensorflow::TensorFormat> PreferredDataFormat() {
+  static const absl::optional<tensorflow::TensorFormat> env_data_format =
+      EnvPreferredDataFormat();
+  return g_scope_data_format ? g_scope_data_format : env_data_format;
+}
+
+std::vector<xla::int64> DataFormatPermutation(int num_dims,
+                                              tensorflow::TensorFormat from,
+                                              tensorflow::TensorFormat to) {
+  std::vector<xla::int64> dims(num_dims);
+  dims[tensorflow::GetTensorBatchDimIndex(num_dims, to)] =
+      tensorflow::GetTensorBatchDimIndex(num_dims, from);
+  dims[tensorflow::GetTensorFeatureDimIndex(num_dims, to)] =
+      tensorflow::GetTensorFeatureDimIndex(num_dims, from);
+  for (int i = 0; i < num_dims - 2; ++i) {
+    dims[tensorflow::GetTensorSpatialDimIndex(num_dims, to, i)] =
+        tensorflow::GetTensorSpatialDimIndex(num_dims, from, i);
+  }
+  return dims;
+}
+
 }  // namespace x10
 
+XLADataFormatScope::XLADataFormatScope(tensorflow::TensorFormat data_format)
+    : previous(x10::g_scope_data_format) {
+  x10::g_scope_data_format = data_format;
+}
+
+XLADataFormatScope::~XLADataFormatScope() {
+  x10::g_scope_data_format = previous;
+}
+
+XLADataFormatScope* MakeDataFormatScope(enum TFDataFormat data_format) {
+  return new XLADataFormatScope(x10::ToTFFormat(data_format));
+}
+void DestroyDataFormatScope(XLADataFormatScope* scope) {
+  if (scope) delete scope;
+}
+
 void destroyOpaqueXLATensorArrayRef(OpaqueXLATensorArrayRef tensor_list) {
   delete[] tensor_list.data;
 }
@@ -280,10 +781,76 @@ void destroyStridedSliceSpec(StridedSliceSpec* strided_slice_spec) {
   delete[] strided_slice_spec->strides.data;
   delete[] strided_slice_spec->processing_sizes.data;
   delete[] strided_slice_spec->final_sizes.data;
+  delete[] strided_slice_spec->slice_begin.data;
+  delete[] strided_slice_spec->slice_end.data;
+  delete[] strided_slice_spec->slice_strides.data;
+  delete[] strided_slice_spec->reverse_dims.data;
   delete strided_slice_spec;
 }
 
+XLARematerializationScope* MakeRematerializationScope() {
+  return new swift_xla::ir::RematerializationScope();
+}
+void DestroyRematerializationScope(XLARematerializationScope* scope,
+                                   OpaqueXLATensorArrayRef outputs) {
+  for (size_t i = 0; i < outputs.size; ++i) {
+    scope->KeepOutput(outputs.data[i]->CurrentIrValue());
+  }
+  delete scope;
+}
+
 // Ops.
+OpaqueXLATensorArrayRef XLATensor_accumulate(
+    OpaqueXLATensorArrayRef accumulators, OpaqueXLATensorArrayRef values,
+    bool reset) {
+  std::vector<XLATensor> accumulator_copies = CopyTensorList(accumulators);
+  std::vector<XLATensor> sums =
+      XLATensor::accumulate_(&accumulator_copies, values.array(), reset);
+  accumulator_copies.insert(accumulator_copies.end(), sums.begin(),
+                            sums.end());
+  return ConvertTensorList(accumulator_copies);
+}
+OpaqueXLATensorArrayRef XLATensor_adam_update(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef first_moments,
+    OpaqueXLATensorArrayRef second_moments, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* beta1, OpaqueXLATensor* beta2, OpaqueXLATensor* epsilon,
+    OpaqueXLATensor* weight_decay, OpaqueXLATensor* grads_finite,
+    bool offload_moments) {
+  std::vector<XLATensor> weight_copies = CopyTensorList(weights);
+  if (offload_moments) {
+    std::vector<XLATensor> first_moment_copies =
+        CopyHostTensorList(first_moments);
+    std::vector<XLATensor> second_moment_copies =
+        CopyHostTensorList(second_moments);
+    XLATensor::adam_update_offloaded_(
+        &weight_copies, &first_moment_copies, &second_moment_copies,
+        grads.array(), *learning_rate, *beta1, *beta2, *epsilon, *weight_decay,
+        grads_finite);
+    weight_copies.insert(weight_copies.end(), first_moment_copies.begin(),
+                         first_moment_copies.end());
+    weight_copies.insert(weight_copies.end(), second_moment_copies.begin(),
+                         second_moment_copies.end());
+    return ConvertTensorList(weight_copies);
+  }
+  std::vector<XLATensor> first_moment_copies = CopyTensorList(first_moments);
+  std::vector<XLATensor> second_moment_copies = CopyTensorList(second_moments);
+  XLATensor::adam_update_(&weight_copies, &first_moment_copies,
+                          &second_moment_copies, grads.array(), *learning_rate,
+                          *beta1, *beta2, *epsilon, *weight_decay,
+                          grads_finite);
+  weight_copies.insert(weight_copies.end(), first_moment_copies.begin(),
+                       first_moment_copies.end());
+  weight_copies.insert(weight_copies.end(), second_moment_copies.begin(),
+                       second_moment_copies.end());
+  return ConvertTensorList(weight_copies);
+}
+OpaqueXLATensor* XLATensor_all_gather(OpaqueXLATensor* input, int64_t dim,
+                                      int64_t shard_count) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  return new XLATensor(
+      XLATensor::all_gather(*input, token, dim, shard_count, {}).first);
+}
 OpaqueXLATensor* XLATensor_annotate(OpaqueXLATensor* a,
                                     const char* annotation) {
   return new XLATensor(XLATensor::annotate(*a, std::string(annotation)));
@@ -298,10 +865,21 @@ OpaqueXLATensor* XLATensor_arange(XLAScalar start, XLAScalar end,
 }
 OpaqueXLATensorArrayRef XLATensor_cross_replica_sum(
     OpaqueXLATensorArrayRef inputs, double scale) {
+  static xla::int64 bucket_bytes =
+      xla::sys_util::GetEnvInt("XLA_ALLREDUCE_BUCKET_BYTES", 25 << 20);
+  static swift_xla::AllReduceOptions default_options =
+      GetCrossReplicaSumOptions();
+  static bool hierarchical =
+      xla::sys_util::GetEnvBool("XLA_ALLREDUCE_HIERARCHICAL", false);
+  swift_xla::AllReduceOptions options = default_options;
+  if (hierarchical) {
+    options.host_groups = xla::ComputationClient::GetReplicaHostGroups();
+  }
   auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
   auto inputs_array = inputs.array();
-  auto reduced_and_token = XLATensor::all_reduce(
-      inputs_array, token, swift_xla::AllReduceType::kSum, scale, {});
+  auto reduced_and_token = XLATensor::all_reduce_bucketed(
+      inputs_array, token, swift_xla::AllReduceType::kSum, scale, {},
+      bucket_bytes, options);
   const auto& result_tensors = reduced_and_token.first;
   return ConvertTensorList(result_tensors);
 }
@@ -320,6 +898,24 @@ OpaqueString* XLATensor_xla_ir_text(OpaqueXLATensor* a) {
       swift_xla::ir::DumpUtil::ToHlo({a->GetIrValue()}, a->GetDevice());
   return new std::string(ir_dag_text);
 }
+OpaqueXLATensor* XLATensor_kv_cache_update(OpaqueXLATensor* cache,
+                                           OpaqueXLATensor* update,
+                                           OpaqueXLATensor* position,
+                                           int64_t dim) {
+  XLATensor result = XLATensor::Create(cache->GetIrValue(), cache->GetDevice(),
+                                       cache->dtype());
+  XLATensor::kv_cache_update_(result, *update, *position, dim);
+  return new XLATensor(result);
+}
+OpaqueXLATensor* XLATensor_set_dimension_bound(OpaqueXLATensor* input,
+                                               OpaqueXLATensor* size,
+                                               int64_t dim) {
+  return new XLATensor(XLATensor::set_dimension_bound(*input, *size, dim));
+}
+OpaqueXLATensor* XLATensor_remove_dynamic_dimension(OpaqueXLATensor* input,
+                                                    int64_t dim) {
+  return new XLATensor(XLATensor::remove_dynamic_dimension(*input, dim));
+}
 OpaqueXLATensor* XLATensor_linspace(XLAScalar start, XLAScalar stop,
                                     int64_t num, const CDevice device,
                                     enum XLATensorScalarType type) {
@@ -328,9 +924,246 @@ OpaqueXLATensor* XLATensor_linspace(XLAScalar start, XLAScalar stop,
                           ToScalarType(type));
   return new XLATensor(out);
 }
+OpaqueXLATensorArrayRef XLATensor_loss_scale_update(
+    OpaqueXLATensorArrayRef grads, OpaqueXLATensor* loss_scale,
+    OpaqueXLATensor* good_steps, int64_t growth_interval, double growth_factor,
+    double backoff_factor) {
+  std::vector<XLATensor> grad_copies = CopyTensorList(grads);
+  XLATensor loss_scale_copy = XLATensor::Create(
+      loss_scale->GetIrValue(), loss_scale->GetDevice(), loss_scale->dtype());
+  XLATensor good_steps_copy = XLATensor::Create(
+      good_steps->GetIrValue(), good_steps->GetDevice(), good_steps->dtype());
+  XLATensor grads_finite = XLATensor::loss_scale_update_(
+      &grad_copies, &loss_scale_copy, &good_steps_copy, growth_interval,
+      growth_factor, backoff_factor);
+  grad_copies.push_back(grads_finite);
+  grad_copies.push_back(loss_scale_copy);
+  grad_copies.push_back(good_steps_copy);
+  return ConvertTensorList(grad_copies);
+}
+OpaqueXLATensor* XLATensor_reduce_scatter_sum(OpaqueXLATensor* input,
+                                              double scale, int64_t dim,
+                                              int64_t shard_count) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  return new XLATensor(XLATensor::reduce_scatter(
+                           *input, token, swift_xla::AllReduceType::kSum,
+                           scale, dim, shard_count, {})
+                           .first);
+}
 OpaqueXLATensor* XLATensor_replica_id(const struct CDevice device) {
   return new XLATensor(XLATensor::xla_replica_id(ConvertDevice(device)));
 }
+OpaqueXLATensor* XLATensor_resize_bilinear(OpaqueXLATensor* input,
+                                           Int64ArrayRef output_size,
+                                           bool align_corners,
+                                           bool half_pixel_centers,
+                                           bool channels_last) {
+  return new XLATensor(XLATensor::xla_resize_bilinear(
+      *input, XlaHelpers::I64List(output_size.slice()), align_corners,
+      half_pixel_centers, channels_last));
+}
+OpaqueXLATensor* XLATensor_resize_bilinear_backward(
+    OpaqueXLATensor* grad_output, Int64ArrayRef input_size, bool align_corners,
+    bool half_pixel_centers, bool channels_last) {
+  return new XLATensor(XLATensor::xla_resize_bilinear_backward(
+      *grad_output, XlaHelpers::I64List(input_size.slice()), align_corners,
+      half_pixel_centers, channels_last));
+}
+OpaqueXLATensor* XLATensor_rng_normal(Int64ArrayRef size,
+                                      OpaqueXLATensor* mean,
+                                      OpaqueXLATensor* stddev) {
+  return new XLATensor(XLATensor::xla_rng_normal(size.slice(), *mean, *stddev));
+}
+OpaqueXLATensor* XLATensor_rng_uniform(Int64ArrayRef size,
+                                       OpaqueXLATensor* minval,
+                                       OpaqueXLATensor* maxval) {
+  return new XLATensor(
+      XLATensor::xla_rng_uniform(size.slice(), *minval, *maxval));
+}
+OpaqueXLATensor_pair XLATensor_scaled_dot_product_attention(
+    OpaqueXLATensor* query, OpaqueXLATensor* key, OpaqueXLATensor* value,
+    double scale, bool causal, int64_t block_size,
+    OpaqueXLATensor* valid_length) {
+  auto outputs = XLATensor::xla_scaled_dot_product_attention(
+      *query, *key, *value, scale, causal, block_size,
+      AsOptionalTensor(valid_length));
+  OpaqueXLATensor_pair result;
+  result.x = new XLATensor(outputs.first);
+  result.y = new XLATensor(outputs.second);
+  return result;
+}
+OpaqueXLATensor_tuple_3 XLATensor_scaled_dot_product_attention_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* query, OpaqueXLATensor* key,
+    OpaqueXLATensor* value, OpaqueXLATensor* output, OpaqueXLATensor* logsumexp,
+    double scale, bool causal, int64_t block_size) {
+  auto grads = XLATensor::xla_scaled_dot_product_attention_backward(
+      *grad_output, *query, *key, *value, *output, *logsumexp, scale, causal,
+      block_size);
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(grads));
+  result.v1 = new XLATensor(std::get<1>(grads));
+  result.v2 = new XLATensor(std::get<2>(grads));
+  return result;
+}
+OpaqueXLATensor* XLATensor_embedding_bag(OpaqueXLATensor* table,
+                                         OpaqueXLATensor* indices,
+                                         OpaqueXLATensor* per_sample_weights,
+                                         enum XLAEmbeddingBagMode mode) {
+  return new XLATensor(XLATensor::xla_embedding_bag(
+      *table, *indices, AsOptionalTensor(per_sample_weights),
+      ToEmbeddingBagMode(mode)));
+}
+OpaqueXLATensor* XLATensor_embedding_bag_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* table,
+    OpaqueXLATensor* indices, OpaqueXLATensor* output,
+    OpaqueXLATensor* per_sample_weights, enum XLAEmbeddingBagMode mode) {
+  return new XLATensor(XLATensor::xla_embedding_bag_backward(
+      *grad_output, *table, *indices, *output,
+      AsOptionalTensor(per_sample_weights), ToEmbeddingBagMode(mode)));
+}
+OpaqueXLATensor_tuple_3 XLATensor_fused_batch_norm(
+    OpaqueXLATensor* input, OpaqueXLATensor* weight, OpaqueXLATensor* bias,
+    OpaqueXLATensor* residual, double eps, int64_t feature_index, bool relu,
+    bool cross_replica) {
+  auto outputs = XLATensor::xla_fused_batch_norm(
+      *input, *weight, *bias, AsOptionalTensor(residual),
+      MakeFusedBatchNormOptions(eps, feature_index, relu, cross_replica));
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(outputs));
+  result.v1 = new XLATensor(std::get<1>(outputs));
+  result.v2 = new XLATensor(std::get<2>(outputs));
+  return result;
+}
+OpaqueXLATensorArrayRef XLATensor_fused_batch_norm_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* weight, OpaqueXLATensor* mean, OpaqueXLATensor* variance,
+    OpaqueXLATensor* output, double eps, int64_t feature_index, bool relu,
+    bool cross_replica) {
+  auto grads = XLATensor::xla_fused_batch_norm_backward(
+      *grad_output, *input, *weight, *mean, *variance, *output,
+      MakeFusedBatchNormOptions(eps, feature_index, relu, cross_replica));
+  return ConvertTensorList(std::vector<XLATensor>{
+      std::get<0>(grads), std::get<1>(grads), std::get<2>(grads),
+      std::get<3>(grads)});
+}
+OpaqueXLATensor_tuple_3 XLATensor_layer_norm(OpaqueXLATensor* input,
+                                             OpaqueXLATensor* weight,
+                                             OpaqueXLATensor* bias,
+                                             int64_t axis, double eps) {
+  auto outputs =
+      XLATensor::xla_layer_norm(*input, *weight, *bias, axis, eps);
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(outputs));
+  result.v1 = new XLATensor(std::get<1>(outputs));
+  result.v2 = new XLATensor(std::get<2>(outputs));
+  return result;
+}
+OpaqueXLATensor_tuple_3 XLATensor_layer_norm_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* weight, OpaqueXLATensor* mean, OpaqueXLATensor* variance,
+    int64_t axis, double eps) {
+  auto grads = XLATensor::xla_layer_norm_backward(
+      *grad_output, *input, *weight, *mean, *variance, axis, eps);
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(grads));
+  result.v1 = new XLATensor(std::get<1>(grads));
+  result.v2 = new XLATensor(std::get<2>(grads));
+  return result;
+}
+OpaqueXLATensor_pair XLATensor_rms_norm(OpaqueXLATensor* input,
+                                        OpaqueXLATensor* weight, int64_t axis,
+                                        double eps) {
+  auto outputs = XLATensor::xla_rms_norm(*input, *weight, axis, eps);
+  OpaqueXLATensor_pair result;
+  result.x = new XLATensor(std::get<0>(outputs));
+  result.y = new XLATensor(std::get<1>(outputs));
+  return result;
+}
+OpaqueXLATensor_pair XLATensor_rms_norm_backward(OpaqueXLATensor* grad_output,
+                                                 OpaqueXLATensor* input,
+                                                 OpaqueXLATensor* weight,
+                                                 OpaqueXLATensor* inv_rms,
+                                                 int64_t axis) {
+  auto grads = XLATensor::xla_rms_norm_backward(*grad_output, *input, *weight,
+                                                *inv_rms, axis);
+  OpaqueXLATensor_pair result;
+  result.x = new XLATensor(std::get<0>(grads));
+  result.y = new XLATensor(std::get<1>(grads));
+  return result;
+}
+OpaqueXLATensor_pair XLATensor_nms(OpaqueXLATensor* boxes,
+                                   OpaqueXLATensor* scores,
+                                   double score_threshold,
+                                   double iou_threshold, int64_t output_size,
+                                   int64_t tile_size) {
+  auto outputs = XLATensor::xla_nms(*boxes, *scores, score_threshold,
+                                    iou_threshold, output_size, tile_size);
+  OpaqueXLATensor_pair result;
+  result.x = new XLATensor(outputs.first);
+  result.y = new XLATensor(outputs.second);
+  return result;
+}
+OpaqueXLATensor* XLATensor_numerics_guard(const struct CDevice device) {
+  return new XLATensor(XLATensor::NumericsGuard(ConvertDevice(device)));
+}
+void XLATensor_set_rng_seed(const struct CDevice device, uint64_t seed) {
+  auto xla_device = ConvertDevice(device);
+  XLATensor::SetRngSeed(&xla_device, seed);
+}
+OpaqueXLATensorArrayRef XLATensor_sgd_update(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef velocities, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* momentum, OpaqueXLATensor* weight_decay, bool nesterov,
+    OpaqueXLATensor* grads_finite) {
+  std::vector<XLATensor> weight_copies = CopyTensorList(weights);
+  std::vector<XLATensor> velocity_copies = CopyTensorList(velocities);
+  XLATensor::sgd_update_(&weight_copies, &velocity_copies, grads.array(),
+                         *learning_rate, *momentum, *weight_decay, nesterov,
+                         grads_finite);
+  weight_copies.insert(weight_copies.end(), velocity_copies.begin(),
+                       velocity_copies.end());
+  return ConvertTensorList(weight_copies);
+}
+OpaqueXLATensor* XLATensor_shard(OpaqueXLATensor* a,
+                                 Int64ArrayRef shard_counts) {
+  return new XLATensor(XLATensor::shard(*a, shard_counts.slice()));
+}
+OpaqueXLATensorArrayRef XLATensor_sharded_adam_update(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensor* first_moment_shard, OpaqueXLATensor* second_moment_shard,
+    OpaqueXLATensor* learning_rate, OpaqueXLATensor* beta1,
+    OpaqueXLATensor* beta2, OpaqueXLATensor* epsilon,
+    OpaqueXLATensor* weight_decay, double grad_scale,
+    OpaqueXLATensor* grads_finite) {
+  std::vector<XLATensor> weight_copies = CopyTensorList(weights);
+  XLATensor first_moment_copy = XLATensor::Create(
+      first_moment_shard->GetIrValue(), first_moment_shard->GetDevice(),
+      first_moment_shard->dtype());
+  XLATensor second_moment_copy = XLATensor::Create(
+      second_moment_shard->GetIrValue(), second_moment_shard->GetDevice(),
+      second_moment_shard->dtype());
+  XLATensor::sharded_adam_update_(
+      &weight_copies, &first_moment_copy, &second_moment_copy, grads.array(),
+      *learning_rate, *beta1, *beta2, *epsilon, *weight_decay, grad_scale,
+      grads_finite);
+  weight_copies.push_back(first_moment_copy);
+  weight_copies.push_back(second_moment_copy);
+  return ConvertTensorList(weight_copies);
+}
+int64_t XLATensor_sharded_optimizer_shard_size(
+    OpaqueXLATensorArrayRef weights) {
+  return XLATensor::sharded_optimizer_shard_size(weights.array());
+}
+OpaqueXLATensor_pair XLATensor_softmax_cross_entropy(
+    OpaqueXLATensor* logits, OpaqueXLATensor* labels, int64_t ignore_index,
+    double label_smoothing, int64_t chunk_size) {
+  auto outputs = XLATensor::xla_softmax_cross_entropy(
+      *logits, *labels, ignore_index, label_smoothing, chunk_size);
+  OpaqueXLATensor_pair result;
+  result.x = new XLATensor(outputs.first);
+  result.y = new XLATensor(outputs.second);
+  return result;
+}
 OpaqueXLATensor* XLATensor_to(OpaqueXLATensor* a, const CDevice* device,
                               Optional_XLAScalarType dtype) {
   return new XLATensor(XLATensor::to(*a, AsOptional(device), dtype.value()));
@@ -374,10 +1207,45 @@ StridedSliceSpec* ComputeIndexingBoundsAndStrides(
       Int64ArrayRefFromCollection(bounds_and_strides.end),
       Int64ArrayRefFromCollection(bounds_and_strides.strides),
       Int64ArrayRefFromCollection(bounds_and_strides.processing_sizes),
-      Int64ArrayRefFromCollection(bounds_and_strides.final_sizes)};
+      Int64ArrayRefFromCollection(bounds_and_strides.final_sizes),
+      Int64ArrayRefFromCollection(bounds_and_strides.slice_begin),
+      Int64ArrayRefFromCollection(bounds_and_strides.slice_end),
+      Int64ArrayRefFromCollection(bounds_and_strides.slice_strides),
+      Int64ArrayRefFromCollection(bounds_and_strides.reverse_dims)};
 }
 void PrintMetrics() {
   LOG(INFO) << "Metrics:\n" << xla::metrics::CreateMetricReport();
 }
+void PrintCompileReport(int64_t top_n) {
+  LOG(INFO) << "Slowest compilations:\n"
+            << xla::metrics_reader::CreateCompileReport(top_n);
+}
+void PrintExecutionReport(int64_t top_n, bool include_hlo) {
+  LOG(INFO) << "Hottest graphs:\n"
+            << xla::metrics_reader::CreateExecutionReport(top_n, include_hlo);
+}
+OpaqueString* GetExecutionReport(int64_t top_n, bool include_hlo) {
+  return new std::string(
+      xla::metrics_reader::CreateExecutionReport(top_n, include_hlo));
+}
+OpaqueString* GetScopeReport(int64_t top_n) {
+  return new std::string(xla::metrics_reader::CreateScopeReport(top_n));
+}
+OpaqueString* GetMemoryReport(int64_t top_n) {
+  return new std::string(xla::metrics_reader::CreateMemoryReport(top_n));
+}
+OpaqueString* GetMemoryDiffReport() {
+  return new std::string(xla::metrics_reader::CreateMemoryDiffReport());
+}
+void PrintStepProfile() {
+  LOG(INFO) << "Step profile:\n"
+            << xla::metrics::StepProfiler::Get()->CreateReport();
+}
+void DumpEventTrace(const char* path) {
+  xla::metrics::EventTracer::Get()->DumpChromeTrace(path);
+}
+OpaqueString* GetPrometheusMetrics() {
+  return new std::string(xla::metrics::CreatePrometheusReport());
+}
 void DeleteString(OpaqueString* str) { delete str; }
 const char* GetStringCStr(OpaqueString* str) { return str->c_str(); }
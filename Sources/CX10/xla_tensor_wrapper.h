@@ -28,12 +28,34 @@
 #endif
 
 #ifdef __cplusplus
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/input_pipeline.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 using OpaqueMaterializedTensor = at::Tensor;
+using OpaqueMaterializedTensorFuture = std::shared_future<at::Tensor>;
 using OpaqueXLATensor = swift_xla::XLATensor;
 using OpaqueXLAShape = xla::util::MaybeRef<xla::Shape>;
-using XLAAnnotationScope = tensorflow::profiler::TraceMe;
+// Annotates the profiler traces, and the device memory accounting.
+struct XLAAnnotationScope {
+  explicit XLAAnnotationScope(const char* scope)
+      : trace(scope), memory_scope(scope), ir_scope(scope) {}
+
+  tensorflow::profiler::TraceMe trace;
+  xla::metrics::MemoryScope memory_scope;
+  swift_xla::ir::ScopePusher ir_scope;
+};
+using XLARematerializationScope = swift_xla::ir::RematerializationScope;
+// Makes the windowed ops traced by the thread run in the given data format,
+// see x10::PreferredDataFormat().
+struct XLADataFormatScope {
+  explicit XLADataFormatScope(tensorflow::TensorFormat data_format);
+  ~XLADataFormatScope();
+
+  absl::optional<tensorflow::TensorFormat> previous;
+};
+using XLAAsyncCheckpoint = std::shared_ptr<swift_xla::AsyncCheckpoint>;
+using XLAInputPipeline = swift_xla::InputPipeline;
 using OpaqueString = std::string;
 extern "C" {
 #else
@@ -43,8 +65,18 @@ typedef struct OpaqueXLAShape {
 } OpaqueXLAShape;
 typedef struct OpaqueMaterializedTensor {
 } OpaqueMaterializedTensor;
+typedef struct OpaqueMaterializedTensorFuture {
+} OpaqueMaterializedTensorFuture;
 typedef struct XLAAnnotationScope {
 } XLAAnnotationScope;
+typedef struct XLARematerializationScope {
+} XLARematerializationScope;
+typedef struct XLADataFormatScope {
+} XLADataFormatScope;
+typedef struct XLAAsyncCheckpoint {
+} XLAAsyncCheckpoint;
+typedef struct XLAInputPipeline {
+} XLAInputPipeline;
 typedef struct OpaqueString {
 } OpaqueString;
 #endif
@@ -91,11 +123,19 @@ XLA_API OpaqueXLATensor* XLATensor_makeScalar(XLAScalar value,
                                               enum XLATensorScalarType type,
                                               const struct CDevice cdevice);
 
-// TODO(parkers): Make aliasing constructor.
 XLA_API OpaqueXLATensor* copyTensor(enum XLATensorScalarType type,
                                     const void* value, size_t num_entries,
                                     const size_t* shape, size_t rank,
                                     const struct CDevice device);
+// Same as copyTensor, but the tensor borrows value instead of copying it. The
+// buffer must stay alive and unmodified until release(release_context) gets
+// called, which happens once the tensor (and any host copy of it) is gone.
+XLA_API OpaqueXLATensor* borrowTensor(enum XLATensorScalarType type,
+                                      const void* value, size_t num_entries,
+                                      const size_t* shape, size_t rank,
+                                      const struct CDevice device,
+                                      void (*release)(void* context),
+                                      void* release_context);
 // Copies tensor directly using xla's linearizer into temporary memory and then
 // schedule an async copy to device. This avoids copies at the cost of being
 // eager about doing a device copy. Except for this explicit copy, it is
@@ -107,9 +147,64 @@ XLA_API OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type
                                                    size_t rank,
                                                    const struct CDevice device,
                                                    bool to_reduced_precision);
+// Same as copyTensor, but the upload to the device starts right away, in the
+// background, so that it overlaps with the computations already running.
+// Computations using the tensor wait for the upload to finish.
+XLA_API OpaqueXLATensor* copyTensorAndPrefetch(enum XLATensorScalarType type,
+                                               const void* value,
+                                               size_t num_entries,
+                                               const size_t* shape,
+                                               size_t rank,
+                                               const struct CDevice device);
+// Same as copyTensor, but pads the tensor with zeros up to padded_shape, an
+// array of rank entries, each greater or equal than the one of shape.
+XLA_API OpaqueXLATensor* copyTensorPadded(enum XLATensorScalarType type,
+                                          const void* value,
+                                          size_t num_entries,
+                                          const size_t* shape, size_t rank,
+                                          const size_t* padded_shape,
+                                          const struct CDevice device);
+// Same as copyTensor, but pads the tensor with zeros up to the shape picked by
+// the XLA_SHAPE_BUCKETS policy, which is stored into bucketed_shape (an array
+// of rank entries). The valid extents within the padded tensor are the ones
+// described by shape.
+XLA_API OpaqueXLATensor* copyTensorToBucket(enum XLATensorScalarType type,
+                                            const void* value,
+                                            size_t num_entries,
+                                            const size_t* shape, size_t rank,
+                                            const struct CDevice device,
+                                            size_t* bucketed_shape);
+// Creates count tensors on device, the i-th one like copyTensor(types[i],
+// values[i], num_entries[i], shapes[i], ranks[i], device) would, and stores
+// them into results. All the host buffers are uploaded in a single transfer.
+XLA_API void copyTensors(size_t count, const enum XLATensorScalarType* types,
+                         const void* const* values, const size_t* num_entries,
+                         const size_t* const* shapes, const size_t* ranks,
+                         const struct CDevice device,
+                         OpaqueXLATensor** results);
 XLA_API void destroyTensor(OpaqueXLATensor* t);
+XLA_API void destroyTensors(OpaqueXLATensor* const* tensors, size_t count);
 XLA_API OpaqueMaterializedTensor* XLATensor_materialize(OpaqueXLATensor* t);
+// Same as calling XLATensor_materialize on every tensor, storing the values in
+// results, but all the pending computations are run by a single sync.
+XLA_API void XLATensor_materialize_many(OpaqueXLATensor* const* tensors,
+                                        size_t count,
+                                        OpaqueMaterializedTensor** results);
+// Schedules the pending computation of the tensor without waiting for it, and
+// returns a future which is ready once the value has been fetched to host.
+XLA_API OpaqueMaterializedTensorFuture* XLATensor_materialize_async(
+    OpaqueXLATensor* t);
+XLA_API bool MaterializedTensorFuture_isReady(
+    OpaqueMaterializedTensorFuture* f);
+// Blocks until the value is available. The returned tensor is owned by the
+// caller, and must be released with destroyMaterializedTensor.
+XLA_API OpaqueMaterializedTensor* MaterializedTensorFuture_wait(
+    OpaqueMaterializedTensorFuture* f);
+XLA_API void destroyMaterializedTensorFuture(
+    OpaqueMaterializedTensorFuture* f);
 XLA_API void destroyMaterializedTensor(OpaqueMaterializedTensor* t);
+XLA_API void destroyMaterializedTensors(
+    OpaqueMaterializedTensor* const* tensors, size_t count);
 XLA_API const void* MaterializedTensor_getData(OpaqueMaterializedTensor* t);
 XLA_API enum XLATensorScalarType MaterializedTensor_getType(
     OpaqueMaterializedTensor* t);
@@ -143,14 +238,55 @@ enum TFDataFormat {
 #ifdef __cplusplus
 namespace x10 {
 tensorflow::TensorFormat ToTFFormat(TFDataFormat data_format);
+
+// A padding of input with a constant value, which the windowed ops reading it
+// can fold into their window padding.
+struct ConstantPad {
+  swift_xla::ir::Value input;
+  xla::PaddingConfig config;
+  at::Scalar value;
+};
+
+// Returns the constant padding value is the result of, if any.
+absl::optional<ConstantPad> MatchConstantPad(const swift_xla::ir::Value& value);
+
+// The data format the NHWC and NCHW convolutions and poolings run in, if any:
+// the one of the innermost data format scope of the thread, or else the one of
+// XLA_PREFERRED_DATA_FORMAT. The ops in the other format transpose their input
+// into it and their output back, and the transposes of successive ops cancel
+// out, so the activations between them stay in the preferred format.
+absl::optional<tensorflow::TensorFormat> PreferredDataFormat();
+
+// The permutation of the dimensions of a num_dims tensor in the from format
+// which puts them in the to format.
+std::vector<xla::int64> DataFormatPermutation(int num_dims,
+                                              tensorflow::TensorFormat from,
+                                              tensorflow::TensorFormat to);
+
+// Permutes the dimensions of value, merging the permutation with the one value
+// is the result of, if any.
+swift_xla::ir::Value PermuteValue(const swift_xla::ir::Value& value,
+                                  std::vector<xla::int64> dims);
 }  // namespace x10
 #endif
 
+// Between MakeDataFormatScope() and DestroyDataFormatScope(), the NHWC and
+// NCHW convolutions and poolings traced by the thread run in the given data
+// format.
+XLA_API XLADataFormatScope* MakeDataFormatScope(enum TFDataFormat data_format);
+XLA_API void DestroyDataFormatScope(XLADataFormatScope* scope);
+
 enum TFMirrorPadMode {
   TFMirrorPadMode_REFLECT = 1,
   TFMirrorPadMode_SYMMETRIC = 2,
 };
 
+enum XLAEmbeddingBagMode {
+  XLAEmbeddingBagMode_SUM = 0,
+  XLAEmbeddingBagMode_MEAN = 1,
+  XLAEmbeddingBagMode_MAX = 2,
+};
+
 // XLA utilities:
 
 typedef struct Int64ArrayRef {
@@ -208,6 +344,10 @@ typedef struct StridedSliceSpec {
   Int64ArrayRef strides;
   Int64ArrayRef processing_sizes;
   Int64ArrayRef final_sizes;
+  Int64ArrayRef slice_begin;
+  Int64ArrayRef slice_end;
+  Int64ArrayRef slice_strides;
+  Int64ArrayRef reverse_dims;
 } StridedSliceSpec;
 
 typedef struct PaddingConfigDimension {
@@ -226,14 +366,144 @@ void destroyOpaqueXLATensorArrayRef(OpaqueXLATensorArrayRef tensor_list);
 
 XLA_API void destroyStridedSliceSpec(StridedSliceSpec* strided_slice_spec);
 
+// Quantizes the float tensor to int8 with a symmetric scale per index of
+// channel_dim, and uploads the quantized values, returned as x, and the float
+// scales, returned as y.
+XLA_API OpaqueXLATensor_pair copyTensorQuantized(const float* value,
+                                                 size_t num_entries,
+                                                 const size_t* shape,
+                                                 size_t rank,
+                                                 int64_t channel_dim,
+                                                 const struct CDevice device);
+
+// Uploads count tensors of the given type stored in the file at path, the
+// i-th one starting at offsets[i] with the ranks[i] dimensions which follow
+// the ones of the previous tensors in shapes. The file is memory mapped and
+// streamed to the device, without intermediate host copies.
+XLA_API OpaqueXLATensorArrayRef loadTensorsFromFile(
+    const char* path, enum XLATensorScalarType type, const size_t* offsets,
+    const size_t* shapes, const size_t* ranks, size_t count,
+    const struct CDevice device);
+
+// Starts writing the tensors whose index modulo num_shards is shard_index to
+// the file at path, in the layout loadTensorsFromFile() reads, and returns
+// right away. The tensors can keep being updated while their snapshotted
+// values are written.
+XLA_API XLAAsyncCheckpoint* saveTensorsAsync(OpaqueXLATensorArrayRef tensors,
+                                             const char* path,
+                                             int shard_index, int num_shards);
+// Returns the file offsets of the saved tensors, setting count to their number.
+XLA_API const size_t* AsyncCheckpoint_offsets(XLAAsyncCheckpoint* checkpoint,
+                                              size_t* count);
+XLA_API void AsyncCheckpoint_wait(XLAAsyncCheckpoint* checkpoint);
+XLA_API void destroyAsyncCheckpoint(XLAAsyncCheckpoint* checkpoint);
+
+// Writes the computations which syncing each group of tensors would run to a
+// bundle file at path. The groups follow each other in tensors, group_sizes
+// telling how many tensors each has.
+XLA_API void exportComputationBundle(OpaqueXLATensorArrayRef tensors,
+                                     Int64ArrayRef group_sizes,
+                                     const char* path);
+// Compiles the computations of the bundle at path into the computation cache.
+XLA_API void loadComputationBundle(const char* path);
+
+// Creates a tensor with the given type and shape, or the one copyTensorToBucket
+// would pad it to if to_bucket, standing for an input of the graphs traced to
+// warm up the computation cache. It has no value, so the graphs using it can
+// only be passed to precompileGraphs().
+XLA_API OpaqueXLATensor* makeWarmupTensor(enum XLATensorScalarType type,
+                                          const size_t* shape, size_t rank,
+                                          const struct CDevice device,
+                                          bool to_bucket);
+// Compiles, concurrently, the computations which syncing each group of tensors
+// would run, into the computation cache and the persistent one, without
+// running them. The groups are laid out like in exportComputationBundle().
+XLA_API void precompileGraphs(OpaqueXLATensorArrayRef tensors,
+                              Int64ArrayRef group_sizes);
+
+// Creates the last stage of a host input pipeline, which collates samples into
+// batches of count fields and keeps at most depth of them uploading or
+// uploaded ahead of the consumer. Field i has element type types[i], and
+// samples of rank ranks[i], whose dimensions follow each other in sample_dims.
+XLA_API XLAInputPipeline* makeInputPipeline(
+    const enum XLATensorScalarType* types, const size_t* sample_dims,
+    const size_t* ranks, size_t count, const struct CDevice device,
+    size_t depth);
+// Collates and queues a batch of num_samples samples, samples[i * count + j]
+// pointing to field j of sample i. Blocks while depth batches are queued.
+XLA_API void InputPipeline_enqueue(XLAInputPipeline* pipeline,
+                                   const void* const* samples,
+                                   size_t num_samples);
+// Blocks until a batch is queued, and returns its tensors, one per field.
+XLA_API OpaqueXLATensorArrayRef
+InputPipeline_dequeue(XLAInputPipeline* pipeline);
+XLA_API void destroyInputPipeline(XLAInputPipeline* pipeline);
+
+// Freezes the tensors into the graphs using them, which embed their values as
+// constants instead of reading them as parameters, until they get updated.
+XLA_API void freezeTensors(OpaqueXLATensorArrayRef tensors);
+
+// Keeps the host values the tensors got created from after their upload,
+// which otherwise drops them under XLA_DROP_UPLOADED_HOST_DATA.
+XLA_API void keepTensorsHostData(OpaqueXLATensorArrayRef tensors);
+
+// Exports the device data of the tensor for the other processes of the host,
+// and returns the handle they import it with, which stays valid until
+// unexportTensorData() gets it.
+XLA_API OpaqueString* exportTensorData(OpaqueXLATensor* t);
+XLA_API void unexportTensorData(const char* handle,
+                                const struct CDevice device);
+// Creates a tensor of the device data exported by another process, which must
+// have the given type and shape.
+XLA_API OpaqueXLATensor* importTensorData(const char* handle,
+                                          enum XLATensorScalarType type,
+                                          Int64ArrayRef dims,
+                                          const struct CDevice device);
+
+// The intermediate values traced between MakeRematerializationScope() and
+// DestroyRematerializationScope() are not kept live for the operations traced
+// afterwards (like the backward pass), which recompute them instead. Only the
+// outputs passed to DestroyRematerializationScope() are kept.
+XLA_API XLARematerializationScope* MakeRematerializationScope();
+XLA_API void DestroyRematerializationScope(XLARematerializationScope* scope,
+                                           OpaqueXLATensorArrayRef outputs);
+
 // Ops:
 XLA_API OpaqueXLATensor* XLATensor_abs(OpaqueXLATensor* a);
+// Adds every value to its accumulator, whose buffer is donated to the result
+// like the one of the cache of XLATensor_kv_cache_update. Returns the new
+// accumulators, followed, with reset, by the sums, the new accumulators being
+// zeros then.
+XLA_API OpaqueXLATensorArrayRef XLATensor_accumulate(
+    OpaqueXLATensorArrayRef accumulators, OpaqueXLATensorArrayRef values,
+    bool reset);
 XLA_API OpaqueXLATensor* XLATensor_acos(OpaqueXLATensor* a);
+XLA_API OpaqueXLATensor* XLATensor_adaptive_avg_pool2d(
+    OpaqueXLATensor* input, Int64ArrayRef output_size);
+XLA_API OpaqueXLATensor*
+XLATensor_adaptive_avg_pool2d_backward(OpaqueXLATensor* grad_output,
+                                       Int64ArrayRef input_size);
 XLA_API OpaqueXLATensor* XLATensor_acosh(OpaqueXLATensor* a);
+// Applies the Adam update to every weight, with a single fused update per
+// device and element type. The update is skipped if grads_finite, which can be
+// null, is false. With offload_moments, the moments are kept in host memory
+// and streamed through the device in buckets. Returns the new weights,
+// followed by the new first and second moments.
+XLA_API OpaqueXLATensorArrayRef XLATensor_adam_update(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef first_moments,
+    OpaqueXLATensorArrayRef second_moments, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* beta1, OpaqueXLATensor* beta2, OpaqueXLATensor* epsilon,
+    OpaqueXLATensor* weight_decay, OpaqueXLATensor* grads_finite,
+    bool offload_moments);
 XLA_API OpaqueXLATensor* XLATensor_add(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_all(OpaqueXLATensor* input,
                                        Int64ArrayRef dimensions,
                                        bool keep_reduced_dimensions);
+// Concatenates along dim the inputs of all the replicas, which must number
+// shard_count.
+XLA_API OpaqueXLATensor* XLATensor_all_gather(OpaqueXLATensor* input,
+                                              int64_t dim, int64_t shard_count);
 XLA_API OpaqueXLATensor* XLATensor_annotate(OpaqueXLATensor* a, const char*);
 XLA_API OpaqueXLATensor* XLATensor_any(OpaqueXLATensor* input,
                                        Int64ArrayRef dimensions,
@@ -254,6 +524,7 @@ XLA_API OpaqueXLATensor_pair XLATensor_broadcast_tensors(OpaqueXLATensor* a,
                                                          OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_cat(OpaqueXLATensorArrayRef tensors, int64_t dim);
 XLA_API OpaqueXLATensor* XLATensor_ceil(OpaqueXLATensor* a);
+XLA_API OpaqueXLATensor* XLATensor_cholesky(OpaqueXLATensor* input);
 XLA_API OpaqueXLATensor*
 XLATensor_clamp(OpaqueXLATensor* input, OpaqueXLATensor* min,
                 OpaqueXLATensor* max);
@@ -278,6 +549,17 @@ XLA_API OpaqueXLATensor* XLATensor_dynamic_slice(
 XLA_API OpaqueXLATensor* XLATensor_dynamic_update_slice(
     OpaqueXLATensor* base, OpaqueXLATensor* update,
     OpaqueXLATensorArrayRef inputs);
+// Gathers the [V, D] table rows picked by the [B, L] indices and pools every
+// bag of L rows into one, returning a [B, D] tensor. Negative indices are
+// padding. The per_sample_weights scale the rows before pooling, if not null.
+XLA_API OpaqueXLATensor* XLATensor_embedding_bag(
+    OpaqueXLATensor* table, OpaqueXLATensor* indices,
+    OpaqueXLATensor* per_sample_weights, enum XLAEmbeddingBagMode mode);
+// Returns the table gradient of XLATensor_embedding_bag.
+XLA_API OpaqueXLATensor* XLATensor_embedding_bag_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* table,
+    OpaqueXLATensor* indices, OpaqueXLATensor* output,
+    OpaqueXLATensor* per_sample_weights, enum XLAEmbeddingBagMode mode);
 XLA_API OpaqueXLATensor* XLATensor_eq(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_exp(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor*
@@ -286,6 +568,26 @@ XLA_API OpaqueXLATensor* XLATensor_expm1(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor*
 XLATensor_flip(OpaqueXLATensor* input, Int64ArrayRef dims);
 XLA_API OpaqueXLATensor* XLATensor_floor(OpaqueXLATensor* a);
+// Batch normalization training over the given feature dimension, with the
+// optional residual add (when residual isn't null) and ReLU fused after it.
+// Returns the output, and the batch mean and variance. With cross_replica, the
+// statistics cover the batches of all the replicas.
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_fused_batch_norm(
+    OpaqueXLATensor* input, OpaqueXLATensor* weight, OpaqueXLATensor* bias,
+    OpaqueXLATensor* residual, double eps, int64_t feature_index, bool relu,
+    bool cross_replica);
+// Returns the input, weight, bias and residual gradients of
+// XLATensor_fused_batch_norm.
+XLA_API OpaqueXLATensorArrayRef XLATensor_fused_batch_norm_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* weight, OpaqueXLATensor* mean, OpaqueXLATensor* variance,
+    OpaqueXLATensor* output, double eps, int64_t feature_index, bool relu,
+    bool cross_replica);
+// Zeroes out the elements of the input with the given probability, drawing the
+// mask from the two seeds, and scales the others by 1 / (1 - probability).
+XLA_API OpaqueXLATensor* XLATensor_fused_dropout(OpaqueXLATensor* input,
+                                                 OpaqueXLATensor* seeds,
+                                                 float probability);
 XLA_API OpaqueXLATensor* XLATensor_gather(OpaqueXLATensor* x,
                                           OpaqueXLATensor* y,
                                           int64_t start_dim);
@@ -297,6 +599,41 @@ XLA_API OpaqueString* XLATensor_xla_ir_text(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_is_finite(OpaqueXLATensor* input);
 XLA_API OpaqueXLATensor* XLATensor_is_inf(OpaqueXLATensor* input);
 XLA_API OpaqueXLATensor* XLATensor_is_nan(OpaqueXLATensor* input);
+// Layer normalization along axis, with single pass statistics. Returns the
+// output, and the mean and variance of every position of the other dimensions.
+XLA_API OpaqueXLATensor_tuple_3
+XLATensor_layer_norm(OpaqueXLATensor* input, OpaqueXLATensor* weight,
+                     OpaqueXLATensor* bias, int64_t axis, double eps);
+// Returns the input, weight and bias gradients of XLATensor_layer_norm.
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_layer_norm_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* weight, OpaqueXLATensor* mean, OpaqueXLATensor* variance,
+    int64_t axis, double eps);
+// Root mean square normalization along axis. Returns the output, and the
+// inverse root mean square of every position of the other dimensions.
+XLA_API OpaqueXLATensor_pair XLATensor_rms_norm(OpaqueXLATensor* input,
+                                                OpaqueXLATensor* weight,
+                                                int64_t axis, double eps);
+// Returns the input and weight gradients of XLATensor_rms_norm.
+XLA_API OpaqueXLATensor_pair XLATensor_rms_norm_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* weight, OpaqueXLATensor* inv_rms, int64_t axis);
+// Returns cache with update written at the scalar position along dim. The
+// buffer of cache is donated to the result at the step barriers once cache is
+// dead, even without XLA_ENABLE_PARAM_ALIASING.
+XLA_API OpaqueXLATensor* XLATensor_kv_cache_update(OpaqueXLATensor* cache,
+                                                   OpaqueXLATensor* update,
+                                                   OpaqueXLATensor* position,
+                                                   int64_t dim);
+// Returns input with dim marked as dynamic, bounded by its size, and the
+// scalar size as its actual size, which the graphs take as a parameter.
+XLA_API OpaqueXLATensor* XLATensor_set_dimension_bound(OpaqueXLATensor* input,
+                                                       OpaqueXLATensor* size,
+                                                       int64_t dim);
+// Returns input with its dynamic dim static at its bound, and zeros past its
+// actual size.
+XLA_API OpaqueXLATensor* XLATensor_remove_dynamic_dimension(
+    OpaqueXLATensor* input, int64_t dim);
 XLA_API OpaqueXLATensor* XLATensor_le(OpaqueXLATensor* x, OpaqueXLATensor* y);
 XLA_API OpaqueXLATensor* XLATensor_lt(OpaqueXLATensor* x, OpaqueXLATensor* y);
 XLA_API OpaqueXLATensor* XLATensor_linspace(XLAScalar start, XLAScalar stop,
@@ -317,8 +654,23 @@ XLATensor_logicalAnd(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_logicalNot(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor*
 XLATensor_logicalOr(OpaqueXLATensor* a, OpaqueXLATensor* b);
+// Applies the dynamic loss scaling to the gradients of a loss multiplied by
+// loss_scale. Returns the unscaled gradients, followed by the boolean telling
+// whether they are all finite, which the optimizer updates take as
+// grads_finite, the new loss scale and the new count of finite steps.
+XLA_API OpaqueXLATensorArrayRef XLATensor_loss_scale_update(
+    OpaqueXLATensorArrayRef grads, OpaqueXLATensor* loss_scale,
+    OpaqueXLATensor* good_steps, int64_t growth_interval, double growth_factor,
+    double backoff_factor);
 XLA_API OpaqueXLATensor*
 XLATensor_matmul(OpaqueXLATensor* a, OpaqueXLATensor* b);
+XLA_API OpaqueXLATensor* XLATensor_matrixInverse(OpaqueXLATensor* input,
+                                                 bool adjoint);
+XLA_API OpaqueXLATensor* XLATensor_matrixSolve(OpaqueXLATensor* matrix,
+                                               OpaqueXLATensor* rhs,
+                                               bool adjoint);
+XLA_API OpaqueXLATensor* XLATensor_matrixTriangularSolve(
+    OpaqueXLATensor* matrix, OpaqueXLATensor* rhs, bool lower, bool adjoint);
 XLA_API OpaqueXLATensor*
 XLATensor_max(OpaqueXLATensor* input, int64_t dim, bool keepdim);
 XLA_API OpaqueXLATensor*
@@ -329,6 +681,9 @@ XLA_API OpaqueXLATensor* XLATensor_min(OpaqueXLATensor* input, int64_t dim,
                                        bool keepdim);
 XLA_API OpaqueXLATensor*
 XLATensor_minimum(OpaqueXLATensor* a, OpaqueXLATensor* b);
+XLA_API OpaqueXLATensor_pair XLATensor_moments(OpaqueXLATensor* input,
+                                               Int64ArrayRef dims,
+                                               bool keep_reduced_dimensions);
 XLA_API OpaqueXLATensor* XLATensor_mul(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_mm(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_ne(OpaqueXLATensor* a, OpaqueXLATensor* b);
@@ -336,6 +691,17 @@ XLA_API OpaqueXLATensor* XLATensor_neg(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_nll_loss(OpaqueXLATensor* input,
                                             OpaqueXLATensor* target,
                                             int64_t ignore_index);
+// Tiled non-maximum suppression of [N, 4] or batched [B, N, 4] boxes. Returns
+// the selected box indices and their number.
+XLA_API OpaqueXLATensor_pair XLATensor_nms(OpaqueXLATensor* boxes,
+                                           OpaqueXLATensor* scores,
+                                           double score_threshold,
+                                           double iou_threshold,
+                                           int64_t output_size,
+                                           int64_t tile_size);
+// Returns the boolean scalar telling whether the floating point values of the
+// latest sync of the device are all finite, with XLA_NUMERICS_GUARD.
+XLA_API OpaqueXLATensor* XLATensor_numerics_guard(const struct CDevice device);
 XLA_API OpaqueXLATensor*
 XLATensor_permute_value(OpaqueXLATensor* a, Int64ArrayRef arr);
 XLA_API OpaqueXLATensor* XLATensor_physical_cast(
@@ -345,17 +711,88 @@ XLA_API OpaqueXLATensor* XLATensor_pow(OpaqueXLATensor* base,
 XLA_API OpaqueXLATensor* XLATensor_prod(OpaqueXLATensor* a, Int64ArrayRef dims,
                                         bool keep_reduced_dimensions);
 XLA_API OpaqueXLATensor_pair XLATensor_qr(OpaqueXLATensor* input, bool some);
+// Matmul against int8 weights quantized per output channel, the last
+// dimension of weight, with the given dequantization scales.
+XLA_API OpaqueXLATensor* XLATensor_quantized_matmul(OpaqueXLATensor* input,
+                                                    OpaqueXLATensor* weight,
+                                                    OpaqueXLATensor* scale);
+// Sums the input over all the replicas, which must number shard_count, and
+// returns the scaled slice along dim which belongs to this replica.
+XLA_API OpaqueXLATensor* XLATensor_reduce_scatter_sum(OpaqueXLATensor* input,
+                                                      double scale, int64_t dim,
+                                                      int64_t shard_count);
 XLA_API OpaqueXLATensor* XLATensor_relu(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_rem(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_repeat(OpaqueXLATensor* input,
                                           Int64ArrayRef repeats);
 XLA_API OpaqueXLATensor* XLATensor_replica_id(const struct CDevice device);
+// Bilinear resize of the spatial dimensions of an NHWC, or NCHW when
+// channels_last is false, input to the [height, width] output_size.
+XLA_API OpaqueXLATensor* XLATensor_resize_bilinear(OpaqueXLATensor* input,
+                                                   Int64ArrayRef output_size,
+                                                   bool align_corners,
+                                                   bool half_pixel_centers,
+                                                   bool channels_last);
+// Returns the input gradient of XLATensor_resize_bilinear, for an input of the
+// [height, width] input_size.
+XLA_API OpaqueXLATensor* XLATensor_resize_bilinear_backward(
+    OpaqueXLATensor* grad_output, Int64ArrayRef input_size, bool align_corners,
+    bool half_pixel_centers, bool channels_last);
+// Random values of the given size, drawn from the step seed of the device.
+// Each call uses its own stream of the seed, so random ops don't depend on
+// each other.
+XLA_API OpaqueXLATensor* XLATensor_rng_normal(Int64ArrayRef size,
+                                              OpaqueXLATensor* mean,
+                                              OpaqueXLATensor* stddev);
+XLA_API OpaqueXLATensor* XLATensor_rng_uniform(Int64ArrayRef size,
+                                               OpaqueXLATensor* minval,
+                                               OpaqueXLATensor* maxval);
 XLA_API OpaqueXLATensor*
 XLATensor_resize_value(OpaqueXLATensor* a, Int64ArrayRef arr);
 XLA_API OpaqueXLATensor* XLATensor_round_to_even(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_rsqrt(OpaqueXLATensor* a);
+// Fused softmax(query * key^T * scale) * value, returning the attention
+// output (x) and the logsumexp of the score rows (y). The key positions at or
+// past the scalar valid_length, which can be null, are masked out.
+XLA_API OpaqueXLATensor_pair XLATensor_scaled_dot_product_attention(
+    OpaqueXLATensor* query, OpaqueXLATensor* key, OpaqueXLATensor* value,
+    double scale, bool causal, int64_t block_size,
+    OpaqueXLATensor* valid_length);
+// Returns the query, key and value gradients of the fused attention.
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_scaled_dot_product_attention_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* query, OpaqueXLATensor* key,
+    OpaqueXLATensor* value, OpaqueXLATensor* output, OpaqueXLATensor* logsumexp,
+    double scale, bool causal, int64_t block_size);
 XLA_API OpaqueXLATensor*
 XLATensor_select(OpaqueXLATensor* a, int64_t dim, int64_t index);
+// Sets the step seed used by XLATensor_rng_normal and XLATensor_rng_uniform.
+XLA_API void XLATensor_set_rng_seed(const struct CDevice device, uint64_t seed);
+// Applies the SGD with momentum update to every weight, fused like
+// XLATensor_adam_update. Returns the new weights, followed by the new
+// velocities.
+XLA_API OpaqueXLATensorArrayRef XLATensor_sgd_update(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef velocities, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* momentum, OpaqueXLATensor* weight_decay, bool nesterov,
+    OpaqueXLATensor* grads_finite);
+// Splits dimension i of a into shard_counts[i] shards across the replication
+// devices, which run the graphs using it as the partitions of one SPMD
+// program.
+XLA_API OpaqueXLATensor* XLATensor_shard(OpaqueXLATensor* a,
+                                         Int64ArrayRef shard_counts);
+// Applies the Adam update to weights replicated across the replication
+// devices, each of which only keeps a shard of the moments. Returns the new
+// weights, followed by the new first and second moment shards.
+XLA_API OpaqueXLATensorArrayRef XLATensor_sharded_adam_update(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensor* first_moment_shard, OpaqueXLATensor* second_moment_shard,
+    OpaqueXLATensor* learning_rate, OpaqueXLATensor* beta1,
+    OpaqueXLATensor* beta2, OpaqueXLATensor* epsilon,
+    OpaqueXLATensor* weight_decay, double grad_scale,
+    OpaqueXLATensor* grads_finite);
+// Returns the size of the moment shards of XLATensor_sharded_adam_update.
+XLA_API int64_t
+XLATensor_sharded_optimizer_shard_size(OpaqueXLATensorArrayRef weights);
 XLA_API OpaqueXLATensor* XLATensor_sigmoid(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_sign(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_sin(OpaqueXLATensor* a);
@@ -363,6 +800,11 @@ XLA_API OpaqueXLATensor* XLATensor_sinh(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_slice(
     OpaqueXLATensor* a, int64_t dim, int64_t start, int64_t end, int64_t step);
 XLA_API OpaqueXLATensor* XLATensor_softmax(OpaqueXLATensor* a, int64_t dim);
+// Fused softmax cross-entropy of logits [N, C] against class indices [N],
+// returning the per example losses (x) and their logits gradient (y).
+XLA_API OpaqueXLATensor_pair XLATensor_softmax_cross_entropy(
+    OpaqueXLATensor* logits, OpaqueXLATensor* labels, int64_t ignore_index,
+    double label_smoothing, int64_t chunk_size);
 XLA_API OpaqueXLATensor* XLATensor_sqrt(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_squeeze(OpaqueXLATensor* a, int64_t dim);
 XLA_API OpaqueXLATensor*
@@ -391,6 +833,13 @@ XLA_API OpaqueXLATensor* XLATensor_tf_ConvBackpropInput(
     OpaqueXLATensor* out_backprop, bool depthwise, Int64ArrayRef strides,
     enum TFPadding padding, Int64ArrayRef explicit_paddings,
     enum TFDataFormat data_format, Int64ArrayRef dilations);
+// Same as XLATensor_tf_Conv, followed by the bias addition along the feature
+// dimension and, when relu is set, the ReLU activation.
+XLA_API OpaqueXLATensor* XLATensor_tf_ConvBiasActivation(
+    OpaqueXLATensor* input, OpaqueXLATensor* filter, OpaqueXLATensor* bias,
+    bool depthwise, Int64ArrayRef strides, enum TFPadding padding,
+    Int64ArrayRef explicit_paddings, enum TFDataFormat data_format,
+    Int64ArrayRef dilations, bool relu);
 XLA_API OpaqueXLATensor*
 XLATensor_tf_MirrorPad(OpaqueXLATensor* input, Int64ArrayRef padding,
                        enum TFMirrorPadMode mode);
@@ -401,6 +850,13 @@ XLATensor_tf_MirrorPadGrad(OpaqueXLATensor* grad_output,
 XLA_API OpaqueXLATensor*
 XLATensor_tf_OneHot(OpaqueXLATensor* indices, OpaqueXLATensor* on_value,
                     OpaqueXLATensor* off_value, int64_t depth, int64_t axis);
+// Same as XLATensor_tf_Conv, with an int8 filter quantized per output channel
+// and the given dequantization scales.
+XLA_API OpaqueXLATensor* XLATensor_tf_QuantizedConv(
+    OpaqueXLATensor* input, OpaqueXLATensor* filter, OpaqueXLATensor* scale,
+    bool depthwise, Int64ArrayRef strides, enum TFPadding padding,
+    Int64ArrayRef explicit_paddings, enum TFDataFormat data_format,
+    Int64ArrayRef dilations);
 XLA_API OpaqueXLATensor* XLATensor_tf_StatelessRandomNormal(
     Int64ArrayRef size, OpaqueXLATensor* seeds, enum XLATensorScalarType type);
 XLA_API OpaqueXLATensor* XLATensor_tf_StatelessRandomUniform(
@@ -408,7 +864,7 @@ XLA_API OpaqueXLATensor* XLATensor_tf_StatelessRandomUniform(
     OpaqueXLATensor* maxvalue);
 XLA_API OpaqueXLATensor*
 XLATensor_tf_UnsortedSegmentSum(OpaqueXLATensor* data, OpaqueXLATensor* indices,
-                                int64_t num_segments);
+                                int64_t num_segments, bool indices_are_sorted);
 XLA_API OpaqueXLATensor* XLATensor_threshold(
     OpaqueXLATensor* input, OpaqueXLATensor* output, float threshold, float value);
 XLA_API OpaqueXLATensor* XLATensor_truncated_normal(OpaqueXLATensor* input);
@@ -432,6 +888,12 @@ XLA_API OpaqueXLATensorArrayRef XLATensor_functional_while(
     OpaqueXLATensor* n, OpaqueXLATensorArrayRef initial,
     OpaqueXLATensorArrayRef placeholders, OpaqueXLATensor* indexPlaceholder,
     OpaqueXLATensorArrayRef results);
+// Returns the results traced from the placeholders, computed by a call to the
+// outlined computation of their graph with the inputs in place of the
+// placeholders. Structurally identical graphs are lowered once.
+XLA_API OpaqueXLATensorArrayRef XLATensor_outlined_call(
+    OpaqueXLATensorArrayRef inputs, OpaqueXLATensorArrayRef placeholders,
+    OpaqueXLATensorArrayRef results);
 XLA_API OpaqueXLATensor* XLATensor_makePlaceholder(OpaqueXLATensor* t, int id);
 // Retrieves the device for a given tensor.
 XLA_API struct CDevice XLATensor_device(OpaqueXLATensor* t);
@@ -449,6 +911,37 @@ XLA_API StridedSliceSpec* ComputeIndexingBoundsAndStrides(
 
 XLA_API void PrintMetrics();
 
+// Logs the top_n slowest compilations, with the call sites which caused them.
+XLA_API void PrintCompileReport(int64_t top_n);
+
+// Logs the top_n graphs with the highest accumulated execution time, with their
+// HLO if include_hlo is set.
+XLA_API void PrintExecutionReport(int64_t top_n, bool include_hlo);
+
+// Returns the execution report of the top_n hottest graphs.
+XLA_API OpaqueString* GetExecutionReport(int64_t top_n, bool include_hlo);
+
+// Returns the top_n annotation scopes with the highest attributed device time.
+// Requires XLA_SCOPE_PROFILE.
+XLA_API OpaqueString* GetScopeReport(int64_t top_n);
+
+// Returns the top_n device memory usage entries, by device, annotation scope
+// and memory kind. Requires XLA_MEMORY_ACCOUNTING.
+XLA_API OpaqueString* GetMemoryReport(int64_t top_n);
+
+// Returns the device memory usage changes since the previous call.
+XLA_API OpaqueString* GetMemoryDiffReport();
+
+// Logs the host time breakdown of the last step, and the averages over the
+// recent steps, as accounted with XLA_STEP_PROFILE.
+XLA_API void PrintStepProfile();
+
+// Writes the runtime event trace, in the Chrome trace JSON format, to path.
+XLA_API void DumpEventTrace(const char* path);
+
+// Returns the current metrics and counters in the Prometheus text format.
+XLA_API OpaqueString* GetPrometheusMetrics();
+
 // Randomly shuffles the array defined by (data, size) by seed and then
 // returns the result.
 XLA_API void SeededRandomShuffle(size_t* data, size_t size, int64_t seed);
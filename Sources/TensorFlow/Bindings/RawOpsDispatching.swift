@@ -4489,9 +4489,7 @@ public typealias Raw = _Raw
     ) -> Tensor<T> {
       switch input.handle.backend {
       case .XLA:
-        let output_device = input.device
-        let input = Tensor<T>(copying: input, to: .defaultTFEager)
-        return Tensor<T>(copying: _RawTFEager.cholesky(input), to: output_device)
+        return _RawXLA.cholesky(input)
       case .TF_EAGER:
         return _RawTFEager.cholesky(input)
       }
@@ -17309,10 +17307,7 @@ public typealias Raw = _Raw
     ) -> Tensor<T> {
       switch input.handle.backend {
       case .XLA:
-        let output_device = input.device
-        let input = Tensor<T>(copying: input, to: .defaultTFEager)
-        return Tensor<T>(
-          copying: _RawTFEager.matrixInverse(input, adjoint: adjoint), to: output_device)
+        return _RawXLA.matrixInverse(input, adjoint: adjoint)
       case .TF_EAGER:
         return _RawTFEager.matrixInverse(input, adjoint: adjoint)
       }
@@ -17528,12 +17523,7 @@ public typealias Raw = _Raw
     ) -> Tensor<T> {
       switch commonBackend(matrix.handle.backend, rhs.handle.backend) {
       case .XLA:
-        let output_device = rhs.device
-        let matrix = Tensor<T>(copying: matrix, to: .defaultTFEager)
-        let rhs = Tensor<T>(copying: rhs, to: .defaultTFEager)
-        return Tensor<T>(
-          copying: _RawTFEager.matrixSolve(matrix: matrix, rhs: rhs, adjoint: adjoint),
-          to: output_device)
+        return _RawXLA.matrixSolve(matrix: matrix, rhs: rhs, adjoint: adjoint)
       case .TF_EAGER:
         return _RawTFEager.matrixSolve(matrix: matrix, rhs: rhs, adjoint: adjoint)
       }
@@ -17725,12 +17715,8 @@ public typealias Raw = _Raw
     ) -> Tensor<T> {
       switch commonBackend(matrix.handle.backend, rhs.handle.backend) {
       case .XLA:
-        let output_device = rhs.device
-        let matrix = Tensor<T>(copying: matrix, to: .defaultTFEager)
-        let rhs = Tensor<T>(copying: rhs, to: .defaultTFEager)
-        return Tensor<T>(
-          copying: _RawTFEager.matrixTriangularSolve(
-            matrix: matrix, rhs: rhs, lower: lower, adjoint: adjoint), to: output_device)
+        return _RawXLA.matrixTriangularSolve(
+          matrix: matrix, rhs: rhs, lower: lower, adjoint: adjoint)
       case .TF_EAGER:
         return _RawTFEager.matrixTriangularSolve(
           matrix: matrix, rhs: rhs, lower: lower, adjoint: adjoint)
@@ -170,7 +170,7 @@ X10_OPS = {
   "ConvertDataFormat4", "ConvertMirrorPadMode", "ReversedPaddings",
   "AvgPool", "AvgPool3D", "AvgPool3DGrad", "AvgPoolGrad", "BatchMatMulV2",
   "BroadcastGradientArgs", "BroadcastTo", "BroadcastTo", "Cast", "Ceil",
-  "ClipByValue", "ConcatV2", "Conv2D", "Conv2DBackpropFilter",
+  "Cholesky", "ClipByValue", "ConcatV2", "Conv2D", "Conv2DBackpropFilter",
   "Conv2DBackpropFilter", "Conv2DBackpropInput", "Conv2DBackpropInput",
   "Conv3D", "Conv3DBackpropFilterV2", "Conv3DBackpropInputV2", "Cos", "Cosh",
   "Cumprod", "Cumsum", "DepthwiseConv2dNative",
@@ -180,7 +180,8 @@ X10_OPS = {
   "InvertPermutation", "IsFinite", "IsInf", "IsNan", "LeakyRelu",
   "LeakyReluGrad", "Less", "LessEqual", "LinSpace", "LinSpace", "Log", "Log1p",
    "LogSoftmax", "LogicalAnd", "LogicalNot", "LogicalOr",
-  "MatMul", "Max", "MaxPool3D", "MaxPool3DGrad", "MaxPoolGradV2",
+  "MatMul", "MatrixInverse", "MatrixSolve", "MatrixTriangularSolve", "Max",
+  "MaxPool3D", "MaxPool3DGrad", "MaxPoolGradV2",
   "MaxPoolGradV2", "MaxPoolV2", "MaxPoolV2", "Maximum", "Mean", "Mean", "Min",
   "Minimum", "MirrorPad", "MirrorPadGrad", "Mod", "Mul", "Neg", "NotEqual",
   "OneHot", "OneHot", "OnesLike", "Pack", "Pad", "PadV2", "PhysicalCast", "Pow",
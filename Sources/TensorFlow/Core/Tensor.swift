@@ -289,6 +289,12 @@ extension Tensor {
       The shape requires \(shape.contiguousSize) scalars but \(scalars.count) were \
       provided.
       """)
+    #if USING_X10_BACKEND
+      if device.backend == .XLA {
+        self = Tensor(_xlaBorrowing: scalars, shape: shape, on: device)
+        return
+      }
+    #endif
     self = scalars.withUnsafeBufferPointer { bufferPointer in
       Tensor(shape: shape, scalars: bufferPointer, on: device)
     }
@@ -389,6 +395,36 @@ extension Tensor {
         self = .init(shape: shape, scalars: scalars, on: device)
       }
     }
+
+    /// Creates a tensor with the specified shape and contiguous scalars in row-major order, whose
+    /// upload to the device starts right away, in the background.
+    ///
+    /// This is meant to prefetch the inputs of the next training step while the current one runs:
+    /// the computations using the tensor only wait for the upload when they need it.
+    ///
+    /// - Parameters:
+    ///   - shape: The shape of the tensor.
+    ///   - scalars: The scalar contents of the tensor.
+    ///   - device: The device to upload the tensor to.
+    /// - Precondition: The product of the dimensions of the shape must equal the number of scalars.
+    public init(
+      shape: TensorShape,
+      scalars: UnsafeBufferPointer<Scalar>,
+      prefetchingOn device: Device
+    ) {
+      precondition(
+        shape.contiguousSize == scalars.count,
+        """
+        The shape requires \(shape.contiguousSize) scalars but \(scalars.count) were \
+        provided.
+        """)
+      switch device.backend {
+      case .XLA:
+        self.init(_xla: XLATensor.make(scalars, shape.dimensions, prefetchingOn: device))
+      case .TF_EAGER:
+        self = .init(shape: shape, scalars: scalars, on: device)
+      }
+    }
   #endif
 
   /// Creates a tensor with the specified shape and contiguous scalars in row-major order.
@@ -22,6 +22,9 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
   /// Computes dropout given a probability.
   @differentiable(wrt: self where Scalar: Differentiable)
   fileprivate func droppingOut(probability: Double) -> Tensor {
+    if device.backend == .XLA {
+      return _xlaFusedDropout(self, probability: probability, seed: Context.local.randomSeed)
+    }
     let noise = Tensor(randomUniform: shape, on: device)
     let keepMask = noise .>= Scalar(probability)
     let keepProbability = Scalar(1.0 - probability)
@@ -242,20 +242,12 @@ public struct LayerNorm<Scalar: TensorFlowFloatingPoint>: Layer {
   /// - Returns: The output.
   @differentiable
   public func forward(_ input: Tensor<Scalar>) -> Tensor<Scalar> {
-    // Note: `withoutDerivative(at:)` is currently needed in the following to prevent the resulting
-    // tensor for `epsilon` from being scalarized on the backwards pass, breaking X10 traces.
-    let epsilon = withoutDerivative(at: input) { Tensor(self.epsilon, deviceAndPrecisionLike: $0) }
     let positiveAxis = (input.rank + axis) % input.rank
     precondition(
       input.shape[positiveAxis] == offset.shape[0],
       "The number of features of the input and the offset doesn't match.")
-    var broadcastShape = TensorShape(Array(repeating: 1, count: input.rank))
-    broadcastShape[positiveAxis] = input.shape[positiveAxis]
-    let offset = self.offset.reshaped(to: broadcastShape)
-    let scale = self.scale.reshaped(to: broadcastShape)
-    let moments = input.moments(alongAxes: positiveAxis)
-    let inv = rsqrt(moments.variance + epsilon) * scale
-    return (input - moments.mean) * inv + offset
+    return fusedLayerNorm(
+      input, scale: scale, offset: offset, axis: positiveAxis, epsilon: Double(epsilon))
   }
 }
 
@@ -268,7 +268,12 @@ func resizeBilinear<Scalar: TensorFlowNumeric>(
   alignCorners: Bool = false,
   halfPixelCenters: Bool = false
 ) -> Tensor<Float> {
-  _Raw.resizeBilinear(
+  if images.device.backend == .XLA {
+    return _xlaResizeBilinear(
+      Tensor<Float>(images), size: size.scalars.map { Int($0) }, alignCorners: alignCorners,
+      halfPixelCenters: halfPixelCenters)
+  }
+  return _Raw.resizeBilinear(
     images: images,
     size: size,
     alignCorners: alignCorners,
@@ -293,7 +298,13 @@ func _vjpResizeBilinear<Scalar: TensorFlowFloatingPoint>(
   return (
     resized,
     { v in
-      _Raw.resizeBilinearGrad(
+      if images.device.backend == .XLA {
+        return Tensor<Scalar>(
+          _xlaResizeBilinearGrad(
+            v, imageSize: [images.shape[1], images.shape[2]], alignCorners: alignCorners,
+            halfPixelCenters: halfPixelCenters))
+      }
+      return _Raw.resizeBilinearGrad(
         grads: v,
         originalImage: images,
         alignCorners: alignCorners,
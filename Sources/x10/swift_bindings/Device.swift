@@ -166,6 +166,18 @@ public struct Device {
     return deviceListToArray(DeviceListHandle(_handle: handle))
   }
 
+  /// Compiles, in the background, the graphs replicated across `devices` for the replica set
+  /// `newDevices`. Resizing the data parallel world, like when preempted hosts leave it, changes
+  /// the replica set the steps get compiled for, so precompiling the likely next replica sets
+  /// keeps the first steps after the resize from waiting on the compiler.
+  public static func precompileForReplicationDevices(_ devices: [Device], _ newDevices: [Device]) {
+    devices.withDeviceList { deviceList in
+      newDevices.withDeviceList { newDeviceList in
+        x10_device_wrapper.precompileForReplicationDevices(&deviceList, &newDeviceList)
+      }
+    }
+  }
+
   public static func syncLiveTensorsForDevices(_ devices: [Device]) {
     devices.withDeviceList { deviceList in
       x10_device_wrapper.syncLiveTensorsForDevices(&deviceList)
@@ -241,3 +253,46 @@ public func LazyTensorBarrier(on device: Device? = nil, devices: [Device] = [],
     }
   }
 }
+
+/// A set of live tensors, random seeds and step counters of its own on every device, for the
+/// models traced and run concurrently within one process, like the ones served side by side.
+///
+/// The tensors belong to the trace context their thread was in when they got created, and
+/// `LazyTensorBarrier` only syncs the ones of the trace context of its thread. The syncs of
+/// different trace contexts do not wait on each other, even on the same device, while they share
+/// the compiled computations. Trace contexts live as long as the process.
+public struct _XLATraceContext: Equatable {
+  /// The identifier of the trace context, 0 being the one of the default trace context.
+  public let id: Int64
+
+  /// The trace context threads are in unless they enter another one.
+  public static let `default` = _XLATraceContext(id: 0)
+
+  private init(id: Int64) {
+    self.id = id
+  }
+
+  /// Creates a trace context.
+  public init() {
+    self.id = createTraceContext()
+  }
+
+  /// The trace context of the current thread.
+  public static var current: _XLATraceContext {
+    _XLATraceContext(id: getTraceContext())
+  }
+
+  /// Runs `body` within the trace context on the current thread, restoring the previous one
+  /// afterwards.
+  public func withCurrent<Result>(_ body: () throws -> Result) rethrows -> Result {
+    let previous = getTraceContext()
+    setTraceContext(id)
+    defer { setTraceContext(previous) }
+    return try body()
+  }
+
+  /// Returns the number of steps `LazyTensorBarrier` marked on `device` within the trace context.
+  public func stepCount(on device: Device) -> Int {
+    return withCurrent { Int(getStepCount(device.cdevice)) }
+  }
+}
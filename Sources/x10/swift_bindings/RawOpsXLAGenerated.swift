@@ -32,6 +32,31 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_acosh(input.xlaHandle))
   }
 
+  public static func adaptiveAvgPool2d<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    outputSize: [Int64]
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    return outputSize.withArrayRef { outputSize in
+      return Tensor(_xlaHandle: XLATensor_adaptive_avg_pool2d(input.xlaHandle, outputSize))
+    }
+  }
+
+  public static func adaptiveAvgPool2dBackward<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    gradOutput: Tensor<T>,
+    inputSize: [Int64]
+  ) -> Tensor<T> {
+    defer { _fixLifetime(gradOutput) }
+    return inputSize.withArrayRef { inputSize in
+      return Tensor(
+        _xlaHandle: XLATensor_adaptive_avg_pool2d_backward(gradOutput.xlaHandle, inputSize))
+    }
+  }
+
   public static func addV2<
     T: TensorFlowNumeric
   >(
@@ -159,6 +184,15 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_ceil(input.xlaHandle))
   }
 
+  public static func cholesky<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    return Tensor(_xlaHandle: XLATensor_cholesky(input.xlaHandle))
+  }
+
   public static func clipByValue<
     T: TensorFlowNumeric
   >(
@@ -354,6 +388,21 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_floor(input.xlaHandle))
   }
 
+  public static func fusedDropout<
+    T: FloatingPoint & TensorFlowScalar,
+    Ti: TensorFlowIndex
+  >(
+    _ input: Tensor<T>,
+    _ seeds: Tensor<Ti>,
+    probability: Float
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(seeds) }
+    checkSameDevice(input.device, seeds.device)
+    return Tensor(
+      _xlaHandle: XLATensor_fused_dropout(input.xlaHandle, seeds.xlaHandle, probability))
+  }
+
   public static func gather<
     T: TensorFlowScalar,
     Tindices: TensorFlowIndex
@@ -543,6 +592,46 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_matmul(lhs.xlaHandle, rhs.xlaHandle))
   }
 
+  public static func matrixInverse<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    adjoint: Bool
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    return Tensor(_xlaHandle: XLATensor_matrixInverse(input.xlaHandle, adjoint))
+  }
+
+  public static func matrixSolve<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    matrix: Tensor<T>,
+    rhs: Tensor<T>,
+    adjoint: Bool
+  ) -> Tensor<T> {
+    defer { _fixLifetime(matrix) }
+    defer { _fixLifetime(rhs) }
+    checkSameDevice(matrix.device, rhs.device)
+    checkSamePrecision(matrix, rhs)
+    return Tensor(_xlaHandle: XLATensor_matrixSolve(matrix.xlaHandle, rhs.xlaHandle, adjoint))
+  }
+
+  public static func matrixTriangularSolve<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    matrix: Tensor<T>,
+    rhs: Tensor<T>,
+    lower: Bool,
+    adjoint: Bool
+  ) -> Tensor<T> {
+    defer { _fixLifetime(matrix) }
+    defer { _fixLifetime(rhs) }
+    checkSameDevice(matrix.device, rhs.device)
+    checkSamePrecision(matrix, rhs)
+    return Tensor(
+      _xlaHandle: XLATensor_matrixTriangularSolve(matrix.xlaHandle, rhs.xlaHandle, lower, adjoint))
+  }
+
   public static func max<
     T: TensorFlowNumeric
   >(
@@ -617,6 +706,20 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_mm(lhs.xlaHandle, rhs.xlaHandle))
   }
 
+  public static func moments<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    reductionIndices: [Int64],
+    keepDims: Bool
+  ) -> (Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(input) }
+    return reductionIndices.withArrayRef { reductionIndices in
+      let tuple_output = XLATensor_moments(input.xlaHandle, reductionIndices, keepDims)
+      return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+    }
+  }
+
   public static func mul<
     T: TensorFlowNumeric
   >(
@@ -711,6 +814,23 @@ extension _RawXLA {
     return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
   }
 
+  static func quantized_matmul<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    _ weight: Tensor<Int8>,
+    _ scale: Tensor<T>
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(scale) }
+    checkSameDevice(input.device, weight.device)
+    checkSameDevice(input.device, scale.device)
+    checkSamePrecision(input, scale)
+    return Tensor(
+      _xlaHandle: XLATensor_quantized_matmul(input.xlaHandle, weight.xlaHandle, scale.xlaHandle))
+  }
+
   public static func relu<
     T: TensorFlowNumeric
   >(
@@ -1024,6 +1144,39 @@ extension _RawXLA {
     }
   }
 
+  static func tf_ConvBiasActivation<
+    T: TensorFlowNumeric
+  >(
+    _ input: Tensor<T>,
+    _ filter: Tensor<T>,
+    _ bias: Tensor<T>,
+    _ depthwise: Bool,
+    _ strides: [Int64],
+    _ padding: TFPadding,
+    _ explicit_paddings: [Int64],
+    _ data_format: TFDataFormat,
+    _ dilations: [Int64],
+    _ relu: Bool
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(filter) }
+    defer { _fixLifetime(bias) }
+    checkSameDevice(input.device, filter.device)
+    checkSamePrecision(input, filter)
+    checkSameDevice(input.device, bias.device)
+    checkSamePrecision(input, bias)
+    return strides.withArrayRef { strides in
+      return explicit_paddings.withArrayRef { explicit_paddings in
+        return dilations.withArrayRef { dilations in
+          return Tensor(
+            _xlaHandle: XLATensor_tf_ConvBiasActivation(
+              input.xlaHandle, filter.xlaHandle, bias.xlaHandle, depthwise, strides, padding,
+              explicit_paddings, data_format, dilations, relu))
+        }
+      }
+    }
+  }
+
   static func tf_MirrorPad<
     T: TensorFlowScalar
   >(
@@ -1074,6 +1227,37 @@ extension _RawXLA {
         indices.xlaHandle, onValue.xlaHandle, offValue.xlaHandle, depth, axis))
   }
 
+  static func tf_QuantizedConv<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    _ filter: Tensor<Int8>,
+    _ scale: Tensor<T>,
+    _ depthwise: Bool,
+    _ strides: [Int64],
+    _ padding: TFPadding,
+    _ explicit_paddings: [Int64],
+    _ data_format: TFDataFormat,
+    _ dilations: [Int64]
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(filter) }
+    defer { _fixLifetime(scale) }
+    checkSameDevice(input.device, filter.device)
+    checkSameDevice(input.device, scale.device)
+    checkSamePrecision(input, scale)
+    return strides.withArrayRef { strides in
+      return explicit_paddings.withArrayRef { explicit_paddings in
+        return dilations.withArrayRef { dilations in
+          return Tensor(
+            _xlaHandle: XLATensor_tf_QuantizedConv(
+              input.xlaHandle, filter.xlaHandle, scale.xlaHandle, depthwise, strides, padding,
+              explicit_paddings, data_format, dilations))
+        }
+      }
+    }
+  }
+
   static func tf_StatelessRandomNormal<
     T: TensorFlowScalar,
     Ti: TensorFlowIndex
@@ -1115,13 +1299,15 @@ extension _RawXLA {
   >(
     _ data: Tensor<T>,
     indicies: Tensor<Ti>,
-    numSegments: Int64
+    numSegments: Int64,
+    indicesAreSorted: Bool
   ) -> Tensor<T> {
     defer { _fixLifetime(data) }
     defer { _fixLifetime(indicies) }
     checkSameDevice(data.device, indicies.device)
     return Tensor(
-      _xlaHandle: XLATensor_tf_UnsortedSegmentSum(data.xlaHandle, indicies.xlaHandle, numSegments))
+      _xlaHandle: XLATensor_tf_UnsortedSegmentSum(
+        data.xlaHandle, indicies.xlaHandle, numSegments, indicesAreSorted))
   }
 
   static func threshold<
@@ -79,6 +79,12 @@ extension Tensor {
     self.init(_xla: XLATensor(_handle: _xlaHandle))
   }
 
+  /// Creates an X10 tensor which shares the storage of `scalars` instead of copying it.
+  @usableFromInline
+  init(_xlaBorrowing scalars: [Scalar], shape: TensorShape, on device: Device) {
+    self.init(_xla: XLATensor.make(borrowing: scalars, shape.dimensions, on: device))
+  }
+
   var xlaHandle: UnsafeMutablePointer<OpaqueXLATensor> { return xlaTensor.handle }
 
   var xlaTensor: XLATensor {
@@ -89,12 +95,38 @@ extension Tensor {
   }
 }
 
+/// Keeps the storage of a borrowed array alive until X10 releases it.
+private final class BorrowedArrayStorage<Scalar> {
+  let array: [Scalar]
+
+  init(_ array: [Scalar]) { self.array = array }
+}
+
 extension XLATensor {
-  /// TODO(parkers): Add support for other types and aliasing.
   static func make<Scalar: XLAScalarType>(
     _ data: [Scalar], _ dims: [Int], on device: Device = Device.default
   ) -> XLATensor {
-    data.withUnsafeBufferPointer { data in return make(data, dims, on: device) }
+    make(borrowing: data, dims, on: device)
+  }
+
+  /// Returns a tensor which borrows the storage of `data` rather than copying it on the host. The
+  /// storage is retained, and so stays immutable, until X10 no longer needs it.
+  static func make<Scalar: XLAScalarType>(
+    borrowing data: [Scalar], _ dims: [Int], on device: Device = Device.default
+  ) -> XLATensor {
+    if data.isEmpty {
+      return data.withUnsafeBufferPointer { data in make(data, dims, on: device) }
+    }
+    let storage = Unmanaged.passRetained(BorrowedArrayStorage(data))
+    return storage.takeUnretainedValue().array.withUnsafeBufferPointer { data in
+      dims.withUnsafeBufferPointer { dims in
+        XLATensor(
+          _handle: borrowTensor(
+            Scalar.xlaTensorScalarType, data.baseAddress, data.count, dims.baseAddress,
+            dims.count, device.cdevice,
+            { Unmanaged<AnyObject>.fromOpaque($0!).release() }, storage.toOpaque()))
+      }
+    }
   }
 
   static func make<Scalar: XLAScalarType>(_ data: Scalar, on device: Device = Device.default)
@@ -119,6 +151,19 @@ extension XLATensor {
     }
   }
 
+  static func make<Scalar: XLAScalarType>(
+    _ data: UnsafeBufferPointer<Scalar>, _ dims: [Int], prefetchingOn device: Device
+  ) -> XLATensor {
+    dims.withUnsafeBufferPointer { dims in
+      return XLATensor(
+        _handle:
+          copyTensorAndPrefetch(
+            Scalar.xlaTensorScalarType, data.baseAddress, data.count, dims.baseAddress, dims.count,
+            device.cdevice
+          ))
+    }
+  }
+
   static func make<Scalar: XLAScalarType>(
     _ data: [Scalar], _ dims: [Int], toReducedPrecision: Bool,
     directlyOn device: Device = Device.default
@@ -171,6 +216,34 @@ extension XLATensor {
     return (data: data, dims: dims)
   }
 
+  /// Returns the values of every tensor in `tensors`, running the pending computations they depend
+  /// on with a single sync rather than one sync per tensor.
+  static func fetchTensorValues<Scalar: XLAScalarType>(
+    _ tensors: [XLATensor], _ t: Scalar.Type
+  ) -> [[Scalar]] {
+    var materialized = [UnsafeMutablePointer<OpaqueMaterializedTensor>?](
+      repeating: nil, count: tensors.count)
+    materialized.withUnsafeMutableBufferPointer { results in
+      tensors.withArrayRef { tensors in
+        XLATensor_materialize_many(tensors.data, tensors.size, results.baseAddress)
+      }
+    }
+    defer {
+      materialized.withUnsafeBufferPointer { results in
+        destroyMaterializedTensors(results.baseAddress, results.count)
+      }
+    }
+    return zip(tensors, materialized).map { tensor, materialized in
+      precondition(
+        MaterializedTensor_getType(materialized) == Scalar.xlaTensorScalarType,
+        "Types mismatch when fetching tensor values.")
+      return Array(
+        UnsafeBufferPointer(
+          start: UnsafePointer<Scalar>(OpaquePointer(MaterializedTensor_getData(materialized))),
+          count: tensor.shape.reduce(1, *)))
+    }
+  }
+
   var dtype: XLATensorScalarType {
     defer { _fixLifetime(self) }
     return XLATensor_dtype(handle)
@@ -209,6 +282,101 @@ extension Array where Element: AnyTensor {
   }
 }
 
+extension Array {
+  /// Returns the scalars of every tensor. The X10 tensors are all fetched with a single sync of
+  /// their pending computations, instead of the one sync per tensor `scalars` would cost.
+  public func _xlaScalars<Scalar: TensorFlowScalar>() -> [[Scalar]]
+  where Element == Tensor<Scalar> {
+    let xlaIndices = indices.filter { self[$0].handle.backend == .XLA }
+    let xlaValues = XLATensor.fetchTensorValues(xlaIndices.map { self[$0].xlaTensor }, Scalar.self)
+    var result = map { $0.handle.backend == .XLA ? [] : $0.scalars }
+    for (index, values) in zip(xlaIndices, xlaValues) {
+      result[index] = values
+    }
+    return result
+  }
+}
+
+/// The scalars of a tensor whose pending computation has been scheduled but not waited for.
+public final class _XLAPendingScalars<Scalar: TensorFlowScalar> {
+  private var future: UnsafeMutablePointer<OpaqueMaterializedTensorFuture>?
+  private var value: [Scalar]?
+  private let count: Int
+
+  init(_ scalars: [Scalar]) {
+    self.value = scalars
+    self.count = scalars.count
+  }
+
+  init(_ tensor: XLATensor) {
+    defer { _fixLifetime(tensor) }
+    self.future = XLATensor_materialize_async(tensor.handle)
+    self.count = tensor.shape.reduce(1, *)
+  }
+
+  deinit {
+    if let future = future { destroyMaterializedTensorFuture(future) }
+  }
+
+  /// Whether `wait()` would return without blocking.
+  public var isReady: Bool {
+    guard let future = future else { return true }
+    return MaterializedTensorFuture_isReady(future)
+  }
+
+  /// Blocks until the scalars have been fetched from the device, and returns them.
+  public func wait() -> [Scalar] {
+    if let value = value { return value }
+    let materialized = MaterializedTensorFuture_wait(future)!
+    defer { destroyMaterializedTensor(materialized) }
+    precondition(
+      MaterializedTensor_getType(materialized) == Scalar.xlaTensorScalarType,
+      "Types mismatch when fetching tensor values.")
+    let scalars = Array(
+      UnsafeBufferPointer(
+        start: UnsafePointer<Scalar>(OpaquePointer(MaterializedTensor_getData(materialized))),
+        count: count))
+    destroyMaterializedTensorFuture(future)
+    future = nil
+    value = scalars
+    return scalars
+  }
+}
+
+/// A checkpoint being written in the background, see `_RawXLA.saveTensors`.
+public final class _XLAAsyncCheckpoint {
+  private let handle: UnsafeMutablePointer<XLAAsyncCheckpoint>
+
+  init(_ handle: UnsafeMutablePointer<XLAAsyncCheckpoint>) {
+    self.handle = handle
+  }
+
+  deinit {
+    destroyAsyncCheckpoint(handle)
+  }
+
+  /// The byte offsets in the file of the saved tensors, to pass to `_RawXLA.loadTensors`.
+  public var offsets: [Int] {
+    var count = 0
+    let offsets = AsyncCheckpoint_offsets(handle, &count)
+    return Array(UnsafeBufferPointer(start: offsets, count: count))
+  }
+
+  /// Blocks until the file has been written.
+  public func wait() {
+    AsyncCheckpoint_wait(handle)
+  }
+}
+
+extension Tensor {
+  /// Starts fetching the scalars of the tensor and returns without waiting for its pending X10
+  /// computation, so that host work can overlap with the device running it.
+  public func _xlaScalarsAsync() -> _XLAPendingScalars<Scalar> {
+    guard handle.backend == .XLA else { return _XLAPendingScalars(scalars) }
+    return _XLAPendingScalars(xlaTensor)
+  }
+}
+
 extension Array where Element == PaddingConfigDimension {
   func withArrayRef<Result>(_ body: (inout PaddingConfig) -> Result) -> Result {
     defer { _fixLifetime(self) }
@@ -241,6 +409,627 @@ extension Tensor {
   }
 }
 
+/// Returns `body(input)`, without keeping the intermediate values computed by `body` live until
+/// the backward pass, which recomputes them instead. This trades compute for activation memory,
+/// and only has an effect on X10 devices.
+@differentiable(wrt: input)
+public func withRematerialization<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, _ body: @differentiable (Tensor<Scalar>) -> Tensor<Scalar>
+) -> Tensor<Scalar> {
+  return body(input)
+}
+
+@derivative(of: withRematerialization, wrt: input)
+func _vjpWithRematerialization<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, _ body: @differentiable (Tensor<Scalar>) -> Tensor<Scalar>
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
+  guard input.device.backend == .XLA else {
+    return valueWithPullback(at: input, in: body)
+  }
+  let scope = MakeRematerializationScope()
+  let (value, pullback) = valueWithPullback(at: input, in: body)
+  [value].withArrayRef { DestroyRematerializationScope(scope, $0) }
+  return (value, pullback)
+}
+
+/// Returns `body()`, with the NHWC and NCHW convolutions and poolings it traces on X10 devices
+/// running in `dataFormat`. The ops in the other format transpose their input and output, and the
+/// transposes of successive ops cancel out, so the activations between them stay in `dataFormat`.
+/// `XLA_PREFERRED_DATA_FORMAT` sets the format for the whole process instead.
+public func withPreferredDataFormat<Result>(
+  _ dataFormat: _RawXLA.DataFormat, _ body: () throws -> Result
+) rethrows -> Result {
+  let scope = MakeDataFormatScope(dataFormat == .nhwc ? TFDataFormat_NHWC : TFDataFormat_NCHW)
+  defer { DestroyDataFormatScope(scope) }
+  return try body()
+}
+
+/// Returns `input` with each element zeroed out with `probability`, and the others scaled by
+/// `1 / (1 - probability)`. The mask is drawn from `seed` in the same kernel as the scaling, and
+/// the backward pass draws it again from `seed` rather than keeping it live until then.
+@differentiable(wrt: input)
+public func _xlaFusedDropout<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, probability: Double, seed: TensorFlowSeed
+) -> Tensor<Scalar> {
+  let seeds = Tensor<Int32>([seed.graph, seed.op], on: input.device)
+  return _RawXLA.fusedDropout(input, seeds, probability: Float(probability))
+}
+
+@derivative(of: _xlaFusedDropout, wrt: input)
+func _vjpXLAFusedDropout<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, probability: Double, seed: TensorFlowSeed
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
+  // The dropout is linear in its input, and the gradient has the shape of the input, so it gets
+  // the same mask.
+  return (
+    _xlaFusedDropout(input, probability: probability, seed: seed),
+    { _xlaFusedDropout($0, probability: probability, seed: seed) }
+  )
+}
+
+/// Returns `softmax(query • keyᵀ * scale) • value` over the last two dimensions.
+///
+/// On X10 devices this is a single fused operation which processes the keys in blocks of
+/// `blockSize` rows and never materializes the full attention matrix. When `causal` is true, query
+/// row `i` only attends to key rows `j <= i`. `scale` defaults to `1 / sqrt(depth)`.
+@differentiable(wrt: (query, key, value))
+public func scaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  query: Tensor<Scalar>, key: Tensor<Scalar>, value: Tensor<Scalar>, scale: Double? = nil,
+  causal: Bool = false, blockSize: Int = 128
+) -> Tensor<Scalar> {
+  let scale = scale ?? 1 / Double(query.shape[query.rank - 1]).squareRoot()
+  return _scaledDotProductAttentionReference(query, key, value, scale: scale, causal: causal)
+}
+
+/// The unfused attention, used off X10 devices.
+@differentiable(wrt: (query, key, value))
+func _scaledDotProductAttentionReference<Scalar: TensorFlowFloatingPoint>(
+  _ query: Tensor<Scalar>, _ key: Tensor<Scalar>, _ value: Tensor<Scalar>, scale: Double,
+  causal: Bool
+) -> Tensor<Scalar> {
+  var scores = matmul(query, key, transposed: true) * Scalar(scale)
+  if causal {
+    let rows = query.shape[query.rank - 2]
+    let columns = key.shape[key.rank - 2]
+    let mask = Tensor<Scalar>(ones: [rows, columns], on: query.device)
+      .bandPart(subdiagonalCount: -1, superdiagonalCount: 0)
+    scores = scores.replacing(
+      with: Tensor(repeating: -Scalar.greatestFiniteMagnitude, shape: scores.shape,
+        on: query.device),
+      where: withoutDerivative(at: mask.broadcasted(like: scores) .== 0))
+  }
+  return matmul(softmax(scores), value)
+}
+
+@derivative(of: scaledDotProductAttention, wrt: (query, key, value))
+func _vjpScaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  query: Tensor<Scalar>, key: Tensor<Scalar>, value: Tensor<Scalar>, scale: Double?,
+  causal: Bool, blockSize: Int
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let scale = scale ?? 1 / Double(query.shape[query.rank - 1]).squareRoot()
+  guard query.device.backend == .XLA else {
+    return valueWithPullback(at: query, key, value) {
+      _scaledDotProductAttentionReference($0, $1, $2, scale: scale, causal: causal)
+    }
+  }
+  let outputs = XLATensor_scaled_dot_product_attention(
+    query.xlaHandle, key.xlaHandle, value.xlaHandle, scale, causal, Int64(blockSize), nil)
+  let output = Tensor<Scalar>(_xlaHandle: outputs.x)
+  let logsumexp = Tensor<Float>(_xlaHandle: outputs.y)
+  return (
+    output,
+    { v in
+      defer { _fixLifetime(v) }
+      let grads = XLATensor_scaled_dot_product_attention_backward(
+        v.xlaHandle, query.xlaHandle, key.xlaHandle, value.xlaHandle, output.xlaHandle,
+        logsumexp.xlaHandle, scale, causal, Int64(blockSize))
+      return (
+        Tensor(_xlaHandle: grads.v0), Tensor(_xlaHandle: grads.v1), Tensor(_xlaHandle: grads.v2)
+      )
+    }
+  )
+}
+
+/// Returns the batch normalization of `input` along `axis`, with the statistics of the batch:
+///
+///     output = (input - mean) * rsqrt(variance + epsilon) * scale + offset
+///
+/// followed by the ReLU activation when `relu` is true. On X10 devices the statistics are computed
+/// in a single pass, in `Float` for reduced precision inputs, and with `crossReplica` they cover
+/// the batches of all the replicas, as one all-reduce.
+@differentiable(wrt: (input, scale, offset))
+public func fusedBatchNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, offset: Tensor<Scalar>, axis: Int = -1,
+  epsilon: Double = 0.001, relu: Bool = false, crossReplica: Bool = false
+) -> Tensor<Scalar> {
+  return _fusedBatchNormReference(
+    input, residual: nil, scale: scale, offset: offset, axis: axis, epsilon: epsilon, relu: relu)
+}
+
+/// Same as `fusedBatchNorm(_:scale:offset:axis:epsilon:relu:crossReplica:)`, with `residual` added
+/// to the normalized input before the activation.
+@differentiable(wrt: (input, residual, scale, offset))
+public func fusedBatchNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, adding residual: Tensor<Scalar>, scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>, axis: Int = -1, epsilon: Double = 0.001, relu: Bool = false,
+  crossReplica: Bool = false
+) -> Tensor<Scalar> {
+  return _fusedBatchNormReference(
+    input, residual: residual, scale: scale, offset: offset, axis: axis, epsilon: epsilon,
+    relu: relu)
+}
+
+/// The unfused batch normalization, used off X10 devices.
+@differentiable(wrt: (input, scale, offset))
+func _fusedBatchNormReference<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, residual: Tensor<Scalar>?, scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>, axis: Int, epsilon: Double, relu: Bool
+) -> Tensor<Scalar> {
+  let positiveAxis = (input.rank + axis) % input.rank
+  var featureShape = TensorShape([Int](repeating: 1, count: input.rank))
+  featureShape[positiveAxis] = input.shape[positiveAxis]
+  let reductionAxes = Array(0..<input.rank).filter { $0 != positiveAxis }
+  let moments = input.moments(alongAxes: reductionAxes)
+  let inv = rsqrt(moments.variance + Scalar(epsilon)) * scale.reshaped(to: featureShape)
+  var output = (input - moments.mean) * inv + offset.reshaped(to: featureShape)
+  if let residual = residual {
+    output = output + residual
+  }
+  return relu ? TensorFlow.relu(output) : output
+}
+
+@derivative(of: fusedBatchNorm, wrt: (input, scale, offset))
+func _vjpFusedBatchNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, offset: Tensor<Scalar>, axis: Int,
+  epsilon: Double, relu: Bool, crossReplica: Bool
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let (output, pullback) = _fusedBatchNormWithPullback(
+    input, residual: nil, scale: scale, offset: offset, axis: axis, epsilon: epsilon, relu: relu,
+    crossReplica: crossReplica)
+  return (output, { v in
+    let grads = pullback(v)
+    return (grads.input, grads.scale, grads.offset)
+  })
+}
+
+@derivative(of: fusedBatchNorm, wrt: (input, residual, scale, offset))
+func _vjpFusedBatchNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, adding residual: Tensor<Scalar>, scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>, axis: Int, epsilon: Double, relu: Bool, crossReplica: Bool
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let (output, pullback) = _fusedBatchNormWithPullback(
+    input, residual: residual, scale: scale, offset: offset, axis: axis, epsilon: epsilon,
+    relu: relu, crossReplica: crossReplica)
+  return (output, { v in
+    let grads = pullback(v)
+    return (grads.input, grads.residual, grads.scale, grads.offset)
+  })
+}
+
+func _fusedBatchNormWithPullback<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, residual: Tensor<Scalar>?, scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>, axis: Int, epsilon: Double, relu: Bool, crossReplica: Bool
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (
+    input: Tensor<Scalar>, residual: Tensor<Scalar>, scale: Tensor<Scalar>,
+    offset: Tensor<Scalar>
+  )
+) {
+  guard input.device.backend == .XLA else {
+    let (output, pullback) = valueWithPullback(at: input, scale, offset) {
+      _fusedBatchNormReference(
+        $0, residual: residual, scale: $1, offset: $2, axis: axis, epsilon: epsilon, relu: relu)
+    }
+    let activated = withoutDerivative(at: output)
+    return (output, { v in
+      let grads = pullback(v)
+      let residualGrad = relu ? v.replacing(with: Tensor(zerosLike: v), where: activated .<= 0) : v
+      return (grads.0, residualGrad, grads.1, grads.2)
+    })
+  }
+  defer { _fixLifetime(residual) }
+  let outputs = XLATensor_fused_batch_norm(
+    input.xlaHandle, scale.xlaHandle, offset.xlaHandle, residual?.xlaHandle, epsilon,
+    Int64(axis), relu, crossReplica)
+  let output = Tensor<Scalar>(_xlaHandle: outputs.v0)
+  let mean = Tensor<Float>(_xlaHandle: outputs.v1)
+  let variance = Tensor<Float>(_xlaHandle: outputs.v2)
+  return (
+    output,
+    { v in
+      defer { _fixLifetime(v) }
+      let tensorListHandle = XLATensor_fused_batch_norm_backward(
+        v.xlaHandle, input.xlaHandle, scale.xlaHandle, mean.xlaHandle, variance.xlaHandle,
+        output.xlaHandle, epsilon, Int64(axis), relu, crossReplica)
+      defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+      let grads = (0..<4).map { Tensor<Scalar>(_xlaHandle: tensorListHandle.data[$0]!) }
+      return (grads[0], grads[3], grads[1], grads[2])
+    }
+  )
+}
+
+/// Returns the layer normalization of `input` along `axis`, with the 1-D `scale` and `offset` of
+/// the size of this axis:
+///
+///     output = (input - mean) * rsqrt(variance + epsilon) * scale + offset
+///
+/// On X10 devices the mean and the variance are computed in a single pass, in `Float` for reduced
+/// precision inputs.
+@differentiable(wrt: (input, scale, offset))
+public func fusedLayerNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, offset: Tensor<Scalar>, axis: Int = -1,
+  epsilon: Double = 0.001
+) -> Tensor<Scalar> {
+  guard input.device.backend == .XLA else {
+    return _fusedLayerNormReference(
+      input, scale: scale, offset: offset, axis: axis, epsilon: epsilon)
+  }
+  let outputs = XLATensor_layer_norm(
+    input.xlaHandle, scale.xlaHandle, offset.xlaHandle, Int64(axis), epsilon)
+  defer {
+    destroyTensor(outputs.v1)
+    destroyTensor(outputs.v2)
+  }
+  return Tensor(_xlaHandle: outputs.v0)
+}
+
+/// The unfused layer normalization, used off X10 devices.
+@differentiable(wrt: (input, scale, offset))
+func _fusedLayerNormReference<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, offset: Tensor<Scalar>, axis: Int,
+  epsilon: Double
+) -> Tensor<Scalar> {
+  let positiveAxis = (input.rank + axis) % input.rank
+  var featureShape = TensorShape([Int](repeating: 1, count: input.rank))
+  featureShape[positiveAxis] = input.shape[positiveAxis]
+  let moments = input.moments(alongAxes: positiveAxis)
+  let inv = rsqrt(moments.variance + Scalar(epsilon)) * scale.reshaped(to: featureShape)
+  return (input - moments.mean) * inv + offset.reshaped(to: featureShape)
+}
+
+@derivative(of: fusedLayerNorm, wrt: (input, scale, offset))
+func _vjpFusedLayerNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, offset: Tensor<Scalar>, axis: Int,
+  epsilon: Double
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  guard input.device.backend == .XLA else {
+    return valueWithPullback(at: input, scale, offset) {
+      _fusedLayerNormReference($0, scale: $1, offset: $2, axis: axis, epsilon: epsilon)
+    }
+  }
+  let outputs = XLATensor_layer_norm(
+    input.xlaHandle, scale.xlaHandle, offset.xlaHandle, Int64(axis), epsilon)
+  let mean = Tensor<Float>(_xlaHandle: outputs.v1)
+  let variance = Tensor<Float>(_xlaHandle: outputs.v2)
+  return (
+    Tensor(_xlaHandle: outputs.v0),
+    { v in
+      defer { _fixLifetime(v) }
+      let grads = XLATensor_layer_norm_backward(
+        v.xlaHandle, input.xlaHandle, scale.xlaHandle, mean.xlaHandle, variance.xlaHandle,
+        Int64(axis), epsilon)
+      return (
+        Tensor(_xlaHandle: grads.v0), Tensor(_xlaHandle: grads.v1), Tensor(_xlaHandle: grads.v2)
+      )
+    }
+  )
+}
+
+/// Returns the root mean square normalization of `input` along `axis`, with the 1-D `scale` of
+/// the size of this axis:
+///
+///     output = input * rsqrt(mean(input * input) + epsilon) * scale
+///
+/// On X10 devices the statistics are computed in `Float` for reduced precision inputs.
+@differentiable(wrt: (input, scale))
+public func fusedRMSNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, axis: Int = -1, epsilon: Double = 1e-6
+) -> Tensor<Scalar> {
+  guard input.device.backend == .XLA else {
+    return _fusedRMSNormReference(input, scale: scale, axis: axis, epsilon: epsilon)
+  }
+  let outputs = XLATensor_rms_norm(input.xlaHandle, scale.xlaHandle, Int64(axis), epsilon)
+  defer { destroyTensor(outputs.y) }
+  return Tensor(_xlaHandle: outputs.x)
+}
+
+/// The unfused root mean square normalization, used off X10 devices.
+@differentiable(wrt: (input, scale))
+func _fusedRMSNormReference<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, axis: Int, epsilon: Double
+) -> Tensor<Scalar> {
+  let positiveAxis = (input.rank + axis) % input.rank
+  var featureShape = TensorShape([Int](repeating: 1, count: input.rank))
+  featureShape[positiveAxis] = input.shape[positiveAxis]
+  let meanSquare = (input * input).mean(alongAxes: positiveAxis)
+  return input * rsqrt(meanSquare + Scalar(epsilon)) * scale.reshaped(to: featureShape)
+}
+
+@derivative(of: fusedRMSNorm, wrt: (input, scale))
+func _vjpFusedRMSNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, scale: Tensor<Scalar>, axis: Int, epsilon: Double
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>)) {
+  guard input.device.backend == .XLA else {
+    return valueWithPullback(at: input, scale) {
+      _fusedRMSNormReference($0, scale: $1, axis: axis, epsilon: epsilon)
+    }
+  }
+  let outputs = XLATensor_rms_norm(input.xlaHandle, scale.xlaHandle, Int64(axis), epsilon)
+  let invRMS = Tensor<Float>(_xlaHandle: outputs.y)
+  return (
+    Tensor(_xlaHandle: outputs.x),
+    { v in
+      defer { _fixLifetime(v) }
+      let grads = XLATensor_rms_norm_backward(
+        v.xlaHandle, input.xlaHandle, scale.xlaHandle, invRMS.xlaHandle, Int64(axis))
+      return (Tensor(_xlaHandle: grads.x), Tensor(_xlaHandle: grads.y))
+    }
+  )
+}
+
+/// Returns the adaptive average pooling of the `[batch, channels, height, width]` `input` to
+/// `outputSize`. Along a dimension of size `n` pooled to size `m`, the window of the output
+/// position `j` spans `(j * n / m)..<ceil((j + 1) * n / m)`.
+///
+/// On X10 devices the sizes which do not divide evenly are pooled with a matmul by an averaging
+/// matrix along each spatial dimension, instead of a pooling per output position.
+@differentiable(wrt: input)
+public func adaptiveAvgPool2D<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, outputSize: (height: Int, width: Int)
+) -> Tensor<Scalar> {
+  precondition(input.rank == 4, "The rank of the input must be 4.")
+  guard input.device.backend == .XLA else {
+    return _adaptiveAvgPool2DReference(input, outputSize: outputSize)
+  }
+  return _RawXLA.adaptiveAvgPool2d(
+    input, outputSize: [Int64(outputSize.height), Int64(outputSize.width)])
+}
+
+/// The adaptive average pooling as two matmuls, used off X10 devices.
+@differentiable(wrt: input)
+func _adaptiveAvgPool2DReference<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, outputSize: (height: Int, width: Int)
+) -> Tensor<Scalar> {
+  let (batch, channels) = (input.shape[0], input.shape[1])
+  let (height, width) = (input.shape[2], input.shape[3])
+  let pooledWidth = matmul(
+    input.reshaped(to: [batch * channels * height, width]),
+    _adaptiveAvgPoolMatrix(width, outputSize.width, on: input.device))
+  let pooled = matmul(
+    pooledWidth.reshaped(to: [batch * channels, height, outputSize.width])
+      .transposed(permutation: 0, 2, 1)
+      .reshaped(to: [batch * channels * outputSize.width, height]),
+    _adaptiveAvgPoolMatrix(height, outputSize.height, on: input.device))
+  return pooled.reshaped(to: [batch, channels, outputSize.width, outputSize.height])
+    .transposed(permutation: 0, 1, 3, 2)
+}
+
+/// The `[inputSize, outputSize]` matrix averaging the adaptive pooling windows of a dimension.
+func _adaptiveAvgPoolMatrix<Scalar: TensorFlowFloatingPoint>(
+  _ inputSize: Int, _ outputSize: Int, on device: Device
+) -> Tensor<Scalar> {
+  var weights = [Scalar](repeating: 0, count: inputSize * outputSize)
+  for j in 0..<outputSize {
+    let start = j * inputSize / outputSize
+    let end = ((j + 1) * inputSize + outputSize - 1) / outputSize
+    for i in start..<end {
+      weights[i * outputSize + j] = 1 / Scalar(end - start)
+    }
+  }
+  return Tensor(shape: [inputSize, outputSize], scalars: weights, on: device)
+}
+
+@derivative(of: adaptiveAvgPool2D, wrt: input)
+func _vjpAdaptiveAvgPool2D<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>, outputSize: (height: Int, width: Int)
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
+  guard input.device.backend == .XLA else {
+    return valueWithPullback(at: input) {
+      _adaptiveAvgPool2DReference($0, outputSize: outputSize)
+    }
+  }
+  let inputSize = input.shape.dimensions.map { Int64($0) }
+  return (
+    adaptiveAvgPool2D(input, outputSize: outputSize),
+    { v in _RawXLA.adaptiveAvgPool2dBackward(gradOutput: v, inputSize: inputSize) }
+  )
+}
+
+/// How `embeddingBag` pools the rows of a bag.
+public enum EmbeddingBagMode {
+  case sum
+  case mean
+  case max
+
+  var xlaMode: XLAEmbeddingBagMode {
+    switch self {
+    case .sum: return XLAEmbeddingBagMode_SUM
+    case .mean: return XLAEmbeddingBagMode_MEAN
+    case .max: return XLAEmbeddingBagMode_MAX
+    }
+  }
+}
+
+/// Returns the `table` rows picked by every row of the `[batch, bagSize]` `indices`, pooled into a
+/// single row per bag, for a `[batch, embeddingSize]` result. Negative indices are padding, and
+/// empty bags pool to zero. When set, `perSampleWeights` scale the picked rows before the pooling.
+///
+/// On X10 devices the gather and the pooling are a single operation, whose table gradient sums
+/// the rows of the repeated indices before scattering them.
+@differentiable(wrt: table)
+public func embeddingBag<Scalar: TensorFlowFloatingPoint>(
+  _ table: Tensor<Scalar>, indices: Tensor<Int32>, perSampleWeights: Tensor<Scalar>? = nil,
+  mode: EmbeddingBagMode = .sum
+) -> Tensor<Scalar> {
+  return _embeddingBagReference(
+    table, indices: indices, perSampleWeights: perSampleWeights, mode: mode)
+}
+
+/// The unfused embedding bag, used off X10 devices.
+@differentiable(wrt: table)
+func _embeddingBagReference<Scalar: TensorFlowFloatingPoint>(
+  _ table: Tensor<Scalar>, indices: Tensor<Int32>, perSampleWeights: Tensor<Scalar>?,
+  mode: EmbeddingBagMode
+) -> Tensor<Scalar> {
+  let valid = indices .>= 0
+  var rows = table.gathering(
+    atIndices: indices.replacing(with: Tensor(zerosLike: indices), where: indices .< 0))
+  if let perSampleWeights = perSampleWeights {
+    rows = rows * perSampleWeights.expandingShape(at: 2)
+  }
+  let mask = Tensor<Scalar>(valid).expandingShape(at: 2)
+  let counts = Tensor<Scalar>(valid).sum(squeezingAxes: 1).expandingShape(at: 1)
+  switch mode {
+  case .sum:
+    return (rows * mask).sum(squeezingAxes: 1)
+  case .mean:
+    return (rows * mask).sum(squeezingAxes: 1) / max(counts, 1)
+  case .max:
+    let lowest = Tensor(
+      repeating: -Scalar.greatestFiniteMagnitude, shape: rows.shape, on: table.device)
+    let padding = withoutDerivative(at: mask.broadcasted(like: rows) .== 0)
+    return rows.replacing(with: lowest, where: padding).max(squeezingAxes: 1)
+      * Tensor<Scalar>(counts .> 0)
+  }
+}
+
+@derivative(of: embeddingBag, wrt: table)
+func _vjpEmbeddingBag<Scalar: TensorFlowFloatingPoint>(
+  _ table: Tensor<Scalar>, indices: Tensor<Int32>, perSampleWeights: Tensor<Scalar>?,
+  mode: EmbeddingBagMode
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
+  guard table.device.backend == .XLA else {
+    return valueWithPullback(at: table) {
+      _embeddingBagReference($0, indices: indices, perSampleWeights: perSampleWeights, mode: mode)
+    }
+  }
+  defer { _fixLifetime(indices) }
+  defer { _fixLifetime(perSampleWeights) }
+  let output = Tensor<Scalar>(
+    _xlaHandle: XLATensor_embedding_bag(
+      table.xlaHandle, indices.xlaHandle, perSampleWeights?.xlaHandle, mode.xlaMode))
+  return (
+    output,
+    { v in
+      defer { _fixLifetime(v) }
+      defer { _fixLifetime(indices) }
+      defer { _fixLifetime(perSampleWeights) }
+      return Tensor(
+        _xlaHandle: XLATensor_embedding_bag_backward(
+          v.xlaHandle, table.xlaHandle, indices.xlaHandle, output.xlaHandle,
+          perSampleWeights?.xlaHandle, mode.xlaMode))
+    }
+  )
+}
+
+/// Returns the indices of the `[numBoxes, 4]` `boxes` kept by greedy non-maximum suppression, in
+/// decreasing `scores` order, and their number. At most `maxOutputSize` boxes are kept, and the
+/// selected indices past that number are zero. Boxes with a score no higher than `scoreThreshold`,
+/// or with an intersection over union higher than `iouThreshold` with a kept box, are suppressed.
+///
+/// With `[batch, numBoxes, 4]` boxes and `[batch, numBoxes]` scores, every batch entry is
+/// suppressed independently, for `[batch, maxOutputSize]` indices and `[batch]` counts. On X10
+/// devices the boxes are processed in blocks of `tileSize`, so memory grows linearly with the
+/// number of boxes instead of quadratically.
+public func nonMaxSuppression<Scalar: TensorFlowFloatingPoint>(
+  boxes: Tensor<Scalar>, scores: Tensor<Scalar>, maxOutputSize: Int, iouThreshold: Float = 0.5,
+  scoreThreshold: Float = -Float.infinity, tileSize: Int = 512
+) -> (selectedIndices: Tensor<Int32>, validCount: Tensor<Int32>) {
+  guard boxes.device.backend == .XLA else {
+    guard boxes.rank == 3 else {
+      let result = _Raw.nonMaxSuppressionV4(
+        boxes: boxes, scores: scores, maxOutputSize: Tensor(Int32(maxOutputSize)),
+        iouThreshold: Tensor(iouThreshold), scoreThreshold: Tensor(scoreThreshold),
+        padToMaxOutputSize: true)
+      return (result.selectedIndices, result.validOutputs)
+    }
+    let results = zip(boxes.unstacked(), scores.unstacked()).map {
+      nonMaxSuppression(
+        boxes: $0, scores: $1, maxOutputSize: maxOutputSize, iouThreshold: iouThreshold,
+        scoreThreshold: scoreThreshold, tileSize: tileSize)
+    }
+    return (
+      Tensor(stacking: results.map { $0.selectedIndices }),
+      Tensor(stacking: results.map { $0.validCount })
+    )
+  }
+  defer { _fixLifetime(boxes) }
+  defer { _fixLifetime(scores) }
+  let outputs = XLATensor_nms(
+    boxes.xlaHandle, scores.xlaHandle, Double(scoreThreshold), Double(iouThreshold),
+    Int64(maxOutputSize), Int64(tileSize))
+  return (Tensor(_xlaHandle: outputs.x), Tensor(_xlaHandle: outputs.y))
+}
+
+/// Returns the bilinear resize of the `[batch, height, width, channels]` `images` to `size`, as a
+/// single X10 operation which never leaves the device.
+func _xlaResizeBilinear<Scalar: TensorFlowFloatingPoint>(
+  _ images: Tensor<Scalar>, size: [Int], alignCorners: Bool, halfPixelCenters: Bool
+) -> Tensor<Scalar> {
+  defer { _fixLifetime(images) }
+  return size.map { Int64($0) }.withArrayRef { size in
+    Tensor(
+      _xlaHandle: XLATensor_resize_bilinear(
+        images.xlaHandle, size, alignCorners, halfPixelCenters, true))
+  }
+}
+
+/// Returns the gradient of `_xlaResizeBilinear` for `images` of the given spatial size.
+func _xlaResizeBilinearGrad<Scalar: TensorFlowFloatingPoint>(
+  _ grad: Tensor<Scalar>, imageSize: [Int], alignCorners: Bool, halfPixelCenters: Bool
+) -> Tensor<Scalar> {
+  defer { _fixLifetime(grad) }
+  return imageSize.map { Int64($0) }.withArrayRef { imageSize in
+    Tensor(
+      _xlaHandle: XLATensor_resize_bilinear_backward(
+        grad.xlaHandle, imageSize, alignCorners, halfPixelCenters, true))
+  }
+}
+
+/// Returns values sampled uniformly in `[lowerBound, upperBound)`, drawn from the step seed of the
+/// device `lowerBound` lives on instead of an explicit seed.
+///
+/// Each call uses its own stream of the step seed, so the sampling ops neither depend on each
+/// other nor change the graph from one step to the next.
+public func _xlaRandomUniform<Scalar: TensorFlowNumeric>(
+  _ shape: TensorShape, lowerBound: Tensor<Scalar>, upperBound: Tensor<Scalar>
+) -> Tensor<Scalar> {
+  defer { _fixLifetime(lowerBound) }
+  defer { _fixLifetime(upperBound) }
+  return shape.dimensions.map { Int64($0) }.withArrayRef { size in
+    Tensor(_xlaHandle: XLATensor_rng_uniform(size, lowerBound.xlaHandle, upperBound.xlaHandle))
+  }
+}
+
+/// Returns normally distributed values, drawn from the step seed like `_xlaRandomUniform`.
+public func _xlaRandomNormal<Scalar: TensorFlowFloatingPoint>(
+  _ shape: TensorShape, mean: Tensor<Scalar>, standardDeviation: Tensor<Scalar>
+) -> Tensor<Scalar> {
+  defer { _fixLifetime(mean) }
+  defer { _fixLifetime(standardDeviation) }
+  return shape.dimensions.map { Int64($0) }.withArrayRef { size in
+    Tensor(_xlaHandle: XLATensor_rng_normal(size, mean.xlaHandle, standardDeviation.xlaHandle))
+  }
+}
+
+/// Sets the step seed used by `_xlaRandomUniform` and `_xlaRandomNormal` on `device`.
+public func _xlaSetRandomSeed(_ seed: UInt64, on device: Device) {
+  XLATensor_set_rng_seed(device.cdevice, seed)
+}
+
 extension Array where Element == AnyTensor {
   func withArrayRef<Result>(_ body: (OpaqueXLATensorArrayRef) throws -> Result) rethrows -> Result {
     try self.map { $0.scalarType.unwrapTensor($0) }.withArrayRef { try body($0) }
@@ -258,6 +1047,22 @@ extension TensorFlowScalar {
     return Tensor<Self>(
       _xlaHandle: XLATensor_makePlaceholder((t as! Tensor<Self>).xlaHandle, Int32(i)))
   }
+  /// Returns the `index`-th slice along the leading dimension of `t`.
+  static func stepSlice(_ t: AnyTensor, index: Tensor<Int32>) -> AnyTensor {
+    let tensor = t as! Tensor<Self>
+    defer { _fixLifetime(tensor) }
+    var dims = tensor.xlaTensor.shape.map { Int64($0) }
+    dims[0] = 1
+    let zero = Tensor<Int32>(0, on: index.device)
+    let startIndices = [index] + Array(repeating: zero, count: dims.count - 1)
+    return startIndices.withArrayRef { startIndices in
+      dims.withArrayRef { dims in
+        Tensor<Self>(
+          _xlaHandle: XLATensor_squeeze(
+            XLATensor_dynamic_slice(tensor.xlaHandle, startIndices, dims), 0))
+      }
+    }
+  }
 }
 
 extension _RawXLA {
@@ -297,6 +1102,564 @@ extension _RawXLA {
       n: n, initial: initial, placeholders: placeholders,
       indexPlaceholder: i, results: results)
   }
+
+  /// Returns `body(inputs)`, computed by a call to an outlined computation instead of inlining
+  /// the operations of `body` into the graph.
+  ///
+  /// The structurally identical bodies, like the layers of a deep transformer, which only differ
+  /// in the tensors they capture, are lowered once and appear once in the HLO of the step, so
+  /// that the lowering time and the size of the computation do not grow with the number of
+  /// layers. The captured tensors, like the layer weights, are passed as arguments of the call.
+  /// XLA may still inline the calls while compiling, so models whose compile time matters should
+  /// stack their layer weights and run the layers with `multiStep` instead.
+  public static func outlined(
+    _ inputs: [AnyTensor], _ body: ([AnyTensor]) -> [AnyTensor]
+  ) -> [AnyTensor] {
+    var idx = 0
+    let placeholders = inputs.map { (v: AnyTensor) -> AnyTensor in
+      idx += 1
+      return v.scalarType.makePlaceholder(v, i: idx)
+    }
+    let results = body(placeholders)
+    return inputs.withArrayRef { inputs in
+      placeholders.withArrayRef { placeholders in
+        results.withArrayRef { resultHandles in
+          let tensorListHandle = XLATensor_outlined_call(inputs, placeholders, resultHandles)
+          defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+          return (0..<tensorListHandle.size).map { i in
+            results[i].scalarType.wrapTensor(XLATensor(_handle: tensorListHandle.data[i]!))
+          }
+        }
+      }
+    }
+  }
+
+  /// Runs `steps` iterations of `body` as a single XLA while loop, so that the
+  /// whole sequence is traced, compiled and dispatched once and `state` stays
+  /// resident on the device between the iterations.
+  ///
+  /// - Parameters:
+  ///   - steps: The number of iterations to run.
+  ///   - state: The values carried from one iteration to the next, such as the
+  ///     model parameters and the optimizer state.
+  ///   - stackedInputs: The per iteration inputs, stacked along their leading
+  ///     dimension, which must be `steps`. The i-th iteration receives their
+  ///     i-th slices.
+  ///   - body: Computes the next state from the current state and inputs.
+  /// - Returns: The state after the last iteration.
+  public static func multiStep(
+    steps: Int, state: [AnyTensor], stackedInputs: [AnyTensor] = [],
+    body: ([AnyTensor], [AnyTensor]) -> [AnyTensor]
+  ) -> [AnyTensor] {
+    precondition(!state.isEmpty, "multiStep requires a non-empty state.")
+    let device = state[0].scalarType.unwrapTensor(state[0]).device
+    for input in stackedInputs {
+      let dims = input.scalarType.unwrapTensor(input).shape
+      precondition(
+        dims.first == steps,
+        "The leading dimension of the stacked inputs must be \(steps), got \(dims).")
+    }
+    return functionalWhile(n: Tensor<Int32>(Int32(steps), on: device), initial: state) {
+      current, i in
+      let inputs = stackedInputs.map { $0.scalarType.stepSlice($0, index: i) }
+      return body(current, inputs)
+    }
+  }
+
+  /// Adds every value of `values` to its accumulator. Once the previous accumulators are not
+  /// referenced anymore, their buffers get donated to the new ones at the step barriers, like the
+  /// one of the cache of `kvCacheUpdate`, even without `XLA_ENABLE_PARAM_ALIASING`. With
+  /// `reset`, the new accumulators are zeros and the sums are returned, otherwise the new
+  /// accumulators are the sums.
+  public static func accumulate(
+    _ accumulators: [Tensor<Float>], _ values: [Tensor<Float>], reset: Bool
+  ) -> (accumulators: [Tensor<Float>], sums: [Tensor<Float>]) {
+    let results = accumulators.withArrayRef { accumulators in
+      values.withArrayRef { values in
+        updatedTensors(XLATensor_accumulate(accumulators, values, reset))
+      }
+    }
+    let n = accumulators.count
+    return (Array(results[0..<n]), reset ? Array(results[n..<2 * n]) : [])
+  }
+
+  /// Applies the Adam update, without bias correction, to all the `weights` at once:
+  ///
+  ///     m = beta1 * m + (1 - beta1) * g
+  ///     v = beta2 * v + (1 - beta2) * g * g
+  ///     w = w - learningRate * (m / (sqrt(v) + epsilon) + weightDecay * w)
+  ///
+  /// The weights are grouped by device and element type and every group is a single update over
+  /// the concatenation of its flattened tensors, instead of several operations per weight.
+  /// When `gradsFinite`, as returned by `lossScaleUpdate`, is false, the weights and moments are
+  /// left unchanged.
+  ///
+  /// With `offloadingMoments`, for models whose optimizer state does not fit in device memory, the
+  /// returned moments live in host memory. Every step streams them through the device in buckets
+  /// of `XLA_OFFLOAD_BUCKET_BYTES`, uploading the next bucket and fetching back the previous ones
+  /// while the current one is updated.
+  public static func adamUpdate(
+    weights: [Tensor<Float>], grads: [Tensor<Float>], firstMoments: [Tensor<Float>],
+    secondMoments: [Tensor<Float>], learningRate: Tensor<Float>, beta1: Tensor<Float>,
+    beta2: Tensor<Float>, epsilon: Tensor<Float>, weightDecay: Tensor<Float>,
+    gradsFinite: Tensor<Bool>? = nil, offloadingMoments: Bool = false
+  ) -> (weights: [Tensor<Float>], firstMoments: [Tensor<Float>], secondMoments: [Tensor<Float>]) {
+    defer { _fixLifetime(learningRate) }
+    defer { _fixLifetime(beta1) }
+    defer { _fixLifetime(beta2) }
+    defer { _fixLifetime(epsilon) }
+    defer { _fixLifetime(weightDecay) }
+    defer { _fixLifetime(gradsFinite) }
+    let results = weights.withArrayRef { weights in
+      grads.withArrayRef { grads in
+        firstMoments.withArrayRef { firstMoments in
+          secondMoments.withArrayRef { secondMoments in
+            updatedTensors(
+              XLATensor_adam_update(
+                weights, grads, firstMoments, secondMoments, learningRate.xlaHandle,
+                beta1.xlaHandle, beta2.xlaHandle, epsilon.xlaHandle, weightDecay.xlaHandle,
+                gradsFinite?.xlaHandle, offloadingMoments))
+          }
+        }
+      }
+    }
+    let n = weights.count
+    return (
+      Array(results[0..<n]), Array(results[n..<2 * n]), Array(results[2 * n..<3 * n])
+    )
+  }
+
+  /// Applies the SGD with momentum update to all the `weights` at once:
+  ///
+  ///     g = g + weightDecay * w
+  ///     u = momentum * u - learningRate * g
+  ///     w = w + (nesterov ? momentum * u - learningRate * g : u)
+  ///
+  /// The weights are grouped, and `gradsFinite` is used, like in `adamUpdate`.
+  public static func sgdUpdate(
+    weights: [Tensor<Float>], grads: [Tensor<Float>], velocities: [Tensor<Float>],
+    learningRate: Tensor<Float>, momentum: Tensor<Float>, weightDecay: Tensor<Float>,
+    nesterov: Bool, gradsFinite: Tensor<Bool>? = nil
+  ) -> (weights: [Tensor<Float>], velocities: [Tensor<Float>]) {
+    defer { _fixLifetime(learningRate) }
+    defer { _fixLifetime(momentum) }
+    defer { _fixLifetime(weightDecay) }
+    defer { _fixLifetime(gradsFinite) }
+    let results = weights.withArrayRef { weights in
+      grads.withArrayRef { grads in
+        velocities.withArrayRef { velocities in
+          updatedTensors(
+            XLATensor_sgd_update(
+              weights, grads, velocities, learningRate.xlaHandle, momentum.xlaHandle,
+              weightDecay.xlaHandle, nesterov, gradsFinite?.xlaHandle))
+        }
+      }
+    }
+    let n = weights.count
+    return (Array(results[0..<n]), Array(results[n..<2 * n]))
+  }
+
+  /// Returns the size of the moment shards of `shardedAdamUpdate` for `weights`, which is their
+  /// scalar count divided by the number of replication devices, rounded up.
+  public static func shardedAdamMomentCount(weights: [Tensor<Float>]) -> Int {
+    return Int(weights.withArrayRef { weights in XLATensor_sharded_optimizer_shard_size(weights) })
+  }
+
+  /// Applies the update of `adamUpdate` to `weights` replicated across the replication devices,
+  /// each of which only keeps its shard of the moments: the first and second moment shards are
+  /// rank 1 tensors of `shardedAdamMomentCount(weights:)` scalars, zero initialized.
+  ///
+  /// The local `grads` of the replicas are reduce-scattered and their sum multiplied by
+  /// `gradScale`, which is `1 / replicaCount` for their mean. Every replica then updates its slice
+  /// of the flattened weights and its moment shards, and the updated slices are all-gathered, so
+  /// the optimizer state takes `1 / replicaCount` of the memory it takes with `adamUpdate`.
+  public static func shardedAdamUpdate(
+    weights: [Tensor<Float>], grads: [Tensor<Float>], firstMoments: Tensor<Float>,
+    secondMoments: Tensor<Float>, learningRate: Tensor<Float>, beta1: Tensor<Float>,
+    beta2: Tensor<Float>, epsilon: Tensor<Float>, weightDecay: Tensor<Float>,
+    gradScale: Double = 1, gradsFinite: Tensor<Bool>? = nil
+  ) -> (weights: [Tensor<Float>], firstMoments: Tensor<Float>, secondMoments: Tensor<Float>) {
+    defer { _fixLifetime(firstMoments) }
+    defer { _fixLifetime(secondMoments) }
+    defer { _fixLifetime(learningRate) }
+    defer { _fixLifetime(beta1) }
+    defer { _fixLifetime(beta2) }
+    defer { _fixLifetime(epsilon) }
+    defer { _fixLifetime(weightDecay) }
+    defer { _fixLifetime(gradsFinite) }
+    let results = weights.withArrayRef { weights in
+      grads.withArrayRef { grads in
+        updatedTensors(
+          XLATensor_sharded_adam_update(
+            weights, grads, firstMoments.xlaHandle, secondMoments.xlaHandle,
+            learningRate.xlaHandle, beta1.xlaHandle, beta2.xlaHandle, epsilon.xlaHandle,
+            weightDecay.xlaHandle, gradScale, gradsFinite?.xlaHandle))
+      }
+    }
+    let n = weights.count
+    return (Array(results[0..<n]), results[n], results[n + 1])
+  }
+
+  /// Applies the dynamic loss scaling to the `grads` of a loss multiplied by `lossScale`. The
+  /// gradients are divided by `lossScale`, and if they are all finite `goodSteps` is incremented,
+  /// and the scale multiplied by `growthFactor` every `growthInterval` finite steps. Otherwise
+  /// the scale is multiplied by `backoffFactor` and `goodSteps` reset. The returned `gradsFinite`
+  /// can be passed to `adamUpdate` or `sgdUpdate`, to skip the steps with overflows without
+  /// reading anything back on the host.
+  public static func lossScaleUpdate(
+    grads: [Tensor<Float>], lossScale: Tensor<Float>, goodSteps: Tensor<Float>,
+    growthInterval: Int = 2000, growthFactor: Double = 2, backoffFactor: Double = 0.5
+  ) -> (
+    grads: [Tensor<Float>], gradsFinite: Tensor<Bool>, lossScale: Tensor<Float>,
+    goodSteps: Tensor<Float>
+  ) {
+    defer { _fixLifetime(lossScale) }
+    defer { _fixLifetime(goodSteps) }
+    let tensorListHandle = grads.withArrayRef { grads in
+      XLATensor_loss_scale_update(
+        grads, lossScale.xlaHandle, goodSteps.xlaHandle, Int64(growthInterval), growthFactor,
+        backoffFactor)
+    }
+    defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+    let n = grads.count
+    return (
+      (0..<n).map { Tensor(_xlaHandle: tensorListHandle.data[$0]!) },
+      Tensor(_xlaHandle: tensorListHandle.data[n]!),
+      Tensor(_xlaHandle: tensorListHandle.data[n + 1]!),
+      Tensor(_xlaHandle: tensorListHandle.data[n + 2]!)
+    )
+  }
+
+  /// Quantizes `tensor` to int8 on the host, with a symmetric scale for every index along
+  /// `channelAxis`, and uploads the result to `device`. The scales are the largest magnitude of
+  /// their channel divided by 127, so `weight` times `scale` broadcast along `channelAxis`
+  /// approximates `tensor`, with a quarter of its memory footprint.
+  public static func quantizePerChannel(
+    _ tensor: Tensor<Float>, channelAxis: Int, on device: Device = .default
+  ) -> (weight: Tensor<Int8>, scale: Tensor<Float>) {
+    let dims = tensor.shape.dimensions
+    let axis = channelAxis < 0 ? channelAxis + dims.count : channelAxis
+    precondition(axis >= 0 && axis < dims.count, "Invalid channel axis \(channelAxis).")
+    let quantized = tensor.scalars.withUnsafeBufferPointer { data in
+      dims.withUnsafeBufferPointer { dims in
+        copyTensorQuantized(
+          data.baseAddress, data.count, dims.baseAddress, dims.count, Int64(axis), device.cdevice)
+      }
+    }
+    return (Tensor(_xlaHandle: quantized.x), Tensor(_xlaHandle: quantized.y))
+  }
+
+  /// Uploads tensors stored in the file at `path` to `device`, as the raw bytes of their scalars
+  /// in row major order, the i-th one starting at byte `offsets[i]` with shape `shapes[i]`.
+  ///
+  /// The file is memory mapped and streamed to the device in parallel, without going through
+  /// Swift arrays, which makes restoring large checkpoints bound by the disk bandwidth.
+  public static func loadTensors<Scalar: TensorFlowScalar>(
+    fromFile path: String, offsets: [Int], shapes: [TensorShape], on device: Device = .default
+  ) -> [Tensor<Scalar>] {
+    precondition(offsets.count == shapes.count, "Expected one offset per shape.")
+    let ranks = shapes.map { $0.rank }
+    let dims = shapes.flatMap { $0.dimensions }
+    let tensorListHandle = offsets.withUnsafeBufferPointer { offsets in
+      ranks.withUnsafeBufferPointer { ranks in
+        dims.withUnsafeBufferPointer { dims in
+          loadTensorsFromFile(
+            path, Scalar.xlaTensorScalarType, offsets.baseAddress, dims.baseAddress,
+            ranks.baseAddress, offsets.count, device.cdevice)
+        }
+      }
+    }
+    defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+    return (0..<tensorListHandle.size).map { i in
+      Tensor(_xlaHandle: tensorListHandle.data[i]!)
+    }
+  }
+
+  /// Starts saving the tensors whose index modulo `shardCount` is `shardIndex` to the file at
+  /// `path`, in the layout `loadTensors` reads, and returns without waiting for it.
+  ///
+  /// The values the tensors have now are snapshotted on the device, so the training steps which
+  /// follow can update the tensors while the snapshot gets streamed to the file. Each replica
+  /// passes its own `shardIndex` to write its share of the replicated model.
+  public static func saveTensors(
+    _ tensors: [AnyTensor], toFile path: String, shardIndex: Int = 0, shardCount: Int = 1
+  ) -> _XLAAsyncCheckpoint {
+    let handle = tensors.withArrayRef { tensors in
+      saveTensorsAsync(tensors, path, Int32(shardIndex), Int32(shardCount))
+    }
+    return _XLAAsyncCheckpoint(handle!)
+  }
+
+  /// Writes the computations which syncing each group of tensors, like
+  /// the outputs of every traced inference graph, to a bundle file at `path`.
+  ///
+  /// A serving process passing the bundle to `loadComputations(fromFile:)` at startup gets its
+  /// first requests served from the computation cache, instead of lowering and compiling their
+  /// graphs. The bundle only loads in processes running the same X10 build.
+  public static func exportComputations(of groups: [[AnyTensor]], toFile path: String) {
+    let tensors = groups.flatMap { $0 }
+    let groupSizes = groups.map { Int64($0.count) }
+    tensors.withArrayRef { tensors in
+      groupSizes.withArrayRef { groupSizes in
+        exportComputationBundle(tensors, groupSizes, path)
+      }
+    }
+  }
+
+  /// Compiles the computations of the bundle written by `exportComputations(of:toFile:)` into
+  /// the computation cache.
+  public static func loadComputations(fromFile path: String) {
+    loadComputationBundle(path)
+  }
+
+  /// Returns a tensor of shape `shape`, or the one `XLA_SHAPE_BUCKETS` pads it to when
+  /// `toBucket`, which stands for an input of the graphs traced to warm up the computation
+  /// cache. It has no value, so the graphs using it can only be passed to `precompile`.
+  public static func warmupTensor<Scalar: TensorFlowScalar>(
+    shape: TensorShape, on device: Device = .default, toBucket: Bool = false
+  ) -> Tensor<Scalar> {
+    let dims = shape.dimensions
+    let handle = dims.withUnsafeBufferPointer { dims in
+      makeWarmupTensor(
+        Scalar.xlaTensorScalarType, dims.baseAddress, dims.count, device.cdevice, toBucket)
+    }
+    return Tensor(_xlaHandle: handle!)
+  }
+
+  /// Compiles, concurrently, the computations which syncing each group of tensors would run,
+  /// into the computation cache and the persistent one, and returns once they are all compiled.
+  /// The computations are not run.
+  public static func precompile(_ groups: [[AnyTensor]]) {
+    let tensors = groups.flatMap { $0 }
+    let groupSizes = groups.map { Int64($0.count) }
+    tensors.withArrayRef { tensors in
+      groupSizes.withArrayRef { groupSizes in
+        precompileGraphs(tensors, groupSizes)
+      }
+    }
+  }
+
+  /// Traces `graph` for inputs of each of the `signatures`, the shapes of its inputs, and
+  /// compiles all the traced graphs at once, so that a server which calls it before reporting
+  /// healthy serves its first requests of every shape from the computation cache.
+  ///
+  /// The inputs are `warmupTensor`s, so `graph` must only trace operations, and not fetch any
+  /// value. With `toBucket`, the signatures are padded like the uploads to `XLA_SHAPE_BUCKETS`.
+  public static func warmUp<Scalar: TensorFlowScalar>(
+    signatures: [[TensorShape]], on device: Device = .default, toBucket: Bool = false,
+    _ graph: ([Tensor<Scalar>]) -> [AnyTensor]
+  ) {
+    precompile(
+      signatures.map { shapes in
+        graph(shapes.map { warmupTensor(shape: $0, on: device, toBucket: toBucket) })
+      })
+  }
+
+  /// Freezes `tensors`, like the weights of a latency critical inference model, into the graphs
+  /// using them, which embed their values as constants instead of reading them as parameters.
+  /// The compiler then folds the computations which only depend on them, like transposed
+  /// weights or fused batch norm scales, and picks their layouts.
+  ///
+  /// The graphs using frozen tensors compile on their own, and updating a frozen tensor
+  /// unfreezes it. Tensors larger than `XLA_FROZEN_CONSTANT_MAX_BYTES` stay parameters.
+  public static func freeze(_ tensors: [AnyTensor]) {
+    tensors.withArrayRef { tensors in
+      freezeTensors(tensors)
+    }
+  }
+
+  /// Keeps the host values `tensors` got created from, which are otherwise released once they
+  /// get uploaded under `XLA_DROP_UPLOADED_HOST_DATA`, for the tensors read back on the host
+  /// often enough that fetching them from the device every time costs more than the memory.
+  public static func keepHostData(_ tensors: [AnyTensor]) {
+    tensors.withArrayRef { tensors in
+      keepTensorsHostData(tensors)
+    }
+  }
+
+  /// Whether the floating point values computed by the latest sync of `device` are all finite,
+  /// with `XLA_NUMERICS_GUARD`, which fuses the check into the synced graph and fetches its result
+  /// along with the step outputs. It can feed the `gradsFinite` argument of `adamUpdate` to skip
+  /// the steps whose loss or gradients overflowed, without a dedicated check and transfer.
+  public static func numericsGuard(on device: Device = .default) -> Tensor<Bool> {
+    return Tensor(_xlaHandle: XLATensor_numerics_guard(device.cdevice))
+  }
+
+  /// Exports the device data of `tensor`, computing it first if needed, and returns the handle
+  /// the other processes of the host pass to `importDeviceData` to use it without a copy, like
+  /// the model replicas served from the same GPU sharing their weights.
+  ///
+  /// The exported data stays alive, and is never updated in place, until `unexportDeviceData`
+  /// gets the handle, which must only happen once the importing processes are done with it.
+  /// Only GPU devices of CUDA builds support this.
+  public static func exportDeviceData<Scalar: TensorFlowScalar>(
+    of tensor: Tensor<Scalar>
+  ) -> String {
+    defer { _fixLifetime(tensor) }
+    let str = exportTensorData(tensor.xlaHandle)
+    defer { DeleteString(str) }
+    return String(cString: GetStringCStr(str))
+  }
+
+  /// Releases the device data exported by `exportDeviceData` on `device` with `handle`.
+  public static func unexportDeviceData(_ handle: String, on device: Device) {
+    unexportTensorData(handle, device.cdevice)
+  }
+
+  /// Returns a tensor of the device data another process exported with `handle`, which must have
+  /// the given scalar type and `shape`. The tensor can be read by the graphs, but its data is
+  /// never donated to their outputs.
+  public static func importDeviceData<Scalar: TensorFlowScalar>(
+    _ handle: String, shape: TensorShape, on device: Device
+  ) -> Tensor<Scalar> {
+    let dims = shape.dimensions.map { Int64($0) }
+    return dims.withArrayRef { dims in
+      Tensor(
+        _xlaHandle: importTensorData(
+          handle, Scalar.xlaTensorScalarType, dims, device.cdevice))
+    }
+  }
+
+  /// Splits axis `i` of `tensor` into `shardCounts[i]` shards across the replication devices,
+  /// whose counts must multiply to the number of those devices.
+  ///
+  /// The graphs using sharded tensors get compiled into a single SPMD program, which each
+  /// replication device runs as one partition, holding only its shard of the sharded tensors.
+  /// Every replication device must trace the same graphs, and fetching a sharded tensor gathers
+  /// it on all of them.
+  public static func shard<Scalar: TensorFlowScalar>(
+    _ tensor: Tensor<Scalar>, shardCounts: [Int]
+  ) -> Tensor<Scalar> {
+    defer { _fixLifetime(tensor) }
+    return shardCounts.map { Int64($0) }.withArrayRef { shardCounts in
+      Tensor(_xlaHandle: XLATensor_shard(tensor.xlaHandle, shardCounts))
+    }
+  }
+
+  /// Sums `tensor` over the replicas, which must number `shardCount`, and returns the `scale`d
+  /// slice along `axis` which belongs to this replica: the i-th replica gets the i-th of
+  /// `shardCount` equal slices. Every replica only receives its own slice of the sum, unlike a
+  /// `crossReplicaSum` followed by a slice.
+  public static func reduceScatter<Scalar: TensorFlowNumeric>(
+    _ tensor: Tensor<Scalar>, alongAxis axis: Int, shardCount: Int, scale: Double = 1
+  ) -> Tensor<Scalar> {
+    defer { _fixLifetime(tensor) }
+    return Tensor(
+      _xlaHandle: XLATensor_reduce_scatter_sum(
+        tensor.xlaHandle, scale, Int64(axis), Int64(shardCount)))
+  }
+
+  /// Concatenates along `axis` the tensors of the replicas, which must number `shardCount`, in
+  /// replica order. The inverse of `reduceScatter`, without the sum.
+  public static func allGather<Scalar: TensorFlowScalar>(
+    _ tensor: Tensor<Scalar>, alongAxis axis: Int, shardCount: Int
+  ) -> Tensor<Scalar> {
+    defer { _fixLifetime(tensor) }
+    return Tensor(
+      _xlaHandle: XLATensor_all_gather(tensor.xlaHandle, Int64(axis), Int64(shardCount)))
+  }
+
+  /// Returns `cache` with `update` written at `position` along `axis`, and at zero along the
+  /// other axes, for the fixed capacity key and value caches of autoregressive decoding.
+  ///
+  /// `position` is a scalar parameter of the traced graph, so every decoding step runs the same
+  /// computation. Once the previous value of the cache is not referenced anymore, its buffer gets
+  /// donated to the new value at the step barriers, even without `XLA_ENABLE_PARAM_ALIASING`, so
+  /// the cache is updated in place rather than copied. The first update copies the cache, as its
+  /// initial buffer is not marked for donation yet.
+  public static func kvCacheUpdate<Scalar: TensorFlowScalar>(
+    _ cache: Tensor<Scalar>, _ update: Tensor<Scalar>, at position: Tensor<Int32>,
+    alongAxis axis: Int
+  ) -> Tensor<Scalar> {
+    defer { _fixLifetime(cache) }
+    defer { _fixLifetime(update) }
+    defer { _fixLifetime(position) }
+    return Tensor(
+      _xlaHandle: XLATensor_kv_cache_update(
+        cache.xlaHandle, update.xlaHandle, position.xlaHandle, Int64(axis)))
+  }
+
+  /// Creates a tensor with the given `shape` and contiguous `scalars`, padded with zeros along
+  /// `axis` up to `bound`, whose size along `axis` the graphs track as a dynamic size rather than
+  /// as part of the shape. The uploaded tensor has the shape of the bound, so every size up to the
+  /// bound traces the same graphs, which the XLA dynamic padder compiles once. The graph results
+  /// must go through `removeDynamicDimension(_:alongAxis:)` before being read.
+  ///
+  /// The size is a scalar parameter of the graphs, except for sizes 0 and 1, which are embedded
+  /// as constants unless `XLA_NO_SPECIAL_SCALARS` is set.
+  public static func boundedDynamicTensor<Scalar: TensorFlowScalar>(
+    shape: TensorShape, scalars: [Scalar], alongAxis axis: Int, bound: Int,
+    on device: Device = .default
+  ) -> Tensor<Scalar> {
+    precondition(
+      shape.contiguousSize == scalars.count,
+      "The shape requires \(shape.contiguousSize) scalars but \(scalars.count) were provided.")
+    precondition(shape[axis] <= bound, "The size along axis \(axis) exceeds the bound \(bound)")
+    var paddedShape = shape.dimensions
+    paddedShape[axis] = bound
+    let padded = scalars.withUnsafeBufferPointer { scalars in
+      shape.dimensions.withUnsafeBufferPointer { dims in
+        paddedShape.withUnsafeBufferPointer { paddedDims in
+          Tensor<Scalar>(
+            _xlaHandle: copyTensorPadded(
+              Scalar.xlaTensorScalarType, scalars.baseAddress, scalars.count, dims.baseAddress,
+              dims.count, paddedDims.baseAddress, device.cdevice))
+        }
+      }
+    }
+    return setDimensionBound(
+      padded, size: Tensor<Int32>(Int32(shape[axis]), on: device), alongAxis: axis)
+  }
+
+  /// Returns `x`, padded along `axis` up to a bound, with `size` as its dynamic size along `axis`.
+  /// The ops reading the result ignore the padding, like the reductions, and the graphs get
+  /// compiled for the bound, `size` being one of their parameters.
+  public static func setDimensionBound<Scalar: TensorFlowScalar>(
+    _ x: Tensor<Scalar>, size: Tensor<Int32>, alongAxis axis: Int
+  ) -> Tensor<Scalar> {
+    defer { _fixLifetime(x) }
+    defer { _fixLifetime(size) }
+    return Tensor(
+      _xlaHandle: XLATensor_set_dimension_bound(x.xlaHandle, size.xlaHandle, Int64(axis)))
+  }
+
+  /// Returns `x` with its dynamic size along `axis` made static at its bound, and zeros past its
+  /// dynamic size.
+  public static func removeDynamicDimension<Scalar: TensorFlowScalar>(
+    _ x: Tensor<Scalar>, alongAxis axis: Int
+  ) -> Tensor<Scalar> {
+    defer { _fixLifetime(x) }
+    return Tensor(_xlaHandle: XLATensor_remove_dynamic_dimension(x.xlaHandle, Int64(axis)))
+  }
+
+  /// Returns the attention of `query` over the first `validLength` rows of the `key` and `value`
+  /// caches, like `scaledDotProductAttention(query:key:value:scale:causal:blockSize:)` with the
+  /// key rows at or past `validLength` masked out. `validLength` is a scalar parameter of the
+  /// traced graph, so the caches keep their capacity and the graph does not change while they
+  /// fill up. Not differentiable, as it is meant for inference.
+  public static func cachedAttention<Scalar: TensorFlowFloatingPoint>(
+    query: Tensor<Scalar>, key: Tensor<Scalar>, value: Tensor<Scalar>,
+    validLength: Tensor<Int32>, scale: Double? = nil, blockSize: Int = 128
+  ) -> Tensor<Scalar> {
+    defer { _fixLifetime(query) }
+    defer { _fixLifetime(key) }
+    defer { _fixLifetime(value) }
+    defer { _fixLifetime(validLength) }
+    let scale = scale ?? 1 / Double(query.shape[query.rank - 1]).squareRoot()
+    let outputs = XLATensor_scaled_dot_product_attention(
+      query.xlaHandle, key.xlaHandle, value.xlaHandle, scale, false, Int64(blockSize),
+      validLength.xlaHandle)
+    destroyTensor(outputs.y)
+    return Tensor(_xlaHandle: outputs.x)
+  }
+
+  private static func updatedTensors(_ tensorListHandle: OpaqueXLATensorArrayRef) -> [Tensor<Float>]
+  {
+    defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+    return (0..<tensorListHandle.size).map { i in
+      Tensor(_xlaHandle: tensorListHandle.data[i]!)
+    }
+  }
 }
 
 /// Add more op wrappers here:
@@ -417,17 +1780,20 @@ extension XLATensor {
 
   static func maxpool_grad(
     _ input: XLATensor,
+    _ output: XLATensor,
     _ grad: XLATensor,
     _ ksize: [Int64],
     _ strides: [Int64],
     _ padding: TFPadding
   ) -> XLATensor {
     defer { _fixLifetime(input) }
+    defer { _fixLifetime(output) }
     defer { _fixLifetime(grad) }
     return ksize.withArrayRef { ksize in
       strides.withArrayRef { strides in
         XLATensor(
-          _handle: tf_MaxPoolGrad(input.handle, grad.handle, ksize, strides, padding))
+          _handle: tf_MaxPoolGrad(
+            input.handle, output.handle, grad.handle, ksize, strides, padding))
       }
     }
   }
@@ -453,6 +1819,12 @@ extension XLATensor {
     let strides: [Int64]
     let processingSizes: [Int64]
     let finalSizes: [Int64]
+    /// The same slice as a single slice with positive strides, followed by the reversal of
+    /// `reverseDims` and a reshape from `processingSizes` to `finalSizes`.
+    let sliceBegin: [Int64]
+    let sliceEnd: [Int64]
+    let sliceStrides: [Int64]
+    let reverseDims: [Int64]
   }
 
   static func computeIndexingBoundsAndStrides(
@@ -472,7 +1844,11 @@ extension XLATensor {
               end: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.end),
               strides: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.strides),
               processingSizes: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.processing_sizes),
-              finalSizes: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.final_sizes)
+              finalSizes: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.final_sizes),
+              sliceBegin: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.slice_begin),
+              sliceEnd: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.slice_end),
+              sliceStrides: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.slice_strides),
+              reverseDims: arrayFromInt64ArrayRef(stridedSliceSpec.pointee.reverse_dims)
             )
           }
         }
@@ -495,3 +1871,69 @@ extension XLATensor {
 public func PrintX10Metrics() {
   PrintMetrics()
 }
+
+/// Logs the `count` slowest graph compilations seen so far, along with the
+/// call sites which triggered them.
+public func PrintX10CompileReport(count: Int = 10) {
+  PrintCompileReport(Int64(count))
+}
+
+/// Logs the `count` graphs with the highest accumulated execution time, along with their
+/// execution count, argument and result bytes, and the last step they ran at. When `includeHLO`
+/// is true, the HLO of the graphs which are still cached is logged as well.
+public func PrintX10ExecutionReport(count: Int = 10, includeHLO: Bool = false) {
+  PrintExecutionReport(Int64(count), includeHLO)
+}
+
+/// Returns the report logged by `PrintX10ExecutionReport(count:includeHLO:)`.
+public func X10ExecutionReport(count: Int = 10, includeHLO: Bool = false) -> String {
+  let str = GetExecutionReport(Int64(count), includeHLO)
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Returns the `count` annotation scopes, as entered with `MakeAnnotationScope`, which the most
+/// device time is attributed to, with their share of the profiled time. The execution time of
+/// every graph is split between the scopes its operations were traced within, in proportion of
+/// their estimated cost. Requires `XLA_SCOPE_PROFILE` to be set.
+public func X10ScopeReport(count: Int = 20) -> String {
+  let str = GetScopeReport(Int64(count))
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Returns the `count` largest device memory users, grouped by device, annotation scope and
+/// kind (parameter, activation, cache, executable). Requires `XLA_MEMORY_ACCOUNTING` to be set.
+public func X10MemoryReport(count: Int = 20) -> String {
+  let str = GetMemoryReport(Int64(count))
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Returns the device memory usage changes since the previous call. Calling it after every step
+/// shows the memory which keeps growing.
+public func X10MemoryDiffReport() -> String {
+  let str = GetMemoryDiffReport()
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Logs how the host time of the last step, and on average of the recent steps, got split
+/// between tracing, graph collection, compilation, transfers, dispatch, device lock waits and
+/// idle time. Requires `XLA_STEP_PROFILE` to be set.
+public func PrintX10StepProfile() {
+  PrintStepProfile()
+}
+
+/// Writes the recent runtime events (graph collection, lowering, compilation, transfers,
+/// executions) to `path`, in the Chrome trace JSON format.
+public func DumpX10EventTrace(to path: String) {
+  DumpEventTrace(path)
+}
+
+/// Returns the current X10 metrics and counters in the Prometheus text exposition format.
+public func X10PrometheusMetrics() -> String {
+  let str = GetPrometheusMetrics()
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
@@ -0,0 +1,105 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// The `Tensor<Float>` parameters of a model packed into a single contiguous tensor, for the
+/// models made of many small parameters.
+///
+/// Every parameter otherwise has its own device buffer, cross replica sum operand and optimizer
+/// update. Here the parameters, their gradients and the optimizer state are single flat tensors
+/// instead: the gradients get summed across the replicas with a single operand, and a single
+/// fused optimizer update computes the new flat parameters. The parameters of the model become
+/// views of the flat storage, slices reshaped to their shapes, which the next step reads from the
+/// single device buffer of `storage`.
+///
+/// The parameters are enumerated in the stable order of the `TensorVisitorPlan` of the gradients,
+/// and must all live on the same device. The model must not have `@noDerivative` parameters of
+/// type `Tensor<Float>`, as its tensors would not match its gradients anymore.
+public struct _XLAFlatParameters<Model: Module> {
+  /// The packed parameters.
+  public private(set) var storage: Tensor<Float>
+  /// The shapes of the parameters, in packing order.
+  public let shapes: [TensorShape]
+  /// The offsets of the parameters in `storage`, in packing order.
+  public let offsets: [Int]
+  private let parameterKeyPaths: [WritableKeyPath<Model, Tensor<Float>>]
+  private let gradientKeyPaths: [WritableKeyPath<Model.TangentVector, Tensor<Float>>]
+
+  /// Packs the parameters of `model`, and makes them views of the packed storage.
+  public init(_ model: inout Model) {
+    parameterKeyPaths = model.recursivelyAllWritableKeyPaths(to: Tensor<Float>.self)
+    gradientKeyPaths = TensorVisitorPlan(model.differentiableVectorView).allTensorKeyPaths
+    precondition(!parameterKeyPaths.isEmpty, "The model has no parameters to pack")
+    precondition(
+      parameterKeyPaths.count == gradientKeyPaths.count,
+      "The parameters of the model do not match its gradients")
+    let parameters = parameterKeyPaths.map { model[keyPath: $0] }
+    let device = parameters[0].device
+    precondition(
+      parameters.allSatisfy { $0.device == device }, "The parameters live on several devices")
+    shapes = parameters.map { $0.shape }
+    var offsets = [Int]()
+    var offset = 0
+    for shape in shapes {
+      offsets.append(offset)
+      offset += shape.contiguousSize
+    }
+    self.offsets = offsets
+    storage = Self.pack(parameters)
+    unpack(into: &model)
+  }
+
+  /// The number of packed scalars.
+  public var scalarCount: Int { storage.shape[0] }
+
+  /// Returns `gradients` packed like the parameters.
+  public func packed(_ gradients: Model.TangentVector) -> Tensor<Float> {
+    Self.pack(gradientKeyPaths.map { gradients[keyPath: $0] })
+  }
+
+  /// Returns the view of the parameter at `index`, in packing order, into `flat`.
+  public func view(_ index: Int, of flat: Tensor<Float>) -> Tensor<Float> {
+    flat.slice(lowerBounds: [offsets[index]], sizes: [shapes[index].contiguousSize])
+      .reshaped(to: shapes[index])
+  }
+
+  /// Makes the parameters of `model` views of `storage`.
+  public func unpack(into model: inout Model) {
+    for (index, keyPath) in parameterKeyPaths.enumerated() {
+      model[keyPath: keyPath] = view(index, of: storage)
+    }
+  }
+
+  /// Packs `gradients`, sums them across the replicas and multiplies them by
+  /// `crossReplicaScale` when it is given, then replaces `storage` with the result of `update`
+  /// on the flat parameters and gradients, typically a single `_RawXLA.adamUpdate` or
+  /// `_RawXLA.sgdUpdate` call, and makes the parameters of `model` views of it.
+  public mutating func update(
+    _ model: inout Model, along gradients: Model.TangentVector,
+    crossReplicaScale: Double? = nil,
+    _ update: (_ parameters: Tensor<Float>, _ gradients: Tensor<Float>) -> Tensor<Float>
+  ) {
+    var flatGradients = packed(gradients)
+    if let crossReplicaScale = crossReplicaScale {
+      flatGradients = _RawXLA.crossReplicaSum([flatGradients], crossReplicaScale)[0]
+    }
+    let newStorage = update(storage, flatGradients)
+    precondition(newStorage.shape == storage.shape, "The update changed the packed shape")
+    storage = newStorage
+    unpack(into: &model)
+  }
+
+  private static func pack(_ tensors: [Tensor<Float>]) -> Tensor<Float> {
+    Tensor(concatenating: tensors.map { $0.reshaped(to: [-1]) })
+  }
+}
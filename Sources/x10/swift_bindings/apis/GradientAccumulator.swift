@@ -0,0 +1,72 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// Accumulates the gradients of several micro-steps before every optimizer update, for the
+/// effective batches which do not fit on the devices at once.
+///
+/// The accumulators stay on the devices, and every micro-step adds the gradients to them in
+/// place: like the key and value caches of `_RawXLA.kvCacheUpdate`, their buffers are donated to
+/// their new values, even without `XLA_ENABLE_PARAM_ALIASING`. The micro-steps do not depend on
+/// their index, so all of them but the last trace the same graph, and only the last one of every
+/// round sums the gradients across the replicas, handing them over while the accumulators get
+/// zeroed for the next round.
+public struct _XLAGradientAccumulator<Gradients: KeyPathIterable> {
+  /// The gradients accumulated in the current round.
+  public private(set) var accumulated: Gradients
+  /// The number of micro-steps of every round.
+  public let microSteps: Int
+  /// The number of micro-steps accumulated in the current round.
+  public private(set) var microStep: Int = 0
+
+  /// Creates an accumulator of `microSteps` micro-steps per round, for gradients with the shapes
+  /// and devices of the `Tensor<Float>` values of `gradients`. The other values are not
+  /// accumulated, the ones of the last micro-step of every round are returned as they are.
+  public init(microSteps: Int, like gradients: Gradients) {
+    precondition(microSteps > 0, "A round needs at least one micro-step")
+    self.microSteps = microSteps
+    self.accumulated = gradients
+    for keyPath in gradients.recursivelyAllWritableKeyPaths(to: Tensor<Float>.self) {
+      let gradient = gradients[keyPath: keyPath]
+      accumulated[keyPath: keyPath] = Tensor(zeros: gradient.shape, on: gradient.device)
+    }
+  }
+
+  /// Adds the `gradients` of a micro-step. On the last micro-step of a round, returns their mean
+  /// over the round, summed across the replicas and multiplied by `crossReplicaScale` when it is
+  /// given, and nil on the other micro-steps.
+  public mutating func accumulate(
+    _ gradients: Gradients, crossReplicaScale: Double? = nil
+  ) -> Gradients? {
+    let keyPaths = accumulated.recursivelyAllWritableKeyPaths(to: Tensor<Float>.self)
+    microStep += 1
+    let lastMicroStep = microStep == microSteps
+    let results = _RawXLA.accumulate(
+      keyPaths.map { accumulated[keyPath: $0] }, keyPaths.map { gradients[keyPath: $0] },
+      reset: lastMicroStep)
+    for (keyPath, accumulator) in zip(keyPaths, results.accumulators) {
+      accumulated[keyPath: keyPath] = accumulator
+    }
+    guard lastMicroStep else { return nil }
+    microStep = 0
+    var means = gradients
+    let scale = 1 / Double(microSteps)
+    for (keyPath, sum) in zip(keyPaths, results.sums) {
+      means[keyPath: keyPath] = crossReplicaScale == nil ? sum * Float(scale) : sum
+    }
+    if let crossReplicaScale = crossReplicaScale {
+      means.crossReplicaSum(crossReplicaScale * scale)
+    }
+    return means
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// A tensor growing along an axis, like the tokens or the attention keys and values of an
+/// autoregressive decoder, whose growth does not change the traced graphs at every step.
+///
+/// Growing a tensor by concatenation changes its shape at every step, so every step compiles a
+/// new graph and copies the whole tensor. The buffer instead preallocates its capacity along
+/// `axis`, in power of two buckets, and writes the appended values with a dynamic update slice
+/// whose offset is a scalar parameter of the graph. The graphs only change when the capacity
+/// grows, and with `XLA_ENABLE_PARAM_ALIASING` the update happens in place, since the previous
+/// storage is not referenced anymore.
+///
+/// The steps writing at offsets 0 and 1 trace their own graphs, as these values are embedded as
+/// constants unless `XLA_NO_SPECIAL_SCALARS` is set.
+public struct _XLAGrowableBuffer<Scalar: TensorFlowNumeric> {
+  /// The preallocated storage, whose first `count` positions along `axis` hold the values.
+  public private(set) var storage: Tensor<Scalar>
+  /// The axis the buffer grows along.
+  public let axis: Int
+  /// The number of positions appended along `axis`.
+  public private(set) var count: Int = 0
+
+  /// Creates an empty buffer of tensors with the given shape, whose size along `axis` is the
+  /// initial capacity.
+  public init(shape: TensorShape, axis: Int, on device: Device = .default) {
+    precondition(axis >= 0 && axis < shape.rank, "Axis out of range")
+    var bucketedShape = shape
+    bucketedShape[axis] = Self.bucketedCapacity(shape[axis])
+    self.storage = Tensor(zeros: bucketedShape, on: device)
+    self.axis = axis
+  }
+
+  /// The number of positions along `axis` the buffer has room for.
+  public var capacity: Int { storage.shape[axis] }
+
+  /// The appended values. Their shape changes with `count`, so the graphs which need a stable
+  /// shape should use `storage` and `validMask` instead.
+  public var values: Tensor<Scalar> {
+    var sizes = storage.shape.dimensions
+    sizes[axis] = count
+    return storage.slice(
+      lowerBounds: [Int](repeating: 0, count: storage.rank), sizes: sizes)
+  }
+
+  /// Whether each position along `axis` of `storage` holds an appended value.
+  public var validMask: Tensor<Bool> {
+    let positions = Tensor<Int32>(
+      rangeFrom: 0, to: Int32(capacity), stride: 1, on: storage.device)
+    return positions .< Tensor<Int32>(Int32(count), on: storage.device)
+  }
+
+  /// Appends `newValues`, whose shape matches the one of `storage` but along `axis`.
+  public mutating func append(_ newValues: Tensor<Scalar>) {
+    let newCount = count + newValues.shape[axis]
+    if newCount > capacity {
+      var padding = [(before: Int, after: Int)](repeating: (0, 0), count: storage.rank)
+      padding[axis].after = Self.bucketedCapacity(newCount) - capacity
+      storage = storage.padded(forSizes: padding)
+    }
+    let zero = Tensor<Int32>(0, on: storage.device)
+    var startIndices = [Tensor<Int32>](repeating: zero, count: storage.rank)
+    startIndices[axis] = Tensor<Int32>(Int32(count), on: storage.device)
+    storage = _RawXLA.dynamicUpdateSlice(storage, newValues, startIndices)
+    count = newCount
+  }
+
+  private static func bucketedCapacity(_ size: Int) -> Int {
+    var capacity = 1
+    while capacity < size { capacity *= 2 }
+    return capacity
+  }
+}
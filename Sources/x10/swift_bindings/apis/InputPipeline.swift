@@ -0,0 +1,99 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// The last stage of a host input pipeline, collating samples into batches and uploading them
+/// ahead of the training steps consuming them.
+///
+/// Collating the samples on the producing thread, then copying every tensor of the batch to the
+/// device, serializes the input pipeline with the host work of the steps. The pipeline instead
+/// collates every batch on the X10 IO thread pool, several workers copying disjoint ranges of
+/// samples into the staging buffers of the batch, whose uploads start right away with the layout
+/// of the device. At most `depth` batches are queued ahead of `dequeue()`, so a producer running
+/// on its own thread blocks once it is that far ahead, and the steps only wait for the uploads
+/// their graphs read.
+public final class _XLAInputPipeline {
+  /// A tensor of every batch, with the batch as dimension 0.
+  public struct Field {
+    let scalarType: XLATensorScalarType
+    /// The shape of the field of a sample.
+    public let sampleShape: TensorShape
+
+    public init<Scalar: TensorFlowScalar>(_ type: Scalar.Type, sampleShape: TensorShape) {
+      self.scalarType = Scalar.xlaTensorScalarType
+      self.sampleShape = sampleShape
+    }
+  }
+
+  /// The tensors of a batch, one per field.
+  public struct Batch {
+    fileprivate let tensors: [XLATensor]
+
+    /// The number of fields.
+    public var count: Int { tensors.count }
+
+    /// Returns the tensor of the field at `index`, whose scalar type must be `Scalar`.
+    public func tensor<Scalar: TensorFlowScalar>(
+      _ index: Int, as type: Scalar.Type = Scalar.self
+    ) -> Tensor<Scalar> {
+      precondition(
+        tensors[index].dtype == Scalar.xlaTensorScalarType,
+        "Field \(index) does not have scalar type \(Scalar.self)")
+      return Tensor(_xla: tensors[index])
+    }
+  }
+
+  /// The fields of every batch.
+  public let fields: [Field]
+  private let handle: UnsafeMutablePointer<XLAInputPipeline>
+
+  /// Creates a pipeline uploading batches of `fields` to `device`, keeping at most `depth` of
+  /// them queued ahead of `dequeue()`.
+  public init(fields: [Field], on device: Device, depth: Int = 2) {
+    precondition(!fields.isEmpty, "A batch needs at least one field")
+    precondition(depth > 0, "The pipeline needs to queue at least one batch")
+    self.fields = fields
+    let types = fields.map { $0.scalarType }
+    let sampleDims = fields.flatMap { $0.sampleShape.dimensions }
+    let ranks = fields.map { $0.sampleShape.rank }
+    handle = makeInputPipeline(types, sampleDims, ranks, fields.count, device.cdevice, depth)
+  }
+
+  deinit {
+    destroyInputPipeline(handle)
+  }
+
+  /// Collates `samples` into a batch and queues it, blocking while `depth` batches are queued
+  /// already. `samples[i][j]` points to the contiguous scalars of field `j` of sample `i`, which
+  /// only need to stay valid during the call.
+  public func enqueue(_ samples: [[UnsafeRawPointer]]) {
+    precondition(!samples.isEmpty, "A batch needs at least one sample")
+    precondition(
+      samples.allSatisfy { $0.count == fields.count },
+      "Every sample must have \(fields.count) fields")
+    let pointers: [UnsafeRawPointer?] = samples.flatMap { $0 }
+    InputPipeline_enqueue(handle, pointers, samples.count)
+  }
+
+  /// Blocks until a batch is queued and returns it.
+  public func dequeue() -> Batch {
+    let tensorListHandle = InputPipeline_dequeue(handle)
+    defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+    return Batch(
+      tensors: (0..<tensorListHandle.size).map { i in
+        XLATensor(_handle: tensorListHandle.data[i]!)
+      })
+  }
+}
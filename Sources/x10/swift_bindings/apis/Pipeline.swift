@@ -0,0 +1,108 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// Runs a model split in stages, one per device, over the microbatches of a batch.
+///
+/// Every stage traces the ops of a microbatch on its own device, and the trace is cut by a
+/// non-blocking barrier right after, so the device starts running it while the host goes on
+/// tracing the other stages. The activations and their gradients move between the stages with
+/// `Tensor(copying:to:)`, which copies in the background once the producing graph ran, so stages
+/// working on different microbatches run at the same time.
+public struct _XLAPipeline {
+  /// A forward or backward pass of a stage over a microbatch.
+  public struct Step: Equatable {
+    public var microbatch: Int
+    public var isForward: Bool
+
+    public init(microbatch: Int, isForward: Bool) {
+      self.microbatch = microbatch
+      self.isForward = isForward
+    }
+  }
+
+  /// The devices of the stages, in pipeline order.
+  public let devices: [Device]
+
+  public init(devices: [Device]) {
+    precondition(!devices.isEmpty, "A pipeline needs at least one stage")
+    self.devices = devices
+  }
+
+  /// Returns the steps of every stage in the one forward one backward (1F1B) order: a stage
+  /// runs the forwards of as many microbatches as there are stages after it, then alternates a
+  /// forward and a backward, and drains the remaining backwards. This bounds the activations a
+  /// stage holds to the number of stages, rather than the number of microbatches.
+  public static func schedule(stageCount: Int, microbatchCount: Int) -> [[Step]] {
+    precondition(stageCount > 0 && microbatchCount > 0)
+    return (0..<stageCount).map { stage in
+      let warmup = min(stageCount - stage - 1, microbatchCount)
+      var steps = (0..<warmup).map { Step(microbatch: $0, isForward: true) }
+      var backward = 0
+      for forward in warmup..<microbatchCount {
+        steps.append(Step(microbatch: forward, isForward: true))
+        steps.append(Step(microbatch: backward, isForward: false))
+        backward += 1
+      }
+      steps += (backward..<microbatchCount).map { Step(microbatch: $0, isForward: false) }
+      return steps
+    }
+  }
+
+  /// Runs the forward and backward passes of every stage over the microbatches, in the 1F1B
+  /// order. The closures get the stage and microbatch indices, and are called on the host one
+  /// at a time: the forward of a stage after the one of the previous stage on that microbatch,
+  /// and its backward after the one of the following stage. The traced ops are expected on the
+  /// device of the stage, and the tensors handed to the next stage copied to its device.
+  public func run(
+    microbatchCount: Int,
+    forward: (_ stage: Int, _ microbatch: Int) -> Void,
+    backward: (_ stage: Int, _ microbatch: Int) -> Void
+  ) {
+    let schedule = _XLAPipeline.schedule(
+      stageCount: devices.count, microbatchCount: microbatchCount)
+    var next = [Int](repeating: 0, count: devices.count)
+    var forwardDone = [Int](repeating: 0, count: devices.count)
+    var backwardDone = [Int](repeating: 0, count: devices.count)
+    let lastStage = devices.count - 1
+    func isReady(_ stage: Int, _ step: Step) -> Bool {
+      if step.isForward {
+        return stage == 0 || forwardDone[stage - 1] > step.microbatch
+      }
+      return forwardDone[stage] > step.microbatch
+        && (stage == lastStage || backwardDone[stage + 1] > step.microbatch)
+    }
+    var remaining = schedule.reduce(0) { $0 + $1.count }
+    while remaining > 0 {
+      // Every round issues the next step of each stage whose inputs are traced, so the stages
+      // of a round work on different microbatches.
+      var issued = false
+      for stage in devices.indices where next[stage] < schedule[stage].count {
+        let step = schedule[stage][next[stage]]
+        guard isReady(stage, step) else { continue }
+        if step.isForward {
+          forward(stage, step.microbatch)
+          forwardDone[stage] += 1
+        } else {
+          backward(stage, step.microbatch)
+          backwardDone[stage] += 1
+        }
+        LazyTensorBarrier(on: devices[stage], wait: false)
+        next[stage] += 1
+        remaining -= 1
+        issued = true
+      }
+      precondition(issued, "The pipeline schedule is stuck")
+    }
+  }
+}
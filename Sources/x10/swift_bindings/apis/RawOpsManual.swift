@@ -635,6 +635,59 @@ public enum _RawXLA {
       dilations.map { Int64($0) })
   }
 
+  /// Computes `conv2D(input, filter)` followed by the addition of `bias` along the channel
+  /// dimension and, when `relu` is true, the ReLU activation, as a single X10 operation.
+  ///
+  /// The epilogue stays attached to the convolution so it can be fused into the convolution
+  /// output rather than materializing the intermediate results.
+  public static func conv2DBiasActivation<T: TensorFlowNumeric>(
+    _ input: Tensor<T>,
+    filter: Tensor<T>,
+    bias: Tensor<T>,
+    strides: [Int32],
+    padding: Padding1,
+    explicitPaddings: [Int32],
+    dataFormat: DataFormat = .nhwc,
+    dilations: [Int32] = [1, 1, 1, 1],
+    relu: Bool
+  ) -> Tensor<T> {
+    return tf_ConvBiasActivation(
+      input, filter, bias, false, strides.map { Int64($0) },
+      convertPadding1(padding),
+      explicitPaddings.map { Int64($0) }, convertDataFormat(dataFormat),
+      dilations.map { Int64($0) }, relu)
+  }
+
+  /// Computes `conv2D(input, filter)` with a filter quantized per output channel, as returned
+  /// by `quantizePerChannel(_:channelAxis:on:)` along its last axis.
+  ///
+  /// The filter is dequantized inside the convolution, so only its int8 values are read from
+  /// memory, and `scale` is applied to the output channels.
+  public static func conv2DQuantized<T: FloatingPoint & TensorFlowScalar>(
+    _ input: Tensor<T>,
+    filter: Tensor<Int8>,
+    scale: Tensor<T>,
+    strides: [Int32],
+    padding: Padding1,
+    explicitPaddings: [Int32],
+    dataFormat: DataFormat = .nhwc,
+    dilations: [Int32] = [1, 1, 1, 1]
+  ) -> Tensor<T> {
+    return tf_QuantizedConv(
+      input, filter, scale, false, strides.map { Int64($0) },
+      convertPadding1(padding),
+      explicitPaddings.map { Int64($0) }, convertDataFormat(dataFormat),
+      dilations.map { Int64($0) })
+  }
+
+  /// Computes `matmul(input, weight)` with a weight quantized per output channel, as returned
+  /// by `quantizePerChannel(_:channelAxis:on:)` along its last axis.
+  public static func quantizedMatmul<T: FloatingPoint & TensorFlowScalar>(
+    _ input: Tensor<T>, weight: Tensor<Int8>, scale: Tensor<T>
+  ) -> Tensor<T> {
+    return quantized_matmul(input, weight, scale)
+  }
+
   /// Computes the gradients of convolution with respect to the filter.
   ///
   /// - Parameters:
@@ -1706,7 +1759,7 @@ public enum _RawXLA {
     checkSamePrecision(grad.isReducedPrecision, origInput.isReducedPrecision)
     return Tensor(
       _xla: XLATensor.maxpool_grad(
-        origInput.xlaTensor, grad.xlaTensor, ksize.map { Int64($0) },
+        origInput.xlaTensor, origOutput.xlaTensor, grad.xlaTensor, ksize.map { Int64($0) },
         strides.map { Int64($0) }, convertPadding(padding)))
   }
 
@@ -1742,7 +1795,7 @@ public enum _RawXLA {
     checkSamePrecision(origInput, origOutput, grad)
     return Tensor(
       _xla: XLATensor.maxpool_grad(
-        origInput.xlaTensor, grad.xlaTensor, ksize,
+        origInput.xlaTensor, origOutput.xlaTensor, grad.xlaTensor, ksize,
         strides, convertPadding(padding)))
   }
   public static func maxPoolGradV2<T: TensorFlowNumeric>(
@@ -1758,7 +1811,7 @@ public enum _RawXLA {
     checkSamePrecision(origInput, origOutput, grad)
     return Tensor(
       _xla: XLATensor.maxpool_grad(
-        origInput.xlaTensor, grad.xlaTensor, ksize.scalars.map { Int64($0) },
+        origInput.xlaTensor, origOutput.xlaTensor, grad.xlaTensor, ksize.scalars.map { Int64($0) },
         strides.scalars.map { Int64($0) }, convertPadding(padding)))
   }
 
@@ -2869,24 +2922,36 @@ public enum _RawXLA {
     features: Tensor<T>,
     labels: Tensor<Tlabels>
   ) -> (loss: Tensor<T>, backprop: Tensor<T>) {
+    return sparseSoftmaxCrossEntropyWithLogits(
+      features: features, labels: labels, ignoreIndex: -1, labelSmoothing: 0)
+  }
+
+  /// Computes the softmax cross entropy cost and gradients to backpropagate, like
+  /// `sparseSoftmaxCrossEntropyWithLogits(features:labels:)`, in a single fused op which never
+  /// materializes the log-probabilities.
+  ///
+  /// - Parameters:
+  ///   - ignoreIndex: The label whose examples get a zero loss and backprop.
+  ///   - labelSmoothing: The weight moved from the label class to the uniform distribution over
+  ///     the classes, in the target distribution.
+  ///   - chunkSize: When positive and dividing the number of classes, the classes are reduced
+  ///     `chunkSize` at a time, which bounds the intermediate size for very large vocabularies.
+  public static func sparseSoftmaxCrossEntropyWithLogits<
+    T: FloatingPoint & TensorFlowScalar,
+    Tlabels: TensorFlowIndex
+  >(
+    features: Tensor<T>,
+    labels: Tensor<Tlabels>,
+    ignoreIndex: Int64,
+    labelSmoothing: Double,
+    chunkSize: Int64 = 0
+  ) -> (loss: Tensor<T>, backprop: Tensor<T>) {
+    defer { _fixLifetime(features) }
+    defer { _fixLifetime(labels) }
     checkSameDevice(features.device, labels.device)
-    let device = labels.device
-    let tmp_output = _RawXLA.logSoftmax(logits: features)
-    var one_hot = _RawXLA.neg(
-      _RawXLA.oneHot(
-        indices: labels, depth: Int64(features.shape[1]),
-        onValue: Tensor<T>(1, on: device),
-        offValue: Tensor<T>(0, on: device)))
-    if features.isReducedPrecision {
-      one_hot = one_hot.toReducedPrecision
-    }
-    let loss = _RawXLA.sum(
-      _RawXLA.mul(one_hot, tmp_output),
-      reductionIndices: [Int64(1)], keepDims: false)
-    // one_hot stands in for the backprop gradient as it has the right shape
-    // and will multiplied on the backwards pass.
-    let backprop = logSoftmaxBackward(gradOutput: one_hot, output: tmp_output, dim: -1)
-    return (loss: loss, backprop: backprop)
+    let outputs = XLATensor_softmax_cross_entropy(
+      features.xlaHandle, labels.xlaHandle, ignoreIndex, labelSmoothing, chunkSize)
+    return (loss: Tensor(_xlaHandle: outputs.x), backprop: Tensor(_xlaHandle: outputs.y))
   }
 
   /// Splits a tensor into `num_split` tensors along one dimension.
@@ -3416,37 +3481,25 @@ public enum _RawXLA {
       strides: strides.scalars.map { Int64($0) }, beginMask: Int32(beginMask),
       endMask: Int32(endMask), ellipsisMask: Int32(ellipsisMask), newAxisMask: Int32(newAxisMask),
       shrinkAxisMask: Int32(shrinkAxisMask))
-    var dimensionsToReverse: [Int64] = []
-    var sliceBegin: [Int64] = []
-    var sliceEnd: [Int64] = []
-    var sliceStrides: [Int64] = []
-    assert(
-      boundsAndStrides.begin.count == boundsAndStrides.end.count
-        && boundsAndStrides.begin.count == boundsAndStrides.strides.count)
-    for i in 0..<boundsAndStrides.begin.count {
-      if boundsAndStrides.strides[i] > 0 {
-        sliceBegin.append(boundsAndStrides.begin[i])
-        sliceEnd.append(Swift.max(boundsAndStrides.end[i], boundsAndStrides.begin[i]))
-        sliceStrides.append(boundsAndStrides.strides[i])
-      } else {
-        // Negative stride: swap begin and end, add 1 because the interval is semi-open, and mark
-        // the dimension to be reversed.
-        sliceBegin.append(Int64(input.shape.dimensions[i]) - boundsAndStrides.begin[i] - 1)
-        sliceEnd.append(
-          Swift.max(
-            Int64(input.shape.dimensions[i]) - boundsAndStrides.end[i] - 1,
-            Int64(input.shape.dimensions[i]) - boundsAndStrides.begin[i] - 1))
-        sliceStrides.append(-boundsAndStrides.strides[i])
-        dimensionsToReverse.append(Int64(i))
-      }
-    }
+    // Slice only the selected elements, then reverse the (smaller) result, and skip the steps
+    // which leave their input unchanged.
+    let inputSizes = input.shape.dimensions.map { Int64($0) }
     var result = input
-    if !dimensionsToReverse.isEmpty {
-      result = flip(result, dims: dimensionsToReverse)
+    if boundsAndStrides.sliceBegin.contains(where: { $0 != 0 })
+      || boundsAndStrides.sliceEnd != inputSizes
+      || boundsAndStrides.sliceStrides.contains(where: { $0 != 1 })
+    {
+      result = xlaSlice(
+        result, start_indices: boundsAndStrides.sliceBegin,
+        limit_indices: boundsAndStrides.sliceEnd, strides: boundsAndStrides.sliceStrides)
     }
-    result = xlaSlice(
-      result, start_indices: sliceBegin, limit_indices: sliceEnd, strides: sliceStrides)
-    return resize_value(result, dims: boundsAndStrides.finalSizes)
+    if !boundsAndStrides.reverseDims.isEmpty {
+      result = flip(result, dims: boundsAndStrides.reverseDims)
+    }
+    if boundsAndStrides.finalSizes != boundsAndStrides.processingSizes {
+      result = resize_value(result, dims: boundsAndStrides.finalSizes)
+    }
+    return result
   }
 
   /// Returns the gradient of `StridedSlice`.
@@ -3774,13 +3827,20 @@ public enum _RawXLA {
       data: data, segmentIds: segmentIds, numSegments: Int(numSegments.scalarized()))
   }
 
+  /// Computes the sum along segments of a tensor, like the overload above.
+  ///
+  /// When `indicesAreSorted` is true, the flattened `segmentIds` must be nondecreasing, and the
+  /// sums are computed with a segmented scan instead of a scatter, which serializes on repeated
+  /// indices on some devices. Unsorted `segmentIds` many times larger than `numSegments` are
+  /// sorted first, see `XLA_SEGMENT_SORT_RATIO`.
   public static func unsortedSegmentSum<
     T: TensorFlowNumeric,
     Tindices: TensorFlowIndex
   >(
     data: Tensor<T>,
     segmentIds: Tensor<Tindices>,
-    numSegments: Int
+    numSegments: Int,
+    indicesAreSorted: Bool = false
   ) -> Tensor<T> {
     checkSameDevice(data.device, segmentIds.device)
     if segmentIds.rank > data.rank {
@@ -3796,7 +3856,9 @@ public enum _RawXLA {
             + String(segmentIds.shape.dimensions[dim]))
       }
     }
-    return tf_UnsortedSegmentSum(data, indicies: segmentIds, numSegments: Int64(numSegments))
+    return tf_UnsortedSegmentSum(
+      data, indicies: segmentIds, numSegments: Int64(numSegments),
+      indicesAreSorted: indicesAreSorted)
   }
 
   /// Returns 0 if x == 0, and x / y otherwise, elementwise.
@@ -119,6 +119,11 @@ def node_type_define(op):
     raise ValueError(f"Problem: no such type: {stype}")
   def format_attr_init(arg):
     return f",\n        {arg[0]}_(std::move({arg[0]}))"
+  def format_attr_accessor(arg):
+    attr_type, attr_name = format_attr_define(arg).strip().rsplit(" ", 1)
+    if attr_type not in ("xla::int64", "bool", "float"):
+      attr_type = f"const {attr_type}&"
+    return f"  {attr_type} {arg[0]}() const {{ return {attr_name[:-1]}; }}\n"
 
   shape_fn = None # f"""{{}}\n#error no shape function for {op["op_node_name"]}\n"""
   def resolve_shape_fn(shape_fn):
@@ -146,22 +151,38 @@ def node_type_define(op):
 
   if "shape_fn" in op:
     shape_fn = resolve_shape_fn(op["shape_fn"])
+    # Ops producing the shape of an operand share its interned shape.
+    if shape_fn.endswith(".shape()"):
+      shape_fn = shape_fn[:-len("shape()")] + "interned_shape()"
+  # The analytic shape function is used when all the operand shapes are static,
+  # and the lowering on a throwaway builder otherwise.
+  analytic_shape_fn = ""
+  if "analytic_shape_fn" in op:
+    analytic_shape_fn = f"""       if (AllStaticShapes({", ".join(arg[0] for arg in tensor_args)})) {{
+         return {resolve_shape_fn(op["analytic_shape_fn"])};
+       }}
+"""
   if shape_fn == None:
     if op["n_results"] == 1:
       shape_fn = f"""[&]() {{
-       xla::XlaBuilder b("InferOutputShape");
+{analytic_shape_fn}       xla::XlaBuilder b("InferOutputShape");
 {"".join(param_convert(arg) for arg in tensor_args)}       xla::XlaOp result = {op["lower_fn"]}(
          {", ".join(format_shape_lower_arg(arg) for arg in op["args"])});
        return XlaHelpers::ShapeOfXlaOp(result);
      }}"""
     else:
       shape_fn = f"""[&]() {{
-       xla::XlaBuilder b("InferOutputShape");
+{analytic_shape_fn}       xla::XlaBuilder b("InferOutputShape");
 {"".join(param_convert(arg) for arg in tensor_args)}       auto results = {op["lower_fn"]}(
          {", ".join(format_shape_lower_arg(arg) for arg in op["args"])});
        return ShapeOfXlaOpList(results);
      }}"""
   num_outputs = op["n_results"]
+  # Composable nodes need their attributes to fold into the next node.
+  accessors = ""
+  if "compose_fn" in op:
+    accessors = "\n" + "".join(
+        format_attr_accessor(arg) for arg in attr_args if arg[0] != "shape")
   ctx = []
   if "needs_lowering_context" in [i[0] for i in op["extras"]]:
     ctx = ["loctx"]
@@ -207,7 +228,7 @@ class {op["op_node_name"]} : public Node {{
     ss << Node::ToString();
 {"".join(format_pretty_print(arg) for arg in attr_args)}    return ss.str();
   }}
-
+{accessors}
  private:
 {"".join(format_attr_define(arg) for arg in attr_args)}}};
 """
@@ -316,31 +337,43 @@ def c_function_define(op):
         f"""{op["c_name"]} has unsupported number of return values {op["n_results"]}"""
     )
 
-  def format_result(result_i=0, dtype=None):
+  def format_result(result_i=0, dtype=None, value=None):
     if not dtype:
       dtype = dtypes[result_i]
+    if not value:
+      value = f"swift_xla::ir::Value(result_node, {result_i})"
     if not dtype:
-      return (f"new "
-              f"swift_xla::XLATensor({first_tensor}->CreateFrom(swift_xla::ir::Value(result_node,"
-              f" {result_i})))")
+      return f"new swift_xla::XLATensor({first_tensor}->CreateFrom({value}))"
     if dtype in tensor_names:
-      return f"new swift_xla::XLATensor({dtype}->CreateFrom(swift_xla::ir::Value(result_node, {result_i})))"
+      return f"new swift_xla::XLATensor({dtype}->CreateFrom({value}))"
     result_dtype_arg = None
     for arg in args:
       if arg[0] == dtype:
         result_dtype_arg = arg
     if result_dtype_arg:
       return (f"new "
-              f"swift_xla::XLATensor({first_tensor}->CreateFrom(swift_xla::ir::Value(result_node,"
-              f" {result_i}), {format_arg_ref(result_dtype_arg)}))")
+              f"swift_xla::XLATensor({first_tensor}->CreateFrom({value},"
+              f" {format_arg_ref(result_dtype_arg)}))")
     return (f"new "
-            f"swift_xla::XLATensor({first_tensor}->CreateFrom(swift_xla::ir::Value(result_node,"
-            f" {result_i}), at::ScalarType::{dtype}))")
+            f"swift_xla::XLATensor({first_tensor}->CreateFrom({value},"
+            f" at::ScalarType::{dtype}))")
 
   prelude = f"""
 {result_type} XLATensor_{op["c_name"]}({", ".join(format_arg_def(arg) for arg in op["args"])}) {{
 {"".join(unpack_arg(arg) for arg in op["args"])}
   auto result_node = {node_ctor};"""
+  if "compose_fn" in op:
+    # The compose function folds the new node into the nodes it is applied to,
+    # and might return one of the existing values.
+    if op["n_results"] != 1:
+      raise ValueError(f"""{op["c_name"]} cannot have a compose_fn""")
+    return f"""
+{result_type} XLATensor_{op["c_name"]}({", ".join(format_arg_def(arg) for arg in op["args"])}) {{
+{"".join(unpack_arg(arg) for arg in op["args"])}
+  auto result_value = swift_xla::ir::ops::{op["compose_fn"]}({", ".join(format_arg_ref(arg) for arg in op["args"])});
+  return {format_result(0, value="result_value")};
+}}
+"""
   if op["n_results"] != 1:
     tuple_names = []
     if op["n_results"] == 2:
@@ -215,7 +215,17 @@ where
       pg.globals.map { globalInit in globalInit(pg.hyperparameters, device) }
     }
     var step = direction
-    let crsScale : Double? = crossReplicaSumCount.map { 1.0 / Double($0) }
+    if let crossReplicaSumCount = crossReplicaSumCount {
+      // Reducing all the gradients in one call lets them go in size bounded
+      // buckets, chained from the last weight, which overlap with the rest
+      // of the backward pass.
+      let keyPaths = kpPlan.allTensorKeyPaths
+      let grads = _Raw.crossReplicaSum(
+        keyPaths.map { step[keyPath: $0] }, 1.0 / Double(crossReplicaSumCount))
+      for (keyPath, grad) in zip(keyPaths, grads) {
+        step[keyPath: keyPath] = grad
+      }
+    }
     // step plays dual-duties as an inout parameter for efficiency.
     let _ = kpPlan.mapTensors(&step, model.differentiableVectorView) {
       (step: inout Tensor<Float>, weight: Tensor<Float>, i: Int) in
@@ -223,9 +233,6 @@ where
       let paramGroup = parameterGroups[selector]
       var state = OptimizerWeightStepState(
         globals: globals[selector], grad: step, weight: weight, weightId: i)
-      if let crsScale = crsScale {
-        state.grad = _Raw.crossReplicaSum([state.grad], crsScale).first!
-      }
       for cb in paramGroup.callbacks { cb(&state, &optimizerState) }
       step = state.step ?? Tensor<Float>(zerosLike: step)
     }
@@ -17,11 +17,15 @@
 #ifndef X10_XLA_CLIENT_ASYNC_TASK_H_
 #define X10_XLA_CLIENT_ASYNC_TASK_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
@@ -39,9 +43,13 @@ class AsyncTask {
     std::mutex mutex;
     std::condition_variable cv;
     bool scheduled = false;
+    bool started = false;
+    bool cancelled = false;
     bool completed = false;
     absl::optional<T> result;
     std::exception_ptr exptr;
+    // Run once the task completed, see Then().
+    std::vector<std::function<void()>> continuations;
   };
 
  public:
@@ -59,34 +67,72 @@ class AsyncTask {
   }
 
   AsyncTask& Schedule() {
-    auto completer = [data = data_]() {
-      absl::optional<T> result;
-      std::exception_ptr exptr;
-      try {
-        result = data->taskfn();
-      } catch (...) {
-        exptr = std::current_exception();
-      }
-
-      std::lock_guard<std::mutex> lock(data->mutex);
-      if (result) {
-        data->result = std::move(*result);
-      } else {
-        data->exptr = std::move(exptr);
-      }
-      data->completed = true;
-      data->cv.notify_all();
-    };
-
     {
       std::lock_guard<std::mutex> lock(data_->mutex);
       XLA_CHECK(!data_->scheduled);
       data_->scheduled = true;
     }
-    xla::env::ScheduleIoClosure(std::move(completer));
+    Enqueue(data_);
     return *this;
   }
 
+  // Returns a task which runs fn(*this) on the IO thread pool once this task
+  // completed, instead of having a thread blocked in Wait(). Within fn, Wait()
+  // returns at once, or rethrows the exception of this task. The returned task
+  // is already scheduled.
+  template <typename F>
+  auto Then(F fn) -> AsyncTask<decltype(fn(std::declval<AsyncTask&>()))> {
+    using U = decltype(fn(std::declval<AsyncTask&>()));
+    AsyncTask<U> next([self = *this, fn = std::move(fn)]() mutable -> U {
+      return fn(self);
+    });
+    next.MarkScheduled();
+    AddContinuation([next]() { AsyncTask<U>::Enqueue(next.data_); });
+    return next;
+  }
+
+  // Returns a task, already scheduled, which completes with the values of all
+  // the given tasks once they all completed, or with the exception of the
+  // first failed one among them.
+  static AsyncTask<std::vector<T>> WhenAll(std::vector<AsyncTask> tasks) {
+    auto pending = std::make_shared<std::atomic<size_t>>(tasks.size() + 1);
+    AsyncTask<std::vector<T>> all([tasks]() mutable {
+      std::vector<T> values;
+      values.reserve(tasks.size());
+      for (auto& task : tasks) {
+        values.push_back(task.Wait().GetValue());
+      }
+      return values;
+    });
+    all.MarkScheduled();
+    auto arrive = [pending, all]() {
+      if (pending->fetch_sub(1) == 1) {
+        AsyncTask<std::vector<T>>::Enqueue(all.data_);
+      }
+    };
+    for (auto& task : tasks) {
+      task.AddContinuation(arrive);
+    }
+    arrive();
+    return all;
+  }
+
+  // Cancels the task if it has not started running yet. A cancelled task
+  // completes with an error, which its continuations observe as well. Returns
+  // whether the task function will not run.
+  bool Cancel() {
+    std::lock_guard<std::mutex> lock(data_->mutex);
+    if (!data_->started) {
+      data_->cancelled = true;
+    }
+    return data_->cancelled;
+  }
+
+  bool IsCompleted() const {
+    std::lock_guard<std::mutex> lock(data_->mutex);
+    return data_->completed;
+  }
+
   const T& GetValue() const {
     std::lock_guard<std::mutex> lock(data_->mutex);
     return *data_->result;
@@ -98,6 +144,66 @@ class AsyncTask {
   }
 
  private:
+  template <typename U>
+  friend class AsyncTask;
+
+  void MarkScheduled() {
+    std::lock_guard<std::mutex> lock(data_->mutex);
+    data_->scheduled = true;
+  }
+
+  // Runs fn once the task completed, right away if it already did.
+  void AddContinuation(std::function<void()> fn) {
+    {
+      std::lock_guard<std::mutex> lock(data_->mutex);
+      if (!data_->completed) {
+        data_->continuations.push_back(std::move(fn));
+        return;
+      }
+    }
+    fn();
+  }
+
+  static void Enqueue(std::shared_ptr<Data> data) {
+    auto completer = [data = std::move(data)]() {
+      absl::optional<T> result;
+      std::exception_ptr exptr;
+      bool cancelled = false;
+      {
+        std::lock_guard<std::mutex> lock(data->mutex);
+        cancelled = data->cancelled;
+        data->started = true;
+      }
+      if (cancelled) {
+        exptr = std::make_exception_ptr(
+            std::runtime_error("Async task cancelled"));
+      } else {
+        try {
+          result = data->taskfn();
+        } catch (...) {
+          exptr = std::current_exception();
+        }
+      }
+
+      std::vector<std::function<void()>> continuations;
+      {
+        std::lock_guard<std::mutex> lock(data->mutex);
+        if (result) {
+          data->result = std::move(*result);
+        } else {
+          data->exptr = std::move(exptr);
+        }
+        data->completed = true;
+        data->cv.notify_all();
+        continuations.swap(data->continuations);
+      }
+      for (auto& continuation : continuations) {
+        continuation();
+      }
+    };
+    xla::env::ScheduleIoClosure(std::move(completer));
+  }
+
   std::shared_ptr<Data> data_;
 };
 
@@ -17,18 +17,30 @@
 #ifndef X10_XLA_CLIENT_CACHE_H_
 #define X10_XLA_CLIENT_CACHE_H_
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
 
 namespace xla {
 namespace util {
 
+// Snapshot of the lookup statistics of a cache.
+struct CacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+};
+
 // Generic key and object cache with LRU expiration policy. The objects of type
 // T will be stored as std::shared_ptr<T> and taken and returned as such, by the
 // cache API.
@@ -56,6 +68,7 @@ class Cache {
       Element* last = &element_list_.back();
       element_map_.erase(&last->first);
       element_list_.pop_back();
+      ++evictions_;
     }
     return emplace_result.first->second->second;
   }
@@ -68,8 +81,10 @@ class Cache {
     std::lock_guard<std::mutex> slock(lock_);
     auto it = element_map_.find(&key);
     if (it == element_map_.end()) {
+      ++misses_;
       return nullptr;
     }
+    ++hits_;
     DoLRU(it->second);
     return it->second->second;
   }
@@ -92,6 +107,15 @@ class Cache {
     element_list_.clear();
   }
 
+  CacheStats GetStats() {
+    std::lock_guard<std::mutex> slock(lock_);
+    CacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    return stats;
+  }
+
  private:
   using ElementList = std::list<Element>;
 
@@ -121,6 +145,326 @@ class Cache {
   size_t max_size_ = 0;
   ElementList element_list_;
   ElementMap element_map_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  size_t evictions_ = 0;
+};
+
+// Drop-in replacement for Cache, with the same API, meant for caches which are
+// hit concurrently by many threads. Keys are spread across independently
+// locked shards, and each shard uses the CLOCK approximation of LRU: a lookup
+// only sets a reference bit on the entry, instead of relinking it, and the
+// eviction hand gives referenced entries a second chance.
+template <typename K, typename T, typename H = std::hash<K>,
+          typename E = std::equal_to<K>>
+class ShardedCache {
+ public:
+  using TypePtr = std::shared_ptr<T>;
+
+  explicit ShardedCache(size_t max_size, size_t num_shards = 16)
+      : shards_(std::max<size_t>(std::min(num_shards, max_size), 1)) {
+    size_t shard_size = (max_size + shards_.size() - 1) / shards_.size();
+    for (auto& shard : shards_) {
+      shard.max_size = std::max<size_t>(shard_size, 1);
+    }
+  }
+
+  // Adds an object to the cache, unless it already exists, in which case the
+  // existing object is returned. If the shard the key maps to grows beyond its
+  // share of the maximum size, an object which has not been referenced since
+  // the last pass of the eviction hand is dropped.
+  TypePtr Add(K key, TypePtr object) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> slock(shard.lock);
+    auto it = shard.map.find(&key);
+    if (it != shard.map.end()) {
+      it->second->referenced.store(true, std::memory_order_relaxed);
+      return it->second->object;
+    }
+    if (shard.ring.size() >= shard.max_size) {
+      shard.Evict();
+      ++shard.evictions;
+    }
+    auto eit =
+        shard.ring.emplace(shard.hand, std::move(key), std::move(object));
+    shard.map.emplace(&eit->key, eit);
+    return eit->object;
+  }
+
+  // Retrieves the existing object if it exists, or nullptr otherwise.
+  TypePtr Get(const K& key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> slock(shard.lock);
+    auto it = shard.map.find(&key);
+    if (it == shard.map.end()) {
+      ++shard.misses;
+      return nullptr;
+    }
+    ++shard.hits;
+    it->second->referenced.store(true, std::memory_order_relaxed);
+    return it->second->object;
+  }
+
+  bool Erase(const K& key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> slock(shard.lock);
+    auto it = shard.map.find(&key);
+    if (it == shard.map.end()) {
+      return false;
+    }
+    shard.Remove(it);
+    return true;
+  }
+
+  void Clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> slock(shard.lock);
+      shard.map.clear();
+      shard.ring.clear();
+      shard.hand = shard.ring.end();
+    }
+  }
+
+  CacheStats GetStats() {
+    CacheStats stats;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> slock(shard.lock);
+      stats.hits += shard.hits;
+      stats.misses += shard.misses;
+      stats.evictions += shard.evictions;
+    }
+    return stats;
+  }
+
+ private:
+  struct Entry {
+    Entry(K key, TypePtr object)
+        : key(std::move(key)), object(std::move(object)) {}
+
+    K key;
+    TypePtr object;
+    std::atomic<bool> referenced{false};
+  };
+
+  using EntryRing = std::list<Entry>;
+
+  struct Hasher {
+    size_t operator()(const K* key) const { return hasher(*key); }
+
+    H hasher;
+  };
+
+  struct Equaler {
+    bool operator()(const K* k1, const K* k2) const {
+      return equaler(*k1, *k2);
+    }
+
+    E equaler;
+  };
+
+  using EntryMap = absl::flat_hash_map<const K*, typename EntryRing::iterator,
+                                       Hasher, Equaler>;
+
+  struct Shard {
+    // Advances the hand until it finds an entry with a clear reference bit,
+    // clearing the bits of the entries it passes over, and removes it.
+    void Evict() {
+      while (true) {
+        if (hand == ring.end()) {
+          hand = ring.begin();
+        }
+        if (!hand->referenced.exchange(false, std::memory_order_relaxed)) {
+          break;
+        }
+        ++hand;
+      }
+      Remove(map.find(&hand->key));
+    }
+
+    void Remove(typename EntryMap::iterator it) {
+      auto eit = it->second;
+      map.erase(it);
+      if (hand == eit) {
+        ++hand;
+      }
+      ring.erase(eit);
+    }
+
+    std::mutex lock;
+    size_t max_size = 0;
+    EntryRing ring;
+    typename EntryRing::iterator hand = ring.end();
+    EntryMap map;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+  };
+
+  Shard& GetShard(const K& key) {
+    // Use the high bits for the shard selection, as the low ones feed the
+    // bucket selection of the per shard hash map.
+    size_t hash = hasher_(key);
+    return shards_[(hash >> (sizeof(size_t) * 4)) % shards_.size()];
+  }
+
+  H hasher_;
+  std::vector<Shard> shards_;
+};
+
+// Cache with the same API as Cache, whose eviction policy accounts for how
+// expensive objects are to recreate, instead of recency alone. The W weigher
+// type must provide Cost(const T&) and Size(const T&) APIs, the latter
+// returning bytes. Entries are evicted by GreedyDual-Size-Frequency priority,
+// which is the entry access frequency times its cost per byte, plus an aging
+// term which rises to the priority of the last evicted entry, so that entries
+// which stop being accessed eventually lose to newer ones.
+// The cache is bounded by both an entry count and, if not zero, a byte budget.
+// As for ShardedCache, keys are spread across independently locked shards.
+template <typename K, typename T, typename W, typename H = std::hash<K>,
+          typename E = std::equal_to<K>>
+class CostAwareCache {
+ public:
+  using TypePtr = std::shared_ptr<T>;
+
+  explicit CostAwareCache(size_t max_size, size_t max_bytes = 0,
+                          size_t num_shards = 16)
+      : shards_(std::max<size_t>(std::min(num_shards, max_size), 1)) {
+    for (auto& shard : shards_) {
+      shard.max_size =
+          std::max<size_t>((max_size + shards_.size() - 1) / shards_.size(), 1);
+      shard.max_bytes = (max_bytes + shards_.size() - 1) / shards_.size();
+    }
+  }
+
+  // Adds an object to the cache, unless it already exists, in which case the
+  // existing object is returned. Adding an object can evict others, or even
+  // the object itself, if it does not fit within the byte budget.
+  TypePtr Add(K key, TypePtr object) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> slock(shard.lock);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      shard.Touch(&it->first, &it->second, weigher_);
+      return it->second.object;
+    }
+    auto emplace_result = shard.map.emplace(std::move(key), Entry());
+    Entry* entry = &emplace_result.first->second;
+    entry->object = std::move(object);
+    entry->size = std::max<size_t>(weigher_.Size(*entry->object), 1);
+    entry->priority_it = shard.priorities.end();
+    shard.bytes += entry->size;
+    shard.Touch(&emplace_result.first->first, entry, weigher_);
+    TypePtr result = entry->object;
+    while (shard.map.size() > shard.max_size ||
+           (shard.max_bytes > 0 && shard.bytes > shard.max_bytes)) {
+      shard.EvictOne();
+    }
+    return result;
+  }
+
+  // Retrieves the existing object if it exists, or nullptr otherwise.
+  TypePtr Get(const K& key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> slock(shard.lock);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      ++shard.misses;
+      return nullptr;
+    }
+    ++shard.hits;
+    shard.Touch(&it->first, &it->second, weigher_);
+    return it->second.object;
+  }
+
+  bool Erase(const K& key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> slock(shard.lock);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      return false;
+    }
+    shard.Remove(it);
+    return true;
+  }
+
+  void Clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> slock(shard.lock);
+      shard.priorities.clear();
+      shard.map.clear();
+      shard.bytes = 0;
+    }
+  }
+
+  CacheStats GetStats() {
+    CacheStats stats;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> slock(shard.lock);
+      stats.hits += shard.hits;
+      stats.misses += shard.misses;
+      stats.evictions += shard.evictions;
+    }
+    return stats;
+  }
+
+ private:
+  struct Entry;
+
+  using EntryMap = absl::node_hash_map<K, Entry, H, E>;
+  using PriorityMap = std::multimap<double, const K*>;
+
+  struct Entry {
+    TypePtr object;
+    size_t size = 0;
+    size_t frequency = 0;
+    typename PriorityMap::iterator priority_it;
+  };
+
+  struct Shard {
+    void Touch(const K* key, Entry* entry, const W& weigher) {
+      if (entry->priority_it != priorities.end()) {
+        priorities.erase(entry->priority_it);
+      }
+      entry->frequency += 1;
+      double priority = aging + static_cast<double>(entry->frequency) *
+                                    weigher.Cost(*entry->object) /
+                                    static_cast<double>(entry->size);
+      entry->priority_it = priorities.emplace(priority, key);
+    }
+
+    void EvictOne() {
+      auto pit = priorities.begin();
+      aging = pit->first;
+      ++evictions;
+      Remove(map.find(*pit->second));
+    }
+
+    void Remove(typename EntryMap::iterator it) {
+      priorities.erase(it->second.priority_it);
+      bytes -= it->second.size;
+      map.erase(it);
+    }
+
+    std::mutex lock;
+    size_t max_size = 0;
+    size_t max_bytes = 0;
+    size_t bytes = 0;
+    double aging = 0;
+    EntryMap map;
+    PriorityMap priorities;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+  };
+
+  Shard& GetShard(const K& key) {
+    size_t hash = hasher_(key);
+    return shards_[(hash >> (sizeof(size_t) * 4)) % shards_.size()];
+  }
+
+  H hasher_;
+  W weigher_;
+  std::vector<Shard> shards_;
 };
 
 }  // namespace util
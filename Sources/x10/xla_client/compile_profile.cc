@@ -0,0 +1,74 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/compile_profile.h"
+
+#include <algorithm>
+
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace xla {
+namespace metrics {
+
+CompileProfile* CompileProfile::Get() {
+  static CompileProfile* profile = new CompileProfile(
+      sys_util::GetEnvInt("XLA_COMPILE_PROFILE_SIZE", 256));
+  return profile;
+}
+
+CompileProfile::CompileProfile(size_t capacity) : capacity_(capacity) {}
+
+void CompileProfile::Record(CompileRecord record) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (capacity_ == 0) {
+    return;
+  }
+  if (records_.size() < capacity_) {
+    records_.push_back(std::move(record));
+  } else {
+    records_[next_] = std::move(record);
+  }
+  next_ = (next_ + 1) % capacity_;
+}
+
+std::vector<CompileRecord> CompileProfile::GetRecords() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (records_.size() < capacity_) {
+    return records_;
+  }
+  std::vector<CompileRecord> records(records_.begin() + next_, records_.end());
+  records.insert(records.end(), records_.begin(), records_.begin() + next_);
+  return records;
+}
+
+std::vector<CompileRecord> CompileProfile::GetSlowestRecords(
+    size_t count) const {
+  std::vector<CompileRecord> records = GetRecords();
+  count = std::min(count, records.size());
+  std::partial_sort(records.begin(), records.begin() + count, records.end(),
+                    [](const CompileRecord& r1, const CompileRecord& r2) {
+                      return r1.compile_time > r2.compile_time;
+                    });
+  records.resize(count);
+  return records;
+}
+
+void CompileProfile::Clear() {
+  std::lock_guard<std::mutex> lock(lock_);
+  records_.clear();
+  next_ = 0;
+}
+
+}  // namespace metrics
+}  // namespace xla
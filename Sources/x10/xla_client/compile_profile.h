@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_COMPILE_PROFILE_H_
+#define X10_XLA_CLIENT_COMPILE_PROFILE_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace xla {
+namespace metrics {
+
+struct CompileRecord {
+  hash_t hash;
+  std::string device;
+  int64 timestamp_ns = 0;
+  double compile_time = 0.0;
+  int64 hlo_instructions = 0;
+  size_t emitted_nodes = 0;
+  // The call-site frames of the code which triggered the compilation.
+  std::string frames;
+  // Only captured for compilations above XLA_COMPILE_TIME_THRESHOLD.
+  std::string hlo_text;
+};
+
+// Bounded table of the most recent compilations. Once XLA_COMPILE_PROFILE_SIZE
+// records have been stored, new records overwrite the oldest ones.
+class CompileProfile {
+ public:
+  static CompileProfile* Get();
+
+  explicit CompileProfile(size_t capacity);
+
+  void Record(CompileRecord record);
+
+  // Returns the stored records, oldest first.
+  std::vector<CompileRecord> GetRecords() const;
+
+  // Returns up to count stored records sorted by decreasing compile time.
+  std::vector<CompileRecord> GetSlowestRecords(size_t count) const;
+
+  void Clear();
+
+ private:
+  mutable std::mutex lock_;
+  size_t capacity_;
+  size_t next_ = 0;
+  std::vector<CompileRecord> records_;
+};
+
+}  // namespace metrics
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_COMPILE_PROFILE_H_
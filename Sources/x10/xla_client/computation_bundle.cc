@@ -0,0 +1,116 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/computation_bundle.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/util.h"
+
+namespace xla {
+namespace util {
+namespace {
+
+// Every entry is a text header line, followed by the serialized HLO module and
+// result shape protos, whose sizes are in the header.
+void WriteEntry(const ComputationBundleEntry& entry, std::ofstream* file) {
+  std::string computation = entry.computation.proto().SerializeAsString();
+  std::string shape = entry.result_shape.ToProto().SerializeAsString();
+  *file << absl::Uint128High64(entry.hash) << " "
+        << absl::Uint128Low64(entry.hash) << " " << entry.device << " "
+        << entry.emitted_nodes << " " << computation.size() << " "
+        << shape.size() << "\n";
+  file->write(computation.data(), computation.size());
+  file->write(shape.data(), shape.size());
+}
+
+bool ReadBytes(std::ifstream* file, size_t size, std::string* bytes) {
+  bytes->resize(size);
+  return static_cast<bool>(file->read(&(*bytes)[0], size));
+}
+
+}  // namespace
+
+Status WriteComputationBundle(
+    const std::string& path, const std::string& fingerprint,
+    absl::Span<const ComputationBundleEntry> entries) {
+  std::string tmp_path = absl::StrCat(path, ".tmp.", getpid());
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file << fingerprint << "\n" << entries.size() << "\n";
+    for (auto& entry : entries) {
+      WriteEntry(entry, &file);
+    }
+    if (!file) {
+      file.close();
+      std::remove(tmp_path.c_str());
+      return InternalError("Unable to write computation bundle %s",
+                           tmp_path);
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return InternalError("Unable to publish computation bundle %s", path);
+  }
+  return Status::OK();
+}
+
+StatusOr<std::vector<ComputationBundleEntry>> ReadComputationBundle(
+    const std::string& path, const std::string& fingerprint) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return NotFound("Unable to open computation bundle %s", path);
+  }
+  std::string file_fingerprint;
+  std::getline(file, file_fingerprint);
+  if (file_fingerprint != fingerprint) {
+    return FailedPrecondition(
+        "Computation bundle %s has been produced by another build: %s", path,
+        file_fingerprint);
+  }
+  size_t count = 0;
+  file >> count;
+  std::vector<ComputationBundleEntry> entries(count);
+  for (auto& entry : entries) {
+    uint64 hash_high = 0;
+    uint64 hash_low = 0;
+    size_t computation_size = 0;
+    size_t shape_size = 0;
+    file >> hash_high >> hash_low >> entry.device >> entry.emitted_nodes >>
+        computation_size >> shape_size;
+    // Skip the newline ending the header.
+    file.get();
+    std::string computation;
+    std::string shape;
+    HloModuleProto computation_proto;
+    ShapeProto shape_proto;
+    if (!file || !ReadBytes(&file, computation_size, &computation) ||
+        !ReadBytes(&file, shape_size, &shape) ||
+        !computation_proto.ParseFromString(computation) ||
+        !shape_proto.ParseFromString(shape)) {
+      return DataLoss("Malformed computation bundle %s", path);
+    }
+    entry.hash = absl::MakeUint128(hash_high, hash_low);
+    entry.computation = XlaComputation(std::move(computation_proto));
+    entry.result_shape = Shape(shape_proto);
+  }
+  return std::move(entries);
+}
+
+}  // namespace util
+}  // namespace xla
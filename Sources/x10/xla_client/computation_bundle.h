@@ -0,0 +1,59 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_COMPUTATION_BUNDLE_H_
+#define X10_XLA_CLIENT_COMPUTATION_BUNDLE_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace xla {
+namespace util {
+
+// A computation of a traced graph, as exported for serving.
+struct ComputationBundleEntry {
+  // The graph hash the computation cache looks the computation up with.
+  hash_t hash;
+  std::string device;
+  XlaComputation computation;
+  // The result shape, with the layout the device compiled it with.
+  Shape result_shape;
+  size_t emitted_nodes = 0;
+};
+
+// Writes the entries into a single file at path, tagged with the fingerprint
+// of the backend which produced them. Like the persistent cache entries, the
+// file is written to a temporary path first and then renamed into place.
+Status WriteComputationBundle(const std::string& path,
+                              const std::string& fingerprint,
+                              absl::Span<const ComputationBundleEntry> entries);
+
+// Reads the entries written by WriteComputationBundle(). Fails if the file is
+// malformed, or if it has been produced by a backend with another fingerprint.
+StatusOr<std::vector<ComputationBundleEntry>> ReadComputationBundle(
+    const std::string& path, const std::string& fingerprint);
+
+}  // namespace util
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_COMPUTATION_BUNDLE_H_
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <string>
@@ -27,6 +28,7 @@
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/core/util/device_name_utils.h"
 
@@ -220,9 +222,207 @@ ComputationClient::Device* GetX10Device(swift_xla::Device device_id) {
   return GetX10Device(device_id.ToString());
 }
 
+std::vector<ComputationClient::DataPtr>
+ComputationClient::Device::TransferToServerAsync(
+    std::vector<TensorSource> tensors) {
+  std::vector<DataPtr> placeholders;
+  placeholders.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    placeholders.push_back(CreateDataPlaceholder(tensor.shape));
+  }
+  XLA_COUNTER("AsyncTransfers", tensors.size());
+  auto transfer_fn = [this, tensors = std::move(tensors), placeholders]() {
+    std::vector<DataPtr> handles = TransferToServer(tensors);
+    for (size_t i = 0; i < handles.size(); ++i) {
+      placeholders[i]->Assign(*handles[i]);
+    }
+  };
+  ScheduleTransfer(placeholders, std::move(transfer_fn));
+  return placeholders;
+}
+
+ComputationClient::DataPtr ComputationClient::Device::TransferFromDeviceAsync(
+    DataPtr data, std::function<void()> wait_fn) {
+  XLA_CHECK(CanTransferFromDevice(*data->device()))
+      << "Unable to copy from " << data->device()->name() << " to " << name();
+  DataPtr placeholder = CreateDataPlaceholder(data->shape());
+  auto transfer_fn = [this, data = std::move(data),
+                      wait_fn = std::move(wait_fn), placeholder]() {
+    wait_fn();
+    data->device()->WaitForTransfers({data});
+    placeholder->Assign(*TransferFromDevice(data));
+  };
+  ScheduleTransfer({placeholder}, std::move(transfer_fn));
+  XLA_COUNTER("DeviceToDeviceTransfers", 1);
+  return placeholder;
+}
+
+ComputationClient::DataPtr ComputationClient::Device::TransferFromDevice(
+    const DataPtr& data) {
+  XLA_ERROR() << "Direct copies to " << name() << " are not supported";
+}
+
+std::string ComputationClient::Device::ExportData(const DataPtr& data) {
+  XLA_ERROR() << "Exporting the data of " << name() << " is not supported";
+}
+
+void ComputationClient::Device::UnexportData(const std::string& handle) {
+  XLA_ERROR() << "Exporting the data of " << name() << " is not supported";
+}
+
+ComputationClient::DataPtr ComputationClient::Device::ImportData(
+    const std::string& handle, const Shape& shape) {
+  XLA_ERROR() << "Importing data into " << name() << " is not supported";
+}
+
+void ComputationClient::Device::ScheduleTransfer(
+    std::vector<DataPtr> placeholders, std::function<void()> transfer_fn) {
+  auto done = std::make_shared<util::MultiWait>(1);
+  {
+    std::lock_guard<std::mutex> lock(transfers_mutex_);
+    for (auto& placeholder : placeholders) {
+      pending_transfers_.emplace(placeholder.get(), done);
+    }
+    num_pending_transfers_ += placeholders.size();
+  }
+  auto cleanup_fn = [this, placeholders = std::move(placeholders),
+                     transfer_fn = done->Completer(std::move(transfer_fn))]() {
+    transfer_fn();
+    std::lock_guard<std::mutex> lock(transfers_mutex_);
+    for (auto& placeholder : placeholders) {
+      pending_transfers_.erase(placeholder.get());
+    }
+    num_pending_transfers_ -= placeholders.size();
+  };
+  env::ScheduleIoClosure(std::move(cleanup_fn));
+}
+
+struct ComputationClient::Device::DeferredTransfers {
+  std::vector<TensorSource> tensors;
+  std::vector<DataPtr> placeholders;
+};
+
+ComputationClient::DataPtr ComputationClient::Device::TransferToServerDeferred(
+    TensorSource tensor) {
+  DataPtr placeholder = CreateDataPlaceholder(tensor.shape);
+  std::lock_guard<std::mutex> lock(deferred_mutex_);
+  if (deferred_transfers_ == nullptr) {
+    deferred_transfers_ = std::make_shared<DeferredTransfers>();
+  }
+  deferred_transfers_->tensors.push_back(std::move(tensor));
+  deferred_transfers_->placeholders.push_back(placeholder);
+  ++num_deferred_transfers_;
+  return placeholder;
+}
+
+void ComputationClient::Device::FlushDeferredTransfers() {
+  // The lock is held during the transfer, so that concurrent waiters do not
+  // get past the placeholders before the data is assigned to them.
+  std::lock_guard<std::mutex> lock(deferred_mutex_);
+  if (num_deferred_transfers_.load() == 0) {
+    return;
+  }
+  DeferredTransfers transfers = std::move(*deferred_transfers_);
+  deferred_transfers_->tensors.clear();
+  deferred_transfers_->placeholders.clear();
+  num_deferred_transfers_ = 0;
+  XLA_VALUE_METRIC("DeferredTransferBatchSize", transfers.tensors.size());
+  std::vector<DataPtr> handles = TransferToServer(transfers.tensors);
+  XLA_CHECK_EQ(handles.size(), transfers.placeholders.size());
+  for (size_t i = 0; i < handles.size(); ++i) {
+    transfers.placeholders[i]->Assign(*handles[i]);
+  }
+}
+
+void ComputationClient::Device::ExecuteComputationPipelined(
+    ComputationPtr computation, std::vector<DataPtr> arguments,
+    std::vector<DataPtr> outputs, const ExecuteComputationOptions& options) {
+  auto done = std::make_shared<util::MultiWait>(1);
+  {
+    std::lock_guard<std::mutex> lock(transfers_mutex_);
+    for (auto& output : outputs) {
+      pending_transfers_.emplace(output.get(), done);
+    }
+    num_pending_transfers_ += outputs.size();
+  }
+  XLA_COUNTER("PipelinedExecutions", 1);
+  auto execute_fn = [this, computation = std::move(computation),
+                     arguments = std::move(arguments), outputs,
+                     options]() {
+    std::vector<DataPtr> results =
+        ExecuteComputation(*computation, arguments, options);
+    XLA_CHECK_EQ(results.size(), outputs.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+      outputs[i]->Assign(*results[i]);
+    }
+  };
+  auto cleanup_fn = [this, outputs = std::move(outputs),
+                     execute_fn = done->Completer(std::move(execute_fn))]() {
+    execute_fn();
+    std::lock_guard<std::mutex> lock(transfers_mutex_);
+    for (auto& output : outputs) {
+      pending_transfers_.erase(output.get());
+    }
+    num_pending_transfers_ -= outputs.size();
+  };
+
+  // A single drainer at a time runs the enqueued executions, in order. Waiting
+  // on the previous execution from a pool thread instead could deadlock, as
+  // waiting threads run other queued closures.
+  {
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    pipeline_.push_back(std::move(cleanup_fn));
+    if (pipeline_running_) {
+      return;
+    }
+    pipeline_running_ = true;
+  }
+  env::ScheduleIoClosure([this]() {
+    for (;;) {
+      std::function<void()> fn;
+      {
+        std::lock_guard<std::mutex> lock(pipeline_mutex_);
+        if (pipeline_.empty()) {
+          pipeline_running_ = false;
+          return;
+        }
+        fn = std::move(pipeline_.front());
+        pipeline_.pop_front();
+      }
+      fn();
+    }
+  });
+}
+
+void ComputationClient::Device::WaitForTransfers(
+    absl::Span<const DataPtr> data) {
+  if (num_deferred_transfers_.load() > 0) {
+    FlushDeferredTransfers();
+  }
+  if (num_pending_transfers_.load() == 0) {
+    return;
+  }
+  std::vector<std::shared_ptr<util::MultiWait>> waits;
+  {
+    std::lock_guard<std::mutex> lock(transfers_mutex_);
+    for (auto& item : data) {
+      auto it = pending_transfers_.find(item.get());
+      if (it != pending_transfers_.end()) {
+        waits.push_back(it->second);
+      }
+    }
+  }
+  for (auto& wait : waits) {
+    wait->Wait();
+  }
+}
+
 std::vector<Literal> ComputationClient::TransferFromServer(
     absl::Span<const DataPtr> handles) {
   if (handles.empty()) return {};
+  for (auto& handle : handles) {
+    handle->device()->WaitForTransfers({handle});
+  }
   TransferManager* transfer = handles[0]->device()->GetTransferManager();
   for (auto& handle : handles) {
     XLA_CHECK_EQ(transfer, handle->device()->GetTransferManager());
@@ -230,6 +430,56 @@ std::vector<Literal> ComputationClient::TransferFromServer(
   return transfer->TransferFromServerImpl(handles);
 }
 
+void ComputationClient::TransferFromServerStreaming(
+    absl::Span<const DataPtr> handles, size_t max_host_bytes,
+    const TransferManager::DestinationFn& destination_fn,
+    const TransferManager::ConsumerFn& consumer_fn) {
+  if (handles.empty()) return;
+  for (auto& handle : handles) {
+    handle->device()->WaitForTransfers({handle});
+  }
+  TransferManager* transfer = handles[0]->device()->GetTransferManager();
+  for (auto& handle : handles) {
+    XLA_CHECK_EQ(transfer, handle->device()->GetTransferManager());
+  }
+  transfer->TransferFromServerStreamingImpl(handles, max_host_bytes,
+                                            destination_fn, consumer_fn);
+}
+
+void ComputationClient::TransferManager::TransferFromServerStreamingImpl(
+    absl::Span<const DataPtr> handles, size_t max_host_bytes,
+    const DestinationFn& destination_fn, const ConsumerFn& consumer_fn) {
+  size_t start = 0;
+  while (start < handles.size()) {
+    size_t end = start;
+    size_t window_bytes = 0;
+    for (; end < handles.size(); ++end) {
+      size_t size = ShapeUtil::ByteSizeOf(handles[end]->shape());
+      if (end > start && window_bytes + size > max_host_bytes) {
+        break;
+      }
+      window_bytes += size;
+    }
+    std::vector<Literal> literals =
+        TransferFromServerImpl(handles.subspan(start, end - start));
+    for (size_t i = 0; i < literals.size(); ++i) {
+      Literal literal = literals[i].Relayout(
+          LayoutUtil::GetDefaultLayoutForShape(literals[i].shape()));
+      literals[i] = Literal();
+      size_t size = literal.size_bytes();
+      void* dest =
+          destination_fn ? destination_fn(start + i, literal.shape()) : nullptr;
+      if (dest != nullptr) {
+        std::memcpy(dest, literal.untyped_data(), size);
+        consumer_fn(start + i, dest, size);
+      } else {
+        consumer_fn(start + i, literal.untyped_data(), size);
+      }
+    }
+    start = end;
+  }
+}
+
 ComputationClient::DataPtr ComputationClient::Device::TransferToServer(
     xla::BorrowingLiteral literal, const xla::Shape& dest_shape) {
   TF_LOG(FATAL) << "Only supported for LocalClient";
@@ -239,6 +489,12 @@ std::map<std::string, Metric> ComputationClient::ReadMetrics() {
   return Get()->GetMetrics();
 }
 
+bool ComputationClient::PipelinedExecution() {
+  static const bool pipelined_execution =
+      sys_util::GetEnvBool("XLA_PIPELINED_EXECUTION", false);
+  return pipelined_execution;
+}
+
 ComputationClient::Device* ComputationClient::DefaultDevice() {
   auto* client = Get();
   return client->GetDevice(client->GetDefaultDevice());
@@ -255,6 +511,29 @@ const std::vector<std::string>& ComputationClient::GetReplicationDevices() {
   return g_replication_devices;
 }
 
+std::vector<std::vector<int64>> ComputationClient::GetReplicaHostGroups() {
+  const std::vector<std::string>& devices = GetReplicationDevices();
+  std::vector<std::vector<int64>> groups;
+  std::map<std::string, size_t> host_groups;
+  for (size_t i = 0; i < devices.size(); ++i) {
+    std::string host = Get()->GetDevice(devices[i])->host();
+    auto it = host_groups.emplace(host, groups.size()).first;
+    if (it->second == groups.size()) {
+      groups.emplace_back();
+    }
+    groups[it->second].push_back(i);
+  }
+  if (groups.size() < 2) {
+    return {};
+  }
+  for (auto& group : groups) {
+    if (group.size() != groups.front().size()) {
+      return {};
+    }
+  }
+  return groups;
+}
+
 swift_xla::Device ComputationClient::DefaultDeviceStruct() {
   return Get()->GetDefaultDeviceStruct();
 }
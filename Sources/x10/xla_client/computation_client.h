@@ -18,21 +18,29 @@
 #define X10_XLA_CLIENT_COMPUTATION_CLIENT_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "absl/container/node_hash_map.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/memory_accounting.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/types.h"
 #include "tensorflow/compiler/xla/client/xla_computation.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
 
 namespace xla {
 
@@ -49,10 +57,28 @@ class ComputationClient {
 
   class TransferManager {
    public:
+    // Returns the host memory the tensor at the given index should be written
+    // to, in the dim0-major layout of the given shape, or nullptr to have the
+    // transfer allocate it.
+    using DestinationFn = std::function<void*(size_t, const Shape&)>;
+    // Consumes the tensor at the given index, given as the host memory holding
+    // it, and its size. The memory is only valid during the call, unless it
+    // was returned by the DestinationFn.
+    using ConsumerFn = std::function<void(size_t, const void*, size_t)>;
+
     virtual ~TransferManager() {}
 
     virtual std::vector<Literal> TransferFromServerImpl(
         absl::Span<const DataPtr> handles) = 0;
+
+    // Transfers the handles to the host keeping at most max_host_bytes of them
+    // in flight (while always allowing one), and calls consumer_fn on each of
+    // them, possibly concurrently and out of order, as soon as it is available.
+    // The default implementation transfers windows of handles with
+    // TransferFromServerImpl().
+    virtual void TransferFromServerStreamingImpl(
+        absl::Span<const DataPtr> handles, size_t max_host_bytes,
+        const DestinationFn& destination_fn, const ConsumerFn& consumer_fn);
   };
 
   class Device {
@@ -76,6 +102,57 @@ class ComputationClient {
     virtual std::vector<DataPtr> TransferToServer(
         absl::Span<const TensorSource> tensors) = 0;
 
+    // Starts transferring the tensors in the background, on the IO thread
+    // pool, and returns placeholders which get the transferred data assigned
+    // once done. The tensors populate_fn and data must stay valid until then.
+    // Computations and transfers back to the host using the placeholders wait
+    // for the transfer with WaitForTransfers().
+    std::vector<DataPtr> TransferToServerAsync(
+        std::vector<TensorSource> tensors);
+
+    // Queues the tensor for a transfer batched with the other deferred ones,
+    // and returns a placeholder which gets the data assigned once the batch is
+    // sent, as a single TransferToServer() call. The batch is sent by the
+    // first WaitForTransfers() following the call, so computations and
+    // transfers back to the host using the placeholder see the data.
+    DataPtr TransferToServerDeferred(TensorSource tensor);
+
+    // Sends the deferred transfers, if any.
+    void FlushDeferredTransfers();
+
+    // Starts copying data, held by another device, to this one in the
+    // background, once wait_fn returns, without going through the host.
+    // Returns a placeholder like TransferToServerAsync() does. Must only be
+    // called when CanTransferFromDevice() holds for the device of data.
+    DataPtr TransferFromDeviceAsync(DataPtr data,
+                                    std::function<void()> wait_fn);
+
+    // Whether the array data of the source device can be copied to this one
+    // directly, like between GPUs with peer access.
+    virtual bool CanTransferFromDevice(const Device& source) { return false; }
+
+    // Copies the array data, held by another device, to this one. The data
+    // must be ready.
+    virtual DataPtr TransferFromDevice(const DataPtr& data);
+
+    // Blocks until the background transfers, if any, targeting the given data
+    // are done.
+    void WaitForTransfers(absl::Span<const DataPtr> data);
+
+    // Exports the array data, which must be ready, for the other processes of
+    // the host to import with ImportData() without a copy, and returns the
+    // handle they import it with. The exports of the same data are counted,
+    // and keep it alive until as many UnexportData() calls, which must wait
+    // for the importers to be done with it.
+    virtual std::string ExportData(const DataPtr& data);
+
+    virtual void UnexportData(const std::string& handle);
+
+    // Imports the data exported by another process with ExportData(), given
+    // its shape. The shared data, exported or imported, is never donated to
+    // the outputs of the computations.
+    virtual DataPtr ImportData(const std::string& handle, const Shape& shape);
+
     // Copies a single tensor in the form of a xla::BorrowingLiteral async to
     // the TPU. The literal is copied to a temporary buffer and then copied
     // async as per the semantics of TransferLiteralToDeviceAsync. The next
@@ -95,11 +172,50 @@ class ComputationClient {
         const Computation& computation, absl::Span<const DataPtr> arguments,
         const ExecuteComputationOptions& options) = 0;
 
+    // Enqueues the execution of the computation behind the ones previously
+    // enqueued on this device, and returns right away. The outputs must be
+    // placeholders created by CreateDataPlaceholder(), and get the results
+    // assigned once the execution is done. Computations and transfers using
+    // them wait for it with WaitForTransfers().
+    void ExecuteComputationPipelined(ComputationPtr computation,
+                                     std::vector<DataPtr> arguments,
+                                     std::vector<DataPtr> outputs,
+                                     const ExecuteComputationOptions& options);
+
     virtual bool IsLocal() { return false; }
 
+    // Adds the metrics specific to this device to metrics.
+    virtual void GetMetrics(std::map<std::string, Metric>* metrics) {}
+
+    // Returns the bytes of device memory held by live buffers, and the bytes
+    // of memory of the device, or -1 when the device does not track them.
+    virtual int64 GetMemoryInUse() { return -1; }
+    virtual int64 GetMemoryLimit() { return -1; }
+
+    // Identifies the host the device is attached to. Devices of the same host
+    // share a faster interconnect than the one across hosts.
+    virtual std::string host() const { return ""; }
+
    private:
+    struct DeferredTransfers;
+
+    // Runs transfer_fn on the IO thread pool, with the placeholders registered
+    // as pending until it returns.
+    void ScheduleTransfer(std::vector<DataPtr> placeholders,
+                          std::function<void()> transfer_fn);
+
     std::string name_;
     swift_xla::Device device_id_;
+    std::mutex deferred_mutex_;
+    std::atomic<size_t> num_deferred_transfers_{0};
+    std::shared_ptr<DeferredTransfers> deferred_transfers_;
+    std::mutex transfers_mutex_;
+    std::atomic<size_t> num_pending_transfers_{0};
+    std::unordered_map<const Data*, std::shared_ptr<util::MultiWait>>
+        pending_transfers_;
+    std::mutex pipeline_mutex_;
+    std::deque<std::function<void()>> pipeline_;
+    bool pipeline_running_ = false;
   };
   class Data {
    public:
@@ -109,8 +225,21 @@ class ComputationClient {
 
     using OpaqueHandle = int64;
 
+    // Describes the data holding this device's shard of a tensor partitioned
+    // across the devices of SPMD computations.
+    struct Sharding {
+      OpSharding sharding;
+      // The shape of the whole tensor.
+      Shape shape;
+    };
+
     Data(Device* device, Shape shape)
-        : device_(std::move(device)), shape_(std::move(shape)) {}
+        : device_(std::move(device)),
+          shape_(std::move(shape)),
+          memory_(metrics::MemoryAccounting::Get()->Track(
+              device_ != nullptr ? device_->name() : std::string(),
+              metrics::MemoryKind::kActivation,
+              metrics::ShapeMemoryBytes(shape_))) {}
 
     virtual ~Data() {}
 
@@ -120,6 +249,14 @@ class ComputationClient {
 
     Info* info() const { return info_.get(); }
 
+    const std::shared_ptr<const Sharding>& sharding() const {
+      return sharding_;
+    }
+
+    void set_sharding(std::shared_ptr<const Sharding> sharding) {
+      sharding_ = std::move(sharding);
+    }
+
     std::shared_ptr<Info> SetInfo(std::shared_ptr<Info> info) {
       std::swap(info, info_);
       return info;
@@ -131,10 +268,24 @@ class ComputationClient {
 
     virtual bool HasValue() const = 0;
 
+    // Whether the buffer is shared with other processes, see
+    // Device::ExportData() and Device::ImportData(), so it must keep its
+    // value.
+    virtual bool IsShared() const { return false; }
+
+    // Changes the kind the memory of this data is accounted to.
+    void SetMemoryKind(metrics::MemoryKind kind) {
+      if (memory_ != nullptr) {
+        memory_->SetKind(kind);
+      }
+    }
+
    private:
     Device* device_;
     Shape shape_;
     std::shared_ptr<Info> info_;
+    std::shared_ptr<const Sharding> sharding_;
+    std::unique_ptr<metrics::MemoryAccounting::Allocation> memory_;
   };
 
   class Computation {
@@ -153,10 +304,28 @@ class ComputationClient {
 
     const std::vector<std::string>& devices() const { return devices_; }
 
+    // The parameter shapes, with the layouts the compiled executable wants its
+    // arguments in. Empty if the backend does not report them.
+    const std::vector<Shape>& compiled_parameter_shapes() const {
+      return compiled_parameter_shapes_;
+    }
+
+    void set_compiled_parameter_shapes(std::vector<Shape> shapes) {
+      compiled_parameter_shapes_ = std::move(shapes);
+    }
+
+    // The size of the code generated for the executable, or -1 if the backend
+    // does not report it.
+    int64 executable_size() const { return executable_size_; }
+
+    void set_executable_size(int64 size) { executable_size_ = size; }
+
    private:
     XlaComputation computation_;
     ProgramShape program_shape_;
     std::vector<std::string> devices_;
+    std::vector<Shape> compiled_parameter_shapes_;
+    int64 executable_size_ = -1;
   };
 
   // The TensorSource provides a way for a client to populate a buffer allocated
@@ -173,6 +342,10 @@ class ComputationClient {
 
     Shape shape;
     PopulateFn populate_fn;
+    // If not null, points to host memory which already holds the tensor in the
+    // layout of shape, which transfers can read directly instead of calling
+    // populate_fn. It must stay valid until TransferToServer() returns.
+    const void* data = nullptr;
   };
 
   struct CompileInstance {
@@ -182,9 +355,17 @@ class ComputationClient {
 
     XlaComputation computation;
     const Shape* output_shape = nullptr;
+    // Trades the speed of the compiled code for a shorter compilation, for
+    // computations which are expected to run only a few times. Backends
+    // without such a knob ignore it.
+    bool fast_compile = false;
   };
 
   struct ExecuteOptions {
+    // Whether the elements of a tuple result come back as their own data,
+    // straight from the execution. With XRT this happens within the execute
+    // call, while otherwise the tuple needs a separate round trip to be
+    // deconstructed.
     bool explode_tuple = true;
   };
 
@@ -230,6 +411,14 @@ class ComputationClient {
   static std::vector<Literal> TransferFromServer(
       absl::Span<const DataPtr> handles);
 
+  // Streams the tensor values behind the supplied handles to the host, with a
+  // bounded amount of host memory. See
+  // TransferManager::TransferFromServerStreamingImpl().
+  static void TransferFromServerStreaming(
+      absl::Span<const DataPtr> handles, size_t max_host_bytes,
+      const TransferManager::DestinationFn& destination_fn,
+      const TransferManager::ConsumerFn& consumer_fn);
+
   virtual std::string GetDefaultDevice() const = 0;
   static Device* DefaultDevice();
 
@@ -249,11 +438,21 @@ class ComputationClient {
 
   static const std::vector<std::string>& GetReplicationDevices();
 
+  // Returns the ordinals of the replication devices grouped by host, with the
+  // same number of replicas in every host, or an empty vector if the replicas
+  // do not span multiple hosts that way.
+  static std::vector<std::vector<int64>> GetReplicaHostGroups();
+
   virtual void SetRngSeed(size_t seed) = 0;
 
   virtual std::map<std::string, Metric> GetMetrics() const = 0;
   static std::map<std::string, Metric> ReadMetrics();
 
+  // Whether step executions are enqueued with
+  // Device::ExecuteComputationPipelined(), so that the host can prepare the
+  // next step while the current one runs (XLA_PIPELINED_EXECUTION).
+  static bool PipelinedExecution();
+
   // Utility API around the vector based Compile() API to compile a single
   // computation.
   ComputationPtr Compile(XlaComputation computation,
@@ -0,0 +1,101 @@
+#include "tensorflow/compiler/xla/xla_client/cuda_graph.h"
+
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#if XLA_CUDA
+#include "tensorflow/stream_executor/cuda/cuda_activation.h"
+#include "tensorflow/stream_executor/gpu/gpu_stream.h"
+#include "third_party/gpus/cuda/include/cuda.h"
+#endif
+
+namespace xla {
+namespace cuda_graph {
+
+#if XLA_CUDA
+
+namespace {
+
+Status ToStatus(CUresult result, const char* what) {
+  if (result == CUDA_SUCCESS) {
+    return Status::OK();
+  }
+  const char* message = nullptr;
+  cuGetErrorString(result, &message);
+  return InternalError("%s failed: %s", what,
+                       message != nullptr ? message : "unknown error");
+}
+
+CUstream AsCudaStream(se::Stream* stream) {
+  return se::gpu::AsGpuStreamValue(stream);
+}
+
+class CudaGraph : public Graph {
+ public:
+  CudaGraph(se::StreamExecutor* executor, CUgraph graph, CUgraphExec exec)
+      : executor_(executor), graph_(graph), exec_(exec) {}
+
+  ~CudaGraph() override {
+    se::gpu::ScopedActivateExecutorContext activation(executor_);
+    cuGraphExecDestroy(exec_);
+    cuGraphDestroy(graph_);
+  }
+
+  Status Launch(se::Stream* stream) const override {
+    XLA_CHECK_EQ(stream->parent(), executor_);
+    se::gpu::ScopedActivateExecutorContext activation(executor_);
+    return ToStatus(cuGraphLaunch(exec_, AsCudaStream(stream)),
+                    "cuGraphLaunch");
+  }
+
+ private:
+  se::StreamExecutor* executor_;
+  CUgraph graph_;
+  CUgraphExec exec_;
+};
+
+}  // namespace
+
+bool IsSupported() { return true; }
+
+Status BeginCapture(se::Stream* stream) {
+  se::gpu::ScopedActivateExecutorContext activation(stream->parent());
+  // The relaxed mode lets XLA allocate device memory while capturing.
+  return ToStatus(cuStreamBeginCapture(AsCudaStream(stream),
+                                       CU_STREAM_CAPTURE_MODE_RELAXED),
+                  "cuStreamBeginCapture");
+}
+
+StatusOr<std::unique_ptr<Graph>> EndCapture(se::Stream* stream) {
+  se::gpu::ScopedActivateExecutorContext activation(stream->parent());
+  CUgraph graph = nullptr;
+  TF_RETURN_IF_ERROR(ToStatus(cuStreamEndCapture(AsCudaStream(stream), &graph),
+                              "cuStreamEndCapture"));
+  CUgraphExec exec = nullptr;
+  Status status =
+      ToStatus(cuGraphInstantiate(&exec, graph, nullptr, nullptr, 0),
+               "cuGraphInstantiate");
+  if (!status.ok()) {
+    cuGraphDestroy(graph);
+    return status;
+  }
+  return std::unique_ptr<Graph>(
+      std::make_unique<CudaGraph>(stream->parent(), graph, exec));
+}
+
+#else  // XLA_CUDA
+
+bool IsSupported() { return false; }
+
+Status BeginCapture(se::Stream* stream) {
+  return Unimplemented("CUDA graphs require the CUDA configuration");
+}
+
+StatusOr<std::unique_ptr<Graph>> EndCapture(se::Stream* stream) {
+  return Unimplemented("CUDA graphs require the CUDA configuration");
+}
+
+#endif  // XLA_CUDA
+
+}  // namespace cuda_graph
+}  // namespace xla
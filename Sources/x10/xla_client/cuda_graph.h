@@ -0,0 +1,36 @@
+#ifndef XLA_CLIENT_CUDA_GRAPH_H_
+#define XLA_CLIENT_CUDA_GRAPH_H_
+
+#include <memory>
+
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/stream_executor/stream.h"
+
+namespace xla {
+namespace cuda_graph {
+
+// An instantiated CUDA graph, which replays the work captured from a stream.
+class Graph {
+ public:
+  virtual ~Graph() = default;
+
+  // Enqueues the captured work on the stream.
+  virtual Status Launch(se::Stream* stream) const = 0;
+};
+
+// Whether the build supports capturing CUDA graphs.
+bool IsSupported();
+
+// Starts capturing, instead of running, the work enqueued on the stream. The
+// stream must not get the work of other threads until EndCapture().
+Status BeginCapture(se::Stream* stream);
+
+// Ends the capture started on the stream and instantiates the captured work.
+// Fails if the work cannot be captured, in which case none of it has run.
+StatusOr<std::unique_ptr<Graph>> EndCapture(se::Stream* stream);
+
+}  // namespace cuda_graph
+}  // namespace xla
+
+#endif  // XLA_CLIENT_CUDA_GRAPH_H_
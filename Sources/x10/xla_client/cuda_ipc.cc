@@ -0,0 +1,134 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/cuda_ipc.h"
+
+#include <cstring>
+
+#include "absl/strings/escaping.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
+#if XLA_CUDA
+#include "tensorflow/stream_executor/cuda/cuda_activation.h"
+#include "third_party/gpus/cuda/include/cuda.h"
+#endif
+
+namespace xla {
+namespace cuda_ipc {
+
+#if XLA_CUDA
+
+namespace {
+
+// The exported memory can be a sub-range of its allocation, which is the unit
+// CUDA shares across processes.
+struct ExportedRange {
+  CUipcMemHandle handle;
+  uint64 offset = 0;
+  uint64 size = 0;
+};
+
+Status ToStatus(CUresult result, const char* what) {
+  if (result == CUDA_SUCCESS) {
+    return Status::OK();
+  }
+  const char* message = nullptr;
+  cuGetErrorString(result, &message);
+  return InternalError("%s failed: %s", what,
+                       message != nullptr ? message : "unknown error");
+}
+
+class CudaImportedMemory : public ImportedMemory {
+ public:
+  CudaImportedMemory(se::StreamExecutor* executor, CUdeviceptr base,
+                     se::DeviceMemoryBase memory)
+      : executor_(executor), base_(base), memory_(memory) {}
+
+  ~CudaImportedMemory() override {
+    se::gpu::ScopedActivateExecutorContext activation(executor_);
+    cuIpcCloseMemHandle(base_);
+  }
+
+  se::DeviceMemoryBase memory() const override { return memory_; }
+
+ private:
+  se::StreamExecutor* executor_;
+  CUdeviceptr base_;
+  se::DeviceMemoryBase memory_;
+};
+
+}  // namespace
+
+bool IsSupported() { return true; }
+
+StatusOr<std::string> ExportMemory(se::StreamExecutor* executor,
+                                   se::DeviceMemoryBase memory) {
+  se::gpu::ScopedActivateExecutorContext activation(executor);
+  CUdeviceptr address = reinterpret_cast<CUdeviceptr>(memory.opaque());
+  CUdeviceptr base = 0;
+  size_t allocation_size = 0;
+  TF_RETURN_IF_ERROR(
+      ToStatus(cuMemGetAddressRange(&base, &allocation_size, address),
+               "cuMemGetAddressRange"));
+  ExportedRange range;
+  TF_RETURN_IF_ERROR(
+      ToStatus(cuIpcGetMemHandle(&range.handle, base), "cuIpcGetMemHandle"));
+  range.offset = address - base;
+  range.size = memory.size();
+  return absl::BytesToHexString(absl::string_view(
+      reinterpret_cast<const char*>(&range), sizeof(range)));
+}
+
+StatusOr<std::unique_ptr<ImportedMemory>> ImportMemory(
+    se::StreamExecutor* executor, const std::string& handle) {
+  std::string bytes = absl::HexStringToBytes(handle);
+  if (bytes.size() != sizeof(ExportedRange)) {
+    return InvalidArgument("Malformed device memory handle: %s", handle);
+  }
+  ExportedRange range;
+  std::memcpy(&range, bytes.data(), sizeof(range));
+  se::gpu::ScopedActivateExecutorContext activation(executor);
+  CUdeviceptr base = 0;
+  TF_RETURN_IF_ERROR(
+      ToStatus(cuIpcOpenMemHandle(&base, range.handle,
+                                  CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS),
+               "cuIpcOpenMemHandle"));
+  se::DeviceMemoryBase memory(reinterpret_cast<void*>(base + range.offset),
+                              range.size);
+  return std::unique_ptr<ImportedMemory>(
+      std::make_unique<CudaImportedMemory>(executor, base, memory));
+}
+
+#else  // XLA_CUDA
+
+bool IsSupported() { return false; }
+
+StatusOr<std::string> ExportMemory(se::StreamExecutor* executor,
+                                   se::DeviceMemoryBase memory) {
+  return Unimplemented(
+      "Sharing device memory across processes requires the CUDA "
+      "configuration");
+}
+
+StatusOr<std::unique_ptr<ImportedMemory>> ImportMemory(
+    se::StreamExecutor* executor, const std::string& handle) {
+  return Unimplemented(
+      "Sharing device memory across processes requires the CUDA "
+      "configuration");
+}
+
+#endif  // XLA_CUDA
+
+}  // namespace cuda_ipc
+}  // namespace xla
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_CUDA_IPC_H_
+#define X10_XLA_CLIENT_CUDA_IPC_H_
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/stream_executor/device_memory.h"
+#include "tensorflow/stream_executor/stream_executor.h"
+
+namespace xla {
+namespace cuda_ipc {
+
+// Device memory allocated by another process, mapped into this one while
+// alive.
+class ImportedMemory {
+ public:
+  virtual ~ImportedMemory() = default;
+
+  virtual se::DeviceMemoryBase memory() const = 0;
+};
+
+// Whether the build supports sharing device memory across processes.
+bool IsSupported();
+
+// Returns the handle the other processes of the host import the memory with.
+// The handle is printable, and the same for every export of the same memory.
+// The memory must stay allocated for as long as they use it.
+StatusOr<std::string> ExportMemory(se::StreamExecutor* executor,
+                                   se::DeviceMemoryBase memory);
+
+// Maps the memory exported by another process with ExportMemory(). A process
+// must only map the same handle once at a time.
+StatusOr<std::unique_ptr<ImportedMemory>> ImportMemory(
+    se::StreamExecutor* executor, const std::string& handle);
+
+}  // namespace cuda_ipc
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_CUDA_IPC_H_
@@ -11,7 +11,9 @@ const char* const kEnvTpuConfig = "XRT_TPU_CONFIG";
 const char* const kEnvDeviceMap = "XRT_DEVICE_MAP";
 const char* const kEnvWorkers = "XRT_WORKERS";
 const char* const kEnvMeshService = "XRT_MESH_SERVICE_ADDRESS";
+const char* const kEnvMeshRelay = "XRT_MESH_RELAY_ADDRESS";
 const char* const kEnvWorldSize = "XRT_SHARD_WORLD_SIZE";
+const char* const kEnvLocalOrdinal = "XRT_SHARD_LOCAL_ORDINAL";
 const char* const kEnvMpDevice = "XRT_MULTI_PROCESSING_DEVICE";
 
 }  // namespace env
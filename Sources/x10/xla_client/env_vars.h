@@ -12,7 +12,9 @@ extern const char* const kEnvTpuConfig;
 extern const char* const kEnvDeviceMap;
 extern const char* const kEnvWorkers;
 extern const char* const kEnvMeshService;
+extern const char* const kEnvMeshRelay;
 extern const char* const kEnvWorldSize;
+extern const char* const kEnvLocalOrdinal;
 extern const char* const kEnvMpDevice;
 
 }  // namespace env
@@ -0,0 +1,158 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/event_tracer.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <sstream>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace xla {
+namespace metrics {
+namespace {
+
+std::atomic<bool> g_dump_requested(false);
+
+void DumpSignalHandler(int signal) { g_dump_requested.store(true); }
+
+int64 GetThreadId() {
+  static std::atomic<int64>* next_id = new std::atomic<int64>(1);
+  thread_local int64 thread_id = next_id->fetch_add(1);
+  return thread_id;
+}
+
+void AppendJsonString(const char* str, std::stringstream* ss) {
+  (*ss) << '"';
+  for (; *str != '\0'; ++str) {
+    if (*str == '"' || *str == '\\') {
+      (*ss) << '\\';
+    }
+    (*ss) << *str;
+  }
+  (*ss) << '"';
+}
+
+}  // namespace
+
+EventTracer* EventTracer::Get() {
+  static EventTracer* tracer = new EventTracer();
+  return tracer;
+}
+
+EventTracer::EventTracer() {
+  size_t size = sys_util::GetEnvInt("XLA_EVENT_TRACE_SIZE", 1 << 16);
+  enabled_ = size > 0;
+  if (!enabled_) {
+    return;
+  }
+  shard_size_ = std::max<size_t>(size / kNumMetricShards, 1);
+  shards_.reset(new Shard[kNumMetricShards]);
+  int signal = sys_util::GetEnvInt("XLA_EVENT_TRACE_SIGNAL", 0);
+  if (signal > 0) {
+    dump_path_ = sys_util::GetEnvString(
+        "XLA_EVENT_TRACE_FILE",
+        absl::StrCat("/tmp/x10_trace.", getpid(), ".json"));
+    std::signal(signal, DumpSignalHandler);
+  }
+}
+
+void EventTracer::Record(const char* name, int64 start_ns, int64 end_ns) {
+  if (!enabled_) {
+    return;
+  }
+  {
+    Shard& shard = shards_[GetMetricShard()];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (shard.events.empty()) {
+      shard.events.resize(shard_size_);
+    }
+    TraceEvent& event = shard.events[shard.count % shard.events.size()];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = end_ns - start_ns;
+    event.thread_id = GetThreadId();
+    ++shard.count;
+  }
+  MaybeDumpOnSignal();
+}
+
+std::vector<TraceEvent> EventTracer::Events() const {
+  std::vector<TraceEvent> events;
+  if (!enabled_) {
+    return events;
+  }
+  for (size_t i = 0; i < kNumMetricShards; ++i) {
+    const Shard& shard = shards_[i];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    size_t count = std::min(shard.count, shard.events.size());
+    events.insert(events.end(), shard.events.begin(),
+                  shard.events.begin() + count);
+  }
+  std::sort(events.begin(), events.end(),
+            [](const TraceEvent& e1, const TraceEvent& e2) {
+              return e1.start_ns < e2.start_ns;
+            });
+  return events;
+}
+
+std::string EventTracer::ChromeTraceJson() const {
+  std::vector<TraceEvent> events = Events();
+  int pid = getpid();
+  std::stringstream ss;
+  ss.precision(3);
+  ss << std::fixed << "{\"traceEvents\":[";
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceEvent& event = events[i];
+    if (i > 0) {
+      ss << ",";
+    }
+    ss << "\n{\"name\":";
+    AppendJsonString(event.name, &ss);
+    // Chrome trace timestamps are expressed in microseconds.
+    ss << ",\"ph\":\"X\",\"ts\":" << event.start_ns / 1000.0
+       << ",\"dur\":" << event.duration_ns / 1000.0 << ",\"pid\":" << pid
+       << ",\"tid\":" << event.thread_id << "}";
+  }
+  ss << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return ss.str();
+}
+
+void EventTracer::DumpChromeTrace(const std::string& path) const {
+  std::ofstream file(path);
+  file << ChromeTraceJson();
+  if (!file) {
+    TF_LOG(ERROR) << "Unable to write the event trace to " << path;
+  } else {
+    TF_LOG(INFO) << "Event trace written to " << path;
+  }
+}
+
+void EventTracer::MaybeDumpOnSignal() {
+  if (!dump_path_.empty() &&
+      TF_PREDICT_FALSE(g_dump_requested.load(std::memory_order_relaxed)) &&
+      g_dump_requested.exchange(false)) {
+    DumpChromeTrace(dump_path_);
+  }
+}
+
+}  // namespace metrics
+}  // namespace xla
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_EVENT_TRACER_H_
+#define X10_XLA_CLIENT_EVENT_TRACER_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace metrics {
+
+struct TraceEvent {
+  // Not owned, see EventTracer::Record().
+  const char* name = nullptr;
+  int64 start_ns = 0;
+  int64 duration_ns = 0;
+  int64 thread_id = 0;
+};
+
+// Records time spans of the runtime activities (graph collection, lowering,
+// compilation, transfers, executions, lock waits) into a ring buffer holding
+// the newest XLA_EVENT_TRACE_SIZE events. The buffer can be dumped in the
+// Chrome trace JSON format, loadable by chrome://tracing and Perfetto, either
+// on demand or upon receiving the XLA_EVENT_TRACE_SIGNAL signal.
+class EventTracer {
+ public:
+  static EventTracer* Get();
+
+  bool enabled() const { return enabled_; }
+
+  // Records a span. The name is not copied, so it must stay valid for the
+  // lifetime of the process (string literals, metric names).
+  void Record(const char* name, int64 start_ns, int64 end_ns);
+
+  // Returns the recorded events, sorted by start time.
+  std::vector<TraceEvent> Events() const;
+
+  std::string ChromeTraceJson() const;
+
+  void DumpChromeTrace(const std::string& path) const;
+
+ private:
+  struct Shard {
+    mutable std::mutex lock;
+    size_t count = 0;
+    std::vector<TraceEvent> events;
+  };
+
+  EventTracer();
+
+  // Dumps the trace to XLA_EVENT_TRACE_FILE if the signal has been received.
+  void MaybeDumpOnSignal();
+
+  bool enabled_ = false;
+  size_t shard_size_ = 0;
+  std::string dump_path_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+// Scope based utility class recording the span of the enclosing C++ scope.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name)
+      : name_(name),
+        start_(EventTracer::Get()->enabled() ? sys_util::NowNs() : 0) {}
+
+  ~TraceSpan() {
+    if (start_ != 0) {
+      EventTracer::Get()->Record(name_, start_, sys_util::NowNs());
+    }
+  }
+
+ private:
+  const char* name_;
+  int64 start_;
+};
+
+#define XLA_TRACE_SPAN(name) xla::metrics::TraceSpan trace_span(name)
+
+}  // namespace metrics
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_EVENT_TRACER_H_
@@ -0,0 +1,188 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/execution_profile.h"
+
+#include <algorithm>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/memory_accounting.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+
+namespace xla {
+namespace metrics {
+namespace {
+
+bool IsScopeProfileEnabled() {
+  static const bool enabled =
+      sys_util::GetEnvBool("XLA_SCOPE_PROFILE", false);
+  return enabled;
+}
+
+// The IR scopes name every entered scope with a ".<id>" suffix telling apart
+// the scopes with the same name, which the profile aggregates.
+std::string StripScopeIds(const std::string& scope) {
+  std::vector<std::string> names = absl::StrSplit(scope, '/');
+  for (std::string& name : names) {
+    size_t pos = name.rfind('.');
+    if (pos != std::string::npos && pos + 1 < name.size() &&
+        std::all_of(name.begin() + pos + 1, name.end(), absl::ascii_isdigit)) {
+      name.resize(pos);
+    }
+  }
+  return absl::StrJoin(names, "/");
+}
+
+}  // namespace
+
+ExecutionProfile* ExecutionProfile::Get() {
+  static ExecutionProfile* profile = new ExecutionProfile();
+  return profile;
+}
+
+void ExecutionProfile::Record(
+    const hash_t& hash, const std::string& device,
+    const ComputationClient::ComputationPtr& computation,
+    int64 execute_time_ns, int64 step) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = records_.find(hash);
+  if (it == records_.end()) {
+    const ProgramShape& program_shape = computation->program_shape();
+    ExecutionRecord record;
+    record.hash = hash;
+    record.device = device;
+    for (auto& parameter_shape : program_shape.parameters()) {
+      record.input_bytes += ShapeMemoryBytes(parameter_shape);
+    }
+    record.output_bytes = ShapeMemoryBytes(program_shape.result());
+    record.parameter_count = program_shape.parameters_size();
+    it = records_.emplace(hash, std::move(record)).first;
+    if (IsScopeProfileEnabled()) {
+      scope_shares_.emplace(hash, ComputeScopeShares(*computation));
+    }
+  }
+  ExecutionRecord& record = it->second;
+  record.execution_count += 1;
+  record.execute_time_ns += execute_time_ns;
+  record.last_step = step;
+  record.computation = computation;
+  auto shares_it = scope_shares_.find(hash);
+  if (shares_it != scope_shares_.end()) {
+    for (auto& scope_share : shares_it->second) {
+      scope_time_ns_[scope_share.first] += scope_share.second * execute_time_ns;
+    }
+  }
+}
+
+ExecutionProfile::ScopeShares ExecutionProfile::ComputeScopeShares(
+    const ComputationClient::Computation& computation) {
+  // The backends do not report per instruction timings, so the instructions
+  // are weighted by their estimated cost, their FLOPs plus the bytes they
+  // access. The lowering names them after their scope in the op_name of their
+  // metadata.
+  auto module_or =
+      util::CreateModuleFromProto(computation.computation().proto());
+  if (!module_or.ok()) {
+    TF_LOG(WARNING) << "Unable to profile the graph scopes: "
+                    << module_or.status();
+    return {};
+  }
+  HloComputation* entry = module_or.ValueOrDie()->entry_computation();
+  HloCostAnalysis analysis(
+      [](const Shape& shape) { return ShapeUtil::ByteSizeOf(shape, 8); });
+  Status status = entry->Accept(&analysis);
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to profile the graph scopes: " << status;
+    return {};
+  }
+  std::unordered_map<std::string, double> scope_costs;
+  double total_cost = 0;
+  for (const HloInstruction* instruction : entry->instructions()) {
+    double cost = analysis.flop_count(*instruction) +
+                  analysis.transcendental_count(*instruction) +
+                  analysis.bytes_accessed(*instruction);
+    scope_costs[StripScopeIds(instruction->metadata().op_name())] += cost;
+    total_cost += cost;
+  }
+  ScopeShares shares;
+  for (auto& scope_cost : scope_costs) {
+    if (total_cost > 0) {
+      shares.emplace_back(scope_cost.first, scope_cost.second / total_cost);
+    }
+  }
+  return shares;
+}
+
+std::vector<ExecutionRecord> ExecutionProfile::GetRecords() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  std::vector<ExecutionRecord> records;
+  records.reserve(records_.size());
+  for (auto& hash_record : records_) {
+    records.push_back(hash_record.second);
+  }
+  return records;
+}
+
+int64 ExecutionProfile::GetExecutionCount(const hash_t& hash) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = records_.find(hash);
+  return it != records_.end() ? it->second.execution_count : 0;
+}
+
+std::vector<ExecutionRecord> ExecutionProfile::GetHottestRecords(
+    size_t count) const {
+  std::vector<ExecutionRecord> records = GetRecords();
+  count = std::min(count, records.size());
+  std::partial_sort(records.begin(), records.begin() + count, records.end(),
+                    [](const ExecutionRecord& r1, const ExecutionRecord& r2) {
+                      return r1.execute_time_ns > r2.execute_time_ns;
+                    });
+  records.resize(count);
+  return records;
+}
+
+std::vector<ScopeTime> ExecutionProfile::GetHottestScopes(size_t count) const {
+  std::vector<ScopeTime> scopes;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto& scope_time : scope_time_ns_) {
+      scopes.push_back(
+          {scope_time.first, static_cast<int64>(scope_time.second)});
+    }
+  }
+  count = std::min(count, scopes.size());
+  std::partial_sort(scopes.begin(), scopes.begin() + count, scopes.end(),
+                    [](const ScopeTime& s1, const ScopeTime& s2) {
+                      return s1.device_time_ns > s2.device_time_ns;
+                    });
+  scopes.resize(count);
+  return scopes;
+}
+
+void ExecutionProfile::Clear() {
+  std::lock_guard<std::mutex> lock(lock_);
+  records_.clear();
+  scope_shares_.clear();
+  scope_time_ns_.clear();
+}
+
+}  // namespace metrics
+}  // namespace xla
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_EXECUTION_PROFILE_H_
+#define X10_XLA_CLIENT_EXECUTION_PROFILE_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace xla {
+namespace metrics {
+
+struct ExecutionRecord {
+  hash_t hash;
+  std::string device;
+  int64 execution_count = 0;
+  // Accumulated time spent executing the computation, in nanoseconds.
+  int64 execute_time_ns = 0;
+  // Bytes of the arguments and results of a single execution.
+  int64 input_bytes = 0;
+  int64 output_bytes = 0;
+  size_t parameter_count = 0;
+  // Value of the MarkStep counter at the last execution.
+  int64 last_step = 0;
+  // Only usable while the computation is still cached.
+  std::weak_ptr<ComputationClient::Computation> computation;
+};
+
+// The device time attributed to an annotation scope, whose name is the one of
+// the nested scopes joined by '/'.
+struct ScopeTime {
+  std::string scope;
+  int64 device_time_ns = 0;
+};
+
+// Per graph execution statistics, keyed by the IR graph hash the computation
+// was compiled from.
+class ExecutionProfile {
+ public:
+  static ExecutionProfile* Get();
+
+  void Record(const hash_t& hash, const std::string& device,
+              const ComputationClient::ComputationPtr& computation,
+              int64 execute_time_ns, int64 step);
+
+  std::vector<ExecutionRecord> GetRecords() const;
+
+  // Returns how many times the computation of the graph with the given hash
+  // has been executed.
+  int64 GetExecutionCount(const hash_t& hash) const;
+
+  // Returns up to count records sorted by decreasing accumulated execution
+  // time.
+  std::vector<ExecutionRecord> GetHottestRecords(size_t count) const;
+
+  // Returns up to count annotation scopes sorted by decreasing device time.
+  // Requires XLA_SCOPE_PROFILE, which splits the execution time of every graph
+  // between the scopes its HLO instructions were traced within, in proportion
+  // of their estimated cost.
+  std::vector<ScopeTime> GetHottestScopes(size_t count) const;
+
+  void Clear();
+
+ private:
+  using ScopeShares = std::vector<std::pair<std::string, double>>;
+
+  static ScopeShares ComputeScopeShares(
+      const ComputationClient::Computation& computation);
+
+  mutable std::mutex lock_;
+  std::unordered_map<hash_t, ExecutionRecord, util::HashReducer> records_;
+  std::unordered_map<hash_t, ScopeShares, util::HashReducer> scope_shares_;
+  std::unordered_map<std::string, double> scope_time_ns_;
+};
+
+}  // namespace metrics
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_EXECUTION_PROFILE_H_
@@ -14,181 +14,347 @@
 
 #include "tensorflow/compiler/xla/xla_client/fake_computation_client.h"
 
-#include <tuple>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 #include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
-#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
-#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
-#include "tensorflow/compiler/xla/xla_client/util.h"
-#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/step_profiler.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 
 namespace xla {
+namespace {
 
-class FakeComputationClient::FakeData : public ComputationClient::Data {
+using DataPtr = ComputationClient::DataPtr;
+using ComputationPtr = ComputationClient::ComputationPtr;
+
+void SleepFor(double seconds) {
+  if (seconds > 0) {
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  }
+}
+
+double BandwidthSeconds(double bytes, double gbps) {
+  return gbps > 0 ? bytes / (gbps * 1e9) : 0;
+}
+
+int64 ArrayBytes(const Shape& shape) {
+  return shape.IsArray() ? ShapeUtil::ByteSizeOf(shape) : 0;
+}
+
+class FakeDevice;
+
+class FakeData : public ComputationClient::Data {
  public:
-  using Data::Data;
+  FakeData(FakeDevice* device, Shape shape, bool has_value);
 
-  virtual OpaqueHandle GetOpaqueHandle() {
+  ~FakeData() override;
+
+  OpaqueHandle GetOpaqueHandle() override {
     return reinterpret_cast<intptr_t>(this);
   }
 
-  virtual void Assign(const Data& data) {}
-  virtual bool HasValue() const { return true; }
+  void Assign(const Data& data) override;
+
+  bool HasValue() const override { return has_value_; }
+
+ private:
+  FakeDevice* device_;
+  bool has_value_;
 };
 
-struct FakeComputationClient::FakeComputation
-    : public ComputationClient::Computation {
-  using Computation::Computation;
+class FakeComputation : public ComputationClient::Computation {
+ public:
+  FakeComputation(XlaComputation computation, ProgramShape program_shape,
+                  std::vector<std::string> devices,
+                  std::vector<Shape> output_shapes, double execute_seconds)
+      : Computation(std::move(computation), std::move(program_shape),
+                    std::move(devices)),
+        output_shapes_(std::move(output_shapes)),
+        execute_seconds_(execute_seconds) {}
+
+  const std::vector<Shape>& output_shapes() const { return output_shapes_; }
+
+  double execute_seconds() const { return execute_seconds_; }
+
+ private:
+  std::vector<Shape> output_shapes_;
+  double execute_seconds_;
 };
 
-using DataPtr = ComputationClient::DataPtr;
-using ComputationPtr = ComputationClient::ComputationPtr;
+class FakeTransferManager : public ComputationClient::TransferManager {
+ public:
+  std::vector<Literal> TransferFromServerImpl(
+      absl::Span<const DataPtr> handles) override;
+};
 
-DataPtr FakeComputationClient::CreateDataPlaceholder(std::string device,
-                                                     Shape shape) {
-  return std::make_shared<FakeData>(device, shape);
-}
+class FakeDevice : public ComputationClient::Device {
+ public:
+  FakeDevice(std::string name, FakeDeviceOptions options)
+      : Device(std::move(name)), options_(options) {}
 
-ComputationClient::DataPtr FakeComputationClient::TransferToServer(
-    xla::BorrowingLiteral literal, const xla::Shape& dest_shape,
-    const std::string& device) {
-  return CreateDataPlaceholder(device, dest_shape);
-}
+  int32_t mesh_id() const override { return device_id().ordinal; }
 
-std::vector<DataPtr> FakeComputationClient::TransferToServer(
-    absl::Span<const TensorSource> tensors) {
-  tensorflow::profiler::TraceMe trace("TransferToServer");
-  std::vector<DataPtr> out;
-  for (const auto& tensor : tensors) {
-    out.push_back(CreateDataPlaceholder(tensor.device, tensor.shape));
+  ComputationClient::TransferManager* GetTransferManager() const override {
+    static FakeTransferManager fake_transfer;
+    return &fake_transfer;
   }
-  return out;
-}
 
-std::vector<Literal> FakeComputationClient::TransferFromServer(
-    absl::Span<const DataPtr> handles) {
-  tensorflow::profiler::TraceMe trace("TransferFromServer");
-  std::vector<Literal> out;
-  for (const auto& handle : handles) {
-    out.push_back(xla::Literal(handle->shape()));
+  std::vector<ComputationPtr> Compile(
+      const std::vector<std::string>& devices,
+      std::vector<ComputationClient::CompileInstance> instances) override;
+
+  std::vector<DataPtr> TransferToServer(
+      absl::Span<const ComputationClient::TensorSource> tensors) override;
+
+  DataPtr TransferToServer(BorrowingLiteral literal,
+                           const Shape& dest_shape) override;
+
+  std::vector<DataPtr> ExecuteChained(
+      absl::Span<const ComputationClient::ExecuteChainedOp> ops) override {
+    TF_LOG(FATAL) << "Implement";
   }
-  return out;
-}
 
-std::vector<ComputationPtr> FakeComputationClient::Compile(
-    std::vector<CompileInstance> instances) {
-  metrics::TimedSection timed(CompileMetric());
-  std::vector<ComputationPtr> out;
-  for (auto& instance : instances) {
-    auto program_shape =
-        xla::ProgramShape(instance.computation.GetProgramShape().ValueOrDie());
-    out.push_back(std::shared_ptr<FakeComputation>(
-        new FakeComputation(std::move(instance.computation),
-                            std::move(program_shape), instance.devices)));
+  std::string ResourceDomain() const override { return "Fake"; }
+
+  DataPtr CreateDataPlaceholder(Shape shape) override {
+    return std::make_shared<FakeData>(this, std::move(shape),
+                                      /*has_value=*/false);
   }
-  return out;
-}
 
-std::vector<DataPtr> FakeComputationClient::ExecuteComputation(
-    const Computation& computation, absl::Span<const DataPtr> arguments,
-    const std::string& device, const ExecuteComputationOptions& options) {
-  std::vector<DataPtr> out;
-  for (const auto& shape :
-       computation.program_shape().result().tuple_shapes()) {
-    out.push_back(CreateDataPlaceholder(device, shape));
+  std::vector<DataPtr> ExecuteComputation(
+      const ComputationClient::Computation& computation,
+      absl::Span<const DataPtr> arguments,
+      const ComputationClient::ExecuteComputationOptions& options) override;
+
+  bool IsLocal() override { return true; }
+
+  int64 GetMemoryInUse() override {
+    std::lock_guard<std::mutex> lock(memory_mutex_);
+    return memory_in_use_;
   }
-  return out;
-}
 
-std::vector<std::vector<DataPtr>> FakeComputationClient::ExecuteReplicated(
-    const Computation& computation,
-    const std::vector<std::vector<DataPtr>>& arguments,
-    absl::Span<const std::string> devices,
-    const ExecuteReplicatedOptions& options) {
-  TF_LOG(FATAL) << "Implement";
-}
+  int64 GetMemoryLimit() override {
+    return options_.memory_bytes > 0 ? options_.memory_bytes : -1;
+  }
 
-std::vector<std::vector<DataPtr>> FakeComputationClient::ExecuteParallel(
-    absl::Span<const Computation* const> computations,
-    const std::vector<std::vector<DataPtr>>& arguments,
-    absl::Span<const std::string> devices,
-    const ExecuteParallelOptions& options) {
-  TF_LOG(FATAL) << "Implement";
-}
+  // Takes the time of a transfer of the given bytes, behind the other
+  // transfers of the device.
+  void SimulateTransfer(int64 bytes) {
+    std::lock_guard<std::mutex> lock(transfer_mutex_);
+    SleepFor(options_.transfer_latency_us * 1e-6 +
+             BandwidthSeconds(bytes, options_.transfer_gbps));
+  }
 
-std::vector<DataPtr> FakeComputationClient::ExecuteChained(
-    absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
-  TF_LOG(FATAL) << "Implement";
-}
+  void Allocate(int64 bytes) {
+    std::lock_guard<std::mutex> lock(memory_mutex_);
+    XLA_CHECK(options_.memory_bytes <= 0 ||
+              memory_in_use_ + bytes <= options_.memory_bytes)
+        << "Out of memory on " << name() << " allocating " << bytes
+        << " bytes, with " << memory_in_use_ << " of "
+        << options_.memory_bytes << " bytes in use";
+    memory_in_use_ += bytes;
+  }
 
-std::vector<std::vector<DataPtr>> FakeComputationClient::DeconstructTuple(
-    absl::Span<const DataPtr> tuples) {
-  TF_LOG(FATAL) << "Implement";
-}
+  void Release(int64 bytes) {
+    std::lock_guard<std::mutex> lock(memory_mutex_);
+    memory_in_use_ -= bytes;
+  }
 
-std::map<std::string, Metric> FakeComputationClient::GetMetrics() const {
-  TF_LOG(FATAL) << "Implement";
-}
+ private:
+  double ExecuteSeconds(const HloModule& module) const;
 
-std::string FakeComputationClient::GetResourceDomain(
-    const std::string& device) const {
-  return "NopDomain";
-}
+  FakeDeviceOptions options_;
+  std::mutex execute_mutex_;
+  std::mutex transfer_mutex_;
+  std::mutex memory_mutex_;
+  int64 memory_in_use_ = 0;
+};
 
-std::string FakeComputationClient::GetDefaultDevice() const {
-  return default_device_;
+FakeData::FakeData(FakeDevice* device, Shape shape, bool has_value)
+    : Data(device, std::move(shape)), device_(device), has_value_(has_value) {
+  if (has_value_) {
+    device_->Allocate(ArrayBytes(this->shape()));
+  }
 }
 
-swift_xla::Device FakeComputationClient::GetDefaultDeviceStruct() const {
-  return swift_xla::Device(swift_xla::DeviceType::CPU, 0);
+FakeData::~FakeData() {
+  if (has_value_) {
+    device_->Release(ArrayBytes(shape()));
+  }
 }
 
-size_t FakeComputationClient::GetNumDevices() const {
-  return device_names_.size();
+void FakeData::Assign(const Data& data) {
+  if (&data != this && !has_value_) {
+    device_->Allocate(ArrayBytes(shape()));
+    has_value_ = true;
+  }
 }
 
-std::vector<std::string> FakeComputationClient::GetLocalDevices() const {
-  TF_LOG(FATAL) << "Implement";
+std::vector<Literal> FakeTransferManager::TransferFromServerImpl(
+    absl::Span<const DataPtr> handles) {
+  tensorflow::profiler::TraceMe trace("TransferFromServer");
+  XLA_STEP_TIMER(kTransfer);
+  metrics::TimedSection timed(ComputationClient::TransferFromServerMetric());
+  std::vector<Literal> out;
+  for (const DataPtr& handle : handles) {
+    dynamic_cast<FakeDevice*>(handle->device())
+        ->SimulateTransfer(ArrayBytes(handle->shape()));
+    out.push_back(Literal::CreateFromShape(handle->shape()));
+  }
+  return out;
 }
 
-std::vector<std::string> FakeComputationClient::GetAllDevices() const {
-  return device_names_;
-  ;
+double FakeDevice::ExecuteSeconds(const HloModule& module) const {
+  HloCostAnalysis analysis(
+      [](const Shape& shape) { return ShapeUtil::ByteSizeOf(shape, 8); });
+  TF_CHECK_OK(module.entry_computation()->Accept(&analysis));
+  int64 collective_bytes = 0;
+  for (const HloComputation* computation : module.computations()) {
+    for (const HloInstruction* instruction : computation->instructions()) {
+      switch (instruction->opcode()) {
+        case HloOpcode::kAllReduce:
+        case HloOpcode::kAllToAll:
+        case HloOpcode::kCollectivePermute:
+          collective_bytes += ShapeUtil::ByteSizeOf(instruction->shape(), 8);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+  double compute_seconds =
+      options_.gflops > 0 ? analysis.flop_count() / (options_.gflops * 1e9)
+                          : 0;
+  double memory_seconds =
+      BandwidthSeconds(analysis.bytes_accessed(), options_.memory_gbps);
+  return options_.launch_us * 1e-6 +
+         std::max(compute_seconds, memory_seconds) +
+         BandwidthSeconds(collective_bytes, options_.interconnect_gbps);
 }
 
-void FakeComputationClient::SetReplicationDevices(
-    std::vector<std::string> devices) {
-  TF_LOG(FATAL) << "Implement";
+std::vector<ComputationPtr> FakeDevice::Compile(
+    const std::vector<std::string>& devices,
+    std::vector<ComputationClient::CompileInstance> instances) {
+  metrics::TimedSection timed(ComputationClient::CompileMetric());
+  std::vector<ComputationPtr> out;
+  for (auto& instance : instances) {
+    ProgramShape program_shape =
+        instance.computation.GetProgramShape().ValueOrDie();
+    std::unique_ptr<HloModule> module =
+        util::CreateModuleFromProto(instance.computation.proto())
+            .ValueOrDie();
+    SleepFor(options_.compile_ms * 1e-3 +
+             options_.compile_us_per_instruction * 1e-6 *
+                 module->instruction_count());
+    const Shape& result_shape = instance.output_shape != nullptr
+                                    ? *instance.output_shape
+                                    : program_shape.result();
+    std::vector<Shape> output_shapes;
+    if (result_shape.IsTuple()) {
+      output_shapes = result_shape.tuple_shapes();
+    } else {
+      output_shapes.push_back(result_shape);
+    }
+    double execute_seconds = ExecuteSeconds(*module);
+    out.push_back(std::make_shared<FakeComputation>(
+        std::move(instance.computation), std::move(program_shape), devices,
+        std::move(output_shapes), execute_seconds));
+  }
+  return out;
 }
 
-const std::vector<std::string>& FakeComputationClient::GetReplicationDevices()
-    const {
-  static std::vector<std::string>* replicated_devices =
-      new std::vector<std::string>;
-  return *replicated_devices;
+std::vector<DataPtr> FakeDevice::TransferToServer(
+    absl::Span<const ComputationClient::TensorSource> tensors) {
+  tensorflow::profiler::TraceMe trace("TransferToServer");
+  XLA_STEP_TIMER(kTransfer);
+  metrics::TimedSection timed(ComputationClient::TransferToServerMetric());
+  std::vector<DataPtr> out;
+  for (const ComputationClient::TensorSource& tensor : tensors) {
+    int64 bytes = ArrayBytes(tensor.shape);
+    // The staging copy runs on the host like for the real devices, only the
+    // copy to the device is simulated.
+    if (tensor.data == nullptr && bytes > 0) {
+      std::unique_ptr<char[]> staging(new char[bytes]);
+      tensor.populate_fn(tensor, staging.get(), bytes);
+    }
+    SimulateTransfer(bytes);
+    out.push_back(
+        std::make_shared<FakeData>(this, tensor.shape, /*has_value=*/true));
+  }
+  return out;
 }
 
-void FakeComputationClient::SetRngSeed(size_t seed) {
-  TF_LOG(FATAL) << "Implement";
+DataPtr FakeDevice::TransferToServer(BorrowingLiteral literal,
+                                     const Shape& dest_shape) {
+  metrics::TimedSection timed(ComputationClient::TransferToServerMetric());
+  SimulateTransfer(ArrayBytes(dest_shape));
+  return std::make_shared<FakeData>(this, dest_shape, /*has_value=*/true);
 }
 
-FakeComputationClient::FakeComputationClient() {
-  for (int i = 0; i < 1; ++i) {
-    device_names_.push_back(absl::StrCat("CPU:", i));
-  }
-  for (int i = 0; i < 16; ++i) {
-    device_names_.push_back(absl::StrCat("TPU:", i));
+std::vector<DataPtr> FakeDevice::ExecuteComputation(
+    const ComputationClient::Computation& computation,
+    absl::Span<const DataPtr> arguments,
+    const ComputationClient::ExecuteComputationOptions& options) {
+  tensorflow::profiler::TraceMe trace("ExecuteComputation");
+  metrics::TimedSection timed(ComputationClient::ExecuteMetric());
+  auto& fake_computation = dynamic_cast<const FakeComputation&>(computation);
+  WaitForTransfers(arguments);
+  std::lock_guard<std::mutex> lock(execute_mutex_);
+  std::vector<DataPtr> out;
+  for (const Shape& shape : fake_computation.output_shapes()) {
+    out.push_back(std::make_shared<FakeData>(this, shape, /*has_value=*/true));
   }
+  SleepFor(fake_computation.execute_seconds());
+  return out;
 }
 
-std::unique_ptr<ComputationClient> ComputationClient::Create() {
-  return std::make_unique<FakeComputationClient>();
+}  // namespace
+
+FakeDeviceOptions GetFakeDeviceOptionsFromEnv() {
+  FakeDeviceOptions options;
+  options.compile_ms = sys_util::GetEnvDouble("XLA_FAKE_COMPILE_MS", 0);
+  options.compile_us_per_instruction =
+      sys_util::GetEnvDouble("XLA_FAKE_COMPILE_US_PER_INSTRUCTION", 0);
+  options.launch_us = sys_util::GetEnvDouble("XLA_FAKE_LAUNCH_US", 0);
+  options.gflops = sys_util::GetEnvDouble("XLA_FAKE_GFLOPS", 0);
+  options.memory_gbps = sys_util::GetEnvDouble("XLA_FAKE_MEMORY_GBPS", 0);
+  options.interconnect_gbps =
+      sys_util::GetEnvDouble("XLA_FAKE_INTERCONNECT_GBPS", 0);
+  options.transfer_latency_us =
+      sys_util::GetEnvDouble("XLA_FAKE_TRANSFER_LATENCY_US", 0);
+  options.transfer_gbps = sys_util::GetEnvDouble("XLA_FAKE_TRANSFER_GBPS", 0);
+  options.memory_bytes = sys_util::GetEnvInt("XLA_DEVICE_MEMORY_LIMIT", 0);
+  return options;
 }
 
-FakeComputationClient::~FakeComputationClient() {}
+std::unique_ptr<ComputationClient::Device> MakeFakeDevice(
+    std::string name, FakeDeviceOptions options) {
+  return std::make_unique<FakeDevice>(std::move(name), options);
+}
 
-bool ComputationClient::IsLocal() { return true; }
+std::vector<std::unique_ptr<ComputationClient::Device>> GetFakeDevices() {
+  std::vector<std::unique_ptr<ComputationClient::Device>> devices;
+  int64 num_devices = sys_util::GetEnvInt("XLA_FAKE_DEVICES", 0);
+  if (num_devices <= 0) {
+    return devices;
+  }
+  std::string device_type =
+      sys_util::GetEnvString("XLA_FAKE_DEVICE_TYPE", "GPU");
+  FakeDeviceOptions options = GetFakeDeviceOptionsFromEnv();
+  for (int64 i = 0; i < num_devices; ++i) {
+    devices.push_back(
+        MakeFakeDevice(absl::StrCat(device_type, ":", i), options));
+  }
+  return devices;
+}
 
 }  // namespace xla
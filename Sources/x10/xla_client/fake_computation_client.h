@@ -17,81 +17,49 @@
 #ifndef X10_XLA_CLIENT_FAKE_COMPUTATION_CLIENT_H_
 #define X10_XLA_CLIENT_FAKE_COMPUTATION_CLIENT_H_
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
-#include "tensorflow/compiler/xla/client/client_library.h"
 
 namespace xla {
 
-class FakeComputationClient : public ComputationClient {
- public:
-  class FakeData;
-  struct FakeComputation;
-
-  FakeComputationClient();
-  ~FakeComputationClient();
-
-  DataPtr CreateDataPlaceholder(std::string device, Shape shape) override;
-
-  std::vector<DataPtr> TransferToServer(
-      absl::Span<const TensorSource> tensors) override;
-
-  DataPtr TransferToServer(xla::BorrowingLiteral literal,
-                           const xla::Shape& dest_shape,
-                           const std::string& device_string) override;
-
-  std::vector<Literal> TransferFromServer(
-      absl::Span<const DataPtr> handles) override;
-
-  std::vector<ComputationPtr> Compile(
-      std::vector<CompileInstance> instances) override;
-
-  std::vector<DataPtr> ExecuteComputation(
-      const Computation& computation, absl::Span<const DataPtr> arguments,
-      const std::string& device,
-      const ExecuteComputationOptions& options) override;
-
-  std::vector<std::vector<DataPtr>> ExecuteReplicated(
-      const Computation& computation,
-      const std::vector<std::vector<DataPtr>>& arguments,
-      absl::Span<const std::string> devices,
-      const ExecuteReplicatedOptions& options) override;
-
-  std::vector<std::vector<DataPtr>> ExecuteParallel(
-      absl::Span<const Computation* const> computations,
-      const std::vector<std::vector<DataPtr>>& arguments,
-      absl::Span<const std::string> devices,
-      const ExecuteParallelOptions& options) override;
-
-  std::vector<DataPtr> ExecuteChained(absl::Span<const ExecuteChainedOp> ops,
-                                      const std::string& device) override;
-
-  std::vector<std::vector<DataPtr>> DeconstructTuple(
-      absl::Span<const DataPtr> tuples) override;
-
-  std::string GetResourceDomain(const std::string& device) const override;
-
-  std::string GetDefaultDevice() const override;
-
-  swift_xla::Device GetDefaultDeviceStruct() const override;
-
-  size_t GetNumDevices() const override;
-
-  std::map<std::string, Metric> GetMetrics() const override;
-
-  std::vector<std::string> GetLocalDevices() const override;
-
-  std::vector<std::string> GetAllDevices() const override;
-
-  void SetReplicationDevices(std::vector<std::string> devices) override;
+// The cost model of a simulated device. The zero bandwidths and throughputs
+// stand for infinitely fast ones.
+struct FakeDeviceOptions {
+  // Compile latency, as a fixed part and a part per HLO instruction.
+  double compile_ms = 0;
+  double compile_us_per_instruction = 0;
+  // Execution time, as the launch latency plus the larger of the time spent
+  // on the FLOPs and on the bytes accessed of the computation, plus the time
+  // spent moving the results of its collectives over the interconnect.
+  double launch_us = 0;
+  double gflops = 0;
+  double memory_gbps = 0;
+  double interconnect_gbps = 0;
+  // Host to device and device to host transfer time, as a fixed latency plus
+  // the time moving the bytes.
+  double transfer_latency_us = 0;
+  double transfer_gbps = 0;
+  // The memory capacity of the device, or 0 if unlimited.
+  int64 memory_bytes = 0;
+};
 
-  const std::vector<std::string>& GetReplicationDevices() const override;
+// Reads the cost model from the XLA_FAKE_* environment variables.
+FakeDeviceOptions GetFakeDeviceOptionsFromEnv();
 
-  void SetRngSeed(size_t seed) override;
+// Creates a device which holds no data and runs nothing, but takes the time
+// the cost model gives to compile, execute and transfer. The executions of the
+// device are serialized, and so are its transfers, but executions, transfers
+// and compiles overlap with each other, like on an accelerator with its own
+// copy engine.
+std::unique_ptr<ComputationClient::Device> MakeFakeDevice(
+    std::string name, FakeDeviceOptions options);
 
- private:
-  std::string default_device_ = "CPU:0";
-  std::vector<std::string> device_names_;
-};
+// Returns the XLA_FAKE_DEVICES simulated devices, of the XLA_FAKE_DEVICE_TYPE
+// type (GPU by default), which stand in for the local accelerators.
+std::vector<std::unique_ptr<ComputationClient::Device>> GetFakeDevices();
 
 }  // namespace xla
 
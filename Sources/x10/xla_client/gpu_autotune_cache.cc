@@ -0,0 +1,290 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/gpu_autotune_cache.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/xla_client/mesh_service.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#if XLA_CUDA
+#include "tensorflow/compiler/xla/autotune_results.pb.h"
+#include "tensorflow/compiler/xla/service/gpu/gemm_algorithm_picker.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_conv_algorithm_picker.h"
+#endif
+
+namespace xla {
+namespace gpu_autotune {
+
+#if XLA_CUDA
+
+namespace {
+
+struct CacheState {
+  absl::Mutex mutex;
+  // The device keys whose stored results have been loaded.
+  std::set<std::string> loaded;
+  // The number of results at the latest store, by device key.
+  std::map<std::string, size_t> stored_counts;
+};
+
+CacheState* GetCacheState() {
+  static CacheState* state = new CacheState();
+  return state;
+}
+
+const std::string& GetCacheDir() {
+  static const std::string* dir = new std::string(
+      sys_util::GetEnvString("XLA_GPU_AUTOTUNE_CACHE_DIR", ""));
+  return *dir;
+}
+
+service::MeshClient* GetSharingClient() {
+  static const bool sharing =
+      sys_util::GetEnvBool("XLA_MESH_AUTOTUNE_SHARING", false);
+  return sharing ? service::MeshClient::Get() : nullptr;
+}
+
+bool IsCudaExecutor(se::StreamExecutor* executor) {
+  return executor->platform()->Name() == "CUDA";
+}
+
+// Identifies the GPU model and driver the results have been timed on, as a
+// valid file name.
+std::string GetDeviceKey(se::StreamExecutor* executor) {
+  const se::DeviceDescription& description = executor->GetDeviceDescription();
+  std::string key =
+      absl::StrCat(description.name(), "-", description.driver_version());
+  for (char& c : key) {
+    if (!absl::ascii_isalnum(c) && c != '.' && c != '-') {
+      c = '_';
+    }
+  }
+  return key;
+}
+
+std::string GetResultsPath(const std::string& device_key) {
+  return absl::StrCat(GetCacheDir(), "/", device_key, ".autotune");
+}
+
+Status WriteResults(AutotuneResults* results) {
+  TF_RETURN_IF_ERROR(
+      gpu::GpuConvAlgorithmPicker::WriteAutotuneResults(results));
+  return gpu::GemmAlgorithmPicker::WriteAutotuneResults(results);
+}
+
+size_t CountResults(const AutotuneResults& results) {
+  return results.dots_size() + results.convs_size();
+}
+
+using EntryKey = std::pair<std::string, std::string>;
+
+EntryKey GetEntryKey(const AutotuneResults::Entry& entry) {
+  return EntryKey(entry.device(), entry.hlo());
+}
+
+// Loads the results missing from the caches of the algorithm pickers, which
+// reject the results they already have. Returns the number of loaded results.
+size_t MergeResults(const AutotuneResults& results,
+                    const std::string& origin) {
+  AutotuneResults current;
+  Status status = WriteResults(&current);
+  std::set<EntryKey> known_dots;
+  std::set<EntryKey> known_convs;
+  for (const AutotuneResults::Entry& entry : current.dots()) {
+    known_dots.insert(GetEntryKey(entry));
+  }
+  for (const AutotuneResults::Entry& entry : current.convs()) {
+    known_convs.insert(GetEntryKey(entry));
+  }
+  AutotuneResults missing;
+  missing.set_version(results.version());
+  for (const AutotuneResults::Entry& entry : results.dots()) {
+    if (known_dots.count(GetEntryKey(entry)) == 0) {
+      *missing.add_dots() = entry;
+    }
+  }
+  for (const AutotuneResults::Entry& entry : results.convs()) {
+    if (known_convs.count(GetEntryKey(entry)) == 0) {
+      *missing.add_convs() = entry;
+    }
+  }
+  if (status.ok()) {
+    status = gpu::GpuConvAlgorithmPicker::LoadAutotuneResults(missing);
+  }
+  if (status.ok()) {
+    status = gpu::GemmAlgorithmPicker::LoadAutotuneResults(missing);
+  }
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to load the GPU autotune results of " << origin
+                    << ": " << status;
+    return 0;
+  }
+  return CountResults(missing);
+}
+
+absl::optional<AutotuneResults> ReadResultsFile(const std::string& path) {
+  std::ifstream results_file(path, std::ios::binary);
+  if (!results_file) {
+    return absl::nullopt;
+  }
+  std::string serialized((std::istreambuf_iterator<char>(results_file)),
+                         std::istreambuf_iterator<char>());
+  AutotuneResults results;
+  if (!results.ParseFromString(serialized)) {
+    TF_LOG(WARNING) << "Ignoring malformed GPU autotune results " << path;
+    return absl::nullopt;
+  }
+  return results;
+}
+
+// Like the persistent cache entries, the file is written to a temporary path
+// first and then renamed into place, so that concurrent processes never read
+// partial results.
+void WriteResultsFile(const std::string& path,
+                      const AutotuneResults& results) {
+  static std::atomic<size_t> tmp_count(0);
+  std::string tmp_path =
+      absl::StrCat(path, ".tmp.", getpid(), ".", tmp_count.fetch_add(1));
+  {
+    std::ofstream results_file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!results.SerializeToOstream(&results_file)) {
+      TF_LOG(WARNING) << "Unable to write GPU autotune results " << tmp_path;
+      results_file.close();
+      std::remove(tmp_path.c_str());
+      return;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    TF_LOG(WARNING) << "Unable to publish GPU autotune results " << path;
+    std::remove(tmp_path.c_str());
+  }
+}
+
+std::string GetSharedKey(se::StreamExecutor* executor,
+                         const std::string& computation_key) {
+  return absl::StrCat("gpu_autotune/", GetDeviceKey(executor), "/",
+                      computation_key);
+}
+
+}  // namespace
+
+void LoadStoredResults(se::StreamExecutor* executor) {
+  if (GetCacheDir().empty() || !IsCudaExecutor(executor)) {
+    return;
+  }
+  std::string device_key = GetDeviceKey(executor);
+  CacheState* state = GetCacheState();
+  absl::MutexLock lock(&state->mutex);
+  if (!state->loaded.insert(device_key).second) {
+    return;
+  }
+  std::string path = GetResultsPath(device_key);
+  absl::optional<AutotuneResults> results = ReadResultsFile(path);
+  if (!results) {
+    return;
+  }
+  size_t count = MergeResults(*results, path);
+  state->stored_counts[device_key] = CountResults(*results);
+  TF_VLOG(2) << "Loaded " << count << " GPU autotune results from " << path;
+  XLA_COUNTER("GpuAutotuneResultsLoaded", count);
+}
+
+bool AcquireSharedResults(se::StreamExecutor* executor,
+                          const std::string& computation_key) {
+  service::MeshClient* client = GetSharingClient();
+  if (client == nullptr || !IsCudaExecutor(executor)) {
+    return false;
+  }
+  std::string shared_key = GetSharedKey(executor, computation_key);
+  absl::optional<std::string> shared = client->AcquireArtifact(shared_key);
+  if (!shared) {
+    return true;
+  }
+  AutotuneResults results;
+  if (!results.ParseFromString(*shared)) {
+    TF_LOG(WARNING) << "Ignoring malformed GPU autotune results "
+                    << shared_key;
+    return false;
+  }
+  CacheState* state = GetCacheState();
+  absl::MutexLock lock(&state->mutex);
+  XLA_COUNTER("GpuAutotuneSharedFetches", 1);
+  XLA_COUNTER("GpuAutotuneResultsLoaded", MergeResults(results, shared_key));
+  return false;
+}
+
+void UpdateResults(se::StreamExecutor* executor,
+                   const std::string& computation_key, bool publish) {
+  bool store = !GetCacheDir().empty();
+  if ((!store && !publish) || !IsCudaExecutor(executor)) {
+    return;
+  }
+  AutotuneResults results;
+  Status status = WriteResults(&results);
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to collect the GPU autotune results: "
+                    << status;
+    return;
+  }
+  if (publish) {
+    GetSharingClient()->PublishArtifact(
+        GetSharedKey(executor, computation_key), results.SerializeAsString());
+  }
+  if (!store) {
+    return;
+  }
+  std::string device_key = GetDeviceKey(executor);
+  CacheState* state = GetCacheState();
+  absl::MutexLock lock(&state->mutex);
+  size_t& stored_count = state->stored_counts[device_key];
+  if (CountResults(results) <= stored_count) {
+    return;
+  }
+  WriteResultsFile(GetResultsPath(device_key), results);
+  stored_count = CountResults(results);
+  XLA_COUNTER("GpuAutotuneResultsStored", 1);
+}
+
+#else  // XLA_CUDA
+
+void LoadStoredResults(se::StreamExecutor* executor) {}
+
+bool AcquireSharedResults(se::StreamExecutor* executor,
+                          const std::string& computation_key) {
+  return false;
+}
+
+void UpdateResults(se::StreamExecutor* executor,
+                   const std::string& computation_key, bool publish) {}
+
+#endif  // XLA_CUDA
+
+}  // namespace gpu_autotune
+}  // namespace xla
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_GPU_AUTOTUNE_CACHE_H_
+#define X10_XLA_CLIENT_GPU_AUTOTUNE_CACHE_H_
+
+#include <string>
+
+#include "tensorflow/stream_executor/stream_executor.h"
+
+namespace xla {
+namespace gpu_autotune {
+
+// The XLA GPU compiler picks the convolution and GEMM algorithms by timing
+// them, and keeps the results in process wide caches, so every new process
+// times them again. These functions persist the results across processes, in
+// the XLA_GPU_AUTOTUNE_CACHE_DIR folder, and across hosts, through the mesh
+// service artifacts. The results are keyed by GPU model and driver version.
+// All of them are no-ops on executors other than CUDA ones.
+
+// Loads the results stored for the GPU model and driver of the executor, the
+// first time it is called for them.
+void LoadStoredResults(se::StreamExecutor* executor);
+
+// To be called before compiling the computation with the given key. With
+// XLA_MESH_AUTOTUNE_SHARING, fetches the results another host published
+// after compiling the same computation, waiting for them if that host is
+// still compiling. Returns whether the caller is the first host compiling it,
+// and should publish its results.
+bool AcquireSharedResults(se::StreamExecutor* executor,
+                          const std::string& computation_key);
+
+// To be called after compiling the computation with the given key. Stores the
+// results, if the compilation added some, and publishes them to the other
+// hosts if requested.
+void UpdateResults(se::StreamExecutor* executor,
+                   const std::string& computation_key, bool publish);
+
+}  // namespace gpu_autotune
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_GPU_AUTOTUNE_CACHE_H_
@@ -1,17 +1,40 @@
 #include "tensorflow/compiler/xla/xla_client/local_device.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <set>
+#include <thread>
 #include <tuple>
 
 #include "absl/container/node_hash_map.h"
 #include "absl/container/node_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/xla_client/cuda_graph.h"
+#include "tensorflow/compiler/xla/xla_client/cuda_ipc.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/event_tracer.h"
+#include "tensorflow/compiler/xla/xla_client/gpu_autotune_cache.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/step_profiler.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
 #include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/stream_executor/device_memory_allocator.h"
+#include "tensorflow/stream_executor/event.h"
 
 namespace xla {
 namespace {
@@ -28,13 +51,23 @@ using ExecuteComputationOptions = ComputationClient::ExecuteComputationOptions;
 
 namespace {
 
+// The devices are the replicas of the computation, or its partitions when it
+// is SPMD partitioned.
 std::unique_ptr<xla::DeviceAssignment> GetAssignment(
-    const std::vector<std::string>& devices) {
+    const std::vector<std::string>& devices, bool spmd_partitioned) {
   std::unique_ptr<xla::DeviceAssignment> assignment;
   if (devices.size() > 1) {
-    assignment = std::make_unique<xla::DeviceAssignment>(devices.size(), 1);
+    int num_devices = devices.size();
+    assignment = spmd_partitioned
+                     ? std::make_unique<xla::DeviceAssignment>(1, num_devices)
+                     : std::make_unique<xla::DeviceAssignment>(num_devices, 1);
     for (size_t i = 0; i < devices.size(); ++i) {
-      (*assignment)(i, 0) = GetX10Device(devices[i])->mesh_id();
+      int32_t mesh_id = GetX10Device(devices[i])->mesh_id();
+      if (spmd_partitioned) {
+        (*assignment)(0, i) = mesh_id;
+      } else {
+        (*assignment)(i, 0) = mesh_id;
+      }
     }
   }
   return assignment;
@@ -51,6 +84,7 @@ struct ConcurrentCompileDedupping {
     std::string result_layout;
     std::string computation;
     int64 num_replicas;
+    bool fast_compile;
     size_t hash = ComputeHash();
     size_t ComputeHash() const {
       util::PartialHasher<std::string, 4096> hasher;
@@ -59,7 +93,8 @@ struct ConcurrentCompileDedupping {
     bool operator==(const Key& other) const {
       return computation == other.computation &&
              result_layout == other.result_layout &&
-             num_replicas == other.num_replicas && client == other.client;
+             num_replicas == other.num_replicas &&
+             fast_compile == other.fast_compile && client == other.client;
     }
   };
   struct Hasher {
@@ -117,14 +152,723 @@ std::vector<const xla::Shape*> ArgumentLayoutAsPointers(
   return argument_layout_ptrs;
 }
 
+// A pool of host staging buffers for the transfers to the device, binned by
+// power of two size classes. Buffers are page locked when the device is not the
+// host, so that DMA can run straight from them, and go back to the pool once
+// the transfer using them is done, up to a maximum amount of cached bytes.
+class StagingBufferPool {
+ public:
+  class Returner {
+   public:
+    Returner() = default;
+    Returner(StagingBufferPool* pool, size_t size)
+        : pool_(pool), size_(size) {}
+
+    void operator()(char* data) const {
+      if (data != nullptr) {
+        pool_->Release(data, size_);
+      }
+    }
+
+   private:
+    StagingBufferPool* pool_ = nullptr;
+    size_t size_ = 0;
+  };
+
+  using BufferPtr = std::unique_ptr<char, Returner>;
+
+  StagingBufferPool(se::StreamExecutor* executor, bool pinned)
+      : executor_(executor), pinned_(pinned) {}
+
+  ~StagingBufferPool() {
+    for (auto& size_buffers : free_buffers_) {
+      for (char* data : size_buffers.second) {
+        Free(data);
+      }
+    }
+  }
+
+  BufferPtr Acquire(size_t size) {
+    size_t size_class = GetSizeClass(size);
+    {
+      absl::MutexLock lock(&mutex_);
+      auto it = free_buffers_.find(size_class);
+      if (it != free_buffers_.end() && !it->second.empty()) {
+        char* data = it->second.back();
+        it->second.pop_back();
+        cached_bytes_ -= size_class;
+        XLA_COUNTER("StagingBufferHit", 1);
+        return BufferPtr(data, Returner(this, size_class));
+      }
+    }
+    XLA_COUNTER("StagingBufferMiss", 1);
+    char* data = nullptr;
+    if (pinned_) {
+      data = static_cast<char*>(executor_->HostMemoryAllocate(size_class));
+      XLA_CHECK(data != nullptr)
+          << "Unable to allocate " << size_class << " bytes of pinned memory";
+    } else {
+      data = new char[size_class];
+    }
+    return BufferPtr(data, Returner(this, size_class));
+  }
+
+ private:
+  static size_t GetSizeClass(size_t size) {
+    size_t size_class = 4096;
+    while (size_class < size) {
+      size_class <<= 1;
+    }
+    return size_class;
+  }
+
+  static size_t GetMaxCachedBytes() {
+    static const size_t max_cached_bytes =
+        sys_util::GetEnvInt("XLA_STAGING_POOL_BYTES", 1LL << 30);
+    return max_cached_bytes;
+  }
+
+  void Release(char* data, size_t size_class) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (cached_bytes_ + size_class <= GetMaxCachedBytes()) {
+        free_buffers_[size_class].push_back(data);
+        cached_bytes_ += size_class;
+        return;
+      }
+    }
+    Free(data);
+  }
+
+  void Free(char* data) {
+    if (pinned_) {
+      executor_->HostMemoryDeallocate(data);
+    } else {
+      delete[] data;
+    }
+  }
+
+  se::StreamExecutor* executor_;
+  bool pinned_;
+  absl::Mutex mutex_;
+  absl::node_hash_map<size_t, std::vector<char*>> free_buffers_
+      ABSL_GUARDED_BY(mutex_);
+  size_t cached_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+
+// A caching layer over the backend device allocator, binned by size classes.
+// Freed blocks stay in the pool, tagged with the id of the next computation to
+// be issued on the device compute stream. Work running on the compute stream
+// is ordered after every computation issued before, so it can reuse any cached
+// block right away, while transfers, which run on sub-streams, only reuse the
+// blocks whose computations have all finished. When the backend runs out of
+// memory, the cached blocks are handed back to it and the allocation retried.
+// The blocks a computation allocates through its own ring allocator go back to
+// its ring when freed, and serve its next runs before the shared cache, so the
+// buffers of its previous outputs become the ones of the next outputs.
+class DeviceMemoryPool {
+ public:
+  class Allocator : public se::DeviceMemoryAllocator {
+   public:
+    Allocator(DeviceMemoryPool* pool, bool stream_ordered, int64 ring_id = -1)
+        : se::DeviceMemoryAllocator(pool->backend_->platform()),
+          pool_(pool),
+          stream_ordered_(stream_ordered),
+          ring_id_(ring_id) {}
+
+    ~Allocator() override {
+      if (ring_id_ >= 0) {
+        pool_->DropRing(ring_id_);
+      }
+    }
+
+    se::port::StatusOr<se::OwningDeviceMemory> Allocate(
+        int device_ordinal, uint64 size, bool retry_on_failure,
+        int64 memory_space) override {
+      return pool_->Allocate(this, device_ordinal, size, retry_on_failure,
+                             memory_space, stream_ordered_, ring_id_);
+    }
+
+    se::port::Status Deallocate(int device_ordinal,
+                                se::DeviceMemoryBase mem) override {
+      return pool_->Deallocate(device_ordinal, mem);
+    }
+
+    bool AllowsAsynchronousDeallocation() const override {
+      return pool_->backend_->AllowsAsynchronousDeallocation();
+    }
+
+    se::port::StatusOr<se::Stream*> GetStream(int device_ordinal) override {
+      return pool_->backend_->GetStream(device_ordinal);
+    }
+
+   private:
+    DeviceMemoryPool* pool_;
+    bool stream_ordered_;
+    int64 ring_id_;
+  };
+
+  // The next_id_fn returns the id of the next computation to be issued on the
+  // compute streams, and done_id_fn the one of the first unfinished one. The
+  // compute allocations can reuse the blocks released by computations still
+  // running only when there is a single compute stream, which orders them.
+  DeviceMemoryPool(se::DeviceMemoryAllocator* backend, int device_ordinal,
+                   std::function<int64()> next_id_fn,
+                   std::function<int64()> done_id_fn, bool single_stream)
+      : backend_(backend),
+        device_ordinal_(device_ordinal),
+        next_id_fn_(std::move(next_id_fn)),
+        done_id_fn_(std::move(done_id_fn)),
+        single_stream_(single_stream),
+        compute_allocator_(this, /*stream_ordered=*/single_stream),
+        transfer_allocator_(this, /*stream_ordered=*/false) {}
+
+  ~DeviceMemoryPool() { ReleaseCached(); }
+
+  // The allocator for the work enqueued on the compute streams.
+  se::DeviceMemoryAllocator* compute_allocator() {
+    return IsEnabled() ? &compute_allocator_ : backend_;
+  }
+
+  // The allocator for the transfers, which run on compute stream sub-streams.
+  se::DeviceMemoryAllocator* transfer_allocator() {
+    return IsEnabled() ? &transfer_allocator_ : backend_;
+  }
+
+  // Returns a compute allocator with its own ring of blocks, for the runs of
+  // one computation, or nullptr if the pool is disabled. Destroying it hands
+  // the blocks of the ring back to the shared cache.
+  std::unique_ptr<se::DeviceMemoryAllocator> NewRingAllocator() {
+    if (!IsEnabled()) {
+      return nullptr;
+    }
+    absl::MutexLock lock(&mutex_);
+    int64 ring_id = next_ring_id_++;
+    rings_[ring_id];
+    return std::make_unique<Allocator>(this, /*stream_ordered=*/single_stream_,
+                                       ring_id);
+  }
+
+  // Returns the bytes of the blocks in use, or -1 if the pool is disabled, as
+  // the backend allocations are not tracked then.
+  int64 GetInUseBytes() {
+    if (!IsEnabled()) {
+      return -1;
+    }
+    absl::MutexLock lock(&mutex_);
+    return in_use_reserved_bytes_;
+  }
+
+  void GetMetrics(const std::string& device_name,
+                  std::map<std::string, Metric>* metrics) {
+    absl::MutexLock lock(&mutex_);
+    auto add_metric = [&](const char* name, int64 value) {
+      Metric metric;
+      metric.int64_value = value;
+      (*metrics)[absl::StrCat(name, ".", device_name)] = std::move(metric);
+    };
+    size_t reserved_bytes = in_use_reserved_bytes_ + cached_bytes_;
+    add_metric("DevicePoolInUseBytes", in_use_bytes_);
+    add_metric("DevicePoolReservedBytes", reserved_bytes);
+    add_metric("DevicePoolPeakReservedBytes", peak_reserved_bytes_);
+    add_metric("DevicePoolCachedBytes", cached_bytes_);
+    add_metric("DevicePoolHits", hits_);
+    add_metric("DevicePoolRingHits", ring_hits_);
+    add_metric("DevicePoolMisses", misses_);
+    if (hits_ + misses_ > 0) {
+      add_metric("DevicePoolHitRatePercent", 100 * hits_ / (hits_ + misses_));
+    }
+    if (reserved_bytes > 0) {
+      add_metric("DevicePoolFragmentationPercent",
+                 100 * (reserved_bytes - in_use_bytes_) / reserved_bytes);
+    }
+  }
+
+ private:
+  struct Block {
+    size_t size_class = 0;
+    size_t size = 0;
+    // The ring the block returns to when freed, or -1.
+    int64 ring_id = -1;
+  };
+
+  struct CachedBlock {
+    void* opaque = nullptr;
+    int64 computation_id = 0;
+  };
+
+  static bool IsEnabled() {
+    static const bool enabled =
+        sys_util::GetEnvBool("XLA_DEVICE_MEMORY_POOL", true);
+    return enabled;
+  }
+
+  // Small sizes go to power of two classes, while large ones are rounded up to
+  // a multiple of 2MB, to bound the memory wasted by the rounding.
+  static size_t GetSizeClass(size_t size) {
+    static const size_t kLargeSize = 1 << 20;
+    static const size_t kLargeGranularity = 2 << 20;
+    if (size > kLargeSize) {
+      return (size + kLargeGranularity - 1) / kLargeGranularity *
+             kLargeGranularity;
+    }
+    size_t size_class = 256;
+    while (size_class < size) {
+      size_class <<= 1;
+    }
+    return size_class;
+  }
+
+  static size_t GetMaxCachedBytes() {
+    static const size_t max_cached_bytes = sys_util::GetEnvInt(
+        "XLA_DEVICE_POOL_MAX_CACHED_BYTES", std::numeric_limits<int64>::max());
+    return max_cached_bytes;
+  }
+
+  using FreeBlocks = absl::node_hash_map<size_t, std::vector<CachedBlock>>;
+
+  // Takes the most recently freed block of the size class which the work can
+  // reuse, or returns nullptr.
+  static void* TakeCachedBlock(FreeBlocks* free_blocks, size_t size_class,
+                               int64 done_id) {
+    auto it = free_blocks->find(size_class);
+    if (it == free_blocks->end()) {
+      return nullptr;
+    }
+    std::vector<CachedBlock>& blocks = it->second;
+    for (size_t i = blocks.size(); i > 0; --i) {
+      if (blocks[i - 1].computation_id <= done_id) {
+        void* opaque = blocks[i - 1].opaque;
+        blocks.erase(blocks.begin() + i - 1);
+        return opaque;
+      }
+    }
+    return nullptr;
+  }
+
+  se::port::StatusOr<se::OwningDeviceMemory> Allocate(
+      se::DeviceMemoryAllocator* allocator, int device_ordinal, uint64 size,
+      bool retry_on_failure, int64 memory_space, bool stream_ordered,
+      int64 ring_id) {
+    if (size == 0 || memory_space != 0 || device_ordinal != device_ordinal_) {
+      return backend_->Allocate(device_ordinal, size, retry_on_failure,
+                                memory_space);
+    }
+    size_t size_class = GetSizeClass(size);
+    int64 done_id = stream_ordered ? std::numeric_limits<int64>::max()
+                                   : done_id_fn_();
+    {
+      absl::MutexLock lock(&mutex_);
+      void* opaque = nullptr;
+      auto ring_it = rings_.find(ring_id);
+      if (ring_it != rings_.end()) {
+        opaque = TakeCachedBlock(&ring_it->second, size_class, done_id);
+        if (opaque != nullptr) {
+          ++ring_hits_;
+        }
+      }
+      if (opaque == nullptr) {
+        opaque = TakeCachedBlock(&free_blocks_, size_class, done_id);
+      }
+      if (opaque != nullptr) {
+        cached_bytes_ -= size_class;
+        ++hits_;
+        AddInUseBlock(opaque, size_class, size, ring_id);
+        return se::OwningDeviceMemory(se::DeviceMemoryBase(opaque, size),
+                                      device_ordinal, allocator);
+      }
+      ++misses_;
+    }
+    auto memory_or = backend_->Allocate(device_ordinal, size_class,
+                                        retry_on_failure, memory_space);
+    if (!memory_or.ok() && ReleaseCached() > 0) {
+      XLA_COUNTER("DevicePoolOomRetries", 1);
+      memory_or = backend_->Allocate(device_ordinal, size_class,
+                                     retry_on_failure, memory_space);
+    }
+    if (!memory_or.ok()) {
+      return memory_or.status();
+    }
+    se::DeviceMemoryBase memory = memory_or.ConsumeValueOrDie().Release();
+    {
+      absl::MutexLock lock(&mutex_);
+      AddInUseBlock(memory.opaque(), size_class, size, ring_id);
+    }
+    return se::OwningDeviceMemory(se::DeviceMemoryBase(memory.opaque(), size),
+                                  device_ordinal, allocator);
+  }
+
+  se::port::Status Deallocate(int device_ordinal, se::DeviceMemoryBase mem) {
+    if (mem.is_null()) {
+      return se::port::Status::OK();
+    }
+    int64 computation_id = next_id_fn_();
+    {
+      absl::MutexLock lock(&mutex_);
+      auto it = in_use_blocks_.find(mem.opaque());
+      if (it != in_use_blocks_.end()) {
+        Block block = it->second;
+        in_use_blocks_.erase(it);
+        in_use_bytes_ -= block.size;
+        in_use_reserved_bytes_ -= block.size_class;
+        if (cached_bytes_ + block.size_class <= GetMaxCachedBytes()) {
+          auto ring_it = rings_.find(block.ring_id);
+          FreeBlocks& free_blocks =
+              ring_it != rings_.end() ? ring_it->second : free_blocks_;
+          free_blocks[block.size_class].push_back(
+              {mem.opaque(), computation_id});
+          cached_bytes_ += block.size_class;
+          return se::port::Status::OK();
+        }
+        mem = se::DeviceMemoryBase(mem.opaque(), block.size_class);
+      }
+    }
+    return backend_->Deallocate(device_ordinal, mem);
+  }
+
+  void AddInUseBlock(void* opaque, size_t size_class, size_t size,
+                     int64 ring_id) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    in_use_blocks_[opaque] = {size_class, size, ring_id};
+    in_use_bytes_ += size;
+    in_use_reserved_bytes_ += size_class;
+    peak_reserved_bytes_ = std::max(peak_reserved_bytes_,
+                                    in_use_reserved_bytes_ + cached_bytes_);
+  }
+
+  // Moves the cached blocks of the ring to the shared cache, where their
+  // in-use blocks also go once freed.
+  void DropRing(int64 ring_id) {
+    absl::MutexLock lock(&mutex_);
+    auto ring_it = rings_.find(ring_id);
+    for (auto& size_blocks : ring_it->second) {
+      std::vector<CachedBlock>& blocks = free_blocks_[size_blocks.first];
+      blocks.insert(blocks.end(), size_blocks.second.begin(),
+                    size_blocks.second.end());
+    }
+    rings_.erase(ring_it);
+  }
+
+  // Hands all the cached blocks, including the ones of the rings, back to the
+  // backend allocator, and returns their total size.
+  size_t ReleaseCached() {
+    std::vector<FreeBlocks> free_blocks(1);
+    size_t released_bytes = 0;
+    {
+      absl::MutexLock lock(&mutex_);
+      std::swap(free_blocks.front(), free_blocks_);
+      for (auto& id_ring : rings_) {
+        free_blocks.emplace_back();
+        std::swap(free_blocks.back(), id_ring.second);
+      }
+      released_bytes = cached_bytes_;
+      cached_bytes_ = 0;
+    }
+    for (auto& blocks_by_size : free_blocks) {
+      for (auto& size_blocks : blocks_by_size) {
+        for (auto& block : size_blocks.second) {
+          TF_CHECK_OK(backend_->Deallocate(
+              device_ordinal_,
+              se::DeviceMemoryBase(block.opaque, size_blocks.first)));
+        }
+      }
+    }
+    return released_bytes;
+  }
+
+  se::DeviceMemoryAllocator* backend_;
+  int device_ordinal_;
+  std::function<int64()> next_id_fn_;
+  std::function<int64()> done_id_fn_;
+  bool single_stream_;
+  Allocator compute_allocator_;
+  Allocator transfer_allocator_;
+  absl::Mutex mutex_;
+  FreeBlocks free_blocks_ ABSL_GUARDED_BY(mutex_);
+  // The cached blocks of the rings, by ring id.
+  absl::node_hash_map<int64, FreeBlocks> rings_ ABSL_GUARDED_BY(mutex_);
+  int64 next_ring_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::node_hash_map<void*, Block> in_use_blocks_ ABSL_GUARDED_BY(mutex_);
+  size_t in_use_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t in_use_reserved_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t cached_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t peak_reserved_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64 hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64 ring_hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64 misses_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+// A device block holding several small tensors transferred at once. Its
+// pieces are handed out as buffers whose release returns them to the block,
+// which deletes itself, freeing the memory, once they are all released.
+class PackedBlock : public se::DeviceMemoryAllocator {
+ public:
+  PackedBlock(se::DeviceMemoryAllocator* backend, se::OwningDeviceMemory memory,
+              size_t num_pieces)
+      : se::DeviceMemoryAllocator(backend->platform()),
+        backend_(backend),
+        memory_(std::move(memory)),
+        live_pieces_(num_pieces) {}
+
+  se::DeviceMemoryBase* memory() { return memory_.ptr(); }
+
+  // Returns the piece at the offset, which the caller releases.
+  se::OwningDeviceMemory Piece(size_t offset, size_t size) {
+    char* base = static_cast<char*>(memory_->opaque());
+    return se::OwningDeviceMemory(se::DeviceMemoryBase(base + offset, size),
+                                  memory_.device_ordinal(), this);
+  }
+
+  se::port::StatusOr<se::OwningDeviceMemory> Allocate(
+      int device_ordinal, uint64 size, bool retry_on_failure,
+      int64 memory_space) override {
+    return Unimplemented("Packed blocks do not allocate memory");
+  }
+
+  se::port::Status Deallocate(int device_ordinal,
+                              se::DeviceMemoryBase mem) override {
+    if (live_pieces_.fetch_sub(1) == 1) {
+      delete this;
+    }
+    return se::port::Status::OK();
+  }
+
+  bool AllowsAsynchronousDeallocation() const override {
+    return backend_->AllowsAsynchronousDeallocation();
+  }
+
+  se::port::StatusOr<se::Stream*> GetStream(int device_ordinal) override {
+    return backend_->GetStream(device_ordinal);
+  }
+
+ private:
+  se::DeviceMemoryAllocator* backend_;
+  se::OwningDeviceMemory memory_;
+  std::atomic<size_t> live_pieces_;
+};
+
+// Forwards the allocations XLA makes while a computation is captured into a
+// CUDA graph, and keeps the ones it releases, as the graph writes to all of
+// them each time it replays.
+class CaptureAllocator : public se::DeviceMemoryAllocator {
+ public:
+  explicit CaptureAllocator(se::DeviceMemoryAllocator* backend)
+      : se::DeviceMemoryAllocator(backend->platform()), backend_(backend) {}
+
+  se::port::StatusOr<se::OwningDeviceMemory> Allocate(
+      int device_ordinal, uint64 size, bool retry_on_failure,
+      int64 memory_space) override {
+    TF_ASSIGN_OR_RETURN(se::OwningDeviceMemory memory,
+                        backend_->Allocate(device_ordinal, size,
+                                           retry_on_failure, memory_space));
+    se::DeviceMemoryBase base = memory.Release();
+    if (!base.is_null()) {
+      absl::MutexLock lock(&mutex_);
+      allocated_.emplace(base.opaque(), base);
+    }
+    return se::OwningDeviceMemory(base, device_ordinal, this);
+  }
+
+  se::port::Status Deallocate(int device_ordinal,
+                              se::DeviceMemoryBase mem) override {
+    absl::MutexLock lock(&mutex_);
+    if (allocated_.count(mem.opaque()) > 0) {
+      return se::port::Status::OK();
+    }
+    return backend_->Deallocate(device_ordinal, mem);
+  }
+
+  // The memory XLA releases while capturing is kept for the graph.
+  bool AllowsAsynchronousDeallocation() const override { return true; }
+
+  se::port::StatusOr<se::Stream*> GetStream(int device_ordinal) override {
+    return backend_->GetStream(device_ordinal);
+  }
+
+  bool IsCaptured(const void* opaque) {
+    absl::MutexLock lock(&mutex_);
+    return allocated_.count(opaque) > 0;
+  }
+
+  // Returns the memory allocated while capturing, which the caller owns.
+  std::vector<se::DeviceMemoryBase> TakeAllocated() {
+    absl::MutexLock lock(&mutex_);
+    std::vector<se::DeviceMemoryBase> allocated;
+    for (auto& opaque_memory : allocated_) {
+      allocated.push_back(opaque_memory.second);
+    }
+    allocated_.clear();
+    return allocated;
+  }
+
+ private:
+  se::DeviceMemoryAllocator* backend_;
+  absl::Mutex mutex_;
+  absl::node_hash_map<const void*, se::DeviceMemoryBase> allocated_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// A computation captured into a CUDA graph, see XLA_CUDA_GRAPHS. The graph
+// reads the argument buffers it was captured with, and writes the temporary
+// and result buffers allocated while capturing, which it owns. It hands its
+// results out as buffers whose release returns them to it, and replays only
+// once they are all released, so that it never overwrites live results. It
+// deletes itself, giving the memory back, once its owner has dropped it and
+// the results are released.
+class CapturedGraph : public se::DeviceMemoryAllocator {
+ public:
+  CapturedGraph(se::DeviceMemoryAllocator* backend, int device_ordinal,
+                std::vector<const void*> argument_addresses,
+                std::unique_ptr<cuda_graph::Graph> graph, ShapedBuffer result,
+                std::vector<se::DeviceMemoryBase> memory)
+      : se::DeviceMemoryAllocator(backend->platform()),
+        backend_(backend),
+        device_ordinal_(device_ordinal),
+        argument_addresses_(std::move(argument_addresses)),
+        graph_(std::move(graph)),
+        result_(std::move(result)),
+        memory_(std::move(memory)) {}
+
+  // Whether the graph can replay with the given argument buffers.
+  bool CanReplay(absl::Span<const void* const> argument_addresses) {
+    absl::MutexLock lock(&mutex_);
+    return live_results_ == 0 &&
+           absl::MakeConstSpan(argument_addresses_) == argument_addresses;
+  }
+
+  // Launches the graph on the stream and returns its results.
+  std::vector<ScopedShapedBuffer> Replay(se::Stream* stream) {
+    TF_CHECK_OK(graph_->Launch(stream));
+    size_t num_results = result_.on_host_shape().tuple_shapes_size();
+    std::vector<ScopedShapedBuffer> results;
+    results.reserve(num_results);
+    for (size_t i = 0; i < num_results; ++i) {
+      ShapeIndex index({static_cast<xla::int64>(i)});
+      ScopedShapedBuffer buffer(
+          ShapeUtil::GetSubshape(result_.on_host_shape(), index),
+          ShapeUtil::GetSubshape(result_.on_device_shape(), index), this,
+          device_ordinal_);
+      buffer.set_buffer(se::OwningDeviceMemory(result_.buffer(index),
+                                               device_ordinal_, this),
+                        {});
+      results.push_back(std::move(buffer));
+    }
+    absl::MutexLock lock(&mutex_);
+    live_results_ += num_results;
+    return results;
+  }
+
+  // Drops the reference of the owner.
+  void Unref() {
+    bool done = false;
+    {
+      absl::MutexLock lock(&mutex_);
+      owned_ = false;
+      done = live_results_ == 0;
+    }
+    if (done) {
+      delete this;
+    }
+  }
+
+  se::port::StatusOr<se::OwningDeviceMemory> Allocate(
+      int device_ordinal, uint64 size, bool retry_on_failure,
+      int64 memory_space) override {
+    return Unimplemented("Captured graphs do not allocate memory");
+  }
+
+  se::port::Status Deallocate(int device_ordinal,
+                              se::DeviceMemoryBase mem) override {
+    bool done = false;
+    {
+      absl::MutexLock lock(&mutex_);
+      --live_results_;
+      done = !owned_ && live_results_ == 0;
+    }
+    if (done) {
+      delete this;
+    }
+    return se::port::Status::OK();
+  }
+
+  bool AllowsAsynchronousDeallocation() const override {
+    return backend_->AllowsAsynchronousDeallocation();
+  }
+
+  se::port::StatusOr<se::Stream*> GetStream(int device_ordinal) override {
+    return backend_->GetStream(device_ordinal);
+  }
+
+ private:
+  ~CapturedGraph() override {
+    graph_.reset();
+    for (const se::DeviceMemoryBase& memory : memory_) {
+      TF_CHECK_OK(backend_->Deallocate(device_ordinal_, memory));
+    }
+  }
+
+  se::DeviceMemoryAllocator* backend_;
+  int device_ordinal_;
+  std::vector<const void*> argument_addresses_;
+  std::unique_ptr<cuda_graph::Graph> graph_;
+  ShapedBuffer result_;
+  std::vector<se::DeviceMemoryBase> memory_;
+  absl::Mutex mutex_;
+  bool owned_ ABSL_GUARDED_BY(mutex_) = true;
+  size_t live_results_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+// The ring allocators of a computation, by the pool of the device it runs on.
+struct BufferRings {
+  // Returns the allocator of the computation for the pool.
+  se::DeviceMemoryAllocator* GetAllocator(DeviceMemoryPool* pool) {
+    absl::MutexLock lock(&mutex);
+    auto it = allocators.find(pool);
+    if (it == allocators.end()) {
+      it = allocators.emplace(pool, pool->NewRingAllocator()).first;
+    }
+    return it->second != nullptr ? it->second.get()
+                                 : pool->compute_allocator();
+  }
+
+  absl::Mutex mutex;
+  absl::node_hash_map<DeviceMemoryPool*,
+                      std::unique_ptr<se::DeviceMemoryAllocator>>
+      allocators ABSL_GUARDED_BY(mutex);
+};
+
+// Tracks the executions of a computation, to capture it into a CUDA graph
+// once it keeps running with the same argument buffers.
+struct GraphReplay {
+  ~GraphReplay() {
+    if (graph != nullptr) {
+      graph->Unref();
+    }
+  }
+
+  absl::Mutex mutex;
+  std::vector<const void*> argument_addresses ABSL_GUARDED_BY(mutex);
+  int64 identical_runs ABSL_GUARDED_BY(mutex) = 0;
+  // Set when the capture fails, or the graph cannot replay the computation.
+  bool failed ABSL_GUARDED_BY(mutex) = false;
+  CapturedGraph* graph ABSL_GUARDED_BY(mutex) = nullptr;
+};
+
 }  // namespace
 
 class LocalTransferManager : public ComputationClient::TransferManager {
  public:
   std::vector<Literal> TransferFromServerImpl(
       absl::Span<const DataPtr> handles) override;
+
+  void TransferFromServerStreamingImpl(
+      absl::Span<const DataPtr> handles, size_t max_host_bytes,
+      const DestinationFn& destination_fn,
+      const ConsumerFn& consumer_fn) override;
 };
 
+struct LocalComputation;
+
 class LocalDevice : public ComputationClient::Device {
  public:
   LocalDevice(std::string name, xla::LocalClient* client, int device_ordinal,
@@ -134,28 +878,100 @@ class LocalDevice : public ComputationClient::Device {
         device_ordinal_(device_ordinal),
         mesh_id_(mesh_id),
         is_cpu_(is_cpu),
-        stream_(std::make_unique<se::Stream>(
-            client->backend().stream_executor(device_ordinal).ValueOrDie())),
         transfer_from_device_stream_(std::make_unique<se::Stream>(
-            client->backend().stream_executor(device_ordinal).ValueOrDie())) {
-    stream_->Init();
+            client->backend().stream_executor(device_ordinal).ValueOrDie())),
+        staging_pool_(
+            client->backend().stream_executor(device_ordinal).ValueOrDie(),
+            /*pinned=*/!is_cpu),
+        memory_pool_(
+            client->backend().memory_allocator(), device_ordinal,
+            [this]() { return next_computation_id(); },
+            [this]() { return done_computation_id(); },
+            /*single_stream=*/GetComputeStreamCount(is_cpu) == 1) {
+    se::StreamExecutor* executor =
+        client->backend().stream_executor(device_ordinal).ValueOrDie();
+    for (size_t i = 0; i < GetComputeStreamCount(is_cpu); ++i) {
+      compute_streams_.push_back(std::make_unique<se::Stream>(executor));
+      compute_streams_.back()->Init();
+    }
+    stream_last_ids_.resize(compute_streams_.size(), -1);
     transfer_from_device_stream_->Init();
+    memory_limit_ = sys_util::GetEnvInt("XLA_DEVICE_MEMORY_LIMIT", 0);
+    int64 free_bytes = 0;
+    int64 total_bytes = 0;
+    if (memory_limit_ <= 0 && !is_cpu &&
+        executor->DeviceMemoryUsage(&free_bytes, &total_bytes)) {
+      memory_limit_ = total_bytes;
+    }
+    if (!is_cpu) {
+      gpu_autotune::LoadStoredResults(executor);
+    }
   }
 
   xla::LocalClient* client() const { return client_; }
   int device_ordinal() const { return device_ordinal_; }
   int32_t mesh_id() const final { return mesh_id_; }
-  se::Stream* stream() const { return stream_.get(); }
+  // The first compute stream, on which the transfers get their sub-streams.
+  se::Stream* stream() const { return compute_streams_.front().get(); }
   se::Stream* transfer_from_device_stream() const {
     return transfer_from_device_stream_.get();
   }
   bool is_cpu() const { return is_cpu_; }
+  StagingBufferPool* staging_pool() { return &staging_pool_; }
+  DeviceMemoryPool* memory_pool() { return &memory_pool_; }
   TransferManager* GetTransferManager() const override {
     static LocalTransferManager local_transfer;
     return &local_transfer;
   }
   virtual bool IsLocal() { return true; }
 
+  static size_t GetComputeStreamCount(bool is_cpu) {
+    static const size_t num_streams =
+        std::max<int64>(sys_util::GetEnvInt("XLA_COMPUTE_STREAMS", 1), 1);
+    // The CPU computations run one at a time on the host stream thread.
+    return is_cpu ? 1 : num_streams;
+  }
+
+  // Whether the computations of the device return before they are done, and
+  // report their completion from a callback of the stream running them.
+  bool IsAsyncExecution() const {
+    static const bool cpu_async =
+        sys_util::GetEnvBool("XLA_CPU_ASYNC_EXECUTION", true);
+    return !is_cpu_ || cpu_async;
+  }
+
+  // Whether the computations get captured into CUDA graphs, which replay them
+  // for as long as they run with the same argument buffers.
+  bool UseCudaGraphs() const {
+    static const bool cuda_graphs =
+        sys_util::GetEnvBool("XLA_CUDA_GRAPHS", false) &&
+        cuda_graph::IsSupported();
+    // The graphs overwrite their results once released, which orders the
+    // replay after the readers of the results only with a single stream.
+    return cuda_graphs && !is_cpu_ && compute_streams_.size() == 1;
+  }
+
+  // Runs the computation through its CUDA graph, capturing the graph first
+  // if the computation ran enough times with the same argument buffers.
+  // Returns false if the computation has to run normally.
+  bool ExecuteGraph(const LocalComputation& computation,
+                    absl::Span<const ShapedBuffer* const> args,
+                    const ExecutableRunOptions& run_options,
+                    std::vector<ScopedShapedBuffer>* results);
+
+  // Captures the computation into a CUDA graph, or returns nullptr if it
+  // cannot be captured.
+  CapturedGraph* CaptureGraph(const LocalComputation& computation,
+                              absl::Span<const ShapedBuffer* const> args,
+                              const ExecutableRunOptions& run_options,
+                              std::vector<const void*> argument_addresses);
+
+  // Picks the compute stream for a computation reading the arguments, and
+  // makes it wait for the arguments computed on the other streams which are
+  // still running. Returns its index.
+  size_t AcquireComputeStream(absl::Span<const DataPtr> arguments,
+                              int64 computation_id);
+
   int64 RunAsyncStart() {
     mutex_.Lock();
     XLA_CHECK(mutex_.AwaitWithTimeout(
@@ -168,27 +984,50 @@ class LocalDevice : public ComputationClient::Device {
     mutex_.Unlock();
     return result;
   }
-  void RunAsyncFinish() {
+  void RunAsyncFinish(int64 computation_id) {
     mutex_.Lock();
     ++available_computation_slots_;
-    ++done_computation_id_;
+    // The computations of different streams finish out of order, the ones
+    // past the first unfinished one are kept aside until it finishes.
+    finished_computation_ids_.insert(computation_id);
+    while (!finished_computation_ids_.empty() &&
+           *finished_computation_ids_.begin() == done_computation_id_) {
+      finished_computation_ids_.erase(finished_computation_ids_.begin());
+      ++done_computation_id_;
+    }
     mutex_.Unlock();
   }
 
   void WaitUntilComputationFinished(int64 computation_id) {
     mutex_.Lock();
     auto cond = [&]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-      return computation_id < done_computation_id_;
+      return IsComputationFinished(computation_id);
     };
     XLA_CHECK(mutex_.AwaitWithTimeout(absl::Condition(&cond), absl::Hours(2)))
         << "TPU DEADLOCKED or very slow computation...";
     mutex_.Unlock();
   }
 
+  int64 next_computation_id() {
+    absl::MutexLock lock(&mutex_);
+    return next_computation_id_;
+  }
+
+  int64 done_computation_id() {
+    absl::MutexLock lock(&mutex_);
+    return done_computation_id_;
+  }
+
   bool HasAvailableComputationSlots() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
     return available_computation_slots_ > 0;
   }
 
+  bool IsComputationFinished(int64 computation_id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return computation_id < done_computation_id_ ||
+           finished_computation_ids_.count(computation_id) > 0;
+  }
+
   DataPtr CreateDataPlaceholder(Shape shape);
 
   std::vector<DataPtr> TransferToServer(
@@ -197,6 +1036,16 @@ class LocalDevice : public ComputationClient::Device {
   DataPtr TransferToServer(xla::BorrowingLiteral literal,
                            const xla::Shape& dest_shape) override;
 
+  bool CanTransferFromDevice(const Device& source) override;
+
+  DataPtr TransferFromDevice(const DataPtr& data) override;
+
+  std::string ExportData(const DataPtr& data) override;
+
+  void UnexportData(const std::string& handle) override;
+
+  DataPtr ImportData(const std::string& handle, const Shape& shape) override;
+
   std::vector<ComputationClient::ComputationPtr> Compile(
       const std::vector<std::string>& devices,
       std::vector<CompileInstance> instances) override;
@@ -214,55 +1063,126 @@ class LocalDevice : public ComputationClient::Device {
       const Computation& computation, absl::Span<const DataPtr> arguments,
       const ExecuteComputationOptions& options) override;
 
+  void GetMetrics(std::map<std::string, Metric>* metrics) override {
+    memory_pool_.GetMetrics(name(), metrics);
+  }
+
+  int64 GetMemoryInUse() override { return memory_pool_.GetInUseBytes(); }
+
+  int64 GetMemoryLimit() override {
+    return memory_limit_ > 0 ? memory_limit_ : -1;
+  }
+
  private:
   absl::Mutex mutex_;
   // This starts out as the number of allowable concurrent executions
   // on this particular device.
   int64 available_computation_slots_ ABSL_GUARDED_BY(mutex_) = 64;
-  // computation id assigned to the next computation executed on stream_.
+  // computation id assigned to the next computation executed on the compute
+  // streams.
   int64 next_computation_id_ ABSL_GUARDED_BY(mutex_) = 0;
-  // Incremented when computations finish.
-  // `computation_id < done_computation_id_` checks if a particular computation
-  // is complete.
+  // The computations with a lower id are all complete.
   int64 done_computation_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The complete computations whose id is above done_computation_id_.
+  std::set<int64> finished_computation_ids_ ABSL_GUARDED_BY(mutex_);
+  // The id of the last computation issued on each compute stream.
+  std::vector<int64> stream_last_ids_ ABSL_GUARDED_BY(mutex_);
+  size_t next_stream_ ABSL_GUARDED_BY(mutex_) = 0;
   xla::LocalClient* client_;
   int device_ordinal_;
   int32_t mesh_id_;
   bool is_cpu_;
-  std::unique_ptr<se::Stream> stream_;
+  std::vector<std::unique_ptr<se::Stream>> compute_streams_;
+  // Held while enqueuing computations when they get captured into CUDA graphs.
+  absl::Mutex launch_mutex_;
   std::unique_ptr<se::Stream> transfer_from_device_stream_;
+  StagingBufferPool staging_pool_;
+  DeviceMemoryPool memory_pool_;
+  // The devices this one can read the memory of, by their stream executor.
+  absl::Mutex peer_mutex_;
+  std::map<se::StreamExecutor*, bool> peer_access_ ABSL_GUARDED_BY(peer_mutex_);
+  // XLA_DEVICE_MEMORY_LIMIT if set, otherwise the memory of the device, or zero
+  // for the CPU, whose memory is the host one.
+  int64 memory_limit_ = 0;
+  // The buffers exported to other processes, by handle, with their number of
+  // exports, and the memory imported from them, which CUDA only lets a
+  // process map once.
+  struct ExportedBuffer {
+    std::shared_ptr<ScopedShapedBuffer> buffer;
+    size_t count = 0;
+  };
+  absl::Mutex ipc_mutex_;
+  std::map<std::string, ExportedBuffer> exported_buffers_
+      ABSL_GUARDED_BY(ipc_mutex_);
+  std::map<std::string, std::weak_ptr<cuda_ipc::ImportedMemory>>
+      imported_memory_ ABSL_GUARDED_BY(ipc_mutex_);
 };
 
 class LocalData : public Data {
  public:
   LocalData(Device* device, Shape shape) : Data(device, std::move(shape)) {}
-  LocalData(Device* device, ScopedShapedBuffer buffer, int64 computation_id)
+  LocalData(Device* device, ScopedShapedBuffer buffer, int64 computation_id,
+            int stream_index = -1, std::shared_ptr<se::Event> event = nullptr)
       : Data(device, buffer.on_host_shape()),
         buffer_(std::make_shared<ScopedShapedBuffer>(std::move(buffer))),
-        computation_id_(computation_id) {}
+        computation_id_(computation_id),
+        stream_index_(stream_index),
+        event_(std::move(event)) {}
+  // Borrows the buffer of another process, which the deleter of buffer
+  // unmaps.
+  LocalData(Device* device, std::shared_ptr<ScopedShapedBuffer> buffer)
+      : Data(device, buffer->on_host_shape()),
+        buffer_(std::move(buffer)),
+        computation_id_(-1),
+        stream_index_(-1),
+        shared_(true) {
+    SetMemoryKind(metrics::MemoryKind::kImported);
+  }
 
   void Assign(const Data& data) override {
     const LocalData& xrt_data = dynamic_cast<const LocalData&>(data);
     if (&xrt_data != this) {
       buffer_ = xrt_data.buffer_;
       computation_id_ = xrt_data.computation_id_;
+      stream_index_ = xrt_data.stream_index_;
+      event_ = xrt_data.event_;
+      shared_ = xrt_data.shared_;
     }
   }
 
   bool HasValue() const override { return buffer_ != nullptr; }
 
+  bool IsShared() const override { return shared_; }
+
+  void MarkShared() { shared_ = true; }
+
   OpaqueHandle GetOpaqueHandle() override {
     return reinterpret_cast<intptr_t>(buffer_.get());
   }
 
   const ShapedBuffer& buffer() const { return *buffer_; }
 
+  const std::shared_ptr<ScopedShapedBuffer>& buffer_ptr() const {
+    return buffer_;
+  }
+
   int64 computation_id() const { return computation_id_; }
 
+  // The compute stream of the computation which produced the buffer, or -1
+  // for transferred buffers, which are complete once they exist.
+  int stream_index() const { return stream_index_; }
+
+  // Recorded on the stream after the computation, with several compute
+  // streams.
+  const std::shared_ptr<se::Event>& event() const { return event_; }
+
  private:
   // TODO(parkers): Remove Assign() and allow buffer_ to be by value.
   std::shared_ptr<ScopedShapedBuffer> buffer_;
   int64 computation_id_;
+  int stream_index_;
+  std::shared_ptr<se::Event> event_;
+  bool shared_ = false;
 };
 
 struct LocalComputation : public Computation {
@@ -277,6 +1197,8 @@ struct LocalComputation : public Computation {
   // finished async.
   std::shared_ptr<LocalExecutable> handle;
   std::shared_ptr<DeviceAssignment> assignment;
+  std::unique_ptr<GraphReplay> graph_replay = std::make_unique<GraphReplay>();
+  std::unique_ptr<BufferRings> buffer_rings = std::make_unique<BufferRings>();
 };
 
 DataPtr LocalDevice::CreateDataPlaceholder(Shape shape) {
@@ -286,13 +1208,15 @@ DataPtr LocalDevice::CreateDataPlaceholder(Shape shape) {
 DataPtr LocalDevice::TransferToServer(xla::BorrowingLiteral literal,
                                       const xla::Shape& dest_shape) {
   tensorflow::profiler::TraceMe trace("TransferSingleTensorToServer");
+  XLA_TRACE_SPAN("TransferSingleTensorToServer");
+  XLA_STEP_TIMER(kTransfer);
 
   stream_executor::DeviceMemoryAllocator* allocator =
-      client()->backend().memory_allocator();
+      memory_pool_.transfer_allocator();
   xla::TransferManager* transfer_manager =
       client()->backend().transfer_manager();
 
-  se::Stream* stream = stream_->GetOrCreateSubStream();
+  se::Stream* stream = stream()->GetOrCreateSubStream();
 
   ScopedShapedBuffer buffer = [&] {
     tensorflow::profiler::TraceMe trace("Allocate");
@@ -307,27 +1231,203 @@ DataPtr LocalDevice::TransferToServer(xla::BorrowingLiteral literal,
 
   TF_CHECK_OK(stream->BlockHostUntilDone());
 
-  stream_->ReturnSubStream(stream);
+  stream()->ReturnSubStream(stream);
 
   return std::make_shared<LocalData>(this, std::move(buffer), -1);
 }
 
+bool LocalDevice::CanTransferFromDevice(const Device& source) {
+  static const bool peer_copy =
+      sys_util::GetEnvBool("XLA_PEER_DEVICE_COPY", true);
+  const LocalDevice* local_source = dynamic_cast<const LocalDevice*>(&source);
+  if (!peer_copy || local_source == nullptr || local_source == this ||
+      local_source->client() != client_ || is_cpu_ || local_source->is_cpu()) {
+    return false;
+  }
+  se::StreamExecutor* source_executor = local_source->stream()->parent();
+  absl::MutexLock lock(&peer_mutex_);
+  auto it = peer_access_.find(source_executor);
+  if (it == peer_access_.end()) {
+    se::StreamExecutor* executor = stream()->parent();
+    bool enabled = executor->CanEnablePeerAccessTo(source_executor) &&
+                   executor->EnablePeerAccessTo(source_executor).ok();
+    TF_VLOG(1) << "Peer access from " << name() << " to "
+               << local_source->name() << ": " << enabled;
+    it = peer_access_.emplace(source_executor, enabled).first;
+  }
+  return it->second;
+}
+
+DataPtr LocalDevice::TransferFromDevice(const DataPtr& data) {
+  tensorflow::profiler::TraceMe trace("TransferFromDevice");
+  XLA_TRACE_SPAN("TransferFromDevice");
+  const auto& local_data = dynamic_cast<const LocalData&>(*data);
+  LocalDevice* source = dynamic_cast<LocalDevice*>(local_data.device());
+  source->WaitUntilComputationFinished(local_data.computation_id());
+  const ShapedBuffer& source_buffer = local_data.buffer();
+  // The buffer of a tuple holds the addresses of its elements, which would
+  // still point to the source device memory after a copy.
+  XLA_CHECK(source_buffer.on_device_shape().IsArray())
+      << source_buffer.on_device_shape();
+
+  ScopedShapedBuffer buffer =
+      client()
+          ->backend()
+          .transfer_manager()
+          ->AllocateScopedShapedBuffer(source_buffer.on_host_shape(),
+                                       memory_pool_.transfer_allocator(),
+                                       device_ordinal_)
+          .ValueOrDie();
+  XLA_CHECK(ShapeUtil::Equal(buffer.on_device_shape(),
+                             source_buffer.on_device_shape()))
+      << buffer.on_device_shape() << " vs. " << source_buffer.on_device_shape();
+
+  se::Stream* stream = stream()->GetOrCreateSubStream();
+  se::DeviceMemoryBase dest = buffer.root_buffer();
+  stream->ThenMemcpy(&dest, source_buffer.root_buffer(), dest.size());
+  TF_CHECK_OK(stream->BlockHostUntilDone());
+  stream()->ReturnSubStream(stream);
+  return std::make_shared<LocalData>(this, std::move(buffer), -1);
+}
+
+std::string LocalDevice::ExportData(const DataPtr& data) {
+  XLA_CHECK(!is_cpu_) << "Only the data of GPUs can be exported";
+  auto& local_data = dynamic_cast<LocalData&>(*data);
+  WaitUntilComputationFinished(local_data.computation_id());
+  const ShapedBuffer& buffer = local_data.buffer();
+  XLA_CHECK(buffer.on_device_shape().IsArray()) << buffer.on_device_shape();
+  std::string handle = ConsumeValue(
+      cuda_ipc::ExportMemory(stream()->parent(), buffer.root_buffer()));
+  absl::MutexLock lock(&ipc_mutex_);
+  ExportedBuffer& exported = exported_buffers_[handle];
+  exported.buffer = local_data.buffer_ptr();
+  ++exported.count;
+  local_data.MarkShared();
+  XLA_COUNTER("ExportedData", 1);
+  return handle;
+}
+
+void LocalDevice::UnexportData(const std::string& handle) {
+  absl::MutexLock lock(&ipc_mutex_);
+  auto it = exported_buffers_.find(handle);
+  XLA_CHECK(it != exported_buffers_.end())
+      << "Data not exported by " << name() << ": " << handle;
+  if (--it->second.count == 0) {
+    exported_buffers_.erase(it);
+  }
+}
+
+DataPtr LocalDevice::ImportData(const std::string& handle,
+                                const Shape& shape) {
+  XLA_CHECK(!is_cpu_) << "Only GPUs can import data";
+  xla::TransferManager* transfer_manager =
+      client()->backend().transfer_manager();
+  Shape device_shape = transfer_manager->HostShapeToDeviceShape(shape);
+  XLA_CHECK(device_shape.IsArray()) << device_shape;
+  std::shared_ptr<cuda_ipc::ImportedMemory> imported;
+  {
+    absl::MutexLock lock(&ipc_mutex_);
+    for (auto it = imported_memory_.begin(); it != imported_memory_.end();) {
+      if (it->second.expired()) {
+        it = imported_memory_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    std::weak_ptr<cuda_ipc::ImportedMemory>& entry = imported_memory_[handle];
+    imported = entry.lock();
+    if (imported == nullptr) {
+      imported = ConsumeValue(
+          cuda_ipc::ImportMemory(stream()->parent(), handle));
+      entry = imported;
+    }
+  }
+  XLA_CHECK_EQ(imported->memory().size(),
+               transfer_manager->GetByteSizeRequirement(device_shape))
+      << "Imported memory does not match " << device_shape;
+  ShapedBuffer shaped_buffer(shape, device_shape, client()->platform(),
+                             device_ordinal_);
+  shaped_buffer.set_buffer(imported->memory(), /*index=*/{});
+  // Without an allocator, the buffer does not free the memory, which stays
+  // mapped until the last data holding the buffer is destroyed.
+  std::shared_ptr<ScopedShapedBuffer> buffer(
+      new ScopedShapedBuffer(std::move(shaped_buffer), /*allocator=*/nullptr),
+      [imported](ScopedShapedBuffer* buffer) { delete buffer; });
+  XLA_COUNTER("ImportedData", 1);
+  return std::make_shared<LocalData>(this, std::move(buffer));
+}
+
 std::vector<DataPtr> LocalDevice::TransferToServer(
     absl::Span<const TensorSource> tensors) {
   auto* device = this;
   tensorflow::profiler::TraceMe trace("TransferToServer");
-  std::vector<std::unique_ptr<char[]>> buffers;
+  XLA_TRACE_SPAN("TransferToServer");
+  XLA_STEP_TIMER(kTransfer);
+  static const size_t pack_bytes =
+      sys_util::GetEnvInt("XLA_TRANSFER_PACK_BYTES", 16 << 10);
+  static const size_t kPackAlignment = 256;
+  xla::TransferManager* transfer_manager =
+      device->client()->backend().transfer_manager();
+  // The small arrays, laid out the same on the host and the device, go to
+  // one device block with a single copy. These are their offsets in it, or
+  // -1 for the tensors transferred on their own.
+  std::vector<int64> pack_offsets(tensors.size(), -1);
+  size_t pack_size = 0;
+  size_t num_packed = 0;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    const Shape& shape = tensors[i].shape;
+    size_t size = xla::ShapeUtil::ByteSizeOf(shape);
+    if (size > 0 && size <= pack_bytes && shape.IsArray() &&
+        xla::ShapeUtil::Equal(
+            transfer_manager->HostShapeToDeviceShape(shape), shape)) {
+      pack_offsets[i] = pack_size;
+      pack_size += xla::RoundUpToNearest(size, kPackAlignment);
+      ++num_packed;
+    }
+  }
+  if (num_packed < 2) {
+    std::fill(pack_offsets.begin(), pack_offsets.end(), -1);
+    pack_size = 0;
+  }
+  StagingBufferPool::BufferPtr pack_buffer;
+  if (pack_size > 0) {
+    pack_buffer = device->staging_pool()->Acquire(pack_size);
+  }
+  // The staging buffers go back to the pool once this function returns, which
+  // happens after the transfers using them are done.
+  std::vector<StagingBufferPool::BufferPtr> buffers;
   buffers.resize(tensors.size());
+  std::vector<const char*> sources(tensors.size());
   size_t total_size = 0;
-  // TODO(parkers): This copy may not be strictly necessary when the layouts
-  // are known to be properly sized from the start.
   util::MultiWait mwait(tensors.size());
   for (size_t i = 0; i < tensors.size(); ++i) {
     size_t size = xla::ShapeUtil::ByteSizeOf(tensors[i].shape);
     total_size += size;
+    if (pack_offsets[i] >= 0) {
+      char* destination = pack_buffer.get() + pack_offsets[i];
+      if (tensors[i].data != nullptr) {
+        std::memcpy(destination, tensors[i].data, size);
+        mwait.Done();
+      } else {
+        auto converter = [&, i, size, destination]() {
+          tensors[i].populate_fn(tensors[i], destination, size);
+        };
+        env::ScheduleClosure(mwait.Completer(std::move(converter)));
+      }
+      continue;
+    }
+    if (tensors[i].data != nullptr) {
+      // The source memory is already laid out as the device wants it, and it
+      // outlives the transfer, so no staging copy is needed.
+      XLA_COUNTER("ZeroCopyTransfers", 1);
+      sources[i] = static_cast<const char*>(tensors[i].data);
+      mwait.Done();
+      continue;
+    }
     auto converter = [&, i, size]() {
-      buffers[i] = std::make_unique<char[]>(size + 1);
+      buffers[i] = device->staging_pool()->Acquire(size + 1);
       tensors[i].populate_fn(tensors[i], buffers[i].get(), size);
+      sources[i] = buffers[i].get();
     };
     if (tensors.size() == 1) {
       mwait.Completer(std::move(converter))();
@@ -346,20 +1446,32 @@ std::vector<DataPtr> LocalDevice::TransferToServer(
 
     se::Stream* stream;
   };
-  std::unique_ptr<se::Stream, ReturnSubStream> stream;
+  std::unique_ptr<se::Stream, ReturnSubStream> stream(
+      device->stream()->GetOrCreateSubStream(),
+      ReturnSubStream{device->stream()});
+  stream_executor::DeviceMemoryAllocator* allocator =
+      device->memory_pool()->transfer_allocator();
+  PackedBlock* pack = nullptr;
+  if (pack_size > 0) {
+    pack = new PackedBlock(
+        allocator,
+        allocator->Allocate(device_ordinal(), pack_size).ValueOrDie(),
+        num_packed);
+    stream->ThenMemcpy(pack->memory(), pack_buffer.get(), pack_size);
+    XLA_COUNTER("PackedTransferTensors", num_packed);
+  }
   std::vector<DataPtr> out;
   for (size_t i = 0; i < tensors.size(); ++i) {
     const TensorSource& tensor = tensors[i];
 
-    stream_executor::DeviceMemoryAllocator* allocator =
-        device->client()->backend().memory_allocator();
-    xla::TransferManager* transfer_manager =
-        device->client()->backend().transfer_manager();
-
-    if (!stream) {
-      stream = std::unique_ptr<se::Stream, ReturnSubStream>(
-          device->stream()->GetOrCreateSubStream(),
-          ReturnSubStream{device->stream()});
+    if (pack_offsets[i] >= 0) {
+      ScopedShapedBuffer buffer(tensor.shape, tensor.shape, pack,
+                                device_ordinal());
+      buffer.set_buffer(
+          pack->Piece(pack_offsets[i], ShapeUtil::ByteSizeOf(tensor.shape)),
+          {});
+      out.push_back(std::make_shared<LocalData>(device, std::move(buffer), -1));
+      continue;
     }
 
     ScopedShapedBuffer buffer = [&] {
@@ -371,7 +1483,7 @@ std::vector<DataPtr> LocalDevice::TransferToServer(
     }();
 
     // TODO(parkers): Check if buffer is aliased and add dep on compute_stream.
-    xla::BorrowingLiteral literal(buffers[i].get(), tensor.shape);
+    xla::BorrowingLiteral literal(sources[i], tensor.shape);
 
     TF_CHECK_OK(transfer_manager->TransferLiteralToDeviceAsync(
         stream.get(), literal, buffer));
@@ -386,6 +1498,7 @@ std::vector<DataPtr> LocalDevice::TransferToServer(
 std::vector<Literal> LocalTransferManager::TransferFromServerImpl(
     absl::Span<const DataPtr> handles) {
   tensorflow::profiler::TraceMe trace("TransferFromServer");
+  XLA_STEP_TIMER(kTransfer);
   metrics::TimedSection timed(ComputationClient::TransferFromServerMetric());
   absl::node_hash_set<LocalDevice*> devices;
   {
@@ -418,15 +1531,88 @@ std::vector<Literal> LocalTransferManager::TransferFromServerImpl(
   return out;
 }
 
+void LocalTransferManager::TransferFromServerStreamingImpl(
+    absl::Span<const DataPtr> handles, size_t max_host_bytes,
+    const DestinationFn& destination_fn, const ConsumerFn& consumer_fn) {
+  tensorflow::profiler::TraceMe trace("TransferFromServerStreaming");
+  XLA_STEP_TIMER(kTransfer);
+  metrics::TimedSection timed(ComputationClient::TransferFromServerMetric());
+  absl::Mutex mutex;
+  size_t inflight_bytes = 0;
+  util::MultiWait mwait(handles.size());
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const auto& local_data = dynamic_cast<const LocalData&>(*handles[i]);
+    LocalDevice* device = dynamic_cast<LocalDevice*>(local_data.device());
+    device->WaitUntilComputationFinished(local_data.computation_id());
+
+    const Shape& host_shape = local_data.buffer().on_host_shape();
+    size_t size = ShapeUtil::ByteSizeOf(host_shape);
+    {
+      absl::MutexLock lock(&mutex);
+      auto has_room = [&]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+        return inflight_bytes == 0 || inflight_bytes + size <= max_host_bytes;
+      };
+      mutex.Await(absl::Condition(&has_room));
+      inflight_bytes += size;
+    }
+    // Caller memory can be written straight into only if the device buffer
+    // host shape has the dim0-major layout the caller expects.
+    bool descending_layout = LayoutUtil::Equal(
+        host_shape.layout(), LayoutUtil::GetDefaultLayoutForShape(host_shape));
+    void* dest = (destination_fn && descending_layout)
+                     ? destination_fn(i, host_shape)
+                     : nullptr;
+    std::shared_ptr<Literal> literal;
+    if (dest == nullptr) {
+      literal = std::make_shared<Literal>(host_shape);
+    }
+    MutableBorrowingLiteral borrowed =
+        literal != nullptr ? MutableBorrowingLiteral(literal.get())
+                           : MutableBorrowingLiteral(
+                                 static_cast<char*>(dest), host_shape);
+    auto consume_fn = [&, i, dest, size, literal]() {
+      util::ExceptionCleanup release([&](std::exception_ptr) {
+        absl::MutexLock lock(&mutex);
+        inflight_bytes -= size;
+      });
+      if (literal == nullptr) {
+        consumer_fn(i, dest, size);
+      } else {
+        Literal host_literal = literal->Relayout(
+            LayoutUtil::GetDefaultLayoutForShape(literal->shape()));
+        void* host_dest = destination_fn
+                              ? destination_fn(i, host_literal.shape())
+                              : nullptr;
+        if (host_dest != nullptr) {
+          std::memcpy(host_dest, host_literal.untyped_data(), size);
+          consumer_fn(i, host_dest, size);
+        } else {
+          consumer_fn(i, host_literal.untyped_data(), size);
+        }
+      }
+    };
+    device->client()->backend().transfer_manager()->TransferLiteralFromDevice(
+        device->transfer_from_device_stream(), local_data.buffer(), borrowed,
+        [&mwait, consume_fn = std::move(consume_fn)](Status status) {
+          TF_CHECK_OK(status);
+          // Run the consumer off the stream callback thread, so that it
+          // overlaps with the next transfers.
+          env::ScheduleIoClosure(mwait.Completer(std::move(consume_fn)));
+        });
+  }
+  mwait.Wait();
+}
+
 std::vector<ComputationPtr> LocalDevice::Compile(
     const std::vector<std::string>& devices,
     std::vector<CompileInstance> instances) {
   metrics::TimedSection timed(ComputationClient::CompileMetric());
-  // TODO(parkers): Probably have to do this in parallel if actually given
-  // n computations.
-  std::vector<ComputationPtr> out;
-  for (CompileInstance& instance : instances) {
-    std::unique_ptr<xla::DeviceAssignment> assignment = GetAssignment(devices);
+  std::vector<ComputationPtr> out(instances.size());
+  auto compile_fn = [&](size_t index) {
+    CompileInstance& instance = instances[index];
+    bool spmd_partitioned = util::HasShardings(instance.computation);
+    std::unique_ptr<xla::DeviceAssignment> assignment =
+        GetAssignment(devices, spmd_partitioned);
 
     tensorflow::profiler::TraceMe trace(
         [&] { return absl::StrCat("XLA Compile: ", name()); });
@@ -436,11 +1622,30 @@ std::vector<ComputationPtr> LocalDevice::Compile(
         BuildArgumentLayouts(computation);
     xla::ExecutableBuildOptions exec_build_options;
 
-    if (instance.output_shape) {
-      exec_build_options.set_result_layout(*instance.output_shape);
-    }
     exec_build_options.set_device_ordinal(device_ordinal());
-    exec_build_options.set_num_replicas(devices.size());
+    if (spmd_partitioned) {
+      // The output shape is the one of the whole results, while the
+      // partitioned executable returns the shards of the sharded ones, so the
+      // result layout is left to the compiler.
+      exec_build_options.set_num_replicas(1);
+      exec_build_options.set_num_partitions(devices.size());
+      exec_build_options.set_use_spmd_partitioning(true);
+      XLA_COUNTER("SpmdPartitionedCompiles", 1);
+    } else {
+      if (instance.output_shape) {
+        exec_build_options.set_result_layout(*instance.output_shape);
+      }
+      exec_build_options.set_num_replicas(devices.size());
+    }
+    if (instance.fast_compile) {
+      // The build options replace the flags defaults, rather than being merged
+      // with them.
+      DebugOptions* debug_options = exec_build_options.mutable_debug_options();
+      *debug_options = GetDebugOptionsFromFlags();
+      debug_options->set_xla_backend_optimization_level(0);
+      debug_options->set_xla_llvm_disable_expensive_passes(true);
+      XLA_COUNTER("FastCompiles", 1);
+    }
 
     std::shared_ptr<xla::LocalExecutable> xla_computation;
     static auto* deduping = new ConcurrentCompileDedupping;
@@ -452,16 +1657,31 @@ std::vector<ComputationPtr> LocalDevice::Compile(
             ? exec_build_options.result_layout()->ToProto().SerializeAsString()
             : "",
         computation.proto().SerializeAsString(),
-        exec_build_options.num_replicas()};
+        exec_build_options.num_replicas(), instance.fast_compile};
 
     if (deduping->ShouldCompile(key, &xla_computation)) {
       deduping->mutex.Unlock();
+      // The GPU compiler picks the convolution and GEMM algorithms by timing
+      // them, unless the stored or shared autotune results already have them.
+      se::StreamExecutor* executor =
+          client()->backend().stream_executor(device_ordinal()).ValueOrDie();
+      std::string autotune_key;
+      bool publish_autotuning = false;
+      if (!is_cpu_) {
+        autotune_key = util::HexHash(util::Hash(key.computation));
+        publish_autotuning =
+            gpu_autotune::AcquireSharedResults(executor, autotune_key);
+      }
       xla_computation = std::move(
           client()
               ->Compile(computation, ArgumentLayoutAsPointers(argument_layouts),
                         exec_build_options)
               .ValueOrDie()
               .front());
+      if (!is_cpu_) {
+        gpu_autotune::UpdateResults(executor, autotune_key,
+                                    publish_autotuning);
+      }
       deduping->mutex.Lock();
       deduping->Publish(key, xla_computation);
     }
@@ -469,64 +1689,288 @@ std::vector<ComputationPtr> LocalDevice::Compile(
     deduping->mutex.Await(absl::Condition(&cond));
     deduping->mutex.Unlock();
 
+    xla::ProgramShape program_shape =
+        instance.computation.GetProgramShape().ValueOrDie();
     auto local_computation = std::make_shared<LocalComputation>(
-        std::move(instance.computation),
-        xla::ProgramShape(instance.computation.GetProgramShape().ValueOrDie()),
-        devices, std::move(xla_computation));
+        std::move(instance.computation), std::move(program_shape), devices,
+        std::move(xla_computation));
     local_computation->assignment = std::move(assignment);
-    out.push_back(std::move(local_computation));
+    const xla::Executable* executable = xla_computation->executable();
+    if (executable->has_module()) {
+      const xla::ComputationLayout& layout =
+          executable->module().entry_computation_layout();
+      std::vector<xla::Shape> parameter_shapes;
+      for (int i = 0; i < layout.parameter_count(); ++i) {
+        parameter_shapes.push_back(layout.parameter_shape(i));
+      }
+      local_computation->set_compiled_parameter_shapes(
+          std::move(parameter_shapes));
+    }
+    local_computation->set_executable_size(
+        executable->SizeOfGeneratedCodeInBytes());
+    out[index] = std::move(local_computation);
+  };
+  if (instances.size() == 1) {
+    compile_fn(0);
+    return out;
+  }
+
+  // Independent computations compile concurrently, on at most
+  // XLA_COMPILE_PARALLELISM IO pool threads pulling the next instance.
+  static const size_t max_parallelism = sys_util::GetEnvInt(
+      "XLA_COMPILE_PARALLELISM", std::thread::hardware_concurrency());
+  size_t num_workers =
+      std::max<size_t>(std::min(instances.size(), max_parallelism), 1);
+  std::atomic<size_t> next_index(0);
+  util::MultiWait mwait(num_workers);
+  for (size_t i = 0; i < num_workers; ++i) {
+    auto worker_fn = [&]() {
+      for (size_t index = next_index++; index < instances.size();
+           index = next_index++) {
+        compile_fn(index);
+      }
+    };
+    env::ScheduleIoClosure(mwait.Completer(std::move(worker_fn)));
   }
+  mwait.Wait();
   return out;
 }
 
 std::vector<DataPtr> LocalDevice::ExecuteComputation(
     const Computation& computation, absl::Span<const DataPtr> arguments,
     const ExecuteComputationOptions& options) {
+  XLA_TRACE_SPAN("ExecuteComputation");
   auto& local_computation = dynamic_cast<const LocalComputation&>(computation);
+  WaitForTransfers(arguments);
   std::vector<const xla::ShapedBuffer*> args;
+  // Kept alive until the computation is done, in case the arguments get
+  // assigned new buffers meanwhile.
+  std::vector<std::shared_ptr<ScopedShapedBuffer>> arg_buffers;
   for (const DataPtr& opaque_arg : arguments) {
-    args.push_back(&dynamic_cast<const LocalData&>(*opaque_arg).buffer());
+    const LocalData& local_data = dynamic_cast<const LocalData&>(*opaque_arg);
+    args.push_back(&local_data.buffer());
+    arg_buffers.push_back(local_data.buffer_ptr());
   }
 
   std::unique_ptr<xla::DeviceAssignment> devices;
 
   xla::ExecutableRunOptions run_options;
-  run_options.set_stream(stream_.get());
-  run_options.set_allocator(client_->backend().memory_allocator());
+  // The outputs of the computation get the blocks its previous outputs
+  // released.
+  run_options.set_allocator(
+      local_computation.buffer_rings->GetAllocator(&memory_pool_));
   run_options.set_intra_op_thread_pool(
       client_->backend().eigen_intra_op_thread_pool_device());
 
   run_options.set_device_assignment(local_computation.assignment.get());
 
-  bool is_cpu = this->is_cpu();
+  bool async_execution = IsAsyncExecution();
   int64 computation_id = -1;
-  if (!is_cpu) {
+  int stream_index = -1;
+  if (async_execution) {
     tensorflow::profiler::TraceMe trace("Acquire Async slot");
     computation_id = RunAsyncStart();
+    stream_index = AcquireComputeStream(arguments, computation_id);
+  }
+  se::Stream* stream = compute_streams_[std::max(stream_index, 0)].get();
+  run_options.set_stream(stream);
+  // A capture takes everything enqueued on the stream meanwhile.
+  absl::MutexLockMaybe launch_lock(UseCudaGraphs() ? &launch_mutex_ : nullptr);
+  std::vector<ScopedShapedBuffer> results;
+  if (!UseCudaGraphs() ||
+      !ExecuteGraph(local_computation, args, run_options, &results)) {
+    xla::ScopedShapedBuffer tmp =
+        local_computation.handle->RunAsync(args, run_options).ValueOrDie();
+    size_t num_tuples = tmp.on_host_shape().tuple_shapes().size();
+    results.reserve(num_tuples);
+    for (size_t i = 0; i < num_tuples; ++i) {
+      results.push_back(
+          tmp.TakeSubTree(ShapeIndex({static_cast<xla::int64>(i)})));
+    }
+  }
+  // With several compute streams, the computations of the other streams
+  // reading the results wait for this event.
+  std::shared_ptr<se::Event> event;
+  if (async_execution && compute_streams_.size() > 1) {
+    event = std::make_shared<se::Event>(stream->parent());
+    XLA_CHECK(event->Init());
+    stream->ThenRecordEvent(event.get());
   }
-  xla::ScopedShapedBuffer tmp =
-      local_computation.handle->RunAsync(args, run_options).ValueOrDie();
-  size_t num_tuples = tmp.on_host_shape().tuple_shapes().size();
   std::vector<DataPtr> out;
-  out.reserve(num_tuples);
-  for (size_t i = 0; i < num_tuples; ++i) {
+  out.reserve(results.size());
+  for (ScopedShapedBuffer& result : results) {
     out.push_back(std::make_shared<LocalData>(
-        this, tmp.TakeSubTree(ShapeIndex({static_cast<xla::int64>(i)})),
-        computation_id));
+        this, std::move(result), computation_id, stream_index, event));
   }
 
-  if (is_cpu) {
-    TF_CHECK_OK(run_options.stream()->BlockHostUntilDone());
+  if (!async_execution) {
+    TF_CHECK_OK(stream->BlockHostUntilDone());
   } else {
-    run_options.stream()->ThenDoHostCallback(
-        [handle = local_computation.handle,
-         assignment = local_computation.assignment,
-         this]() { RunAsyncFinish(); });
+    stream->ThenDoHostCallback([handle = local_computation.handle,
+                                assignment = local_computation.assignment,
+                                arg_buffers = std::move(arg_buffers), this,
+                                computation_id]() {
+      RunAsyncFinish(computation_id);
+    });
   }
 
   return out;
 }
 
+bool LocalDevice::ExecuteGraph(const LocalComputation& computation,
+                               absl::Span<const ShapedBuffer* const> args,
+                               const ExecutableRunOptions& run_options,
+                               std::vector<ScopedShapedBuffer>* results) {
+  static const int64 warmup_runs =
+      sys_util::GetEnvInt("XLA_CUDA_GRAPH_WARMUP", 3);
+  std::vector<const void*> argument_addresses;
+  for (const ShapedBuffer* arg : args) {
+    if (!arg->on_device_shape().IsArray()) {
+      return false;
+    }
+    argument_addresses.push_back(arg->root_buffer().opaque());
+  }
+  GraphReplay* replay = computation.graph_replay.get();
+  absl::MutexLock lock(&replay->mutex);
+  if (replay->graph != nullptr) {
+    if (!replay->graph->CanReplay(argument_addresses)) {
+      XLA_COUNTER("CudaGraphReplayMisses", 1);
+      return false;
+    }
+    *results = replay->graph->Replay(run_options.stream());
+    XLA_COUNTER("CudaGraphReplays", 1);
+    return true;
+  }
+  if (replay->failed) {
+    return false;
+  }
+  if (argument_addresses == replay->argument_addresses) {
+    ++replay->identical_runs;
+  } else {
+    replay->argument_addresses = argument_addresses;
+    replay->identical_runs = 1;
+  }
+  if (replay->identical_runs <= warmup_runs) {
+    return false;
+  }
+  replay->graph = CaptureGraph(computation, args, run_options,
+                               std::move(argument_addresses));
+  if (replay->graph == nullptr) {
+    replay->failed = true;
+    XLA_COUNTER("CudaGraphCaptureFailures", 1);
+    return false;
+  }
+  XLA_COUNTER("CudaGraphCaptures", 1);
+  // The capture only recorded the work, the first replay runs it.
+  *results = replay->graph->Replay(run_options.stream());
+  return true;
+}
+
+CapturedGraph* LocalDevice::CaptureGraph(
+    const LocalComputation& computation,
+    absl::Span<const ShapedBuffer* const> args,
+    const ExecutableRunOptions& run_options,
+    std::vector<const void*> argument_addresses) {
+  XLA_TRACE_SPAN("CaptureGraph");
+  se::Stream* stream = run_options.stream();
+  // The graph may outlive the ring allocator of the computation.
+  se::DeviceMemoryAllocator* backend = memory_pool_.compute_allocator();
+  CaptureAllocator allocator(backend);
+  ExecutableRunOptions capture_options = run_options;
+  capture_options.set_allocator(&allocator);
+  Status status = cuda_graph::BeginCapture(stream);
+  absl::optional<ShapedBuffer> result;
+  std::unique_ptr<cuda_graph::Graph> graph;
+  if (status.ok()) {
+    auto result_or = computation.handle->RunAsync(args, capture_options);
+    if (result_or.ok()) {
+      result = result_or.ConsumeValueOrDie().release();
+    }
+    auto graph_or = cuda_graph::EndCapture(stream);
+    if (graph_or.ok()) {
+      graph = graph_or.ConsumeValueOrDie();
+    }
+    status = !result_or.ok() ? result_or.status() : graph_or.status();
+  }
+  // The graph hands out the elements of the result tuple as its own buffers.
+  if (status.ok() && !result->on_host_shape().IsTuple()) {
+    status = Unimplemented("The result is not a tuple");
+  }
+  for (int64 i = 0;
+       status.ok() && i < result->on_host_shape().tuple_shapes_size(); ++i) {
+    ShapeIndex index({i});
+    if (!ShapeUtil::GetSubshape(result->on_device_shape(), index).IsArray() ||
+        !allocator.IsCaptured(result->buffer(index).opaque())) {
+      status = Unimplemented("Result %d is not an array of its own", i);
+    }
+  }
+  std::vector<se::DeviceMemoryBase> memory = allocator.TakeAllocated();
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to capture a CUDA graph: " << status;
+    for (const se::DeviceMemoryBase& block : memory) {
+      TF_CHECK_OK(backend->Deallocate(device_ordinal_, block));
+    }
+    return nullptr;
+  }
+  return new CapturedGraph(backend, device_ordinal_,
+                           std::move(argument_addresses), std::move(graph),
+                           std::move(*result), std::move(memory));
+}
+
+size_t LocalDevice::AcquireComputeStream(absl::Span<const DataPtr> arguments,
+                                         int64 computation_id) {
+  if (compute_streams_.size() == 1) {
+    absl::MutexLock lock(&mutex_);
+    stream_last_ids_[0] = computation_id;
+    return 0;
+  }
+  // The arguments still being computed on this device, with the stream of
+  // the last one.
+  std::vector<const LocalData*> pending;
+  int64 last_id = -1;
+  int stream_index = -1;
+  absl::MutexLock lock(&mutex_);
+  for (const DataPtr& argument : arguments) {
+    const LocalData& local_data = dynamic_cast<const LocalData&>(*argument);
+    if (local_data.device() != this || local_data.stream_index() < 0 ||
+        IsComputationFinished(local_data.computation_id())) {
+      continue;
+    }
+    pending.push_back(&local_data);
+    if (local_data.computation_id() > last_id) {
+      last_id = local_data.computation_id();
+      stream_index = local_data.stream_index();
+    }
+  }
+  if (stream_index < 0) {
+    // Independent work goes to an idle stream, or to the next one in turn.
+    for (size_t i = 0; i < compute_streams_.size(); ++i) {
+      size_t index = (next_stream_ + i) % compute_streams_.size();
+      if (stream_last_ids_[index] < 0 ||
+          IsComputationFinished(stream_last_ids_[index])) {
+        stream_index = index;
+        break;
+      }
+    }
+    if (stream_index < 0) {
+      stream_index = next_stream_;
+    }
+    next_stream_ = (stream_index + 1) % compute_streams_.size();
+  }
+  se::Stream* stream = compute_streams_[stream_index].get();
+  absl::node_hash_set<se::Event*> waited;
+  for (const LocalData* local_data : pending) {
+    if (local_data->stream_index() != stream_index &&
+        local_data->event() != nullptr &&
+        waited.insert(local_data->event().get()).second) {
+      stream->ThenWaitFor(local_data->event().get());
+      XLA_COUNTER("ComputeStreamWaits", 1);
+    }
+  }
+  stream_last_ids_[stream_index] = computation_id;
+  return stream_index;
+}
+
 }  // namespace
 
 std::unique_ptr<ComputationClient::Device> MakeLocalDeviceFromClient(
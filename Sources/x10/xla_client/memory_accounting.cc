@@ -0,0 +1,171 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/memory_accounting.h"
+
+#include <algorithm>
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace xla {
+namespace metrics {
+namespace {
+
+thread_local std::string g_memory_scope;
+
+std::vector<MemoryUsage> SortedUsage(std::vector<MemoryUsage> usage,
+                                     size_t count) {
+  count = std::min(count, usage.size());
+  std::partial_sort(usage.begin(), usage.begin() + count, usage.end(),
+                    [](const MemoryUsage& u1, const MemoryUsage& u2) {
+                      return u1.bytes > u2.bytes;
+                    });
+  usage.resize(count);
+  return usage;
+}
+
+}  // namespace
+
+const char* MemoryKindName(MemoryKind kind) {
+  switch (kind) {
+    case MemoryKind::kParameter:
+      return "parameter";
+    case MemoryKind::kActivation:
+      return "activation";
+    case MemoryKind::kCache:
+      return "cache";
+    case MemoryKind::kExecutable:
+      return "executable";
+    case MemoryKind::kImported:
+      return "imported";
+    default:
+      return "unknown";
+  }
+}
+
+int64 ShapeMemoryBytes(const Shape& shape) {
+  if (shape.IsTuple()) {
+    int64 size = 0;
+    for (auto& element_shape : shape.tuple_shapes()) {
+      size += ShapeMemoryBytes(element_shape);
+    }
+    return size;
+  }
+  return shape.IsArray() ? ShapeUtil::ByteSizeOfElements(shape) : 0;
+}
+
+MemoryAccounting::Allocation::Allocation(std::string device, std::string scope,
+                                         MemoryKind kind, int64 bytes)
+    : device_(std::move(device)),
+      scope_(std::move(scope)),
+      kind_(kind),
+      bytes_(bytes) {}
+
+MemoryAccounting::Allocation::~Allocation() {
+  MemoryAccounting::Get()->Update(*this, -1);
+}
+
+void MemoryAccounting::Allocation::SetKind(MemoryKind kind) {
+  if (kind != kind_) {
+    MemoryAccounting::Get()->Update(*this, -1);
+    kind_ = kind;
+    MemoryAccounting::Get()->Update(*this, 1);
+  }
+}
+
+MemoryAccounting* MemoryAccounting::Get() {
+  static MemoryAccounting* accounting = new MemoryAccounting();
+  return accounting;
+}
+
+MemoryAccounting::MemoryAccounting()
+    : enabled_(sys_util::GetEnvBool("XLA_MEMORY_ACCOUNTING", false)) {}
+
+std::unique_ptr<MemoryAccounting::Allocation> MemoryAccounting::Track(
+    const std::string& device, MemoryKind kind, int64 bytes) {
+  if (!enabled_) {
+    return nullptr;
+  }
+  std::unique_ptr<Allocation> allocation(
+      new Allocation(device, MemoryScope::Current(), kind, bytes));
+  Update(*allocation, 1);
+  return allocation;
+}
+
+void MemoryAccounting::Update(const Allocation& allocation, int64 sign) {
+  Key key(allocation.device_, allocation.scope_, allocation.kind_);
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = usage_.find(key);
+  if (it == usage_.end()) {
+    MemoryUsage usage;
+    usage.device = allocation.device_;
+    usage.scope = allocation.scope_;
+    usage.kind = allocation.kind_;
+    it = usage_.emplace(std::move(key), std::move(usage)).first;
+  }
+  it->second.bytes += sign * allocation.bytes_;
+  it->second.count += sign;
+}
+
+std::vector<MemoryUsage> MemoryAccounting::GetUsage() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  std::vector<MemoryUsage> usage;
+  for (auto& key_usage : usage_) {
+    if (key_usage.second.count != 0) {
+      usage.push_back(key_usage.second);
+    }
+  }
+  return usage;
+}
+
+std::vector<MemoryUsage> MemoryAccounting::GetTopUsage(size_t count) const {
+  return SortedUsage(GetUsage(), count);
+}
+
+std::vector<MemoryUsage> MemoryAccounting::DiffSinceLastSnapshot() {
+  std::vector<MemoryUsage> diff;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto& key_usage : usage_) {
+      MemoryUsage delta = key_usage.second;
+      auto it = snapshot_.find(key_usage.first);
+      if (it != snapshot_.end()) {
+        delta.bytes -= it->second.bytes;
+        delta.count -= it->second.count;
+      }
+      if (delta.bytes != 0 || delta.count != 0) {
+        diff.push_back(std::move(delta));
+      }
+    }
+    snapshot_ = usage_;
+  }
+  size_t count = diff.size();
+  return SortedUsage(std::move(diff), count);
+}
+
+MemoryScope::MemoryScope(const char* name)
+    : parent_size_(g_memory_scope.size()) {
+  if (!g_memory_scope.empty()) {
+    g_memory_scope.push_back('/');
+  }
+  g_memory_scope.append(name);
+}
+
+MemoryScope::~MemoryScope() { g_memory_scope.resize(parent_size_); }
+
+const std::string& MemoryScope::Current() { return g_memory_scope; }
+
+}  // namespace metrics
+}  // namespace xla
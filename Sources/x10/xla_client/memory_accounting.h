@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_MEMORY_ACCOUNTING_H_
+#define X10_XLA_CLIENT_MEMORY_ACCOUNTING_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace metrics {
+
+enum class MemoryKind {
+  // Device data uploaded from the host.
+  kParameter,
+  // Device data produced by computations.
+  kActivation,
+  // Device data held by the device data caches.
+  kCache,
+  // Compiled computations. Their size is approximated with the HLO size.
+  kExecutable,
+  // Device data imported from another process, which owns its memory.
+  kImported,
+};
+
+const char* MemoryKindName(MemoryKind kind);
+
+// Returns the bytes of the array elements within shape.
+int64 ShapeMemoryBytes(const Shape& shape);
+
+struct MemoryUsage {
+  std::string device;
+  // The annotation scope which was active when the memory got created.
+  std::string scope;
+  MemoryKind kind = MemoryKind::kActivation;
+  int64 bytes = 0;
+  int64 count = 0;
+};
+
+// Accounts the live device memory by device, creating annotation scope and
+// kind. Enabled with XLA_MEMORY_ACCOUNTING.
+class MemoryAccounting {
+ public:
+  // Keeps the bytes accounted to its usage entry while alive.
+  class Allocation {
+   public:
+    ~Allocation();
+
+    void SetKind(MemoryKind kind);
+
+   private:
+    friend class MemoryAccounting;
+
+    Allocation(std::string device, std::string scope, MemoryKind kind,
+               int64 bytes);
+
+    std::string device_;
+    std::string scope_;
+    MemoryKind kind_;
+    int64 bytes_;
+  };
+
+  static MemoryAccounting* Get();
+
+  bool enabled() const { return enabled_; }
+
+  // Returns nullptr if the accounting is disabled.
+  std::unique_ptr<Allocation> Track(const std::string& device, MemoryKind kind,
+                                    int64 bytes);
+
+  // Returns the non empty usage entries.
+  std::vector<MemoryUsage> GetUsage() const;
+
+  // Returns up to count usage entries sorted by decreasing bytes.
+  std::vector<MemoryUsage> GetTopUsage(size_t count) const;
+
+  // Returns the usage changes since the previous call (the returned bytes and
+  // count are deltas), sorted by decreasing bytes growth. Calling this at every
+  // step exposes the memory which keeps accumulating.
+  std::vector<MemoryUsage> DiffSinceLastSnapshot();
+
+ private:
+  using Key = std::tuple<std::string, std::string, MemoryKind>;
+
+  MemoryAccounting();
+
+  void Update(const Allocation& allocation, int64 sign);
+
+  bool enabled_ = false;
+  mutable std::mutex lock_;
+  std::map<Key, MemoryUsage> usage_;
+  std::map<Key, MemoryUsage> snapshot_;
+};
+
+// Scope based utility class setting the annotation scope the memory created
+// by the current thread gets accounted to. Scopes nest, with their names being
+// joined by '/'.
+class MemoryScope {
+ public:
+  explicit MemoryScope(const char* name);
+
+  ~MemoryScope();
+
+  static const std::string& Current();
+
+ private:
+  size_t parent_size_ = 0;
+};
+
+}  // namespace metrics
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_MEMORY_ACCOUNTING_H_
@@ -23,8 +23,11 @@
 #include <grpcpp/server_builder.h>
 #include <grpcpp/server_context.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <map>
 #include <mutex>
@@ -32,10 +35,13 @@
 #include <unordered_map>
 
 #include "absl/container/node_hash_map.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/env_vars.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.grpc.pb.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/nccl_distributed.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
@@ -74,6 +80,31 @@ namespace {
                               status.error_message());
 }
 
+bool UseCompression() {
+  static bool compression = sys_util::GetEnvBool("XRT_MESH_COMPRESSION", false);
+  return compression;
+}
+
+std::shared_ptr<::grpc::Channel> CreateMeshChannel(const std::string& address) {
+  ::grpc::ChannelArguments args;
+  if (UseCompression()) {
+    args.SetCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+  }
+  return ::grpc::CreateCustomChannel(
+      address, ::grpc::InsecureChannelCredentials(), args);
+}
+
+std::unique_ptr<::grpc::Server> StartServer(const std::string& address,
+                                            ::grpc::Service* service) {
+  ::grpc::ServerBuilder builder;
+  builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
+  if (UseCompression()) {
+    builder.SetDefaultCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+  }
+  builder.RegisterService(service);
+  return builder.BuildAndStart();
+}
+
 class MeshServiceImpl : public grpc::MeshService::Service {
  public:
   explicit MeshServiceImpl(grpc::Config config) : config_(std::move(config)) {}
@@ -86,12 +117,43 @@ class MeshServiceImpl : public grpc::MeshService::Service {
                             const grpc::RendezvousRequest* request,
                             grpc::RendezvousResponse* response) override;
 
+  ::grpc::Status RendezvousGroup(::grpc::ServerContext* context,
+                                 const grpc::RendezvousGroupRequest* request,
+                                 grpc::RendezvousResponse* response) override;
+
   ::grpc::Status GetNcclUniqueUid(
       ::grpc::ServerContext* context,
       const grpc::GetNcclUniqueUidRequest* request,
       grpc::GetNcclUniqueUidResponse* response) override;
 
+  ::grpc::Status AcquireArtifact(
+      ::grpc::ServerContext* context,
+      const grpc::AcquireArtifactRequest* request,
+      grpc::AcquireArtifactResponse* response) override;
+
+  ::grpc::Status PublishArtifact(
+      ::grpc::ServerContext* context,
+      const grpc::PublishArtifactRequest* request,
+      grpc::PublishArtifactResponse* response) override;
+
+  ::grpc::Status ReportStepTimings(
+      ::grpc::ServerContext* context,
+      const grpc::ReportStepTimingsRequest* request,
+      grpc::ReportStepTimingsResponse* response) override;
+
+  ::grpc::Status GetStepSkew(::grpc::ServerContext* context,
+                             const grpc::GetStepSkewRequest* request,
+                             grpc::GetStepSkewResponse* response) override;
+
  private:
+  using Arrival = std::pair<int64, std::string>;
+
+  ::grpc::Status RunRendezvous(::grpc::ServerContext* context,
+                               const std::string& tag,
+                               std::vector<Arrival> arrivals,
+                               const std::set<int64>& replicas,
+                               grpc::RendezvousResponse* response);
+
   class RendezvousData {
    public:
     explicit RendezvousData(size_t count, const std::set<int64>& replicas)
@@ -169,10 +231,24 @@ class MeshServiceImpl : public grpc::MeshService::Service {
     }
   }
 
+  struct Artifact {
+    bool published = false;
+    std::string payload;
+  };
+
   std::mutex lock_;
   grpc::Config config_;
   absl::node_hash_map<std::string, std::shared_ptr<RendezvousData>>
       rendezvous_map_;
+  // Recomputes step_skew_ from the step timings. Called with timings_lock_
+  // held.
+  void UpdateStepSkew();
+
+  std::condition_variable artifacts_cv_;
+  absl::node_hash_map<std::string, Artifact> artifacts_;
+  std::mutex timings_lock_;
+  std::map<std::string, std::deque<grpc::StepTiming>> step_timings_;
+  grpc::GetStepSkewResponse step_skew_;
 };
 
 ::grpc::Status MeshServiceImpl::GetConfig(::grpc::ServerContext* context,
@@ -188,20 +264,52 @@ class MeshServiceImpl : public grpc::MeshService::Service {
     grpc::RendezvousResponse* response) {
   std::set<int64> replicas(request->replicas().begin(),
                            request->replicas().end());
-  auto rendezvous = GetRendezvous(request->tag(), replicas);
-  rendezvous->Complete(request->ordinal(), request->payload(), replicas);
-  TF_VLOG(3) << "Entering rendezvous: ordinal=" << request->ordinal()
-             << ", tag=" << request->tag() << ", peer=" << context->peer();
+  std::vector<Arrival> arrivals;
+  arrivals.emplace_back(request->ordinal(), request->payload());
+  return RunRendezvous(context, request->tag(), std::move(arrivals), replicas,
+                       response);
+}
+
+::grpc::Status MeshServiceImpl::RendezvousGroup(
+    ::grpc::ServerContext* context, const grpc::RendezvousGroupRequest* request,
+    grpc::RendezvousResponse* response) {
+  if (request->ordinals_size() != request->payloads_size()) {
+    return ::grpc::Status(
+        ::grpc::StatusCode::INVALID_ARGUMENT,
+        absl::StrCat("Mismatching ordinals and payloads count: ",
+                     request->ordinals_size(), " vs. ",
+                     request->payloads_size()));
+  }
+  std::set<int64> replicas(request->replicas().begin(),
+                           request->replicas().end());
+  std::vector<Arrival> arrivals;
+  for (int i = 0; i < request->ordinals_size(); ++i) {
+    arrivals.emplace_back(request->ordinals(i), request->payloads(i));
+  }
+  return RunRendezvous(context, request->tag(), std::move(arrivals), replicas,
+                       response);
+}
+
+::grpc::Status MeshServiceImpl::RunRendezvous(
+    ::grpc::ServerContext* context, const std::string& tag,
+    std::vector<Arrival> arrivals, const std::set<int64>& replicas,
+    grpc::RendezvousResponse* response) {
+  auto rendezvous = GetRendezvous(tag, replicas);
+  for (auto& arrival : arrivals) {
+    rendezvous->Complete(arrival.first, std::move(arrival.second), replicas);
+  }
+  TF_VLOG(3) << "Entering rendezvous: ordinals=" << arrivals.size()
+             << ", tag=" << tag << ", peer=" << context->peer();
   ::grpc::Status status = rendezvous->Wait();
-  TF_VLOG(3) << "Exiting rendezvous: ordinal=" << request->ordinal()
-             << ", tag=" << request->tag() << ", peer=" << context->peer()
+  TF_VLOG(3) << "Exiting rendezvous: ordinals=" << arrivals.size()
+             << ", tag=" << tag << ", peer=" << context->peer()
              << ", status=" << status;
   if (status.ok()) {
     for (auto& ordinal_payload : rendezvous->Payloads()) {
       response->add_payloads(ordinal_payload.second);
     }
   }
-  ReleaseRendezvous(request->tag(), rendezvous);
+  ReleaseRendezvous(tag, rendezvous);
   return status;
 }
 
@@ -219,36 +327,441 @@ class MeshServiceImpl : public grpc::MeshService::Service {
   return ::grpc::Status::OK;
 }
 
+::grpc::Status MeshServiceImpl::AcquireArtifact(
+    ::grpc::ServerContext* context, const grpc::AcquireArtifactRequest* request,
+    grpc::AcquireArtifactResponse* response) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto insert_result = artifacts_.emplace(request->key(), Artifact());
+  if (insert_result.second) {
+    TF_VLOG(3) << "Producing artifact: key=" << request->key()
+               << ", peer=" << context->peer();
+    return ::grpc::Status::OK;
+  }
+  // The node map keeps the artifact in place while other keys get added.
+  const Artifact* artifact = &insert_result.first->second;
+  TF_VLOG(3) << "Waiting for artifact: key=" << request->key()
+             << ", peer=" << context->peer();
+  while (!artifact->published) {
+    if (context->IsCancelled()) {
+      return ::grpc::Status(
+          ::grpc::StatusCode::CANCELLED,
+          absl::StrCat("Artifact not published: ", request->key()));
+    }
+    artifacts_cv_.wait_for(lock, std::chrono::seconds(1));
+  }
+  response->set_payload(artifact->payload);
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status MeshServiceImpl::PublishArtifact(
+    ::grpc::ServerContext* context, const grpc::PublishArtifactRequest* request,
+    grpc::PublishArtifactResponse* response) {
+  TF_VLOG(3) << "Publishing artifact: key=" << request->key()
+             << ", size=" << request->payload().size()
+             << ", peer=" << context->peer();
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    Artifact& artifact = artifacts_[request->key()];
+    if (!artifact.published) {
+      artifact.payload = request->payload();
+      artifact.published = true;
+    }
+  }
+  artifacts_cv_.notify_all();
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status MeshServiceImpl::ReportStepTimings(
+    ::grpc::ServerContext* context,
+    const grpc::ReportStepTimingsRequest* request,
+    grpc::ReportStepTimingsResponse* response) {
+  static const size_t window = sys_util::GetEnvInt("XRT_MESH_STEP_WINDOW", 20);
+  std::lock_guard<std::mutex> lock(timings_lock_);
+  std::deque<grpc::StepTiming>& timings = step_timings_[request->replica()];
+  for (auto& timing : request->timings()) {
+    timings.push_back(timing);
+    if (timings.size() > window) {
+      timings.pop_front();
+    }
+  }
+  UpdateStepSkew();
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status MeshServiceImpl::GetStepSkew(
+    ::grpc::ServerContext* context, const grpc::GetStepSkewRequest* request,
+    grpc::GetStepSkewResponse* response) {
+  std::lock_guard<std::mutex> lock(timings_lock_);
+  *response = step_skew_;
+  return ::grpc::Status::OK;
+}
+
+void MeshServiceImpl::UpdateStepSkew() {
+  static const double straggler_ratio =
+      sys_util::GetEnvDouble("XRT_MESH_STRAGGLER_RATIO", 1.25);
+  grpc::GetStepSkewResponse step_skew;
+  std::vector<double> wall_times;
+  for (auto& replica_timings : step_timings_) {
+    const std::deque<grpc::StepTiming>& timings = replica_timings.second;
+    if (timings.empty()) {
+      continue;
+    }
+    grpc::ReplicaStepStats* stats = step_skew.add_replicas();
+    stats->set_replica(replica_timings.first);
+    stats->set_steps(timings.size());
+    double wall_ns = 0;
+    double trace_ns = 0;
+    double idle_ns = 0;
+    double device_wait_ns = 0;
+    for (auto& timing : timings) {
+      wall_ns += timing.wall_ns();
+      trace_ns += timing.trace_ns();
+      idle_ns += timing.idle_ns();
+      device_wait_ns += timing.device_wait_ns();
+    }
+    stats->set_wall_ns(wall_ns / timings.size());
+    stats->set_trace_ns(trace_ns / timings.size());
+    stats->set_idle_ns(idle_ns / timings.size());
+    stats->set_device_wait_ns(device_wait_ns / timings.size());
+    wall_times.push_back(stats->wall_ns());
+  }
+  if (wall_times.empty()) {
+    return;
+  }
+  std::sort(wall_times.begin(), wall_times.end());
+  double median = wall_times[wall_times.size() / 2];
+  step_skew.set_skew(median > 0 ? wall_times.back() / median : 1.0);
+  for (auto& stats : *step_skew.mutable_replicas()) {
+    stats.set_straggler(median > 0 &&
+                        stats.wall_ns() > straggler_ratio * median);
+  }
+  // Only the replicas turning into stragglers get logged, not every report of
+  // a replica which is already one.
+  std::set<std::string> stragglers;
+  for (auto& stats : step_skew_.replicas()) {
+    if (stats.straggler()) {
+      stragglers.insert(stats.replica());
+    }
+  }
+  for (auto& stats : step_skew.replicas()) {
+    if (stats.straggler() && stragglers.count(stats.replica()) == 0) {
+      TF_LOG(WARNING) << "Replica " << stats.replica()
+                      << " is a straggler: step=" << stats.wall_ns() / 1e6
+                      << "ms, median=" << median / 1e6
+                      << "ms, trace=" << stats.trace_ns() / 1e6
+                      << "ms, idle=" << stats.idle_ns() / 1e6
+                      << "ms, device_wait=" << stats.device_wait_ns() / 1e6
+                      << "ms";
+    }
+  }
+  XLA_VALUE_METRIC("MeshStepSkew", step_skew.skew());
+  step_skew_ = std::move(step_skew);
+}
+
+// A relay sits between the replicas of a host and the upstream mesh service.
+// The replicas joining a rendezvous within a short window are forwarded as a
+// single group request, so the upstream service sees one connection per host
+// instead of one per replica.
+class MeshRelayImpl : public grpc::MeshService::Service {
+ public:
+  explicit MeshRelayImpl(const std::string& upstream_address)
+      : channel_(CreateMeshChannel(upstream_address)),
+        upstream_(grpc::MeshService::NewStub(channel_)) {}
+
+  ::grpc::Status GetConfig(::grpc::ServerContext* context,
+                           const grpc::GetConfigRequest* request,
+                           grpc::GetConfigResponse* response) override;
+
+  ::grpc::Status Rendezvous(::grpc::ServerContext* context,
+                            const grpc::RendezvousRequest* request,
+                            grpc::RendezvousResponse* response) override;
+
+  ::grpc::Status RendezvousGroup(::grpc::ServerContext* context,
+                                 const grpc::RendezvousGroupRequest* request,
+                                 grpc::RendezvousResponse* response) override;
+
+  ::grpc::Status GetNcclUniqueUid(
+      ::grpc::ServerContext* context,
+      const grpc::GetNcclUniqueUidRequest* request,
+      grpc::GetNcclUniqueUidResponse* response) override;
+
+  ::grpc::Status AcquireArtifact(
+      ::grpc::ServerContext* context,
+      const grpc::AcquireArtifactRequest* request,
+      grpc::AcquireArtifactResponse* response) override;
+
+  ::grpc::Status PublishArtifact(
+      ::grpc::ServerContext* context,
+      const grpc::PublishArtifactRequest* request,
+      grpc::PublishArtifactResponse* response) override;
+
+  ::grpc::Status ReportStepTimings(
+      ::grpc::ServerContext* context,
+      const grpc::ReportStepTimingsRequest* request,
+      grpc::ReportStepTimingsResponse* response) override;
+
+  ::grpc::Status GetStepSkew(::grpc::ServerContext* context,
+                             const grpc::GetStepSkewRequest* request,
+                             grpc::GetStepSkewResponse* response) override;
+
+ private:
+  struct Batch {
+    std::mutex mutex;
+    std::condition_variable cv;
+    grpc::RendezvousGroupRequest request;
+    std::set<int64> replicas;
+    bool done = false;
+    ::grpc::Status status;
+    grpc::RendezvousResponse response;
+  };
+
+  static bool IsFull(const Batch& batch) {
+    return !batch.replicas.empty() &&
+           static_cast<size_t>(batch.request.ordinals_size()) >=
+               batch.replicas.size();
+  }
+
+  ::grpc::Status Join(
+      const std::string& tag,
+      const google::protobuf::RepeatedField<google::protobuf::uint32>& ordinals,
+      const google::protobuf::RepeatedPtrField<std::string>& payloads,
+      const std::set<int64>& replicas, grpc::RendezvousResponse* response);
+
+  std::shared_ptr<::grpc::Channel> channel_;
+  std::unique_ptr<grpc::MeshService::Stub> upstream_;
+  std::mutex lock_;
+  absl::node_hash_map<std::string, std::shared_ptr<Batch>> batches_;
+  std::unique_ptr<grpc::Config> config_;
+  std::map<std::string, std::string> nccl_uids_;
+};
+
+::grpc::Status MeshRelayImpl::GetConfig(::grpc::ServerContext* context,
+                                        const grpc::GetConfigRequest* request,
+                                        grpc::GetConfigResponse* response) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (config_ == nullptr) {
+    ::grpc::ClientContext upstream_context;
+    upstream_context.set_wait_for_ready(true);
+    grpc::GetConfigResponse upstream_response;
+    ::grpc::Status status =
+        upstream_->GetConfig(&upstream_context, *request, &upstream_response);
+    if (!status.ok()) {
+      return status;
+    }
+    config_ = absl::make_unique<grpc::Config>(
+        std::move(*upstream_response.mutable_config()));
+  }
+  *response->mutable_config() = *config_;
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status MeshRelayImpl::Rendezvous(
+    ::grpc::ServerContext* context, const grpc::RendezvousRequest* request,
+    grpc::RendezvousResponse* response) {
+  google::protobuf::RepeatedField<google::protobuf::uint32> ordinals;
+  ordinals.Add(request->ordinal());
+  google::protobuf::RepeatedPtrField<std::string> payloads;
+  *payloads.Add() = request->payload();
+  return Join(request->tag(), ordinals, payloads,
+              std::set<int64>(request->replicas().begin(),
+                              request->replicas().end()),
+              response);
+}
+
+::grpc::Status MeshRelayImpl::RendezvousGroup(
+    ::grpc::ServerContext* context, const grpc::RendezvousGroupRequest* request,
+    grpc::RendezvousResponse* response) {
+  return Join(request->tag(), request->ordinals(), request->payloads(),
+              std::set<int64>(request->replicas().begin(),
+                              request->replicas().end()),
+              response);
+}
+
+::grpc::Status MeshRelayImpl::Join(
+    const std::string& tag,
+    const google::protobuf::RepeatedField<google::protobuf::uint32>& ordinals,
+    const google::protobuf::RepeatedPtrField<std::string>& payloads,
+    const std::set<int64>& replicas, grpc::RendezvousResponse* response) {
+  static int64 window_ms = sys_util::GetEnvInt("XRT_MESH_RELAY_WINDOW_MS", 20);
+  std::shared_ptr<Batch> batch;
+  bool leader = false;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::shared_ptr<Batch>& tag_batch = batches_[tag];
+    if (tag_batch == nullptr) {
+      tag_batch = std::make_shared<Batch>();
+      tag_batch->request.set_tag(tag);
+      for (auto replica : replicas) {
+        tag_batch->request.add_replicas(replica);
+      }
+      tag_batch->replicas = replicas;
+      leader = true;
+    }
+    batch = tag_batch;
+    if (replicas != batch->replicas) {
+      return ::grpc::Status(
+          ::grpc::StatusCode::INVALID_ARGUMENT,
+          absl::StrCat("Mismatching replicas: (",
+                       absl::StrJoin(batch->replicas, ", "), ") vs. (",
+                       absl::StrJoin(replicas, ", "), ")"));
+    }
+    std::lock_guard<std::mutex> batch_lock(batch->mutex);
+    batch->request.mutable_ordinals()->MergeFrom(ordinals);
+    batch->request.mutable_payloads()->MergeFrom(payloads);
+    if (IsFull(*batch)) {
+      batch->cv.notify_all();
+    }
+  }
+  if (leader) {
+    {
+      std::unique_lock<std::mutex> batch_lock(batch->mutex);
+      batch->cv.wait_for(batch_lock, std::chrono::milliseconds(window_ms),
+                         [&]() { return IsFull(*batch); });
+    }
+    {
+      // Arrivals after this point start a new batch for the same tag, which
+      // the upstream service merges within the same rendezvous.
+      std::lock_guard<std::mutex> lock(lock_);
+      auto it = batches_.find(tag);
+      if (it != batches_.end() && it->second == batch) {
+        batches_.erase(it);
+      }
+    }
+    XLA_COUNTER("MeshRelayBatches", 1);
+    XLA_VALUE_METRIC("MeshRelayBatchSize", batch->request.ordinals_size());
+    TF_VLOG(3) << "Forwarding rendezvous: ordinals="
+               << batch->request.ordinals_size() << ", tag=" << tag;
+    ::grpc::ClientContext upstream_context;
+    upstream_context.set_wait_for_ready(true);
+    grpc::RendezvousResponse upstream_response;
+    ::grpc::Status status = upstream_->RendezvousGroup(
+        &upstream_context, batch->request, &upstream_response);
+    {
+      std::lock_guard<std::mutex> batch_lock(batch->mutex);
+      batch->status = status;
+      batch->response = std::move(upstream_response);
+      batch->done = true;
+    }
+    batch->cv.notify_all();
+  }
+  std::unique_lock<std::mutex> batch_lock(batch->mutex);
+  batch->cv.wait(batch_lock, [&]() { return batch->done; });
+  if (batch->status.ok()) {
+    *response = batch->response;
+  }
+  return batch->status;
+}
+
+::grpc::Status MeshRelayImpl::GetNcclUniqueUid(
+    ::grpc::ServerContext* context,
+    const grpc::GetNcclUniqueUidRequest* request,
+    grpc::GetNcclUniqueUidResponse* response) {
+  // The upstream service hands out a single UID per replica group, so the
+  // relay only needs to fetch it once for all of its replicas.
+  std::string replicas_str = absl::StrJoin(request->replicas(), ",");
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = nccl_uids_.find(replicas_str);
+  if (it == nccl_uids_.end()) {
+    ::grpc::ClientContext upstream_context;
+    upstream_context.set_wait_for_ready(true);
+    grpc::GetNcclUniqueUidResponse upstream_response;
+    ::grpc::Status status = upstream_->GetNcclUniqueUid(
+        &upstream_context, *request, &upstream_response);
+    if (!status.ok()) {
+      return status;
+    }
+    it = nccl_uids_.emplace(replicas_str, upstream_response.uid()).first;
+  }
+  response->set_uid(it->second);
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status MeshRelayImpl::AcquireArtifact(
+    ::grpc::ServerContext* context, const grpc::AcquireArtifactRequest* request,
+    grpc::AcquireArtifactResponse* response) {
+  ::grpc::ClientContext upstream_context;
+  upstream_context.set_wait_for_ready(true);
+  upstream_context.set_deadline(context->deadline());
+  return upstream_->AcquireArtifact(&upstream_context, *request, response);
+}
+
+::grpc::Status MeshRelayImpl::PublishArtifact(
+    ::grpc::ServerContext* context, const grpc::PublishArtifactRequest* request,
+    grpc::PublishArtifactResponse* response) {
+  ::grpc::ClientContext upstream_context;
+  upstream_context.set_wait_for_ready(true);
+  return upstream_->PublishArtifact(&upstream_context, *request, response);
+}
+
+::grpc::Status MeshRelayImpl::ReportStepTimings(
+    ::grpc::ServerContext* context,
+    const grpc::ReportStepTimingsRequest* request,
+    grpc::ReportStepTimingsResponse* response) {
+  ::grpc::ClientContext upstream_context;
+  upstream_context.set_wait_for_ready(true);
+  return upstream_->ReportStepTimings(&upstream_context, *request, response);
+}
+
+::grpc::Status MeshRelayImpl::GetStepSkew(
+    ::grpc::ServerContext* context, const grpc::GetStepSkewRequest* request,
+    grpc::GetStepSkewResponse* response) {
+  ::grpc::ClientContext upstream_context;
+  upstream_context.set_wait_for_ready(true);
+  return upstream_->GetStepSkew(&upstream_context, *request, response);
+}
+
 }  // namespace
 
 struct MeshService::Impl {
-  Impl(const std::string& address, grpc::Config config)
-      : impl(std::move(config)) {
-    ::grpc::ServerBuilder builder;
-    builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
-    builder.RegisterService(&impl);
-    server = builder.BuildAndStart();
+  Impl(const std::string& address,
+       std::unique_ptr<grpc::MeshService::Service> service)
+      : service(std::move(service)) {
+    server = StartServer(address, this->service.get());
   }
 
-  MeshServiceImpl impl;
+  std::unique_ptr<grpc::MeshService::Service> service;
   std::unique_ptr<::grpc::Server> server;
 };
 
 MeshService::MeshService(const std::string& address, grpc::Config config)
-    : impl_(new Impl(address, std::move(config))) {}
+    : impl_(new Impl(address,
+                     absl::make_unique<MeshServiceImpl>(std::move(config)))) {}
+
+MeshService::MeshService(const std::string& address,
+                         const std::string& upstream_address)
+    : impl_(new Impl(address,
+                     absl::make_unique<MeshRelayImpl>(upstream_address))) {}
 
 MeshService::~MeshService() {}
 
 struct MeshClient::Impl {
   explicit Impl(const std::string& address) : address(address) {
-    channel =
-        ::grpc::CreateChannel(address, ::grpc::InsecureChannelCredentials());
+    channel = CreateMeshChannel(address);
     stub = grpc::MeshService::NewStub(channel);
   }
 
+  // Returns the stub to be used for rendezvous and NCCL UID requests, which
+  // go through the host relay if one is configured.
+  grpc::MeshService::Stub* GetRelayStub() {
+    std::call_once(relay_once, [this]() {
+      std::string relay_address =
+          sys_util::GetEnvString(env::kEnvMeshRelay, "");
+      if (relay_address.empty()) {
+        return;
+      }
+      TF_VLOG(1) << "Using mesh relay at " << relay_address;
+      relay_channel = CreateMeshChannel(relay_address);
+      relay_stub = grpc::MeshService::NewStub(relay_channel);
+    });
+    return relay_stub != nullptr ? relay_stub.get() : stub.get();
+  }
+
   std::shared_ptr<::grpc::Channel> channel;
   std::unique_ptr<grpc::MeshService::Stub> stub;
   std::string address;
+  std::once_flag relay_once;
+  std::shared_ptr<::grpc::Channel> relay_channel;
+  std::unique_ptr<grpc::MeshService::Stub> relay_stub;
 };
 
 MeshClient* MeshClient::Get() {
@@ -292,6 +805,8 @@ std::vector<std::string> MeshClient::Rendezvous(
     int ordinal, const std::string& tag, const std::string& payload,
     absl::Span<const int64> replicas) const {
   ::grpc::ClientContext context;
+  // The relay may still be starting within another process of the host.
+  context.set_wait_for_ready(true);
   grpc::RendezvousRequest request;
   grpc::RendezvousResponse response;
   request.set_tag(tag);
@@ -301,7 +816,8 @@ std::vector<std::string> MeshClient::Rendezvous(
     request.add_replicas(replica);
   }
   TF_VLOG(3) << "Waiting for rendezvous: ordinal=" << ordinal << " tag=" << tag;
-  ::grpc::Status status = impl_->stub->Rendezvous(&context, request, &response);
+  ::grpc::Status status =
+      impl_->GetRelayStub()->Rendezvous(&context, request, &response);
   TF_VLOG(3) << "Rendezvous wait complete: " << tag;
   if (!status.ok()) {
     XLA_ERROR() << "Failed to meet rendezvous '" << tag << "': " << status;
@@ -316,6 +832,7 @@ std::vector<std::string> MeshClient::Rendezvous(
 std::string MeshClient::GetNcclUniqueUid(
     absl::Span<const int64> replicas) const {
   ::grpc::ClientContext context;
+  context.set_wait_for_ready(true);
   grpc::GetNcclUniqueUidRequest request;
   grpc::GetNcclUniqueUidResponse response;
   for (auto& replica : replicas) {
@@ -325,7 +842,7 @@ std::string MeshClient::GetNcclUniqueUid(
   TF_VLOG(3) << "Waiting for NCCL UID: replicas=("
              << absl::StrJoin(replicas, ", ") << ")";
   ::grpc::Status status =
-      impl_->stub->GetNcclUniqueUid(&context, request, &response);
+      impl_->GetRelayStub()->GetNcclUniqueUid(&context, request, &response);
   TF_VLOG(3) << "NCCL UID wait complete: " << absl::StrJoin(replicas, ", ")
              << ")";
   if (!status.ok()) {
@@ -335,5 +852,77 @@ std::string MeshClient::GetNcclUniqueUid(
   return response.uid();
 }
 
+absl::optional<std::string> MeshClient::AcquireArtifact(
+    const std::string& key) const {
+  static const int64 wait_seconds =
+      sys_util::GetEnvInt("XRT_MESH_ARTIFACT_WAIT", 600);
+  ::grpc::ClientContext context;
+  context.set_wait_for_ready(true);
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::seconds(wait_seconds));
+  grpc::AcquireArtifactRequest request;
+  grpc::AcquireArtifactResponse response;
+  request.set_key(key);
+  ::grpc::Status status =
+      impl_->GetRelayStub()->AcquireArtifact(&context, request, &response);
+  if (status.error_code() == ::grpc::StatusCode::DEADLINE_EXCEEDED) {
+    TF_LOG(WARNING) << "Timed out waiting for artifact '" << key << "'";
+    XLA_COUNTER("MeshArtifactTimeouts", 1);
+    return absl::nullopt;
+  }
+  if (!status.ok()) {
+    XLA_ERROR() << "Failed to acquire artifact '" << key << "': " << status;
+  }
+  if (!response.has_payload()) {
+    return absl::nullopt;
+  }
+  XLA_COUNTER("MeshArtifactFetches", 1);
+  return std::move(*response.mutable_payload());
+}
+
+void MeshClient::PublishArtifact(const std::string& key,
+                                 const std::string& payload) const {
+  ::grpc::ClientContext context;
+  context.set_wait_for_ready(true);
+  grpc::PublishArtifactRequest request;
+  grpc::PublishArtifactResponse response;
+  request.set_key(key);
+  request.set_payload(payload);
+  ::grpc::Status status =
+      impl_->GetRelayStub()->PublishArtifact(&context, request, &response);
+  if (!status.ok()) {
+    XLA_ERROR() << "Failed to publish artifact '" << key << "': " << status;
+  }
+}
+
+void MeshClient::ReportStepTimings(
+    const std::string& replica,
+    const std::vector<grpc::StepTiming>& timings) const {
+  ::grpc::ClientContext context;
+  grpc::ReportStepTimingsRequest request;
+  grpc::ReportStepTimingsResponse response;
+  request.set_replica(replica);
+  for (auto& timing : timings) {
+    *request.add_timings() = timing;
+  }
+  ::grpc::Status status =
+      impl_->GetRelayStub()->ReportStepTimings(&context, request, &response);
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Failed to report step timings: " << status;
+  }
+}
+
+grpc::GetStepSkewResponse MeshClient::GetStepSkew() const {
+  ::grpc::ClientContext context;
+  grpc::GetStepSkewRequest request;
+  grpc::GetStepSkewResponse response;
+  ::grpc::Status status =
+      impl_->GetRelayStub()->GetStepSkew(&context, request, &response);
+  if (!status.ok()) {
+    XLA_ERROR() << "Failed to retrieve the step skew: " << status;
+  }
+  return response;
+}
+
 }  // namespace service
 }  // namespace xla
@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.pb.h"
 #include "tensorflow/compiler/xla/types.h"
@@ -34,6 +35,12 @@ class MeshService {
  public:
   MeshService(const std::string& address, grpc::Config config);
 
+  // Creates a relay service, which gathers the rendezvous of the replicas
+  // connecting to it, and forwards each group as a single request to the
+  // service at upstream_address. Relays can point to other relays, to build
+  // a rendezvous tree over large meshes.
+  MeshService(const std::string& address, const std::string& upstream_address);
+
   ~MeshService();
 
  private:
@@ -56,6 +63,27 @@ class MeshClient {
 
   std::string GetNcclUniqueUid(absl::Span<const int64> replicas) const;
 
+  // Returns the artifact published under key, waiting for it if another host
+  // is producing it. Returns nothing when the caller is the first to ask for
+  // it, or when the producer did not publish it within XRT_MESH_ARTIFACT_WAIT
+  // seconds. The caller should then produce the artifact and publish it.
+  absl::optional<std::string> AcquireArtifact(const std::string& key) const;
+
+  // Publishes the artifact under key. Only the first publication of a key is
+  // kept, so racing producers are harmless.
+  void PublishArtifact(const std::string& key,
+                       const std::string& payload) const;
+
+  // Reports the timings of the latest steps of the replica, which the mesh
+  // service uses to track the skew of the step times across the replicas.
+  // Failures are only logged, as the reports are best effort.
+  void ReportStepTimings(const std::string& replica,
+                         const std::vector<grpc::StepTiming>& timings) const;
+
+  // Returns the step times of the replicas, with the slow ones flagged as
+  // stragglers.
+  grpc::GetStepSkewResponse GetStepSkew() const;
+
  private:
   explicit MeshClient(const std::string& address);
 
@@ -14,10 +14,17 @@
 
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <map>
 #include <sstream>
+#include <thread>
 
+#include "absl/memory/memory.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
@@ -81,6 +88,8 @@ class MetricsArena {
 
 MetricsArena* MetricsArena::Get() {
   static MetricsArena* arena = new MetricsArena();
+  static bool exporter_started = StartMetricsExporter();
+  (void)exporter_started;
   return arena;
 }
 
@@ -139,6 +148,14 @@ const std::vector<double>& GetPercentiles() {
   return *metrics_percentiles;
 }
 
+// Returns the relative accuracy of the metric quantile sketches, or zero if the
+// sketches are disabled.
+double GetSketchAccuracy() {
+  static const double accuracy =
+      sys_util::GetEnvDouble("XLA_METRICS_SKETCH_ACCURACY", 0.0);
+  return accuracy;
+}
+
 void EmitMetricInfo(const std::string& name, MetricData* data,
                     std::stringstream* ss) {
   double accumulator = 0.0;
@@ -178,6 +195,19 @@ void EmitMetricInfo(const std::string& name, MetricData* data,
           << "%=" << data->Repr(samples[index].value);
   }
   (*ss) << std::endl;
+
+  std::unique_ptr<QuantileSketch> sketch = data->Sketch();
+  if (sketch != nullptr && sketch->Count() > 0) {
+    (*ss) << "  CumulativePercentiles: ";
+    for (size_t i = 0; i < metrics_percentiles.size(); ++i) {
+      if (i > 0) {
+        (*ss) << "; ";
+      }
+      (*ss) << (metrics_percentiles[i] * 100.0) << "%="
+            << data->Repr(sketch->Quantile(metrics_percentiles[i]));
+    }
+    (*ss) << std::endl;
+  }
 }
 
 void EmitCounterInfo(const std::string& name, CounterData* data,
@@ -186,50 +216,249 @@ void EmitCounterInfo(const std::string& name, CounterData* data,
   (*ss) << "  Value: " << data->Value() << std::endl;
 }
 
+size_t GetHistogramBucket(double value) {
+  if (!(value > 1.0)) {
+    return 0;
+  }
+  int exponent = 0;
+  std::frexp(value, &exponent);
+  // Here 2^(exponent - 1) <= value < 2^exponent.
+  size_t bucket = exponent / 2;
+  if (value > HistogramBucketBound(bucket)) {
+    ++bucket;
+  }
+  return std::min(bucket, kNumHistogramBuckets - 1);
+}
+
+// Splits a metric name into a valid Prometheus metric name, and the escaped
+// device label value for per-device metrics.
+std::pair<std::string, std::string> PrometheusName(const std::string& name) {
+  std::string base = name;
+  std::string device;
+  size_t pos = name.find('.');
+  if (pos != std::string::npos) {
+    base = name.substr(0, pos);
+    device = name.substr(pos + 1);
+  }
+  std::string metric_name = "x10_";
+  for (char c : base) {
+    metric_name += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+  }
+  std::string escaped_device;
+  for (char c : device) {
+    if (c == '"' || c == '\\') {
+      escaped_device += '\\';
+    }
+    escaped_device += c;
+  }
+  return {metric_name, escaped_device};
+}
+
+void EmitPrometheusMetric(const std::string& name, MetricData* data,
+                          std::stringstream* ss) {
+  auto repr_fn = data->repr_fn().target<std::string (*)(double)>();
+  bool is_time = repr_fn != nullptr && *repr_fn == MetricFnTime;
+  bool is_bytes = repr_fn != nullptr && *repr_fn == MetricFnBytes;
+  // Time metrics are recorded in nanoseconds, and exported in seconds.
+  double scale = is_time ? 1e-9 : 1.0;
+  auto name_device = PrometheusName(name);
+  std::string metric_name = name_device.first;
+  if (is_time) {
+    metric_name += "_seconds";
+  } else if (is_bytes) {
+    metric_name += "_bytes";
+  }
+  std::string device_label =
+      name_device.second.empty()
+          ? ""
+          : absl::StrCat("device=\"", name_device.second, "\"");
+  std::string bucket_labels =
+      device_label.empty() ? "" : absl::StrCat(device_label, ",");
+  std::string sample_labels =
+      device_label.empty() ? "" : absl::StrCat("{", device_label, "}");
+
+  std::vector<int64> histogram = data->Histogram();
+  (*ss) << "# TYPE " << metric_name << " histogram\n";
+  int64 count = 0;
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    count += histogram[i];
+    (*ss) << metric_name << "_bucket{" << bucket_labels << "le=\"";
+    if (i + 1 < histogram.size()) {
+      (*ss) << HistogramBucketBound(i) * scale;
+    } else {
+      (*ss) << "+Inf";
+    }
+    (*ss) << "\"} " << count << "\n";
+  }
+  (*ss) << metric_name << "_sum" << sample_labels << " "
+        << data->Accumulator() * scale << "\n";
+  (*ss) << metric_name << "_count" << sample_labels << " " << count << "\n";
+}
+
+void EmitPrometheusCounter(const std::string& name, CounterData* data,
+                           std::stringstream* ss) {
+  auto name_device = PrometheusName(name);
+  std::string sample_labels =
+      name_device.second.empty()
+          ? ""
+          : absl::StrCat("{device=\"", name_device.second, "\"}");
+  (*ss) << "# TYPE " << name_device.first << " counter\n";
+  (*ss) << name_device.first << sample_labels << " " << data->Value() << "\n";
+}
+
+// Periodically writes the Prometheus report to the XLA_METRICS_EXPORT_FILE
+// file, if set. The file is replaced atomically, so that it can be read by the
+// node exporter textfile collector.
+bool StartMetricsExporter() {
+  static const std::string export_file =
+      sys_util::GetEnvString("XLA_METRICS_EXPORT_FILE", "");
+  if (export_file.empty()) {
+    return false;
+  }
+  static const int64 export_period =
+      sys_util::GetEnvInt("XLA_METRICS_EXPORT_PERIOD", 10);
+  std::thread exporter([]() {
+    std::string tmp_file = absl::StrCat(export_file, ".tmp");
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::seconds(export_period));
+      {
+        std::ofstream file(tmp_file, std::ios::trunc);
+        file << CreatePrometheusReport();
+        if (!file) {
+          TF_LOG(ERROR) << "Unable to write metrics to " << tmp_file;
+          continue;
+        }
+      }
+      if (std::rename(tmp_file.c_str(), export_file.c_str()) != 0) {
+        TF_LOG(ERROR) << "Unable to rename " << tmp_file << " to "
+                      << export_file;
+      }
+    }
+  });
+  exporter.detach();
+  return true;
+}
+
 }  // namespace
 
+double HistogramBucketBound(size_t bucket) {
+  return std::ldexp(1.0, 2 * bucket);
+}
+
+size_t GetMetricShard() {
+  static std::atomic<size_t>* next_shard = new std::atomic<size_t>(0);
+  thread_local size_t shard = next_shard->fetch_add(1) % kNumMetricShards;
+  return shard;
+}
+
 MetricData::MetricData(MetricReprFn repr_fn, size_t max_samples)
-    : repr_fn_(std::move(repr_fn)), samples_(max_samples) {}
+    : repr_fn_(std::move(repr_fn)),
+      max_samples_(max_samples),
+      shards_(new Shard[kNumMetricShards]) {}
 
 void MetricData::AddSample(int64 timestamp_ns, double value) {
-  std::lock_guard<std::mutex> lock(lock_);
-  size_t position = count_ % samples_.size();
-  ++count_;
-  accumulator_ += value;
-  samples_[position] = Sample(timestamp_ns, value);
+  Shard& shard = shards_[GetMetricShard()];
+  std::lock_guard<std::mutex> lock(shard.lock);
+  if (shard.samples.empty()) {
+    shard.samples.resize(max_samples_);
+    double accuracy = GetSketchAccuracy();
+    if (accuracy > 0.0) {
+      shard.sketch = absl::make_unique<QuantileSketch>(accuracy);
+    }
+  }
+  size_t position = shard.count % shard.samples.size();
+  ++shard.count;
+  shard.accumulator += value;
+  shard.samples[position] = Sample(timestamp_ns, value);
+  shard.histogram[GetHistogramBucket(value)] += 1;
+  if (shard.sketch != nullptr) {
+    shard.sketch->Add(value);
+  }
 }
 
 double MetricData::Accumulator() const {
-  std::lock_guard<std::mutex> lock(lock_);
-  return accumulator_;
+  double accumulator = 0.0;
+  for (size_t i = 0; i < kNumMetricShards; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].lock);
+    accumulator += shards_[i].accumulator;
+  }
+  return accumulator;
 }
 
 size_t MetricData::TotalSamples() const {
-  std::lock_guard<std::mutex> lock(lock_);
-  return count_;
+  size_t count = 0;
+  for (size_t i = 0; i < kNumMetricShards; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].lock);
+    count += shards_[i].count;
+  }
+  return count;
 }
 
 std::vector<Sample> MetricData::Samples(double* accumulator,
                                         size_t* total_samples) const {
-  std::lock_guard<std::mutex> lock(lock_);
   std::vector<Sample> samples;
-  if (count_ <= samples_.size()) {
-    samples.insert(samples.end(), samples_.begin(), samples_.begin() + count_);
-  } else {
-    size_t position = count_ % samples_.size();
-    samples.insert(samples.end(), samples_.begin() + position, samples_.end());
-    samples.insert(samples.end(), samples_.begin(),
-                   samples_.begin() + position);
+  double shards_accumulator = 0.0;
+  size_t shards_count = 0;
+  for (size_t i = 0; i < kNumMetricShards; ++i) {
+    const Shard& shard = shards_[i];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (shard.count <= shard.samples.size()) {
+      samples.insert(samples.end(), shard.samples.begin(),
+                     shard.samples.begin() + shard.count);
+    } else {
+      size_t position = shard.count % shard.samples.size();
+      samples.insert(samples.end(), shard.samples.begin() + position,
+                     shard.samples.end());
+      samples.insert(samples.end(), shard.samples.begin(),
+                     shard.samples.begin() + position);
+    }
+    shards_accumulator += shard.accumulator;
+    shards_count += shard.count;
+  }
+  // Merge the shards back into a single buffer, from the oldest to the newer
+  // sample, holding at most max_samples samples.
+  std::stable_sort(samples.begin(), samples.end(),
+                   [](const Sample& s1, const Sample& s2) {
+                     return s1.timestamp_ns < s2.timestamp_ns;
+                   });
+  if (samples.size() > max_samples_) {
+    samples.erase(samples.begin(), samples.end() - max_samples_);
   }
   if (accumulator != nullptr) {
-    *accumulator = accumulator_;
+    *accumulator = shards_accumulator;
   }
   if (total_samples != nullptr) {
-    *total_samples = count_;
+    *total_samples = shards_count;
   }
   return samples;
 }
 
+std::unique_ptr<QuantileSketch> MetricData::Sketch() const {
+  double accuracy = GetSketchAccuracy();
+  if (accuracy <= 0.0) {
+    return nullptr;
+  }
+  auto sketch = absl::make_unique<QuantileSketch>(accuracy);
+  for (size_t i = 0; i < kNumMetricShards; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].lock);
+    if (shards_[i].sketch != nullptr) {
+      sketch->Merge(*shards_[i].sketch);
+    }
+  }
+  return sketch;
+}
+
+std::vector<int64> MetricData::Histogram() const {
+  std::vector<int64> histogram(kNumHistogramBuckets, 0);
+  for (size_t i = 0; i < kNumMetricShards; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].lock);
+    for (size_t j = 0; j < kNumHistogramBuckets; ++j) {
+      histogram[j] += shards_[i].histogram[j];
+    }
+  }
+  return histogram;
+}
+
 Metric::Metric(std::string name, MetricReprFn repr_fn, size_t max_samples)
     : name_(std::move(name)),
       repr_fn_(std::move(repr_fn)),
@@ -347,6 +576,19 @@ std::string CreateMetricReport() {
   return ss.str();
 }
 
+std::string CreatePrometheusReport() {
+  MetricsArena* arena = MetricsArena::Get();
+  std::stringstream ss;
+  ss.precision(9);
+  arena->ForEachMetric([&ss](const std::string& name, MetricData* data) {
+    EmitPrometheusMetric(name, data, &ss);
+  });
+  arena->ForEachCounter([&ss](const std::string& name, CounterData* data) {
+    EmitPrometheusCounter(name, data, &ss);
+  });
+  return ss.str();
+}
+
 std::vector<std::string> GetMetricNames() {
   return MetricsArena::Get()->GetMetricNames();
 }
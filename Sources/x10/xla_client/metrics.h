@@ -24,6 +24,8 @@
 #include <vector>
 
 #include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/event_tracer.h"
+#include "tensorflow/compiler/xla/xla_client/quantile_sketch.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/types.h"
 
@@ -41,8 +43,24 @@ struct Sample {
 
 using MetricReprFn = std::function<std::string(double)>;
 
+// Number of shards the metric and counter data is split into. Threads record
+// into the shard they are assigned to, so that they rarely contend.
+constexpr size_t kNumMetricShards = 16;
+
+// Returns the metric shard assigned to the calling thread.
+size_t GetMetricShard();
+
+// Metrics count their samples in exponential histogram buckets, whose upper
+// bounds are 4^0, 4^1, ..., 4^(kNumHistogramBuckets - 2), and infinity.
+constexpr size_t kNumHistogramBuckets = 24;
+
+// Returns the upper bound of the given histogram bucket.
+double HistogramBucketBound(size_t bucket);
+
 // Class used to collect time-stamped numeric samples. The samples are stored in
-// a circular buffer whose size can be configured at constructor time.
+// a circular buffer whose size can be configured at constructor time. Every
+// shard gets its own circular buffer, and readers merge them, keeping the
+// newest max_samples samples.
 class MetricData {
  public:
   // Creates a new MetricData object with the internal circular buffer storing
@@ -63,28 +81,65 @@ class MetricData {
   // is not nullptr, it will receive the count of the posted values.
   std::vector<Sample> Samples(double* accumulator, size_t* total_samples) const;
 
+  // Returns a quantile sketch of all the samples ever posted to this metric,
+  // or nullptr if sketches are not enabled (XLA_METRICS_SKETCH_ACCURACY).
+  // Unlike Samples(), which only covers the newest max_samples samples, this is
+  // a cumulative view.
+  std::unique_ptr<QuantileSketch> Sketch() const;
+
+  // Returns the (non cumulative) counts of all the samples ever posted to this
+  // metric, per histogram bucket.
+  std::vector<int64> Histogram() const;
+
   std::string Repr(double value) const { return repr_fn_(value); }
 
+  const MetricReprFn& repr_fn() const { return repr_fn_; }
+
  private:
-  mutable std::mutex lock_;
+  struct Shard {
+    mutable std::mutex lock;
+    size_t count = 0;
+    // Allocated on the first sample, as most metrics are only recorded by a
+    // few threads.
+    std::vector<Sample> samples;
+    std::unique_ptr<QuantileSketch> sketch;
+    int64 histogram[kNumHistogramBuckets] = {};
+    double accumulator = 0.0;
+  };
+
   MetricReprFn repr_fn_;
-  size_t count_ = 0;
-  std::vector<Sample> samples_;
-  double accumulator_ = 0.0;
+  size_t max_samples_;
+  std::unique_ptr<Shard[]> shards_;
 };
 
 // Counters are a very lightweight form of metrics which do not need to track
 // sample time.
 class CounterData {
  public:
-  CounterData() : value_(0) {}
+  CounterData() {}
 
-  void AddValue(xla::int64 value) { value_ += value; }
+  void AddValue(xla::int64 value) {
+    shards_[GetMetricShard()].value.fetch_add(value,
+                                              std::memory_order_relaxed);
+  }
 
-  xla::int64 Value() const { return value_; }
+  xla::int64 Value() const {
+    xla::int64 value = 0;
+    for (auto& shard : shards_) {
+      value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+  }
 
  private:
-  std::atomic<xla::int64> value_;
+  // Padded to a cache line, so that threads updating different shards do not
+  // bounce it between their cores.
+  struct Shard {
+    std::atomic<xla::int64> value{0};
+    char padding[64 - sizeof(std::atomic<xla::int64>)];
+  };
+
+  Shard shards_[kNumMetricShards];
 };
 
 // Emits the value in a to_string() conversion.
@@ -172,6 +227,12 @@ class Counter {
 // Creates a report with the current metrics statistics.
 std::string CreateMetricReport();
 
+// Creates a report of the current metrics and counters in the Prometheus text
+// exposition format. Metrics are exported as histograms, in seconds for the
+// time metrics. The name of per-device metrics ("Name.Device") is exported as
+// the Name metric, with a device label.
+std::string CreatePrometheusReport();
+
 // Returns the currently registered metric names. Note that the list can grow
 // since metrics are usualy function intialized (they are static function
 // variables).
@@ -191,7 +252,8 @@ std::vector<std::string> GetCounterNames();
 CounterData* GetCounter(const std::string& name);
 
 // Scope based utility class to measure the time the code takes within a given
-// C++ scope.
+// C++ scope. The scope is also recorded as a span of the event trace, named
+// after the metric.
 class TimedSection {
  public:
   explicit TimedSection(Metric* metric)
@@ -200,6 +262,7 @@ class TimedSection {
   ~TimedSection() {
     int64 now = sys_util::NowNs();
     metric_->AddSample(now, now - start_);
+    EventTracer::Get()->Record(metric_->Name().c_str(), start_, now);
   }
 
   double Elapsed() const {
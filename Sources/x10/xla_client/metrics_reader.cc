@@ -14,12 +14,18 @@
 
 #include "tensorflow/compiler/xla/xla_client/metrics_reader.h"
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 
+#include "tensorflow/compiler/xla/xla_client/compile_profile.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/execution_profile.h"
+#include "tensorflow/compiler/xla/xla_client/memory_accounting.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
 
 namespace xla {
 namespace metrics_reader {
@@ -82,11 +88,111 @@ std::string CreateXrtMetricReport() {
   return ss.str();
 }
 
+void EmitMemoryUsage(const metrics::MemoryUsage& usage, std::stringstream* ss) {
+  (*ss) << "  " << usage.device << " "
+        << (usage.scope.empty() ? "<none>" : usage.scope) << " "
+        << metrics::MemoryKindName(usage.kind) << ": "
+        << (usage.bytes < 0 ? "-" : "")
+        << metrics::MetricFnBytes(usage.bytes < 0 ? -usage.bytes : usage.bytes)
+        << " in "
+        << usage.count << " buffers" << std::endl;
+}
+
 }  // namespace
 
 std::string CreateMetricReport() {
   return metrics::CreateMetricReport() + CreateXrtMetricReport();
 }
 
+std::string CreateCompileReport(size_t top_n, bool include_hlo) {
+  std::vector<metrics::CompileRecord> records =
+      metrics::CompileProfile::Get()->GetSlowestRecords(top_n);
+  std::stringstream ss;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const metrics::CompileRecord& record = records[i];
+    ss << "Compile #" << i << ": " << util::HexHash(record.hash) << std::endl;
+    ss << "  Device: " << record.device << std::endl;
+    ss << "  CompileTime: " << metrics::MetricFnTime(record.compile_time * 1e9)
+       << std::endl;
+    ss << "  HloInstructions: " << record.hlo_instructions << std::endl;
+    ss << "  EmittedNodes: " << record.emitted_nodes << std::endl;
+    ss << record.frames;
+    if (include_hlo && !record.hlo_text.empty()) {
+      ss << record.hlo_text << std::endl;
+    }
+  }
+  return ss.str();
+}
+
+std::string CreateExecutionReport(size_t top_n, bool include_hlo) {
+  std::vector<metrics::ExecutionRecord> records =
+      metrics::ExecutionProfile::Get()->GetHottestRecords(top_n);
+  std::stringstream ss;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const metrics::ExecutionRecord& record = records[i];
+    ss << "Execution #" << i << ": " << util::HexHash(record.hash)
+       << std::endl;
+    ss << "  Device: " << record.device << std::endl;
+    ss << "  ExecutionCount: " << record.execution_count << std::endl;
+    ss << "  ExecuteTime: " << metrics::MetricFnTime(record.execute_time_ns)
+       << std::endl;
+    ss << "  MeanExecuteTime: "
+       << metrics::MetricFnTime(static_cast<double>(record.execute_time_ns) /
+                                record.execution_count)
+       << std::endl;
+    ss << "  InputBytes: " << metrics::MetricFnBytes(record.input_bytes)
+       << std::endl;
+    ss << "  OutputBytes: " << metrics::MetricFnBytes(record.output_bytes)
+       << std::endl;
+    ss << "  Parameters: " << record.parameter_count << std::endl;
+    ss << "  LastStep: " << record.last_step << std::endl;
+    auto computation = record.computation.lock();
+    if (include_hlo && computation != nullptr) {
+      ss << ConsumeValue(
+                util::GetComputationHloText(computation->computation()))
+         << std::endl;
+    }
+  }
+  return ss.str();
+}
+
+std::string CreateScopeReport(size_t top_n) {
+  std::vector<metrics::ScopeTime> scopes =
+      metrics::ExecutionProfile::Get()->GetHottestScopes(
+          std::numeric_limits<size_t>::max());
+  int64 total_time_ns = 1;
+  for (auto& scope : scopes) {
+    total_time_ns += scope.device_time_ns;
+  }
+  std::stringstream ss;
+  for (size_t i = 0; i < std::min(top_n, scopes.size()); ++i) {
+    const metrics::ScopeTime& scope = scopes[i];
+    ss << "  " << (scope.scope.empty() ? "<none>" : scope.scope) << ": "
+       << metrics::MetricFnTime(scope.device_time_ns) << " ("
+       << 100.0 * scope.device_time_ns / total_time_ns << "%)" << std::endl;
+  }
+  return ss.str();
+}
+
+std::string CreateMemoryReport(size_t top_n) {
+  std::stringstream ss;
+  ss << "Device memory:" << std::endl;
+  for (auto& usage : metrics::MemoryAccounting::Get()->GetTopUsage(top_n)) {
+    EmitMemoryUsage(usage, &ss);
+  }
+  return ss.str();
+}
+
+std::string CreateMemoryDiffReport() {
+  std::stringstream ss;
+  ss << "Device memory changes:" << std::endl;
+  std::vector<metrics::MemoryUsage> diff =
+      metrics::MemoryAccounting::Get()->DiffSinceLastSnapshot();
+  for (auto& usage : diff) {
+    EmitMemoryUsage(usage, &ss);
+  }
+  return ss.str();
+}
+
 }  // namespace metrics_reader
 }  // namespace xla
@@ -17,6 +17,7 @@
 #ifndef X10_XLA_CLIENT_METRICS_READER_H_
 #define X10_XLA_CLIENT_METRICS_READER_H_
 
+#include <cstddef>
 #include <string>
 
 namespace xla {
@@ -25,6 +26,29 @@ namespace metrics_reader {
 // Creates a report with the current metrics statistics.
 std::string CreateMetricReport();
 
+// Creates a report of the top_n slowest compilations recorded in the compile
+// profile. When include_hlo is true, the captured HLO text is appended to each
+// entry which has one.
+std::string CreateCompileReport(size_t top_n, bool include_hlo = false);
+
+// Creates a report of the top_n graphs with the highest accumulated execution
+// time. If include_hlo is true, the HLO of the graphs which are still cached is
+// appended to their entry.
+std::string CreateExecutionReport(size_t top_n, bool include_hlo = false);
+
+// Creates a report of the top_n annotation scopes with the highest attributed
+// device time, and their share of the profiled time. Requires
+// XLA_SCOPE_PROFILE.
+std::string CreateScopeReport(size_t top_n);
+
+// Creates a report of the top_n device memory usage entries, by device,
+// annotation scope and kind. Requires XLA_MEMORY_ACCOUNTING.
+std::string CreateMemoryReport(size_t top_n);
+
+// Creates a report of the device memory usage changes since the previous call.
+// With the call made at every step, growing entries point to leaks.
+std::string CreateMemoryDiffReport();
+
 }  // namespace metrics_reader
 }  // namespace xla
 
@@ -18,6 +18,7 @@
 #include <exception>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
 namespace xla {
 namespace util {
@@ -36,7 +37,15 @@ void MultiWait::Done() {
 
 void MultiWait::Wait() {
   std::unique_lock<std::mutex> lock(mutex_);
-  cv_.wait(lock, [this] { return completed_count_ >= count_; });
+  // Help running the queued closures, which are likely the ones we wait for.
+  while (completed_count_ < count_) {
+    lock.unlock();
+    bool helped = env::RunScheduledClosure();
+    lock.lock();
+    if (!helped) {
+      cv_.wait(lock, [this] { return completed_count_ >= count_; });
+    }
+  }
   if (exptr_ != nullptr) {
     std::rethrow_exception(exptr_);
   }
@@ -0,0 +1,91 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/persistent_cache.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace xla {
+namespace util {
+
+PersistentCache::PersistentCache(std::string folder, std::string fingerprint)
+    : folder_(std::move(folder)), fingerprint_(std::move(fingerprint)) {}
+
+std::unique_ptr<XlaComputation> PersistentCache::Get(const hash_t& key) const {
+  std::string path = GetEntryPath(key);
+  std::ifstream entry_file(path, std::ios::binary);
+  if (!entry_file) {
+    XLA_COUNTER("PersistentCacheMiss", 1);
+    return nullptr;
+  }
+  std::string fingerprint;
+  std::getline(entry_file, fingerprint);
+  std::string serialized((std::istreambuf_iterator<char>(entry_file)),
+                         std::istreambuf_iterator<char>());
+  HloModuleProto proto;
+  if (fingerprint != fingerprint_ || !proto.ParseFromString(serialized)) {
+    TF_VLOG(2) << "Dropping stale persistent cache entry " << path;
+    XLA_COUNTER("PersistentCacheInvalidated", 1);
+    Erase(key);
+    return nullptr;
+  }
+  XLA_COUNTER("PersistentCacheHit", 1);
+  return std::make_unique<XlaComputation>(std::move(proto));
+}
+
+void PersistentCache::Add(const hash_t& key,
+                          const XlaComputation& computation) const {
+  static std::atomic<size_t> tmp_count(0);
+  std::string path = GetEntryPath(key);
+  std::string tmp_path =
+      absl::StrCat(path, ".tmp.", getpid(), ".", tmp_count.fetch_add(1));
+  {
+    std::ofstream entry_file(tmp_path, std::ios::binary | std::ios::trunc);
+    entry_file << fingerprint_ << "\n";
+    if (!computation.proto().SerializeToOstream(&entry_file)) {
+      TF_LOG(WARNING) << "Unable to write persistent cache entry " << tmp_path;
+      entry_file.close();
+      std::remove(tmp_path.c_str());
+      return;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    TF_LOG(WARNING) << "Unable to publish persistent cache entry " << path;
+    std::remove(tmp_path.c_str());
+    return;
+  }
+  XLA_COUNTER("PersistentCacheStore", 1);
+}
+
+void PersistentCache::Erase(const hash_t& key) const {
+  std::remove(GetEntryPath(key).c_str());
+}
+
+std::string PersistentCache::GetEntryPath(const hash_t& key) const {
+  return absl::StrCat(folder_, "/", HexHash(key), ".hlo");
+}
+
+}  // namespace util
+}  // namespace xla
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_PERSISTENT_CACHE_H_
+#define X10_XLA_CLIENT_PERSISTENT_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace xla {
+namespace util {
+
+// Disk backed store of lowered computations, keyed by graph hash. Every entry
+// carries a fingerprint of the backend which produced it, and entries whose
+// fingerprint does not match the current one are dropped on lookup. Writes go
+// to a temporary file first and are then renamed into place, so concurrent
+// processes sharing the same folder never observe partially written entries.
+class PersistentCache {
+ public:
+  PersistentCache(std::string folder, std::string fingerprint);
+
+  // Returns the computation stored for key, or nullptr if the entry is missing
+  // or has been invalidated.
+  std::unique_ptr<XlaComputation> Get(const hash_t& key) const;
+
+  void Add(const hash_t& key, const XlaComputation& computation) const;
+
+  void Erase(const hash_t& key) const;
+
+ private:
+  std::string GetEntryPath(const hash_t& key) const;
+
+  std::string folder_;
+  std::string fingerprint_;
+};
+
+}  // namespace util
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_PERSISTENT_CACHE_H_
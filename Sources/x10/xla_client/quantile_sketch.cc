@@ -0,0 +1,101 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/quantile_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace xla {
+namespace metrics {
+namespace {
+
+// Magnitudes below this value are counted as zeros, to bound the number of
+// buckets.
+constexpr double kMinMagnitude = 1e-9;
+
+}  // namespace
+
+QuantileSketch::QuantileSketch(double relative_accuracy)
+    : relative_accuracy_(relative_accuracy),
+      gamma_((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+      log_gamma_(std::log(gamma_)) {
+  XLA_CHECK(relative_accuracy > 0.0 && relative_accuracy < 1.0)
+      << relative_accuracy;
+}
+
+void QuantileSketch::Add(double value) {
+  if (value > kMinMagnitude) {
+    positive_buckets_[BucketIndex(value)] += 1;
+  } else if (value < -kMinMagnitude) {
+    negative_buckets_[BucketIndex(-value)] += 1;
+  } else {
+    zero_count_ += 1;
+  }
+  count_ += 1;
+}
+
+void QuantileSketch::Merge(const QuantileSketch& other) {
+  XLA_CHECK_EQ(relative_accuracy_, other.relative_accuracy_);
+  for (auto& index_count : other.positive_buckets_) {
+    positive_buckets_[index_count.first] += index_count.second;
+  }
+  for (auto& index_count : other.negative_buckets_) {
+    negative_buckets_[index_count.first] += index_count.second;
+  }
+  zero_count_ += other.zero_count_;
+  count_ += other.count_;
+}
+
+double QuantileSketch::Quantile(double quantile) const {
+  if (count_ == 0) {
+    return 0.0;
+  }
+  int64 rank = static_cast<int64>(
+      std::max(0.0, std::min(quantile, 1.0)) * (count_ - 1));
+  int64 seen = 0;
+  // Negative values go from the largest magnitude (the lowest value) down.
+  for (auto it = negative_buckets_.rbegin(); it != negative_buckets_.rend();
+       ++it) {
+    seen += it->second;
+    if (seen > rank) {
+      return -BucketValue(it->first);
+    }
+  }
+  seen += zero_count_;
+  if (seen > rank) {
+    return 0.0;
+  }
+  for (auto& index_count : positive_buckets_) {
+    seen += index_count.second;
+    if (seen > rank) {
+      return BucketValue(index_count.first);
+    }
+  }
+  return BucketValue(positive_buckets_.rbegin()->first);
+}
+
+int QuantileSketch::BucketIndex(double magnitude) const {
+  return static_cast<int>(std::ceil(std::log(magnitude) / log_gamma_));
+}
+
+double QuantileSketch::BucketValue(int index) const {
+  // The middle point, in relative terms, of (gamma^(index-1), gamma^index].
+  return 2.0 * std::pow(gamma_, index) / (gamma_ + 1.0);
+}
+
+}  // namespace metrics
+}  // namespace xla
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_QUANTILE_SKETCH_H_
+#define X10_XLA_CLIENT_QUANTILE_SKETCH_H_
+
+#include <map>
+
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace metrics {
+
+// A mergeable quantile sketch (DDSketch). Values are counted in buckets whose
+// bounds grow geometrically, so that quantile queries have a relative error
+// bounded by the accuracy given at construction time, and the memory grows
+// with the logarithm of the range of the values, not with their count.
+class QuantileSketch {
+ public:
+  explicit QuantileSketch(double relative_accuracy);
+
+  void Add(double value);
+
+  // Adds all the values counted by other, which must have been created with
+  // the same accuracy.
+  void Merge(const QuantileSketch& other);
+
+  // Returns the value at the given quantile, in the [0, 1] range, of all the
+  // values added so far. Returns zero if no values have been added.
+  double Quantile(double quantile) const;
+
+  int64 Count() const { return count_; }
+
+ private:
+  int BucketIndex(double magnitude) const;
+
+  double BucketValue(int index) const;
+
+  double relative_accuracy_;
+  double gamma_;
+  double log_gamma_;
+  std::map<int, int64> positive_buckets_;
+  std::map<int, int64> negative_buckets_;
+  int64 zero_count_ = 0;
+  int64 count_ = 0;
+};
+
+}  // namespace metrics
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_QUANTILE_SKETCH_H_
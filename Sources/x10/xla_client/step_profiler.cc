@@ -0,0 +1,164 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/step_profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace xla {
+namespace metrics {
+namespace {
+
+void EmitDuration(const char* name, int64 ns, int64 wall_ns,
+                  std::stringstream* ss) {
+  (*ss) << " " << name << "=" << std::fixed << std::setprecision(3)
+        << ns / 1e6 << "ms";
+  if (wall_ns > 0) {
+    (*ss) << "(" << std::setprecision(1) << 100.0 * ns / wall_ns << "%)";
+  }
+}
+
+}  // namespace
+
+thread_local StepTimer* StepTimer::current_ = nullptr;
+
+const char* StepCategoryName(StepCategory category) {
+  switch (category) {
+    case StepCategory::kTrace:
+      return "trace";
+    case StepCategory::kSyncCollection:
+      return "sync";
+    case StepCategory::kPostOrder:
+      return "post_order";
+    case StepCategory::kCacheLookup:
+      return "cache_lookup";
+    case StepCategory::kCompile:
+      return "compile";
+    case StepCategory::kFetchTensorData:
+      return "fetch_data";
+    case StepCategory::kTransfer:
+      return "transfer";
+    case StepCategory::kDispatch:
+      return "dispatch";
+    case StepCategory::kDeviceLockWait:
+      return "lock_wait";
+    default:
+      return "unknown";
+  }
+}
+
+StepProfiler* StepProfiler::Get() {
+  static StepProfiler* profiler = new StepProfiler();
+  return profiler;
+}
+
+StepProfiler::StepProfiler()
+    : log_period_(sys_util::GetEnvInt("XLA_STEP_PROFILE", 0)),
+      enabled_(log_period_ > 0 ||
+               sys_util::GetEnvInt("XLA_MESH_STEP_REPORT", 0) > 0),
+      capacity_(sys_util::GetEnvInt("XLA_STEP_PROFILE_SIZE", 100)) {
+  for (auto& category_ns : category_ns_) {
+    category_ns.store(0);
+  }
+}
+
+void StepProfiler::EndStep(int64 step) {
+  if (!enabled()) {
+    return;
+  }
+  int64 now = sys_util::NowNs();
+  StepRecord record;
+  record.step = step;
+  int64 attributed_ns = 0;
+  for (size_t i = 0; i < kNumStepCategories; ++i) {
+    record.category_ns[i] = category_ns_[i].exchange(0);
+    attributed_ns += record.category_ns[i];
+  }
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    int64 start_ns = step_start_ns_;
+    step_start_ns_ = now;
+    if (start_ns == 0) {
+      // The first step only sets the time base.
+      return;
+    }
+    record.wall_ns = now - start_ns;
+    record.idle_ns = std::max<int64>(record.wall_ns - attributed_ns, 0);
+    if (capacity_ > 0) {
+      if (records_.size() < capacity_) {
+        records_.push_back(record);
+      } else {
+        records_[next_] = record;
+      }
+      next_ = (next_ + 1) % capacity_;
+    }
+  }
+  if (capacity_ > 0 && log_period_ > 0 && step % log_period_ == 0) {
+    TF_LOG(INFO) << CreateReport();
+  }
+}
+
+std::vector<StepRecord> StepProfiler::GetRecords() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (records_.size() < capacity_) {
+    return records_;
+  }
+  std::vector<StepRecord> records(records_.begin() + next_, records_.end());
+  records.insert(records.end(), records_.begin(), records_.begin() + next_);
+  return records;
+}
+
+std::string StepProfiler::FormatRecord(const StepRecord& record) {
+  std::stringstream ss;
+  EmitDuration("wall", record.wall_ns, 0, &ss);
+  for (size_t i = 0; i < kNumStepCategories; ++i) {
+    EmitDuration(StepCategoryName(static_cast<StepCategory>(i)),
+                 record.category_ns[i], record.wall_ns, &ss);
+  }
+  EmitDuration("idle", record.idle_ns, record.wall_ns, &ss);
+  return ss.str();
+}
+
+std::string StepProfiler::CreateReport() const {
+  std::vector<StepRecord> records = GetRecords();
+  if (records.empty()) {
+    return std::string();
+  }
+  StepRecord average;
+  for (auto& record : records) {
+    average.wall_ns += record.wall_ns;
+    for (size_t i = 0; i < kNumStepCategories; ++i) {
+      average.category_ns[i] += record.category_ns[i];
+    }
+    average.idle_ns += record.idle_ns;
+  }
+  average.wall_ns /= records.size();
+  for (size_t i = 0; i < kNumStepCategories; ++i) {
+    average.category_ns[i] /= records.size();
+  }
+  average.idle_ns /= records.size();
+
+  std::stringstream ss;
+  ss << "Step " << records.back().step << ":"
+     << FormatRecord(records.back()) << std::endl;
+  ss << "Average of " << records.size() << " steps:" << FormatRecord(average);
+  return ss.str();
+}
+
+}  // namespace metrics
+}  // namespace xla
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_STEP_PROFILER_H_
+#define X10_XLA_CLIENT_STEP_PROFILER_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace metrics {
+
+// The host activities the time between two steps is attributed to.
+enum class StepCategory {
+  kTrace,
+  kSyncCollection,
+  kPostOrder,
+  kCacheLookup,
+  kCompile,
+  kFetchTensorData,
+  kTransfer,
+  kDispatch,
+  kDeviceLockWait,
+  kNumCategories,
+};
+
+constexpr size_t kNumStepCategories =
+    static_cast<size_t>(StepCategory::kNumCategories);
+
+const char* StepCategoryName(StepCategory category);
+
+struct StepRecord {
+  int64 step = 0;
+  int64 wall_ns = 0;
+  int64 category_ns[kNumStepCategories] = {};
+  // The part of the wall time not attributed to any category. Since the
+  // categories are accounted from all the threads, this is zero whenever the
+  // asynchronous activity exceeds the wall time.
+  int64 idle_ns = 0;
+};
+
+// Attributes the host wall time between consecutive MarkStep() calls to the
+// StepCategory activities. Enabled with XLA_STEP_PROFILE set to N > 0, in which
+// case every N steps the last step record, and the averages over the newest
+// XLA_STEP_PROFILE_SIZE steps, get logged. Also enabled, without the logging,
+// when the step records get reported to the mesh service, with
+// XLA_MESH_STEP_REPORT.
+class StepProfiler {
+ public:
+  static StepProfiler* Get();
+
+  bool enabled() const { return enabled_; }
+
+  void Add(StepCategory category, int64 ns) {
+    category_ns_[static_cast<size_t>(category)].fetch_add(
+        ns, std::memory_order_relaxed);
+  }
+
+  // Closes the current step, and starts accounting a new one.
+  void EndStep(int64 step);
+
+  // Returns the stored step records, oldest first.
+  std::vector<StepRecord> GetRecords() const;
+
+  // Returns the compact representation of a step record.
+  static std::string FormatRecord(const StepRecord& record);
+
+  // Returns a report with the last step record, and the averages of the stored
+  // ones.
+  std::string CreateReport() const;
+
+ private:
+  StepProfiler();
+
+  int64 log_period_ = 0;
+  bool enabled_ = false;
+  std::atomic<int64> category_ns_[kNumStepCategories];
+  mutable std::mutex lock_;
+  int64 step_start_ns_ = 0;
+  size_t capacity_ = 0;
+  size_t next_ = 0;
+  std::vector<StepRecord> records_;
+};
+
+// Scope based utility class accounting the time spent within the enclosing C++
+// scope to a step category. Nested timers on the same thread are exclusive,
+// that is, the time of the inner scope is only accounted to its own category.
+class StepTimer {
+ public:
+  explicit StepTimer(StepCategory category)
+      : category_(category),
+        start_(StepProfiler::Get()->enabled() ? sys_util::NowNs() : 0) {
+    if (start_ != 0) {
+      parent_ = current_;
+      current_ = this;
+    }
+  }
+
+  ~StepTimer() {
+    if (start_ != 0) {
+      int64 elapsed = sys_util::NowNs() - start_;
+      StepProfiler::Get()->Add(category_, elapsed - nested_ns_);
+      if (parent_ != nullptr) {
+        parent_->nested_ns_ += elapsed;
+      }
+      current_ = parent_;
+    }
+  }
+
+ private:
+  static thread_local StepTimer* current_;
+
+  StepCategory category_;
+  int64 start_;
+  int64 nested_ns_ = 0;
+  StepTimer* parent_ = nullptr;
+};
+
+#define XLA_STEP_TIMER(category) \
+  xla::metrics::StepTimer step_timer(xla::metrics::StepCategory::category)
+
+}  // namespace metrics
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_STEP_PROFILER_H_
@@ -14,24 +14,109 @@
 
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstring>
 #include <deque>
 #include <exception>
+#include <fstream>
 #include <mutex>
+#include <string>
+#include <vector>
 
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 
 namespace xla {
 namespace env {
 namespace {
 
+// Parses a CPU list in the "0-3,8,10-11" format used by the Linux sysfs files.
+std::vector<int> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  for (absl::string_view range :
+       absl::StrSplit(cpu_list, ',', absl::SkipWhitespace())) {
+    std::vector<std::string> bounds =
+        absl::StrSplit(absl::StripAsciiWhitespace(range), '-');
+    int first = std::stoi(bounds.front());
+    int last = std::stoi(bounds.back());
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// Returns the CPUs the pool threads should be pinned to, or an empty list if
+// they should not be pinned. An explicit CPU list wins over a NUMA node, whose
+// CPUs are read from sysfs.
+std::vector<int> GetPoolCpus(const char* cpus_env, const char* numa_node_env) {
+  std::string cpu_list = sys_util::GetEnvString(cpus_env, "");
+  if (cpu_list.empty()) {
+    int64 numa_node = sys_util::GetEnvInt(numa_node_env, -1);
+    if (numa_node < 0) {
+      return {};
+    }
+    std::string path =
+        absl::StrCat("/sys/devices/system/node/node", numa_node, "/cpulist");
+    std::ifstream cpulist_file(path);
+    if (!std::getline(cpulist_file, cpu_list)) {
+      TF_LOG(WARNING) << "Unable to read the CPUs of NUMA node " << numa_node
+                      << " from " << path;
+      return {};
+    }
+  }
+  return ParseCpuList(cpu_list);
+}
+
+void PinCurrentThread(const std::vector<int>& cpus) {
+  if (cpus.empty()) {
+    return;
+  }
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (error != 0) {
+    TF_LOG(WARNING) << "Unable to set the thread pool CPU affinity: "
+                    << std::strerror(error);
+  }
+#endif
+}
+
+// A work stealing thread pool. Every worker owns a queue, which it pops in LIFO
+// order, while idle workers steal from the FIFO end of the other queues.
+// Closures scheduled from a worker go to its own queue, the others are spread
+// round robin. When all the workers are busy, bounded extra threads are spawned
+// to drain the queues, which protects from thread-pool-size-deadlocks caused by
+// closures doing sync waits on the pool threads.
 class ThreadPool {
  public:
-  explicit ThreadPool(size_t num_threads) {
+  ThreadPool(size_t num_threads, size_t max_extra_threads,
+             std::vector<int> cpus)
+      : max_extra_threads_(max_extra_threads), cpus_(std::move(cpus)) {
+    num_threads = std::max<size_t>(num_threads, 1);
+    queues_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+      queues_.push_back(absl::make_unique<WorkQueue>());
+    }
     threads_.reserve(num_threads);
     for (size_t i = 0; i < num_threads; ++i) {
-      threads_.emplace_back([this]() { Worker(); });
+      threads_.emplace_back([this, i]() { Worker(i); });
     }
   }
 
@@ -47,73 +132,177 @@ class ThreadPool {
   }
 
   void Schedule(std::function<void()> closure) {
-    // If we have more work scheduled than waiting worker threads, just schedule
-    // it on a separate thread. This prevents tricky thread-pool-size-deadlocks
-    // caused by an undersized thread pool and closures that end up doing sync
-    // waits on the pool threads.
-    bool scheduled = false;
+    size_t index = (tls_pool == this && tls_index < queues_.size())
+                       ? tls_index
+                       : next_queue_.fetch_add(1) % queues_.size();
+    // Account for the closure before queueing it, so that the counter never
+    // goes below the number of closures in the queues.
+    size_t queued = queued_.fetch_add(1) + 1;
+    {
+      WorkQueue* queue = queues_[index].get();
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      queue->work.emplace_back(std::move(closure));
+    }
+    XLA_VALUE_METRIC("ThreadPoolQueueDepth", queued);
+
+    bool spawn = false;
     {
       std::lock_guard<std::mutex> lock(mutex_);
-      if (work_.size() < waiting_) {
-        work_.emplace_back(std::move(closure));
-        scheduled = true;
+      if (waiting_ > 0) {
+        cv_.notify_one();
+      }
+      if (queued > waiting_ && extra_threads_ < max_extra_threads_) {
+        ++extra_threads_;
+        spawn = true;
       }
     }
-    if (scheduled) {
-      cv_.notify_one();
-    } else {
-      ScheduleOnThread(std::move(closure));
+    if (spawn) {
+      XLA_COUNTER("ThreadPoolSpawnedThreads", 1);
+      std::thread thread([this]() { ExtraWorker(); });
+      thread.detach();
     }
   }
 
+  // Runs one of the queued closures from the calling thread, returning whether
+  // there was any.
+  bool RunQueuedClosure() {
+    size_t index = tls_pool == this ? tls_index : queues_.size();
+    std::function<void()> closure = FindWork(index);
+    if (closure == nullptr) {
+      return false;
+    }
+    closure();
+    return true;
+  }
+
+  size_t num_threads() const { return threads_.size(); }
+
+  size_t queued() const { return queued_.load(); }
+
  private:
-  void Worker() {
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> work;
+  };
+
+  void Worker(size_t index) {
+    PinCurrentThread(cpus_);
+    tls_pool = this;
+    tls_index = index;
     while (true) {
-      std::function<void()> closure = GetWork();
-      if (closure == nullptr) {
+      std::function<void()> closure = FindWork(index);
+      if (closure != nullptr) {
+        closure();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++waiting_;
+      cv_.wait(lock, [this] { return exiting_ || queued_.load() > 0; });
+      --waiting_;
+      if (exiting_ && queued_.load() == 0) {
         break;
       }
-      closure();
     }
   }
 
-  void ScheduleOnThread(std::function<void()> closure) {
-    std::thread thread(std::move(closure));
-    thread.detach();
+  // Extra workers have no queue of their own, and exit once there is no more
+  // work to steal.
+  void ExtraWorker() {
+    PinCurrentThread(cpus_);
+    tls_pool = this;
+    tls_index = queues_.size();
+    while (true) {
+      std::function<void()> closure = FindWork(tls_index);
+      if (closure == nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queued_.load() == 0) {
+          --extra_threads_;
+          break;
+        }
+        continue;
+      }
+      closure();
+    }
   }
 
-  std::function<void()> GetWork() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    ++waiting_;
-    cv_.wait(lock, [this] { return exiting_ || !work_.empty(); });
-    --waiting_;
-    if (work_.empty()) {
+  std::function<void()> FindWork(size_t index) {
+    if (queued_.load() == 0) {
       return nullptr;
     }
-    std::function<void()> closure(std::move(work_.front()));
-    work_.pop_front();
-    return closure;
+    if (index < queues_.size()) {
+      WorkQueue* queue = queues_[index].get();
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      if (!queue->work.empty()) {
+        std::function<void()> closure(std::move(queue->work.back()));
+        queue->work.pop_back();
+        queued_.fetch_sub(1);
+        return closure;
+      }
+    }
+    size_t start = index < queues_.size() ? index + 1 : 0;
+    for (size_t i = 0; i < queues_.size(); ++i) {
+      size_t victim = (start + i) % queues_.size();
+      if (victim == index) {
+        continue;
+      }
+      WorkQueue* queue = queues_[victim].get();
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      if (!queue->work.empty()) {
+        std::function<void()> closure(std::move(queue->work.front()));
+        queue->work.pop_front();
+        queued_.fetch_sub(1);
+        XLA_COUNTER("ThreadPoolSteals", 1);
+        return closure;
+      }
+    }
+    return nullptr;
   }
 
+  static thread_local ThreadPool* tls_pool;
+  static thread_local size_t tls_index;
+
+  const size_t max_extra_threads_;
+  const std::vector<int> cpus_;
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
   std::vector<std::thread> threads_;
+  std::atomic<size_t> next_queue_{0};
+  std::atomic<size_t> queued_{0};
   std::mutex mutex_;
   std::condition_variable cv_;
   bool exiting_ = false;
-  std::deque<std::function<void()>> work_;
   size_t waiting_ = 0;
+  size_t extra_threads_ = 0;
 };
 
+thread_local ThreadPool* ThreadPool::tls_pool = nullptr;
+thread_local size_t ThreadPool::tls_index = 0;
+
+size_t GetMaxExtraThreads(size_t num_threads) {
+  return sys_util::GetEnvInt("XLA_THREAD_POOL_MAX_EXTRA_THREADS",
+                             4 * num_threads);
+}
+
+ThreadPool* CreateThreadPool(const char* size_env, const char* cpus_env,
+                             const char* numa_node_env) {
+  std::vector<int> cpus = GetPoolCpus(cpus_env, numa_node_env);
+  size_t num_threads = sys_util::GetEnvInt(
+      size_env, cpus.empty() ? std::thread::hardware_concurrency()
+                             : cpus.size());
+  return new ThreadPool(num_threads, GetMaxExtraThreads(num_threads),
+                        std::move(cpus));
+}
+
 ThreadPool* GetThreadPool() {
-  static size_t num_threads = sys_util::GetEnvInt(
-      "XLA_THREAD_POOL_SIZE", std::thread::hardware_concurrency());
-  static ThreadPool* pool = new ThreadPool(num_threads);
+  static ThreadPool* pool =
+      CreateThreadPool("XLA_THREAD_POOL_SIZE", "XLA_THREAD_POOL_CPUS",
+                       "XLA_THREAD_POOL_NUMA_NODE");
   return pool;
 }
 
 ThreadPool* GetIoThreadPool() {
-  static size_t num_threads = sys_util::GetEnvInt(
-      "XLA_IO_THREAD_POOL_SIZE", std::thread::hardware_concurrency());
-  static ThreadPool* pool = new ThreadPool(num_threads);
+  static ThreadPool* pool =
+      CreateThreadPool("XLA_IO_THREAD_POOL_SIZE", "XLA_IO_THREAD_POOL_CPUS",
+                       "XLA_IO_THREAD_POOL_NUMA_NODE");
   return pool;
 }
 
@@ -123,7 +312,14 @@ class Completion::Data {
  public:
   void Wait() {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this] { return completed_; });
+    while (!completed_) {
+      lock.unlock();
+      bool helped = RunScheduledClosure();
+      lock.lock();
+      if (!helped) {
+        cv_.wait(lock, [this] { return completed_; });
+      }
+    }
     if (exptr_ != nullptr) {
       std::rethrow_exception(exptr_);
     }
@@ -171,6 +367,12 @@ void ScheduleIoClosure(std::function<void()> closure) {
   GetIoThreadPool()->Schedule(std::move(closure));
 }
 
+bool RunScheduledClosure() { return GetThreadPool()->RunQueuedClosure(); }
+
+size_t GetThreadPoolSize() { return GetThreadPool()->num_threads(); }
+
+size_t GetQueuedClosures() { return GetThreadPool()->queued(); }
+
 Completion ScheduleClosureWithCompletion(std::function<void()> closure) {
   auto data = std::make_shared<Completion::Data>();
   GetThreadPool()->Schedule(
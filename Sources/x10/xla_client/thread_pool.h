@@ -47,6 +47,17 @@ Completion ScheduleClosureWithCompletion(std::function<void()> closure);
 void ScheduleIoClosure(std::function<void()> closure);
 Completion ScheduleIoClosureWithCompletion(std::function<void()> closure);
 
+// Runs, from the calling thread, one of the closures queued with
+// ScheduleClosure(), if any. Returns whether a closure was run. Blocked waiters
+// use this to help draining the pool instead of sleeping.
+bool RunScheduledClosure();
+
+// Returns the number of workers of the compute pool, which ScheduleClosure()
+// feeds, and the number of its closures still waiting for a thread. Callers
+// splitting work into parallel closures use them to size their share.
+size_t GetThreadPoolSize();
+size_t GetQueuedClosures();
+
 }  // namespace env
 }  // namespace xla
 
@@ -6,47 +6,156 @@ namespace xla {
 namespace util {
 namespace {
 
-hash_t LoadHash(const uint8** data, const uint8* top) {
-  std::ptrdiff_t size = top - (*data);
-  if (size >= sizeof(hash_t)) {
-    hash_t v;
-    std::memcpy(&v, *data, sizeof(v));
-    *data += sizeof(hash_t);
-    return v;
+constexpr uint64 kPrime32_1 = 0x9e3779b1;
+constexpr uint64 kPrime64_1 = 0x9e3779b185ebca87;
+constexpr uint64 kPrime64_2 = 0xc2b2ae3d27d4eb4f;
+constexpr uint64 kPrime64_3 = 0x165667b19e3779f9;
+constexpr uint64 kPrime64_4 = 0x85ebca77c2b2ae63;
+constexpr uint64 kPrime64_5 = 0x27d4eb2f165667c5;
+
+constexpr uint64 kSecret[16] = {
+    0x6e789e6aa1b965f4, 0x06c45d188009454f, 0xf88bb8a8724c81ec,
+    0x1b39896a51a8749b, 0x53cb9f0c747ea2ea, 0x2c829abe1f4532e1,
+    0xc584133ac916ab3c, 0x3ee5789041c98ac3, 0xf3b8488c368cb0a6,
+    0x657eecdd3cb13d09, 0xc2d326e0055bdef6, 0x8621a03fe0bbdb7b,
+    0x8e1f7555983aa92f, 0xb54e0f1600cc4d19, 0x84bb3f97971d80ab,
+    0x7d29825c75521255,
+};
+
+// The bytes of a 64 bytes stripe of the long inputs, and the stripes between
+// two scramblings of the accumulators.
+constexpr size_t kStripeSize = 64;
+constexpr size_t kStripesPerBlock = 16;
+
+inline uint64 Read64(const uint8* data) {
+  uint64 value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+inline uint64 Read32(const uint8* data) {
+  uint32 value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+inline uint64 RotateLeft(uint64 value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64 MulFold64(uint64 a, uint64 b) {
+  absl::uint128 product = absl::uint128(a) * b;
+  return absl::Uint128Low64(product) ^ absl::Uint128High64(product);
+}
+
+inline uint64 Avalanche(uint64 h) {
+  h ^= h >> 37;
+  h *= 0x165667919e3779f9;
+  return h ^ (h >> 32);
+}
+
+// Folds up to 16 bytes into the two halves of the hash.
+void HashShort(const uint8* data, size_t n, uint64* lo, uint64* hi) {
+  uint64 a = 0;
+  uint64 b = 0;
+  if (n >= 8) {
+    a = Read64(data);
+    b = Read64(data + n - 8);
+  } else if (n >= 4) {
+    a = Read32(data);
+    b = Read32(data + n - 4);
+  } else if (n > 0) {
+    a = (static_cast<uint64>(data[0]) << 16) |
+        (static_cast<uint64>(data[n >> 1]) << 8) | data[n - 1];
+    b = a;
   }
+  uint64 l = MulFold64(a ^ (kSecret[0] + *lo), b ^ (kSecret[1] - *hi));
+  uint64 h = MulFold64(b ^ (kSecret[2] + *hi), a ^ (kSecret[3] - *lo));
+  *lo = l;
+  *hi = h;
+}
 
-  union {
-    hash_t h;
-    uint8 b[sizeof(hash_t)];
-  } uval;
-  uval.h = 0;
-  std::memcpy(uval.b, *data, size);
-  *data += size;
-  return uval.h;
+// Folds 17 to 128 bytes as up to eight 16 bytes chunks, the last one being
+// read from the end of the data, alternating the half they go into.
+void HashMedium(const uint8* data, size_t n, uint64 seed_lo, uint64 seed_hi,
+                uint64* lo, uint64* hi) {
+  size_t num_chunks = (n + 15) / 16;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    const uint8* chunk = i + 1 < num_chunks ? data + 16 * i : data + n - 16;
+    const uint64* key = kSecret + 2 * i;
+    uint64 w0 = Read64(chunk);
+    uint64 w1 = Read64(chunk + 8);
+    if (i % 2 == 0) {
+      *lo += MulFold64(w0 ^ (key[0] + seed_lo), w1 ^ (key[1] - seed_lo));
+      *hi ^= w0 + w1;
+    } else {
+      *hi += MulFold64(w0 ^ (key[0] + seed_hi), w1 ^ (key[1] - seed_hi));
+      *lo ^= w0 + w1;
+    }
+  }
+}
+
+// The eight lanes are independent, and only use 32x32->64 bits products, so
+// that the compilers turn the loop into SSE2/AVX2/NEON vector code.
+inline void AccumulateStripe(uint64* acc, const uint8* stripe,
+                             const uint64* key) {
+  for (size_t i = 0; i < 8; ++i) {
+    uint64 value = Read64(stripe + 8 * i);
+    uint64 keyed = value ^ key[i];
+    acc[i ^ 1] += value;
+    acc[i] += (keyed & 0xffffffff) * (keyed >> 32);
+  }
+}
+
+inline void ScrambleAccumulators(uint64* acc) {
+  for (size_t i = 0; i < 8; ++i) {
+    acc[i] ^= acc[i] >> 47;
+    acc[i] ^= kSecret[i + 8];
+    acc[i] *= kPrime32_1;
+  }
+}
+
+void HashLong(const uint8* data, size_t n, uint64 seed_lo, uint64 seed_hi,
+              uint64* lo, uint64* hi) {
+  uint64 acc[8] = {0xc2b2ae3d + seed_lo, kPrime64_1 + seed_hi,
+                   kPrime64_2 + seed_lo, kPrime64_3 + seed_hi,
+                   kPrime64_4 + seed_lo, 0x85ebca77 + seed_hi,
+                   kPrime64_5 + seed_lo, kPrime32_1 + seed_hi};
+  // The last stripe is read from the end of the data, so it is never partial.
+  size_t num_stripes = (n - 1) / kStripeSize;
+  for (size_t s = 0; s < num_stripes; ++s) {
+    AccumulateStripe(acc, data + s * kStripeSize, kSecret + s % 8);
+    if (s % kStripesPerBlock == kStripesPerBlock - 1) {
+      ScrambleAccumulators(acc);
+    }
+  }
+  AccumulateStripe(acc, data + n - kStripeSize, kSecret + 7);
+  for (size_t i = 0; i < 4; ++i) {
+    *lo += MulFold64(acc[2 * i] ^ kSecret[2 * i],
+                     acc[2 * i + 1] ^ kSecret[2 * i + 1]);
+    *hi += MulFold64(acc[2 * i + 1] ^ kSecret[15 - 2 * i],
+                     acc[2 * i] ^ kSecret[14 - 2 * i]);
+  }
 }
 
 }  // namespace
 
+// An XXH3 style 128 bits hash, whose inputs up to 16 bytes, like the ones of
+// the Hash() of the scalars, only take two 64x64->128 bits products.
 hash_t HashBlock(const void* data, size_t n, const hash_t& seed) {
-  const hash_t m = 0xc6a4a7935bd1e995;
-  const int r = 47;
-
   const uint8* u8_data = reinterpret_cast<const uint8*>(data);
-  const uint8* top = u8_data + n;
-  hash_t h = seed ^ (n * m);
-  while (u8_data < top) {
-    hash_t k = LoadHash(&u8_data, top);
-    k *= m;
-    k ^= k >> r;
-    k *= m;
-
-    h ^= k;
-    h *= m;
+  uint64 seed_lo = absl::Uint128Low64(seed);
+  uint64 seed_hi = absl::Uint128High64(seed);
+  uint64 lo = seed_lo + n * kPrime64_1;
+  uint64 hi = seed_hi ^ RotateLeft(seed_lo, 23) ^ (n * kPrime64_2);
+  if (n <= 16) {
+    HashShort(u8_data, n, &lo, &hi);
+  } else if (n <= 128) {
+    HashMedium(u8_data, n, seed_lo, seed_hi, &lo, &hi);
+  } else {
+    HashLong(u8_data, n, seed_lo, seed_hi, &lo, &hi);
   }
-  h ^= h >> r;
-  h *= m;
-  h ^= h >> r;
-  return h;
+  return absl::MakeUint128(Avalanche(hi ^ RotateLeft(lo, 17)), Avalanche(lo));
 }
 
 hash_t DataHash(const void* data, size_t size) {
@@ -63,8 +172,13 @@ size_t StdHashCombine(uintmax_t a, uintmax_t b) {
 }
 
 hash_t HashCombine(const hash_t& a, const hash_t& b) {
-  static const hash_t kb = absl::MakeUint128(101, 0x27d4eb2f165667c5);
-  return a ^ (b * kb + 0x9e3779b97f4a7c15 + (a << 6) + (a >> 2));
+  uint64 lo = MulFold64(absl::Uint128Low64(a) ^ kSecret[4],
+                        absl::Uint128Low64(b) ^ kSecret[5]) ^
+              absl::Uint128High64(a);
+  uint64 hi = MulFold64(absl::Uint128High64(a) ^ kSecret[6],
+                        absl::Uint128High64(b) ^ kSecret[7]) ^
+              lo;
+  return absl::MakeUint128(hi, lo);
 }
 
 size_t HashReduce(const hash_t& a) {
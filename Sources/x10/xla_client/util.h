@@ -315,16 +315,48 @@ static inline hash_t Hash(const std::string& value) {
 template <typename T>
 hash_t ContainerHash(const T& values);
 
+// The types whose spans are hashed as a single block of bytes.
 template <typename T>
+struct IsBlockHashable
+    : std::integral_constant<bool, std::is_arithmetic<T>::value ||
+                                       std::is_same<T, hash_t>::value> {};
+
+// Hashes a span of scalars or hashes in a single pass over its bytes, without
+// hashing and combining each value on its own.
+template <typename T>
+hash_t HashSpan(absl::Span<const T> values, const hash_t& seed) {
+  static_assert(IsBlockHashable<T>::value, "Not a block hashable type");
+  return HashBlock(values.data(), values.size() * sizeof(T), seed);
+}
+
+template <typename T, typename std::enable_if<
+                          !IsBlockHashable<T>::value>::type* = nullptr>
 hash_t Hash(absl::Span<const T> values) {
   return ContainerHash(values);
 }
 
-template <typename T>
+template <typename T, typename std::enable_if<
+                          IsBlockHashable<T>::value>::type* = nullptr>
+hash_t Hash(absl::Span<const T> values) {
+  return HashSpan(values, 0x85ebca77c2b2ae63);
+}
+
+template <typename T,
+          typename std::enable_if<!IsBlockHashable<T>::value ||
+                                  std::is_same<T, bool>::value>::type* =
+              nullptr>
 hash_t Hash(const std::vector<T>& values) {
   return ContainerHash(values);
 }
 
+template <typename T,
+          typename std::enable_if<IsBlockHashable<T>::value &&
+                                  !std::is_same<T, bool>::value>::type* =
+              nullptr>
+hash_t Hash(const std::vector<T>& values) {
+  return HashSpan(absl::MakeConstSpan(values), 0x85ebca77c2b2ae63);
+}
+
 template <typename T>
 hash_t Hash(const std::set<T>& values) {
   return ContainerHash(values);
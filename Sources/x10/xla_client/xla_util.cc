@@ -33,12 +33,8 @@ namespace util {
 namespace {
 
 hash_t SingleShapeHash(const Shape& shape, hash_t seed) {
-  for (auto dim : shape.layout().minor_to_major()) {
-    seed = HashCombine(seed, dim);
-  }
-  for (auto dim : shape.dimensions()) {
-    seed = HashCombine(seed, dim);
-  }
+  seed = HashSpan<int64>(shape.layout().minor_to_major(), seed);
+  seed = HashSpan<int64>(shape.dimensions(), seed);
   return HashCombine(seed, static_cast<int>(shape.element_type()));
 }
 
@@ -107,5 +103,16 @@ hash_t ShapeHash(const Shape& shape) {
   return hash;
 }
 
+bool HasShardings(const XlaComputation& computation) {
+  for (auto& hlo_computation : computation.proto().computations()) {
+    for (auto& instruction : hlo_computation.instructions()) {
+      if (instruction.has_sharding()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 }  // namespace util
 }  // namespace xla
@@ -49,6 +49,10 @@ void CheckComputationStatus(
 
 hash_t ShapeHash(const Shape& shape);
 
+// Tells whether the computation has sharding annotations, in which case it
+// must be compiled with the SPMD partitioner.
+bool HasShardings(const XlaComputation& computation);
+
 }  // namespace util
 }  // namespace xla
 
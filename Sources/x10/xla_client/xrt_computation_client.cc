@@ -14,20 +14,25 @@
 
 #include "tensorflow/compiler/xla/xla_client/xrt_computation_client.h"
 
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <limits>
 #include <list>
+#include <numeric>
 #include <sstream>
 #include <unordered_map>
 
+#include "absl/base/call_once.h"
 #include "absl/container/node_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/xla_client/env_vars.h"
+#include "tensorflow/compiler/xla/xla_client/fake_computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
@@ -38,10 +43,13 @@
 #include "tensorflow/compiler/xla/xla_client/local_device.h"
 #include "tensorflow/compiler/xrt/xrt_util.h"
 #include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/net.h"
 #include "tensorflow/core/protobuf/cluster.pb.h"
 #include "tensorflow/core/util/device_name_utils.h"
@@ -74,14 +82,27 @@ class XrtComputationClient::XrtDevice : public ComputationClient::Device {
     return client_->GetResourceDomain(name());
   }
 
+  std::string host() const override {
+    Worker worker = client_->GetWorkerForDevice(name()).first;
+    return absl::StrCat(worker.name, ":", worker.task_no);
+  }
+
   std::vector<ComputationClient::DataPtr> ExecuteChained(
       absl::Span<const ComputationClient::ExecuteChainedOp> ops) override {
+    std::vector<DataPtr> device_data;
+    for (auto& op : ops) {
+      if (op.device_data != nullptr) {
+        device_data.push_back(op.device_data);
+      }
+    }
+    WaitForTransfers(device_data);
     return client_->ExecuteChained(ops, name());
   }
 
   std::vector<ComputationClient::DataPtr> ExecuteComputation(
       const Computation& computation, absl::Span<const DataPtr> arguments,
       const ExecuteComputationOptions& options) override {
+    WaitForTransfers(arguments);
     return client_->ExecuteComputation(computation, arguments, name(), options);
   }
 
@@ -92,6 +113,15 @@ class XrtComputationClient::XrtDevice : public ComputationClient::Device {
   XrtComputationClient* computation_client() const { return client_; }
 
  private:
+  // Concatenates the pieces of a split tensor, along its major dimension, into
+  // a new device data of the given shape.
+  DataPtr AssembleSplitTensor(const Shape& shape,
+                              absl::Span<const DataPtr> pieces);
+
+  // Slices the device data, along its major dimension, into pieces of
+  // piece_rows rows but the last one.
+  std::vector<DataPtr> SplitTensor(const DataPtr& data, int64 piece_rows);
+
   XrtComputationClient* client_;
 };
 
@@ -506,6 +536,72 @@ int64 GetMaxTensorsPartitionSize() {
   return max_partition_size;
 }
 
+// Returns the number of partitions a transfer of total_size bytes should be
+// spread over, so that large transfers run over concurrent sessions.
+size_t GetNumTransferPartitions(int64 total_size) {
+  static int64 min_partition_size =
+      sys_util::GetEnvInt("XRT_MIN_TENSORS_PARTITION", 64 << 20);
+  static int64 max_partitions =
+      sys_util::GetEnvInt("XRT_MAX_TRANSFER_PARTITIONS", 8);
+  int64 max_partition_size = GetMaxTensorsPartitionSize();
+  int64 needed = (total_size + max_partition_size - 1) / max_partition_size;
+  int64 wanted = std::min<int64>(
+      (total_size + min_partition_size - 1) / min_partition_size,
+      max_partitions);
+  return std::max<int64>(std::max(needed, wanted), 1);
+}
+
+// Returns the size of the chunks the tensors larger than it are transferred
+// in, or 0 if they are transferred whole. Chunking bounds the host memory
+// held by the transfer of very large tensors, and keeps the messages of the
+// remote sessions small.
+int64 GetTransferChunkSize() {
+  static int64 chunk_size =
+      sys_util::GetEnvInt("XRT_TRANSFER_CHUNK_BYTES", 0);
+  return chunk_size;
+}
+
+// Returns how many chunks of a chunked transfer are in flight concurrently.
+size_t GetTransferChunksInFlight() {
+  static int64 chunks_in_flight =
+      sys_util::GetEnvInt("XRT_TRANSFER_CHUNKS_IN_FLIGHT", 4);
+  return std::max<int64>(chunks_in_flight, 1);
+}
+
+// Whether slices of the major dimension of a tensor with the given shape are
+// contiguous in its host memory.
+bool IsSplittable(const Shape& shape) {
+  return shape.IsArray() && shape.rank() > 0 && shape.dimensions(0) > 1 &&
+         (!LayoutUtil::HasLayout(shape) ||
+          (shape.layout().tiles().empty() &&
+           shape.layout().minor_to_major().back() == 0));
+}
+
+// The host side of a tensor whose transfer is split in pieces. All the pieces
+// copy from the whole tensor, which is populated once by the first piece
+// needing it, unless the source data can be read directly.
+class SplitTensorSource {
+ public:
+  explicit SplitTensorSource(const TensorSource* source) : source_(source) {}
+
+  const char* GetData() {
+    if (source_->data != nullptr) {
+      return static_cast<const char*>(source_->data);
+    }
+    absl::call_once(populate_once_, [this]() {
+      size_t size = ShapeUtil::ByteSizeOfElements(source_->shape);
+      buffer_.reset(new char[size]);
+      source_->populate_fn(*source_, buffer_.get(), size);
+    });
+    return buffer_.get();
+  }
+
+ private:
+  const TensorSource* source_;
+  absl::once_flag populate_once_;
+  std::unique_ptr<char[]> buffer_;
+};
+
 bool GpuIsAvailable() {
   std::vector<string> devices;
   tensorflow::Status s =
@@ -627,34 +723,73 @@ XrtComputationClient::XrtComputationClient(
   InitializeDevices(std::move(topology_proto));
   StartHandleReleaser();
 
+  static const int64 prewarm_sessions =
+      sys_util::GetEnvInt("XRT_SESSION_PREWARM_COUNT", 0);
+  for (auto& worker_target : options_.workers_map) {
+    session_cache_->Prewarm(worker_target.second, prewarm_sessions);
+  }
+
   for (const auto& dev_target : options_.global_device_map) {
     AddDevice(std::make_unique<XrtDevice>(dev_target.first, this));
   }
 
+  // The simulated devices stand in for the local GPUs, so that the device
+  // pipelining can be benchmarked without them.
+  std::vector<std::unique_ptr<Device>> fake_devices = GetFakeDevices();
+  if (!fake_devices.empty()) {
+    options_.default_device = fake_devices.front()->name();
+    for (auto& device : fake_devices) {
+      AddDevice(std::move(device));
+    }
+    return;
+  }
   for (auto& device : GetAllLocalDevicesForPlatform("gpu", "GPU")) {
     options_.default_device = "GPU:0";
     AddDevice(std::move(device));
   }
 }
 
-std::vector<size_t> XrtComputationClient::PartitionTransferToServer(
-    absl::Span<const TensorSource> tensors) {
-  int64 max_partition_size = GetMaxTensorsPartitionSize();
-  uint64 current_size = 0;
-  std::vector<size_t> partitions;
+std::vector<std::vector<size_t>>
+XrtComputationClient::PartitionTransferToServer(
+    absl::Span<const TensorSource> tensors, int64 max_partition_size) {
+  std::vector<int64> sizes(tensors.size());
+  int64 total_size = 0;
   for (size_t i = 0; i < tensors.size(); ++i) {
-    int64 tensor_size = ShapeUtil::ByteSizeOfElements(tensors[i].shape);
-    if (current_size + tensor_size > max_partition_size) {
-      if (partitions.empty() && i > 0) {
-        partitions.push_back(0);
-      }
-      partitions.push_back(i);
-      current_size = 0;
+    sizes[i] = ShapeUtil::ByteSizeOfElements(tensors[i].shape);
+    total_size += sizes[i];
+  }
+  size_t num_partitions = std::max<size_t>(
+      std::min(GetNumTransferPartitions(total_size), tensors.size()), 1);
+  // Placing the largest tensors first, each over the least loaded partition,
+  // keeps the partitions byte balanced.
+  std::vector<size_t> order(tensors.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t i1, size_t i2) { return sizes[i1] > sizes[i2]; });
+  std::vector<std::vector<size_t>> partitions(num_partitions);
+  std::vector<int64> loads(num_partitions, 0);
+  for (size_t index : order) {
+    size_t best = std::min_element(loads.begin(), loads.end()) - loads.begin();
+    if (!partitions[best].empty() &&
+        loads[best] + sizes[index] > max_partition_size) {
+      partitions.emplace_back();
+      loads.push_back(0);
+      best = partitions.size() - 1;
     }
-    current_size += tensor_size;
+    partitions[best].push_back(index);
+    loads[best] += sizes[index];
+  }
+  partitions.erase(
+      std::remove_if(partitions.begin(), partitions.end(),
+                     [](const std::vector<size_t>& partition) {
+                       return partition.empty();
+                     }),
+      partitions.end());
+  for (auto& partition : partitions) {
+    std::sort(partition.begin(), partition.end());
   }
   if (partitions.empty()) {
-    partitions.push_back(0);
+    partitions.emplace_back();
   }
   return partitions;
 }
@@ -662,34 +797,186 @@ std::vector<size_t> XrtComputationClient::PartitionTransferToServer(
 std::vector<ComputationClient::DataPtr>
 XrtComputationClient::XrtDevice::TransferToServer(
     absl::Span<const TensorSource> tensors) {
-  auto partitions = PartitionTransferToServer(tensors);
-  if (partitions.size() == 1) {
+  int64 total_size = 0;
+  for (auto& tensor : tensors) {
+    total_size += ShapeUtil::ByteSizeOfElements(tensor.shape);
+  }
+  size_t num_partitions = GetNumTransferPartitions(total_size);
+  int64 piece_size = (total_size + num_partitions - 1) / num_partitions;
+  int64 max_partition_size = GetMaxTensorsPartitionSize();
+  int64 chunk_size = GetTransferChunkSize();
+  bool chunked = chunk_size > 0 && total_size > chunk_size;
+  if (chunked) {
+    piece_size = std::min(piece_size, chunk_size);
+    max_partition_size = std::min(max_partition_size, chunk_size);
+  }
+
+  // Tensors larger than a balanced partition, or than a chunk, are split along
+  // their major dimension, so that the pieces go over concurrent sessions, and
+  // then get concatenated back on the device.
+  struct SplitTensor {
+    size_t index = 0;
+    size_t first_piece = 0;
+    size_t num_pieces = 0;
+  };
+  std::vector<SplitTensor> splits;
+  std::vector<std::shared_ptr<SplitTensorSource>> split_sources;
+  std::vector<TensorSource> pieces;
+  std::vector<size_t> piece_index;
+  for (size_t i = 0; i < tensors.size() && (num_partitions > 1 || chunked);
+       ++i) {
+    int64 size = ShapeUtil::ByteSizeOfElements(tensors[i].shape);
+    if (size <= piece_size || !IsSplittable(tensors[i].shape)) {
+      continue;
+    }
+    int64 rows = tensors[i].shape.dimensions(0);
+    int64 num_pieces = std::min((size + piece_size - 1) / piece_size, rows);
+    int64 piece_rows = (rows + num_pieces - 1) / num_pieces;
+    int64 row_size = size / rows;
+    auto split_source = std::make_shared<SplitTensorSource>(&tensors[i]);
+    splits.push_back({i, pieces.size(), 0});
+    for (int64 row = 0; row < rows; row += piece_rows) {
+      Shape shape = tensors[i].shape;
+      shape.set_dimensions(0, std::min(piece_rows, rows - row));
+      int64 offset = row * row_size;
+      pieces.emplace_back(
+          std::move(shape),
+          [split_source, offset](const TensorSource&, void* dest, size_t size) {
+            std::memcpy(dest, split_source->GetData() + offset, size);
+          });
+      ++splits.back().num_pieces;
+    }
+    split_sources.push_back(std::move(split_source));
+  }
+
+  std::vector<TensorSource> split_tensors;
+  absl::Span<const TensorSource> sources = tensors;
+  if (!splits.empty()) {
+    XLA_COUNTER("XrtSplitTransfers", splits.size());
+    size_t split_index = 0;
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      if (split_index < splits.size() && splits[split_index].index == i) {
+        ++split_index;
+      } else {
+        split_tensors.push_back(tensors[i]);
+        piece_index.push_back(i);
+      }
+    }
+    for (SplitTensor& split : splits) {
+      size_t first_piece = split_tensors.size();
+      for (size_t p = 0; p < split.num_pieces; ++p) {
+        split_tensors.push_back(std::move(pieces[split.first_piece + p]));
+      }
+      split.first_piece = first_piece;
+    }
+    sources = split_tensors;
+  }
+
+  auto partitions = PartitionTransferToServer(sources, max_partition_size);
+  if (partitions.size() == 1 && splits.empty()) {
     // Fast path in case of single partition. Avoid creating threads and
     // waiting, since this is the common case.
     return client_->TransferToServerInternal(this, tensors);
   }
   XLA_COUNTER("XrtPartitionedTransferToServer", 1);
 
-  util::MultiWait mwait(partitions.size());
-  std::vector<DataPtr> results(tensors.size());
-  for (size_t i = 0; i < partitions.size(); ++i) {
-    auto sender = [&, i]() {
-      size_t base_index = partitions[i];
-      size_t length = (i + 1 < partitions.size())
-                          ? partitions[i + 1] - base_index
-                          : tensors.size() - base_index;
-      auto partitions_results = client_->TransferToServerInternal(
-          this, tensors.subspan(base_index, length));
-      for (size_t r = 0; r < length; ++r) {
-        results[base_index + r] = std::move(partitions_results[r]);
+  // Every sender transfers partitions until none is left. A chunked transfer
+  // only has a few senders, as every partition being sent holds a host copy
+  // of its tensors.
+  size_t num_senders = chunked ? std::min(GetTransferChunksInFlight(),
+                                          partitions.size())
+                               : partitions.size();
+  if (chunked) {
+    XLA_COUNTER("XrtChunkedTransferToServer", 1);
+  }
+  std::atomic<size_t> next_partition(0);
+  util::MultiWait mwait(num_senders);
+  std::vector<DataPtr> transferred(sources.size());
+  for (size_t s = 0; s < num_senders; ++s) {
+    auto sender = [&]() {
+      for (size_t i = next_partition++; i < partitions.size();
+           i = next_partition++) {
+        XLA_TIMED("XrtTransferPartitionTime");
+        std::vector<TensorSource> partition_sources;
+        partition_sources.reserve(partitions[i].size());
+        int64 partition_size = 0;
+        for (size_t index : partitions[i]) {
+          partition_sources.push_back(sources[index]);
+          partition_size +=
+              ShapeUtil::ByteSizeOfElements(sources[index].shape);
+        }
+        XLA_VALUE_METRIC("XrtTransferPartitionBytes", partition_size);
+        auto partitions_results =
+            client_->TransferToServerInternal(this, partition_sources);
+        for (size_t r = 0; r < partitions[i].size(); ++r) {
+          transferred[partitions[i][r]] = std::move(partitions_results[r]);
+        }
       }
     };
     env::ScheduleIoClosure(mwait.Completer(std::move(sender)));
   }
   mwait.Wait();
+  if (splits.empty()) {
+    return transferred;
+  }
+
+  std::vector<DataPtr> results(tensors.size());
+  for (size_t i = 0; i < piece_index.size(); ++i) {
+    results[piece_index[i]] = std::move(transferred[i]);
+  }
+  for (const SplitTensor& split : splits) {
+    results[split.index] = AssembleSplitTensor(
+        tensors[split.index].shape,
+        absl::MakeConstSpan(transferred)
+            .subspan(split.first_piece, split.num_pieces));
+  }
   return results;
 }
 
+DataPtr XrtComputationClient::XrtDevice::AssembleSplitTensor(
+    const Shape& shape, absl::Span<const DataPtr> pieces) {
+  XlaBuilder builder("AssembleSplitTensor");
+  std::vector<XlaOp> parameters;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    parameters.push_back(Parameter(&builder, i, pieces[i]->shape(),
+                                   absl::StrCat("p", i)));
+  }
+  ConcatInDim(&builder, parameters, 0);
+  std::vector<CompileInstance> instances;
+  instances.emplace_back(ConsumeValue(builder.Build()), &shape);
+  // The compilation cache makes this a lookup after the first time a given
+  // split layout is seen.
+  std::vector<ComputationPtr> computations =
+      Compile(ComputationClient::GetCompilationDevices(name(), {}),
+              std::move(instances));
+  std::vector<DataPtr> results =
+      client_->ExecuteComputation(*computations.front(), pieces, name(),
+                                  ExecuteComputationOptions());
+  XLA_CHECK_EQ(results.size(), 1);
+  return std::move(results.front());
+}
+
+std::vector<DataPtr> XrtComputationClient::XrtDevice::SplitTensor(
+    const DataPtr& data, int64 piece_rows) {
+  const Shape& shape = data->shape();
+  int64 rows = shape.dimensions(0);
+  XlaBuilder builder("SplitTensor");
+  XlaOp parameter = Parameter(&builder, 0, shape, "p0");
+  std::vector<XlaOp> pieces;
+  for (int64 row = 0; row < rows; row += piece_rows) {
+    pieces.push_back(
+        SliceInDim(parameter, row, std::min(row + piece_rows, rows), 1, 0));
+  }
+  Tuple(&builder, pieces);
+  std::vector<CompileInstance> instances;
+  instances.emplace_back(ConsumeValue(builder.Build()), nullptr);
+  std::vector<ComputationPtr> computations =
+      Compile(ComputationClient::GetCompilationDevices(name(), {}),
+              std::move(instances));
+  return client_->ExecuteComputation(*computations.front(), {data}, name(),
+                                     ExecuteComputationOptions());
+}
+
 std::vector<ComputationClient::DataPtr>
 XrtComputationClient::TransferToServerInternal(
     XrtDevice* device_ptr, absl::Span<const TensorSource> tensors) {
@@ -720,12 +1007,14 @@ XrtComputationClient::TransferToServerInternal(
           XrtSession* session = GetSessionForXrtDevice(
               alloc_session_cache_.get(), xrt_device, &session_map);
           SessionWork* session_work = &session_work_map[session];
-          tensorflow::Scope device_scope =
-              session->root()->WithDevice(xrt_device);
+          const tensorflow::Scope& device_scope =
+              session->GetDeviceScope(xrt_device);
           const XrtSession::CachedNode& cached_node =
               GetAllocateNode(session, device_scope, device, tensors[i].shape);
           session_work->feed_inputs.insert({cached_node.holders[0], tensor});
+          // Fetch the handle and the compiled program shape.
           session_work->outputs_handles.push_back(cached_node.outputs[0]);
+          session_work->outputs_handles.push_back(cached_node.outputs[1]);
           session_work->index_mapping.push_back(i);
 
           total_size += tdata.size();
@@ -763,6 +1052,77 @@ XrtComputationClient::TransferToServerInternal(
 
 std::vector<Literal> XrtComputationClient::TransferFromServerImpl(
     absl::Span<const DataPtr> handles) {
+  int64 chunk_size = GetTransferChunkSize();
+  std::vector<DataPtr> whole_handles;
+  std::vector<size_t> whole_index;
+  std::vector<size_t> chunked_index;
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const Shape& shape = handles[i]->shape();
+    if (chunk_size > 0 && shape.IsArray() && shape.rank() > 0 &&
+        shape.dimensions(0) > 1 &&
+        ShapeUtil::ByteSizeOfElements(shape) > chunk_size) {
+      chunked_index.push_back(i);
+    } else {
+      whole_handles.push_back(handles[i]);
+      whole_index.push_back(i);
+    }
+  }
+  if (chunked_index.empty()) {
+    return TransferFromServerInternal(handles);
+  }
+  std::vector<Literal> results(handles.size());
+  if (!whole_handles.empty()) {
+    std::vector<Literal> whole_results =
+        TransferFromServerInternal(whole_handles);
+    for (size_t i = 0; i < whole_index.size(); ++i) {
+      results[whole_index[i]] = std::move(whole_results[i]);
+    }
+  }
+  for (size_t index : chunked_index) {
+    results[index] = TransferFromServerChunked(handles[index], chunk_size);
+  }
+  return results;
+}
+
+Literal XrtComputationClient::TransferFromServerChunked(const DataPtr& handle,
+                                                        int64 chunk_size) {
+  XLA_COUNTER("XrtChunkedTransferFromServer", 1);
+  const Shape& shape = handle->shape();
+  int64 rows = shape.dimensions(0);
+  int64 row_size = ShapeUtil::ByteSizeOfElements(shape) / rows;
+  int64 chunk_rows = std::max<int64>(chunk_size / row_size, 1);
+  std::vector<DataPtr> chunks =
+      dynamic_cast<XrtDevice*>(handle->device())->SplitTensor(handle,
+                                                               chunk_rows);
+  Literal result(ShapeUtil::MakeShapeWithDescendingLayout(
+      shape.element_type(), shape.dimensions()));
+  char* result_data = static_cast<char*>(result.untyped_data());
+
+  // Every chunk is copied into the result as soon as it is read, and its
+  // device data released.
+  size_t num_readers = std::min(GetTransferChunksInFlight(), chunks.size());
+  std::atomic<size_t> next_chunk(0);
+  util::MultiWait mwait(num_readers);
+  for (size_t r = 0; r < num_readers; ++r) {
+    auto reader = [&]() {
+      for (size_t c = next_chunk++; c < chunks.size(); c = next_chunk++) {
+        Literal chunk =
+            std::move(TransferFromServerInternal({chunks[c]}).front());
+        chunks[c] = nullptr;
+        chunk = chunk.Relayout(
+            LayoutUtil::GetDefaultLayoutForShape(chunk.shape()));
+        std::memcpy(result_data + c * chunk_rows * row_size,
+                    chunk.untyped_data(), chunk.size_bytes());
+      }
+    };
+    env::ScheduleIoClosure(mwait.Completer(std::move(reader)));
+  }
+  mwait.Wait();
+  return result;
+}
+
+std::vector<Literal> XrtComputationClient::TransferFromServerInternal(
+    absl::Span<const DataPtr> handles) {
   metrics::TimedSection timed(TransferFromServerMetric());
 
   int64 max_partition_size = GetMaxTensorsPartitionSize();
@@ -783,7 +1143,7 @@ std::vector<Literal> XrtComputationClient::TransferFromServerImpl(
     XrtSession* session = GetSessionForDevice(
         session_cache_.get(), xrt_data.device()->name(), &session_maps.back());
     SessionWork* session_work = &session_work_map[session];
-    tensorflow::Scope device_scope = session->root()->WithDevice(
+    const tensorflow::Scope& device_scope = session->GetDeviceScope(
         SwiftDeviceToXrtDevice(xrt_data.device()->name()));
     const XrtSession::CachedNode& cached_node =
         GetReadNode(session, device_scope, xrt_data.device()->name());
@@ -815,6 +1175,23 @@ std::vector<Literal> XrtComputationClient::TransferFromServerImpl(
   return results;
 }
 
+XrtComputationClient::CompilationCacheKey::CompilationCacheKey(
+    std::string domain, const std::string& serialized_computation)
+    : domain(std::move(domain)), size(serialized_computation.size()) {
+  // Fold the fingerprints of fixed size chunks, so that the key does not
+  // depend on how large the proto is, and no copy of it is ever needed.
+  static const size_t kChunkSize = 1 << 20;
+  fingerprint = absl::MakeUint128(0, size);
+  for (size_t pos = 0; pos < serialized_computation.size();
+       pos += kChunkSize) {
+    tensorflow::Fprint128 chunk_fprint = tensorflow::Fingerprint128(
+        absl::string_view(serialized_computation).substr(pos, kChunkSize));
+    fingerprint = util::HashCombine(
+        fingerprint,
+        absl::MakeUint128(chunk_fprint.high64, chunk_fprint.low64));
+  }
+}
+
 std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
     const std::string& device, const std::vector<std::string>& devices,
     std::vector<CompileInstance> instances) {
@@ -833,8 +1210,9 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
       std::unique_ptr<xrt::XLAComputation> xrt_computation =
           CreateXrtComputation(instance.computation, devices,
                                instance.output_shape);
+      std::string serialized_computation = xrt_computation->SerializeAsString();
       CompilationCacheKey cache_key(GetResourceDomain(device),
-                                    xrt_computation->SerializeAsString());
+                                    serialized_computation);
       auto computation_ptr = compilation_cache_.Get(cache_key);
       if (computation_ptr == nullptr) {
         cache_keys[i] = std::move(cache_key);
@@ -847,13 +1225,15 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
           XrtSession* session = GetSessionForXrtDevice(
               session_cache_.get(), xrt_device, &session_map);
           SessionWork* session_work = &session_work_map[session];
-          tensorflow::Scope device_scope =
-              session->root()->WithDevice(xrt_device);
+          const tensorflow::Scope& device_scope =
+              session->GetDeviceScope(xrt_device);
           const XrtSession::CachedNode& cached_node =
               GetCompileNode(session, device_scope, device);
           session_work->feed_inputs.insert(
-              {cached_node.holders[0], cache_keys[i].serialized_computation});
+              {cached_node.holders[0], serialized_computation});
+          // Fetch the handle and the compiled program shape.
           session_work->outputs_handles.push_back(cached_node.outputs[0]);
+          session_work->outputs_handles.push_back(cached_node.outputs[1]);
           session_work->index_mapping.push_back(i);
         }
       } else {
@@ -885,7 +1265,18 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
         results[li] = std::make_shared<XrtComputation>(
             this, std::move(instance->computation), program_shapes[li], devices,
             outputs[output_index].scalar<int64>()(), device);
-        ++output_index;
+        xla::ProgramShapeProto compiled_program_shape;
+        if (compiled_program_shape.ParseFromString(
+                outputs[output_index + 1].scalar<tensorflow::tstring>()())) {
+          std::vector<Shape> parameter_shapes;
+          for (const xla::ShapeProto& shape :
+               compiled_program_shape.parameters()) {
+            parameter_shapes.emplace_back(shape);
+          }
+          results[li]->set_compiled_parameter_shapes(
+              std::move(parameter_shapes));
+        }
+        output_index += 2;
 
         compilation_cache_.Add(std::move(cache_keys[li]), results[li]);
         CreateCompileHandlesCounter()->AddValue(1);
@@ -916,6 +1307,7 @@ XrtComputationClient::ExecuteComputation(
     const Computation& computation, absl::Span<const DataPtr> arguments,
     const std::string& device, const ExecuteComputationOptions& options) {
   metrics::TimedSection timed(ExecuteMetric());
+  util::ExceptionCleanup execution = TrackExecution();
 
   XrtSessionCache::SessionMap session_map;
   std::string effective_device = GetEffectiveDevice(device);
@@ -944,6 +1336,7 @@ XrtComputationClient::ExecuteReplicated(
     absl::Span<const std::string> devices,
     const ExecuteReplicatedOptions& options) {
   metrics::TimedSection timed(ExecuteReplicatedMetric());
+  util::ExceptionCleanup execution = TrackExecution();
 
   XrtSessionCache::SessionMap session_map;
   tensorflow::ClientSession::FeedType feed_inputs;
@@ -1027,6 +1420,7 @@ XrtComputationClient::ExecuteParallel(
     absl::Span<const std::string> devices,
     const ExecuteParallelOptions& options) {
   metrics::TimedSection timed(ExecuteParallelMetric());
+  util::ExceptionCleanup execution = TrackExecution();
 
   XrtSessionCache::SessionMap session_map;
   tensorflow::ClientSession::FeedType feed_inputs;
@@ -1047,6 +1441,7 @@ std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChained(
 std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChainedXrt(
     absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
   metrics::TimedSection timed(ExecuteChainedMetric());
+  util::ExceptionCleanup execution = TrackExecution();
 
   XrtSessionCache::SessionMap session_map;
   std::string effective_device = GetEffectiveDevice(device);
@@ -1054,7 +1449,7 @@ std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChainedXrt(
   tensorflow::ClientSession::FeedType feed_inputs;
   XrtSession* session =
       GetSessionForXrtDevice(session_cache_.get(), xrt_device, &session_map);
-  tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+  const tensorflow::Scope& device_scope = session->GetDeviceScope(xrt_device);
 
   xrt::XRTChainedExecuteConfig config;
   config.set_core_index_in_replica(0);
@@ -1129,6 +1524,7 @@ std::vector<ComputationClient::DataPtr>
 XrtComputationClient::ExecuteChainedSplit(
     absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
   metrics::TimedSection timed(ExecuteChainedMetric());
+  util::ExceptionCleanup execution = TrackExecution();
 
   std::vector<int64> uses(ops.size(), 0);
   for (auto& op : ops) {
@@ -1141,7 +1537,7 @@ XrtComputationClient::ExecuteChainedSplit(
   const std::string& xrt_device = SwiftDeviceToXrtDevice(effective_device);
   XrtSession* session =
       GetSessionForXrtDevice(session_cache_.get(), xrt_device, &session_map);
-  tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+  const tensorflow::Scope& device_scope = session->GetDeviceScope(xrt_device);
   std::vector<std::vector<DataPtr>> ops_outputs(ops.size());
   std::vector<DataPtr> results;
   for (size_t i = 0; i < ops.size(); ++i) {
@@ -1212,7 +1608,7 @@ XrtComputationClient::DeconstructTuple(absl::Span<const DataPtr> tuples) {
     SessionWork* session_work = &session_work_map[session];
     session_work->index_mapping.push_back(i);
 
-    tensorflow::Scope device_scope = session->root()->WithDevice(
+    const tensorflow::Scope& device_scope = session->GetDeviceScope(
         SwiftDeviceToXrtDevice(xrt_data.device()->name()));
     int64 count = ShapeUtil::TupleElementCount(xrt_data.shape());
     tuple_elements_count[i] = count;
@@ -1301,6 +1697,8 @@ const std::string& XrtComputationClient::SwiftDeviceToXrtDevice(
 std::unique_ptr<xrt::XLAComputation> XrtComputationClient::CreateXrtComputation(
     const XlaComputation& computation, absl::Span<const std::string> devices,
     const Shape* output_shape) const {
+  XLA_CHECK(!util::HasShardings(computation))
+      << "SPMD partitioned computations require local devices";
   std::unique_ptr<xrt::XLAComputation> xrt_computation(
       new xrt::XLAComputation());
   auto config = xrt_computation->mutable_config();
@@ -1368,7 +1766,7 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     const std::string& xrt_device = SwiftDeviceToXrtDevice(devices[i]);
     XrtSession* session =
         GetSessionForXrtDevice(session_cache_.get(), xrt_device, session_map);
-    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+    const tensorflow::Scope& device_scope = session->GetDeviceScope(xrt_device);
     const XrtSession::CachedNode& cached_node =
         GetExecuteNode(session, device_scope, devices[i]);
     feed_inputs->insert(
@@ -1400,7 +1798,7 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     const std::string& xrt_device = SwiftDeviceToXrtDevice(devices[i]);
     XrtSession* session =
         GetSessionForXrtDevice(session_cache_.get(), xrt_device, session_map);
-    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+    const tensorflow::Scope& device_scope = session->GetDeviceScope(xrt_device);
     const XrtSession::CachedNode& cached_node =
         GetExecuteNode(session, device_scope, devices[i]);
     feed_inputs->insert({cached_node.holders[0], computation.get_handle()});
@@ -1430,9 +1828,13 @@ void XrtComputationClient::ReleaseHandles(
   {
     std::lock_guard<std::mutex> lock(lock_);
     released_handles.swap(*handles);
+    if (released_data_handles_.empty() && released_compile_handles_.empty()) {
+      oldest_release_ns_ = 0;
+    }
   }
   if (!released_handles.empty()) {
     metrics::TimedSection timed(timed_metric);
+    XLA_VALUE_METRIC("ReleaseHandlesBatchSize", released_handles.size());
 
     XrtSessionCache::SessionMap session_map;
     std::map<XrtSession*, std::vector<DeviceHandle>> session_handles_map;
@@ -1452,7 +1854,7 @@ void XrtComputationClient::ReleaseHandles(
       for (size_t i = 0; i < session_handles.size(); ++i) {
         flat_handles_tensor(i) = session_handles[i].handle;
       }
-      tensorflow::Scope device_scope = session->root()->WithDevice(
+      const tensorflow::Scope& device_scope = session->GetDeviceScope(
           SwiftDeviceToXrtDevice(session_handles.front().device));
       const XrtSession::CachedNode& cached_node =
           op_generator(session, device_scope, session_handles.front().device);
@@ -1498,11 +1900,50 @@ void XrtComputationClient::HandleReleaser() {
 void XrtComputationClient::ReleaseHandle(int64 handle,
                                          const std::string& device,
                                          std::vector<DeviceHandle>* handles) {
+  static const size_t batch_size =
+      sys_util::GetEnvInt("XLA_RELEASE_BATCH_SIZE", 256);
+  static const int64 max_delay_ns =
+      sys_util::GetEnvInt("XLA_RELEASE_MAX_DELAY_MS", 100) * 1000000;
+  static const size_t backpressure_handles =
+      sys_util::GetEnvInt("XLA_RELEASE_BACKPRESSURE_HANDLES", 16384);
+  size_t num_pending = 0;
+  bool activate = false;
   {
     std::lock_guard<std::mutex> lock(lock_);
     handles->push_back({device, handle});
+    int64 now = sys_util::NowNs();
+    if (oldest_release_ns_ == 0) {
+      oldest_release_ns_ = now;
+    }
+    num_pending =
+        released_data_handles_.size() + released_compile_handles_.size();
+    activate = executions_in_flight_ == 0 || num_pending >= batch_size ||
+               now - oldest_release_ns_ >= max_delay_ns;
+  }
+  if (num_pending >= backpressure_handles) {
+    XLA_COUNTER("ReleaseHandlesBackPressure", 1);
+    triggered_task_->WaitForRun(triggered_task_->Activate());
+  } else if (activate) {
+    triggered_task_->Activate();
   }
-  triggered_task_->Activate();
+}
+
+util::ExceptionCleanup XrtComputationClient::TrackExecution() {
+  ++executions_in_flight_;
+  return util::ExceptionCleanup([this](std::exception_ptr) {
+    if (--executions_in_flight_ > 0) {
+      return;
+    }
+    bool has_pending = false;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      has_pending =
+          !released_data_handles_.empty() || !released_compile_handles_.empty();
+    }
+    if (has_pending) {
+      triggered_task_->Activate();
+    }
+  });
 }
 
 void XrtComputationClient::ReleaseXrtData(const std::string& device,
@@ -1651,6 +2092,16 @@ void XrtComputationClient::InitializeDevices(
     if (device.ordinal == 0) {
       CreateMeshService(mesh_service_address, topology_proto.get());
     }
+    // The first process of every host runs the relay the host processes
+    // rendezvous through, if one is configured.
+    std::string mesh_relay_address =
+        sys_util::GetEnvString(env::kEnvMeshRelay, "");
+    if (!mesh_relay_address.empty() &&
+        sys_util::GetEnvInt(env::kEnvLocalOrdinal, -1) == 0) {
+      TF_VLOG(1) << "Creating mesh relay bound to " << mesh_relay_address;
+      mesh_relay_ = absl::make_unique<service::MeshService>(
+          mesh_relay_address, mesh_service_address);
+    }
     SetupGpuRuntime();
   }
 }
@@ -1847,6 +2298,9 @@ std::map<std::string, Metric> XrtComputationClient::GetMetrics() const {
       metrics_data.emplace(std::move(metric_name), std::move(metric));
     }
   }
+  for (Device* device : GetAllDevicePointers()) {
+    device->GetMetrics(&metrics_data);
+  }
   return metrics_data;
 }
 
@@ -1874,7 +2328,7 @@ void XrtComputationClient::InitSession(XrtSession* session) const {
       continue;
     }
     const std::string& xrt_device = SwiftDeviceToXrtDevice(device);
-    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+    const tensorflow::Scope& device_scope = session->GetDeviceScope(xrt_device);
     for (auto& init : init_nodes) {
       for (int i = 0; i < init.count; ++i) {
         (this->*init.node_ctor)(session, device_scope, device);
@@ -1888,14 +2342,16 @@ const XrtSession::CachedNode& XrtComputationClient::GetCompileNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
   static const std::string op_name("XrtCompile");  // NOLINT
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(op_name, device);
   if (cache->Empty()) {
     XLA_COUNTER("XrtCompile_Empty", 1);
     std::vector<tensorflow::ops::Placeholder> holders(
         {tensorflow::ops::Placeholder(scope, tensorflow::DT_STRING)});
-    cache->Add(std::make_shared<XrtSession::CachedNode>(
-        tensorflow::ops::XRTCompile(scope, holders[0]).handle, holders));
+    tensorflow::ops::XRTCompile compile(scope, holders[0]);
+    std::vector<tensorflow::Output> outputs(
+        {compile.handle, compile.program_shape});
+    cache->Add(
+        std::make_shared<XrtSession::CachedNode>(std::move(outputs), holders));
   }
   return cache->Get();
 }
@@ -1904,8 +2360,7 @@ const XrtSession::CachedNode& XrtComputationClient::GetExecuteNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
   static const std::string op_name("XrtExecute");  // NOLINT
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(op_name, device);
   if (cache->Empty()) {
     XLA_COUNTER("XrtExecute_Empty", 1);
     std::vector<tensorflow::ops::Placeholder> holders(
@@ -1926,8 +2381,7 @@ const XrtSession::CachedNode& XrtComputationClient::GetExecuteChainedNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
   static const std::string op_name("XrtExecuteChained");  // NOLINT
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(op_name, device);
   if (cache->Empty()) {
     XLA_COUNTER("XrtExecuteChained_Empty", 1);
     std::vector<tensorflow::ops::Placeholder> holders(
@@ -1944,8 +2398,7 @@ const XrtSession::CachedNode& XrtComputationClient::GetReadNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
   static const std::string op_name("XrtRead");  // NOLINT
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(op_name, device);
   if (cache->Empty()) {
     XLA_COUNTER("XrtRead_Empty", 1);
     std::vector<tensorflow::ops::Placeholder> holders(
@@ -1963,8 +2416,7 @@ const XrtSession::CachedNode& XrtComputationClient::GetAllocateNode(
   // layouts attributes, these need to be included within the key.
   std::stringstream ss;
   ss << "XRTAllocateFromTensor(" << shape << ")";
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(ss.str(), device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(ss.str(), device);
   if (cache->Empty()) {
     XLA_COUNTER("XRTAllocateFromTensor_Empty", 1);
     tensorflow::TensorShape tensor_shape(shape.dimensions());
@@ -1991,8 +2443,7 @@ XrtComputationClient::GetReleaseAllocationHandleNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
   static const std::string op_name("XrtReleaseAllocationHandle");  // NOLINT
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(op_name, device);
   if (cache->Empty()) {
     XLA_COUNTER("XrtReleaseAllocationHandle_Empty", 1);
     std::vector<tensorflow::ops::Placeholder> holders(
@@ -2008,8 +2459,7 @@ const XrtSession::CachedNode& XrtComputationClient::GetReleaseCompileHandleNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
   static const std::string op_name("XrtReleaseCompileHandle");  // NOLINT
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(op_name, device);
   if (cache->Empty()) {
     XLA_COUNTER("XrtReleaseCompileHandle_Empty", 1);
     std::vector<tensorflow::ops::Placeholder> holders(
@@ -2025,8 +2475,7 @@ const XrtSession::CachedNode& XrtComputationClient::GetSubTupleNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
   static const std::string op_name("XrtSubTuple");  // NOLINT
-  XrtSession::NodeCache* cache =
-      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  XrtSession::NodeCache* cache = session->GetNodeCache(op_name, device);
   if (cache->Empty()) {
     XLA_COUNTER("XrtSubTuple_Empty", 1);
     std::vector<tensorflow::ops::Placeholder> holders(
@@ -2150,6 +2599,7 @@ void XrtComputationClient::MaybeCreateLocalService(const Options& options) {
   }
   int task_index = -1;
   std::string job_name;
+  std::string local_target;
   std::vector<std::string> hosts;
   for (auto& worker_target : options.workers_map) {
     if (worker_target.first.name == kLocalService &&
@@ -2161,6 +2611,7 @@ void XrtComputationClient::MaybeCreateLocalService(const Options& options) {
             << "'";
         job_name = worker_target.first.name;
         task_index = worker_target.first.task_no;
+        local_target = worker_target.second;
       }
     }
   }
@@ -2171,6 +2622,15 @@ void XrtComputationClient::MaybeCreateLocalService(const Options& options) {
     XrtLocalService* service =
         new XrtLocalService(cluster_spec, job_name, task_index);
     service->Start();
+    static const bool in_process_sessions =
+        sys_util::GetEnvBool("XRT_IN_PROCESS_SESSIONS", true);
+    if (in_process_sessions) {
+      TF_VLOG(2) << "In-process sessions for " << local_target << " through "
+                 << service->target();
+      session_cache_->SetInProcessTarget(local_target, service->target());
+      alloc_session_cache_->SetInProcessTarget(local_target,
+                                               service->target());
+    }
   }
 }
 
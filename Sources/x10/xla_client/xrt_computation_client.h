@@ -178,6 +178,8 @@ class XrtComputationClient : public ComputationClient,
   std::vector<DataPtr> ExecuteChained(absl::Span<const ExecuteChainedOp> ops,
                                       const std::string& device);
 
+  // Splits tuple data into the data of its elements, with a session run per
+  // worker. Only needed for results of executions which did not explode them.
   std::vector<std::vector<DataPtr>> DeconstructTuple(
       absl::Span<const DataPtr> tuples);
 
@@ -202,30 +204,30 @@ class XrtComputationClient : public ComputationClient,
  private:
   // The data structure used for the key in the compilation cache. Compilations
   // handles are valid within given domain (essentially the host+port worker
-  // endpoints), so the key must include the domain.
+  // endpoints), so the key must include the domain. The serialized computation
+  // is identified by its 128 bit fingerprint and size, so that large protos
+  // are neither retained by the cache nor compared byte by byte on lookup.
   struct CompilationCacheKey {
     struct Hash {
       size_t operator()(const CompilationCacheKey& entry) const {
-        util::PartialHasher<std::string, 4096> hasher;
         hash_t h = util::DataHash(entry.domain.data(), entry.domain.size());
-        return util::HashReduce(
-            util::HashCombine(h, hasher(entry.serialized_computation)));
+        return util::HashReduce(util::HashCombine(h, entry.fingerprint));
       }
     };
 
-    CompilationCacheKey(std::string domain, std::string serialized_computation)
-        : domain(std::move(domain)),
-          serialized_computation(std::move(serialized_computation)) {}
+    CompilationCacheKey(std::string domain,
+                        const std::string& serialized_computation);
     CompilationCacheKey() = default;
     CompilationCacheKey(CompilationCacheKey&&) = default;
     CompilationCacheKey& operator=(CompilationCacheKey&&) = default;
     bool operator==(const CompilationCacheKey& rhs) const {
-      return domain == rhs.domain &&
-             serialized_computation == rhs.serialized_computation;
+      return domain == rhs.domain && fingerprint == rhs.fingerprint &&
+             size == rhs.size;
     }
 
     std::string domain;
-    std::string serialized_computation;
+    hash_t fingerprint;
+    size_t size = 0;
   };
 
   // When we split a batch operation into per-session batches, we use this data
@@ -282,6 +284,14 @@ class XrtComputationClient : public ComputationClient,
   std::vector<DataPtr> TransferToServerInternal(
       XrtDevice* device_ptr, absl::Span<const TensorSource> tensors);
 
+  std::vector<Literal> TransferFromServerInternal(
+      absl::Span<const DataPtr> handles);
+
+  // Reads a tensor larger than XRT_TRANSFER_CHUNK_BYTES in chunks of its major
+  // dimension, sliced on the device, with at most XRT_TRANSFER_CHUNKS_IN_FLIGHT
+  // of them being transferred at any time.
+  Literal TransferFromServerChunked(const DataPtr& handle, int64 chunk_size);
+
   // Retrieves the worker,worker_host pair for a given S4TF device (ie,
   // TPU:0).
   std::pair<Worker, std::string> GetWorkerForDevice(
@@ -299,9 +309,19 @@ class XrtComputationClient : public ComputationClient,
                       metrics::Metric* timed_metric,
                       metrics::Counter* destroy_counter);
 
+  // Queues the handle for release. The releaser runs right away when no
+  // execution is in flight, and otherwise once XLA_RELEASE_BATCH_SIZE handles
+  // are pending or the oldest one has waited XLA_RELEASE_MAX_DELAY_MS. Above
+  // XLA_RELEASE_BACKPRESSURE_HANDLES pending handles, the caller blocks until
+  // the releaser ran.
   void ReleaseHandle(int64 handle, const std::string& device,
                      std::vector<DeviceHandle>* handles);
 
+  // Marks an execution as in flight until the returned cleanup goes away, at
+  // which point the pending handles get released if no other execution is
+  // still running.
+  util::ExceptionCleanup TrackExecution();
+
   void ReleaseXrtData(const std::string& device, int64 handle);
 
   void ReleaseXrtComputation(const std::string& compilation_device,
@@ -463,8 +483,11 @@ class XrtComputationClient : public ComputationClient,
   static std::vector<std::vector<DataPtr>> BuildParallelArguments(
       absl::Span<const DataPtr> arguments);
 
-  static std::vector<size_t> PartitionTransferToServer(
-      absl::Span<const TensorSource> tensors);
+  // Spreads the tensors over byte balanced partitions, each below
+  // max_partition_size bytes unless made of a single larger tensor, and
+  // returns the tensor indices of every partition.
+  static std::vector<std::vector<size_t>> PartitionTransferToServer(
+      absl::Span<const TensorSource> tensors, int64 max_partition_size);
 
   // Extracts the XlaComputation pointers out of Computation ones. Used to be
   // passed to xrt_util::CheckComputationStatus() for its error reporting.
@@ -480,7 +503,9 @@ class XrtComputationClient : public ComputationClient,
   static std::string GetLocalTarget(const Options& options);
 
   // Checks whether a local GRPC service is required, and starts it if need it.
-  static void MaybeCreateLocalService(const Options& options);
+  // Unless XRT_IN_PROCESS_SESSIONS is disabled, the sessions to the local
+  // worker then reach the service in process.
+  void MaybeCreateLocalService(const Options& options);
 
   Options options_;
   std::mutex lock_;
@@ -495,9 +520,14 @@ class XrtComputationClient : public ComputationClient,
   // XRT thread safety semantics.
   std::vector<DeviceHandle> released_data_handles_;
   std::vector<DeviceHandle> released_compile_handles_;
+  int64 oldest_release_ns_ = 0;
+  std::atomic<size_t> executions_in_flight_{0};
   // The mesh service which is used to coordinate all the client hosts which are
   // feeding different TPU devices in a POD (or slice) training.
   std::unique_ptr<service::MeshService> mesh_service_;
+  // The relay forwarding the rendezvous of the processes of this host to the
+  // mesh service.
+  std::unique_ptr<service::MeshService> mesh_relay_;
 };
 
 }  // namespace xla
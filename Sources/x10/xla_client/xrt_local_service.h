@@ -47,6 +47,11 @@ class XrtLocalService {
   // Starts the service.
   void Start();
 
+  // The target the sessions of this process reach the service with. The
+  // sessions created with it find the master of the service in process, and
+  // skip the gRPC serialization of their requests.
+  std::string target() const { return server_->target(); }
+
  private:
   std::unique_ptr<tensorflow::ServerInterface> server_;
 };
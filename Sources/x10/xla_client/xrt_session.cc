@@ -14,24 +14,33 @@
 
 #include "tensorflow/compiler/xla/xla_client/xrt_session.h"
 
-#include "absl/strings/str_cat.h"
-
 namespace xla {
 
 XrtSession::XrtSession(const tensorflow::SessionOptions& session_options)
-    : target_(session_options.target),
+    : XrtSession(session_options.target, session_options) {}
+
+XrtSession::XrtSession(std::string target,
+                       const tensorflow::SessionOptions& session_options)
+    : target_(std::move(target)),
       root_(tensorflow::Scope::NewRootScope()),
       session_(root_, session_options) {}
 
-void XrtSession::Reset() {
-  for (auto& name_cache : node_cache_) {
-    name_cache.second.Rewind();
+const tensorflow::Scope& XrtSession::GetDeviceScope(
+    const std::string& xrt_device) {
+  auto it = device_scopes_.find(xrt_device);
+  if (it == device_scopes_.end()) {
+    it = device_scopes_.emplace(xrt_device, root_.WithDevice(xrt_device))
+             .first;
   }
+  return it->second;
 }
 
-std::string XrtSession::GetCacheKey(const std::string& op_name,
-                                    const std::string& device) {
-  return absl::StrCat(op_name, ";", device);
+void XrtSession::Reset() {
+  for (auto& op_caches : node_cache_) {
+    for (auto& device_cache : op_caches.second) {
+      device_cache.second.Rewind();
+    }
+  }
 }
 
 }  // namespace xla
@@ -91,24 +91,37 @@ class XrtSession {
 
   explicit XrtSession(const tensorflow::SessionOptions& session_options);
 
+  // Creates a session known as target, which connects to the one within the
+  // session options.
+  XrtSession(std::string target,
+             const tensorflow::SessionOptions& session_options);
+
   const std::string& target() const { return target_; }
 
   tensorflow::Scope* root() { return &root_; }
 
   tensorflow::ClientSession* session() { return &session_; }
 
-  NodeCache* GetNodeCache(const std::string& key) { return &node_cache_[key]; }
+  // Returns the cache of the nodes built for the op on the given device. The
+  // caches are keyed in two levels, so that lookups do not need to build a
+  // combined key string on every call.
+  NodeCache* GetNodeCache(const std::string& op_name,
+                          const std::string& device) {
+    return &node_cache_[op_name][device];
+  }
 
-  void Reset();
+  // Returns the scope placing nodes on the given XRT device. The scope is
+  // created on first use, and reused by all the nodes built for the device.
+  const tensorflow::Scope& GetDeviceScope(const std::string& xrt_device);
 
-  static std::string GetCacheKey(const std::string& op_name,
-                                 const std::string& device);
+  void Reset();
 
  private:
   std::string target_;
   tensorflow::Scope root_;
   tensorflow::ClientSession session_;
-  std::map<std::string, NodeCache> node_cache_;
+  std::map<std::string, std::map<std::string, NodeCache>> node_cache_;
+  std::map<std::string, tensorflow::Scope> device_scopes_;
 };
 
 }  // namespace xla
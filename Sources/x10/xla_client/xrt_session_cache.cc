@@ -14,8 +14,12 @@
 
 #include "tensorflow/compiler/xla/xla_client/xrt_session_cache.h"
 
+#include <algorithm>
+
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
 namespace xla {
 
@@ -27,14 +31,30 @@ XrtSessionCache::XrtSessionCache(tensorflow::ConfigProto config,
       local_target_(std::move(local_target)) {}
 
 XrtSessionCache::Ref XrtSessionCache::GetSession(const std::string& target) {
-  std::lock_guard<std::mutex> lock(lock_);
-  auto& session_queue = session_map_[target];
-  if (!session_queue.empty()) {
-    std::shared_ptr<XrtSession> session = std::move(session_queue.back());
-    session_queue.pop_back();
-    session->Reset();
-    return Ref(this, std::move(session));
+  if (UseThreadAffinity()) {
+    std::vector<AffineSession>* affine_sessions = GetAffineSessions();
+    for (auto it = affine_sessions->begin(); it != affine_sessions->end();
+         ++it) {
+      if (it->cache == this && it->session->target() == target) {
+        std::shared_ptr<XrtSession> session = std::move(it->session);
+        affine_sessions->erase(it);
+        XLA_COUNTER("XrtSessionAffinityHit", 1);
+        session->Reset();
+        return Ref(this, std::move(session));
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto& session_queue = session_map_[target];
+    if (!session_queue.empty()) {
+      std::shared_ptr<XrtSession> session = std::move(session_queue.back());
+      session_queue.pop_back();
+      session->Reset();
+      return Ref(this, std::move(session));
+    }
   }
+  XLA_COUNTER("XrtSessionCacheMiss", 1);
   return Ref(this, CreateSession(target));
 }
 
@@ -48,10 +68,70 @@ XrtSession* XrtSessionCache::GetSession(const std::string& target,
 }
 
 void XrtSessionCache::AddSession(std::shared_ptr<XrtSession> session) {
+  if (UseThreadAffinity()) {
+    std::vector<AffineSession>* affine_sessions = GetAffineSessions();
+    auto it = std::find_if(affine_sessions->begin(), affine_sessions->end(),
+                           [&](const AffineSession& affine_session) {
+                             return affine_session.cache == this &&
+                                    affine_session.session->target() ==
+                                        session->target();
+                           });
+    if (it == affine_sessions->end()) {
+      affine_sessions->push_back({this, std::move(session)});
+      return;
+    }
+  }
+  AddSharedSession(std::move(session));
+}
+
+void XrtSessionCache::AddSharedSession(std::shared_ptr<XrtSession> session) {
   std::lock_guard<std::mutex> lock(lock_);
   session_map_[session->target()].push_back(std::move(session));
 }
 
+void XrtSessionCache::Prewarm(const std::string& target, size_t count) {
+  size_t num_sessions = 0;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    size_t cached = session_map_[target].size();
+    num_sessions = count > cached ? count - cached : 0;
+  }
+  std::vector<std::shared_ptr<XrtSession>> sessions(num_sessions);
+  util::MultiWait mwait(num_sessions);
+  for (size_t i = 0; i < num_sessions; ++i) {
+    auto create_fn = [&, i]() { sessions[i] = CreateSession(target); };
+    env::ScheduleIoClosure(mwait.Completer(std::move(create_fn)));
+  }
+  mwait.Wait();
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto& session : sessions) {
+    session_map_[target].push_back(std::move(session));
+  }
+}
+
+XrtSessionCache::AffineSessions::~AffineSessions() {
+  for (auto& affine_session : sessions) {
+    affine_session.cache->AddSharedSession(std::move(affine_session.session));
+  }
+}
+
+std::vector<XrtSessionCache::AffineSession>*
+XrtSessionCache::GetAffineSessions() {
+  static thread_local AffineSessions affine_sessions;
+  return &affine_sessions.sessions;
+}
+
+bool XrtSessionCache::UseThreadAffinity() {
+  static const bool use_thread_affinity =
+      sys_util::GetEnvBool("XRT_SESSION_THREAD_AFFINITY", true);
+  return use_thread_affinity;
+}
+
+void XrtSessionCache::SetInProcessTarget(const std::string& target,
+                                         std::string in_process_target) {
+  in_process_targets_[target] = std::move(in_process_target);
+}
+
 std::shared_ptr<XrtSession> XrtSessionCache::CreateSession(
     const std::string& target) const {
   XLA_COUNTER("XrtSessionCount", 1);
@@ -75,8 +155,17 @@ std::shared_ptr<XrtSession> XrtSessionCache::CreateSession(
   bool multi_stream = sys_util::GetEnvBool("XRT_GRPC_MULTISTREAM", true);
   rpc_options->set_disable_session_connection_sharing(multi_stream);
 
+  auto it = in_process_targets_.find(target);
+  if (it != in_process_targets_.end()) {
+    // The master of an in-process server is looked up by the server target,
+    // and it runs the steps on its own worker directly, handing the feeds and
+    // fetches over as tensors instead of serialized protos.
+    session_options.target = it->second;
+    rpc_options->set_use_rpc_for_inprocess_master(false);
+    XLA_COUNTER("XrtInProcessSessionCount", 1);
+  }
   std::shared_ptr<XrtSession> session =
-      std::make_shared<XrtSession>(session_options);
+      std::make_shared<XrtSession>(target, session_options);
   if (initfn_ != nullptr) {
     initfn_(session.get());
   }
@@ -24,6 +24,7 @@
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/compiler/xla/xla_client/xrt_session.h"
 #include "tensorflow/compiler/xla/types.h"
@@ -31,7 +32,9 @@
 namespace xla {
 
 // Caches XrtSession objects. The XrtSession objects handed out by this class
-// will be at exclusive use of the caller.
+// will be at exclusive use of the caller. Unless XRT_SESSION_THREAD_AFFINITY is
+// disabled, every thread keeps the last session it returned for each target,
+// and gets it back on its next request without going through the shared pool.
 class XrtSessionCache {
  public:
   // A reference to an existing XrtSession. Its destructor will return it to the
@@ -100,12 +103,42 @@ class XrtSessionCache {
 
   void AddSession(std::shared_ptr<XrtSession> session);
 
+  // Creates sessions for target, concurrently, until the shared pool holds at
+  // least count of them.
+  void Prewarm(const std::string& target, size_t count);
+
+  // Makes the sessions for target connect to in_process_target, the target of
+  // a server running within this process. Must be called before any session
+  // for target gets created.
+  void SetInProcessTarget(const std::string& target,
+                          std::string in_process_target);
+
  private:
+  struct AffineSession {
+    XrtSessionCache* cache = nullptr;
+    std::shared_ptr<XrtSession> session;
+  };
+
+  // The sessions held by the current thread, which go back to the shared pools
+  // of their caches when the thread exits.
+  struct AffineSessions {
+    ~AffineSessions();
+
+    std::vector<AffineSession> sessions;
+  };
+
+  static std::vector<AffineSession>* GetAffineSessions();
+
+  void AddSharedSession(std::shared_ptr<XrtSession> session);
+
+  static bool UseThreadAffinity();
+
   std::shared_ptr<XrtSession> CreateSession(const std::string& target) const;
 
   tensorflow::ConfigProto config_;
   std::function<void(XrtSession*)> initfn_;
   std::string local_target_;
+  std::map<std::string, std::string> in_process_targets_;
   std::mutex lock_;
   std::map<std::string, std::deque<std::shared_ptr<XrtSession>>> session_map_;
 };
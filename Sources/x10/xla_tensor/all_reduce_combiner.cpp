@@ -0,0 +1,285 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/all_reduce_combiner.h"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_reduce.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+const ops::AllReduce* AsAllReduce(const Node* node) {
+  if (node->op() != *ops::xla_cross_replica_sum) {
+    return nullptr;
+  }
+  return dynamic_cast<const ops::AllReduce*>(node);
+}
+
+bool SameReduction(const ops::AllReduce* lhs, const ops::AllReduce* rhs) {
+  return lhs->reduce_type() == rhs->reduce_type() &&
+         lhs->scale() == rhs->scale() && lhs->groups() == rhs->groups() &&
+         lhs->options().wire_type == rhs->options().wire_type &&
+         lhs->options().wire_type_min_elements ==
+             rhs->options().wire_type_min_elements &&
+         lhs->options().host_groups == rhs->options().host_groups;
+}
+
+// A run of all-reduces which become a single one.
+struct Group {
+  std::vector<const ops::AllReduce*> members;
+  // The position within the post order of the first member. Nodes before it
+  // cannot depend on the group.
+  size_t first_position = 0;
+  NodePtr combined;
+};
+
+struct Member {
+  Group* group = nullptr;
+  // The position of the first result of the member among the results of the
+  // combined all-reduce.
+  size_t offset = 0;
+};
+
+class Combiner {
+ public:
+  explicit Combiner(absl::Span<const Node* const> post_order)
+      : post_order_(post_order) {
+    for (size_t i = 0; i < post_order_.size(); ++i) {
+      positions_.emplace(post_order_[i], i);
+    }
+  }
+
+  // Returns whether some groups have more than one member.
+  bool FindGroups() {
+    std::vector<std::unique_ptr<Group>> groups;
+    for (size_t i = 0; i < post_order_.size(); ++i) {
+      const ops::AllReduce* all_reduce = AsAllReduce(post_order_[i]);
+      if (all_reduce == nullptr) {
+        continue;
+      }
+      const Output& token = all_reduce->operands().back();
+      auto it = members_.find(token.node);
+      if (it != members_.end() &&
+          token.index + 1 == token.node->num_outputs() &&
+          SameReduction(it->second.group->members.front(), all_reduce) &&
+          !DependsOnGroup(all_reduce, *it->second.group)) {
+        Group* group = it->second.group;
+        members_.emplace(all_reduce, Member{group, 0});
+        group->members.push_back(all_reduce);
+        continue;
+      }
+      groups.push_back(std::make_unique<Group>());
+      groups.back()->members.push_back(all_reduce);
+      groups.back()->first_position = i;
+      members_.emplace(all_reduce, Member{groups.back().get(), 0});
+    }
+    bool combined = false;
+    for (auto& group : groups) {
+      if (group->members.size() > 1) {
+        size_t offset = 0;
+        for (const ops::AllReduce* member : group->members) {
+          members_.at(member).offset = offset;
+          offset += member->num_outputs() - 1;
+        }
+        combined = true;
+        XLA_COUNTER("CombinedAllReduces", group->members.size());
+        groups_.push_back(std::move(group));
+      } else {
+        members_.erase(group->members.front());
+      }
+    }
+    return combined;
+  }
+
+  // Returns the roots of the rewritten graph, or an empty vector if the groups
+  // cannot be combined.
+  std::vector<Value> Rewrite(absl::Span<const Value> roots) {
+    std::vector<const Node*> order;
+    if (!ComputeRewriteOrder(roots, &order)) {
+      XLA_COUNTER("AllReduceCombineLoops", 1);
+      return {};
+    }
+    for (const Node* node : order) {
+      auto member_it = members_.find(node);
+      if (member_it != members_.end()) {
+        Group* group = member_it->second.group;
+        if (group->combined == nullptr) {
+          group->combined = MakeCombined(*group);
+        }
+        continue;
+      }
+      std::vector<Value> operands;
+      bool changed = false;
+      for (size_t i = 0; i < node->operands().size(); ++i) {
+        operands.push_back(MapOperand(node, i));
+        changed = changed || operands.back().node != node->operand_nodes()[i];
+      }
+      if (changed) {
+        rewritten_.emplace(node, node->Clone(operands));
+      }
+    }
+    std::vector<Value> new_roots;
+    for (const Value& root : roots) {
+      new_roots.push_back(MapOutput(root.node, root.index));
+    }
+    return new_roots;
+  }
+
+ private:
+  // Whether the data operands of all_reduce read any output of the group,
+  // including the token, through other nodes.
+  bool DependsOnGroup(const ops::AllReduce* all_reduce, const Group& group) {
+    std::vector<const Node*> stack;
+    std::unordered_set<const Node*> visited;
+    for (size_t i = 0; i + 1 < all_reduce->operands().size(); ++i) {
+      stack.push_back(all_reduce->operand(i).node);
+    }
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+      if (!visited.insert(node).second ||
+          positions_.at(node) < group.first_position) {
+        continue;
+      }
+      auto it = members_.find(node);
+      if (it != members_.end() && it->second.group == &group) {
+        return true;
+      }
+      for (const Output& operand : node->operands()) {
+        stack.push_back(operand.node);
+      }
+    }
+    return false;
+  }
+
+  // The operands a node waits on in the rewritten graph: the members of a
+  // group wait on the data operands of all the members, and on the token of
+  // the first one.
+  std::vector<const Node*> RewriteOperands(const Node* node) {
+    std::vector<const Node*> operands;
+    auto it = members_.find(node);
+    if (it == members_.end()) {
+      for (const Output& operand : node->operands()) {
+        operands.push_back(operand.node);
+      }
+      return operands;
+    }
+    const Group& group = *it->second.group;
+    for (const ops::AllReduce* member : group.members) {
+      for (size_t i = 0; i + 1 < member->operands().size(); ++i) {
+        operands.push_back(member->operand(i).node);
+      }
+    }
+    operands.push_back(group.members.front()->operands().back().node);
+    return operands;
+  }
+
+  // A post order of the rewritten graph, in terms of the original nodes.
+  // Returns false if the rewritten graph has a loop, which happens when two
+  // groups each read the outputs of the other.
+  bool ComputeRewriteOrder(absl::Span<const Value> roots,
+                           std::vector<const Node*>* order) {
+    std::unordered_map<const Node*, Util::EmitStatus> status;
+    std::vector<std::pair<const Node*, bool>> stack;
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+      stack.emplace_back(it->node.get(), false);
+    }
+    while (!stack.empty()) {
+      const Node* node = stack.back().first;
+      bool expanded = stack.back().second;
+      stack.pop_back();
+      Util::EmitStatus& node_status = status[node];
+      if (expanded) {
+        node_status = Util::kEmitted;
+        order->push_back(node);
+        continue;
+      }
+      if (node_status == Util::kEmitted) {
+        continue;
+      }
+      if (node_status == Util::kEmitting) {
+        return false;
+      }
+      node_status = Util::kEmitting;
+      stack.emplace_back(node, true);
+      std::vector<const Node*> operands = RewriteOperands(node);
+      for (auto it = operands.rbegin(); it != operands.rend(); ++it) {
+        stack.emplace_back(*it, false);
+      }
+    }
+    return true;
+  }
+
+  NodePtr MakeCombined(const Group& group) {
+    std::vector<Value> inputs;
+    for (const ops::AllReduce* member : group.members) {
+      for (size_t i = 0; i + 1 < member->operands().size(); ++i) {
+        inputs.push_back(MapOperand(member, i));
+      }
+    }
+    const ops::AllReduce* first = group.members.front();
+    return MakeNode<ops::AllReduce>(
+        first->reduce_type(), inputs,
+        MapOperand(first, first->operands().size() - 1), first->scale(),
+        first->groups(), first->options());
+  }
+
+  Value MapOperand(const Node* node, size_t i) {
+    return MapOutput(node->operand_nodes()[i], node->operand(i).index);
+  }
+
+  Value MapOutput(const NodePtr& node, size_t index) {
+    auto member_it = members_.find(node.get());
+    if (member_it != members_.end()) {
+      const Member& member = member_it->second;
+      XLA_CHECK(member.group->combined != nullptr);
+      if (index + 1 == node->num_outputs()) {
+        return Value(member.group->combined,
+                     member.group->combined->num_outputs() - 1);
+      }
+      return Value(member.group->combined, member.offset + index);
+    }
+    auto it = rewritten_.find(node.get());
+    return Value(it != rewritten_.end() ? it->second : node, index);
+  }
+
+  absl::Span<const Node* const> post_order_;
+  std::unordered_map<const Node*, size_t> positions_;
+  std::unordered_map<const Node*, Member> members_;
+  std::vector<std::unique_ptr<Group>> groups_;
+  std::unordered_map<const Node*, NodePtr> rewritten_;
+};
+
+}  // namespace
+
+std::vector<Value> CombineIndependentAllReduces(
+    absl::Span<const Value> roots, absl::Span<const Node* const> post_order) {
+  Combiner combiner(post_order);
+  if (!combiner.FindGroups()) {
+    return {};
+  }
+  return combiner.Rewrite(roots);
+}
+
+}  // namespace ir
+}  // namespace swift_xla
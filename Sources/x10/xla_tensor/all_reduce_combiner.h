@@ -0,0 +1,41 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+
+// The all-reduces of a graph are chained by their tokens in issue order, even
+// when they reduce unrelated tensors, which keeps XLA from merging or
+// overlapping them. Within a single graph every replica runs the same program,
+// so the chain is only needed between collectives whose data depends on each
+// other. Finds the runs of all-reduces with the same reduction and replica
+// groups where every one waits on the token of the previous one, and reads no
+// output of the previous ones, and returns the roots of a copy of the graph in
+// which every such run is a single all-reduce. The collectives which have real
+// ordering needs, and the other collectives, keep their token chain. Returns
+// an empty vector if the graph has no such runs.
+std::vector<Value> CombineIndependentAllReduces(
+    absl::Span<const Value> roots, absl::Span<const Node* const> post_order);
+
+}  // namespace ir
+}  // namespace swift_xla
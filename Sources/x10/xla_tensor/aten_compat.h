@@ -550,6 +550,7 @@
   _(aten, ones_like)                                        \
   _(aten, orgqr)                                            \
   _(aten, ormqr)                                            \
+  _(aten, outlined_call)                                    \
   _(aten, pairwise_distance)                                \
   _(aten, pdist)                                            \
   _(aten, placeholder)                                      \
@@ -566,6 +567,7 @@
   _(aten, prod)                                             \
   _(aten, put)                                              \
   _(aten, qr)                                               \
+  _(aten, quantized_matmul)                                 \
   _(aten, rand)                                             \
   _(aten, rand_like)                                        \
   _(aten, randint)                                          \
@@ -677,9 +679,11 @@
   _(aten, tf_convolution)                                   \
   _(aten, tf_conv_backprop_filter)                          \
   _(aten, tf_conv_backprop_input)                           \
+  _(aten, tf_conv_bias_activation)                          \
   _(aten, tf_mirror_pad)                                    \
   _(aten, tf_mirror_pad_backward)                           \
   _(aten, tf_one_hot)                                       \
+  _(aten, tf_quantized_convolution)                         \
   _(aten, tf_stateless_random_normal)                       \
   _(aten, tf_stateless_random_uniform)                      \
   _(aten, tf_unsorted_segment_sum)                          \
@@ -758,6 +762,8 @@
   _(aten, xla_avg_pool_grad)                                \
   _(aten, xla_dynamic_update_slice)                         \
   _(aten, xla_dynamic_slice)                                \
+  _(aten, xla_remove_dynamic_dimension)                     \
+  _(aten, xla_set_dimension_bound)                          \
   _(aten, xla_max_pool)                                     \
   _(aten, xla_max_pool_grad)                                \
   _(aten, xla_pad)                                          \
@@ -767,27 +773,52 @@
   _(aten, xla_truncated_normal)                             \
   _(aten, xla_is_finite)                                    \
   _(aten, xla_is_inf)                                       \
-  _(aten, xla_is_nan)
-
-#define FORALL_XLA_SYMBOLS(_, __)  \
-  __(xla, all_to_all)              \
-  _(xla, as_strided_view_update)   \
-  _(xla, cast)                     \
-  _(xla, collective_permute)       \
-  _(xla, cross_replica_sum)        \
-  _(xla, device_data)              \
-  _(xla, diagonal_view_update)     \
-  _(xla, generic_slice)            \
-  _(xla, get_dimensions_size)      \
-  _(xla, moving_average)           \
-  _(xla, nms)                      \
-  _(xla, not_supported)            \
-  _(xla, replication_pad)          \
-  _(xla, replication_pad_backward) \
-  _(xla, select)                   \
-  _(xla, tensor_data)              \
-  _(xla, token)                    \
-  _(xla, unselect)                 \
+  _(aten, xla_is_nan)                                       \
+  _(aten, xla_all_finite)
+
+#define FORALL_XLA_SYMBOLS(_, __)               \
+  __(xla, all_to_all)                           \
+  _(xla, adam_update)                           \
+  _(xla, all_gather)                            \
+  _(xla, as_strided_view_update)                \
+  _(xla, cast)                                  \
+  _(xla, collective_permute)                    \
+  _(xla, cross_replica_sum)                     \
+  _(xla, device_data)                           \
+  _(xla, diagonal_view_update)                  \
+  _(xla, embedding_bag)                         \
+  _(xla, embedding_bag_backward)                \
+  _(xla, fused_batch_norm)                      \
+  _(xla, fused_batch_norm_backward)             \
+  _(xla, generic_slice)                         \
+  _(xla, get_dimensions_size)                   \
+  _(xla, layer_norm)                            \
+  _(xla, layer_norm_backward)                   \
+  _(xla, loss_scale_update)                     \
+  _(xla, moments)                               \
+  _(xla, moving_average)                        \
+  _(xla, nms)                                   \
+  _(xla, not_supported)                         \
+  _(xla, reduce_scatter)                        \
+  _(xla, remat_barrier)                         \
+  _(xla, replication_pad)                       \
+  _(xla, replication_pad_backward)              \
+  _(xla, resize_bilinear)                       \
+  _(xla, resize_bilinear_backward)              \
+  _(xla, rms_norm)                              \
+  _(xla, rms_norm_backward)                     \
+  _(xla, rng_normal)                            \
+  _(xla, rng_uniform)                           \
+  _(xla, scaled_dot_product_attention)          \
+  _(xla, scaled_dot_product_attention_backward) \
+  _(xla, select)                                \
+  _(xla, sgd_update)                            \
+  _(xla, sharded_adam_update)                   \
+  _(xla, sharding)                              \
+  _(xla, softmax_cross_entropy)                 \
+  _(xla, tensor_data)                           \
+  _(xla, token)                                 \
+  _(xla, unselect)                              \
   _(xla, update_slice)
 
 namespace at {
@@ -1064,6 +1095,31 @@ class NonOwnedAnyScalarBuffer : public AnyScalarBuffer {
   }
 };
 
+// Implementation of Scalar buffer backed by a data buffer borrowed from the
+// caller, which is handed back through release(context) on destruction.
+template <typename T>
+class ReleasingAnyScalarBuffer : public AnyScalarBuffer {
+ public:
+  ReleasingAnyScalarBuffer(const T* data, size_t len, void (*release)(void*),
+                           void* context)
+      : AnyScalarBuffer(internal::GetScalarType<T>()),
+        release_(release),
+        context_(context) {
+    set_base(data);
+    set_size(len);
+  }
+
+  ~ReleasingAnyScalarBuffer() override {
+    if (release_ != nullptr) {
+      release_(context_);
+    }
+  }
+
+ private:
+  void (*release_)(void*);
+  void* context_;
+};
+
 template <typename T>
 std::unique_ptr<AnyScalarBuffer> AnyScalarBuffer::make(
     std::unique_ptr<T[]> data, size_t len) {
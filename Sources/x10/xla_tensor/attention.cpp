@@ -0,0 +1,282 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/attention.h"
+
+#include <numeric>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace {
+
+constexpr xla::PrimitiveType kIndexType = xla::PrimitiveType::S32;
+
+// Contracts lhs_dim of lhs with rhs_dim of rhs, batching over all but the last
+// two dimensions of both.
+xla::XlaOp BatchDot(xla::XlaOp lhs, xla::int64 lhs_dim, xla::XlaOp rhs,
+                    xla::int64 rhs_dim) {
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(lhs).rank();
+  xla::DotDimensionNumbers dims;
+  for (xla::int64 i = 0; i < rank - 2; ++i) {
+    dims.add_lhs_batch_dimensions(i);
+    dims.add_rhs_batch_dimensions(i);
+  }
+  dims.add_lhs_contracting_dimensions(lhs_dim);
+  dims.add_rhs_contracting_dimensions(rhs_dim);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::DotGeneral(lhs, rhs, dims, &precision_config);
+}
+
+// The dimensions along which the [..., S] row values get broadcast to the
+// [..., S, N] block values.
+std::vector<xla::int64> RowDimensions(xla::int64 rank) {
+  std::vector<xla::int64> dims(rank - 1);
+  std::iota(dims.begin(), dims.end(), 0);
+  return dims;
+}
+
+xla::int64 EffectiveBlockSize(xla::int64 key_length, xla::int64 block_size) {
+  return block_size > 0 && key_length % block_size == 0 ? block_size
+                                                        : key_length;
+}
+
+// Slices the block_size rows, starting at start, from the second minor
+// dimension of input.
+xla::XlaOp SliceBlock(xla::XlaOp input, xla::XlaOp start,
+                      xla::int64 block_size) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  std::vector<xla::XlaOp> starts(shape.rank(),
+                                 xla::Zero(input.builder(), kIndexType));
+  starts[shape.rank() - 2] = start;
+  std::vector<xla::int64> sizes(shape.dimensions().begin(),
+                                shape.dimensions().end());
+  sizes[shape.rank() - 2] = block_size;
+  return xla::DynamicSlice(input, starts, sizes);
+}
+
+xla::XlaOp UpdateBlock(xla::XlaOp input, xla::XlaOp update, xla::XlaOp start) {
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(input).rank();
+  std::vector<xla::XlaOp> starts(rank, xla::Zero(input.builder(), kIndexType));
+  starts[rank - 2] = start;
+  return xla::DynamicUpdateSlice(input, update, starts);
+}
+
+// Computes the scaled, and optionally masked, [..., S, N] scores of the query
+// against the key block starting at start. The valid_length mask is skipped if
+// it is not a valid op.
+xla::XlaOp BlockScores(xla::XlaOp query, xla::XlaOp key_block,
+                       xla::XlaOp start, double scale, bool causal,
+                       xla::XlaOp valid_length = xla::XlaOp()) {
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(query).rank();
+  xla::XlaOp scores = BatchDot(query, rank - 1, key_block, rank - 1);
+  const xla::Shape& scores_shape = XlaHelpers::ShapeOfXlaOp(scores);
+  xla::XlaBuilder* builder = query.builder();
+  scores = xla::Mul(scores, XlaHelpers::ScalarValue<double>(
+                                scale, scores_shape.element_type(), builder));
+  if (!causal && !valid_length.valid()) {
+    return scores;
+  }
+  xla::Shape index_shape =
+      xla::ShapeUtil::ChangeElementType(scores_shape, kIndexType);
+  xla::XlaOp columns = xla::Add(xla::Iota(builder, index_shape, rank - 1),
+                                start);
+  xla::XlaOp masked = xla::Broadcast(
+      xla::MinValue(builder, scores_shape.element_type()),
+      scores_shape.dimensions());
+  if (causal) {
+    xla::XlaOp rows = xla::Iota(builder, index_shape, rank - 2);
+    scores = xla::Select(xla::Gt(columns, rows), masked, scores);
+  }
+  if (valid_length.valid()) {
+    scores = xla::Select(xla::Ge(columns, valid_length), masked, scores);
+  }
+  return scores;
+}
+
+xla::XlaOp RowReduce(xla::XlaOp input, bool max) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaBuilder* builder = input.builder();
+  return max ? xla::Reduce(input, xla::MinValue(builder, shape.element_type()),
+                           XlaHelpers::CreateMaxComputation(
+                               shape.element_type()),
+                           {shape.rank() - 1})
+             : xla::Reduce(input, xla::Zero(builder, shape.element_type()),
+                           XlaHelpers::CreateAddComputation(
+                               shape.element_type()),
+                           {shape.rank() - 1});
+}
+
+}  // namespace
+
+xla::PrimitiveType AttentionComputeType(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+AttentionResult BuildScaledDotProductAttention(xla::XlaOp query, xla::XlaOp key,
+                                               xla::XlaOp value, double scale,
+                                               bool causal,
+                                               xla::int64 block_size,
+                                               xla::XlaOp valid_length) {
+  const xla::Shape& query_shape = XlaHelpers::ShapeOfXlaOp(query);
+  const xla::Shape& key_shape = XlaHelpers::ShapeOfXlaOp(key);
+  const xla::Shape& value_shape = XlaHelpers::ShapeOfXlaOp(value);
+  xla::int64 rank = query_shape.rank();
+  XLA_CHECK_GE(rank, 2) << query_shape;
+  XLA_CHECK_EQ(key_shape.rank(), rank) << key_shape;
+  XLA_CHECK_EQ(value_shape.rank(), rank) << value_shape;
+  xla::int64 key_length = key_shape.dimensions(rank - 2);
+  block_size = EffectiveBlockSize(key_length, block_size);
+  xla::PrimitiveType type = query_shape.element_type();
+  xla::PrimitiveType compute_type = AttentionComputeType(type);
+  xla::XlaBuilder* builder = query.builder();
+
+  std::vector<xla::int64> row_sizes(query_shape.dimensions().begin(),
+                                    query_shape.dimensions().end() - 1);
+  std::vector<xla::int64> output_sizes(row_sizes);
+  output_sizes.push_back(value_shape.dimensions(rank - 1));
+  // The running row maximum starts at the lowest finite value, rather than at
+  // -inf, so that masked out scores never compute -inf - -inf.
+  std::vector<xla::XlaOp> initial_values = {
+      xla::ConvertElementType(query, compute_type),
+      xla::ConvertElementType(key, compute_type),
+      xla::ConvertElementType(value, compute_type),
+      xla::Broadcast(xla::MinFiniteValue(builder, compute_type), row_sizes),
+      xla::Broadcast(xla::Zero(builder, compute_type), row_sizes),
+      xla::Broadcast(xla::Zero(builder, compute_type), output_sizes)};
+  // The valid length is threaded through the loop state, after the
+  // accumulators, as the body cannot capture ops of the outer computation.
+  if (valid_length.valid()) {
+    initial_values.push_back(
+        xla::ConvertElementType(valid_length, kIndexType));
+  }
+
+  auto body_fn = [&](xla::XlaOp index, absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp start = xla::Mul(
+        index, XlaHelpers::ScalarValue(block_size, kIndexType, body_builder));
+    xla::XlaOp key_block = SliceBlock(values[1], start, block_size);
+    xla::XlaOp value_block = SliceBlock(values[2], start, block_size);
+    xla::XlaOp body_valid_length =
+        values.size() > 6 ? values[6] : xla::XlaOp();
+    xla::XlaOp scores = BlockScores(values[0], key_block, start, scale, causal,
+                                    body_valid_length);
+    std::vector<xla::int64> row_dims = RowDimensions(rank);
+    xla::XlaOp max = xla::Max(values[3], RowReduce(scores, /*max=*/true));
+    xla::XlaOp probs = xla::Exp(xla::Sub(scores, max, row_dims));
+    xla::XlaOp correction = xla::Exp(xla::Sub(values[3], max));
+    xla::XlaOp sum = xla::Add(xla::Mul(values[4], correction),
+                              RowReduce(probs, /*max=*/false));
+    xla::XlaOp accumulator =
+        xla::Add(xla::Mul(values[5], correction, row_dims),
+                 BatchDot(probs, rank - 1, value_block, rank - 2));
+    std::vector<xla::XlaOp> results = {values[0], values[1], values[2],
+                                       max,       sum,       accumulator};
+    if (body_valid_length.valid()) {
+      results.push_back(body_valid_length);
+    }
+    return results;
+  };
+  std::vector<xla::XlaOp> results = ConsumeValue(xla::ForEachIndex(
+      key_length / block_size, kIndexType, body_fn, initial_values,
+      "ScaledDotProductAttention", builder));
+  xla::XlaOp output = xla::Div(results[5], results[4], RowDimensions(rank));
+  return {xla::ConvertElementType(output, type),
+          xla::Add(results[3], xla::Log(results[4]))};
+}
+
+std::vector<xla::XlaOp> BuildScaledDotProductAttentionBackward(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, double scale, bool causal,
+    xla::int64 block_size) {
+  const xla::Shape& query_shape = XlaHelpers::ShapeOfXlaOp(query);
+  const xla::Shape& key_shape = XlaHelpers::ShapeOfXlaOp(key);
+  const xla::Shape& value_shape = XlaHelpers::ShapeOfXlaOp(value);
+  xla::int64 rank = query_shape.rank();
+  xla::int64 key_length = key_shape.dimensions(rank - 2);
+  block_size = EffectiveBlockSize(key_length, block_size);
+  xla::PrimitiveType compute_type =
+      AttentionComputeType(query_shape.element_type());
+  xla::XlaBuilder* builder = query.builder();
+
+  xla::XlaOp compute_grad_output =
+      xla::ConvertElementType(grad_output, compute_type);
+  // Row-wise sum of grad_output * output, which is the softmax gradient term
+  // shared by all the key blocks.
+  xla::XlaOp delta = RowReduce(
+      xla::Mul(compute_grad_output, xla::ConvertElementType(output,
+                                                            compute_type)),
+      /*max=*/false);
+  std::vector<xla::XlaOp> initial_values = {
+      xla::ConvertElementType(query, compute_type),
+      xla::ConvertElementType(key, compute_type),
+      xla::ConvertElementType(value, compute_type),
+      compute_grad_output,
+      logsumexp,
+      delta,
+      xla::Zeros(builder, xla::ShapeUtil::ChangeElementType(query_shape,
+                                                            compute_type)),
+      xla::Zeros(builder,
+                 xla::ShapeUtil::ChangeElementType(key_shape, compute_type)),
+      xla::Zeros(builder, xla::ShapeUtil::ChangeElementType(value_shape,
+                                                            compute_type))};
+
+  auto body_fn = [&](xla::XlaOp index, absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp start = xla::Mul(
+        index, XlaHelpers::ScalarValue(block_size, kIndexType, body_builder));
+    xla::XlaOp scale_value =
+        XlaHelpers::ScalarValue<double>(scale, compute_type, body_builder);
+    std::vector<xla::int64> row_dims = RowDimensions(rank);
+    xla::XlaOp key_block = SliceBlock(values[1], start, block_size);
+    xla::XlaOp value_block = SliceBlock(values[2], start, block_size);
+    xla::XlaOp scores = BlockScores(values[0], key_block, start, scale, causal);
+    xla::XlaOp probs = xla::Exp(xla::Sub(scores, values[4], row_dims));
+    xla::XlaOp grad_value_block =
+        BatchDot(probs, rank - 2, values[3], rank - 2);
+    xla::XlaOp grad_probs =
+        BatchDot(values[3], rank - 1, value_block, rank - 1);
+    xla::XlaOp grad_scores =
+        xla::Mul(probs, xla::Sub(grad_probs, values[5], row_dims));
+    xla::XlaOp grad_query =
+        xla::Add(values[6], xla::Mul(BatchDot(grad_scores, rank - 1, key_block,
+                                              rank - 2),
+                                     scale_value));
+    xla::XlaOp grad_key_block = xla::Mul(
+        BatchDot(grad_scores, rank - 2, values[0], rank - 2), scale_value);
+    return std::vector<xla::XlaOp>{
+        values[0],  values[1],
+        values[2],  values[3],
+        values[4],  values[5],
+        grad_query, UpdateBlock(values[7], grad_key_block, start),
+        UpdateBlock(values[8], grad_value_block, start)};
+  };
+  std::vector<xla::XlaOp> results = ConsumeValue(xla::ForEachIndex(
+      key_length / block_size, kIndexType, body_fn, initial_values,
+      "ScaledDotProductAttentionBackward", builder));
+  return {xla::ConvertElementType(results[6], query_shape.element_type()),
+          xla::ConvertElementType(results[7], key_shape.element_type()),
+          xla::ConvertElementType(results[8], value_shape.element_type())};
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+struct AttentionResult {
+  xla::XlaOp output;
+  // The log of the softmax denominators, [..., S], needed by the backward.
+  xla::XlaOp logsumexp;
+};
+
+// Computes softmax(query * key^T * scale) * value for query [..., S, D], key
+// [..., T, D] and value [..., T, Dv]. When causal is true, the key positions
+// past the query position are masked out. The keys are processed block_size at
+// a time with an online softmax, so that the [..., S, T] scores are never
+// materialized. A block_size which does not divide T uses a single block.
+// When valid_length, an S32 scalar, is given, the key positions at or past it
+// are masked out as well, as for the fixed capacity key and value caches of
+// autoregressive decoding.
+AttentionResult BuildScaledDotProductAttention(
+    xla::XlaOp query, xla::XlaOp key, xla::XlaOp value, double scale,
+    bool causal, xla::int64 block_size,
+    xla::XlaOp valid_length = xla::XlaOp());
+
+// Computes the gradients of query, key and value, blockwise as well, by
+// recomputing the attention probabilities from the forward logsumexp.
+std::vector<xla::XlaOp> BuildScaledDotProductAttentionBackward(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, double scale, bool causal,
+    xla::int64 block_size);
+
+// Returns the type the attention is computed with, for inputs of the given
+// type. Reduced precision inputs are computed in F32.
+xla::PrimitiveType AttentionComputeType(xla::PrimitiveType type);
+
+}  // namespace swift_xla
@@ -14,8 +14,12 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
 
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 
 namespace swift_xla {
 namespace {
@@ -29,6 +33,75 @@ xla::XlaOp VarianceRecover(xla::XlaOp invstd, float eps_value) {
   return one_over_invstd * one_over_invstd - eps;
 }
 
+// The dimensions of a rank sized shape, but feature_index.
+std::vector<xla::int64> ReductionDimensions(xla::int64 rank,
+                                            xla::int64 feature_index) {
+  std::vector<xla::int64> dims;
+  for (xla::int64 i = 0; i < rank; ++i) {
+    if (i != feature_index) {
+      dims.push_back(i);
+    }
+  }
+  return dims;
+}
+
+// Sums the given per feature rows across the replicas, all together in a
+// single all-reduce.
+std::vector<xla::XlaOp> SumRowsAcrossReplicas(
+    absl::Span<const xla::XlaOp> rows,
+    const std::vector<std::vector<xla::int64>>& replica_groups) {
+  xla::XlaBuilder* builder = rows.front().builder();
+  xla::int64 num_features =
+      XlaHelpers::ShapeOfXlaOp(rows.front()).dimensions(0);
+  std::vector<xla::XlaOp> packed_rows;
+  for (xla::XlaOp row : rows) {
+    packed_rows.push_back(xla::Reshape(row, {1, num_features}));
+  }
+  // The token only orders collectives across the graph, and this one has no
+  // other collective to be ordered with.
+  xla::XlaOp token = xla::Zero(builder, XlaHelpers::TypeOfXlaOp(rows.front()));
+  xla::XlaOp reduced =
+      BuildAllReduce(AllReduceType::kSum,
+                     {xla::ConcatInDim(builder, packed_rows, 0)}, token,
+                     /*scale=*/1.0, replica_groups)
+          .front();
+  std::vector<xla::XlaOp> results;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    results.push_back(xla::Reshape(
+        xla::SliceInDim(reduced, i, i + 1, /*stride=*/1, 0), {num_features}));
+  }
+  return results;
+}
+
+// Combines the replica statistics from their (count, count * mean,
+// m2 + count * mean^2) sums, which keep the Welford precision within a replica.
+BatchNormStatistics CrossReplicaStatistics(
+    const BatchNormStatistics& stats, xla::int64 count,
+    const std::vector<std::vector<xla::int64>>& replica_groups) {
+  const xla::Shape& mean_shape = XlaHelpers::ShapeOfXlaOp(stats.mean);
+  xla::XlaOp counts = XlaHelpers::ScalarBroadcast<double>(
+      count, mean_shape, stats.mean.builder());
+  xla::XlaOp sums = counts * stats.mean;
+  std::vector<xla::XlaOp> reduced = SumRowsAcrossReplicas(
+      {counts, sums, counts * stats.variance + sums * stats.mean},
+      replica_groups);
+  xla::XlaOp mean = reduced[1] / reduced[0];
+  return {mean, reduced[2] / reduced[0] - mean * mean};
+}
+
+BatchNormStatistics ComputeStatistics(xla::XlaOp input,
+                                      const FusedBatchNormOptions& options) {
+  BatchNormStatistics stats =
+      BuildWelfordStatistics(input, options.feature_index);
+  if (!options.cross_replica) {
+    return stats;
+  }
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::int64 count = xla::ShapeUtil::ElementsIn(input_shape) /
+                     input_shape.dimensions(options.feature_index);
+  return CrossReplicaStatistics(stats, count, options.replica_groups);
+}
+
 }  // namespace
 
 xla::XlaOp BatchNormVarianceInvert(xla::XlaOp variance, float eps_value) {
@@ -68,4 +141,230 @@ BatchNormGrads BuildBatchNormBackward(xla::XlaOp grad, xla::XlaOp input,
   return {grad_input, grad_weight, grad_bias};
 }
 
+xla::PrimitiveType BatchNormComputeType(xla::PrimitiveType type) {
+  return MomentsComputeType(type);
+}
+
+BatchNormStatistics BuildWelfordStatistics(xla::XlaOp input,
+                                           xla::int64 feature_index) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  WelfordReduction stats = BuildWelfordReduction(
+      input, ReductionDimensions(input_shape.rank(), feature_index));
+  xla::XlaOp zero = xla::ZerosLike(stats.m2);
+  return {stats.mean, xla::Select(xla::Gt(stats.count, zero),
+                                  stats.m2 / stats.count, zero)};
+}
+
+BatchNormOutput BuildFusedBatchNormTraining(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp bias,
+    const absl::optional<xla::XlaOp>& residual,
+    const FusedBatchNormOptions& options) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = BatchNormComputeType(input_shape.element_type());
+  BatchNormStatistics stats = ComputeStatistics(input, options);
+  xla::XlaOp invstd =
+      BatchNormVarianceInvert(stats.variance, options.eps_value);
+  std::vector<xla::int64> feature_dims = {options.feature_index};
+  xla::XlaOp normalized =
+      xla::Sub(xla::ConvertElementType(input, type), stats.mean, feature_dims);
+  xla::XlaOp scale = invstd * xla::ConvertElementType(weight, type);
+  xla::XlaOp output =
+      xla::Add(xla::Mul(normalized, scale, feature_dims),
+               xla::ConvertElementType(bias, type), feature_dims);
+  if (residual) {
+    output = output + xla::ConvertElementType(*residual, type);
+  }
+  if (options.relu) {
+    output = xla::Max(output, xla::Zero(input.builder(), type));
+  }
+  return {xla::ConvertElementType(output, input_shape.element_type()),
+          stats.mean, stats.variance};
+}
+
+FusedBatchNormGrads BuildFusedBatchNormBackward(
+    xla::XlaOp grad, xla::XlaOp input, xla::XlaOp weight, xla::XlaOp mean,
+    xla::XlaOp variance, xla::XlaOp output,
+    const FusedBatchNormOptions& options) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  xla::PrimitiveType type = BatchNormComputeType(input_shape.element_type());
+  xla::XlaBuilder* builder = input.builder();
+  xla::XlaOp zero = xla::Zero(builder, type);
+  std::vector<xla::int64> feature_dims = {options.feature_index};
+  std::vector<xla::int64> reduce_dims =
+      ReductionDimensions(input_shape.rank(), options.feature_index);
+  xla::XlaComputation add = XlaHelpers::CreateAddComputation(type);
+
+  xla::XlaOp grad_activation = xla::ConvertElementType(grad, type);
+  if (options.relu) {
+    grad_activation =
+        xla::Select(xla::Gt(xla::ConvertElementType(output, type), zero),
+                    grad_activation, xla::ZerosLike(grad_activation));
+  }
+  xla::XlaOp invstd = BatchNormVarianceInvert(variance, options.eps_value);
+  xla::XlaOp normalized = xla::Mul(
+      xla::Sub(xla::ConvertElementType(input, type), mean, feature_dims),
+      invstd, feature_dims);
+  xla::XlaOp grad_bias = xla::Reduce(grad_activation, zero, add, reduce_dims);
+  xla::XlaOp grad_weight =
+      xla::Reduce(grad_activation * normalized, zero, add, reduce_dims);
+
+  // The input gradient depends on the batch averages of the two reductions
+  // above, which span all the replicas when the statistics did.
+  xla::int64 num_features = input_shape.dimensions(options.feature_index);
+  xla::XlaOp counts = XlaHelpers::ScalarBroadcast<double>(
+      xla::ShapeUtil::ElementsIn(input_shape) / num_features, type,
+      {num_features}, builder);
+  xla::XlaOp sum_grad = grad_bias;
+  xla::XlaOp sum_grad_normalized = grad_weight;
+  if (options.cross_replica) {
+    std::vector<xla::XlaOp> reduced = SumRowsAcrossReplicas(
+        {counts, sum_grad, sum_grad_normalized}, options.replica_groups);
+    counts = reduced[0];
+    sum_grad = reduced[1];
+    sum_grad_normalized = reduced[2];
+  }
+  xla::XlaOp mean_grad = sum_grad / counts;
+  xla::XlaOp mean_grad_normalized = sum_grad_normalized / counts;
+  xla::XlaOp centered_grad =
+      xla::Sub(grad_activation,
+               xla::Add(xla::Mul(normalized, mean_grad_normalized,
+                                 feature_dims),
+                        mean_grad, feature_dims));
+  xla::XlaOp grad_input =
+      xla::Mul(centered_grad, invstd * xla::ConvertElementType(weight, type),
+               feature_dims);
+  return {xla::ConvertElementType(grad_input, input_shape.element_type()),
+          xla::ConvertElementType(grad_weight, weight_shape.element_type()),
+          xla::ConvertElementType(grad_bias, weight_shape.element_type()),
+          xla::ConvertElementType(grad_activation,
+                                  XlaHelpers::TypeOfXlaOp(grad))};
+}
+
+LayerNormOutput BuildLayerNorm(xla::XlaOp input, xla::XlaOp weight,
+                               xla::XlaOp bias, xla::int64 axis,
+                               float eps_value) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = BatchNormComputeType(input_shape.element_type());
+  MomentsResult moments = BuildMoments(input, {axis},
+                                       /*keep_reduced_dimensions=*/false,
+                                       /*unbiased=*/false);
+  xla::XlaOp invstd = BatchNormVarianceInvert(moments.variance, eps_value);
+  std::vector<xla::int64> row_dims =
+      ReductionDimensions(input_shape.rank(), axis);
+  std::vector<xla::int64> feature_dims = {axis};
+  xla::XlaOp normalized = xla::Mul(
+      xla::Sub(xla::ConvertElementType(input, type), moments.mean, row_dims),
+      invstd, row_dims);
+  xla::XlaOp output = xla::Add(
+      xla::Mul(normalized, xla::ConvertElementType(weight, type),
+               feature_dims),
+      xla::ConvertElementType(bias, type), feature_dims);
+  return {xla::ConvertElementType(output, input_shape.element_type()),
+          moments.mean, moments.variance};
+}
+
+BatchNormGrads BuildLayerNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                      xla::XlaOp weight, xla::XlaOp mean,
+                                      xla::XlaOp variance, xla::int64 axis,
+                                      float eps_value) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  xla::PrimitiveType type = BatchNormComputeType(input_shape.element_type());
+  xla::XlaBuilder* builder = input.builder();
+  xla::XlaOp zero = xla::Zero(builder, type);
+  std::vector<xla::int64> row_dims =
+      ReductionDimensions(input_shape.rank(), axis);
+  std::vector<xla::int64> feature_dims = {axis};
+  xla::XlaComputation add = XlaHelpers::CreateAddComputation(type);
+
+  xla::XlaOp grad_output = xla::ConvertElementType(grad, type);
+  xla::XlaOp invstd = BatchNormVarianceInvert(variance, eps_value);
+  xla::XlaOp normalized = xla::Mul(
+      xla::Sub(xla::ConvertElementType(input, type), mean, row_dims), invstd,
+      row_dims);
+  xla::XlaOp grad_bias = xla::Reduce(grad_output, zero, add, row_dims);
+  xla::XlaOp grad_weight =
+      xla::Reduce(grad_output * normalized, zero, add, row_dims);
+
+  // Same as the batch normalization input gradient, with the averages taken
+  // along the axis instead of across it.
+  xla::XlaOp grad_normalized = xla::Mul(
+      grad_output, xla::ConvertElementType(weight, type), feature_dims);
+  xla::XlaOp count = XlaHelpers::ScalarValue<double>(
+      input_shape.dimensions(axis), type, builder);
+  xla::XlaOp mean_grad =
+      xla::Reduce(grad_normalized, zero, add, feature_dims) / count;
+  xla::XlaOp mean_grad_normalized =
+      xla::Reduce(grad_normalized * normalized, zero, add, feature_dims) /
+      count;
+  xla::XlaOp centered_grad = xla::Sub(
+      grad_normalized,
+      xla::Add(xla::Mul(normalized, mean_grad_normalized, row_dims), mean_grad,
+               row_dims));
+  xla::XlaOp grad_input = xla::Mul(centered_grad, invstd, row_dims);
+  return {xla::ConvertElementType(grad_input, input_shape.element_type()),
+          xla::ConvertElementType(grad_weight, weight_shape.element_type()),
+          xla::ConvertElementType(grad_bias, weight_shape.element_type())};
+}
+
+RmsNormOutput BuildRmsNorm(xla::XlaOp input, xla::XlaOp weight,
+                           xla::int64 axis, float eps_value) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = BatchNormComputeType(input_shape.element_type());
+  xla::XlaBuilder* builder = input.builder();
+  std::vector<xla::int64> row_dims =
+      ReductionDimensions(input_shape.rank(), axis);
+  std::vector<xla::int64> feature_dims = {axis};
+  xla::XlaOp values = xla::ConvertElementType(input, type);
+  xla::XlaOp count = XlaHelpers::ScalarValue<double>(
+      input_shape.dimensions(axis), type, builder);
+  xla::XlaOp mean_square =
+      xla::Reduce(values * values, xla::Zero(builder, type),
+                  XlaHelpers::CreateAddComputation(type), feature_dims) /
+      count;
+  xla::XlaOp inv_rms = BatchNormVarianceInvert(mean_square, eps_value);
+  xla::XlaOp output =
+      xla::Mul(xla::Mul(values, inv_rms, row_dims),
+               xla::ConvertElementType(weight, type), feature_dims);
+  return {xla::ConvertElementType(output, input_shape.element_type()),
+          inv_rms};
+}
+
+RmsNormGrads BuildRmsNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                  xla::XlaOp weight, xla::XlaOp inv_rms,
+                                  xla::int64 axis) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  xla::PrimitiveType type = BatchNormComputeType(input_shape.element_type());
+  xla::XlaBuilder* builder = input.builder();
+  xla::XlaOp zero = xla::Zero(builder, type);
+  std::vector<xla::int64> row_dims =
+      ReductionDimensions(input_shape.rank(), axis);
+  std::vector<xla::int64> feature_dims = {axis};
+  xla::XlaComputation add = XlaHelpers::CreateAddComputation(type);
+
+  xla::XlaOp grad_output = xla::ConvertElementType(grad, type);
+  xla::XlaOp normalized =
+      xla::Mul(xla::ConvertElementType(input, type), inv_rms, row_dims);
+  xla::XlaOp grad_weight =
+      xla::Reduce(grad_output * normalized, zero, add, row_dims);
+
+  // Without the centering, only the projection on the normalized input is
+  // removed from the gradient.
+  xla::XlaOp grad_normalized = xla::Mul(
+      grad_output, xla::ConvertElementType(weight, type), feature_dims);
+  xla::XlaOp count = XlaHelpers::ScalarValue<double>(
+      input_shape.dimensions(axis), type, builder);
+  xla::XlaOp mean_grad_normalized =
+      xla::Reduce(grad_normalized * normalized, zero, add, feature_dims) /
+      count;
+  xla::XlaOp grad_input = xla::Mul(
+      xla::Sub(grad_normalized,
+               xla::Mul(normalized, mean_grad_normalized, row_dims)),
+      inv_rms, row_dims);
+  return {xla::ConvertElementType(grad_input, input_shape.element_type()),
+          xla::ConvertElementType(grad_weight, weight_shape.element_type())};
+}
+
 }  // namespace swift_xla
@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <vector>
+
+#include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
 namespace swift_xla {
@@ -46,4 +49,103 @@ BatchNormGrads BuildBatchNormBackward(xla::XlaOp grad, xla::XlaOp input,
                                       xla::XlaOp save_invstd, bool training,
                                       float eps_value);
 
+struct BatchNormStatistics {
+  xla::XlaOp mean;
+  // The biased variance.
+  xla::XlaOp variance;
+};
+
+// Options of the fused batch normalization training path.
+struct FusedBatchNormOptions {
+  float eps_value = 1e-5;
+  xla::int64 feature_index = 1;
+  // Whether the output goes through a ReLU, after the residual if any.
+  bool relu = false;
+  // Whether the statistics are computed over the whole global batch, rather
+  // than over the replica batch only, with replica_groups as in
+  // BuildAllReduce().
+  bool cross_replica = false;
+  std::vector<std::vector<xla::int64>> replica_groups;
+};
+
+struct FusedBatchNormGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_weight;
+  xla::XlaOp grad_bias;
+  // The gradient at the output of the normalization, which is also the one of
+  // the residual.
+  xla::XlaOp grad_activation;
+};
+
+// The type the fused batch normalization accumulates inputs of the given
+// type in.
+xla::PrimitiveType BatchNormComputeType(xla::PrimitiveType type);
+
+// Computes the per feature mean and variance of input over all the other
+// dimensions, with a single pass Welford reduction. Reduced precision inputs
+// are accumulated in F32, which is also the type of the statistics.
+BatchNormStatistics BuildWelfordStatistics(xla::XlaOp input,
+                                           xla::int64 feature_index);
+
+// Batch normalization training which computes the statistics with
+// BuildWelfordStatistics() and applies the optional residual add and ReLU
+// epilogue in the same computation. With options.cross_replica, the replica
+// statistics are summed in a single all-reduce. The returned statistics are in
+// the accumulation type.
+BatchNormOutput BuildFusedBatchNormTraining(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp bias,
+    const absl::optional<xla::XlaOp>& residual,
+    const FusedBatchNormOptions& options);
+
+// The gradients of BuildFusedBatchNormTraining(), given its output and the
+// statistics it returned. The gradients of weight and bias only cover this
+// replica batch, even with options.cross_replica.
+FusedBatchNormGrads BuildFusedBatchNormBackward(
+    xla::XlaOp grad, xla::XlaOp input, xla::XlaOp weight, xla::XlaOp mean,
+    xla::XlaOp variance, xla::XlaOp output,
+    const FusedBatchNormOptions& options);
+
+struct LayerNormOutput {
+  xla::XlaOp output;
+  xla::XlaOp mean;
+  xla::XlaOp variance;
+};
+
+// Layer normalization of input along axis, scaled by weight and shifted by
+// bias, which have the size of the axis. The statistics of every position of
+// the other dimensions are computed in a single pass with BuildMoments(), and
+// are returned in the accumulation type.
+LayerNormOutput BuildLayerNorm(xla::XlaOp input, xla::XlaOp weight,
+                               xla::XlaOp bias, xla::int64 axis,
+                               float eps_value);
+
+// The gradients of BuildLayerNorm() with respect to the input, weight and
+// bias, given the statistics it returned.
+BatchNormGrads BuildLayerNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                      xla::XlaOp weight, xla::XlaOp mean,
+                                      xla::XlaOp variance, xla::int64 axis,
+                                      float eps_value);
+
+struct RmsNormOutput {
+  xla::XlaOp output;
+  xla::XlaOp inv_rms;
+};
+
+struct RmsNormGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_weight;
+};
+
+// Root mean square normalization of input along axis, scaled by weight, which
+// has the size of the axis. Also returns the inverse root mean square of every
+// position of the other dimensions, in the accumulation type.
+RmsNormOutput BuildRmsNorm(xla::XlaOp input, xla::XlaOp weight,
+                           xla::int64 axis, float eps_value);
+
+// The gradients of BuildRmsNorm() with respect to the input and weight, given
+// the inverse root mean square it returned.
+RmsNormGrads BuildRmsNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                  xla::XlaOp weight, xla::XlaOp inv_rms,
+                                  xla::int64 axis);
+
 }  // namespace swift_xla
@@ -0,0 +1,255 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks of the host side of tracing: IR node creation and hashing,
+// the graph walks of a sync, the compilation cache lookups and the tensor
+// registration. Nothing runs on the device, so the default client, which falls
+// back to the local CPU device, is enough.
+//
+// Usage: x10_benchmark [substring of the benchmark names to run]
+// X10_BENCHMARK_MIN_SECONDS sets the minimum time spent in every benchmark.
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "swift_bindings/xla_tensor_wrapper.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+
+// Gives the benchmarks access to the sync internals of XLATensor.
+class XLATensorBenchmarks {
+ public:
+  using PostOrderData = XLATensor::PostOrderData;
+  using SyncTensorsConfig = XLATensor::SyncTensorsConfig;
+
+  static XLATensor::SyncTensorCollection CollectSyncTensors(
+      const std::vector<XLATensor>& tensors) {
+    return XLATensor::CollectSyncTensors(tensors, SyncTensorsConfig());
+  }
+
+  static PostOrderData RunPostOrder(const std::vector<XLATensor>& tensors,
+                                    absl::Span<const size_t> indices) {
+    return XLATensor::RunPostOrder(tensors, indices);
+  }
+
+  static bool LookupCachedCompile(const std::vector<XLATensor>& tensors,
+                                  const xla::hash_t& hash) {
+    return XLATensor::LookupCachedCompile(tensors, hash) != nullptr;
+  }
+
+  // Adds a trivial computation to the compilation cache under hash.
+  static void AddCachedCompile(const xla::hash_t& hash) {
+    xla::XlaBuilder builder("Benchmark");
+    xla::ConstantR0<float>(&builder, 0);
+    xla::XlaComputation computation = builder.Build().ValueOrDie();
+    xla::ProgramShape program_shape =
+        computation.GetProgramShape().ValueOrDie();
+    auto cached_computation =
+        std::make_shared<XLATensor::CachedComputation>(
+            std::make_shared<xla::ComputationClient::Computation>(
+                std::move(computation), std::move(program_shape),
+                std::vector<std::string>()),
+            /*graph_size=*/1, /*compile_time=*/1.0);
+    XLATensor::GetComputationCache()->Add(hash, cached_computation);
+  }
+};
+
+namespace {
+
+double GetMinSeconds() {
+  static const double min_seconds =
+      xla::sys_util::GetEnvDouble("X10_BENCHMARK_MIN_SECONDS", 0.5);
+  return min_seconds;
+}
+
+bool Matches(const std::string& filter, const std::string& name) {
+  return name.find(filter) != std::string::npos;
+}
+
+// Runs fn, which processes items_per_call items, in batches of growing size
+// until the minimum time is spent, and prints the time per call and per item.
+void RunBenchmark(const std::string& filter, const std::string& name,
+                  size_t items_per_call, const std::function<void()>& fn) {
+  if (!Matches(filter, name)) {
+    return;
+  }
+  using Clock = std::chrono::steady_clock;
+  fn();
+  size_t calls = 0;
+  size_t batch = 1;
+  double seconds = 0;
+  while (seconds < GetMinSeconds()) {
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < batch; ++i) {
+      fn();
+    }
+    seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    calls += batch;
+    batch *= 2;
+  }
+  double ns_per_call = seconds * 1e9 / calls;
+  std::printf("%-40s %12zu calls %14.1f ns/call %12.1f ns/item\n",
+              name.c_str(), calls, ns_per_call, ns_per_call / items_per_call);
+}
+
+xla::Shape BenchmarkShape() {
+  return xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32, {16, 16});
+}
+
+XLATensor MakeLeafTensor(const Device& device, double value) {
+  return XLATensor::Create(
+      ir::Value(ir::MakeNode<ir::ops::Scalar>(value, BenchmarkShape())),
+      device);
+}
+
+// Builds a balanced binary tree of about num_nodes IR nodes, whose leaves are
+// distinct scalars, so that the graph is deep in size but shallow in height.
+ir::Value MakeTreeGraph(size_t num_nodes) {
+  std::vector<ir::Value> level;
+  for (size_t i = 0; i < (num_nodes + 1) / 2; ++i) {
+    level.emplace_back(ir::MakeNode<ir::ops::Scalar>(
+        static_cast<double>(i), BenchmarkShape()));
+  }
+  while (level.size() > 1) {
+    std::vector<ir::Value> next_level;
+    for (size_t i = 0; i + 1 < level.size(); i += 2) {
+      next_level.emplace_back(ir::ops::GenericOp(
+          ir::OpKind(at::aten::add), {level[i], level[i + 1]},
+          BenchmarkShape(), /*lower_fn=*/nullptr));
+    }
+    if (level.size() % 2 == 1) {
+      next_level.push_back(level.back());
+    }
+    level = std::move(next_level);
+  }
+  return level.front();
+}
+
+// Times the creation of one traced op of every family through the C API the
+// Swift bindings use, including the tensor handle and its registration.
+void BenchmarkNodeCreation(const std::string& filter, const Device& device) {
+  XLATensor* lhs = new XLATensor(MakeLeafTensor(device, 1));
+  XLATensor* rhs = new XLATensor(MakeLeafTensor(device, 2));
+  std::vector<int64_t> dims = {0};
+  std::vector<int64_t> sizes = {256};
+  RunBenchmark(filter, "NodeCreation/Elementwise", 1,
+               [&]() { destroyTensor(XLATensor_add(lhs, rhs)); });
+  RunBenchmark(filter, "NodeCreation/Unary", 1,
+               [&]() { destroyTensor(XLATensor_exp(lhs)); });
+  RunBenchmark(filter, "NodeCreation/Reduction", 1, [&]() {
+    destroyTensor(XLATensor_sum(lhs, Int64ArrayRef{dims.data(), dims.size()},
+                                /*keep_reduced_dimensions=*/false));
+  });
+  RunBenchmark(filter, "NodeCreation/View", 1, [&]() {
+    destroyTensor(XLATensor_resize_value(
+        lhs, Int64ArrayRef{sizes.data(), sizes.size()}));
+  });
+  destroyTensor(lhs);
+  destroyTensor(rhs);
+}
+
+// Times the node constructors, which are dominated by the hashing of the node
+// attributes, shapes and operands.
+void BenchmarkNodeHash(const std::string& filter) {
+  double value = 0;
+  RunBenchmark(filter, "NodeHash/Scalar", 1, [&]() {
+    ir::MakeNode<ir::ops::Scalar>(value, BenchmarkShape());
+    value += 1;
+  });
+  ir::Value lhs(ir::MakeNode<ir::ops::Scalar>(1.0, BenchmarkShape()));
+  ir::Value rhs(ir::MakeNode<ir::ops::Scalar>(2.0, BenchmarkShape()));
+  RunBenchmark(filter, "NodeHash/Binary", 1, [&]() {
+    ir::ops::GenericOp(ir::OpKind(at::aten::add), {lhs, rhs},
+                       BenchmarkShape(), /*lower_fn=*/nullptr);
+  });
+}
+
+void BenchmarkGraphWalks(const std::string& filter, const Device& device) {
+  for (size_t num_nodes : {1000, 10000, 100000, 1000000}) {
+    std::string suffix = "/" + std::to_string(num_nodes);
+    if (!Matches(filter, "CollectSyncTensors" + suffix) &&
+        !Matches(filter, "ComputePostOrder" + suffix) &&
+        !Matches(filter, "PostOrder" + suffix)) {
+      continue;
+    }
+    ir::Value root = MakeTreeGraph(num_nodes);
+    std::vector<XLATensor> tensors = {XLATensor::Create(root, device)};
+    std::vector<size_t> indices = {0};
+    RunBenchmark(filter, "CollectSyncTensors" + suffix, 1, [&]() {
+      XLATensorBenchmarks::CollectSyncTensors(tensors);
+    });
+    RunBenchmark(filter, "ComputePostOrder" + suffix, num_nodes, [&]() {
+      ir::Util::ComputePostOrder(root.node.get());
+    });
+    RunBenchmark(filter, "PostOrder" + suffix, num_nodes, [&]() {
+      XLATensorBenchmarks::RunPostOrder(tensors, indices);
+    });
+  }
+}
+
+void BenchmarkCacheLookup(const std::string& filter, const Device& device) {
+  std::vector<XLATensor> tensors = {MakeLeafTensor(device, 1)};
+  xla::hash_t hash = xla::util::MHash(std::string("x10_benchmark"));
+  XLATensorBenchmarks::AddCachedCompile(hash);
+  RunBenchmark(filter, "LookupCachedCompile/Hit", 1, [&]() {
+    XLA_CHECK(XLATensorBenchmarks::LookupCachedCompile(tensors, hash));
+  });
+  xla::hash_t missing_hash = xla::util::MHash(std::string("x10_missing"));
+  RunBenchmark(filter, "LookupCachedCompile/Miss", 1, [&]() {
+    XLA_CHECK(!XLATensorBenchmarks::LookupCachedCompile(tensors, missing_hash));
+  });
+}
+
+// Times the creation and destruction of a tensor handle, which register and
+// unregister it with the device context arena.
+void BenchmarkDeviceContextArena(const std::string& filter,
+                                 const Device& device) {
+  ir::Value value(ir::MakeNode<ir::ops::Scalar>(1.0, BenchmarkShape()));
+  RunBenchmark(filter, "DeviceContextArena/RegisterUnregister", 1,
+               [&]() { XLATensor::Create(value, device); });
+  std::vector<XLATensor> live_tensors;
+  for (size_t i = 0; i < 10000; ++i) {
+    live_tensors.push_back(XLATensor::Create(value, device));
+  }
+  RunBenchmark(filter, "DeviceContextArena/GetLiveTensors/10000",
+               live_tensors.size(),
+               [&]() { XLATensor::GetLiveTensors(&device); });
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+  swift_xla::Device device = swift_xla::GetCurrentDevice();
+  swift_xla::BenchmarkNodeCreation(filter, device);
+  swift_xla::BenchmarkNodeHash(filter);
+  swift_xla::BenchmarkGraphWalks(filter, device);
+  swift_xla::BenchmarkCacheLookup(filter, device);
+  swift_xla::BenchmarkDeviceContextArena(filter, device);
+  return 0;
+}
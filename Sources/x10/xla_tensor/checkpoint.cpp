@@ -0,0 +1,121 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
+
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace swift_xla {
+namespace {
+
+// Counts, for every device data, the checkpoints holding it. The same data can
+// be held by more than one, when a checkpoint is started before the previous
+// one is done.
+class PinnedDataRegistry {
+ public:
+  void Pin(absl::Span<const xla::ComputationClient::DataPtr> xla_data) {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (const xla::ComputationClient::DataPtr& data : xla_data) {
+      ++pinned_[data.get()];
+    }
+  }
+
+  void Unpin(absl::Span<const xla::ComputationClient::DataPtr> xla_data) {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (const xla::ComputationClient::DataPtr& data : xla_data) {
+      auto it = pinned_.find(data.get());
+      XLA_CHECK(it != pinned_.end());
+      if (--it->second == 0) {
+        pinned_.erase(it);
+      }
+    }
+  }
+
+  bool IsPinned(const xla::ComputationClient::Data* data) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return pinned_.count(data) > 0;
+  }
+
+ private:
+  std::mutex lock_;
+  std::unordered_map<const xla::ComputationClient::Data*, size_t> pinned_;
+};
+
+PinnedDataRegistry* GetPinnedDataRegistry() {
+  static PinnedDataRegistry* registry = new PinnedDataRegistry();
+  return registry;
+}
+
+}  // namespace
+
+AsyncCheckpoint::AsyncCheckpoint(std::vector<size_t> offsets)
+    : offsets_(std::move(offsets)), mwait_(1) {}
+
+AsyncCheckpoint::~AsyncCheckpoint() {
+  try {
+    mwait_.Wait();
+  } catch (const std::exception& ex) {
+    TF_LOG(ERROR) << "Failed to write checkpoint: " << ex.what();
+  }
+}
+
+void AsyncCheckpoint::Wait() { mwait_.Wait(); }
+
+std::shared_ptr<AsyncCheckpoint> SaveTensorsAsync(
+    std::vector<XLATensor>* tensors, const std::string& path, int shard_index,
+    int num_shards) {
+  XLA_CHECK_GT(num_shards, 0);
+  XLA_CHECK(shard_index >= 0 && shard_index < num_shards)
+      << "Invalid checkpoint shard " << shard_index << " of " << num_shards;
+  std::vector<XLATensor> shard_tensors;
+  for (size_t i = shard_index; i < tensors->size(); i += num_shards) {
+    shard_tensors.push_back((*tensors)[i]);
+  }
+  std::function<void()> wait_fn;
+  std::vector<xla::ComputationClient::DataPtr> xla_data =
+      XLATensor::SnapshotTensorsData(&shard_tensors, &wait_fn);
+  auto checkpoint =
+      std::make_shared<AsyncCheckpoint>(GetFileTensorOffsets(xla_data));
+  // The buffers are pinned before the tensors can be used by another step, as
+  // that step could otherwise update them in place.
+  GetPinnedDataRegistry()->Pin(xla_data);
+  auto write_fn = [xla_data = std::move(xla_data), wait_fn = std::move(wait_fn),
+                   offsets = checkpoint->offsets(), path]() mutable {
+    xla::util::StatusCleanup unpin([&](xla::Status) {
+      GetPinnedDataRegistry()->Unpin(xla_data);
+      xla_data.clear();
+    });
+    wait_fn();
+    XlaDataToFile(xla_data, offsets, path);
+  };
+  xla::env::ScheduleIoClosure(
+      checkpoint->mwait()->Completer(std::move(write_fn)));
+  XLA_COUNTER("AsyncCheckpoints", 1);
+  return checkpoint;
+}
+
+bool IsCheckpointPinned(const xla::ComputationClient::Data* data) {
+  return GetPinnedDataRegistry()->IsPinned(data);
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+
+namespace swift_xla {
+
+// A checkpoint being written in the background. The tensors are snapshotted
+// when it is created, so the training steps which follow can update them
+// while their old values get streamed to the file.
+class AsyncCheckpoint {
+ public:
+  explicit AsyncCheckpoint(std::vector<size_t> offsets);
+
+  // Waits for the file to be written, logging the failures.
+  ~AsyncCheckpoint();
+
+  // The offsets in the file of the saved tensors, see GetFileTensorOffsets().
+  const std::vector<size_t>& offsets() const { return offsets_; }
+
+  // Waits for the file to be written, and throws if it failed.
+  void Wait();
+
+  xla::util::MultiWait* mwait() { return &mwait_; }
+
+ private:
+  std::vector<size_t> offsets_;
+  xla::util::MultiWait mwait_;
+};
+
+// Saves the tensors whose index modulo num_shards is shard_index to the file
+// at path, in the layout FileToXlaData() reads. Each replica passes its own
+// shard_index, so the replicas write disjoint shards of the replicated model.
+// The pending IR of the tensors is scheduled without waiting, and the device
+// to host transfers and file writes run on the IO thread pool, streaming at
+// most XLA_CHECKPOINT_INFLIGHT_BYTES through host memory.
+std::shared_ptr<AsyncCheckpoint> SaveTensorsAsync(
+    std::vector<XLATensor>* tensors, const std::string& path, int shard_index,
+    int num_shards);
+
+// Tells whether the device data is held by a checkpoint still being written.
+// Such data must not be donated to, or aliased with the outputs of, the
+// computations of the following steps.
+bool IsCheckpointPinned(const xla::ComputationClient::Data* data);
+
+}  // namespace swift_xla
@@ -0,0 +1,344 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Collective communication benchmarks over the replication devices, or all the
+// devices of the default device type when no replication is configured. Every
+// local replica runs on its own thread, tracing the collective and syncing it
+// as a replicated computation, like the training loops do. In multi-host
+// setups every host runs the benchmark, and the replicas of the other hosts
+// join through the mesh service; only the host of the first replica reports.
+//
+// The all_reduce, all_to_all and collective_permute collectives are timed over
+// f32 and bf16 messages of X10_COLLECTIVE_BENCHMARK_MIN_BYTES to
+// X10_COLLECTIVE_BENCHMARK_MAX_BYTES per replica, over all the replicas, over
+// pairs of replicas and, in multi-host setups, over the replicas of each host.
+// The all_reduce of 16 tensors is also timed as a single fused reduction and
+// in XLA_ALLREDUCE_BUCKET_BYTES buckets. The algorithmic bandwidth is the
+// message size over the time, and the bus bandwidth scales it by the share of
+// the message each replica sends, as nccl-tests does: 2(n-1)/n for all_reduce,
+// (n-1)/n for all_to_all and 1 for collective_permute.
+//
+// Usage: x10_collective_benchmark [substring of the benchmark names to run]
+// X10_COLLECTIVE_BENCHMARK_ITERS sets the number of timed iterations.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/token.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+using ReplicaGroups = std::vector<std::vector<xla::int64>>;
+
+constexpr size_t kNumFusedTensors = 16;
+
+// Blocks the replica threads until all of them reached it.
+class Barrier {
+ public:
+  explicit Barrier(size_t count) : count_(count) {}
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t generation = generation_;
+    if (++waiting_ == count_) {
+      waiting_ = 0;
+      ++generation_;
+      cv_.notify_all();
+    } else {
+      cv_.wait(lock, [&]() { return generation != generation_; });
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t count_;
+  size_t waiting_ = 0;
+  size_t generation_ = 0;
+};
+
+struct GroupConfig {
+  std::string name;
+  ReplicaGroups groups;
+  size_t group_size = 0;
+};
+
+struct Collective {
+  std::string name;
+  size_t num_inputs = 1;
+  // The share of the message each replica sends, for a group of n replicas.
+  std::function<double(size_t)> bus_factor;
+  std::function<std::vector<XLATensor>(const std::vector<XLATensor>&,
+                                       const GroupConfig&)>
+      trace_fn;
+};
+
+ReplicaGroups MakeRingPairs(const GroupConfig& config, size_t num_replicas) {
+  ReplicaGroups groups = config.groups;
+  if (groups.empty()) {
+    groups.emplace_back();
+    for (size_t i = 0; i < num_replicas; ++i) {
+      groups.back().push_back(i);
+    }
+  }
+  ReplicaGroups pairs;
+  for (const std::vector<xla::int64>& group : groups) {
+    for (size_t i = 0; i < group.size(); ++i) {
+      pairs.push_back({group[i], group[(i + 1) % group.size()]});
+    }
+  }
+  return pairs;
+}
+
+std::vector<Collective> MakeCollectives(size_t num_replicas) {
+  auto all_reduce_factor = [](size_t n) { return 2.0 * (n - 1) / n; };
+  std::vector<Collective> collectives;
+  collectives.push_back(
+      {"all_reduce", 1, all_reduce_factor,
+       [](const std::vector<XLATensor>& inputs, const GroupConfig& config) {
+         return std::vector<XLATensor>{
+             XLATensor::all_reduce(inputs.front(),
+                                   ir::MakeNode<ir::ops::Token>(),
+                                   AllReduceType::kSum, 1.0, config.groups)
+                 .first};
+       }});
+  collectives.push_back(
+      {"all_reduce_fused", kNumFusedTensors, all_reduce_factor,
+       [](const std::vector<XLATensor>& inputs, const GroupConfig& config) {
+         return XLATensor::all_reduce(inputs, ir::MakeNode<ir::ops::Token>(),
+                                      AllReduceType::kSum, 1.0, config.groups)
+             .first;
+       }});
+  collectives.push_back(
+      {"all_reduce_bucketed", kNumFusedTensors, all_reduce_factor,
+       [](const std::vector<XLATensor>& inputs, const GroupConfig& config) {
+         static const xla::int64 bucket_bytes =
+             xla::sys_util::GetEnvInt("XLA_ALLREDUCE_BUCKET_BYTES", 25 << 20);
+         return XLATensor::all_reduce_bucketed(
+                    inputs, ir::MakeNode<ir::ops::Token>(),
+                    AllReduceType::kSum, 1.0, config.groups, bucket_bytes)
+             .first;
+       }});
+  collectives.push_back(
+      {"all_to_all", 1, [](size_t n) { return 1.0 * (n - 1) / n; },
+       [](const std::vector<XLATensor>& inputs, const GroupConfig& config) {
+         return std::vector<XLATensor>{
+             XLATensor::all_to_all(inputs.front(),
+                                   ir::MakeNode<ir::ops::Token>(),
+                                   /*split_dimension=*/0,
+                                   /*concat_dimension=*/0, config.group_size,
+                                   config.groups)
+                 .first};
+       }});
+  collectives.push_back(
+      {"collective_permute", 1, [](size_t n) { return 1.0; },
+       [num_replicas](const std::vector<XLATensor>& inputs,
+                      const GroupConfig& config) {
+         std::vector<std::pair<xla::int64, xla::int64>> source_target_pairs;
+         for (const std::vector<xla::int64>& pair :
+              MakeRingPairs(config, num_replicas)) {
+           source_target_pairs.emplace_back(pair[0], pair[1]);
+         }
+         return std::vector<XLATensor>{
+             XLATensor::collective_permute(inputs.front(),
+                                           ir::MakeNode<ir::ops::Token>(),
+                                           std::move(source_target_pairs))
+                 .first};
+       }});
+  return collectives;
+}
+
+std::vector<GroupConfig> MakeGroupConfigs(size_t num_replicas) {
+  std::vector<GroupConfig> configs = {{"all", {}, num_replicas}};
+  if (num_replicas > 2 && num_replicas % 2 == 0) {
+    GroupConfig pairs{"pairs", {}, 2};
+    for (size_t i = 0; i < num_replicas; i += 2) {
+      pairs.groups.push_back({static_cast<xla::int64>(i),
+                              static_cast<xla::int64>(i + 1)});
+    }
+    configs.push_back(std::move(pairs));
+  }
+  ReplicaGroups host_groups = xla::ComputationClient::GetReplicaHostGroups();
+  if (!host_groups.empty()) {
+    size_t group_size = host_groups.front().size();
+    configs.push_back({"hosts", std::move(host_groups), group_size});
+  }
+  return configs;
+}
+
+std::vector<XLATensor> MakeInputs(const Device& device, size_t count,
+                                  size_t num_inputs, at::ScalarType type) {
+  std::vector<XLATensor> inputs;
+  for (size_t i = 0; i < num_inputs; ++i) {
+    at::Tensor tensor(std::vector<float>(count / num_inputs, 1.0f),
+                      {static_cast<int64_t>(count / num_inputs)});
+    XLATensor input = XLATensor::Create(tensor, device);
+    if (type != at::ScalarType::Float) {
+      input = XLATensor::to(input, absl::nullopt, type);
+    }
+    inputs.push_back(std::move(input));
+  }
+  XLATensor::SyncTensorsGraph(&inputs, /*devices=*/{}, /*wait=*/true,
+                              /*sync_xla_data=*/true);
+  return inputs;
+}
+
+// Runs the collective over the local replicas, returning the seconds per
+// iteration.
+double RunCollective(const Collective& collective, const GroupConfig& config,
+                     size_t count, at::ScalarType type,
+                     const std::vector<std::string>& replication_devices,
+                     const std::vector<std::string>& local_devices,
+                     size_t iterations) {
+  Barrier barrier(local_devices.size());
+  xla::int64 start = 0;
+  xla::int64 end = 0;
+  auto replica_fn = [&](size_t index) {
+    Device device(local_devices[index]);
+    std::vector<XLATensor> inputs =
+        MakeInputs(device, count, collective.num_inputs, type);
+    auto step_fn = [&]() {
+      std::vector<XLATensor> outputs = collective.trace_fn(inputs, config);
+      XLATensor::SyncTensorsGraph(&outputs, replication_devices,
+                                  /*wait=*/true, /*sync_xla_data=*/false);
+      XLATensor::MarkStep(&device);
+    };
+    // The first step compiles the replicated computation.
+    step_fn();
+    barrier.Wait();
+    if (index == 0) {
+      start = xla::sys_util::NowNs();
+    }
+    for (size_t i = 0; i < iterations; ++i) {
+      step_fn();
+    }
+    barrier.Wait();
+    if (index == 0) {
+      end = xla::sys_util::NowNs();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < local_devices.size(); ++i) {
+    threads.emplace_back(replica_fn, i);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return 1e-9 * (end - start) / iterations;
+}
+
+std::vector<std::string> GetReplicationDevices() {
+  std::vector<std::string> devices =
+      xla::ComputationClient::GetReplicationDevices();
+  if (!devices.empty()) {
+    return devices;
+  }
+  DeviceType hw_type = xla::ComputationClient::DefaultDeviceStruct().hw_type;
+  for (const std::string& device : xla::ComputationClient::AllDevices()) {
+    if (Device(device).hw_type == hw_type) {
+      devices.push_back(device);
+    }
+  }
+  return devices;
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+  size_t min_bytes =
+      xla::sys_util::GetEnvInt("X10_COLLECTIVE_BENCHMARK_MIN_BYTES", 1 << 10);
+  size_t max_bytes =
+      xla::sys_util::GetEnvInt("X10_COLLECTIVE_BENCHMARK_MAX_BYTES", 1 << 28);
+  size_t iterations =
+      xla::sys_util::GetEnvInt("X10_COLLECTIVE_BENCHMARK_ITERS", 20);
+  XLA_CHECK_GT(iterations, 0);
+
+  std::vector<std::string> replication_devices =
+      swift_xla::GetReplicationDevices();
+  std::vector<std::string> all_devices =
+      xla::ComputationClient::AllDevices();
+  std::vector<std::string> local_devices;
+  for (const std::string& device : replication_devices) {
+    if (std::find(all_devices.begin(), all_devices.end(), device) !=
+        all_devices.end()) {
+      local_devices.push_back(device);
+    }
+  }
+  XLA_CHECK(!local_devices.empty()) << "No local replication device";
+  bool report = local_devices.front() == replication_devices.front();
+  size_t num_replicas = replication_devices.size();
+  if (report) {
+    std::printf("%zu replicas, %zu local\n", num_replicas,
+                local_devices.size());
+    std::printf("%-20s %-6s %-5s %12s %12s %12s %12s\n", "collective",
+                "groups", "type", "bytes", "time(us)", "algbw(GB/s)",
+                "busbw(GB/s)");
+  }
+
+  struct DataType {
+    const char* name;
+    at::ScalarType type;
+    size_t element_size;
+  };
+  std::vector<DataType> types = {{"f32", at::ScalarType::Float, 4},
+                                 {"bf16", at::ScalarType::BFloat16, 2}};
+  for (const swift_xla::Collective& collective :
+       swift_xla::MakeCollectives(num_replicas)) {
+    if (collective.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    for (const swift_xla::GroupConfig& config :
+         swift_xla::MakeGroupConfigs(num_replicas)) {
+      for (const DataType& type : types) {
+        for (size_t bytes = min_bytes; bytes <= max_bytes; bytes *= 4) {
+          // The all_to_all splits the message in group_size chunks, and the
+          // fused reductions in num_inputs tensors.
+          size_t granularity = config.group_size * collective.num_inputs;
+          size_t count =
+              bytes / type.element_size / granularity * granularity;
+          if (count == 0) {
+            continue;
+          }
+          double seconds = swift_xla::RunCollective(
+              collective, config, count, type.type, replication_devices,
+              local_devices, iterations);
+          double message_bytes = count * type.element_size;
+          double algbw = message_bytes / seconds * 1e-9;
+          if (report) {
+            std::printf("%-20s %-6s %-5s %12.0f %12.1f %12.3f %12.3f\n",
+                        collective.name.c_str(), config.name.c_str(),
+                        type.name, message_bytes, seconds * 1e6, algbw,
+                        algbw * collective.bus_factor(config.group_size));
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
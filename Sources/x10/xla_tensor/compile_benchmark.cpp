@@ -0,0 +1,256 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compile time regression benchmark over a corpus of saved computations. Every
+// file of the corpus directory holds either:
+// - graphs saved with XLA_SAVE_TENSORS_FILE and XLA_SAVE_TENSORS_FMT=hlo, each
+//   between the "## BEGIN_GRAPH" and "## END_GRAPH" markers;
+// - an entry of the XLA_PERSISTENT_CACHE_DIR cache;
+// - a single computation in HLO text.
+// Every computation is compiled for the default device, through the same
+// ComputationClient::Device::Compile() the sync uses, and the report lists
+// per graph, tab separated, the best compile time over
+// X10_COMPILE_BENCHMARK_REPEATS runs, the peak host memory grown during the
+// compile and the executable size (-1 when the backend does not report it).
+//
+// Usage: x10_compile_benchmark CORPUS_DIR [BASELINE_REPORT]
+// When a baseline report, as printed by an earlier run, is given, the graphs
+// whose compile time or memory grew by more than the
+// X10_COMPILE_BENCHMARK_THRESHOLD factor (1.2 by default) are listed, and the
+// exit status is 1.
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace swift_xla {
+namespace {
+
+constexpr char kBeginGraph[] = "## BEGIN_GRAPH\n";
+constexpr char kEndGraph[] = "## END_GRAPH";
+
+struct SavedComputation {
+  std::string name;
+  xla::XlaComputation computation;
+};
+
+struct CompileRecord {
+  double compile_seconds = 0;
+  xla::int64 peak_bytes = 0;
+  xla::int64 executable_bytes = -1;
+};
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  XLA_CHECK(file) << "Unable to open " << path;
+  return std::string((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+}
+
+std::vector<std::string> ListFiles(const std::string& folder) {
+  std::vector<std::string> files;
+  DIR* dir = opendir(folder.c_str());
+  XLA_CHECK(dir != nullptr) << "Unable to list " << folder;
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      files.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+bool ParseHloText(const std::string& name, const std::string& text,
+                  std::vector<SavedComputation>* computations) {
+  auto module_or = xla::ParseAndReturnUnverifiedModule(text);
+  if (!module_or.ok()) {
+    TF_LOG(WARNING) << "Skipping " << name << ", not HLO text: "
+                    << module_or.status();
+    return false;
+  }
+  computations->push_back(
+      {name, xla::XlaComputation(module_or.ValueOrDie()->ToProto())});
+  return true;
+}
+
+// Loads the computations of the corpus file. They are named after the file, so
+// that the reports of corpora copied to other places can be compared.
+void LoadComputations(const std::string& folder, const std::string& file,
+                      std::vector<SavedComputation>* computations) {
+  std::string path = folder + "/" + file;
+  std::string contents = ReadFile(path);
+  if (contents.find(kBeginGraph) != std::string::npos) {
+    size_t index = 0;
+    for (size_t begin = contents.find(kBeginGraph); begin != std::string::npos;
+         begin = contents.find(kBeginGraph, begin)) {
+      begin += std::strlen(kBeginGraph);
+      size_t end = contents.find(kEndGraph, begin);
+      XLA_CHECK_NE(end, std::string::npos) << "Truncated graph in " << path;
+      ParseHloText(file + "#" + std::to_string(index++),
+                   contents.substr(begin, end - begin), computations);
+    }
+    return;
+  }
+  // The persistent cache entries are the build fingerprint line followed by
+  // the serialized HloModuleProto.
+  size_t newline = contents.find('\n');
+  xla::HloModuleProto proto;
+  if (absl::EndsWith(file, ".hlo") && newline != std::string::npos &&
+      proto.ParseFromString(contents.substr(newline + 1))) {
+    computations->push_back({file, xla::XlaComputation(std::move(proto))});
+    return;
+  }
+  ParseHloText(file, contents, computations);
+}
+
+// Reads a field, in kB, of /proc/self/status. Returns -1 if not available.
+xla::int64 ReadProcStatusKb(const std::string& field) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, field.size(), field) == 0 &&
+        line.size() > field.size() && line[field.size()] == ':') {
+      return std::stoll(line.substr(field.size() + 1));
+    }
+  }
+  return -1;
+}
+
+// Resets the peak resident set size (VmHWM) to the current one.
+void ResetPeakMemory() { std::ofstream("/proc/self/clear_refs") << "5"; }
+
+CompileRecord CompileComputation(const xla::XlaComputation& computation,
+                                 size_t repeats) {
+  xla::ComputationClient::Device* device =
+      xla::ComputationClient::DefaultDevice();
+  CompileRecord record;
+  for (size_t i = 0; i < repeats; ++i) {
+    std::vector<xla::ComputationClient::CompileInstance> instances;
+    instances.emplace_back(computation, /*output_shape=*/nullptr);
+    ResetPeakMemory();
+    xla::int64 start_rss_kb = ReadProcStatusKb("VmRSS");
+    xla::int64 start = xla::sys_util::NowNs();
+    std::vector<xla::ComputationClient::ComputationPtr> compiled =
+        device->Compile({device->name()}, std::move(instances));
+    double seconds = 1e-9 * (xla::sys_util::NowNs() - start);
+    xla::int64 peak_rss_kb = ReadProcStatusKb("VmHWM");
+    XLA_CHECK_EQ(compiled.size(), 1);
+    if (i == 0 || seconds < record.compile_seconds) {
+      record.compile_seconds = seconds;
+    }
+    if (start_rss_kb >= 0 && peak_rss_kb >= 0) {
+      record.peak_bytes =
+          std::max(record.peak_bytes, (peak_rss_kb - start_rss_kb) * 1024);
+    }
+    record.executable_bytes = compiled.front()->executable_size();
+  }
+  return record;
+}
+
+std::map<std::string, CompileRecord> ReadBaseline(const std::string& path) {
+  std::map<std::string, CompileRecord> baseline;
+  std::ifstream file(path);
+  XLA_CHECK(file) << "Unable to open " << path;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::vector<std::string> fields = absl::StrSplit(line, '\t');
+    if (fields.size() != 4 || fields[0] == "name") {
+      continue;
+    }
+    CompileRecord record;
+    record.compile_seconds = std::stod(fields[1]);
+    record.peak_bytes = std::stoll(fields[2]);
+    record.executable_bytes = std::stoll(fields[3]);
+    baseline[fields[0]] = record;
+  }
+  return baseline;
+}
+
+bool Regressed(double value, double baseline_value, double threshold) {
+  return baseline_value > 0 && value > baseline_value * threshold;
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  XLA_CHECK(argc == 2 || argc == 3)
+      << "Usage: " << argv[0] << " CORPUS_DIR [BASELINE_REPORT]";
+  size_t repeats = std::max<xla::int64>(
+      xla::sys_util::GetEnvInt("X10_COMPILE_BENCHMARK_REPEATS", 3), 1);
+  std::vector<swift_xla::SavedComputation> computations;
+  for (const std::string& file : swift_xla::ListFiles(argv[1])) {
+    swift_xla::LoadComputations(argv[1], file, &computations);
+  }
+
+  std::map<std::string, swift_xla::CompileRecord> records;
+  std::printf("name\tcompile_seconds\tpeak_bytes\texecutable_bytes\n");
+  for (const swift_xla::SavedComputation& saved : computations) {
+    swift_xla::CompileRecord record =
+        swift_xla::CompileComputation(saved.computation, repeats);
+    std::printf("%s\t%.6f\t%lld\t%lld\n", saved.name.c_str(),
+                record.compile_seconds,
+                static_cast<long long>(record.peak_bytes),
+                static_cast<long long>(record.executable_bytes));
+    records[saved.name] = record;
+  }
+  if (argc < 3) {
+    return 0;
+  }
+
+  double threshold =
+      xla::sys_util::GetEnvDouble("X10_COMPILE_BENCHMARK_THRESHOLD", 1.2);
+  bool regressed = false;
+  for (const auto& name_baseline : swift_xla::ReadBaseline(argv[2])) {
+    auto it = records.find(name_baseline.first);
+    if (it == records.end()) {
+      continue;
+    }
+    const swift_xla::CompileRecord& baseline = name_baseline.second;
+    const swift_xla::CompileRecord& record = it->second;
+    if (swift_xla::Regressed(record.compile_seconds, baseline.compile_seconds,
+                             threshold) ||
+        swift_xla::Regressed(record.peak_bytes, baseline.peak_bytes,
+                             threshold)) {
+      std::fprintf(stderr,
+                   "Regression in %s: %.6fs vs %.6fs, %lld vs %lld bytes\n",
+                   name_baseline.first.c_str(), record.compile_seconds,
+                   baseline.compile_seconds,
+                   static_cast<long long>(record.peak_bytes),
+                   static_cast<long long>(baseline.peak_bytes));
+      regressed = true;
+    }
+  }
+  return regressed ? 1 : 0;
+}
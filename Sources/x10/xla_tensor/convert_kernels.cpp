@@ -0,0 +1,331 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/convert_kernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define X10_CONVERT_AVX2 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define X10_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace swift_xla {
+namespace {
+
+#if defined(X10_CONVERT_AVX2)
+
+#define X10_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+
+bool HasAvx2() {
+  static const bool has_avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+  return has_avx2;
+}
+
+X10_TARGET_AVX2 size_t ConvertFloatToBF16Avx2(uint16_t* dest,
+                                              const float* source, size_t n) {
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i bias = _mm256_set1_epi32(0x7fff);
+  const __m256i qnan = _mm256_set1_epi32(0x7fc0);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 value = _mm256_loadu_ps(source + i);
+    __m256i bits = _mm256_castps_si256(value);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+    __m256i rounded = _mm256_srli_epi32(
+        _mm256_add_epi32(bits, _mm256_add_epi32(bias, lsb)), 16);
+    __m256i nan_mask =
+        _mm256_castps_si256(_mm256_cmp_ps(value, value, _CMP_UNORD_Q));
+    rounded = _mm256_blendv_epi8(rounded, qnan, nan_mask);
+    // The pack works within 128 bit lanes, so gather the low halves after it.
+    __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(rounded, rounded), 0xd8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm256_castsi256_si128(packed));
+  }
+  return i;
+}
+
+X10_TARGET_AVX2 size_t ConvertBF16ToFloatAvx2(float* dest,
+                                              const uint16_t* source,
+                                              size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i bits = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i),
+                        _mm256_slli_epi32(bits, 16));
+  }
+  return i;
+}
+
+X10_TARGET_AVX2 size_t ConvertFloatToHalfAvx2(uint16_t* dest,
+                                              const float* source, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(source + i),
+                                     _MM_FROUND_TO_NEAREST_INT));
+  }
+  return i;
+}
+
+X10_TARGET_AVX2 size_t ConvertHalfToFloatAvx2(float* dest,
+                                              const uint16_t* source,
+                                              size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dest + i,
+                     _mm256_cvtph_ps(_mm_loadu_si128(
+                         reinterpret_cast<const __m128i*>(source + i))));
+  }
+  return i;
+}
+
+X10_TARGET_AVX2 size_t ConvertInt64ToInt32Avx2(int32_t* dest,
+                                               const int64_t* source,
+                                               size_t n) {
+  const __m256i low_words = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i value =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm256_castsi256_si128(
+                         _mm256_permutevar8x32_epi32(value, low_words)));
+  }
+  return i;
+}
+
+X10_TARGET_AVX2 size_t ConvertInt32ToInt64Avx2(int64_t* dest,
+                                               const int32_t* source,
+                                               size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(dest + i),
+        _mm256_cvtepi32_epi64(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i))));
+  }
+  return i;
+}
+
+X10_TARGET_AVX2 bool TransposeTile32Avx2(uint32_t* dest, size_t dest_stride,
+                                          const uint32_t* source,
+                                          size_t source_stride, size_t rows,
+                                          size_t cols) {
+  if (rows % 8 != 0 || cols % 8 != 0) {
+    return false;
+  }
+  for (size_t r = 0; r < rows; r += 8) {
+    for (size_t c = 0; c < cols; c += 8) {
+      const float* block =
+          reinterpret_cast<const float*>(source + r * source_stride + c);
+      __m256 r0 = _mm256_loadu_ps(block);
+      __m256 r1 = _mm256_loadu_ps(block + source_stride);
+      __m256 r2 = _mm256_loadu_ps(block + 2 * source_stride);
+      __m256 r3 = _mm256_loadu_ps(block + 3 * source_stride);
+      __m256 r4 = _mm256_loadu_ps(block + 4 * source_stride);
+      __m256 r5 = _mm256_loadu_ps(block + 5 * source_stride);
+      __m256 r6 = _mm256_loadu_ps(block + 6 * source_stride);
+      __m256 r7 = _mm256_loadu_ps(block + 7 * source_stride);
+      __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+      __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+      __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+      __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+      __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+      __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+      __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+      __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+      __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+      __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+      __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+      __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+      __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+      __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+      __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+      __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+      float* out = reinterpret_cast<float*>(dest + c * dest_stride + r);
+      _mm256_storeu_ps(out, _mm256_permute2f128_ps(s0, s4, 0x20));
+      _mm256_storeu_ps(out + dest_stride,
+                       _mm256_permute2f128_ps(s1, s5, 0x20));
+      _mm256_storeu_ps(out + 2 * dest_stride,
+                       _mm256_permute2f128_ps(s2, s6, 0x20));
+      _mm256_storeu_ps(out + 3 * dest_stride,
+                       _mm256_permute2f128_ps(s3, s7, 0x20));
+      _mm256_storeu_ps(out + 4 * dest_stride,
+                       _mm256_permute2f128_ps(s0, s4, 0x31));
+      _mm256_storeu_ps(out + 5 * dest_stride,
+                       _mm256_permute2f128_ps(s1, s5, 0x31));
+      _mm256_storeu_ps(out + 6 * dest_stride,
+                       _mm256_permute2f128_ps(s2, s6, 0x31));
+      _mm256_storeu_ps(out + 7 * dest_stride,
+                       _mm256_permute2f128_ps(s3, s7, 0x31));
+    }
+  }
+  return true;
+}
+
+#undef X10_TARGET_AVX2
+
+#elif defined(X10_CONVERT_NEON)
+
+size_t ConvertFloatToBF16Neon(uint16_t* dest, const float* source, size_t n) {
+  const uint32x4_t one = vdupq_n_u32(1);
+  const uint32x4_t bias = vdupq_n_u32(0x7fff);
+  const uint16x4_t qnan = vdup_n_u16(0x7fc0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t value = vld1q_f32(source + i);
+    uint32x4_t bits = vreinterpretq_u32_f32(value);
+    uint32x4_t lsb = vandq_u32(vshrq_n_u32(bits, 16), one);
+    uint16x4_t rounded =
+        vshrn_n_u32(vaddq_u32(bits, vaddq_u32(bias, lsb)), 16);
+    uint16x4_t not_nan = vmovn_u32(vceqq_f32(value, value));
+    vst1_u16(dest + i, vbsl_u16(not_nan, rounded, qnan));
+  }
+  return i;
+}
+
+size_t ConvertBF16ToFloatNeon(float* dest, const uint16_t* source, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(dest + i, vreinterpretq_f32_u32(
+                            vshll_n_u16(vld1_u16(source + i), 16)));
+  }
+  return i;
+}
+
+size_t ConvertFloatToHalfNeon(uint16_t* dest, const float* source, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1_u16(dest + i,
+             vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source + i))));
+  }
+  return i;
+}
+
+size_t ConvertHalfToFloatNeon(float* dest, const uint16_t* source, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(dest + i,
+              vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(source + i))));
+  }
+  return i;
+}
+
+size_t ConvertInt64ToInt32Neon(int32_t* dest, const int64_t* source,
+                               size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    vst1_s32(dest + i, vmovn_s64(vld1q_s64(source + i)));
+  }
+  return i;
+}
+
+size_t ConvertInt32ToInt64Neon(int64_t* dest, const int32_t* source,
+                               size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    vst1q_s64(dest + i, vmovl_s32(vld1_s32(source + i)));
+  }
+  return i;
+}
+
+bool TransposeTile32Neon(uint32_t* dest, size_t dest_stride,
+                         const uint32_t* source, size_t source_stride,
+                         size_t rows, size_t cols) {
+  if (rows % 4 != 0 || cols % 4 != 0) {
+    return false;
+  }
+  for (size_t r = 0; r < rows; r += 4) {
+    for (size_t c = 0; c < cols; c += 4) {
+      const uint32_t* block = source + r * source_stride + c;
+      uint32x4x2_t t01 =
+          vtrnq_u32(vld1q_u32(block), vld1q_u32(block + source_stride));
+      uint32x4x2_t t23 = vtrnq_u32(vld1q_u32(block + 2 * source_stride),
+                                   vld1q_u32(block + 3 * source_stride));
+      uint32_t* out = dest + c * dest_stride + r;
+      vst1q_u32(out, vcombine_u32(vget_low_u32(t01.val[0]),
+                                  vget_low_u32(t23.val[0])));
+      vst1q_u32(out + dest_stride, vcombine_u32(vget_low_u32(t01.val[1]),
+                                                vget_low_u32(t23.val[1])));
+      vst1q_u32(out + 2 * dest_stride,
+                vcombine_u32(vget_high_u32(t01.val[0]),
+                             vget_high_u32(t23.val[0])));
+      vst1q_u32(out + 3 * dest_stride,
+                vcombine_u32(vget_high_u32(t01.val[1]),
+                             vget_high_u32(t23.val[1])));
+    }
+  }
+  return true;
+}
+
+#endif
+
+}  // namespace
+
+#if defined(X10_CONVERT_AVX2)
+#define X10_DISPATCH_CONVERT(name, dest, source, n) \
+  return HasAvx2() ? name##Avx2(dest, source, n) : 0
+#elif defined(X10_CONVERT_NEON)
+#define X10_DISPATCH_CONVERT(name, dest, source, n) \
+  return name##Neon(dest, source, n)
+#else
+#define X10_DISPATCH_CONVERT(name, dest, source, n) return 0
+#endif
+
+size_t ConvertFloatToBF16(uint16_t* dest, const float* source, size_t n) {
+  X10_DISPATCH_CONVERT(ConvertFloatToBF16, dest, source, n);
+}
+
+size_t ConvertBF16ToFloat(float* dest, const uint16_t* source, size_t n) {
+  X10_DISPATCH_CONVERT(ConvertBF16ToFloat, dest, source, n);
+}
+
+size_t ConvertFloatToHalf(uint16_t* dest, const float* source, size_t n) {
+  X10_DISPATCH_CONVERT(ConvertFloatToHalf, dest, source, n);
+}
+
+size_t ConvertHalfToFloat(float* dest, const uint16_t* source, size_t n) {
+  X10_DISPATCH_CONVERT(ConvertHalfToFloat, dest, source, n);
+}
+
+size_t ConvertInt64ToInt32(int32_t* dest, const int64_t* source, size_t n) {
+  X10_DISPATCH_CONVERT(ConvertInt64ToInt32, dest, source, n);
+}
+
+size_t ConvertInt32ToInt64(int64_t* dest, const int32_t* source, size_t n) {
+  X10_DISPATCH_CONVERT(ConvertInt32ToInt64, dest, source, n);
+}
+
+bool TransposeTile32(uint32_t* dest, size_t dest_stride,
+                     const uint32_t* source, size_t source_stride, size_t rows,
+                     size_t cols) {
+#if defined(X10_CONVERT_AVX2)
+  return HasAvx2() && TransposeTile32Avx2(dest, dest_stride, source,
+                                          source_stride, rows, cols);
+#elif defined(X10_CONVERT_NEON)
+  return TransposeTile32Neon(dest, dest_stride, source, source_stride, rows,
+                             cols);
+#else
+  return false;
+#endif
+}
+
+#undef X10_DISPATCH_CONVERT
+
+}  // namespace swift_xla
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/bfloat16/bfloat16.h"
+
+namespace swift_xla {
+
+// Vectorized conversions between contiguous buffers, for the element type
+// pairs which the XLA_USE_BF16, XLA_USE_FP16 and XLA_USE_32BIT_LONG settings
+// make common on the host to device paths. The instruction set is picked at
+// runtime (AVX2 and F16C on x86-64, NEON on AArch64). Every kernel converts the
+// longest prefix of the source it can handle with vector instructions, and
+// returns its length, leaving the remaining elements to the caller.
+// The float to bfloat16 conversion rounds to nearest even, and turns NaNs into
+// quiet NaNs, like the tensorflow::bfloat16 constructor does.
+size_t ConvertFloatToBF16(uint16_t* dest, const float* source, size_t n);
+size_t ConvertBF16ToFloat(float* dest, const uint16_t* source, size_t n);
+size_t ConvertFloatToHalf(uint16_t* dest, const float* source, size_t n);
+size_t ConvertHalfToFloat(float* dest, const uint16_t* source, size_t n);
+size_t ConvertInt64ToInt32(int32_t* dest, const int64_t* source, size_t n);
+size_t ConvertInt32ToInt64(int64_t* dest, const int32_t* source, size_t n);
+
+// Transposes a rows x cols tile of 32 bit elements, so that
+// dest[c * dest_stride + r] = source[r * source_stride + c]. Returns false,
+// without writing anything, if no vector unit is available, or the tile sides
+// are not multiples of its width (8 with AVX2, 4 with NEON).
+bool TransposeTile32(uint32_t* dest, size_t dest_stride,
+                     const uint32_t* source, size_t source_stride, size_t rows,
+                     size_t cols);
+
+template <typename T, size_t SIZE>
+struct IsSignedInt {
+  static constexpr bool value = std::is_integral<T>::value &&
+                                std::is_signed<T>::value && sizeof(T) == SIZE;
+};
+
+// Maps a destination and source element type pair to its vectorized kernel.
+// The value member tells whether one exists.
+template <typename D, typename S, typename Enable = void>
+struct VectorConversion {
+  static constexpr bool value = false;
+
+  static size_t Convert(D* dest, const S* source, size_t n) { return 0; }
+};
+
+template <>
+struct VectorConversion<tensorflow::bfloat16, float> {
+  static constexpr bool value = true;
+
+  static size_t Convert(tensorflow::bfloat16* dest, const float* source,
+                        size_t n) {
+    return ConvertFloatToBF16(reinterpret_cast<uint16_t*>(dest), source, n);
+  }
+};
+
+template <>
+struct VectorConversion<float, tensorflow::bfloat16> {
+  static constexpr bool value = true;
+
+  static size_t Convert(float* dest, const tensorflow::bfloat16* source,
+                        size_t n) {
+    return ConvertBF16ToFloat(dest, reinterpret_cast<const uint16_t*>(source),
+                              n);
+  }
+};
+
+template <>
+struct VectorConversion<xla::half, float> {
+  static constexpr bool value = true;
+
+  static size_t Convert(xla::half* dest, const float* source, size_t n) {
+    return ConvertFloatToHalf(reinterpret_cast<uint16_t*>(dest), source, n);
+  }
+};
+
+template <>
+struct VectorConversion<float, xla::half> {
+  static constexpr bool value = true;
+
+  static size_t Convert(float* dest, const xla::half* source, size_t n) {
+    return ConvertHalfToFloat(dest, reinterpret_cast<const uint16_t*>(source),
+                              n);
+  }
+};
+
+// The 64 bit integer types are spelled differently by XLA and the host
+// tensors, so match them by size.
+template <typename D, typename S>
+struct VectorConversion<
+    D, S,
+    typename std::enable_if<IsSignedInt<D, 4>::value &&
+                            IsSignedInt<S, 8>::value>::type> {
+  static constexpr bool value = true;
+
+  static size_t Convert(D* dest, const S* source, size_t n) {
+    return ConvertInt64ToInt32(reinterpret_cast<int32_t*>(dest),
+                               reinterpret_cast<const int64_t*>(source), n);
+  }
+};
+
+template <typename D, typename S>
+struct VectorConversion<
+    D, S,
+    typename std::enable_if<IsSignedInt<D, 8>::value &&
+                            IsSignedInt<S, 4>::value>::type> {
+  static constexpr bool value = true;
+
+  static size_t Convert(D* dest, const S* source, size_t n) {
+    return ConvertInt32ToInt64(reinterpret_cast<int64_t*>(dest),
+                               reinterpret_cast<const int32_t*>(source), n);
+  }
+};
+
+}  // namespace swift_xla
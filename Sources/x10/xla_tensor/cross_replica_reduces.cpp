@@ -14,7 +14,9 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
 
+#include <algorithm>
 #include <map>
+#include <numeric>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
@@ -23,6 +25,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/token_handler.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 
 namespace swift_xla {
@@ -95,18 +98,163 @@ std::vector<xla::ReplicaGroup> CreateReduceGroups(
   return reduce_groups;
 }
 
+xla::XlaOp BuildReduceBinary(AllReduceType reduce_type, xla::XlaOp lhs,
+                             xla::XlaOp rhs) {
+  switch (reduce_type) {
+    case AllReduceType::kSum:
+      return lhs + rhs;
+    case AllReduceType::kMul:
+      return lhs * rhs;
+    case AllReduceType::kAnd:
+      return xla::And(lhs, rhs);
+    case AllReduceType::kOr:
+      return xla::Or(lhs, rhs);
+    case AllReduceType::kMin:
+      return xla::Min(lhs, rhs);
+    case AllReduceType::kMax:
+      return xla::Max(lhs, rhs);
+  }
+  XLA_ERROR() << "Invalid reduce type: "
+              << xla::util::GetEnumValue(reduce_type);
+}
+
+bool UseAllToAllCollectives() {
+  // The XLA GPU and CPU backends do not implement the all-to-all.
+  DeviceType hw_type = GetCurrentDevice().hw_type;
+  return hw_type == DeviceType::TPU || hw_type == DeviceType::REMOTE_TPU;
+}
+
+// Returns the position of this replica within its group, as a S32 scalar.
+xla::XlaOp BuildGroupIndex(xla::XlaBuilder* builder,
+                           const std::vector<std::vector<xla::int64>>& groups) {
+  xla::XlaOp replica_id = xla::ReplicaId(builder);
+  if (groups.empty()) {
+    return xla::ConvertElementType(replica_id, xla::PrimitiveType::S32);
+  }
+  xla::int64 num_replicas = 0;
+  for (auto& group : groups) {
+    for (auto replica_id : group) {
+      num_replicas = std::max(num_replicas, replica_id + 1);
+    }
+  }
+  std::vector<xla::int32> group_index(num_replicas, 0);
+  for (auto& group : groups) {
+    for (size_t i = 0; i < group.size(); ++i) {
+      group_index[group[i]] = i;
+    }
+  }
+  xla::XlaOp index = xla::DynamicSlice(
+      xla::ConstantR1<xla::int32>(builder, group_index),
+      {xla::ConvertElementType(replica_id, xla::PrimitiveType::S32)}, {1});
+  return xla::Reshape(index, {});
+}
+
+// Returns the start indices of the shard_index-th slice along dim, of the
+// given size.
+std::vector<xla::XlaOp> ShardStartIndices(xla::XlaOp shard_index,
+                                          xla::int64 rank, xla::int64 dim,
+                                          xla::int64 size) {
+  xla::XlaBuilder* builder = shard_index.builder();
+  std::vector<xla::XlaOp> start_indices(
+      rank, XlaHelpers::ScalarValue<xla::int32>(0, builder));
+  start_indices[dim] =
+      shard_index * XlaHelpers::ScalarValue<xla::int32>(size, builder);
+  return start_indices;
+}
+
+// Sums the operand over all the replicas, with the slow links across hosts
+// only carrying a 1/replicas_per_host shard of it from every host.
+xla::XlaOp BuildHierarchicalSum(
+    xla::XlaOp operand, const std::vector<std::vector<xla::int64>>& host_groups,
+    TokenHandler* token_handler) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(operand);
+  xla::PrimitiveType type = shape.element_type();
+  xla::XlaBuilder* builder = operand.builder();
+  xla::int64 host_size = host_groups.front().size();
+  std::vector<std::vector<xla::int64>> cross_host_groups(host_size);
+  for (auto& group : host_groups) {
+    for (xla::int64 i = 0; i < host_size; ++i) {
+      cross_host_groups[i].push_back(group[i]);
+    }
+  }
+
+  xla::int64 size = xla::ShapeUtil::ElementsIn(shape);
+  xla::int64 shard_size = (size + host_size - 1) / host_size;
+  xla::XlaOp zero = XlaHelpers::ScalarValue<float>(0, type, builder);
+  xla::XlaOp flat = xla::Reshape(
+      token_handler->GetInput(operand, &shape), {size});
+  if (shard_size * host_size != size) {
+    flat = xla::PadInDim(flat, zero, 0, 0, shard_size * host_size - size);
+  }
+  xla::XlaOp shard = BuildReduceScatterSum(flat, host_size, host_groups);
+  shard = xla::AllReduce(shard, XlaHelpers::CreateAddComputation(type),
+                         CreateReduceGroups(cross_host_groups));
+  xla::XlaOp gathered = BuildAllGather(shard, host_size, host_groups);
+  if (shard_size * host_size != size) {
+    gathered = xla::SliceInDim(gathered, 0, size, 1, 0);
+  }
+  return xla::Reshape(gathered, shape.dimensions());
+}
+
 }  // namespace
 
 std::vector<xla::XlaOp> BuildAllReduce(
     AllReduceType reduce_type, absl::Span<const xla::XlaOp> operands,
     xla::XlaOp token, double scale,
-    const std::vector<std::vector<xla::int64>>& groups) {
+    const std::vector<std::vector<xla::int64>>& groups,
+    const AllReduceOptions& options) {
   std::vector<xla::ReplicaGroup> reduce_groups = CreateReduceGroups(groups);
+  // The operands sent in the wire type are scaled beforehand, so that sums of
+  // many replicas do not overflow its range.
+  std::vector<xla::XlaOp> reduce_operands(operands.begin(), operands.end());
+  std::vector<xla::PrimitiveType> original_types(
+      operands.size(), xla::PrimitiveType::PRIMITIVE_TYPE_INVALID);
+  if (options.wire_type) {
+    for (size_t i = 0; i < operands.size(); ++i) {
+      const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(operands[i]);
+      if (xla::primitive_util::IsFloatingPointType(shape.element_type()) &&
+          xla::primitive_util::BitWidth(shape.element_type()) >
+              xla::primitive_util::BitWidth(*options.wire_type) &&
+          xla::ShapeUtil::ElementsIn(shape) >=
+              options.wire_type_min_elements) {
+        xla::XlaOp operand = operands[i];
+        if (scale != 1.0) {
+          operand = operand * XlaHelpers::ScalarValue<float>(
+                                  scale, shape.element_type(),
+                                  operand.builder());
+        }
+        original_types[i] = shape.element_type();
+        reduce_operands[i] =
+            xla::ConvertElementType(operand, *options.wire_type);
+      }
+    }
+  }
+  if (!options.host_groups.empty() && groups.empty() &&
+      reduce_type == AllReduceType::kSum) {
+    TokenHandler token_handler(token);
+    xla::XlaOp chained_token = token;
+    std::vector<xla::XlaOp> result;
+    for (size_t i = 0; i < reduce_operands.size(); ++i) {
+      xla::XlaOp reduced = BuildHierarchicalSum(
+          reduce_operands[i], options.host_groups, &token_handler);
+      chained_token = token_handler.GetNewToken(reduced);
+      if (original_types[i] != xla::PrimitiveType::PRIMITIVE_TYPE_INVALID) {
+        reduced = xla::ConvertElementType(reduced, original_types[i]);
+      } else if (scale != 1.0) {
+        reduced = reduced * XlaHelpers::ScalarValue<float>(
+                                scale, XlaHelpers::TypeOfXlaOp(reduced),
+                                reduced.builder());
+      }
+      result.push_back(reduced);
+    }
+    result.push_back(chained_token);
+    return result;
+  }
   // TODO: We use pseudo-tokens ATM, which are real values. This need to be
   // switched to use the real XLA Token once support has been added to XLA
   // AllReduce().
   xla::XlaOp chained_token = token;
-  ReduceContext redux = GetReduceContext(operands);
+  ReduceContext redux = GetReduceContext(reduce_operands);
   std::vector<xla::XlaOp> result(operands.size());
   for (auto& type_ctx : redux.contexts) {
     xla::XlaOp token_op = MaybeConvertTo(chained_token, type_ctx.first);
@@ -122,6 +270,12 @@ std::vector<xla::XlaOp> BuildAllReduce(
     for (size_t i = 0; i < type_ctx.second.indices.size(); ++i) {
       size_t op_idx = type_ctx.second.indices[i];
       xla::XlaOp gte = xla::GetTupleElement(reduce, i);
+      if (original_types[op_idx] !=
+          xla::PrimitiveType::PRIMITIVE_TYPE_INVALID) {
+        result[op_idx] =
+            xla::ConvertElementType(gte, original_types[op_idx]);
+        continue;
+      }
       if (scale != 1.0) {
         xla::XlaOp scaling_value = XlaHelpers::ScalarValue<float>(
             scale, type_ctx.second.operand_shapes[i].element_type(),
@@ -138,6 +292,129 @@ std::vector<xla::XlaOp> BuildAllReduce(
   return result;
 }
 
+xla::XlaOp BuildReduceScatterSum(
+    xla::XlaOp operand, xla::int64 group_size,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(operand);
+  xla::int64 size = xla::ShapeUtil::ElementsIn(shape);
+  XLA_CHECK_EQ(size % group_size, 0) << shape;
+  xla::int64 shard_size = size / group_size;
+  xla::PrimitiveType type = shape.element_type();
+  // Every replica gets the given shard from all its group peers, and sums
+  // them.
+  xla::XlaOp scattered =
+      xla::AllToAll(operand, 0, 0, group_size, CreateReduceGroups(groups));
+  return xla::Reduce(
+      xla::Reshape(scattered, {group_size, shard_size}),
+      XlaHelpers::ScalarValue<float>(0, type, operand.builder()),
+      XlaHelpers::CreateAddComputation(type), {0});
+}
+
+xla::XlaOp BuildAllGather(xla::XlaOp shard, xla::int64 group_size,
+                          const std::vector<std::vector<xla::int64>>& groups) {
+  xla::int64 shard_size =
+      xla::ShapeUtil::ElementsIn(XlaHelpers::ShapeOfXlaOp(shard));
+  // Sends the shard to every peer, which receives the shards of the group in
+  // replica order.
+  return xla::AllToAll(xla::Reshape(xla::Broadcast(shard, {group_size}),
+                                    {group_size * shard_size}),
+                       0, 0, group_size, CreateReduceGroups(groups));
+}
+
+ReduceScatterResult BuildReduceScatter(
+    AllReduceType reduce_type, xla::XlaOp input, xla::XlaOp token,
+    double scale, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  XLA_CHECK_EQ(input_shape.dimensions(dim) % shard_count, 0)
+      << "Dimension " << dim << " of " << input_shape
+      << " does not split in " << shard_count << " shards";
+  xla::int64 shard_size = input_shape.dimensions(dim) / shard_count;
+  xla::PrimitiveType type = input_shape.element_type();
+  TokenHandler token_handler(token);
+  xla::XlaOp chained_input = token_handler.GetInput(input, &input_shape);
+  xla::XlaOp result;
+  if (UseAllToAllCollectives()) {
+    // After the all-to-all, the i-th slice along dim holds this replica shard
+    // of the input of the i-th peer, and the slices just need to be reduced.
+    xla::XlaOp scattered = xla::AllToAll(chained_input, dim, dim, shard_count,
+                                         CreateReduceGroups(groups));
+    result = xla::SliceInDim(scattered, 0, shard_size, 1, dim);
+    for (xla::int64 i = 1; i < shard_count; ++i) {
+      result = BuildReduceBinary(
+          reduce_type, result,
+          xla::SliceInDim(scattered, i * shard_size, (i + 1) * shard_size, 1,
+                          dim));
+    }
+  } else {
+    xla::XlaOp reduced =
+        xla::AllReduce(chained_input, GetReduceComutation(reduce_type, type),
+                       CreateReduceGroups(groups));
+    std::vector<xla::int64> shard_sizes(input_shape.dimensions().begin(),
+                                        input_shape.dimensions().end());
+    shard_sizes[dim] = shard_size;
+    result = xla::DynamicSlice(
+        reduced,
+        ShardStartIndices(BuildGroupIndex(input.builder(), groups),
+                          input_shape.rank(), dim, shard_size),
+        shard_sizes);
+  }
+  if (scale != 1.0) {
+    result = result * XlaHelpers::ScalarValue<float>(scale, type,
+                                                     input.builder());
+  }
+  return {result, token_handler.GetNewToken(result)};
+}
+
+AllGatherResult BuildAllGather(
+    xla::XlaOp input, xla::XlaOp token, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = input_shape.element_type();
+  xla::int64 shard_size = input_shape.dimensions(dim);
+  std::vector<xla::int64> output_sizes(input_shape.dimensions().begin(),
+                                       input_shape.dimensions().end());
+  output_sizes[dim] = shard_size * shard_count;
+  TokenHandler token_handler(token);
+  xla::XlaOp chained_input = token_handler.GetInput(input, &input_shape);
+  xla::XlaOp result;
+  if (UseAllToAllCollectives()) {
+    // Every peer gets its own copy of the input, and receives the ones of the
+    // group in replica order.
+    std::vector<xla::int64> broadcast_dims(input_shape.rank());
+    std::iota(broadcast_dims.begin(), broadcast_dims.end(), 0);
+    for (xla::int64 i = dim; i < input_shape.rank(); ++i) {
+      ++broadcast_dims[i];
+    }
+    std::vector<xla::int64> copies_sizes(input_shape.dimensions().begin(),
+                                         input_shape.dimensions().end());
+    copies_sizes.insert(copies_sizes.begin() + dim, shard_count);
+    xla::XlaOp copies = xla::Reshape(
+        xla::BroadcastInDim(chained_input, copies_sizes, broadcast_dims),
+        output_sizes);
+    result = xla::AllToAll(copies, dim, dim, shard_count,
+                           CreateReduceGroups(groups));
+  } else {
+    // The peers place their input at their own offset, within zeros, and the
+    // all-reduce fills in the others.
+    xla::XlaOp zeros = xla::Broadcast(
+        XlaHelpers::ScalarValue<float>(0, type, input.builder()),
+        output_sizes);
+    xla::XlaOp placed = xla::DynamicUpdateSlice(
+        zeros, chained_input,
+        ShardStartIndices(BuildGroupIndex(input.builder(), groups),
+                          input_shape.rank(), dim, shard_size));
+    result = xla::AllReduce(
+        placed,
+        GetReduceComutation(type == xla::PrimitiveType::PRED
+                                ? AllReduceType::kOr
+                                : AllReduceType::kSum,
+                            type),
+        CreateReduceGroups(groups));
+  }
+  return {result, token_handler.GetNewToken(result)};
+}
+
 AllToAllResult BuildAllToAll(
     xla::XlaOp input, xla::XlaOp token, xla::int64 split_dimension,
     xla::int64 concat_dimension, xla::int64 split_count,
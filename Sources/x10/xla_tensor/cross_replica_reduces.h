@@ -18,6 +18,7 @@
 
 #include <vector>
 
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
@@ -32,6 +33,21 @@ enum class AllReduceType {
   kAnd,
 };
 
+// Lossy settings of an all-reduce, trading precision for less data moved
+// between the replicas.
+struct AllReduceOptions {
+  // If set, the floating point operands with a wider type are scaled, and then
+  // reduced in this type, before being converted back to their own type.
+  absl::optional<xla::PrimitiveType> wire_type;
+  // Operands with less elements than this are always reduced in their own
+  // type, since their transfer is latency bound anyway.
+  xla::int64 wire_type_min_elements = 0;
+  // The replicas grouped by host. If set, a sum over all the replicas is
+  // reduce-scattered within the hosts, all-reduced across hosts one shard at a
+  // time, and all-gathered back within the hosts.
+  std::vector<std::vector<xla::int64>> host_groups;
+};
+
 struct AllToAllResult {
   xla::XlaOp result;
   xla::XlaOp token;
@@ -42,16 +58,60 @@ struct CollectivePermuteResult {
   xla::XlaOp token;
 };
 
+struct ReduceScatterResult {
+  xla::XlaOp result;
+  xla::XlaOp token;
+};
+
+struct AllGatherResult {
+  xla::XlaOp result;
+  xla::XlaOp token;
+};
+
 std::vector<xla::XlaOp> BuildAllReduce(
     AllReduceType reduce_type, absl::Span<const xla::XlaOp> operands,
     xla::XlaOp token, double scale,
+    const std::vector<std::vector<xla::int64>>& groups,
+    const AllReduceOptions& options = {});
+
+// Sums the rank 1 operand, whose size is a multiple of group_size, over the
+// replicas of every group of group_size replicas, and returns the shard of the
+// sum which belongs to this replica: the i-th replica of a group gets the i-th
+// of its group_size equal slices.
+xla::XlaOp BuildReduceScatterSum(
+    xla::XlaOp operand, xla::int64 group_size,
     const std::vector<std::vector<xla::int64>>& groups);
 
+// The inverse of BuildReduceScatterSum(), without the sum: returns the
+// concatenation of the rank 1 shards of the replicas of the group, in their
+// order within the group.
+xla::XlaOp BuildAllGather(xla::XlaOp shard, xla::int64 group_size,
+                          const std::vector<std::vector<xla::int64>>& groups);
+
 AllToAllResult BuildAllToAll(
     xla::XlaOp input, xla::XlaOp token, xla::int64 split_dimension,
     xla::int64 concat_dimension, xla::int64 split_count,
     const std::vector<std::vector<xla::int64>>& groups);
 
+// Reduces the input over the replicas of every group of shard_count replicas,
+// and returns the shard of the result which belongs to this replica along
+// dim: the i-th replica of a group gets the i-th of shard_count equal slices.
+// On TPU the shards are exchanged with an all-to-all, so every replica only
+// sends and receives the data of one shard from each peer. The other backends
+// lack an all-to-all, and slice the output of an all-reduce instead.
+ReduceScatterResult BuildReduceScatter(
+    AllReduceType reduce_type, xla::XlaOp input, xla::XlaOp token,
+    double scale, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups);
+
+// Concatenates along dim the inputs of the replicas of every group of
+// shard_count replicas, in their order within the group. Like
+// BuildReduceScatter(), it uses an all-to-all on TPU, and an all-reduce of the
+// input placed within zeros on the other backends.
+AllGatherResult BuildAllGather(
+    xla::XlaOp input, xla::XlaOp token, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups);
+
 CollectivePermuteResult BuildCollectivePermute(
     xla::XlaOp input, xla::XlaOp token,
     const std::vector<std::pair<xla::int64, xla::int64>>& source_target_pairs);
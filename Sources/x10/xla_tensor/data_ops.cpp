@@ -20,10 +20,12 @@
 
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
@@ -34,14 +36,31 @@
 namespace swift_xla {
 namespace {
 
+// The cost of a sparse gather of one element, in units of the dense gather
+// work for one element of the gathered dimension.
+xla::int64 SparseGatherCost(DeviceType hw_type) {
+  static xla::int64 tpu_cost =
+      xla::sys_util::GetEnvInt("XLA_TPU_SPARSE_GATHER_COST", 100);
+  static xla::int64 cost =
+      xla::sys_util::GetEnvInt("XLA_SPARSE_GATHER_COST", 8);
+  return hw_type == DeviceType::TPU || hw_type == DeviceType::REMOTE_TPU
+             ? tpu_cost
+             : cost;
+}
+
 bool IsSparseGather(const xla::Shape& input_shape,
                     const xla::Shape& index_shape, xla::int64 dim) {
-  static int dense_gather_factor =
-      xla::sys_util::GetEnvInt("XLA_DENSE_GATHER_FACTOR", 100);
-  xla::int64 input_elements = xla::ShapeUtil::ElementsIn(input_shape);
-  xla::int64 index_elements = xla::ShapeUtil::ElementsIn(index_shape);
-  // Simple heuristic. Might need fine tuning.
-  return index_elements < input_elements / dense_gather_factor;
+  auto build_fn = [&](xla::XlaBuilder* builder, bool dense) {
+    xla::XlaOp input =
+        xla::Broadcast(xla::Zero(builder, input_shape.element_type()),
+                       input_shape.dimensions());
+    xla::XlaOp index = MakeBenchmarkIndices(builder, index_shape, dim,
+                                            input_shape.dimensions(dim));
+    return xla::TorchGather(input, index, dim, /*sparse=*/!dense);
+  };
+  return !UseDenseIndexedLowering(
+      "gather", GetCurrentDevice(), input_shape, index_shape, dim,
+      !IsSparseGatherByCost(input_shape, index_shape, dim), build_fn);
 }
 
 xla::XlaOp MirrorPadInDimensions(xla::XlaOp input,
@@ -117,6 +136,22 @@ xla::XlaOp MirrorPadInDimensionsBackward(
 
 }  // namespace
 
+bool IsSparseGatherByCost(const xla::Shape& input_shape,
+                          const xla::Shape& index_shape, xla::int64 dim) {
+  static int dense_gather_factor =
+      xla::sys_util::GetEnvInt("XLA_DENSE_GATHER_FACTOR", -1);
+  if (dense_gather_factor > 0) {
+    xla::int64 input_elements = xla::ShapeUtil::ElementsIn(input_shape);
+    xla::int64 index_elements = xla::ShapeUtil::ElementsIn(index_shape);
+    return index_elements < input_elements / dense_gather_factor;
+  }
+  // The dense gather compares every index with the whole gathered dimension,
+  // while the sparse one does a fixed amount of (much slower on TPU) work per
+  // index, so the choice only depends on the gathered dimension size.
+  return input_shape.dimensions(dim) >
+         SparseGatherCost(GetCurrentDevice().hw_type);
+}
+
 bool IsSparseGather(xla::XlaOp input, xla::XlaOp index, xla::int64 dim) {
   return IsSparseGather(XlaHelpers::ShapeOfXlaOp(input),
                         XlaHelpers::ShapeOfXlaOp(index), dim);
@@ -27,6 +27,14 @@
 // data movement and no computation.
 namespace swift_xla {
 
+// Returns whether the sparse XLA gather beats the dense comparison of every
+// index against the gathered dimension, according to the per device cost
+// model.
+bool IsSparseGatherByCost(const xla::Shape& input_shape,
+                          const xla::Shape& index_shape, xla::int64 dim);
+
+// Same as above for xla::TorchGather(), but measured instead when lowering
+// autotuning is enabled.
 bool IsSparseGather(xla::XlaOp input, xla::XlaOp index, xla::int64 dim);
 
 // For input_sizes and a potentially incomplete output_sizes, return a complete
@@ -0,0 +1,229 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/dynamic_batcher.h"
+
+#include <chrono>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_slice.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/shape_bucketing.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+xla::hash_t GetSignature(const std::string& key,
+                         absl::Span<const XLATensor> inputs) {
+  xla::hash_t hash = xla::util::MHash(key);
+  for (const XLATensor& input : inputs) {
+    xla::Shape shape = input.shape().get();
+    XLA_CHECK_GT(shape.rank(), 0) << "Batched inputs need a batch dimension";
+    shape.set_dimensions(0, 1);
+    hash = xla::util::HashCombine(
+        hash, xla::util::MHash(xla::ShapeUtil::HumanString(shape),
+                               input.GetDevice().ToString()));
+  }
+  return hash;
+}
+
+// Concatenates the values along dimension 0, and pads the result with zeros
+// up to batch_size.
+ir::Value MakeBatch(absl::Span<const ir::Value> values,
+                    xla::int64 batch_size) {
+  xla::Shape shape = values.front().shape();
+  xla::int64 size = 0;
+  for (const ir::Value& value : values) {
+    size += value.shape().dimensions(0);
+  }
+  shape.set_dimensions(0, batch_size);
+  auto lower_fn = [size, batch_size](
+                      const ir::Node& node,
+                      ir::LoweringContext* loctx) -> ir::XlaOpVector {
+    std::vector<xla::XlaOp> operands;
+    for (const ir::Output& operand : node.operands()) {
+      operands.push_back(loctx->GetOutputOp(operand));
+    }
+    xla::XlaOp batch = xla::ConcatInDim(loctx->builder(), operands, 0);
+    if (batch_size > size) {
+      xla::XlaOp zero =
+          xla::Zero(loctx->builder(), node.shape().element_type());
+      batch = xla::PadInDim(batch, zero, 0, 0, batch_size - size);
+    }
+    return node.ReturnOp(batch, loctx);
+  };
+  return ir::ops::GenericOp(ir::OpKind(at::aten::cat), values,
+                            std::move(shape), std::move(lower_fn),
+                            /*num_outputs=*/1, xla::util::MHash(batch_size));
+}
+
+}  // namespace
+
+DynamicBatcher::DynamicBatcher(Options options)
+    : options_(std::move(options)) {
+  XLA_CHECK_GT(options_.max_batch_size, 0);
+}
+
+DynamicBatcher* DynamicBatcher::Get() {
+  static DynamicBatcher* batcher = []() {
+    Options options;
+    options.max_batch_size = xla::sys_util::GetEnvInt(
+        "XLA_BATCHER_MAX_BATCH_SIZE", options.max_batch_size);
+    options.timeout_us = xla::sys_util::GetEnvInt("XLA_BATCHER_TIMEOUT_US",
+                                                  options.timeout_us);
+    return new DynamicBatcher(options);
+  }();
+  return batcher;
+}
+
+std::vector<XLATensor> DynamicBatcher::Run(const std::string& key,
+                                           std::vector<XLATensor> inputs,
+                                           const BatchFn& fn) {
+  XLA_CHECK(!inputs.empty());
+  auto request = std::make_shared<Request>();
+  request->batch_size = inputs.front().shape().get().dimensions(0);
+  for (const XLATensor& input : inputs) {
+    XLA_CHECK_EQ(input.shape().get().dimensions(0), request->batch_size)
+        << "Batched inputs must have the same batch size";
+  }
+  xla::hash_t signature = GetSignature(key, inputs);
+  request->inputs = std::move(inputs);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  Queue& queue = queues_[signature];
+  queue.pending.push_back(request);
+  queue.pending_size += request->batch_size;
+  cv_.notify_all();
+  while (!request->taken) {
+    if (queue.gathering) {
+      cv_.wait(lock, [&]() { return request->taken || !queue.gathering; });
+      continue;
+    }
+    // This call gathers the next batch, which is not necessarily the one
+    // holding its own request, when many are queued.
+    queue.gathering = true;
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::microseconds(options_.timeout_us);
+    cv_.wait_until(lock, deadline, [&]() {
+      return queue.pending_size >= options_.max_batch_size;
+    });
+    std::vector<std::shared_ptr<Request>> batch = TakeBatch(&queue);
+    queue.gathering = false;
+    cv_.notify_all();
+    lock.unlock();
+    ExecuteBatch(batch, fn);
+    lock.lock();
+    cv_.notify_all();
+  }
+  cv_.wait(lock, [&]() { return request->done; });
+  if (request->exptr != nullptr) {
+    std::rethrow_exception(request->exptr);
+  }
+  return std::move(request->outputs);
+}
+
+std::vector<std::shared_ptr<DynamicBatcher::Request>> DynamicBatcher::TakeBatch(
+    Queue* queue) {
+  std::vector<std::shared_ptr<Request>> batch;
+  xla::int64 batch_size = 0;
+  size_t count = 0;
+  for (; count < queue->pending.size(); ++count) {
+    const std::shared_ptr<Request>& request = queue->pending[count];
+    if (count > 0 &&
+        batch_size + request->batch_size > options_.max_batch_size) {
+      break;
+    }
+    request->taken = true;
+    batch_size += request->batch_size;
+    batch.push_back(request);
+  }
+  queue->pending.erase(queue->pending.begin(), queue->pending.begin() + count);
+  queue->pending_size -= batch_size;
+  return batch;
+}
+
+void DynamicBatcher::ExecuteBatch(
+    absl::Span<const std::shared_ptr<Request>> requests, const BatchFn& fn) {
+  std::vector<std::vector<XLATensor>> outputs(requests.size());
+  std::exception_ptr exptr;
+  try {
+    const std::vector<XLATensor>& first_inputs = requests.front()->inputs;
+    xla::int64 size = 0;
+    for (auto& request : requests) {
+      size += request->batch_size;
+    }
+    // The batch gets the size a host tensor of the batched shape would be
+    // bucketed to.
+    std::vector<xla::int64> dimensions = xla::util::ToVector<xla::int64>(
+        first_inputs.front().shape().get().dimensions());
+    dimensions[0] = size;
+    xla::int64 batch_size = GetBucketedDimensions(dimensions)[0];
+    XLA_COUNTER("DynamicBatches", 1);
+    XLA_VALUE_METRIC("DynamicBatchSize", size);
+    XLA_COUNTER("DynamicBatchPaddedExamples", batch_size - size);
+
+    std::vector<XLATensor> batch_inputs;
+    for (size_t i = 0; i < first_inputs.size(); ++i) {
+      std::vector<ir::Value> values;
+      for (auto& request : requests) {
+        values.push_back(request->inputs[i].GetIrValue());
+      }
+      batch_inputs.push_back(
+          first_inputs[i].CreateFrom(MakeBatch(values, batch_size)));
+    }
+    std::vector<XLATensor> batch_outputs = fn(batch_inputs);
+
+    std::vector<XLATensor> results;
+    xla::int64 offset = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+      for (const XLATensor& output : batch_outputs) {
+        const xla::Shape& shape = output.shape();
+        XLA_CHECK(shape.rank() > 0 && shape.dimensions(0) == batch_size)
+            << "Batched function output " << shape
+            << " has no batch dimension of size " << batch_size;
+        std::vector<xla::int64> start_indices(shape.rank(), 0);
+        std::vector<xla::int64> limit_indices =
+            xla::util::ToVector<xla::int64>(shape.dimensions());
+        std::vector<xla::int64> strides(shape.rank(), 1);
+        start_indices[0] = offset;
+        limit_indices[0] = offset + requests[i]->batch_size;
+        outputs[i].push_back(output.CreateFrom(ir::MakeNode<ir::ops::XlaSlice>(
+            output.GetIrValue(), std::move(start_indices),
+            std::move(limit_indices), std::move(strides))));
+        results.push_back(outputs[i].back());
+      }
+      offset += requests[i]->batch_size;
+    }
+    // A single graph computes the batch and slices it up.
+    XLATensor::SyncTensorsGraph(&results, /*devices=*/{}, /*wait=*/true,
+                                /*sync_xla_data=*/false);
+  } catch (...) {
+    exptr = std::current_exception();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < requests.size(); ++i) {
+    requests[i]->outputs = std::move(outputs[i]);
+    requests[i]->exptr = exptr;
+    requests[i]->done = true;
+  }
+  cv_.notify_all();
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+struct NmsResult {
+  xla::XlaOp selected_indices;
+  xla::XlaOp num_valid;
+};
+
+NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
+                   xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
+                   xla::int64 output_size);
+
+// Same as BuildNms(), without materializing the all-pairs IoU matrix. The boxes
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+
+// Coalesces the concurrent calls of a batch-polymorphic function, like the
+// forward pass of a served model, into a single execution. The callers, each
+// on its own thread and typically with a batch of one, get the inputs of the
+// calls waiting for the same function, key and input signature concatenated
+// along dimension 0, padded to the batch bucket of XLA_SHAPE_BUCKETS, so that
+// the batched graphs take a few sizes only and stay in the computation cache.
+// The function then runs once over the batch, and every caller gets its slice
+// of the outputs.
+class DynamicBatcher {
+ public:
+  // Maps inputs whose dimension 0 is the batch to outputs whose dimension 0 is
+  // the same batch, computing every example independently of the others.
+  using BatchFn =
+      std::function<std::vector<XLATensor>(const std::vector<XLATensor>&)>;
+
+  struct Options {
+    // The largest batch, in examples, executed at once.
+    xla::int64 max_batch_size = 32;
+    // How long the first call of a batch waits for others to join it.
+    xla::int64 timeout_us = 2000;
+  };
+
+  explicit DynamicBatcher(Options options);
+
+  // The batcher configured with XLA_BATCHER_MAX_BATCH_SIZE and
+  // XLA_BATCHER_TIMEOUT_US.
+  static DynamicBatcher* Get();
+
+  // Runs fn over inputs batched with the concurrent calls having the same key,
+  // and inputs with the same element types, device and shapes apart from
+  // dimension 0. The calls sharing a key must pass equivalent functions. Blocks
+  // until the batch ran, and returns the outputs for inputs, as device data.
+  std::vector<XLATensor> Run(const std::string& key,
+                             std::vector<XLATensor> inputs, const BatchFn& fn);
+
+ private:
+  struct Request {
+    std::vector<XLATensor> inputs;
+    xla::int64 batch_size = 0;
+    bool taken = false;
+    bool done = false;
+    std::vector<XLATensor> outputs;
+    std::exception_ptr exptr;
+  };
+
+  struct Queue {
+    std::vector<std::shared_ptr<Request>> pending;
+    xla::int64 pending_size = 0;
+    // Whether a call is gathering the next batch.
+    bool gathering = false;
+  };
+
+  // Removes from the queue the oldest requests fitting within a batch.
+  std::vector<std::shared_ptr<Request>> TakeBatch(Queue* queue);
+
+  void ExecuteBatch(absl::Span<const std::shared_ptr<Request>> requests,
+                    const BatchFn& fn);
+
+  Options options_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::unordered_map<xla::hash_t, Queue, xla::util::HashReducer> queues_;
+};
+
+}  // namespace swift_xla
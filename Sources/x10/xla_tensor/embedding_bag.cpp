@@ -0,0 +1,265 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/embedding_bag.h"
+
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/segment_reduction_ops.h"
+#include "tensorflow/compiler/xla/client/lib/comparators.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace {
+
+struct GatheredBags {
+  // The [B, L, D] gathered rows, scaled by the per sample weights.
+  xla::XlaOp rows;
+  // The [B, L] mask of the non padding indices.
+  xla::XlaOp valid;
+  // The [B] number of non padding indices of every bag.
+  xla::XlaOp counts;
+};
+
+// Gathers the rows of the [N, D] table selected by the rank 1 indices, either
+// with an index select or with a one-hot product running on the matrix units.
+xla::XlaOp GatherRows(xla::XlaOp table, xla::XlaOp flat_indices, bool dense) {
+  if (!dense) {
+    return xla::TorchIndexSelect(table, flat_indices, /*dim=*/0);
+  }
+  const xla::Shape& table_shape = XlaHelpers::ShapeOfXlaOp(table);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(flat_indices);
+  xla::XlaOp row_ids = xla::Iota(
+      table.builder(),
+      xla::ShapeUtil::MakeShape(
+          indices_shape.element_type(),
+          {indices_shape.dimensions(0), table_shape.dimensions(0)}),
+      1);
+  xla::XlaOp one_hot = xla::ConvertElementType(
+      xla::Eq(row_ids, flat_indices, {0}), table_shape.element_type());
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::Dot(one_hot, table, &precision_config);
+}
+
+GatheredBags GatherBags(xla::XlaOp table, xla::XlaOp indices,
+                        const absl::optional<xla::XlaOp>& per_sample_weights) {
+  const xla::Shape& table_shape = XlaHelpers::ShapeOfXlaOp(table);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  xla::PrimitiveType type = table_shape.element_type();
+  xla::int64 num_bags = indices_shape.dimensions(0);
+  xla::int64 bag_size = indices_shape.dimensions(1);
+  xla::int64 num_rows = table_shape.dimensions(0);
+  xla::int64 row_size = table_shape.dimensions(1);
+  xla::XlaBuilder* builder = table.builder();
+
+  xla::XlaOp valid = xla::Ge(
+      indices, xla::Zero(builder, indices_shape.element_type()));
+  xla::XlaOp flat_indices =
+      xla::Reshape(xla::Select(valid, indices, xla::ZerosLike(indices)),
+                   {num_bags * bag_size});
+  const xla::Shape& flat_indices_shape =
+      XlaHelpers::ShapeOfXlaOp(flat_indices);
+  auto build_fn = [&](xla::XlaBuilder* bench_builder, bool dense) {
+    xla::XlaOp bench_table = xla::Broadcast(xla::Zero(bench_builder, type),
+                                            table_shape.dimensions());
+    xla::XlaOp bench_indices = MakeBenchmarkIndices(
+        bench_builder, flat_indices_shape, /*dim=*/0, num_rows);
+    return GatherRows(bench_table, bench_indices, dense);
+  };
+  bool dense = UseDenseIndexedLowering(
+      "embedding_bag_gather", GetCurrentDevice(), table_shape,
+      flat_indices_shape, /*dim=*/0,
+      !IsSparseGatherByCost(table_shape, flat_indices_shape, /*dim=*/0),
+      build_fn);
+  xla::XlaOp rows = GatherRows(table, flat_indices, dense);
+  rows = xla::Reshape(rows, {num_bags, bag_size, row_size});
+  if (per_sample_weights) {
+    rows = xla::Mul(rows, xla::ConvertElementType(*per_sample_weights, type),
+                    {0, 1});
+  }
+  xla::XlaOp counts = xla::Reduce(xla::ConvertElementType(valid, type),
+                                  xla::Zero(builder, type),
+                                  XlaHelpers::CreateAddComputation(type), {1});
+  return {rows, valid, counts};
+}
+
+xla::XlaOp BroadcastBagMask(xla::XlaOp mask, const xla::Shape& rows_shape) {
+  return xla::BroadcastInDim(mask, rows_shape.dimensions(), {0, 1});
+}
+
+// Sums up the [N, D] rows of the repeated [N] indices, returning the unique
+// indices in increasing order, and their rows. Out of range indices are
+// dropped, and the trailing unused slots of the results get increasing out of
+// range indices.
+std::pair<xla::XlaOp, xla::XlaOp> DeduplicateRows(xla::XlaOp indices,
+                                                  xla::XlaOp rows,
+                                                  xla::int64 num_rows) {
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  const xla::Shape& rows_shape = XlaHelpers::ShapeOfXlaOp(rows);
+  xla::PrimitiveType index_type = indices_shape.element_type();
+  xla::int64 size = indices_shape.dimensions(0);
+  xla::XlaBuilder* builder = indices.builder();
+  xla::XlaOp positions = xla::Iota(builder, xla::PrimitiveType::S32, size);
+  xla::XlaOp sorted = xla::Sort(
+      {indices, positions},
+      xla::CreateScalarLtComputation({index_type, xla::PrimitiveType::S32},
+                                     builder));
+  xla::XlaOp sorted_indices = xla::GetTupleElement(sorted, 0);
+  xla::XlaOp sorted_rows =
+      xla::TorchIndexSelect(rows, xla::GetTupleElement(sorted, 1), /*dim=*/0);
+  // Every run of equal sorted indices becomes one segment.
+  xla::XlaOp starts_segment = xla::ConcatInDim(
+      builder,
+      {xla::ConstantR1<bool>(builder, {true}),
+       xla::Ne(xla::SliceInDim(sorted_indices, 1, size, 1, 0),
+               xla::SliceInDim(sorted_indices, 0, size - 1, 1, 0))},
+      0);
+  xla::XlaOp segment_ids =
+      BuildCumulativeComputation(
+          xla::ConvertElementType(starts_segment, xla::PrimitiveType::S32), 0,
+          XlaHelpers::CreateAddComputation(xla::PrimitiveType::S32),
+          xla::Zero(builder, xla::PrimitiveType::S32), /*exclusive=*/false,
+          /*reverse=*/false) -
+      xla::One(builder, xla::PrimitiveType::S32);
+  xla::XlaOp unique_rows = SortedSegmentReduce(
+      sorted_rows, segment_ids, xla::Zero(builder, rows_shape.element_type()),
+      size, [](xla::XlaOp a, xla::XlaOp b) { return a + b; });
+  xla::XlaOp out_of_range = XlaHelpers::ScalarValue<xla::int64>(
+      num_rows, index_type, builder);
+  xla::XlaOp unique_indices = SortedSegmentReduce(
+      sorted_indices, segment_ids, xla::MaxValue(builder, index_type), size,
+      [](xla::XlaOp a, xla::XlaOp b) { return xla::Min(a, b); });
+  xla::XlaOp unused_indices =
+      xla::Iota(builder, index_type, size) + out_of_range;
+  unique_indices = xla::Select(
+      xla::Lt(unique_indices, out_of_range), unique_indices, unused_indices);
+  return std::make_pair(unique_indices, unique_rows);
+}
+
+}  // namespace
+
+xla::XlaOp BuildEmbeddingBag(
+    xla::XlaOp table, xla::XlaOp indices,
+    const absl::optional<xla::XlaOp>& per_sample_weights,
+    EmbeddingBagMode mode) {
+  GatheredBags bags = GatherBags(table, indices, per_sample_weights);
+  const xla::Shape& rows_shape = XlaHelpers::ShapeOfXlaOp(bags.rows);
+  xla::PrimitiveType type = rows_shape.element_type();
+  xla::XlaBuilder* builder = table.builder();
+  xla::XlaOp valid = BroadcastBagMask(bags.valid, rows_shape);
+  if (mode == EmbeddingBagMode::kMax) {
+    xla::XlaOp lowest = xla::MinValue(builder, type);
+    xla::XlaOp maxima = xla::Reduce(
+        xla::Select(valid, bags.rows,
+                    xla::Broadcast(lowest, rows_shape.dimensions())),
+        lowest, XlaHelpers::CreateMaxComputation(type), {1});
+    xla::XlaOp nonempty = xla::Gt(bags.counts, xla::Zero(builder, type));
+    return xla::Select(
+        xla::BroadcastInDim(nonempty, XlaHelpers::SizesOfXlaOp(maxima), {0}),
+        maxima, xla::ZerosLike(maxima));
+  }
+  xla::XlaOp sums =
+      xla::Reduce(xla::Select(valid, bags.rows, xla::ZerosLike(bags.rows)),
+                  xla::Zero(builder, type),
+                  XlaHelpers::CreateAddComputation(type), {1});
+  if (mode == EmbeddingBagMode::kMean) {
+    return xla::Div(sums, xla::Max(bags.counts, xla::One(builder, type)), {0});
+  }
+  return sums;
+}
+
+xla::XlaOp BuildEmbeddingBagBackward(
+    xla::XlaOp grad_output, xla::XlaOp table, xla::XlaOp indices,
+    xla::XlaOp output, const absl::optional<xla::XlaOp>& per_sample_weights,
+    EmbeddingBagMode mode) {
+  const xla::Shape& table_shape = XlaHelpers::ShapeOfXlaOp(table);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  xla::PrimitiveType type = table_shape.element_type();
+  xla::int64 num_bags = indices_shape.dimensions(0);
+  xla::int64 bag_size = indices_shape.dimensions(1);
+  xla::int64 num_rows = table_shape.dimensions(0);
+  xla::int64 row_size = table_shape.dimensions(1);
+  xla::XlaBuilder* builder = table.builder();
+  std::vector<xla::int64> rows_sizes = {num_bags, bag_size, row_size};
+
+  xla::XlaOp valid = xla::Ge(
+      indices, xla::Zero(builder, indices_shape.element_type()));
+  xla::XlaOp grad = grad_output;
+  absl::optional<xla::XlaOp> slot_mask;
+  if (mode == EmbeddingBagMode::kMean) {
+    xla::XlaOp counts =
+        xla::Reduce(xla::ConvertElementType(valid, type),
+                    xla::Zero(builder, type),
+                    XlaHelpers::CreateAddComputation(type), {1});
+    grad = xla::Div(grad, xla::Max(counts, xla::One(builder, type)), {0});
+  } else if (mode == EmbeddingBagMode::kMax) {
+    // Only the first slot holding the maximum of a bag gets its gradient.
+    GatheredBags bags = GatherBags(table, indices, per_sample_weights);
+    xla::XlaOp is_max = xla::And(
+        xla::Eq(bags.rows, xla::BroadcastInDim(output, rows_sizes, {0, 2})),
+        BroadcastBagMask(bags.valid, XlaHelpers::ShapeOfXlaOp(bags.rows)));
+    xla::XlaOp slots = xla::Iota(
+        builder, xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, rows_sizes),
+        1);
+    xla::XlaOp no_slot = XlaHelpers::ScalarValue<xla::int64>(
+        bag_size, xla::PrimitiveType::S32, builder);
+    xla::XlaOp first_slots = xla::Reduce(
+        xla::Select(is_max, slots,
+                    xla::Broadcast(no_slot, rows_sizes)),
+        no_slot, XlaHelpers::CreateMinComputation(xla::PrimitiveType::S32),
+        {1});
+    slot_mask =
+        xla::Eq(slots, xla::BroadcastInDim(first_slots, rows_sizes, {0, 2}));
+  }
+  xla::XlaOp slot_grads = xla::BroadcastInDim(grad, rows_sizes, {0, 2});
+  if (slot_mask) {
+    slot_grads = xla::Select(*slot_mask, slot_grads,
+                             xla::ZerosLike(slot_grads));
+  }
+  if (per_sample_weights) {
+    slot_grads = xla::Mul(
+        slot_grads, xla::ConvertElementType(*per_sample_weights, type),
+        {0, 1});
+  }
+  // Padding slots get an out of range index, which the scatter drops.
+  xla::XlaOp flat_indices = xla::Reshape(
+      xla::Select(valid, indices,
+                  xla::Broadcast(XlaHelpers::ScalarValue<xla::int64>(
+                                     num_rows, indices_shape.element_type(),
+                                     builder),
+                                 indices_shape.dimensions())),
+      {num_bags * bag_size});
+  auto unique = DeduplicateRows(
+      flat_indices, xla::Reshape(slot_grads, {num_bags * bag_size, row_size}),
+      num_rows);
+
+  xla::ScatterDimensionNumbers dim_numbers;
+  dim_numbers.set_index_vector_dim(1);
+  dim_numbers.add_update_window_dims(1);
+  dim_numbers.add_inserted_window_dims(0);
+  dim_numbers.add_scatter_dims_to_operand_dims(0);
+  return xla::Scatter(
+      xla::Broadcast(xla::Zero(builder, type), table_shape.dimensions()),
+      xla::Reshape(unique.first, {num_bags * bag_size, 1}), unique.second,
+      XlaHelpers::CreateAddComputation(type), dim_numbers,
+      /*indices_are_sorted=*/true, /*unique_indices=*/true);
+}
+
+}  // namespace swift_xla
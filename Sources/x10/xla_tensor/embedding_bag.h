@@ -0,0 +1,47 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+enum class EmbeddingBagMode {
+  kSum,
+  kMean,
+  kMax,
+};
+
+// Gathers the table rows picked by every row of the [B, L] indices, and pools
+// each bag of L rows into a single one, for a [B, D] result given a [V, D]
+// table. Negative indices are padding, and empty bags pool to zero. When set,
+// the [B, L] per_sample_weights scale the gathered rows before the pooling.
+xla::XlaOp BuildEmbeddingBag(
+    xla::XlaOp table, xla::XlaOp indices,
+    const absl::optional<xla::XlaOp>& per_sample_weights,
+    EmbeddingBagMode mode);
+
+// The table gradient of BuildEmbeddingBag(), given its output. The gradient
+// rows of the repeated indices are summed up first, so that the scatter into
+// the table gradient has sorted, unique indices.
+xla::XlaOp BuildEmbeddingBagBackward(
+    xla::XlaOp grad_output, xla::XlaOp table, xla::XlaOp indices,
+    xla::XlaOp output, const absl::optional<xla::XlaOp>& per_sample_weights,
+    EmbeddingBagMode mode);
+
+}  // namespace swift_xla
@@ -0,0 +1,138 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/host_evaluation.h"
+
+#include <unordered_set>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/xla/service/hlo_evaluator.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+// The most elements a node of a tiny graph can have.
+constexpr xla::int64 kMaxNodeElements = 16;
+
+xla::int64 CountElements(const xla::Shape& shape) {
+  xla::int64 count = 0;
+  xla::ShapeUtil::ForEachSubshape(
+      shape, [&](const xla::Shape& subshape, const xla::ShapeIndex& index) {
+        if (subshape.IsArray()) {
+          count += xla::ShapeUtil::ElementsIn(subshape);
+        }
+      });
+  return count;
+}
+
+// Whether the results of the instruction are the same on the host as on the
+// device.
+bool IsHostEvaluable(const xla::HloInstruction& instruction) {
+  static const std::unordered_set<std::string>* device_opcodes =
+      new std::unordered_set<std::string>({
+          "all-gather", "all-reduce", "all-to-all", "collective-permute",
+          "custom-call", "infeed", "outfeed", "partition-id", "recv",
+          "recv-done", "reduce-scatter", "replica-id", "rng",
+          "rng-bit-generator", "rng-get-and-update-state", "send",
+          "send-done"});
+  return device_opcodes->count(xla::HloOpcodeString(instruction.opcode())) ==
+         0;
+}
+
+}  // namespace
+
+absl::optional<std::vector<xla::Literal>> EvaluateOnHost(
+    absl::Span<const Value> roots, const Device& device,
+    const HostValueFn& host_value_fn) {
+  static const size_t max_nodes =
+      xla::sys_util::GetEnvInt("XLA_HOST_EVALUATION_MAX_NODES", 32);
+  if (max_nodes == 0 || roots.empty()) {
+    return absl::nullopt;
+  }
+  std::vector<const Node*> root_nodes;
+  for (const Value& root : roots) {
+    root_nodes.push_back(root.node.get());
+  }
+  std::vector<const Node*> post_order = Util::ComputePostOrder(root_nodes);
+  if (post_order.size() > max_nodes) {
+    return absl::nullopt;
+  }
+  for (const Node* node : post_order) {
+    if (CountElements(node->shape()) > kMaxNodeElements) {
+      return absl::nullopt;
+    }
+  }
+
+  RootLoweringContext loctx("HostEvaluation", device);
+  for (const Value& root : roots) {
+    loctx.AddResult(loctx.GetOutputOp(root));
+  }
+  std::vector<xla::Literal> arguments;
+  for (const xla::ComputationClient::DataPtr& data :
+       loctx.GetParametersData()) {
+    absl::optional<xla::Literal> value = host_value_fn(*data);
+    if (!value) {
+      return absl::nullopt;
+    }
+    arguments.push_back(std::move(*value));
+  }
+  xla::StatusOr<xla::XlaComputation> computation = loctx.Build();
+  if (!computation.ok()) {
+    return absl::nullopt;
+  }
+  xla::ProgramShape program_shape =
+      ConsumeValue(computation.ValueOrDie().GetProgramShape());
+  xla::HloModuleConfig config(program_shape);
+  std::unique_ptr<xla::HloModule> module = ConsumeValue(
+      xla::HloModule::CreateFromProto(computation.ValueOrDie().proto(),
+                                      config));
+  for (const xla::HloComputation* hlo_computation : module->computations()) {
+    for (const xla::HloInstruction* instruction :
+         hlo_computation->instructions()) {
+      if (!IsHostEvaluable(*instruction)) {
+        return absl::nullopt;
+      }
+    }
+  }
+
+  std::vector<const xla::Literal*> argument_ptrs;
+  for (const xla::Literal& argument : arguments) {
+    argument_ptrs.push_back(&argument);
+  }
+  xla::HloEvaluator evaluator;
+  xla::StatusOr<xla::Literal> result =
+      evaluator.Evaluate(*module, argument_ptrs);
+  if (!result.ok()) {
+    return absl::nullopt;
+  }
+  std::vector<xla::Literal> values;
+  if (result.ValueOrDie().shape().IsTuple()) {
+    values = result.ValueOrDie().DecomposeTuple();
+  } else {
+    values.push_back(result.ConsumeValueOrDie());
+  }
+  XLA_CHECK_EQ(values.size(), roots.size());
+  XLA_COUNTER("HostEvaluatedGraphs", 1);
+  return values;
+}
+
+}  // namespace ir
+}  // namespace swift_xla
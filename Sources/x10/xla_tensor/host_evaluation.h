@@ -0,0 +1,48 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+namespace ir {
+
+// Returns the host copy of the value of device data, if there is one.
+using HostValueFn = std::function<absl::optional<xla::Literal>(
+    const xla::ComputationClient::Data&)>;
+
+// Evaluates tiny graphs, like the shape arithmetic, loop conditions and
+// learning rate schedules of the Swift code, with the HLO evaluator on the
+// host, instead of compiling them and running them on the device. Returns the
+// values of the roots, or nothing if the graph is not tiny: when it has more
+// than XLA_HOST_EVALUATION_MAX_NODES nodes, nodes of more than a few
+// elements, device data without a host copy, or ops whose results depend on
+// the device, like collectives and random numbers.
+absl::optional<std::vector<xla::Literal>> EvaluateOnHost(
+    absl::Span<const Value> roots, const Device& device,
+    const HostValueFn& host_value_fn);
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,210 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/host_fallback.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+using HostOpTable = std::map<DeviceType, std::unordered_set<std::string>>;
+
+const HostOpTable& GetHostOpTable() {
+  static const HostOpTable* table = []() {
+    HostOpTable* table = new HostOpTable();
+    std::string spec =
+        xla::sys_util::GetEnvString("XLA_HOST_FALLBACK_OPS", "");
+    for (absl::string_view entry :
+         absl::StrSplit(spec, ';', absl::SkipEmpty())) {
+      std::vector<std::string> parts = absl::StrSplit(entry, '=');
+      XLA_CHECK_EQ(parts.size(), 2)
+          << "Invalid XLA_HOST_FALLBACK_OPS entry: " << entry;
+      DeviceType hw_type = Device(absl::StrCat(parts[0], ":0")).hw_type;
+      for (absl::string_view op :
+           absl::StrSplit(parts[1], ',', absl::SkipEmpty())) {
+        (*table)[hw_type].insert(std::string(op));
+      }
+    }
+    return table;
+  }();
+  return *table;
+}
+
+bool HasHostDevice() {
+  static const bool has_host_device = []() {
+    std::vector<std::string> devices = xla::ComputationClient::AllDevices();
+    return std::find(devices.begin(), devices.end(), "CPU:0") !=
+           devices.end();
+  }();
+  return has_host_device;
+}
+
+// Maps the nodes which run on the host to their host clones, so that all the
+// outputs of a multi-output node come from the same host node.
+class HostClones {
+ public:
+  ir::NodePtr Get(const ir::NodePtr& node) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = clones_.find(node.get());
+    if (it == clones_.end() || it->second.node.lock() != node) {
+      return nullptr;
+    }
+    return it->second.clone;
+  }
+
+  void Put(const ir::NodePtr& node, ir::NodePtr clone) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Prune();
+    clones_[node.get()] = Entry{node, std::move(clone)};
+  }
+
+ private:
+  struct Entry {
+    std::weak_ptr<ir::Node> node;
+    ir::NodePtr clone;
+  };
+
+  void Prune() {
+    for (auto it = clones_.begin(); it != clones_.end();) {
+      it = it->second.node.expired() ? clones_.erase(it) : std::next(it);
+    }
+  }
+
+  std::mutex mutex_;
+  std::unordered_map<const ir::Node*, Entry> clones_;
+};
+
+// Maps the device data copied back from the host to the host tensors they
+// have been copied from.
+class HostMirrors {
+ public:
+  absl::optional<XLATensor> Get(const xla::ComputationClient::Data* data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = mirrors_.find(data);
+    if (it == mirrors_.end() || it->second.data.expired()) {
+      return absl::nullopt;
+    }
+    return it->second.host_tensor;
+  }
+
+  void Put(const xla::ComputationClient::DataPtr& data,
+           XLATensor host_tensor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = mirrors_.begin(); it != mirrors_.end();) {
+      it = it->second.data.expired() ? mirrors_.erase(it) : std::next(it);
+    }
+    mirrors_.emplace(data.get(), Entry{data, std::move(host_tensor)});
+  }
+
+ private:
+  struct Entry {
+    std::weak_ptr<xla::ComputationClient::Data> data;
+    XLATensor host_tensor;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<const xla::ComputationClient::Data*, Entry> mirrors_;
+};
+
+HostClones* GetHostClones() {
+  static HostClones* clones = new HostClones();
+  return clones;
+}
+
+HostMirrors* GetHostMirrors() {
+  static HostMirrors* mirrors = new HostMirrors();
+  return mirrors;
+}
+
+bool RunsOnHost(const ir::Node& node, const Device& device) {
+  const HostOpTable& table = GetHostOpTable();
+  if (table.empty() || device.hw_type == DeviceType::CPU) {
+    return false;
+  }
+  auto it = table.find(device.hw_type);
+  return it != table.end() && it->second.count(node.op().ToString()) > 0 &&
+         HasHostDevice() &&
+         xla::ComputationClient::GetReplicationDevices().empty();
+}
+
+ir::Value ToHost(const ir::Value& value, const Device& device,
+                 const Device& host_device) {
+  const ir::ops::DeviceData* device_data =
+      ir::ops::DeviceData::Cast(value.node.get());
+  if (device_data != nullptr) {
+    absl::optional<XLATensor> mirror =
+        GetHostMirrors()->Get(device_data->data().get());
+    if (mirror) {
+      XLA_COUNTER("HostFallbackSkippedTransfers", 1);
+      return mirror->GetIrValue();
+    }
+  }
+  XLA_COUNTER("HostFallbackTransfers", 1);
+  XLATensor tensor = XLATensor::Create(value, device);
+  return XLATensor::to(tensor, host_device, c10::nullopt).GetIrValue();
+}
+
+}  // namespace
+
+ir::Value MaybeRunOnHost(ir::Value ir_value, const Device& device,
+                         c10::optional<at::ScalarType> logical_element_type) {
+  if (!RunsOnHost(*ir_value.node, device)) {
+    return ir_value;
+  }
+  Device host_device(DeviceType::CPU, 0);
+  ir::NodePtr host_node = GetHostClones()->Get(ir_value.node);
+  if (host_node == nullptr) {
+    std::vector<ir::Value> host_operands;
+    const auto& operand_nodes = ir_value->operand_nodes();
+    for (size_t i = 0; i < operand_nodes.size(); ++i) {
+      host_operands.push_back(
+          ToHost(ir::Value(operand_nodes[i], ir_value->operand(i).index),
+                 device, host_device));
+    }
+    host_node = ir_value->Clone(host_operands);
+    GetHostClones()->Put(ir_value.node, host_node);
+    XLA_COUNTER("HostFallbackOps", 1);
+  }
+  XLATensor host_tensor =
+      XLATensor::Create(ir::Value(host_node, ir_value.index), host_device,
+                        logical_element_type);
+  XLA_COUNTER("HostFallbackTransfers", 1);
+  ir::Value device_value =
+      XLATensor::to(host_tensor, device, c10::nullopt).GetIrValue();
+  const ir::ops::DeviceData* device_data =
+      ir::ops::DeviceData::Cast(device_value.node.get());
+  if (device_data != nullptr) {
+    GetHostMirrors()->Put(device_data->data(), std::move(host_tensor));
+  }
+  return device_value;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// Moves the ops which are unsupported or slow on an accelerator to the CPU
+// device, following the placement table of XLA_HOST_FALLBACK_OPS, whose
+// format is TYPE=OP,...;TYPE=OP,... where TYPE is a device type, like TPU,
+// and OP a qualified op name, like xla::nms.
+//
+// The graph of the accelerator gets cut at the operands of such an op: they
+// are copied to the CPU device as soon as their pending computation ran, the
+// op is traced there, and its output is copied back, all of it asynchronously,
+// so that the accelerator graph using the output only waits for the copy. The
+// outputs of a multi-output op share the same host op, and the host ops
+// reading the outputs of other host ops read their host copies, so that chains
+// of host ops only copy their inputs and outputs.
+//
+// Returns the value standing for ir_value on device, which is ir_value itself
+// unless its op runs on the host.
+ir::Value MaybeRunOnHost(ir::Value ir_value, const Device& device,
+                         c10::optional<at::ScalarType> logical_element_type);
+
+}  // namespace swift_xla
@@ -0,0 +1,120 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/input_pipeline.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+namespace {
+
+// The number of IO closures collating a batch, each copying a contiguous range
+// of its samples.
+size_t GetCollationTasks(size_t batch_size) {
+  static const size_t max_tasks = std::max<size_t>(
+      xla::sys_util::GetEnvInt("XLA_INPUT_PIPELINE_COLLATION_TASKS", 8), 1);
+  return std::min(batch_size, max_tasks);
+}
+
+}  // namespace
+
+InputPipeline::InputPipeline(std::vector<Field> fields, const Device& device,
+                             size_t depth)
+    : fields_(std::move(fields)), device_(device), depth_(depth) {
+  XLA_CHECK(!fields_.empty());
+  XLA_CHECK_GT(depth_, 0);
+  for (const Field& field : fields_) {
+    sample_bytes_.push_back(at::GetLenFromShape(field.sample_dims) *
+                            at::internal::GetSizeof(field.scalar_type));
+  }
+}
+
+std::vector<at::Tensor> InputPipeline::Collate(
+    absl::Span<const void* const> samples, size_t batch_size) const {
+  std::vector<at::Tensor> batch;
+  std::vector<char*> staging;
+  for (const Field& field : fields_) {
+    std::vector<int64_t> dims = {static_cast<int64_t>(batch_size)};
+    dims.insert(dims.end(), field.sample_dims.begin(), field.sample_dims.end());
+    batch.push_back(AllocateTensor(field.scalar_type, std::move(dims)));
+    const void* data = batch.back().buffer().raw_data();
+    staging.push_back(static_cast<char*>(const_cast<void*>(data)));
+  }
+  size_t num_tasks = GetCollationTasks(batch_size);
+  size_t task_samples = (batch_size + num_tasks - 1) / num_tasks;
+  xla::util::MultiWait mwait(num_tasks);
+  for (size_t task = 0; task < num_tasks; ++task) {
+    size_t begin = task * task_samples;
+    size_t end = std::min(begin + task_samples, batch_size);
+    auto collate_fn = [&, begin, end]() {
+      for (size_t i = begin; i < end; ++i) {
+        for (size_t j = 0; j < fields_.size(); ++j) {
+          std::memcpy(staging[j] + i * sample_bytes_[j],
+                      samples[i * fields_.size() + j], sample_bytes_[j]);
+        }
+      }
+    };
+    xla::env::ScheduleIoClosure(mwait.Completer(std::move(collate_fn)));
+  }
+  mwait.Wait();
+  return batch;
+}
+
+void InputPipeline::Enqueue(absl::Span<const void* const> samples) {
+  XLA_CHECK_EQ(samples.size() % fields_.size(), 0);
+  size_t batch_size = samples.size() / fields_.size();
+  XLA_CHECK_GT(batch_size, 0);
+  std::vector<at::Tensor> batch = Collate(samples, batch_size);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (batches_.size() >= depth_) {
+      XLA_COUNTER("InputPipelineProducerWaits", 1);
+      cv_.wait(lock, [this] { return batches_.size() < depth_; });
+    }
+    // The transfers keep the staging buffers alive until they are done.
+    std::vector<XLATensor> tensors;
+    for (const at::Tensor& tensor : batch) {
+      tensors.push_back(XLATensor::Create(
+          TensorToXlaDataAsync(tensor, device_), tensor.scalar_type()));
+    }
+    batches_.push_back(std::move(tensors));
+  }
+  cv_.notify_all();
+  XLA_COUNTER("InputPipelineBatches", 1);
+}
+
+std::vector<XLATensor> InputPipeline::Dequeue() {
+  std::vector<XLATensor> tensors;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (batches_.empty()) {
+      XLA_COUNTER("InputPipelineStalls", 1);
+      cv_.wait(lock, [this] { return !batches_.empty(); });
+    }
+    tensors = std::move(batches_.front());
+    batches_.pop_front();
+  }
+  cv_.notify_all();
+  return tensors;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// The last stage of a host input pipeline. The samples get collated into
+// batches by the IO thread pool, every worker copying a range of samples into
+// the host staging buffers of the batch, whose uploads to the device then
+// start right away, with the device layout. The pipeline keeps at most depth
+// batches queued ahead of the steps consuming them, so the producer feeding it
+// blocks once it is that far ahead.
+class InputPipeline {
+ public:
+  // A tensor of every batch.
+  struct Field {
+    at::ScalarType scalar_type;
+    // The dimensions of a sample, the batch adding dimension 0.
+    std::vector<int64_t> sample_dims;
+  };
+
+  InputPipeline(std::vector<Field> fields, const Device& device, size_t depth);
+
+  // Collates a batch of samples, where samples[i * fields.size() + j] points
+  // to the contiguous elements of field j of sample i, and queues it. Blocks
+  // while depth batches are queued already. The samples are copied before it
+  // returns.
+  void Enqueue(absl::Span<const void* const> samples);
+
+  // Blocks until a batch is queued, and returns its tensors, one per field,
+  // whose data the computations wait on until their uploads are done.
+  std::vector<XLATensor> Dequeue();
+
+  size_t num_fields() const { return fields_.size(); }
+
+ private:
+  std::vector<at::Tensor> Collate(absl::Span<const void* const> samples,
+                                  size_t batch_size) const;
+
+  std::vector<Field> fields_;
+  std::vector<size_t> sample_bytes_;
+  Device device_;
+  size_t depth_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::vector<XLATensor>> batches_;
+};
+
+}  // namespace swift_xla
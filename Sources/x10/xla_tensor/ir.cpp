@@ -14,22 +14,94 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 
+#include <algorithm>
 #include <functional>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/remat_barrier.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
 
 namespace swift_xla {
 namespace ir {
 namespace {
 
 using ShapeCache =
-    xla::util::Cache<xla::hash_t, xla::Shape, xla::util::HashReducer>;
+    xla::util::Cache<xla::hash_t, const InternedShape, xla::util::HashReducer>;
+
+using ShapeBuckets =
+    std::unordered_map<xla::hash_t, std::vector<InternedShapePtr>,
+                       xla::util::HashReducer>;
+
+InternedShapePtr FindShape(const ShapeBuckets& buckets, xla::hash_t key,
+                           const xla::Shape& shape) {
+  auto it = buckets.find(key);
+  if (it != buckets.end()) {
+    for (auto& interned : it->second) {
+      if (interned->shape == shape) {
+        return interned;
+      }
+    }
+  }
+  return nullptr;
+}
+
+// The process wide pool of interned shapes, fronted by a per thread copy of
+// the entries each thread used, so that lookups do not need to lock.
+class ShapePool {
+ public:
+  static ShapePool* Get() {
+    static ShapePool* pool = new ShapePool();
+    return pool;
+  }
+
+  InternedShapePtr Intern(xla::Shape shape) {
+    static size_t max_size =
+        xla::sys_util::GetEnvInt("XLA_IR_SHAPE_POOL_SIZE", 65536);
+    thread_local ShapeBuckets* local_buckets = new ShapeBuckets();
+    xla::hash_t key = xla::util::ShapeHash(shape);
+    InternedShapePtr interned = FindShape(*local_buckets, key, shape);
+    if (interned != nullptr) {
+      return interned;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      interned = FindShape(buckets_, key, shape);
+      if (interned == nullptr) {
+        interned = MakeInternedShape(std::move(shape));
+        if (size_ >= max_size) {
+          XLA_COUNTER("IrShapePoolFull", 1);
+          return interned;
+        }
+        buckets_[key].push_back(interned);
+        ++size_;
+      }
+    }
+    (*local_buckets)[key].push_back(interned);
+    return interned;
+  }
+
+ private:
+  static InternedShapePtr MakeInternedShape(xla::Shape shape) {
+    auto interned = std::make_shared<InternedShape>();
+    interned->hash = xla::util::Hash(shape.ToString());
+    interned->shape = std::move(shape);
+    return interned;
+  }
+
+  std::mutex mutex_;
+  ShapeBuckets buckets_;
+  size_t size_ = 0;
+};
 
 struct ScapeEntry {
   std::string name;
@@ -39,29 +111,46 @@ struct ScapeEntry {
 struct ScopeContext {
   std::vector<ScapeEntry> scopes;
   size_t next_id = 1;
+  std::string current_scope;
 };
 
 thread_local ScopeContext g_scope_context;
 
+struct RematerializationContext {
+  size_t depth = 0;
+  // Set once a rematerialization scope has been entered by this thread, since
+  // only then newly traced nodes need their operands to be checked.
+  bool active = false;
+};
+
+thread_local RematerializationContext g_remat_context;
+
 void PushScope(const std::string& name) {
   size_t id = g_scope_context.next_id;
   g_scope_context.scopes.push_back(
       {absl::StrCat(name, ".", id), g_scope_context.next_id + 1});
   g_scope_context.next_id = 1;
+  UpdateCurrentScope();
 }
 
 void PopScope() {
   XLA_CHECK(!g_scope_context.scopes.empty());
   g_scope_context.next_id = g_scope_context.scopes.back().saved_next_id;
   g_scope_context.scopes.pop_back();
+  UpdateCurrentScope();
 }
 
+// The annotation scopes can span steps, like the one of a training loop
+// iteration, in which case the ids keep counting within the enclosing scope.
 void ResetScopeContext() {
-  XLA_CHECK_EQ(g_scope_context.scopes.size(), 0);
-  g_scope_context.next_id = 1;
+  if (g_scope_context.scopes.empty()) {
+    g_scope_context.next_id = 1;
+  }
 }
 
-std::string GetCurrentScope() {
+// The current scope is only rebuilt when pushing or popping scopes, since it
+// gets read for every node created.
+void UpdateCurrentScope() {
   std::string scope;
   for (auto& scope_entry : g_scope_context.scopes) {
     if (scope.empty()) {
@@ -70,18 +159,80 @@ std::string GetCurrentScope() {
       absl::StrAppend(&scope, "/", scope_entry.name);
     }
   }
-  return scope;
+  g_scope_context.current_scope = std::move(scope);
+}
+
+const std::string& GetCurrentScope() { return g_scope_context.current_scope; }
+
+bool ShouldCaptureFrames() {
+  thread_local xla::int64 node_count = 0;
+  return Node::s_capture_frames_ &&
+         node_count++ % Node::s_frames_sampling_ == 0;
 }
 
-ShapeCache* GetShapeCache() {
-  static xla::int64 shape_cache_size =
-      xla::sys_util::GetEnvInt("XLA_IR_SHAPE_CACHE_SIZE", 131072);
-  thread_local ShapeCache* cache = new ShapeCache(shape_cache_size);
-  return cache;
+using TracedNodes = std::unordered_map<xla::hash_t, std::weak_ptr<Node>,
+                                       xla::util::HashReducer>;
+
+TracedNodes* GetTracedNodes() {
+  thread_local TracedNodes* traced_nodes = new TracedNodes();
+  return traced_nodes;
+}
+
+bool IsSameNode(const Node& node1, const Node& node2) {
+  return node1.op() == node2.op() && node1.node_hash() == node2.node_hash() &&
+         node1.num_outputs() == node2.num_outputs() &&
+         &node1.shape() == &node2.shape() &&
+         node1.operands() == node2.operands();
 }
 
+// The shape inference results are shared by all the tracing threads. The
+// cache is split in shards, each with its own lock, to keep contention low,
+// and XLA_IR_SHAPE_CACHE_SIZE bounds the total number of entries.
+class ShardedShapeCache {
+ public:
+  static ShardedShapeCache* Get() {
+    static ShardedShapeCache* cache = new ShardedShapeCache(
+        xla::sys_util::GetEnvInt("XLA_IR_SHAPE_CACHE_SIZE", 131072));
+    return cache;
+  }
+
+  InternedShapePtr Get(const xla::hash_t& hash) {
+    InternedShapePtr shape = GetShard(hash)->Get(hash);
+    if (shape != nullptr) {
+      XLA_COUNTER("IrShapeCacheHit", 1);
+    } else {
+      XLA_COUNTER("IrShapeCacheMiss", 1);
+    }
+    return shape;
+  }
+
+  InternedShapePtr Add(const xla::hash_t& hash, InternedShapePtr shape) {
+    return GetShard(hash)->Add(hash, std::move(shape));
+  }
+
+ private:
+  static constexpr size_t kNumShards = 16;
+
+  explicit ShardedShapeCache(size_t max_size) {
+    size_t shard_size = std::max<size_t>(max_size / kNumShards, 1);
+    for (auto& shard : shards_) {
+      shard = absl::make_unique<ShapeCache>(shard_size);
+    }
+  }
+
+  ShapeCache* GetShard(const xla::hash_t& hash) {
+    return shards_[xla::util::HashReducer()(hash) % kNumShards].get();
+  }
+
+  std::unique_ptr<ShapeCache> shards_[kNumShards];
+};
+
 }  // namespace
 
+InternedShapePtr InternShape(xla::Shape shape) {
+  return ShapePool::Get()->Intern(std::move(shape));
+}
+
 size_t Output::Hasher::operator()(const Output& output) const {
   return xla::util::StdHashCombine(
       reinterpret_cast<std::ptrdiff_t>(output.node), output.index);
@@ -105,6 +256,13 @@ const xla::Shape& Value::shape() const { return node->shape(index); }
 
 const xla::Shape& Value::node_shape() const { return node->shape(); }
 
+InternedShapePtr Value::interned_shape() const {
+  if (node->shape().IsTuple()) {
+    return InternShape(shape());
+  }
+  return node->interned_shape();
+}
+
 xla::hash_t Value::hash() const {
   return xla::util::HashCombine(node->hash(), index);
 }
@@ -118,16 +276,29 @@ xla::hash_t OpKind::hash() const { return static_cast<c10::unique_t>(op); }
 bool Node::s_log_graph_changes_ =
     xla::sys_util::GetEnvInt("XLA_LOG_GRAPH_CHANGES", 0);
 
+bool Node::s_capture_frames_ =
+    Node::s_log_graph_changes_ ||
+    xla::sys_util::GetEnvBool("XLA_IR_CAPTURE_FRAMES", false);
+
+xla::int64 Node::s_frames_sampling_ = std::max<xla::int64>(
+    xla::sys_util::GetEnvInt("XLA_IR_FRAMES_SAMPLING", 1), 1);
+
 Node::Node(OpKind op, OpList operands, xla::Shape shape, size_t num_outputs,
            xla::hash_t hash_seed)
+    : Node(std::move(op), operands, InternShape(std::move(shape)), num_outputs,
+           hash_seed) {}
+
+Node::Node(OpKind op, OpList operands, InternedShapePtr shape,
+           size_t num_outputs, xla::hash_t hash_seed)
     : op_(std::move(op)),
       num_outputs_(num_outputs),
       shape_(std::move(shape)),
       node_hash_(xla::util::HashCombine(op_.hash(), hash_seed)),
-      hash_(node_hash_) {
+      hash_(node_hash_),
+      rematerialize_(g_remat_context.depth > 0) {
   metadata_.scope = GetCurrentScope();
-  if (s_log_graph_changes_) {
-    metadata_.frame_info = GetSwiftFrames();
+  if (ShouldCaptureFrames()) {
+    metadata_.raw_frames = CaptureRawFrames();
   }
   for (auto& operand : operands) {
     AddOperand(operand.node, operand.index);
@@ -138,8 +309,9 @@ Node::Node(OpKind op, OpList operands, xla::Shape shape, size_t num_outputs,
 Node::Node(OpKind op, OpList operands,
            const std::function<xla::Shape()>& shape_fn, size_t num_outputs,
            xla::hash_t hash_seed)
-    : Node(std::move(op), operands, xla::Shape(), num_outputs, hash_seed) {
-  // Forward the constructor to the one above (with empty shape), so we have the
+    : Node(std::move(op), operands, InternedShapePtr(), num_outputs,
+           hash_seed) {
+  // Forward the constructor to the one above (with no shape), so we have the
   // full hash information, then fetch/compute the real shape.
   shape_ = GetOpShape(shape_fn);
 }
@@ -148,21 +320,21 @@ Node::Node(OpKind op, xla::Shape shape, size_t num_outputs,
            xla::hash_t hash_seed)
     : op_(std::move(op)),
       num_outputs_(num_outputs),
-      shape_(std::move(shape)),
-      node_hash_(GetOpHash(op_, shape_, hash_seed)),
+      shape_(InternShape(std::move(shape))),
+      node_hash_(GetOpHash(op_, *shape_, hash_seed)),
       hash_(node_hash_) {
   metadata_.scope = GetCurrentScope();
-  if (s_log_graph_changes_) {
-    metadata_.frame_info = GetSwiftFrames();
+  if (ShouldCaptureFrames()) {
+    metadata_.raw_frames = CaptureRawFrames();
   }
 }
 
 const xla::Shape& Node::shape(size_t output_index) const {
-  if (shape_.IsTuple()) {
-    return shape_.tuple_shapes(output_index);
+  if (shape_->shape.IsTuple()) {
+    return shape_->shape.tuple_shapes(output_index);
   }
   XLA_CHECK_EQ(output_index, 0);
-  return shape_;
+  return shape_->shape;
 }
 
 void Node::AddOperand(NodePtr node, size_t index) {
@@ -200,6 +372,14 @@ std::string Node::ToString() const {
   return ss.str();
 }
 
+void Node::SetNodeHash(xla::hash_t node_hash) {
+  node_hash_ = node_hash;
+  hash_ = node_hash_;
+  for (auto& operand : operands_as_outputs_) {
+    hash_ = xla::util::HashCombine(hash_, operand.hash());
+  }
+}
+
 NodePtr Node::Clone(OpList operands) const {
   XLA_ERROR() << "Cloning not implemented for node: " << *this;
 }
@@ -208,20 +388,21 @@ XlaOpVector Node::Lower(LoweringContext* loctx) const {
   XLA_ERROR() << "Lowering not implemented for node: " << *this;
 }
 
-xla::hash_t Node::GetOpHash(OpKind op, const xla::Shape& shape,
+xla::hash_t Node::GetOpHash(OpKind op, const InternedShape& shape,
                             xla::hash_t hash_seed) {
-  xla::hash_t h =
-      xla::util::HashCombine(op.hash(), xla::util::Hash(shape.ToString()));
+  // The hash of the shape text is computed once per interned shape.
+  xla::hash_t h = xla::util::HashCombine(op.hash(), shape.hash);
   return xla::util::HashCombine(h, hash_seed);
 }
 
-xla::Shape Node::GetOpShape(const std::function<xla::Shape()>& shape_fn) const {
-  ShapeCache* shape_cache = GetShapeCache();
+InternedShapePtr Node::GetOpShape(
+    const std::function<xla::Shape()>& shape_fn) const {
+  ShardedShapeCache* shape_cache = ShardedShapeCache::Get();
   auto shape = shape_cache->Get(hash());
   if (shape == nullptr) {
-    shape = shape_cache->Add(hash(), std::make_shared<xla::Shape>(shape_fn()));
+    shape = shape_cache->Add(hash(), InternShape(shape_fn()));
   }
-  return *shape;
+  return shape;
 }
 
 ScopePusher::ScopePusher(const std::string& name) { PushScope(name); }
@@ -230,5 +411,125 @@ ScopePusher::~ScopePusher() { PopScope(); }
 
 void ScopePusher::ResetScopes() { ResetScopeContext(); }
 
+RematerializationScope::RematerializationScope() {
+  ++g_remat_context.depth;
+  g_remat_context.active = true;
+}
+
+RematerializationScope::~RematerializationScope() {
+  XLA_CHECK_GT(g_remat_context.depth, 0);
+  --g_remat_context.depth;
+}
+
+void RematerializationScope::KeepOutput(const Value& value) {
+  if (value) {
+    value.node->set_rematerialize(false);
+  }
+}
+
+bool RematerializationActive() { return g_remat_context.active; }
+
+NodePtr RematerializeOperands(NodePtr node) {
+  if (node->rematerialize() || g_remat_context.depth > 0) {
+    return node;
+  }
+  const auto& operand_nodes = node->operand_nodes();
+  auto it = std::find_if(
+      operand_nodes.begin(), operand_nodes.end(),
+      [](const NodePtr& operand) { return operand->rematerialize(); });
+  if (it == operand_nodes.end()) {
+    return node;
+  }
+  // The recomputation is tied to an operand which is not rematerialized (in
+  // the backward pass, usually the incoming gradient), so that it does not
+  // run any earlier than needed.
+  Value dependency;
+  for (size_t i = 0; i < operand_nodes.size(); ++i) {
+    if (!operand_nodes[i]->rematerialize()) {
+      dependency = Value(operand_nodes[i], node->operand(i).index);
+      break;
+    }
+  }
+  std::unordered_map<const Node*, NodePtr> clones;
+  OutputMap<Value> inputs;
+  std::function<Value(const Value&)> clone_value =
+      [&](const Value& value) -> Value {
+    if (!value.node->rematerialize()) {
+      if (!dependency || value.node->operands().empty()) {
+        return value;
+      }
+      Output output(value.node.get(), value.index);
+      auto input_it = inputs.find(output);
+      if (input_it == inputs.end()) {
+        input_it =
+            inputs
+                .emplace(output, MakeNode<ops::RematBarrier>(value, dependency))
+                .first;
+      }
+      return input_it->second;
+    }
+    auto clone_it = clones.find(value.node.get());
+    if (clone_it == clones.end()) {
+      std::vector<Value> operands;
+      const auto& value_operands = value.node->operand_nodes();
+      for (size_t i = 0; i < value_operands.size(); ++i) {
+        operands.push_back(clone_value(
+            Value(value_operands[i], value.node->operand(i).index)));
+      }
+      clone_it =
+          clones.emplace(value.node.get(), value.node->Clone(operands)).first;
+    }
+    return Value(clone_it->second, value.index);
+  };
+  std::vector<Value> operands;
+  for (size_t i = 0; i < operand_nodes.size(); ++i) {
+    operands.push_back(
+        clone_value(Value(operand_nodes[i], node->operand(i).index)));
+  }
+  XLA_COUNTER("RematerializedNodes", clones.size());
+  return node->Clone(operands);
+}
+
+bool TracedNodeReuseEnabled() {
+  static bool enabled = xla::sys_util::GetEnvBool("XLA_IR_NODE_REUSE", false);
+  return enabled;
+}
+
+NodePtr ReuseTracedNode(NodePtr node) {
+  // Leaf nodes, like the device data ones, carry an identity which is not
+  // part of their hash, and only non-leaf nodes can be matched by operands.
+  if (node->operands().empty()) {
+    return node;
+  }
+  static size_t max_size =
+      xla::sys_util::GetEnvInt("XLA_IR_NODE_REUSE_CACHE_SIZE", 1 << 20);
+  TracedNodes* traced_nodes = GetTracedNodes();
+  std::weak_ptr<Node>& traced = (*traced_nodes)[node->hash()];
+  NodePtr traced_node = traced.lock();
+  if (traced_node != nullptr && IsSameNode(*traced_node, *node)) {
+    XLA_COUNTER("IrNodeReused", 1);
+    return traced_node;
+  }
+  traced = node;
+  if (traced_nodes->size() > max_size) {
+    TrimTracedNodes();
+    if (traced_nodes->size() > max_size / 2) {
+      traced_nodes->clear();
+    }
+  }
+  return node;
+}
+
+void TrimTracedNodes() {
+  TracedNodes* traced_nodes = GetTracedNodes();
+  for (auto it = traced_nodes->begin(); it != traced_nodes->end();) {
+    if (it->second.expired()) {
+      it = traced_nodes->erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 }  // namespace ir
 }  // namespace swift_xla
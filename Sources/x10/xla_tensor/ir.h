@@ -28,8 +28,10 @@
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/node_allocator.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/swift_backtrace.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/xla_client/step_profiler.h"
 #include "tensorflow/compiler/xla/xla_client/types.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 
@@ -49,9 +51,28 @@ struct UserMetaData {
   virtual ~UserMetaData() {}
 };
 
+// An immutable shape, shared by all the IR nodes having it, along with the
+// hash of its text form.
+struct InternedShape {
+  xla::Shape shape;
+  xla::hash_t hash = 0;
+};
+
+using InternedShapePtr = std::shared_ptr<const InternedShape>;
+
+// Returns the interned copy of the shape, which becomes the one handed out
+// for all the shapes equal to it (up to XLA_IR_SHAPE_POOL_SIZE of them).
+InternedShapePtr InternShape(xla::Shape shape);
+
 struct MetaData {
+  // Symbolizes the frames captured when the node got created, if any.
+  std::vector<SourceLocation> frame_info() const {
+    return raw_frames.addresses.empty() ? std::vector<SourceLocation>()
+                                        : SymbolizeFrames(raw_frames);
+  }
+
   std::string scope;
-  std::vector<SourceLocation> frame_info;
+  RawFrames raw_frames;
 };
 
 // Represents a specific output produced by a node. Since the output of a node
@@ -110,6 +131,10 @@ struct Value {
   const xla::Shape& shape() const;
   const xla::Shape& node_shape() const;
 
+  // The interned form of shape(), which nodes taking the same shape as this
+  // value can share without going through the shape pool.
+  InternedShapePtr interned_shape() const;
+
   xla::hash_t hash() const;
 
   operator bool() const { return node != nullptr; }
@@ -166,6 +191,11 @@ class Node {
   Node(OpKind op, OpList operands, xla::Shape shape, size_t num_outputs = 1,
        xla::hash_t hash_seed = 0x5a2d296e9);
 
+  // Same as the constructor above, but takes a shape already interned, like
+  // the one of an operand, skipping the shape pool lookup.
+  Node(OpKind op, OpList operands, InternedShapePtr shape,
+       size_t num_outputs = 1, xla::hash_t hash_seed = 0x5a2d296e9);
+
   // Same as the constructor above, but the shape is generated by a function,
   // only if needed (shape cache miss).
   Node(OpKind op, OpList operands, const std::function<xla::Shape()>& shape_fn,
@@ -182,12 +212,15 @@ class Node {
 
   // Retrieves the full shape of the IR Node. Note that if this is a
   // multi-output node, the returned shape will be a tuple.
-  const xla::Shape& shape() const { return shape_; }
+  const xla::Shape& shape() const { return shape_->shape; }
 
   // Retrieves the shape of the output at a given index. If the node is not a
   // multi-output node, output_index must be zero.
   const xla::Shape& shape(size_t output_index) const;
 
+  // The interned form of shape().
+  const InternedShapePtr& interned_shape() const { return shape_; }
+
   const absl::InlinedVector<Output, 4>& operands() const {
     return operands_as_outputs_;
   }
@@ -204,6 +237,12 @@ class Node {
 
   const MetaData& metadata() const { return metadata_; }
 
+  // Whether the node has been traced within a rematerialization scope, and
+  // gets recomputed for its uses traced after the scope.
+  bool rematerialize() const { return rematerialize_; }
+
+  void set_rematerialize(bool rematerialize) { rematerialize_ = rematerialize; }
+
   virtual std::string ToString() const;
 
   virtual NodePtr Clone(OpList operands) const;
@@ -215,19 +254,26 @@ class Node {
   XlaOpVector ReturnOps(absl::Span<const xla::XlaOp> ops,
                         LoweringContext* loctx) const;
 
+ protected:
+  // Replaces the node hash derived from the op and hash seed, updating the
+  // graph hash accordingly. Used by nodes restored from a serialized graph,
+  // which keep the hash they were recorded with.
+  void SetNodeHash(xla::hash_t node_hash);
+
  private:
   // Adds node's index output number as operand.
   void AddOperand(NodePtr node, size_t index = 0);
 
-  xla::Shape GetOpShape(const std::function<xla::Shape()>& shape_fn) const;
+  InternedShapePtr GetOpShape(
+      const std::function<xla::Shape()>& shape_fn) const;
 
-  static xla::hash_t GetOpHash(OpKind op, const xla::Shape& shape,
+  static xla::hash_t GetOpHash(OpKind op, const InternedShape& shape,
                                xla::hash_t hash_seed);
 
   // The ID of the operation captured by this node.
   OpKind op_;
   size_t num_outputs_ = 1;
-  xla::Shape shape_;
+  InternedShapePtr shape_;
   // A node holds a real reference to its operands.
   absl::InlinedVector<NodePtr, 4> operands_;
   // Outputs do not hold references on the nodes, and neither do the uses, since
@@ -239,9 +285,14 @@ class Node {
   xla::hash_t hash_ = 0;
   // The IR specific metadata attached to the IR node.
   MetaData metadata_;
+  bool rematerialize_ = false;
 
  public:
   static bool s_log_graph_changes_;
+  // Nodes capture their creation frames one every s_frames_sampling_ nodes,
+  // if frames are captured at all.
+  static bool s_capture_frames_;
+  static xla::int64 s_frames_sampling_;
 };
 
 // RAII data structure to be used a stack variable to enter a new IR scope. IR
@@ -254,6 +305,37 @@ struct ScopePusher {
   static void ResetScopes();
 };
 
+// RAII data structure to be used a stack variable to enter a rematerialization
+// scope. The non-leaf nodes traced within the scope are not kept live for the
+// nodes traced after it (typically, the backward pass ones). Uses of them get a
+// recomputed copy of the scope subgraph instead. The values computed by the
+// scope for its own later uses (like the next layer) must be passed to
+// KeepOutput(), otherwise they get recomputed as well.
+struct RematerializationScope {
+  RematerializationScope();
+  ~RematerializationScope();
+
+  void KeepOutput(const Value& value);
+};
+
+bool RematerializationActive();
+
+// Replaces the operands of node which have been traced within a
+// rematerialization scope (while node was not) with recomputed copies.
+NodePtr RematerializeOperands(NodePtr node);
+
+// Steady state training re-traces the same op sequence every step. When
+// enabled (XLA_IR_NODE_REUSE), a newly traced non-leaf node which matches a
+// live node created by this thread, with the same hash, shape and operands,
+// is dropped in favor of the existing node, so that the subgraphs which did
+// not change since the last step are shared with it.
+NodePtr ReuseTracedNode(NodePtr node);
+
+bool TracedNodeReuseEnabled();
+
+// Drops the trace cache entries whose nodes are gone.
+void TrimTracedNodes();
+
 inline std::ostream& operator<<(std::ostream& stream, const Node& node) {
   stream << node.ToString();
   return stream;
@@ -261,7 +343,18 @@ inline std::ostream& operator<<(std::ostream& stream, const Node& node) {
 
 template <typename T, typename... Args>
 NodePtr MakeNode(Args&&... args) {
-  return std::make_shared<T>(std::forward<Args>(args)...);
+  XLA_STEP_TIMER(kTrace);
+  NodePtr node;
+  if (NodeArena::Enabled()) {
+    node = std::allocate_shared<T>(NodeAllocator<T>(),
+                                   std::forward<Args>(args)...);
+  } else {
+    node = std::make_shared<T>(std::forward<Args>(args)...);
+  }
+  if (RematerializationActive()) {
+    node = RematerializeOperands(std::move(node));
+  }
+  return TracedNodeReuseEnabled() ? ReuseTracedNode(std::move(node)) : node;
 }
 
 template <typename T>
@@ -314,7 +314,7 @@ std::string DumpUtil::GetGraphChangeLog(absl::Span<const Node* const> roots) {
     change_log_node.text = node_serializer.str();
     h = xla::util::HashCombine(h, xla::util::Hash(change_log_node.text));
     change_log_node.shape = node->shape();
-    change_log_node.backtrace = node->metadata().frame_info;
+    change_log_node.backtrace = node->metadata().frame_info();
     change_log.push_back(change_log_node);
   }
   std::stringstream ss;
@@ -0,0 +1,379 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_serialization.h"
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+// The graph is this header, the nodes in post order, then the roots. Integers
+// are LEB128 varints, except the node hashes, which are two fixed 64 bit words
+// in little endian order. Strings are prefixed by their varint size.
+constexpr char kGraphHeader[] = "X10IRG1";
+
+// The kind of the attributes following a node.
+enum class AttributeKind : char {
+  kNone,
+  kText,
+  kIntegralScalar,
+  kFloatingScalar,
+  kLiteral,
+  kParameter,
+};
+
+class Writer {
+ public:
+  void WriteVarint(std::uint64_t value) {
+    while (value >= 0x80) {
+      data_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    data_.push_back(static_cast<char>(value));
+  }
+
+  void WriteFixed64(std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      data_.push_back(static_cast<char>(value >> (8 * i)));
+    }
+  }
+
+  void WriteByte(char value) { data_.push_back(value); }
+
+  void WriteString(absl::string_view value) {
+    WriteVarint(value.size());
+    data_.append(value.data(), value.size());
+  }
+
+  // Writes the index of the value within the table, followed by the value
+  // itself the first time it is seen.
+  void WriteInterned(const std::string& value,
+                     std::unordered_map<std::string, size_t>* table) {
+    auto it = table->find(value);
+    if (it != table->end()) {
+      WriteVarint(it->second);
+      return;
+    }
+    WriteVarint(table->size());
+    WriteString(value);
+    table->emplace(value, table->size());
+  }
+
+  std::string Release() { return std::move(data_); }
+
+ private:
+  std::string data_;
+};
+
+class Reader {
+ public:
+  explicit Reader(absl::string_view data) : data_(data) {}
+
+  bool AtEnd() const { return position_ == data_.size(); }
+
+  std::uint64_t ReadVarint() {
+    std::uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      XLA_CHECK(shift < 64 && position_ < data_.size())
+          << "Corrupted serialized graph";
+      char byte = data_[position_++];
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+  }
+
+  std::uint64_t ReadFixed64() {
+    XLA_CHECK_LE(position_ + 8, data_.size()) << "Corrupted serialized graph";
+    std::uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+      value |= static_cast<std::uint64_t>(
+                   static_cast<unsigned char>(data_[position_++]))
+               << (8 * i);
+    }
+    return value;
+  }
+
+  char ReadByte() {
+    XLA_CHECK_LT(position_, data_.size()) << "Corrupted serialized graph";
+    return data_[position_++];
+  }
+
+  absl::string_view ReadString() {
+    size_t size = ReadVarint();
+    XLA_CHECK_LE(position_ + size, data_.size())
+        << "Corrupted serialized graph";
+    absl::string_view value = data_.substr(position_, size);
+    position_ += size;
+    return value;
+  }
+
+  // Reads a value written by Writer::WriteInterned(), parsing it with parse_fn
+  // the first time it is seen.
+  template <typename T, typename F>
+  const T& ReadInterned(std::vector<T>* table, const F& parse_fn) {
+    size_t index = ReadVarint();
+    if (index == table->size()) {
+      table->push_back(parse_fn(ReadString()));
+    }
+    XLA_CHECK_LT(index, table->size()) << "Corrupted serialized graph";
+    return (*table)[index];
+  }
+
+ private:
+  absl::string_view data_;
+  size_t position_ = 0;
+};
+
+// A node restored without its lowering, for the node types which are not
+// serialized with enough information to rebuild them.
+class DeserializedNode : public Node {
+ public:
+  DeserializedNode(OpKind op, OpList operands, xla::Shape shape,
+                   size_t num_outputs, xla::hash_t node_hash,
+                   std::string attributes)
+      : Node(std::move(op), operands, std::move(shape), num_outputs),
+        attributes_(std::move(attributes)) {
+    SetNodeHash(node_hash);
+  }
+
+  std::string ToString() const override {
+    return Node::ToString() + attributes_;
+  }
+
+  NodePtr Clone(OpList operands) const override {
+    return MakeNode<DeserializedNode>(op(), operands, shape(), num_outputs(),
+                                      node_hash(), attributes_);
+  }
+
+ private:
+  std::string attributes_;
+};
+
+void WriteHash(const xla::hash_t& hash, Writer* writer) {
+  writer->WriteFixed64(absl::Uint128Low64(hash));
+  writer->WriteFixed64(absl::Uint128High64(hash));
+}
+
+xla::hash_t ReadHash(Reader* reader) {
+  std::uint64_t low = reader->ReadFixed64();
+  return absl::MakeUint128(reader->ReadFixed64(), low);
+}
+
+// Returns the attributes of the node, as the part of its text form which
+// follows the text form of every node.
+std::string GetTextAttributes(const Node* node) {
+  std::string text = node->ToString();
+  std::string base_text = node->Node::ToString();
+  if (absl::StartsWith(text, base_text)) {
+    return text.substr(base_text.size());
+  }
+  return ", " + text;
+}
+
+void WriteAttributes(const Node* node,
+                     std::vector<xla::ComputationClient::DataPtr>* parameters,
+                     size_t* num_parameters, Writer* writer) {
+  const ops::DeviceData* device_data = ops::DeviceData::Cast(node);
+  if (device_data != nullptr) {
+    writer->WriteByte(static_cast<char>(AttributeKind::kParameter));
+    writer->WriteVarint((*num_parameters)++);
+    if (parameters != nullptr) {
+      parameters->push_back(device_data->data());
+    }
+    return;
+  }
+  const ops::Scalar* scalar = dynamic_cast<const ops::Scalar*>(node);
+  if (scalar != nullptr) {
+    if (scalar->value().isIntegral()) {
+      writer->WriteByte(static_cast<char>(AttributeKind::kIntegralScalar));
+      writer->WriteFixed64(scalar->value().toLong());
+    } else {
+      double value = scalar->value().toDouble();
+      std::uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      writer->WriteByte(static_cast<char>(AttributeKind::kFloatingScalar));
+      writer->WriteFixed64(bits);
+    }
+    return;
+  }
+  const ops::Constant* constant = dynamic_cast<const ops::Constant*>(node);
+  if (constant != nullptr) {
+    writer->WriteByte(static_cast<char>(AttributeKind::kLiteral));
+    writer->WriteString(constant->value().ToProto().SerializeAsString());
+    return;
+  }
+  std::string attributes = GetTextAttributes(node);
+  if (attributes.empty()) {
+    writer->WriteByte(static_cast<char>(AttributeKind::kNone));
+  } else {
+    writer->WriteByte(static_cast<char>(AttributeKind::kText));
+    writer->WriteString(attributes);
+  }
+}
+
+void CheckHeader(Reader* reader) {
+  absl::string_view header = reader->ReadString();
+  XLA_CHECK_EQ(header, kGraphHeader) << "Not a serialized graph";
+}
+
+}  // namespace
+
+std::string SerializationUtil::Serialize(
+    absl::Span<const Value> roots,
+    std::vector<xla::ComputationClient::DataPtr>* parameters) {
+  std::vector<const Node*> root_nodes;
+  for (const Value& root : roots) {
+    root_nodes.push_back(root.node.get());
+  }
+  std::vector<const Node*> post_order = Util::ComputePostOrder(root_nodes);
+
+  Writer writer;
+  writer.WriteString(kGraphHeader);
+  writer.WriteVarint(post_order.size());
+  std::unordered_map<std::string, size_t> ops;
+  std::unordered_map<std::string, size_t> shapes;
+  std::unordered_map<const Node*, size_t> node_indices;
+  size_t num_parameters = 0;
+  for (const Node* node : post_order) {
+    writer.WriteInterned(node->op().ToString(), &ops);
+    writer.WriteInterned(node->shape().ToProto().SerializeAsString(), &shapes);
+    writer.WriteVarint(node->num_outputs());
+    WriteHash(node->node_hash(), &writer);
+    writer.WriteVarint(node->operands().size());
+    for (const Output& operand : node->operands()) {
+      // Operands are mostly recent nodes, which makes the distance shorter
+      // than the index.
+      writer.WriteVarint(node_indices.size() - node_indices.at(operand.node));
+      writer.WriteVarint(operand.index);
+    }
+    WriteAttributes(node, parameters, &num_parameters, &writer);
+    node_indices.emplace(node, node_indices.size());
+  }
+  writer.WriteVarint(roots.size());
+  for (const Value& root : roots) {
+    writer.WriteVarint(node_indices.at(root.node.get()));
+    writer.WriteVarint(root.index);
+  }
+  return writer.Release();
+}
+
+std::vector<Value> SerializationUtil::Deserialize(
+    absl::string_view data,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters) {
+  Reader reader(data);
+  CheckHeader(&reader);
+  size_t num_nodes = reader.ReadVarint();
+  std::vector<OpKind> ops;
+  std::vector<xla::Shape> shapes;
+  std::vector<NodePtr> nodes;
+  for (size_t i = 0; i < num_nodes; ++i) {
+    OpKind op = reader.ReadInterned(&ops, [](absl::string_view name) {
+      return OpKind::Get(std::string(name));
+    });
+    xla::Shape shape = reader.ReadInterned(&shapes, [](absl::string_view data) {
+      xla::ShapeProto proto;
+      XLA_CHECK(proto.ParseFromArray(data.data(), data.size()))
+          << "Corrupted serialized graph";
+      return xla::Shape(proto);
+    });
+    size_t num_outputs = reader.ReadVarint();
+    xla::hash_t node_hash = ReadHash(&reader);
+    std::vector<Value> operands(reader.ReadVarint());
+    for (Value& operand : operands) {
+      size_t distance = reader.ReadVarint();
+      XLA_CHECK(distance > 0 && distance <= nodes.size())
+          << "Corrupted serialized graph";
+      operand.node = nodes[nodes.size() - distance];
+      operand.index = reader.ReadVarint();
+    }
+
+    NodePtr node;
+    std::string attributes;
+    switch (static_cast<AttributeKind>(reader.ReadByte())) {
+      case AttributeKind::kNone:
+        break;
+      case AttributeKind::kText:
+        attributes = std::string(reader.ReadString());
+        break;
+      case AttributeKind::kIntegralScalar:
+        node = MakeNode<ops::Scalar>(
+            static_cast<int64_t>(reader.ReadFixed64()), std::move(shape));
+        break;
+      case AttributeKind::kFloatingScalar: {
+        std::uint64_t bits = reader.ReadFixed64();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        node = MakeNode<ops::Scalar>(value, std::move(shape));
+        break;
+      }
+      case AttributeKind::kLiteral: {
+        xla::LiteralProto proto;
+        absl::string_view literal = reader.ReadString();
+        XLA_CHECK(proto.ParseFromArray(literal.data(), literal.size()))
+            << "Corrupted serialized graph";
+        node = MakeNode<ops::Constant>(
+            xla::Literal::CreateFromProto(proto).ConsumeValueOrDie());
+        break;
+      }
+      case AttributeKind::kParameter: {
+        size_t index = reader.ReadVarint();
+        if (!parameters.empty()) {
+          XLA_CHECK_LT(index, parameters.size())
+              << "Missing parameter for the serialized graph";
+          node = MakeNode<ops::DeviceData>(parameters[index]);
+        } else {
+          // Not restored as device data, which the lowering and the device
+          // data lookups would take for real data.
+          op = OpKind::Get("xla::placeholder");
+          attributes = absl::StrCat(", parameter=", index);
+        }
+        break;
+      }
+      default:
+        XLA_ERROR() << "Corrupted serialized graph";
+    }
+    if (node == nullptr) {
+      node = MakeNode<DeserializedNode>(std::move(op), operands,
+                                        std::move(shape), num_outputs,
+                                        node_hash, std::move(attributes));
+    }
+    nodes.push_back(std::move(node));
+  }
+
+  std::vector<Value> roots(reader.ReadVarint());
+  for (Value& root : roots) {
+    size_t index = reader.ReadVarint();
+    XLA_CHECK_LT(index, nodes.size()) << "Corrupted serialized graph";
+    root = Value(nodes[index], reader.ReadVarint());
+  }
+  XLA_CHECK(reader.AtEnd()) << "Corrupted serialized graph";
+  return roots;
+}
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+
+namespace swift_xla {
+namespace ir {
+
+// A compact binary form of IR graphs. Every node is stored once, in post
+// order, with its op kind and shape (each interned once per graph), its node
+// hash, its operand edges and its attributes. Device data nodes become
+// numbered parameter placeholders, scalars and constants keep their values, and
+// the attributes of the other nodes are kept in their text form.
+class SerializationUtil {
+ public:
+  // Serializes the graph rooted at the given values. The data of the parameter
+  // placeholders is appended, in placeholder order, to parameters if not null.
+  static std::string Serialize(
+      absl::Span<const Value> roots,
+      std::vector<xla::ComputationClient::DataPtr>* parameters = nullptr);
+
+  // Restores the roots of a serialized graph. The placeholders become device
+  // data nodes of the given parameters, which must then be as many as the
+  // placeholders, or xla::placeholder nodes when no parameters are given.
+  // Scalars, constants and device data restore to their own node types; the
+  // other nodes restore to nodes with the recorded op, shape, hash and
+  // attribute text, which can be hashed, dumped and cloned but not lowered.
+  static std::vector<Value> Deserialize(
+      absl::string_view data,
+      absl::Span<const xla::ComputationClient::DataPtr> parameters = {});
+};
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -14,6 +14,7 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_map.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 
@@ -79,6 +80,36 @@ std::vector<const Node*> Util::ComputePostOrder(
   return ComputePostOrder(nodes, &emap);
 }
 
+std::vector<const Node*> Util::ComputeLeafOrder(
+    absl::Span<const Node* const> nodes) {
+  // This mirrors the stack discipline of ComputePostOrder(), where leaves are
+  // emitted the first time they reach the top of the stack. Keeping the same
+  // visit order is what makes the leaf sequence match the post-order one.
+  std::vector<const Node*> leaves;
+  absl::flat_hash_set<const Node*> visited;
+  std::vector<const Node*> queue;
+  for (auto root : nodes) {
+    queue.push_back(root);
+    while (!queue.empty()) {
+      const Node* node = queue.back();
+      if (visited.insert(node).second) {
+        for (const auto& output : node->operands()) {
+          if (visited.find(output.node) == visited.end()) {
+            queue.push_back(output.node);
+          }
+        }
+        if (node->operands().empty()) {
+          leaves.push_back(node);
+          queue.pop_back();
+        }
+      } else {
+        queue.pop_back();
+      }
+    }
+  }
+  return leaves;
+}
+
 std::vector<Value> Util::Clone(absl::Span<const Value> values,
                                absl::Span<const Node* const> post_order) {
   absl::node_hash_map<const Node*, NodePtr> clone_map;
@@ -54,6 +54,12 @@ class Util {
   static std::vector<const Node*> ComputePostOrder(
       absl::Span<const Node* const> nodes);
 
+  // Returns the leaf nodes of the graph rooted at nodes, in the same order the
+  // ComputePostOrder() API would emit them, without building the full
+  // post-order and emission map.
+  static std::vector<const Node*> ComputeLeafOrder(
+      absl::Span<const Node* const> nodes);
+
   // Clones the IR graph whose roots are passed in the values parameter.
   static std::vector<Value> Clone(absl::Span<const Value> values);
 
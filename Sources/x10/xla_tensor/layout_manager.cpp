@@ -18,16 +18,20 @@
 #include <exception>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
 
 #include "absl/container/node_hash_map.h"
 #include "absl/strings/str_split.h"
+#include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 
 namespace swift_xla {
@@ -113,6 +117,77 @@ class LayoutManager {
   LayoutMap layouts_;
 };
 
+// Remembers the parameter layouts picked by the compiled executables, which
+// differ from the default ones.
+class LayoutAdvisor {
+ public:
+  static LayoutAdvisor* Get() {
+    static LayoutAdvisor* advisor = new LayoutAdvisor();
+    return advisor;
+  }
+
+  absl::optional<std::vector<xla::int64>> GetLayout(
+      absl::Span<const xla::int64> dimensions, xla::PrimitiveType type,
+      DeviceType device_type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (layouts_.empty()) {
+      return absl::nullopt;
+    }
+    auto it = layouts_.find(MakeKey(dimensions, type, device_type));
+    if (it == layouts_.end()) {
+      return absl::nullopt;
+    }
+    return it->second;
+  }
+
+  // Only the first layout recorded for a shape is kept. Otherwise graphs which
+  // prefer different layouts for the same shape would keep flipping it, and
+  // force each other to recompile.
+  bool Record(absl::Span<const xla::int64> dimensions, xla::PrimitiveType type,
+              DeviceType device_type, absl::Span<const xla::int64> layout) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return layouts_
+        .emplace(MakeKey(dimensions, type, device_type),
+                 std::vector<xla::int64>(layout.begin(), layout.end()))
+        .second;
+  }
+
+ private:
+  struct Key {
+    bool operator==(const Key& rhs) const {
+      return type == rhs.type && device_type == rhs.device_type &&
+             dimensions == rhs.dimensions;
+    }
+
+    std::vector<xla::int64> dimensions;
+    xla::PrimitiveType type;
+    DeviceType device_type;
+  };
+
+  struct KeyHasher {
+    size_t operator()(const Key& key) const {
+      return xla::util::HashReduce(
+          xla::util::MHash(key.dimensions, static_cast<int>(key.type),
+                           static_cast<int>(key.device_type)));
+    }
+  };
+
+  static Key MakeKey(absl::Span<const xla::int64> dimensions,
+                     xla::PrimitiveType type, DeviceType device_type) {
+    return {std::vector<xla::int64>(dimensions.begin(), dimensions.end()),
+            type, device_type};
+  }
+
+  std::mutex mutex_;
+  std::unordered_map<Key, std::vector<xla::int64>, KeyHasher> layouts_;
+};
+
+bool UseLayoutAdvisor() {
+  static const bool use_advisor =
+      xla::sys_util::GetEnvBool("XLA_LAYOUT_ADVISOR", true);
+  return use_advisor;
+}
+
 double PaddingFactor(xla::int64 size, int padding) {
   int rem = static_cast<int>(size % padding);
   return 1.0 + (rem > 0 ? static_cast<double>(padding - rem) /
@@ -169,6 +244,18 @@ xla::Shape MakeShapeWithLayout(xla::PrimitiveType type,
   return shape;
 }
 
+// The shape picked for the device type, when no layout is forced by XLA_LAYOUTS
+// or recorded from the compiled executables.
+xla::Shape MakeDefaultArrayShape(absl::Span<const xla::int64> dimensions,
+                                 absl::Span<const bool> dynamic_dimensions,
+                                 xla::PrimitiveType type,
+                                 DeviceType device_type) {
+  if (dimensions.size() > 1 && device_type == DeviceType::TPU) {
+    return MakeTpuShape(dimensions, dynamic_dimensions, type);
+  }
+  return MakeSwiftTensorLayout(dimensions, dynamic_dimensions, type);
+}
+
 }  // namespace
 
 xla::Shape MakeSwiftTensorLayout(absl::Span<const xla::int64> dimensions,
@@ -189,10 +276,36 @@ xla::Shape MakeArrayShapeFromDimensions(
     return MakeShapeWithLayout(type, dimensions, dynamic_dimensions,
                                *layout_ptr);
   }
-  if (dimensions.size() > 1 && device_type == DeviceType::TPU) {
-    return MakeTpuShape(dimensions, dynamic_dimensions, type);
+  if (dimensions.size() > 1 && UseLayoutAdvisor()) {
+    absl::optional<std::vector<xla::int64>> layout =
+        LayoutAdvisor::Get()->GetLayout(dimensions, type, device_type);
+    if (layout) {
+      return MakeShapeWithLayout(type, dimensions, dynamic_dimensions,
+                                 *layout);
+    }
+  }
+  return MakeDefaultArrayShape(dimensions, dynamic_dimensions, type,
+                               device_type);
+}
+
+void RecordParameterLayout(const xla::Shape& shape, DeviceType device_type) {
+  if (!UseLayoutAdvisor() || !shape.IsArray() || shape.rank() < 2 ||
+      !shape.has_layout() || !shape.is_static() ||
+      LayoutManager::Get()->GetLayout(shape.dimensions()) != nullptr) {
+    return;
+  }
+  xla::Shape default_shape = MakeDefaultArrayShape(
+      shape.dimensions(), {}, shape.element_type(), device_type);
+  if (xla::LayoutUtil::Equal(shape.layout(), default_shape.layout())) {
+    return;
+  }
+  if (LayoutAdvisor::Get()->Record(shape.dimensions(), shape.element_type(),
+                                   device_type,
+                                   shape.layout().minor_to_major())) {
+    XLA_COUNTER("AdvisedLayouts", 1);
+    TF_VLOG(2) << "Uploading " << default_shape << " with compiled layout "
+               << shape;
   }
-  return MakeSwiftTensorLayout(dimensions, dynamic_dimensions, type);
 }
 
 }  // namespace swift_xla
@@ -38,4 +38,11 @@ xla::Shape MakeArrayShapeFromDimensions(
     absl::Span<const bool> dynamic_dimensions, xla::PrimitiveType type,
     DeviceType device_type);
 
+// Records the layout a compiled executable for the device type wants one of its
+// parameters in. When it differs from the one MakeArrayShapeFromDimensions()
+// picks, later calls for the same dimensions and type return it, so that the
+// tensors are uploaded in the layout the executables expect rather than being
+// relaid out on the device at every step.
+void RecordParameterLayout(const xla::Shape& shape, DeviceType device_type);
+
 }  // namespace swift_xla
@@ -0,0 +1,186 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace swift_xla {
+namespace {
+
+struct AutotunerState {
+  std::mutex lock;
+  // Whether the choices stored in the cache file have been loaded.
+  bool loaded = false;
+  // Maps a key to whether the dense lowering won.
+  std::unordered_map<std::string, bool> choices;
+};
+
+AutotunerState* GetAutotunerState() {
+  static AutotunerState* state = new AutotunerState();
+  return state;
+}
+
+const std::string& GetCachePath() {
+  static const std::string* path = new std::string(
+      xla::sys_util::GetEnvString("XLA_LOWERING_AUTOTUNE_CACHE", ""));
+  return *path;
+}
+
+// The cache file has one "<key> dense|sparse" line per choice.
+void LoadChoices(AutotunerState* state) {
+  state->loaded = true;
+  if (GetCachePath().empty()) {
+    return;
+  }
+  std::ifstream cache_file(GetCachePath());
+  std::string line;
+  while (std::getline(cache_file, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    std::string lowering;
+    if (fields >> key >> lowering) {
+      state->choices[key] = lowering == "dense";
+    }
+  }
+  TF_VLOG(2) << "Loaded " << state->choices.size()
+             << " lowering choices from " << GetCachePath();
+}
+
+void StoreChoice(const std::string& key, bool dense) {
+  if (GetCachePath().empty()) {
+    return;
+  }
+  std::ofstream cache_file(GetCachePath(), std::ios_base::app);
+  cache_file << key << " " << (dense ? "dense" : "sparse") << "\n";
+}
+
+std::string GetKey(const std::string& op_name, const Device& device,
+                   const xla::Shape& input_shape,
+                   const xla::Shape& index_shape, xla::int64 dim) {
+  return absl::StrCat(op_name, ":", xla::util::GetEnumValue(device.hw_type),
+                      ":", xla::ShapeUtil::HumanString(input_shape), ":",
+                      xla::ShapeUtil::HumanString(index_shape), ":", dim);
+}
+
+bool CanBenchmark(const xla::Shape& input_shape,
+                  const xla::Shape& index_shape) {
+  static xla::int64 max_bytes = xla::sys_util::GetEnvInt(
+      "XLA_LOWERING_AUTOTUNE_MAX_BYTES", 256 << 20);
+  return xla::ShapeUtil::ByteSizeOf(input_shape) +
+             xla::ShapeUtil::ByteSizeOf(index_shape) <=
+         max_bytes;
+}
+
+// Returns the fastest wall time of a few runs of the computation built by
+// build_fn, after a warm up one.
+xla::int64 BenchmarkNs(const Device& device,
+                       const IndexedLoweringBuilder& build_fn, bool dense) {
+  static int runs =
+      std::max<int>(xla::sys_util::GetEnvInt("XLA_LOWERING_AUTOTUNE_RUNS", 5),
+                    1);
+  xla::XlaBuilder builder(dense ? "DenseLoweringBenchmark"
+                                : "SparseLoweringBenchmark");
+  build_fn(&builder, dense);
+  xla::XlaComputation computation = ConsumeValue(builder.Build());
+  xla::ComputationClient::Device* x10_device = xla::GetX10Device(device);
+  std::vector<xla::ComputationClient::CompileInstance> instances;
+  instances.emplace_back(std::move(computation), /*output_shape=*/nullptr);
+  auto computations = x10_device->Compile(
+      xla::ComputationClient::GetCompilationDevices(device.ToString(), {}),
+      std::move(instances));
+  xla::ComputationClient::ExecuteComputationOptions options;
+  x10_device->ExecuteComputation(*computations.front(), {}, options);
+  xla::int64 best_ns = std::numeric_limits<xla::int64>::max();
+  for (int i = 0; i < runs; ++i) {
+    xla::int64 start_ns = xla::sys_util::NowNs();
+    x10_device->ExecuteComputation(*computations.front(), {}, options);
+    best_ns = std::min(best_ns, xla::sys_util::NowNs() - start_ns);
+  }
+  return best_ns;
+}
+
+}  // namespace
+
+bool UseDenseIndexedLowering(const std::string& op_name, const Device& device,
+                             const xla::Shape& input_shape,
+                             const xla::Shape& index_shape, xla::int64 dim,
+                             bool cost_model_dense,
+                             const IndexedLoweringBuilder& build_fn) {
+  static bool autotune =
+      xla::sys_util::GetEnvBool("XLA_LOWERING_AUTOTUNE", false);
+  if (!autotune) {
+    return cost_model_dense;
+  }
+  std::string key = GetKey(op_name, device, input_shape, index_shape, dim);
+  AutotunerState* state = GetAutotunerState();
+  // Lowerings are rare enough that benchmarking under the lock, which keeps
+  // concurrent lowerings from timing the same key twice, costs nothing.
+  std::lock_guard<std::mutex> lock(state->lock);
+  if (!state->loaded) {
+    LoadChoices(state);
+  }
+  auto it = state->choices.find(key);
+  if (it != state->choices.end()) {
+    return it->second;
+  }
+  if (!CanBenchmark(input_shape, index_shape)) {
+    return cost_model_dense;
+  }
+  XLA_COUNTER("LoweringAutotuneBenchmarks", 1);
+  xla::int64 dense_ns = BenchmarkNs(device, build_fn, /*dense=*/true);
+  xla::int64 sparse_ns = BenchmarkNs(device, build_fn, /*dense=*/false);
+  bool dense = dense_ns < sparse_ns;
+  TF_VLOG(1) << "Lowering autotune of " << key << ": dense=" << dense_ns
+             << "ns, sparse=" << sparse_ns << "ns";
+  state->choices.emplace(key, dense);
+  StoreChoice(key, dense);
+  return dense;
+}
+
+xla::XlaOp MakeBenchmarkIndices(xla::XlaBuilder* builder,
+                                const xla::Shape& index_shape, xla::int64 dim,
+                                xla::int64 dim_size) {
+  // Spreads the indices over the whole dimension, since a sparse lowering
+  // of repeated indices would be unfairly cache friendly.
+  xla::XlaOp positions = xla::Iota(
+      builder,
+      xla::ShapeUtil::MakeShape(index_shape.element_type(),
+                                index_shape.dimensions()),
+      dim);
+  xla::XlaOp stride = XlaHelpers::ScalarValue<xla::int64>(
+      std::max<xla::int64>(dim_size / std::max<xla::int64>(
+                                          index_shape.dimensions(dim), 1),
+                           1),
+      index_shape.element_type(), builder);
+  xla::XlaOp size = XlaHelpers::ScalarValue<xla::int64>(
+      dim_size, index_shape.element_type(), builder);
+  return xla::Rem(positions * stride, size);
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// Builds a benchmark computation of an indexed operation into the given
+// builder, with the dense lowering if the flag is set, the sparse one
+// otherwise.
+using IndexedLoweringBuilder =
+    std::function<xla::XlaOp(xla::XlaBuilder*, bool dense)>;
+
+// Returns whether the op_name gather or scatter, along dim of input_shape with
+// indices of index_shape, should use its dense lowering on the given device.
+//
+// With XLA_LOWERING_AUTOTUNE set, the first request for every (op, shapes,
+// device type) key compiles build_fn with both lowerings, times them on the
+// device and keeps the fastest one, which is also appended to the
+// XLA_LOWERING_AUTOTUNE_CACHE file, if set, so that later processes reuse it.
+// Otherwise, or when the operands are too large to be benchmarked,
+// cost_model_dense is returned.
+bool UseDenseIndexedLowering(const std::string& op_name, const Device& device,
+                             const xla::Shape& input_shape,
+                             const xla::Shape& index_shape, xla::int64 dim,
+                             bool cost_model_dense,
+                             const IndexedLoweringBuilder& build_fn);
+
+// Returns valid benchmark indices of the given shape, pointing within a
+// dim_size sized dim.
+xla::XlaOp MakeBenchmarkIndices(xla::XlaBuilder* builder,
+                                const xla::Shape& index_shape, xla::int64 dim,
+                                xla::int64 dim_size);
+
+}  // namespace swift_xla
@@ -0,0 +1,459 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of the alternative lowerings of the ops whose lowering is chosen
+// by a heuristic, over sweeps of their shapes:
+// - gather and scatter: the dense comparison of every index against the
+//   indexed dimension, and the sparse XLA gather and scatter, as the indexed
+//   dimension grows;
+// - resize and resize_backward: the interpolation matrix products, and the
+//   TPU resize kernel in one call or one dimension at a time, as the scale
+//   factor grows;
+// - nms: the all-pairs IoU matrix, and the tiled suppression over several tile
+//   sizes, as the number of boxes grows;
+// - avg_pool and max_pool: the NCHW pooling of pooling.cpp, which also
+//   computes the max indices, and the plain XLA pooling in NCHW and NHWC, as
+//   the number of channels grows.
+// Every alternative is compiled and run on every device of
+// X10_LOWERING_BENCHMARK_DEVICES (comma separated, the default device by
+// default), the TPU kernels only on TPU devices. The report lists per sweep
+// point the time per run of every alternative, the fastest one and, when the
+// op has one, the time of the lowering the current heuristic picks. The
+// crossover points, where the fastest alternative changes, are listed last.
+//
+// Usage: x10_lowering_benchmark [substring of the op names to run]
+// X10_BENCHMARK_MIN_SECONDS sets the minimum time spent running every
+// alternative.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/nms_op.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/pooling.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/resize_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/xla_lower_util.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/pooling.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+using DataPtr = xla::ComputationClient::DataPtr;
+using BuildFn = std::function<xla::XlaOp(
+    xla::XlaBuilder*, const std::vector<xla::XlaOp>& parameters)>;
+
+struct Alternative {
+  std::string name;
+  BuildFn build_fn;
+  bool tpu_only = false;
+};
+
+// A point of the sweep of an op: the shapes of its parameters, its lowerings,
+// and the one the heuristic picks, if any.
+struct SweepPoint {
+  std::string label;
+  std::vector<xla::Shape> parameter_shapes;
+  std::vector<Alternative> alternatives;
+  BuildFn model_fn;
+};
+
+struct Crossover {
+  std::string op;
+  std::string device;
+  std::string from_label;
+  std::string to_label;
+  std::string from_best;
+  std::string to_best;
+};
+
+double GetMinSeconds() {
+  static const double min_seconds =
+      xla::sys_util::GetEnvDouble("X10_BENCHMARK_MIN_SECONDS", 0.2);
+  return min_seconds;
+}
+
+xla::Shape F32Shape(absl::Span<const xla::int64> dimensions) {
+  return xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32, dimensions);
+}
+
+// Fills the floating point parameters with a deterministic spread of values in
+// [0, 1), so that data dependent lowerings like the suppression do some work.
+DataPtr TransferParameter(xla::ComputationClient::Device* device,
+                          const xla::Shape& shape) {
+  xla::ComputationClient::TensorSource source(
+      shape, [](const xla::ComputationClient::TensorSource& source,
+                void* buffer, size_t size) {
+        if (source.shape.element_type() != xla::PrimitiveType::F32) {
+          std::memset(buffer, 0, size);
+          return;
+        }
+        float* values = static_cast<float*>(buffer);
+        for (size_t i = 0; i < size / sizeof(float); ++i) {
+          values[i] = static_cast<float>((i * 2654435761u) % 1000) / 1000;
+        }
+      });
+  return device->TransferToServer({source}).front();
+}
+
+// Returns the seconds per run of the computation built by build_fn.
+double TimeLowering(xla::ComputationClient::Device* device,
+                    const SweepPoint& point, const BuildFn& build_fn,
+                    const std::vector<DataPtr>& arguments) {
+  xla::XlaBuilder builder("LoweringBenchmark");
+  std::vector<xla::XlaOp> parameters;
+  for (size_t i = 0; i < point.parameter_shapes.size(); ++i) {
+    parameters.push_back(xla::Parameter(&builder, i, point.parameter_shapes[i],
+                                        absl::StrCat("p", i)));
+  }
+  xla::XlaComputation computation =
+      builder.Build(build_fn(&builder, parameters)).ValueOrDie();
+  std::vector<xla::ComputationClient::CompileInstance> instances;
+  instances.emplace_back(std::move(computation), /*output_shape=*/nullptr);
+  xla::ComputationClient::ComputationPtr compiled =
+      device->Compile({device->name()}, std::move(instances)).front();
+
+  using Clock = std::chrono::steady_clock;
+  auto run = [&]() {
+    std::vector<DataPtr> results = device->ExecuteComputation(
+        *compiled, arguments,
+        xla::ComputationClient::ExecuteComputationOptions());
+    device->WaitForTransfers(results);
+  };
+  run();
+  size_t runs = 0;
+  size_t batch = 1;
+  double seconds = 0;
+  while (seconds < GetMinSeconds()) {
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < batch; ++i) {
+      run();
+    }
+    seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    runs += batch;
+    batch *= 2;
+  }
+  return seconds / runs;
+}
+
+// Runs the sweep of op on the device, and appends the points where the fastest
+// alternative changes to crossovers.
+void RunSweep(const std::string& op, const std::string& device_name,
+              const std::vector<SweepPoint>& points,
+              std::vector<Crossover>* crossovers) {
+  xla::ComputationClient::Device* device = xla::GetX10Device(device_name);
+  Device device_id(device_name);
+  bool is_tpu = device_id.hw_type == DeviceType::TPU ||
+                device_id.hw_type == DeviceType::REMOTE_TPU;
+  // The heuristics look at the current device.
+  SetCurrentDevice(device_id);
+
+  std::vector<std::string> header = {"op", "device", "point"};
+  for (const Alternative& alternative : points.front().alternatives) {
+    if (is_tpu || !alternative.tpu_only) {
+      header.push_back(alternative.name + "_us");
+    }
+  }
+  header.push_back("best");
+  if (points.front().model_fn) {
+    header.push_back("heuristic_us");
+  }
+  std::printf("%s\n", absl::StrJoin(header, "\t").c_str());
+
+  std::string previous_label;
+  std::string previous_best;
+  for (const SweepPoint& point : points) {
+    std::vector<DataPtr> arguments;
+    for (const xla::Shape& shape : point.parameter_shapes) {
+      arguments.push_back(TransferParameter(device, shape));
+    }
+    std::vector<std::string> fields = {op, device_name, point.label};
+    std::string best;
+    double best_seconds = std::numeric_limits<double>::infinity();
+    for (const Alternative& alternative : point.alternatives) {
+      if (alternative.tpu_only && !is_tpu) {
+        continue;
+      }
+      double seconds =
+          TimeLowering(device, point, alternative.build_fn, arguments);
+      fields.push_back(absl::StrFormat("%.1f", seconds * 1e6));
+      if (seconds < best_seconds) {
+        best_seconds = seconds;
+        best = alternative.name;
+      }
+    }
+    fields.push_back(best);
+    if (point.model_fn) {
+      double seconds = TimeLowering(device, point, point.model_fn, arguments);
+      fields.push_back(absl::StrFormat("%.1f", seconds * 1e6));
+    }
+    std::printf("%s\n", absl::StrJoin(fields, "\t").c_str());
+    if (!previous_best.empty() && best != previous_best) {
+      crossovers->push_back(
+          {op, device_name, previous_label, point.label, previous_best, best});
+    }
+    previous_label = point.label;
+    previous_best = best;
+  }
+  std::printf("\n");
+}
+
+// Gathers and scatters 16 indices per row of a [64, dim_size] input, along the
+// second dimension.
+std::vector<SweepPoint> IndexedSweep(bool scatter) {
+  std::vector<SweepPoint> points;
+  for (xla::int64 dim_size = 4; dim_size <= 65536; dim_size *= 4) {
+    xla::Shape input_shape = F32Shape({64, dim_size});
+    xla::Shape index_shape =
+        xla::ShapeUtil::MakeShape(xla::PrimitiveType::S64, {64, 16});
+    auto indices = [=](xla::XlaBuilder* builder) {
+      return MakeBenchmarkIndices(builder, index_shape, 1, dim_size);
+    };
+    SweepPoint point;
+    point.label = absl::StrCat("dim_size=", dim_size);
+    point.parameter_shapes = {input_shape};
+    if (scatter) {
+      point.parameter_shapes.push_back(F32Shape({64, 16}));
+      auto scatter_fn = [=](bool dense) {
+        return [=](xla::XlaBuilder* builder,
+                   const std::vector<xla::XlaOp>& parameters) {
+          ScatterOptions options(/*combiner=*/nullptr);
+          return dense ? XlaDenseScatter(parameters[0], indices(builder),
+                                         parameters[1], 1, options)
+                       : XlaSparseScatter(parameters[0], indices(builder),
+                                          parameters[1], 1, options);
+        };
+      };
+      point.alternatives = {{"dense", scatter_fn(true)},
+                            {"sparse", scatter_fn(false)}};
+      point.model_fn = [=](xla::XlaBuilder* builder,
+                           const std::vector<xla::XlaOp>& parameters) {
+        return CreateScatter(GetCurrentDevice(), parameters[0],
+                             indices(builder), parameters[1], 1,
+                             ScatterOptions(/*combiner=*/nullptr));
+      };
+    } else {
+      auto gather_fn = [=](bool sparse) {
+        return [=](xla::XlaBuilder* builder,
+                   const std::vector<xla::XlaOp>& parameters) {
+          return xla::TorchGather(parameters[0], indices(builder), 1, sparse);
+        };
+      };
+      point.alternatives = {{"dense", gather_fn(false)},
+                            {"sparse", gather_fn(true)}};
+      point.model_fn = [=](xla::XlaBuilder* builder,
+                           const std::vector<xla::XlaOp>& parameters) {
+        xla::XlaOp index = indices(builder);
+        return xla::TorchGather(parameters[0], index, 1,
+                                IsSparseGather(parameters[0], index, 1));
+      };
+    }
+    points.push_back(std::move(point));
+  }
+  return points;
+}
+
+// Resizes a [8, 32, 32, 64] NHWC image by growing factors, or back for the
+// backward pass.
+std::vector<SweepPoint> ResizeSweep(bool backward) {
+  using resize::ResizeLowering;
+  constexpr xla::int64 kSize = 32;
+  std::vector<SweepPoint> points;
+  for (xla::int64 factor : {2, 3, 4, 6, 8}) {
+    xla::int64 large = kSize * factor;
+    auto resize_fn = [=](ResizeLowering lowering) {
+      return [=](xla::XlaBuilder* builder,
+                 const std::vector<xla::XlaOp>& parameters) {
+        return backward ? resize::BuildResizeBilinearBackward(
+                              parameters[0], {kSize, kSize},
+                              /*align_corners=*/false,
+                              /*half_pixel_centers=*/true,
+                              /*channels_last=*/true, lowering)
+                        : resize::BuildResizeBilinear(
+                              parameters[0], {large, large},
+                              /*align_corners=*/false,
+                              /*half_pixel_centers=*/true,
+                              /*channels_last=*/true, lowering);
+      };
+    };
+    SweepPoint point;
+    point.label = absl::StrCat("factor=", factor);
+    point.parameter_shapes = {backward ? F32Shape({8, large, large, 64})
+                                       : F32Shape({8, kSize, kSize, 64})};
+    point.alternatives = {
+        {"separable", resize_fn(ResizeLowering::kSeparable)},
+        {"kernel", resize_fn(ResizeLowering::kKernel), /*tpu_only=*/true},
+        {"split_kernel", resize_fn(ResizeLowering::kSplitKernel),
+         /*tpu_only=*/true}};
+    point.model_fn = resize_fn(ResizeLowering::kCostModel);
+    points.push_back(std::move(point));
+  }
+  return points;
+}
+
+// Suppresses a growing number of boxes, keeping at most 100 of them.
+std::vector<SweepPoint> NmsSweep() {
+  constexpr xla::int64 kOutputSize = 100;
+  std::vector<SweepPoint> points;
+  for (xla::int64 num_boxes = 256; num_boxes <= 16384; num_boxes *= 4) {
+    auto thresholds = [](xla::XlaBuilder* builder) {
+      return std::make_pair(xla::ConstantR0<float>(builder, 0.0f),
+                            xla::ConstantR0<float>(builder, 0.5f));
+    };
+    auto tiled_fn = [=](xla::int64 tile_size) {
+      return [=](xla::XlaBuilder* builder,
+                 const std::vector<xla::XlaOp>& parameters) {
+        auto threshold = thresholds(builder);
+        NmsResult result =
+            BuildTiledNms(parameters[0], parameters[1], threshold.first,
+                          threshold.second, kOutputSize, tile_size);
+        return xla::Tuple(builder,
+                          {result.selected_indices, result.num_valid});
+      };
+    };
+    SweepPoint point;
+    point.label = absl::StrCat("num_boxes=", num_boxes);
+    point.parameter_shapes = {F32Shape({num_boxes, 4}), F32Shape({num_boxes})};
+    point.alternatives.push_back(
+        {"all_pairs", [=](xla::XlaBuilder* builder,
+                          const std::vector<xla::XlaOp>& parameters) {
+           auto threshold = thresholds(builder);
+           NmsResult result = BuildNms(parameters[0], parameters[1],
+                                       threshold.first, threshold.second,
+                                       kOutputSize);
+           return xla::Tuple(builder,
+                             {result.selected_indices, result.num_valid});
+         }});
+    for (xla::int64 tile_size : {64, 256, 1024}) {
+      point.alternatives.push_back(
+          {absl::StrCat("tiled_", tile_size), tiled_fn(tile_size)});
+    }
+    points.push_back(std::move(point));
+  }
+  return points;
+}
+
+// Pools 3x3 windows with stride 2 over [16, channels, 56, 56] inputs, passed
+// in NHWC to the NHWC alternative.
+std::vector<SweepPoint> PoolSweep(bool max_pool) {
+  const std::vector<xla::int64> kNchwKernel = {1, 1, 3, 3};
+  const std::vector<xla::int64> kNchwStride = {1, 1, 2, 2};
+  const std::vector<xla::int64> kNhwcKernel = {1, 3, 3, 1};
+  const std::vector<xla::int64> kNhwcStride = {1, 2, 2, 1};
+  const xla::TensorFormat nchw(0, 1, {2, 3});
+  const xla::TensorFormat nhwc(0, 3, {1, 2});
+  std::vector<SweepPoint> points;
+  for (xla::int64 channels = 8; channels <= 512; channels *= 4) {
+    auto xla_pool_fn = [=](bool channels_last) {
+      return [=](xla::XlaBuilder* builder,
+                 const std::vector<xla::XlaOp>& parameters) {
+        xla::XlaOp input = parameters[channels_last ? 1 : 0];
+        const std::vector<xla::int64>& kernel =
+            channels_last ? kNhwcKernel : kNchwKernel;
+        const std::vector<xla::int64>& stride =
+            channels_last ? kNhwcStride : kNchwStride;
+        const xla::TensorFormat& format = channels_last ? nhwc : nchw;
+        if (max_pool) {
+          return xla::MaxPool(input, kernel, stride, xla::Padding::kValid,
+                              format);
+        }
+        std::vector<std::pair<xla::int64, xla::int64>> padding(2, {0, 0});
+        return xla::AvgPool(input, kernel, stride, padding, format,
+                            /*counts_include_padding=*/false);
+      };
+    };
+    SweepPoint point;
+    point.label = absl::StrCat("channels=", channels);
+    point.parameter_shapes = {F32Shape({16, channels, 56, 56}),
+                              F32Shape({16, 56, 56, channels})};
+    point.alternatives.push_back(
+        {"pooling_nchw", [=](xla::XlaBuilder* builder,
+                             const std::vector<xla::XlaOp>& parameters) {
+           if (max_pool) {
+             MaxPoolResult result = BuildMaxPoolNd(
+                 parameters[0], /*spatial_dim_count=*/2, {3, 3}, {2, 2},
+                 {0, 0}, /*ceil_mode=*/false);
+             return xla::Tuple(builder, {result.result, result.indices});
+           }
+           return BuildAvgPoolNd(parameters[0], /*spatial_dim_count=*/2,
+                                 {3, 3}, {2, 2}, {0, 0}, /*ceil_mode=*/false,
+                                 /*count_include_pad=*/false);
+         }});
+    point.alternatives.push_back({"xla_nchw", xla_pool_fn(false)});
+    point.alternatives.push_back({"xla_nhwc", xla_pool_fn(true)});
+    points.push_back(std::move(point));
+  }
+  return points;
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+  std::string devices_spec =
+      xla::sys_util::GetEnvString("X10_LOWERING_BENCHMARK_DEVICES", "");
+  std::vector<std::string> devices =
+      absl::StrSplit(devices_spec, ',', absl::SkipEmpty());
+  if (devices.empty()) {
+    devices.push_back(xla::ComputationClient::DefaultDevice()->name());
+  }
+
+  using SweepFn = std::function<std::vector<swift_xla::SweepPoint>()>;
+  std::vector<std::pair<std::string, SweepFn>> sweeps = {
+      {"gather", []() { return swift_xla::IndexedSweep(false); }},
+      {"scatter", []() { return swift_xla::IndexedSweep(true); }},
+      {"resize", []() { return swift_xla::ResizeSweep(false); }},
+      {"resize_backward", []() { return swift_xla::ResizeSweep(true); }},
+      {"nms", []() { return swift_xla::NmsSweep(); }},
+      {"avg_pool", []() { return swift_xla::PoolSweep(false); }},
+      {"max_pool", []() { return swift_xla::PoolSweep(true); }},
+  };
+  std::vector<swift_xla::Crossover> crossovers;
+  for (const std::string& device : devices) {
+    for (const auto& op_sweep : sweeps) {
+      if (op_sweep.first.find(filter) == std::string::npos) {
+        continue;
+      }
+      swift_xla::RunSweep(op_sweep.first, device, op_sweep.second(),
+                          &crossovers);
+    }
+  }
+
+  std::printf("Crossovers:\n");
+  for (const swift_xla::Crossover& crossover : crossovers) {
+    std::printf("%s on %s: %s at %s, %s at %s\n", crossover.op.c_str(),
+                crossover.device.c_str(), crossover.from_best.c_str(),
+                crossover.from_label.c_str(), crossover.to_best.c_str(),
+                crossover.to_label.c_str());
+  }
+  return 0;
+}
@@ -17,9 +17,18 @@
 #include <sstream>
 #include <stdexcept>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/mixed_precision.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
 namespace swift_xla {
 namespace ir {
@@ -41,8 +50,12 @@ class HloMetadataSetter {
   }
 
  private:
+  // The scope profile attributes the device time of the instructions to the
+  // scope their metadata names.
   static bool ShouldPopulateXlaOpMetadata() {
-    static bool op_metadata = xla::sys_util::GetEnvBool("XLA_HLO_DEBUG", false);
+    static bool op_metadata =
+        xla::sys_util::GetEnvBool("XLA_HLO_DEBUG", false) ||
+        xla::sys_util::GetEnvBool("XLA_SCOPE_PROFILE", false);
     return op_metadata;
   }
 
@@ -59,6 +72,95 @@ class HloMetadataSetter {
   LoweringContext* loctx_ = nullptr;
 };
 
+// Splits the non-leaf nodes of the post-order into regions which only share
+// leaf nodes, using union-find over the operand edges. The nodes of every
+// region are returned in post-order.
+std::vector<std::vector<const Node*>> PartitionIndependentRegions(
+    absl::Span<const Node* const> post_order) {
+  absl::flat_hash_map<const Node*, size_t> node_index;
+  std::vector<size_t> parents;
+  auto find_root = [&](size_t index) {
+    while (parents[index] != index) {
+      parents[index] = parents[parents[index]];
+      index = parents[index];
+    }
+    return index;
+  };
+  std::vector<const Node*> nodes;
+  for (auto node : post_order) {
+    if (node->operands().empty()) {
+      continue;
+    }
+    size_t index = parents.size();
+    node_index.emplace(node, index);
+    parents.push_back(index);
+    nodes.push_back(node);
+    for (auto& operand : node->operands()) {
+      auto it = node_index.find(operand.node);
+      if (it != node_index.end()) {
+        parents[find_root(it->second)] = find_root(index);
+      }
+    }
+  }
+  std::vector<std::vector<const Node*>> regions;
+  absl::flat_hash_map<size_t, size_t> region_index;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto it = region_index.emplace(find_root(i), regions.size()).first;
+    if (it->second == regions.size()) {
+      regions.emplace_back();
+    }
+    regions[it->second].push_back(nodes[i]);
+  }
+  return regions;
+}
+
+// Makes every group of calls, given by instruction id, call the computation
+// embedded for the first call of the group, and drops the computations which
+// are no longer called. Returns the number of calls redirected.
+size_t ShareCallTargets(absl::Span<const std::vector<xla::int64>> call_groups,
+                        xla::HloModuleProto* module) {
+  absl::flat_hash_map<xla::int64, xla::HloInstructionProto*> instructions;
+  absl::flat_hash_map<xla::int64, const xla::HloComputationProto*>
+      computations;
+  for (auto& computation : *module->mutable_computations()) {
+    computations.emplace(computation.id(), &computation);
+    for (auto& instruction : *computation.mutable_instructions()) {
+      instructions.emplace(instruction.id(), &instruction);
+    }
+  }
+  size_t redirected = 0;
+  for (auto& calls : call_groups) {
+    xla::int64 target =
+        instructions.at(calls.front())->called_computation_ids(0);
+    for (size_t i = 1; i < calls.size(); ++i) {
+      instructions.at(calls[i])->set_called_computation_ids(0, target);
+      ++redirected;
+    }
+  }
+  absl::flat_hash_set<xla::int64> called;
+  std::vector<xla::int64> stack({module->entry_computation_id()});
+  while (!stack.empty()) {
+    xla::int64 id = stack.back();
+    stack.pop_back();
+    if (!called.insert(id).second) {
+      continue;
+    }
+    for (auto& instruction : computations.at(id)->instructions()) {
+      for (xla::int64 callee : instruction.called_computation_ids()) {
+        stack.push_back(callee);
+      }
+    }
+  }
+  google::protobuf::RepeatedPtrField<xla::HloComputationProto> kept;
+  for (auto& computation : *module->mutable_computations()) {
+    if (called.contains(computation.id())) {
+      kept.Add()->Swap(&computation);
+    }
+  }
+  module->mutable_computations()->Swap(&kept);
+  return redirected;
+}
+
 }  // namespace
 
 LoweringContext::LoweringContext(xla::XlaBuilder* builder, Device device)
@@ -82,14 +184,42 @@ RootLoweringContext::RootLoweringContext(
   }
 }
 
+RootLoweringContext::RootLoweringContext(
+    const std::string& name, Device device,
+    absl::Span<const Node* const> post_order, Util::EmissionMap emit_status,
+    absl::Span<const Output> outputs)
+    : LoweringContext(&builder_, std::move(device), std::move(emit_status)),
+      builder_(name) {
+  LowerPostOrder(post_order, outputs);
+}
+
+xla::ComputationClient::Data::OpaqueHandle LoweringContext::GetParameterKey(
+    const std::shared_ptr<xla::ComputationClient::Data>& data) {
+  if (xla::ComputationClient::PipelinedExecution()) {
+    return reinterpret_cast<intptr_t>(data.get());
+  }
+  return data->GetOpaqueHandle();
+}
+
 xla::XlaOp LoweringContext::GetParameter(
     const std::shared_ptr<xla::ComputationClient::Data>& data) {
-  xla::ComputationClient::Data::OpaqueHandle handle = data->GetOpaqueHandle();
+  xla::ComputationClient::Data::OpaqueHandle handle = GetParameterKey(data);
   auto it = parameters_map_.find(handle);
   if (it == parameters_map_.end()) {
-    xla::XlaOp param =
-        xla::Parameter(builder(), parameters_.size(), data->shape(),
-                       absl::StrCat("p", parameters_.size()));
+    xla::XlaOp param;
+    if (data->sharding() != nullptr) {
+      // The data only holds the shard of this device, but the computation is
+      // written in terms of the whole tensor.
+      const xla::OpSharding& sharding = data->sharding()->sharding;
+      xla::XlaScopedShardingAssignment assignment(builder(), sharding);
+      param = xla::Parameter(builder(), parameters_.size(),
+                             data->sharding()->shape,
+                             absl::StrCat("p", parameters_.size()));
+      op_shardings_.emplace(param.handle(), sharding);
+    } else {
+      param = xla::Parameter(builder(), parameters_.size(), data->shape(),
+                             absl::StrCat("p", parameters_.size()));
+    }
     it = parameters_map_.emplace(handle, Parameter{param, parameters_.size()})
              .first;
     parameters_.push_back(data);
@@ -120,17 +250,67 @@ void LoweringContext::SetResult(size_t index, xla::XlaOp op) {
   root_tuple_.at(index) = std::move(op);
 }
 
+xla::XlaOp LoweringContext::ShardOp(xla::XlaOp op,
+                                    const xla::OpSharding& sharding) {
+  xla::XlaScopedShardingAssignment assignment(builder(), sharding);
+  xla::XlaOp sharded_op = xla::CustomCall(
+      builder(), "Sharding", {op}, XlaHelpers::ShapeOfXlaOp(op));
+  op_shardings_.emplace(sharded_op.handle(), sharding);
+  return sharded_op;
+}
+
 xla::StatusOr<xla::XlaComputation> LoweringContext::Build() {
   if (!root_tuple_.empty()) {
+    absl::optional<xla::OpSharding> tuple_sharding;
+    if (!op_shardings_.empty()) {
+      // The SPMD partitioner needs the sharding of every result, the ones not
+      // annotated get replicated.
+      tuple_sharding = xla::OpSharding();
+      tuple_sharding->set_type(xla::OpSharding::TUPLE);
+      for (auto& op : root_tuple_) {
+        auto it = op_shardings_.find(op.handle());
+        xla::OpSharding* sharding = tuple_sharding->add_tuple_shardings();
+        if (it != op_shardings_.end()) {
+          *sharding = it->second;
+        } else {
+          sharding->set_type(xla::OpSharding::REPLICATED);
+        }
+      }
+    }
+    xla::XlaScopedShardingAssignment assignment(builder(), tuple_sharding);
     xla::XlaOp root = xla::Tuple(builder(), root_tuple_);
-    return builder()->Build(root);
+    return ShareCalledComputations(builder()->Build(root));
   }
-  return builder()->Build();
+  return ShareCalledComputations(builder()->Build());
 }
 
 xla::StatusOr<xla::XlaComputation> LoweringContext::Build(xla::XlaOp root) {
   XLA_CHECK(root_tuple_.empty());
-  return builder()->Build(root);
+  return ShareCalledComputations(builder()->Build(root));
+}
+
+xla::XlaOp LoweringContext::CallComputation(
+    const Computation& computation, absl::Span<const xla::XlaOp> operands) {
+  xla::XlaOp call = xla::Call(builder(), computation.computation(), operands);
+  computation_calls_[computation.hash()].push_back(call.handle());
+  return call;
+}
+
+xla::StatusOr<xla::XlaComputation> LoweringContext::ShareCalledComputations(
+    xla::StatusOr<xla::XlaComputation> computation) const {
+  std::vector<std::vector<xla::int64>> call_groups;
+  for (auto& hash_calls : computation_calls_) {
+    if (hash_calls.second.size() > 1) {
+      call_groups.push_back(hash_calls.second);
+    }
+  }
+  if (!computation.ok() || call_groups.empty()) {
+    return computation;
+  }
+  xla::XlaComputation result = computation.ConsumeValueOrDie();
+  XLA_COUNTER("SharedComputationCalls",
+              ShareCallTargets(call_groups, result.mutable_proto()));
+  return std::move(result);
 }
 
 void LoweringContext::AssignOutputOp(const Output& output, xla::XlaOp op) {
@@ -150,21 +330,192 @@ xla::XlaOp LoweringContext::GetOutputOp(const Output& output) {
     XLA_CHECK(it != emitted_outputs_.end())
         << "No XLA operation emitted for output: " << output;
   }
+  if (amp_type_ != xla::PRIMITIVE_TYPE_INVALID &&
+      XlaHelpers::TypeOfXlaOp(it->second) == xla::PrimitiveType::F32) {
+    return xla::ConvertElementType(it->second, amp_type_);
+  }
   return it->second;
 }
 
 XlaOpVector LoweringContext::LowerNode(const Node* node) {
   XlaOpVector result_ops;
+  if (TryReuseLowering(node, &result_ops)) {
+    return result_ops;
+  }
   // TODO(asuhan): handle errors without crashing
   HloMetadataSetter meta_setter(this, node);
 
+  // Operands lowered on demand by GetOutputOp() get their own AMP type.
+  xla::PrimitiveType outer_amp_type = amp_type_;
+  amp_type_ = GetAmpLoweringType(node);
   result_ops = node->Lower(this);
+  if (amp_type_ != xla::PRIMITIVE_TYPE_INVALID) {
+    RestoreAmpOutputs(node, &result_ops);
+  }
+  amp_type_ = outer_amp_type;
   if (!builder()->first_error().ok()) {
     ReportBuilderError(node, /*error_msg=*/nullptr);
   }
   return result_ops;
 }
 
+void LoweringContext::RestoreAmpOutputs(const Node* node,
+                                        XlaOpVector* result_ops) {
+  XLA_COUNTER("AmpLoweredNodes", 1);
+  for (size_t i = 0; i < result_ops->size(); ++i) {
+    xla::XlaOp& op = (*result_ops)[i];
+    if (XlaHelpers::TypeOfXlaOp(op) != xla::PrimitiveType::F32) {
+      op = xla::ConvertElementType(op, xla::PrimitiveType::F32);
+      AssignOutputOp(Output(node, i), op);
+    }
+  }
+}
+
+void LoweringContext::LowerPostOrder(absl::Span<const Node* const> post_order,
+                                     absl::Span<const Output> outputs) {
+  static const bool parallel_lowering =
+      xla::sys_util::GetEnvBool("XLA_PARALLEL_LOWERING", false);
+  static const size_t min_region_size =
+      xla::sys_util::GetEnvInt("XLA_PARALLEL_LOWERING_MIN_NODES", 1000);
+  if (!parallel_lowering || post_order.size() < 2 * min_region_size) {
+    for (auto node : post_order) {
+      LowerNode(node);
+    }
+    return;
+  }
+  // Lower the leaves first and in post-order, so that the parameters get the
+  // same numbering they would get with a serial lowering.
+  for (auto node : post_order) {
+    if (node->operands().empty()) {
+      LowerNode(node);
+    }
+  }
+  std::vector<std::vector<const Node*>> region_nodes =
+      PartitionIndependentRegions(post_order);
+  absl::flat_hash_map<const Node*, size_t> node_region;
+  for (size_t i = 0; i < region_nodes.size(); ++i) {
+    for (auto node : region_nodes[i]) {
+      node_region.emplace(node, i);
+    }
+  }
+  std::vector<std::vector<Output>> region_outputs(region_nodes.size());
+  for (auto& output : outputs) {
+    auto it = node_region.find(output.node);
+    if (it != node_region.end()) {
+      region_outputs[it->second].push_back(output);
+    }
+  }
+
+  std::vector<LoweringRegion> regions;
+  for (size_t i = 0; i < region_nodes.size(); ++i) {
+    if (region_nodes[i].size() < min_region_size ||
+        region_outputs[i].empty()) {
+      for (auto node : region_nodes[i]) {
+        LowerNode(node);
+      }
+    } else {
+      regions.push_back({std::move(region_nodes[i]),
+                         std::move(region_outputs[i]), xla::XlaComputation(),
+                         {}});
+    }
+  }
+  XLA_COUNTER("ParallelLoweringRegions", regions.size());
+
+  xla::util::MultiWait mwait(regions.size());
+  for (auto& region : regions) {
+    auto lowerfn = [this, region = &region]() { LowerRegion(region); };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(lowerfn)));
+  }
+  mwait.Wait();
+
+  for (auto& region : regions) {
+    std::vector<xla::XlaOp> operands;
+    operands.reserve(region.parameters.size());
+    for (auto& data : region.parameters) {
+      operands.push_back(parameters_map_.at(GetParameterKey(data)).param);
+    }
+    xla::XlaOp call = xla::Call(builder(), region.computation, operands);
+    for (size_t i = 0; i < region.outputs.size(); ++i) {
+      xla::XlaOp output = xla::GetTupleElement(call, i);
+      auto it = region.output_shardings.find(i);
+      if (it != region.output_shardings.end()) {
+        op_shardings_.emplace(output.handle(), it->second);
+      }
+      AssignOutputOp(region.outputs[i], output);
+    }
+  }
+  if (!builder()->first_error().ok()) {
+    XLA_ERROR() << "XLA builder error while stitching lowered regions: "
+                << builder()->GetCurrentStatus();
+  }
+}
+
+void LoweringContext::LowerRegion(LoweringRegion* region) const {
+  xla::XlaBuilder builder(absl::StrCat(builder_ptr_->name(), "_region"));
+  LoweringContext region_ctx(&builder, device_);
+  for (auto node : region->nodes) {
+    // Leaves are shared among regions, so every region lowers its own copy.
+    for (auto& operand : node->operands()) {
+      if (operand.node->operands().empty() &&
+          region_ctx.emitted_outputs_.count(operand) == 0) {
+        region_ctx.LowerNode(operand.node);
+      }
+    }
+    region_ctx.LowerNode(node);
+  }
+  for (size_t i = 0; i < region->outputs.size(); ++i) {
+    xla::XlaOp op = region_ctx.emitted_outputs_.at(region->outputs[i]);
+    auto it = region_ctx.op_shardings_.find(op.handle());
+    if (it != region_ctx.op_shardings_.end()) {
+      region->output_shardings.emplace(i, it->second);
+    }
+    region_ctx.AddResult(op);
+  }
+  region->computation = ConsumeValue(region_ctx.Build());
+  region->parameters = region_ctx.GetParametersData();
+}
+
+bool LoweringContext::TryReuseLowering(const Node* node,
+                                       XlaOpVector* result_ops) {
+  static const bool enable_cse = xla::sys_util::GetEnvBool("XLA_IR_CSE", true);
+  // Device data leaves are already deduplicated by GetParameter(), and only
+  // scalars carry their value within the node hash among the other leaves.
+  if (!enable_cse || (node->operands().empty() &&
+                      dynamic_cast<const ops::Scalar*>(node) == nullptr)) {
+    return false;
+  }
+  LoweredNode lowered;
+  lowered.node = node;
+  lowered.operand_handles.reserve(node->operands().size());
+  xla::hash_t hash = node->node_hash();
+  for (auto& operand : node->operands()) {
+    auto it = emitted_outputs_.find(operand);
+    if (it == emitted_outputs_.end()) {
+      return false;
+    }
+    lowered.operand_handles.push_back(it->second.handle());
+    hash = xla::util::HashCombine(hash, it->second.handle());
+  }
+  auto range = lowered_nodes_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const Node* other = it->second.node;
+    if (other->op() == node->op() &&
+        other->num_outputs() == node->num_outputs() &&
+        other->shape() == node->shape() &&
+        it->second.operand_handles == lowered.operand_handles) {
+      for (size_t i = 0; i < node->num_outputs(); ++i) {
+        xla::XlaOp op = emitted_outputs_.at(Output(other, i));
+        AssignOutputOp(Output(node, i), op);
+        result_ops->push_back(op);
+      }
+      XLA_COUNTER("IrCseEliminatedNodes", 1);
+      return true;
+    }
+  }
+  lowered_nodes_.emplace(hash, std::move(lowered));
+  return false;
+}
+
 void LoweringContext::ReportBuilderError(const Node* node,
                                          const char* error_msg) {
   std::stringstream ss;
@@ -180,6 +531,9 @@ void LoweringContext::ReportBuilderError(const Node* node,
   if (!nmeta.scope.empty()) {
     ss << "Scope: " << nmeta.scope << "\n";
   }
+  if (!nmeta.raw_frames.addresses.empty()) {
+    ss << nmeta.frame_info();
+  }
   XLA_ERROR() << ss.str();
 }
 
@@ -25,6 +25,8 @@
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/computation.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
@@ -44,6 +46,12 @@ class LoweringContext {
 
   const Device& device() const { return device_; };
 
+  // Returns the key identifying the parameter which holds data. Data whose
+  // computation is still pipelined only gets its handle once it ran, so the
+  // data object itself is the key when XLA_PIPELINED_EXECUTION is enabled.
+  static xla::ComputationClient::Data::OpaqueHandle GetParameterKey(
+      const std::shared_ptr<xla::ComputationClient::Data>& data);
+
   // If a parameter associated with data has already been declared, it will be
   // returned. Otherwise a new one will be created, associated with the tensor
   // held in data.
@@ -56,6 +64,10 @@ class LoweringContext {
 
   const std::vector<size_t>& GetParameterSequence() const;
 
+  // Returns op annotated with the given sharding, for the SPMD partitioner.
+  // The sharding is also given to the entry of the result tuple holding op.
+  xla::XlaOp ShardOp(xla::XlaOp op, const xla::OpSharding& sharding);
+
   // Adds the output of a given operation to the result tuple. Returns the index
   // of the output within the tuple.
   size_t AddResult(xla::XlaOp op);
@@ -74,6 +86,12 @@ class LoweringContext {
   // corresponding XLA operation returned.
   xla::XlaOp GetOutputOp(const Output& output);
 
+  // Calls computation on the operands. The calls of equal computations, by
+  // fingerprint, share a single called computation within the one returned by
+  // Build(), instead of embedding a copy each.
+  xla::XlaOp CallComputation(const Computation& computation,
+                             absl::Span<const xla::XlaOp> operands);
+
   // Build the XLA computation capturing all the operations created with the
   // embedded XLA builder (returned by the builder() API).
   xla::StatusOr<xla::XlaComputation> Build();
@@ -88,6 +106,14 @@ class LoweringContext {
   // before calling this API. Returns the generated XLA operations.
   XlaOpVector LowerNode(const Node* node);
 
+  // Lowers all the nodes of the post-order. Only the lowering of the given
+  // outputs is guaranteed to be available with GetOutputOp() afterwards, as
+  // with XLA_PARALLEL_LOWERING, regions of the graph which only share leaf
+  // nodes are lowered concurrently into separate computations, which are then
+  // called from this context's builder.
+  void LowerPostOrder(absl::Span<const Node* const> post_order,
+                      absl::Span<const Output> outputs);
+
   size_t GetEmittedNodeCount() const { return emit_status_.size(); }
 
  private:
@@ -96,6 +122,40 @@ class LoweringContext {
     size_t index = 0;
   };
 
+  // A node already lowered within this context, together with the XLA
+  // operations it has been lowered on top of.
+  struct LoweredNode {
+    const Node* node = nullptr;
+    std::vector<xla::int64> operand_handles;
+  };
+
+  struct LoweringRegion {
+    std::vector<const Node*> nodes;
+    std::vector<Output> outputs;
+    xla::XlaComputation computation;
+    std::vector<xla::ComputationClient::DataPtr> parameters;
+    // The shardings of the sharded outputs, by output index.
+    std::unordered_map<size_t, xla::OpSharding> output_shardings;
+  };
+
+  // Lowers the region nodes into a separate computation, returning the values
+  // of the region outputs as tuple.
+  void LowerRegion(LoweringRegion* region) const;
+
+  // Looks up a node structurally identical to the given one, whose operands
+  // have been lowered to the same XLA operations, and if found, reuses its
+  // lowering as lowering for node.
+  bool TryReuseLowering(const Node* node, XlaOpVector* result_ops);
+
+  // Converts the outputs of a node lowered in reduced precision by AMP back to
+  // f32, see mixed_precision.h.
+  void RestoreAmpOutputs(const Node* node, XlaOpVector* result_ops);
+
+  // Makes the calls issued with CallComputation() share their computation
+  // within the built one.
+  xla::StatusOr<xla::XlaComputation> ShareCalledComputations(
+      xla::StatusOr<xla::XlaComputation> computation) const;
+
   // Reports an XLA builder error for the given node.
   TF_ATTRIBUTE_NORETURN void ReportBuilderError(const Node* node,
                                                 const char* error_msg);
@@ -107,8 +167,20 @@ class LoweringContext {
       parameters_map_;
   std::vector<size_t> parameter_sequence_;
   std::vector<xla::XlaOp> root_tuple_;
+  // The shardings of the sharded parameters and of the ShardOp() results, by
+  // XLA operation handle.
+  std::unordered_map<xla::int64, xla::OpSharding> op_shardings_;
   OutputMap<xla::XlaOp> emitted_outputs_;
   Util::EmissionMap emit_status_;
+  std::unordered_multimap<xla::hash_t, LoweredNode, xla::util::HashReducer>
+      lowered_nodes_;
+  // The handles of the CallComputation() results, by computation fingerprint.
+  std::unordered_map<xla::hash_t, std::vector<xla::int64>,
+                     xla::util::HashReducer>
+      computation_calls_;
+  // The type GetOutputOp() converts the f32 operands to, while lowering a node
+  // under AMP.
+  xla::PrimitiveType amp_type_ = xla::PRIMITIVE_TYPE_INVALID;
 };
 
 class RootLoweringContext : public LoweringContext {
@@ -117,6 +189,12 @@ class RootLoweringContext : public LoweringContext {
   RootLoweringContext(const std::string& name, Device device,
                       absl::Span<const Node* const> post_order,
                       Util::EmissionMap emit_status);
+  // Same as above, but lowers using LowerPostOrder(), so that only the given
+  // outputs can be retrieved with GetOutputOp().
+  RootLoweringContext(const std::string& name, Device device,
+                      absl::Span<const Node* const> post_order,
+                      Util::EmissionMap emit_status,
+                      absl::Span<const Output> outputs);
   xla::XlaBuilder builder_;
 };
 
@@ -17,8 +17,10 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/math.h"
 #include "tensorflow/compiler/xla/client/lib/matrix.h"
 #include "tensorflow/compiler/xla/client/lib/qr.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 
@@ -93,6 +95,105 @@ std::vector<xla::int64> GetDiagonalPermutation(xla::int64 rank, xla::int64 dim1,
   return permutation;
 }
 
+// The largest matrices the linear algebra ops handle element by element.
+constexpr xla::int64 kMaxUnrolledMatrixSize = 4;
+
+// The elements of a batch of matrices, as [..., 1, 1] arrays.
+using MatrixElements = std::vector<std::vector<xla::XlaOp>>;
+
+xla::int64 MatrixSize(xla::XlaOp matrix) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(matrix);
+  return shape.dimensions(shape.rank() - 1);
+}
+
+MatrixElements GetMatrixElements(xla::XlaOp matrix, bool transpose) {
+  xla::int64 n = MatrixSize(matrix);
+  MatrixElements elements(n, std::vector<xla::XlaOp>(n));
+  for (xla::int64 i = 0; i < n; ++i) {
+    for (xla::int64 j = 0; j < n; ++j) {
+      xla::XlaOp element =
+          xla::SliceInMinorDims(matrix, {i, j}, {i + 1, j + 1});
+      if (transpose) {
+        elements[j][i] = element;
+      } else {
+        elements[i][j] = element;
+      }
+    }
+  }
+  return elements;
+}
+
+xla::XlaOp MakeMatrix(const MatrixElements& elements) {
+  xla::XlaBuilder* builder = elements[0][0].builder();
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(elements[0][0]).rank();
+  std::vector<xla::XlaOp> rows;
+  for (const auto& row : elements) {
+    rows.push_back(xla::ConcatInDim(builder, row, rank - 1));
+  }
+  return xla::ConcatInDim(builder, rows, rank - 2);
+}
+
+// The determinant of the submatrix of the given rows and columns, by Laplace
+// expansion along its first row.
+xla::XlaOp MinorDeterminant(const MatrixElements& a,
+                            const std::vector<xla::int64>& rows,
+                            const std::vector<xla::int64>& columns) {
+  if (rows.size() == 1) {
+    return a[rows[0]][columns[0]];
+  }
+  std::vector<xla::int64> minor_rows(rows.begin() + 1, rows.end());
+  xla::XlaOp result;
+  for (size_t k = 0; k < columns.size(); ++k) {
+    std::vector<xla::int64> minor_columns(columns);
+    minor_columns.erase(minor_columns.begin() + k);
+    xla::XlaOp term = a[rows[0]][columns[k]] *
+                      MinorDeterminant(a, minor_rows, minor_columns);
+    if (k == 0) {
+      result = term;
+    } else {
+      result = k % 2 == 0 ? result + term : result - term;
+    }
+  }
+  return result;
+}
+
+// Inverts the matrices with their adjugate divided by their determinant.
+xla::XlaOp BuildUnrolledInverse(const MatrixElements& a) {
+  xla::int64 n = a.size();
+  if (n == 1) {
+    return MakeMatrix({{xla::Reciprocal(a[0][0])}});
+  }
+  MatrixElements cofactors(n, std::vector<xla::XlaOp>(n));
+  for (xla::int64 i = 0; i < n; ++i) {
+    for (xla::int64 j = 0; j < n; ++j) {
+      std::vector<xla::int64> rows;
+      std::vector<xla::int64> columns;
+      for (xla::int64 k = 0; k < n; ++k) {
+        if (k != i) {
+          rows.push_back(k);
+        }
+        if (k != j) {
+          columns.push_back(k);
+        }
+      }
+      xla::XlaOp minor = MinorDeterminant(a, rows, columns);
+      cofactors[i][j] = (i + j) % 2 == 0 ? minor : xla::Neg(minor);
+    }
+  }
+  xla::XlaOp determinant = a[0][0] * cofactors[0][0];
+  for (xla::int64 j = 1; j < n; ++j) {
+    determinant = determinant + a[0][j] * cofactors[0][j];
+  }
+  xla::XlaOp scale = xla::Reciprocal(determinant);
+  MatrixElements inverse(n, std::vector<xla::XlaOp>(n));
+  for (xla::int64 i = 0; i < n; ++i) {
+    for (xla::int64 j = 0; j < n; ++j) {
+      inverse[i][j] = cofactors[j][i] * scale;
+    }
+  }
+  return MakeMatrix(inverse);
+}
+
 }  // namespace
 
 xla::XlaOp BuildTriu(xla::XlaOp input, xla::int64 diagonal) {
@@ -141,17 +242,93 @@ xla::XlaOp BuildDiagonalViewUpdate(xla::XlaOp target, xla::XlaOp input,
   return result;
 }
 
-xla::XlaOp BuildInverse(xla::XlaOp input) {
+xla::XlaOp BuildInverse(xla::XlaOp input, bool adjoint) {
+  if (MatrixSize(input) <= kMaxUnrolledMatrixSize) {
+    return BuildUnrolledInverse(GetMatrixElements(input, adjoint));
+  }
   xla::QRDecompositionResult qr_result =
       xla::QRDecomposition(input, /*full_matrices=*/false, /*block_size=*/128,
                            /*precision=*/XlaHelpers::mat_mul_precision())
           .ValueOrDie();
-  return xla::TriangularSolve(qr_result.r,
-                              xla::TransposeInMinorDims(qr_result.q),
-                              /*left_side=*/true,
+  xla::XlaOp inverse =
+      xla::TriangularSolve(qr_result.r, xla::TransposeInMinorDims(qr_result.q),
+                           /*left_side=*/true,
+                           /*lower=*/false, /*unit_diagonal=*/false,
+                           /*transpose_a=*/
+                           xla::TriangularSolveOptions::NO_TRANSPOSE);
+  return adjoint ? xla::TransposeInMinorDims(inverse) : inverse;
+}
+
+xla::XlaOp BuildCholesky(xla::XlaOp input) {
+  xla::int64 n = MatrixSize(input);
+  if (n > kMaxUnrolledMatrixSize) {
+    // Like the TF kernel, only reads the lower triangle, and zeroes the upper
+    // one of the result.
+    return BuildTril(xla::Cholesky(input, /*lower=*/true), 0);
+  }
+  MatrixElements a = GetMatrixElements(input, /*transpose=*/false);
+  xla::XlaOp zero = xla::ZerosLike(a[0][0]);
+  MatrixElements l(n, std::vector<xla::XlaOp>(n, zero));
+  for (xla::int64 i = 0; i < n; ++i) {
+    for (xla::int64 j = 0; j <= i; ++j) {
+      xla::XlaOp sum = a[i][j];
+      for (xla::int64 k = 0; k < j; ++k) {
+        sum = sum - l[i][k] * l[j][k];
+      }
+      l[i][j] = i == j ? xla::Sqrt(sum) : sum / l[j][j];
+    }
+  }
+  return MakeMatrix(l);
+}
+
+xla::XlaOp BuildMatrixSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool adjoint) {
+  if (MatrixSize(matrix) <= kMaxUnrolledMatrixSize) {
+    return xla::BatchDot(BuildInverse(matrix, adjoint), rhs,
+                         XlaHelpers::mat_mul_precision());
+  }
+  xla::XlaOp a = adjoint ? xla::TransposeInMinorDims(matrix) : matrix;
+  xla::QRDecompositionResult qr_result =
+      xla::QRDecomposition(a, /*full_matrices=*/false, /*block_size=*/128,
+                           /*precision=*/XlaHelpers::mat_mul_precision())
+          .ValueOrDie();
+  xla::XlaOp qt_rhs =
+      xla::BatchDot(xla::TransposeInMinorDims(qr_result.q), rhs,
+                    XlaHelpers::mat_mul_precision());
+  return xla::TriangularSolve(qr_result.r, qt_rhs, /*left_side=*/true,
                               /*lower=*/false, /*unit_diagonal=*/false,
                               /*transpose_a=*/
                               xla::TriangularSolveOptions::NO_TRANSPOSE);
 }
 
+xla::XlaOp BuildTriangularSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool lower,
+                                bool adjoint) {
+  xla::int64 n = MatrixSize(matrix);
+  if (n > kMaxUnrolledMatrixSize) {
+    return xla::TriangularSolve(
+        matrix, rhs, /*left_side=*/true, lower, /*unit_diagonal=*/false,
+        /*transpose_a=*/adjoint ? xla::TriangularSolveOptions::ADJOINT
+                                : xla::TriangularSolveOptions::NO_TRANSPOSE);
+  }
+  // Substitutes the rows of the solution one after the other, the [..., 1, 1]
+  // elements broadcasting along the [..., 1, k] rows.
+  MatrixElements a = GetMatrixElements(matrix, adjoint);
+  if (adjoint) {
+    lower = !lower;
+  }
+  const xla::Shape& rhs_shape = XlaHelpers::ShapeOfXlaOp(rhs);
+  xla::int64 num_columns = rhs_shape.dimensions(rhs_shape.rank() - 1);
+  std::vector<xla::XlaOp> x(n);
+  for (xla::int64 step = 0; step < n; ++step) {
+    xla::int64 i = lower ? step : n - 1 - step;
+    xla::XlaOp row = xla::SliceInMinorDims(rhs, {i, 0}, {i + 1, num_columns});
+    for (xla::int64 j = 0; j < n; ++j) {
+      if (lower ? j < i : j > i) {
+        row = row - a[i][j] * x[j];
+      }
+    }
+    x[i] = row / a[i][i];
+  }
+  return xla::ConcatInDim(rhs.builder(), x, rhs_shape.rank() - 2);
+}
+
 }  // namespace swift_xla
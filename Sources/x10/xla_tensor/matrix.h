@@ -31,6 +31,18 @@ xla::XlaOp BuildDiagonalViewUpdate(xla::XlaOp target, xla::XlaOp input,
                                    xla::int64 offset, xla::int64 dim1,
                                    xla::int64 dim2);
 
-xla::XlaOp BuildInverse(xla::XlaOp input);
+// The batched linear algebra ops below use closed form or unrolled kernels on
+// the matrix elements for matrices up to 4x4, common in geometry workloads,
+// and the general XLA decompositions for larger ones. Only the real types are
+// supported, so the adjoint is the transpose.
+
+xla::XlaOp BuildInverse(xla::XlaOp input, bool adjoint);
+
+xla::XlaOp BuildCholesky(xla::XlaOp input);
+
+xla::XlaOp BuildMatrixSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool adjoint);
+
+xla::XlaOp BuildTriangularSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool lower,
+                                bool adjoint);
 
 }  // namespace swift_xla
@@ -0,0 +1,112 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/mixed_precision.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace swift_xla {
+namespace {
+
+// The matmuls and convolutions, forward and backward. The convolution with the
+// bias and activation epilogue is left out, as its activation would run in
+// reduced precision too.
+constexpr char kDefaultAllowOps[] =
+    "aten::matmul,aten::mm,aten::tf_convolution,aten::tf_conv_backprop_filter,"
+    "aten::tf_conv_backprop_input";
+
+xla::PrimitiveType ParseAmpType() {
+  std::string amp = absl::AsciiStrToLower(
+      xla::sys_util::GetEnvString("XLA_AMP", ""));
+  if (amp.empty() || amp == "0" || amp == "none") {
+    return xla::PRIMITIVE_TYPE_INVALID;
+  }
+  xla::PrimitiveType type = xla::PRIMITIVE_TYPE_INVALID;
+  if (amp == "bf16") {
+    type = xla::PrimitiveType::BF16;
+  } else if (amp == "f16" || amp == "fp16") {
+    type = xla::PrimitiveType::F16;
+  } else {
+    XLA_ERROR() << "Invalid XLA_AMP value: " << amp;
+  }
+  TF_LOG(INFO) << "Using automatic mixed precision with "
+               << xla::primitive_util::LowercasePrimitiveTypeName(type);
+  return type;
+}
+
+std::set<std::string> ParseOpList(const char* env, const char* defval) {
+  std::set<std::string> ops;
+  for (absl::string_view op : absl::StrSplit(
+           xla::sys_util::GetEnvString(env, defval), ',', absl::SkipEmpty())) {
+    ops.emplace(absl::StripAsciiWhitespace(op));
+  }
+  return ops;
+}
+
+const std::set<std::string>& GetAllowedOps() {
+  static const std::set<std::string>* allowed_ops = []() {
+    std::set<std::string> ops =
+        ParseOpList("XLA_AMP_ALLOW_OPS", kDefaultAllowOps);
+    for (const std::string& op : ParseOpList("XLA_AMP_DENY_OPS", "")) {
+      ops.erase(op);
+    }
+    return new std::set<std::string>(std::move(ops));
+  }();
+  return *allowed_ops;
+}
+
+bool IsF32Array(const xla::Shape& shape) {
+  return shape.IsArray() && shape.element_type() == xla::PrimitiveType::F32;
+}
+
+}  // namespace
+
+xla::PrimitiveType GetAmpType() {
+  static const xla::PrimitiveType amp_type = ParseAmpType();
+  return amp_type;
+}
+
+xla::PrimitiveType GetAmpLoweringType(const ir::Node* node) {
+  xla::PrimitiveType amp_type = GetAmpType();
+  if (amp_type == xla::PRIMITIVE_TYPE_INVALID ||
+      GetAllowedOps().count(node->op().ToString()) == 0) {
+    return xla::PRIMITIVE_TYPE_INVALID;
+  }
+  // Only nodes computing in f32 are affected, the ones already running in
+  // another floating point type are left alone.
+  for (size_t i = 0; i < node->num_outputs(); ++i) {
+    if (!IsF32Array(node->shape(i))) {
+      return xla::PRIMITIVE_TYPE_INVALID;
+    }
+  }
+  for (const ir::Output& operand : node->operands()) {
+    const xla::Shape& shape = operand.shape();
+    if (xla::primitive_util::IsFloatingPointType(shape.element_type()) &&
+        !IsF32Array(shape)) {
+      return xla::PRIMITIVE_TYPE_INVALID;
+    }
+  }
+  return amp_type;
+}
+
+}  // namespace swift_xla
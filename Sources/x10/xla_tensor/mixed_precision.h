@@ -0,0 +1,42 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace swift_xla {
+
+// Automatic mixed precision, enabled by setting XLA_AMP to bf16 or f16. Unlike
+// XLA_USE_BF16 and XLA_USE_FP16, which store every f32 tensor in reduced
+// precision, AMP keeps the tensors in f32 and only changes the lowering of the
+// IR nodes whose op kind is in the allow list, which by default holds the
+// matmuls and convolutions. Those get their f32 operands converted to the
+// reduced precision type, and their results converted back to f32. The other
+// nodes, like the reductions, softmax and normalizations, run in f32.
+// XLA_AMP_ALLOW_OPS replaces the allow list, and XLA_AMP_DENY_OPS removes op
+// kinds from it, both as comma separated op kinds like "aten::matmul".
+
+// Returns the reduced precision type of AMP, or PRIMITIVE_TYPE_INVALID if it
+// is disabled.
+xla::PrimitiveType GetAmpType();
+
+// Returns the type the f32 operands of the node should be converted to when
+// lowering it, or PRIMITIVE_TYPE_INVALID if it should be lowered as is.
+xla::PrimitiveType GetAmpLoweringType(const ir::Node* node);
+
+}  // namespace swift_xla
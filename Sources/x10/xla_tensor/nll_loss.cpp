@@ -19,6 +19,8 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 
 namespace swift_xla {
 namespace {
@@ -114,6 +116,48 @@ WeightScale GetMaskedWeight(const absl::optional<xla::XlaOp>& weight,
   return {result_weight, scale};
 }
 
+// The per row statistics BuildSoftmaxCrossEntropy needs from the logits.
+struct LogitsStats {
+  xla::XlaOp max;
+  // Sum of exp(logits - max).
+  xla::XlaOp sum;
+  // The logit of the label class.
+  xla::XlaOp target;
+  // Sum of the logits over all the classes.
+  xla::XlaOp total;
+};
+
+xla::XlaOp ReduceClasses(xla::XlaOp input, xla::XlaOp init,
+                         const xla::XlaComputation& computation) {
+  return xla::Reduce(input, init, computation, {1});
+}
+
+// Computes the row statistics of the [N, K] logits chunk whose first class is
+// start.
+LogitsStats ChunkStats(xla::XlaOp logits, xla::XlaOp labels, xla::XlaOp start) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(logits);
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  xla::XlaBuilder* builder = logits.builder();
+  xla::PrimitiveType type = shape.element_type();
+  xla::XlaOp zero = xla::Zero(builder, type);
+  xla::XlaComputation add_func = XlaHelpers::CreateAddComputation(type);
+  xla::XlaOp max = ReduceClasses(logits, xla::MinValue(builder, type),
+                                 XlaHelpers::CreateMaxComputation(type));
+  xla::XlaOp sum = ReduceClasses(xla::Exp(xla::Sub(logits, max, {0})), zero,
+                                 add_func);
+  xla::XlaOp classes = xla::Add(
+      xla::Iota(builder,
+                xla::ShapeUtil::ChangeElementType(shape,
+                                                  labels_shape.element_type()),
+                1),
+      start);
+  xla::XlaOp is_target = xla::Eq(classes, labels, {0});
+  xla::XlaOp target = ReduceClasses(
+      xla::Select(is_target, logits, xla::Broadcast(zero, shape.dimensions())),
+      zero, add_func);
+  return {max, sum, target, ReduceClasses(logits, zero, add_func)};
+}
+
 }  // namespace
 
 // Builds the NLLLoss for log-probabilities "logits" and class indices "labels".
@@ -184,4 +228,97 @@ xla::XlaOp BuildNllLossBackward(xla::XlaOp grad_output, xla::XlaOp logits,
   return result / weight_scale.scale;
 }
 
+SoftmaxCrossEntropyResult BuildSoftmaxCrossEntropy(xla::XlaOp logits,
+                                                   xla::XlaOp labels,
+                                                   int ignore_index,
+                                                   double label_smoothing,
+                                                   xla::int64 chunk_size) {
+  const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  XLA_CHECK_EQ(logits_shape.rank(), 2) << logits_shape;
+  XLA_CHECK_EQ(labels_shape.rank(), 1) << labels_shape;
+  xla::PrimitiveType type = logits_shape.element_type();
+  xla::PrimitiveType compute_type =
+      type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+          ? xla::PrimitiveType::F32
+          : type;
+  xla::PrimitiveType index_type = labels_shape.element_type();
+  xla::XlaBuilder* builder = logits.builder();
+  xla::int64 batch_size = logits_shape.dimensions(0);
+  xla::int64 num_classes = logits_shape.dimensions(1);
+  xla::XlaOp compute_logits = xla::ConvertElementType(logits, compute_type);
+
+  LogitsStats stats;
+  if (chunk_size <= 0 || chunk_size >= num_classes ||
+      num_classes % chunk_size != 0) {
+    stats = ChunkStats(compute_logits, labels, xla::Zero(builder, index_type));
+  } else {
+    xla::XlaOp zeros =
+        xla::Broadcast(xla::Zero(builder, compute_type), {batch_size});
+    // The running maximum starts at the lowest finite value, so that the first
+    // chunk correction is exp(lowest - max) = 0 rather than exp(-inf - -inf).
+    std::vector<xla::XlaOp> initial_values = {
+        compute_logits, labels,
+        xla::Broadcast(xla::MinFiniteValue(builder, compute_type),
+                       {batch_size}),
+        zeros, zeros, zeros};
+    auto body_fn = [&](xla::XlaOp index, absl::Span<const xla::XlaOp> values,
+                       xla::XlaBuilder* body_builder)
+        -> xla::StatusOr<std::vector<xla::XlaOp>> {
+      xla::XlaOp start = xla::Mul(
+          index, XlaHelpers::ScalarValue(chunk_size, index_type, body_builder));
+      xla::XlaOp chunk = xla::DynamicSlice(
+          values[0], {xla::Zero(body_builder, index_type), start},
+          {batch_size, chunk_size});
+      LogitsStats chunk_stats = ChunkStats(chunk, values[1], start);
+      xla::XlaOp max = xla::Max(values[2], chunk_stats.max);
+      xla::XlaOp sum =
+          xla::Add(xla::Mul(values[3], xla::Exp(xla::Sub(values[2], max))),
+                   xla::Mul(chunk_stats.sum,
+                            xla::Exp(xla::Sub(chunk_stats.max, max))));
+      return std::vector<xla::XlaOp>{
+          values[0], values[1], max, sum,
+          xla::Add(values[4], chunk_stats.target),
+          xla::Add(values[5], chunk_stats.total)};
+    };
+    std::vector<xla::XlaOp> results = ConsumeValue(xla::ForEachIndex(
+        num_classes / chunk_size, index_type, body_fn, initial_values,
+        "SoftmaxCrossEntropy", builder));
+    stats = {results[2], results[3], results[4], results[5]};
+  }
+
+  xla::XlaOp on_value = XlaHelpers::ScalarValue<double>(
+      1.0 - label_smoothing, compute_type, builder);
+  xla::XlaOp off_value = XlaHelpers::ScalarValue<double>(
+      label_smoothing / num_classes, compute_type, builder);
+  xla::XlaOp logsumexp = xla::Add(stats.max, xla::Log(stats.sum));
+  xla::XlaOp loss =
+      xla::Sub(xla::Sub(logsumexp, xla::Mul(on_value, stats.target)),
+               xla::Mul(off_value, stats.total));
+  xla::XlaOp valid = xla::Ne(
+      labels, XlaHelpers::ScalarValue<xla::int64>(ignore_index, index_type,
+                                                  builder));
+  xla::XlaOp zero = xla::Zero(builder, compute_type);
+  loss = xla::Select(valid, loss, xla::Broadcast(zero, {batch_size}));
+
+  // The gradient is softmax(logits) minus the target distribution, which only
+  // differs from label_smoothing / C at the label class.
+  xla::Shape compute_shape =
+      xla::ShapeUtil::ChangeElementType(logits_shape, compute_type);
+  xla::XlaOp classes = xla::Iota(
+      builder, xla::ShapeUtil::ChangeElementType(logits_shape, index_type), 1);
+  xla::XlaOp targets = xla::Select(
+      xla::Eq(classes, labels, {0}),
+      xla::Broadcast(xla::Add(on_value, off_value),
+                     compute_shape.dimensions()),
+      xla::Broadcast(off_value, compute_shape.dimensions()));
+  xla::XlaOp grad_logits = xla::Sub(
+      xla::Exp(xla::Sub(compute_logits, logsumexp, {0})), targets);
+  grad_logits = xla::Select(
+      xla::BroadcastInDim(valid, compute_shape.dimensions(), {0}), grad_logits,
+      xla::Broadcast(zero, compute_shape.dimensions()));
+  return {xla::ConvertElementType(loss, type),
+          xla::ConvertElementType(grad_logits, type)};
+}
+
 }  // namespace swift_xla
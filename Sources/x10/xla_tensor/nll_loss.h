@@ -35,4 +35,23 @@ xla::XlaOp BuildNllLossBackward(xla::XlaOp grad_output, xla::XlaOp logits,
                                 const absl::optional<xla::XlaOp>& total_weight,
                                 int ignore_index, ReductionMode reduction_mode);
 
+struct SoftmaxCrossEntropyResult {
+  // The [N] per example losses, zero where the label is ignore_index.
+  xla::XlaOp loss;
+  // The [N, C] gradient of each example loss with respect to its logits.
+  xla::XlaOp grad_logits;
+};
+
+// Computes the cross-entropy between softmax(logits) for logits [N, C] and the
+// class indices labels [N], along with its logits gradient, without
+// materializing the log-probabilities. With label smoothing the target
+// distribution is (1 - label_smoothing) * one_hot + label_smoothing / C. When
+// chunk_size divides C, the row statistics are accumulated chunk_size classes
+// at a time with an online softmax.
+SoftmaxCrossEntropyResult BuildSoftmaxCrossEntropy(xla::XlaOp logits,
+                                                   xla::XlaOp labels,
+                                                   int ignore_index,
+                                                   double label_smoothing,
+                                                   xla::int64 chunk_size);
+
 }  // namespace swift_xla
@@ -1,15 +1,18 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/nms_op.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "tensorflow/compiler/xla/client/lib/arithmetic.h"
 #include "tensorflow/compiler/xla/client/lib/comparators.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
 #include "tensorflow/compiler/xla/client/lib/sorting.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 
 // Code extracted from:
@@ -145,6 +148,232 @@ xla::XlaOp NmsGather(xla::XlaOp input, absl::Span<const xla::int64> input_sizes,
   return xla::Gather(input, indices, dim_numbers, slice_sizes);
 }
 
+// The corners and area of a [B, 4, T] block of boxes, with [B, T] shapes.
+struct BoxCorners {
+  xla::XlaOp y_min;
+  xla::XlaOp x_min;
+  xla::XlaOp y_max;
+  xla::XlaOp x_max;
+  xla::XlaOp area;
+};
+
+BoxCorners MakeBoxCorners(xla::XlaOp boxes) {
+  auto sizes = XlaHelpers::SizesOfXlaOp(boxes);
+  auto coordinate = [&](xla::int64 index) {
+    return xla::Reshape(xla::SliceInDim(boxes, /*start_index=*/index,
+                                        /*limit_index=*/index + 1,
+                                        /*stride=*/1, /*dimno=*/1),
+                        {sizes[0], sizes[2]});
+  };
+  xla::XlaOp c_y0 = coordinate(0);
+  xla::XlaOp c_x0 = coordinate(1);
+  xla::XlaOp c_y1 = coordinate(2);
+  xla::XlaOp c_x1 = coordinate(3);
+  BoxCorners corners;
+  corners.y_min = xla::Min(c_y0, c_y1);
+  corners.x_min = xla::Min(c_x0, c_x1);
+  corners.y_max = xla::Max(c_y0, c_y1);
+  corners.x_max = xla::Max(c_x0, c_x1);
+  corners.area =
+      (corners.y_max - corners.y_min) * (corners.x_max - corners.x_min);
+  return corners;
+}
+
+// Returns the [B, R, C] mask of the row boxes whose IoU with the column boxes
+// is over the threshold.
+xla::XlaOp OverlapMask(const BoxCorners& rows, const BoxCorners& cols,
+                       xla::XlaOp iou_threshold) {
+  auto row_sizes = XlaHelpers::SizesOfXlaOp(rows.area);
+  auto col_sizes = XlaHelpers::SizesOfXlaOp(cols.area);
+  std::vector<xla::int64> sizes = {row_sizes[0], row_sizes[1], col_sizes[1]};
+  auto row = [&](xla::XlaOp value) {
+    return xla::BroadcastInDim(value, sizes, {0, 1});
+  };
+  auto col = [&](xla::XlaOp value) {
+    return xla::BroadcastInDim(value, sizes, {0, 2});
+  };
+  xla::XlaOp i_ymin = xla::Max(row(rows.y_min), col(cols.y_min));
+  xla::XlaOp i_xmin = xla::Max(row(rows.x_min), col(cols.x_min));
+  xla::XlaOp i_ymax = xla::Min(row(rows.y_max), col(cols.y_max));
+  xla::XlaOp i_xmax = xla::Min(row(rows.x_max), col(cols.x_max));
+  xla::XlaOp zero = xla::ZerosLike(i_ymin);
+  xla::XlaOp i_area =
+      xla::Max(i_ymax - i_ymin, zero) * xla::Max(i_xmax - i_xmin, zero);
+  xla::XlaOp u_area = row(rows.area) + col(cols.area) - i_area;
+  return xla::Gt(i_area / u_area, iou_threshold);
+}
+
+xla::XlaOp AnyInDim(xla::XlaOp pred, xla::int64 dim) {
+  xla::XlaBuilder* builder = pred.builder();
+  return xla::Reduce(
+      pred, xla::ConstantR0<bool>(builder, false),
+      xla::CreateScalarOrComputation(xla::PrimitiveType::PRED, builder),
+      {dim});
+}
+
+xla::XlaOp CountInDim(xla::XlaOp pred, xla::int64 dim) {
+  xla::XlaBuilder* builder = pred.builder();
+  return xla::Reduce(
+      xla::ConvertElementType(pred, xla::PrimitiveType::S32),
+      xla::Zero(builder, xla::PrimitiveType::S32),
+      xla::CreateScalarAddComputation(xla::PrimitiveType::S32, builder),
+      {dim});
+}
+
+// Greedily suppresses the boxes of a tile among themselves. A box suppressed by
+// a higher scoring box can no longer suppress others, so the keep mask is
+// iterated to its fixed point, which the i-th box reaches in at most i steps.
+xla::XlaOp SuppressWithinTile(xla::XlaOp tile_boxes, xla::XlaOp tile_keep,
+                              xla::XlaOp iou_threshold) {
+  xla::XlaBuilder* builder = tile_boxes.builder();
+  BoxCorners corners = MakeBoxCorners(tile_boxes);
+  xla::XlaOp overlaps = OverlapMask(corners, corners, iou_threshold);
+  xla::Shape mask_shape = XlaHelpers::ShapeOfXlaOp(overlaps);
+  mask_shape.set_element_type(xla::PrimitiveType::S32);
+  // Only the higher scoring boxes, which come first, can suppress a box.
+  xla::XlaOp higher_scoring = xla::Gt(xla::Iota(builder, mask_shape, 1),
+                                      xla::Iota(builder, mask_shape, 2));
+  std::vector<xla::XlaOp> init_values = {xla::And(overlaps, higher_scoring),
+                                         tile_keep, tile_keep,
+                                         xla::ConstantR0<bool>(builder, true)};
+  auto cond_fn = [](absl::Span<const xla::XlaOp> values,
+                    xla::XlaBuilder* builder) -> xla::StatusOr<xla::XlaOp> {
+    return values[3];
+  };
+  auto body_fn = [](absl::Span<const xla::XlaOp> values,
+                    xla::XlaBuilder* builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp mask = values[0];
+    xla::XlaOp keep = values[2];
+    auto sizes = XlaHelpers::SizesOfXlaOp(mask);
+    xla::XlaOp suppressed =
+        AnyInDim(xla::And(mask, xla::BroadcastInDim(keep, sizes, {0, 2})), 2);
+    xla::XlaOp new_keep = xla::And(values[1], xla::Not(suppressed));
+    xla::XlaOp changed = AnyInDim(
+        AnyInDim(xla::Ne(new_keep, keep), /*dim=*/1), /*dim=*/0);
+    return std::vector<xla::XlaOp>{mask, values[1], new_keep, changed};
+  };
+  return ConsumeValue(xla::WhileLoopHelper(cond_fn, body_fn, init_values,
+                                           "TileSuppressLoop", builder))[2];
+}
+
+// Suppresses the boxes of a tile which overlap with the boxes kept in the
+// tiles before it.
+struct SuppressByPreviousTilesBodyFn {
+  explicit SuppressByPreviousTilesBodyFn(xla::int64 tile_size)
+      : tile_size(tile_size) {}
+
+  xla::StatusOr<std::vector<xla::XlaOp>> operator()(
+      absl::Span<const xla::XlaOp> values, xla::XlaBuilder* builder) const {
+    xla::XlaOp tile_idx = values[0];
+    xla::XlaOp boxes = values[1];
+    xla::XlaOp keep = values[2];
+    xla::XlaOp tile_boxes = values[3];
+    xla::XlaOp tile_suppressed = values[4];
+    xla::XlaOp iou_threshold = values[5];
+    xla::int64 batch_size = XlaHelpers::SizesOfXlaOp(keep)[0];
+    xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::S32);
+    xla::XlaOp start =
+        tile_idx * xla::ConstantR0<xla::int32>(builder, tile_size);
+    xla::XlaOp prev_boxes = xla::DynamicSlice(boxes, {zero, zero, start},
+                                              {batch_size, 4, tile_size});
+    xla::XlaOp prev_keep =
+        xla::DynamicSlice(keep, {zero, start}, {batch_size, tile_size});
+    xla::XlaOp overlaps =
+        OverlapMask(MakeBoxCorners(tile_boxes), MakeBoxCorners(prev_boxes),
+                    iou_threshold);
+    xla::XlaOp suppressed = AnyInDim(
+        xla::And(overlaps,
+                 xla::BroadcastInDim(prev_keep,
+                                     XlaHelpers::SizesOfXlaOp(overlaps),
+                                     {0, 2})),
+        2);
+    return std::vector<xla::XlaOp>{
+        tile_idx + xla::One(builder, xla::PrimitiveType::S32), boxes, keep,
+        tile_boxes, xla::Or(tile_suppressed, suppressed), iou_threshold,
+        values[6]};
+  }
+
+  xla::int64 tile_size;
+};
+
+// Processes the sorted boxes one tile at a time, suppressing every tile first
+// by the already final keep mask of the tiles before it, then within itself.
+struct SuppressTileBodyFn {
+  explicit SuppressTileBodyFn(xla::int64 tile_size) : tile_size(tile_size) {}
+
+  xla::StatusOr<std::vector<xla::XlaOp>> operator()(
+      absl::Span<const xla::XlaOp> values, xla::XlaBuilder* builder) const {
+    xla::XlaOp tile_idx = values[0];
+    xla::XlaOp boxes = values[1];
+    xla::XlaOp keep = values[2];
+    xla::XlaOp iou_threshold = values[3];
+    xla::int64 batch_size = XlaHelpers::SizesOfXlaOp(keep)[0];
+    xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::S32);
+    xla::XlaOp start =
+        tile_idx * xla::ConstantR0<xla::int32>(builder, tile_size);
+    xla::XlaOp tile_boxes = xla::DynamicSlice(boxes, {zero, zero, start},
+                                              {batch_size, 4, tile_size});
+    xla::XlaOp tile_keep =
+        xla::DynamicSlice(keep, {zero, start}, {batch_size, tile_size});
+
+    std::vector<xla::XlaOp> init_values = {
+        zero,
+        boxes,
+        keep,
+        tile_boxes,
+        xla::Broadcast(xla::ConstantR0<bool>(builder, false),
+                       {batch_size, tile_size}),
+        iou_threshold,
+        tile_idx};
+    auto cond_fn = [](absl::Span<const xla::XlaOp> values,
+                      xla::XlaBuilder* builder) -> xla::StatusOr<xla::XlaOp> {
+      return xla::Lt(values[0], values[6]);
+    };
+    auto prev_result = ConsumeValue(xla::WhileLoopHelper(
+        cond_fn, SuppressByPreviousTilesBodyFn(tile_size), init_values,
+        "PreviousTilesSuppressLoop", builder));
+    tile_keep = xla::And(tile_keep, xla::Not(prev_result[4]));
+    tile_keep = SuppressWithinTile(tile_boxes, tile_keep, iou_threshold);
+    keep = xla::DynamicUpdateSlice(keep, tile_keep, {zero, start});
+    return std::vector<xla::XlaOp>{
+        tile_idx + xla::One(builder, xla::PrimitiveType::S32), boxes, keep,
+        iou_threshold};
+  }
+
+  xla::int64 tile_size;
+};
+
+// Stops when all the tiles have been processed, or when every batch entry has
+// output_size boxes kept in the processed tiles.
+struct SuppressTileCondFn {
+  SuppressTileCondFn(xla::int64 num_tiles, xla::int64 tile_size,
+                     xla::int64 output_size)
+      : num_tiles(num_tiles), tile_size(tile_size), output_size(output_size) {}
+
+  xla::StatusOr<xla::XlaOp> operator()(absl::Span<const xla::XlaOp> values,
+                                       xla::XlaBuilder* builder) const {
+    xla::XlaOp tile_idx = values[0];
+    xla::XlaOp keep = values[2];
+    xla::XlaOp tiles_left =
+        xla::Lt(tile_idx, xla::ConstantR0<xla::int32>(builder, num_tiles));
+    xla::Shape keep_shape = XlaHelpers::ShapeOfXlaOp(keep);
+    keep_shape.set_element_type(xla::PrimitiveType::S32);
+    xla::XlaOp processed =
+        xla::Lt(xla::Iota(builder, keep_shape, 1),
+                tile_idx * xla::ConstantR0<xla::int32>(builder, tile_size));
+    xla::XlaOp results_not_full =
+        AnyInDim(xla::Lt(CountInDim(xla::And(keep, processed), 1),
+                         xla::ConstantR0<xla::int32>(builder, output_size)),
+                 0);
+    return xla::And(tiles_left, results_not_full);
+  }
+
+  xla::int64 num_tiles;
+  xla::int64 tile_size;
+  xla::int64 output_size;
+};
+
 }  // namespace
 
 NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
@@ -289,4 +518,121 @@ NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
   return {selected_indices, num_valid};
 }
 
+NmsResult BuildTiledNms(xla::XlaOp boxes, xla::XlaOp scores,
+                        xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
+                        xla::int64 output_size, xla::int64 tile_size) {
+  const xla::Shape& boxes_shape = XlaHelpers::ShapeOfXlaOp(boxes);
+  const xla::Shape& scores_shape = XlaHelpers::ShapeOfXlaOp(scores);
+  XLA_CHECK(boxes_shape.rank() == 2 || boxes_shape.rank() == 3)
+      << boxes_shape;
+  XLA_CHECK_EQ(scores_shape.rank(), boxes_shape.rank() - 1);
+  if (boxes_shape.rank() == 2) {
+    xla::int64 num_boxes = boxes_shape.dimensions(0);
+    NmsResult result = BuildTiledNms(
+        xla::Reshape(boxes, {1, num_boxes, 4}),
+        xla::Reshape(scores, {1, num_boxes}), score_threshold, iou_threshold,
+        output_size, tile_size);
+    return {xla::Reshape(result.selected_indices, {output_size}),
+            xla::Reshape(result.num_valid, {})};
+  }
+  xla::int64 batch_size = boxes_shape.dimensions(0);
+  xla::int64 num_boxes = boxes_shape.dimensions(1);
+  XLA_CHECK_EQ(boxes_shape.dimensions(2), 4);
+  XLA_CHECK_EQ(scores_shape.dimensions(0), batch_size);
+  XLA_CHECK_EQ(scores_shape.dimensions(1), num_boxes);
+  XLA_CHECK_LT(num_boxes, std::numeric_limits<xla::int32>::max());
+  XLA_CHECK_GE(output_size, 0);
+  XLA_CHECK_LT(output_size, std::numeric_limits<xla::int32>::max());
+  XLA_CHECK_GT(tile_size, 0);
+
+  // Pad to whole tiles, and to at least output_size boxes for the final TopK.
+  xla::int64 extent =
+      std::max<xla::int64>(std::max(num_boxes, output_size), 1);
+  xla::int64 tile = std::min(tile_size, extent);
+  xla::int64 num_tiles = (extent + tile - 1) / tile;
+  xla::int64 padding = num_tiles * tile - num_boxes;
+
+  xla::XlaBuilder* builder = boxes.builder();
+  xla::PrimitiveType scores_type = scores_shape.element_type();
+  xla::XlaOp iota_indices = xla::Iota(
+      builder,
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                {batch_size, num_boxes}),
+      1);
+  // Both sorts are stable, so that boxes and indices agree on ties.
+  xla::XlaOp indices_sort = xla::Sort(
+      {scores, iota_indices},
+      xla::CreateScalarGtComputation({scores_type, xla::PrimitiveType::S32},
+                                     builder),
+      /*dimension=*/1, /*is_stable=*/true);
+  xla::XlaOp scores_sorted = xla::GetTupleElement(indices_sort, 0);
+  xla::XlaOp indices_sorted = xla::GetTupleElement(indices_sort, 1);
+  // Choose a more convenient [B, 4, N] layout.
+  xla::XlaOp boxes_sorted = xla::GetTupleElement(
+      xla::Sort({xla::BroadcastInDim(scores, {batch_size, 4, num_boxes},
+                                     {0, 2}),
+                 xla::Transpose(boxes, {0, 2, 1})},
+                xla::CreateScalarGtComputation(
+                    {scores_type, boxes_shape.element_type()}, builder),
+                /*dimension=*/2, /*is_stable=*/true),
+      1);
+  boxes_sorted = xla::PadInDim(
+      boxes_sorted, xla::Zero(builder, boxes_shape.element_type()),
+      /*dimno=*/2, /*pad_lo=*/0, /*pad_hi=*/padding);
+  scores_sorted =
+      xla::PadInDim(scores_sorted, xla::MinValue(builder, scores_type),
+                    /*dimno=*/1, /*pad_lo=*/0, /*pad_hi=*/padding);
+  indices_sorted = xla::PadInDim(
+      indices_sorted, xla::Zero(builder, xla::PrimitiveType::S32),
+      /*dimno=*/1, /*pad_lo=*/0, /*pad_hi=*/padding);
+
+  xla::int64 padded_boxes = num_tiles * tile;
+  xla::XlaOp positions = xla::Iota(
+      builder,
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                {batch_size, padded_boxes}),
+      1);
+  xla::XlaOp keep = xla::And(
+      xla::Gt(scores_sorted, score_threshold),
+      xla::Lt(positions, xla::ConstantR0<xla::int32>(builder, num_boxes)));
+
+  std::vector<xla::XlaOp> init_values = {
+      xla::Zero(builder, xla::PrimitiveType::S32), boxes_sorted, keep,
+      iou_threshold};
+  auto suppress_loop_result = ConsumeValue(xla::WhileLoopHelper(
+      SuppressTileCondFn(num_tiles, tile, output_size),
+      SuppressTileBodyFn(tile), init_values, "TiledBoxSuppressLoop", builder));
+  // Only consider boxes in the tiles we have processed, since the loop stops
+  // once enough boxes are selected.
+  xla::XlaOp processed =
+      xla::Lt(positions, suppress_loop_result[0] *
+                             xla::ConstantR0<xla::int32>(builder, tile));
+  keep = xla::And(suppress_loop_result[2], processed);
+
+  // Select the first kept boxes in score order, the earlier the higher.
+  xla::XlaOp priority = xla::Select(
+      keep,
+      xla::ConstantR0<xla::int32>(builder, padded_boxes) - positions,
+      xla::ZerosLike(positions));
+  xla::XlaOp selected_positions =
+      xla::GetTupleElement(xla::TopK(priority, output_size), 1);
+  xla::XlaOp num_valid = xla::Min(
+      CountInDim(keep, 1), xla::ConstantR0<xla::int32>(builder, output_size));
+
+  // Re-index into the original scores input tensor.
+  std::vector<xla::int64> output_sizes = {batch_size, output_size};
+  xla::XlaOp selected_indices = xla::TorchGather(
+      indices_sorted, selected_positions, /*dim=*/1,
+      IsSparseGather(indices_sorted, selected_positions, /*dim=*/1));
+  xla::XlaOp valid_output = xla::Lt(
+      xla::Iota(builder,
+                xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                          output_sizes),
+                1),
+      xla::BroadcastInDim(num_valid, output_sizes, {0}));
+  selected_indices = xla::Select(valid_output, selected_indices,
+                                 xla::ZerosLike(selected_indices));
+  return {selected_indices, num_valid};
+}
+
 }  // namespace swift_xla
@@ -13,4 +13,15 @@ NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
                    xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
                    xla::int64 output_size);
 
+// Same as BuildNms(), without materializing the all-pairs IoU matrix. The boxes
+// are sorted by score and processed in blocks of tile_size, so memory grows
+// with tile_size * tile_size instead of quadratically in the number of boxes.
+// Takes either [N, 4] boxes and [N] scores, or [B, N, 4] boxes and [B, N]
+// scores, in which case every batch entry is suppressed independently and the
+// result has [B, output_size] indices and [B] valid counts. The selected
+// indices past the valid count are zero.
+NmsResult BuildTiledNms(xla::XlaOp boxes, xla::XlaOp scores,
+                        xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
+                        xla::int64 output_size, xla::int64 tile_size);
+
 }  // namespace swift_xla
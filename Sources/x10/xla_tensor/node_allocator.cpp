@@ -0,0 +1,204 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/node_allocator.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+constexpr size_t kAlignment = 16;
+constexpr size_t kMaxBlockSize = 2048;
+constexpr size_t kNumClasses = kMaxBlockSize / kAlignment;
+constexpr size_t kSlabSize = 64 * 1024;
+// Number of blocks moved at once between a thread cache and the shared free
+// lists.
+constexpr size_t kTransferBlocks = 64;
+constexpr size_t kMaxCachedBlocks = 4 * kTransferBlocks;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct FreeList {
+  FreeBlock* head = nullptr;
+  size_t count = 0;
+
+  void Push(void* ptr) {
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = head;
+    head = block;
+    ++count;
+  }
+
+  void* Pop() {
+    FreeBlock* block = head;
+    head = block->next;
+    --count;
+    return block;
+  }
+};
+
+size_t SizeClass(size_t size) { return (size + kAlignment - 1) / kAlignment; }
+
+class SharedPool {
+ public:
+  static SharedPool* Get() {
+    // Leaked, as thread caches return their blocks to it at thread exit.
+    static SharedPool* pool = new SharedPool();
+    return pool;
+  }
+
+  // Moves up to kTransferBlocks free blocks of the given class to list,
+  // carving a new slab if there are none.
+  void Refill(size_t size_class, FreeList* list) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeList& shared = lists_[size_class];
+    if (shared.count == 0) {
+      size_t block_size = size_class * kAlignment;
+      std::unique_ptr<char[]> slab(new char[kSlabSize]);
+      for (size_t offset = 0; offset + block_size <= kSlabSize;
+           offset += block_size) {
+        shared.Push(slab.get() + offset);
+      }
+      slabs_.push_back(std::move(slab));
+      reserved_bytes_ += kSlabSize;
+    }
+    for (size_t i = 0; i < kTransferBlocks && shared.count > 0; ++i) {
+      list->Push(shared.Pop());
+    }
+  }
+
+  // Moves count blocks from list back to the shared free list.
+  void Release(size_t size_class, FreeList* list, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeList& shared = lists_[size_class];
+    for (size_t i = 0; i < count && list->count > 0; ++i) {
+      shared.Push(list->Pop());
+    }
+  }
+
+  void* AllocateOne(size_t size_class) {
+    FreeList list;
+    Refill(size_class, &list);
+    void* ptr = list.Pop();
+    Release(size_class, &list, list.count);
+    return ptr;
+  }
+
+  void FreeOne(size_t size_class, void* ptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lists_[size_class].Push(ptr);
+  }
+
+  size_t reserved_bytes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reserved_bytes_;
+  }
+
+ private:
+  std::mutex mutex_;
+  FreeList lists_[kNumClasses + 1];
+  std::vector<std::unique_ptr<char[]>> slabs_;
+  size_t reserved_bytes_ = 0;
+};
+
+// The thread cache is trivially destructible, so that it stays usable while
+// other thread locals holding IR nodes get destroyed. Once the thread exit
+// flush ran, allocations go straight to the shared pool.
+thread_local FreeList g_thread_lists[kNumClasses + 1];  // NOLINT
+thread_local bool g_thread_flushed = false;            // NOLINT
+
+struct ThreadCacheFlusher {
+  ~ThreadCacheFlusher() {
+    for (size_t i = 0; i <= kNumClasses; ++i) {
+      SharedPool::Get()->Release(i, &g_thread_lists[i],
+                                 g_thread_lists[i].count);
+    }
+    g_thread_flushed = true;
+  }
+};
+
+FreeList* GetThreadList(size_t size_class) {
+  thread_local ThreadCacheFlusher flusher;  // NOLINT
+  return g_thread_flushed ? nullptr : &g_thread_lists[size_class];
+}
+
+std::atomic<xla::int64> g_step_allocations{0};
+std::atomic<xla::int64> g_step_bytes{0};
+
+}  // namespace
+
+void* NodeArena::Allocate(size_t size) {
+  g_step_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_step_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (size > kMaxBlockSize) {
+    return ::operator new(size);
+  }
+  size_t size_class = SizeClass(size);
+  FreeList* list = GetThreadList(size_class);
+  if (list == nullptr) {
+    return SharedPool::Get()->AllocateOne(size_class);
+  }
+  if (list->count == 0) {
+    SharedPool::Get()->Refill(size_class, list);
+  }
+  return list->Pop();
+}
+
+void NodeArena::Free(void* ptr, size_t size) {
+  if (size > kMaxBlockSize) {
+    ::operator delete(ptr);
+    return;
+  }
+  size_t size_class = SizeClass(size);
+  FreeList* list = GetThreadList(size_class);
+  if (list == nullptr) {
+    SharedPool::Get()->FreeOne(size_class, ptr);
+    return;
+  }
+  list->Push(ptr);
+  if (list->count > kMaxCachedBlocks) {
+    SharedPool::Get()->Release(size_class, list, kTransferBlocks);
+  }
+}
+
+void NodeArena::MarkStep() {
+  XLA_VALUE_METRIC("IrNodeAllocationsPerStep", g_step_allocations.exchange(0));
+  XLA_VALUE_METRIC("IrNodeBytesPerStep", g_step_bytes.exchange(0));
+  XLA_VALUE_METRIC("IrNodeArenaReservedBytes",
+                   SharedPool::Get()->reserved_bytes());
+  for (size_t i = 0; i <= kNumClasses; ++i) {
+    FreeList* list = GetThreadList(i);
+    if (list != nullptr && list->count > kTransferBlocks) {
+      SharedPool::Get()->Release(i, list, list->count - kTransferBlocks);
+    }
+  }
+}
+
+bool NodeArena::Enabled() {
+  static bool enabled = xla::sys_util::GetEnvBool("XLA_IR_NODE_ARENA", true);
+  return enabled;
+}
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace swift_xla {
+namespace ir {
+
+// Slab allocator for the IR nodes, and their shared pointer control blocks, and
+// for the XLATensor objects handed out by the C API.
+// Memory is handed out from per size class free lists, cached per thread,
+// which are refilled from slabs that are never returned to the system. Freed
+// nodes go back to the free list of the freeing thread, so nodes escaping
+// into live tensors, or released by other threads, keep the regular
+// shared_ptr semantics.
+class NodeArena {
+ public:
+  static void* Allocate(size_t size);
+
+  static void Free(void* ptr, size_t size);
+
+  // Reports the node allocations since the previous step as metrics, and
+  // hands the memory cached by the calling thread in excess of its steady
+  // state back to the shared free lists.
+  static void MarkStep();
+
+  // Whether MakeNode() uses the arena (XLA_IR_NODE_ARENA).
+  static bool Enabled();
+};
+
+// Standard allocator interface over NodeArena, for std::allocate_shared().
+template <typename T>
+class NodeAllocator {
+ public:
+  using value_type = T;
+
+  NodeAllocator() = default;
+
+  template <typename U>
+  NodeAllocator(const NodeAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(NodeArena::Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) { NodeArena::Free(ptr, n * sizeof(T)); }
+
+  template <typename U>
+  bool operator==(const NodeAllocator<U>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const NodeAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -14,8 +14,18 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/op_by_op_executor.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include "absl/container/node_hash_map.h"
 #include "absl/strings/str_cat.h"
@@ -23,6 +33,7 @@
 #include "tensorflow/compiler/xla/xla_client/device.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
@@ -34,50 +45,138 @@
 namespace swift_xla {
 namespace {
 
-absl::optional<size_t> GetOutputIndex(bool is_device_data, size_t index) {
-  // The output of every result of an op-by-op computation is wrapped into a
-  // tuple, so we need to use the index to extract it. Device data instead is
-  // already unwrapped, so we need to pass an empty index so that TF/XRT code
-  // uses the result buffer directly.
-  if (is_device_data) {
-    return absl::nullopt;
+using ChainedInput = xla::ComputationClient::ExecuteChainedOp::Input;
+
+// The op kinds which are cheap and elementwise, so that runs of them are worth
+// lowering into a single computation, instead of one launch per node with the
+// intermediate values going through device memory.
+const std::unordered_set<std::string>& GetClusterableOps() {
+  static const std::unordered_set<std::string>* clusterable_ops =
+      new std::unordered_set<std::string>({
+          "aten::abs",         "aten::acos",         "aten::acosh",
+          "aten::add",         "aten::asin",         "aten::asinh",
+          "aten::atan",        "aten::atanh",        "aten::bitwise_not",
+          "aten::ceil",        "aten::clamp",        "aten::cos",
+          "aten::cosh",        "aten::div",          "aten::eq",
+          "aten::exp",         "aten::expand",       "aten::expm1",
+          "aten::floor",       "aten::ge",           "aten::gt",
+          "aten::le",          "aten::log",          "aten::log1p",
+          "aten::logical_and", "aten::logical_or",   "aten::lt",
+          "aten::mul",         "aten::ne",           "aten::neg",
+          "aten::pow",         "aten::relu",         "aten::round_to_even",
+          "aten::rsqrt",       "aten::sigmoid",      "aten::sign",
+          "aten::sin",         "aten::sinh",         "aten::sqrt",
+          "aten::sub",         "aten::tan",          "aten::tanh",
+          "aten::threshold_backward", "aten::where", "aten::xla_is_finite",
+          "aten::xla_is_inf",  "aten::xla_is_nan",   "aten::xla_rem",
+          "prim::Constant",    "xla::cast",
+      });
+  return *clusterable_ops;
+}
+
+size_t GetMaxClusterSize() {
+  static const size_t max_cluster_size =
+      xla::sys_util::GetEnvInt("XLA_OP_BY_OP_MAX_CLUSTER_SIZE", 32);
+  return max_cluster_size;
+}
+
+// Splits the post-order into the units run as a single chained op: the device
+// data nodes, which come first, then the runs of consecutive clusterable nodes,
+// and the other nodes on their own. As a run is consecutive in the post-order,
+// every path between two of its nodes only goes through nodes of the run, so
+// the units can be run in order.
+std::vector<std::vector<size_t>> ClusterPostOrder(
+    absl::Span<const ir::Node* const> post_order) {
+  std::vector<std::vector<size_t>> units;
+  std::vector<std::vector<size_t>> compute_units;
+  bool open_cluster = false;
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const ir::Node* node = post_order[i];
+    if (ir::ops::DeviceData::Cast(node) != nullptr) {
+      units.push_back({i});
+      continue;
+    }
+    bool clusterable = GetMaxClusterSize() > 1 &&
+                       GetClusterableOps().count(node->op().ToString()) > 0;
+    if (clusterable && open_cluster &&
+        compute_units.back().size() < GetMaxClusterSize()) {
+      compute_units.back().push_back(i);
+      continue;
+    }
+    compute_units.push_back({i});
+    open_cluster = clusterable;
   }
-  return index;
+  units.insert(units.end(), std::make_move_iterator(compute_units.begin()),
+               std::make_move_iterator(compute_units.end()));
+  return units;
 }
 
-const xla::Shape& GetParameterShape(const ir::Output& operand,
-                                    const xla::Shape& input_shape) {
-  // See comment in GetOutputIndex() about device data WRT computation outpout
-  // shape handling.
-  const ir::ops::DeviceData* device_data =
-      ir::ops::DeviceData::Cast(operand.node);
-  return device_data != nullptr
-             ? input_shape
-             : xla::ShapeUtil::GetTupleElementShape(input_shape, operand.index);
+const xla::Shape& GetInputShape(
+    const ChainedInput& input, absl::Span<const xla::Shape* const> ops_shapes) {
+  // The outputs of the computations are wrapped into a tuple, while device data
+  // is used as is.
+  const xla::Shape& shape = *ops_shapes[input.op_index];
+  return input.output_index
+             ? xla::ShapeUtil::GetTupleElementShape(shape, *input.output_index)
+             : shape;
 }
 
 xla::hash_t ComputeNodeKey(const ir::Node* node,
                            absl::Span<const xla::Shape* const> input_shapes,
                            const xla::hash_t& seed) {
   xla::hash_t key = seed;
-  const auto& operands = node->operands();
-  for (size_t i = 0; i < operands.size(); ++i) {
-    key = xla::util::HashCombine(key, xla::util::ShapeHash(GetParameterShape(
-                                          operands[i], *input_shapes[i])));
+  for (const xla::Shape* shape : input_shapes) {
+    key = xla::util::HashCombine(key, xla::util::ShapeHash(*shape));
   }
   key = xla::util::HashCombine(key, xla::util::ShapeHash(node->shape()));
   return xla::util::HashCombine(key, node->node_hash());
 }
 
+// Extends ComputeNodeKey() to a cluster, whose key also covers how its nodes
+// are wired to each other, to its inputs and to its results.
+xla::hash_t ComputeClusterKey(
+    absl::Span<const ir::Node* const> nodes,
+    absl::Span<const ir::Output> inputs,
+    absl::Span<const xla::Shape* const> input_shapes,
+    absl::Span<const ir::Output> results, const xla::hash_t& seed) {
+  absl::node_hash_map<const ir::Node*, size_t> node_positions;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    node_positions[nodes[i]] = i;
+  }
+  auto output_key = [&](const ir::Output& output) {
+    auto it = node_positions.find(output.node);
+    if (it != node_positions.end()) {
+      return xla::util::MHash(it->second, output.index);
+    }
+    size_t input_index =
+        std::find(inputs.begin(), inputs.end(), output) - inputs.begin();
+    return xla::util::MHash(nodes.size() + input_index);
+  };
+  xla::hash_t key = seed;
+  for (const xla::Shape* shape : input_shapes) {
+    key = xla::util::HashCombine(key, xla::util::ShapeHash(*shape));
+  }
+  for (const ir::Node* node : nodes) {
+    key = xla::util::HashCombine(key, node->node_hash());
+    key = xla::util::HashCombine(key, xla::util::ShapeHash(node->shape()));
+    for (const ir::Output& operand : node->operands()) {
+      key = xla::util::HashCombine(key, output_key(operand));
+    }
+  }
+  for (const ir::Output& result : results) {
+    key = xla::util::HashCombine(key, output_key(result));
+  }
+  return key;
+}
+
 xla::XlaComputation BuildNodeComputation(
     const ir::Node* node, absl::Span<const xla::Shape* const> input_shapes,
     const Device& device) {
   ir::RootLoweringContext loctx("BuildNodeComputation", device);
   const auto& operands = node->operands();
   for (size_t i = 0; i < operands.size(); ++i) {
-    xla::XlaOp param = xla::Parameter(
-        loctx.builder(), i, GetParameterShape(operands[i], *input_shapes[i]),
-        absl::StrCat("p", i));
+    xla::XlaOp param = xla::Parameter(loctx.builder(), i, *input_shapes[i],
+                                      absl::StrCat("p", i));
     loctx.AssignOutputOp(operands[i], param);
   }
   for (auto& xla_op : loctx.LowerNode(node)) {
@@ -86,6 +185,120 @@ xla::XlaComputation BuildNodeComputation(
   return ConsumeValue(loctx.Build());
 }
 
+xla::XlaComputation BuildClusterComputation(
+    absl::Span<const ir::Node* const> nodes,
+    absl::Span<const ir::Output> inputs,
+    absl::Span<const xla::Shape* const> input_shapes,
+    absl::Span<const ir::Output> results, const Device& device) {
+  ir::RootLoweringContext loctx("BuildClusterComputation", device);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    xla::XlaOp param = xla::Parameter(loctx.builder(), i, *input_shapes[i],
+                                      absl::StrCat("p", i));
+    loctx.AssignOutputOp(inputs[i], param);
+  }
+  for (const ir::Node* node : nodes) {
+    loctx.LowerNode(node);
+  }
+  for (const ir::Output& result : results) {
+    loctx.AddResult(loctx.GetOutputOp(result));
+  }
+  return ConsumeValue(loctx.Build());
+}
+
+// An output of a chained op, as its index and its optional tuple index.
+using ChainedValue = std::pair<size_t, absl::optional<size_t>>;
+
+// The computations compiled in the background, as the indices of their compile
+// instances, not yet applied to the chained ops.
+struct CompileArrivals {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::pair<size_t, xla::ComputationClient::ComputationPtr>>
+      computations;
+  std::exception_ptr exception;
+};
+
+// Returns the ops not executed yet, whose computation is available and whose
+// inputs are either executed or runnable themselves.
+std::vector<bool> GetRunnableOps(
+    absl::Span<const xla::ComputationClient::ExecuteChainedOp> ops,
+    const std::vector<bool>& executed) {
+  std::vector<bool> runnable(ops.size(), false);
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (executed[i] || ops[i].computation == nullptr) {
+      continue;
+    }
+    runnable[i] = std::all_of(
+        ops[i].inputs.begin(), ops[i].inputs.end(),
+        [&](const ChainedInput& input) {
+          return executed[input.op_index] || runnable[input.op_index];
+        });
+  }
+  return runnable;
+}
+
+// Builds the chained ops running the in_stage ops, whose inputs coming from
+// the already executed ops are fed as device data. Returns the values the
+// stage outputs, in result order, which are the ones used by the ops running
+// after the stage, or by the roots.
+std::vector<ChainedValue> BuildStageOps(
+    absl::Span<const xla::ComputationClient::ExecuteChainedOp> ops,
+    const std::vector<bool>& executed, const std::vector<bool>& in_stage,
+    absl::Span<const ChainedValue> root_values,
+    const std::map<ChainedValue, xla::ComputationClient::DataPtr>& values,
+    std::vector<xla::ComputationClient::ExecuteChainedOp>* stage_ops) {
+  std::vector<size_t> stage_indices(ops.size());
+  std::map<ChainedValue, size_t> imported_values;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (!in_stage[i]) {
+      continue;
+    }
+    xla::ComputationClient::ExecuteChainedOp cxop;
+    cxop.computation = ops[i].computation;
+    for (const ChainedInput& input : ops[i].inputs) {
+      if (in_stage[input.op_index]) {
+        cxop.inputs.push_back(
+            {stage_indices[input.op_index], input.output_index});
+        continue;
+      }
+      ChainedValue value(input.op_index, input.output_index);
+      auto it = imported_values.find(value);
+      if (it == imported_values.end()) {
+        xla::ComputationClient::ExecuteChainedOp data_op;
+        data_op.device_data = values.at(value);
+        it = imported_values.emplace(value, stage_ops->size()).first;
+        stage_ops->push_back(std::move(data_op));
+      }
+      cxop.inputs.push_back({it->second, absl::nullopt});
+    }
+    stage_indices[i] = stage_ops->size();
+    stage_ops->push_back(std::move(cxop));
+  }
+
+  std::set<ChainedValue> stage_values;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (executed[i] || in_stage[i]) {
+      continue;
+    }
+    for (const ChainedInput& input : ops[i].inputs) {
+      if (in_stage[input.op_index]) {
+        stage_values.emplace(input.op_index, input.output_index);
+      }
+    }
+  }
+  for (const ChainedValue& root_value : root_values) {
+    if (in_stage[root_value.first]) {
+      stage_values.insert(root_value);
+    }
+  }
+  std::vector<ChainedValue> results(stage_values.begin(), stage_values.end());
+  for (size_t i = 0; i < results.size(); ++i) {
+    (*stage_ops)[stage_indices[results[i].first]].outputs.push_back(
+        {i, results[i].second});
+  }
+  return results;
+}
+
 xla::hash_t GetNodesKeySeed(const std::string& device,
                             absl::Span<const std::string> devices) {
   return xla::util::MHash(device, devices);
@@ -96,9 +309,11 @@ xla::hash_t GetNodesKeySeed(const std::string& device,
 OpByOpExecutor::OpByOpExecutor(size_t compile_cache_size)
     : compile_cache_(compile_cache_size) {}
 
-std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
-    absl::Span<const ir::Value> roots, const std::string& device,
-    absl::Span<const std::string> devices) {
+std::vector<xla::ComputationClient::ExecuteChainedOp>
+OpByOpExecutor::BuildPendingOps(absl::Span<const ir::Value> roots,
+                                const std::string& device,
+                                absl::Span<const std::string> devices,
+                                PendingCompiles* pending) {
   std::vector<const ir::Node*> root_nodes;
   root_nodes.reserve(roots.size());
   for (auto& root : roots) {
@@ -109,96 +324,168 @@ std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
   XLA_VALUE_METRIC("OpByOpGraphSize", post_order.size());
   TF_VLOG(5) << "TensorsGraphSize=" << post_order.size();
 
+  std::vector<std::vector<size_t>> units = ClusterPostOrder(post_order);
+  XLA_VALUE_METRIC("OpByOpLaunches", units.size());
+  std::vector<size_t> node_units(post_order.size());
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t i : units[u]) {
+      node_units[i] = u;
+    }
+  }
   absl::node_hash_map<const ir::Node*, size_t> node_to_index;
   node_to_index.reserve(post_order.size());
   for (size_t i = 0; i < post_order.size(); ++i) {
     node_to_index[post_order[i]] = i;
   }
+  // The results of the clusters are their node outputs used by other units, or
+  // requested as roots.
+  std::vector<std::vector<ir::Output>> cluster_results(units.size());
+  auto add_cluster_result = [&](const ir::Output& output, size_t user_unit) {
+    size_t unit = node_units[node_to_index.at(output.node)];
+    std::vector<ir::Output>& results = cluster_results[unit];
+    if (units[unit].size() > 1 && unit != user_unit &&
+        std::find(results.begin(), results.end(), output) == results.end()) {
+      results.push_back(output);
+    }
+  };
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    for (const ir::Output& operand : post_order[i]->operands()) {
+      add_cluster_result(operand, node_units[i]);
+    }
+  }
+  for (const ir::Value& root : roots) {
+    add_cluster_result(ir::Output(root.node.get(), root.index), units.size());
+  }
+  // Where every node output can be found within the chained ops.
+  absl::node_hash_map<ir::Output, ChainedInput, ir::Output::Hasher>
+      output_inputs;
+  auto get_output_input = [&](const ir::Output& output) -> ChainedInput {
+    auto it = output_inputs.find(output);
+    if (it != output_inputs.end()) {
+      return it->second;
+    }
+    size_t unit = node_units[node_to_index.at(output.node)];
+    if (ir::ops::DeviceData::Cast(output.node) != nullptr) {
+      return {unit, absl::nullopt};
+    }
+    return {unit, output.index};
+  };
 
-  auto compilation_devices =
+  pending->devices =
       xla::ComputationClient::GetCompilationDevices(device, devices);
-  xla::hash_t nodes_key_seed = GetNodesKeySeed(device, compilation_devices);
+  xla::hash_t nodes_key_seed = GetNodesKeySeed(device, pending->devices);
   Device exec_device(device);
-  std::vector<xla::hash_t> cache_keys;
   absl::node_hash_map<xla::hash_t, std::vector<size_t>, xla::util::HashReducer>
       compile_indices;
   absl::node_hash_map<xla::hash_t, size_t, xla::util::HashReducer>
       cache_keys_instance;
-  std::list<xla::Shape> compile_shapes;
-  std::vector<bool> device_data_ops(post_order.size());
-  std::vector<const xla::Shape*> ops_shapes(post_order.size());
-  std::vector<xla::ComputationClient::CompileInstance> compile_instances;
+  std::vector<const xla::Shape*> ops_shapes(units.size());
   std::vector<xla::ComputationClient::ExecuteChainedOp> chained_exec_ops(
-      post_order.size());
-  for (size_t i = 0; i < post_order.size(); ++i) {
-    const ir::Node* node = post_order[i];
-    xla::ComputationClient::ExecuteChainedOp& cxop = chained_exec_ops[i];
+      units.size());
+  for (size_t u = 0; u < units.size(); ++u) {
+    xla::ComputationClient::ExecuteChainedOp& cxop = chained_exec_ops[u];
+    const ir::Node* node = post_order[units[u].front()];
     const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
     if (device_data != nullptr) {
       cxop.device_data = device_data->data();
-      ops_shapes[i] = &cxop.device_data->shape();
-      device_data_ops[i] = true;
-    } else {
-      std::vector<const xla::Shape*> op_input_shapes;
-      for (auto& operand : node->operands()) {
-        size_t op_index = node_to_index.at(operand.node);
-        cxop.inputs.push_back(
-            {op_index,
-             GetOutputIndex(device_data_ops[op_index], operand.index)});
-        op_input_shapes.push_back(ops_shapes[op_index]);
+      ops_shapes[u] = &cxop.device_data->shape();
+      continue;
+    }
+    std::vector<const ir::Node*> nodes;
+    std::vector<ir::Output> inputs;
+    for (size_t i : units[u]) {
+      nodes.push_back(post_order[i]);
+      for (const ir::Output& operand : post_order[i]->operands()) {
+        if (node_units[node_to_index.at(operand.node)] != u &&
+            (units[u].size() == 1 || std::find(inputs.begin(), inputs.end(),
+                                               operand) == inputs.end())) {
+          inputs.push_back(operand);
+        }
       }
+    }
+    std::vector<const xla::Shape*> op_input_shapes;
+    for (const ir::Output& input : inputs) {
+      ChainedInput chained_input = get_output_input(input);
+      cxop.inputs.push_back(chained_input);
+      op_input_shapes.push_back(&GetInputShape(chained_input, ops_shapes));
+    }
+    const std::vector<ir::Output>& results = cluster_results[u];
+    for (size_t i = 0; i < results.size(); ++i) {
+      output_inputs[results[i]] = {u, i};
+    }
 
-      xla::hash_t cache_key =
-          ComputeNodeKey(node, op_input_shapes, nodes_key_seed);
-      cxop.computation = compile_cache_.Get(cache_key);
-      if (cxop.computation == nullptr) {
-        XLA_COUNTER("OpByOpCompileCacheMiss", 1);
-
-        // Within a single IR graph, there can be many duplicated IR nodes, so
-        // make sure we do not issue an XLA compilation for each one of those.
-        auto& cache_key_indices = compile_indices[cache_key];
-        cache_key_indices.push_back(i);
-        if (cache_key_indices.size() == 1) {
-          cache_keys.push_back(cache_key);
-          cache_keys_instance[cache_key] = compile_instances.size();
-
-          xla::XlaComputation computation =
-              BuildNodeComputation(node, op_input_shapes, exec_device);
-          xla::ProgramShape program_shape =
-              ConsumeValue(computation.GetProgramShape());
-          compile_shapes.push_back(MakeShapeWithDeviceLayout(
-              program_shape.result(), exec_device.hw_type));
-          compile_instances.push_back(
-              {std::move(computation), &compile_shapes.back()});
-          ops_shapes[i] = &compile_shapes.back();
-        } else {
-          ops_shapes[i] =
-              compile_instances[cache_keys_instance.at(cache_key)].output_shape;
-        }
+    xla::hash_t cache_key =
+        nodes.size() == 1
+            ? ComputeNodeKey(node, op_input_shapes, nodes_key_seed)
+            : ComputeClusterKey(nodes, inputs, op_input_shapes, results,
+                                nodes_key_seed);
+    cxop.computation = compile_cache_.Get(cache_key);
+    if (cxop.computation == nullptr) {
+      XLA_COUNTER("OpByOpCompileCacheMiss", 1);
+
+      // Within a single IR graph, there can be many duplicated IR nodes, so
+      // make sure we do not issue an XLA compilation for each one of those.
+      auto& cache_key_indices = compile_indices[cache_key];
+      cache_key_indices.push_back(u);
+      if (cache_key_indices.size() == 1) {
+        pending->cache_keys.push_back(cache_key);
+        cache_keys_instance[cache_key] = pending->instances.size();
+
+        xla::XlaComputation computation =
+            nodes.size() == 1
+                ? BuildNodeComputation(node, op_input_shapes, exec_device)
+                : BuildClusterComputation(nodes, inputs, op_input_shapes,
+                                          results, exec_device);
+        xla::ProgramShape program_shape =
+            ConsumeValue(computation.GetProgramShape());
+        pending->shapes.push_back(MakeShapeWithDeviceLayout(
+            program_shape.result(), exec_device.hw_type));
+        pending->instances.push_back(
+            {std::move(computation), &pending->shapes.back()});
+        ops_shapes[u] = &pending->shapes.back();
       } else {
-        ops_shapes[i] = &cxop.computation->program_shape().result();
+        ops_shapes[u] =
+            pending->instances[cache_keys_instance.at(cache_key)].output_shape;
       }
+    } else {
+      ops_shapes[u] = &cxop.computation->program_shape().result();
+    }
+    if (nodes.size() > 1) {
+      XLA_COUNTER("OpByOpClusters", 1);
+      XLA_VALUE_METRIC("OpByOpClusterSize", nodes.size());
     }
   }
   // Fixup the requested outputs (roots) within the chained ops vector.
   for (size_t i = 0; i < roots.size(); ++i) {
-    size_t op_index = node_to_index.at(roots[i].node.get());
-    chained_exec_ops[op_index].outputs.push_back(
-        {i, GetOutputIndex(device_data_ops[op_index], roots[i].index)});
+    ChainedInput root_input =
+        get_output_input(ir::Output(roots[i].node.get(), roots[i].index));
+    chained_exec_ops[root_input.op_index].outputs.push_back(
+        {i, root_input.output_index});
   }
 
+  for (const xla::hash_t& cache_key : pending->cache_keys) {
+    pending->op_indices.push_back(std::move(compile_indices[cache_key]));
+  }
+  return chained_exec_ops;
+}
+
+std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
+    absl::Span<const ir::Value> roots, const std::string& device,
+    absl::Span<const std::string> devices) {
+  PendingCompiles pending;
+  auto chained_exec_ops = BuildPendingOps(roots, device, devices, &pending);
   // If we missed the cache for certain ops, compile them now and fixup the
   // chained ops vector.
-  if (!compile_instances.empty()) {
-    TF_VLOG(3) << "Compiling " << compile_instances.size()
+  if (!pending.instances.empty()) {
+    TF_VLOG(3) << "Compiling " << pending.instances.size()
                << " computations on device " << device;
     auto computation_ptrs = xla::GetX10Device(device)->Compile(
-        compilation_devices, std::move(compile_instances));
+        pending.devices, std::move(pending.instances));
     TF_VLOG(3) << "Compiling " << computation_ptrs.size()
                << " computations on device " << device << " done!";
     for (size_t i = 0; i < computation_ptrs.size(); ++i) {
-      compile_cache_.Add(cache_keys[i], computation_ptrs[i]);
-      for (auto index : compile_indices[cache_keys[i]]) {
+      compile_cache_.Add(pending.cache_keys[i], computation_ptrs[i]);
+      for (auto index : pending.op_indices[i]) {
         chained_exec_ops[index].computation = computation_ptrs[i];
       }
     }
@@ -209,8 +496,122 @@ std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
 std::vector<xla::ComputationClient::DataPtr> OpByOpExecutor::Execute(
     absl::Span<const ir::Value> roots, const std::string& device,
     absl::Span<const std::string> devices) {
-  auto chained_exec_ops = BuildOps(roots, device, devices);
-  return xla::GetX10Device(device)->ExecuteChained(chained_exec_ops);
+  auto pending = std::make_shared<PendingCompiles>();
+  auto chained_exec_ops =
+      BuildPendingOps(roots, device, devices, pending.get());
+  if (pending->instances.empty()) {
+    return xla::GetX10Device(device)->ExecuteChained(chained_exec_ops);
+  }
+  return ExecutePipelined(std::move(chained_exec_ops), std::move(pending),
+                          device, roots.size());
+}
+
+std::vector<xla::ComputationClient::DataPtr> OpByOpExecutor::ExecutePipelined(
+    std::vector<xla::ComputationClient::ExecuteChainedOp> chained_exec_ops,
+    std::shared_ptr<PendingCompiles> pending, const std::string& device,
+    size_t num_results) {
+  xla::ComputationClient::Device* x10_device = xla::GetX10Device(device);
+  // The compilations run on the IO thread pool, as they wait for the compile
+  // service, each one reporting its computation when done.
+  auto arrivals = std::make_shared<CompileArrivals>();
+  TF_VLOG(3) << "Compiling " << pending->instances.size()
+             << " computations on device " << device << " in the background";
+  for (size_t i = 0; i < pending->instances.size(); ++i) {
+    xla::env::ScheduleIoClosure([x10_device, pending, arrivals, i]() {
+      std::vector<xla::ComputationClient::CompileInstance> instances;
+      instances.push_back(std::move(pending->instances[i]));
+      xla::ComputationClient::ComputationPtr computation;
+      std::exception_ptr exception;
+      try {
+        computation =
+            x10_device->Compile(pending->devices, std::move(instances)).front();
+      } catch (...) {
+        exception = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(arrivals->mutex);
+      if (exception != nullptr) {
+        arrivals->exception = exception;
+      } else {
+        arrivals->computations.emplace_back(i, std::move(computation));
+      }
+      arrivals->cv.notify_one();
+    });
+  }
+  auto take_arrivals = [&](bool wait) {
+    std::vector<std::pair<size_t, xla::ComputationClient::ComputationPtr>>
+        computations;
+    {
+      std::unique_lock<std::mutex> lock(arrivals->mutex);
+      if (wait) {
+        arrivals->cv.wait(lock, [&] {
+          return !arrivals->computations.empty() ||
+                 arrivals->exception != nullptr;
+        });
+      }
+      if (arrivals->exception != nullptr) {
+        std::rethrow_exception(arrivals->exception);
+      }
+      computations.swap(arrivals->computations);
+    }
+    for (auto& index_computation : computations) {
+      size_t index = index_computation.first;
+      compile_cache_.Add(pending->cache_keys[index], index_computation.second);
+      for (auto op_index : pending->op_indices[index]) {
+        chained_exec_ops[op_index].computation = index_computation.second;
+      }
+    }
+  };
+
+  // The values of the executed ops which are used by the ops still to run, or
+  // are results.
+  std::map<ChainedValue, xla::ComputationClient::DataPtr> values;
+  std::vector<ChainedValue> root_values(num_results);
+  std::vector<bool> executed(chained_exec_ops.size(), false);
+  size_t num_executed = 0;
+  for (size_t i = 0; i < chained_exec_ops.size(); ++i) {
+    xla::ComputationClient::ExecuteChainedOp& cxop = chained_exec_ops[i];
+    for (auto& output : cxop.outputs) {
+      root_values[output.result_index] = {i, output.output_index};
+    }
+    cxop.outputs.clear();
+    if (cxop.device_data != nullptr) {
+      values[{i, absl::nullopt}] = cxop.device_data;
+      executed[i] = true;
+      ++num_executed;
+    }
+  }
+  size_t num_stages = 0;
+  while (num_executed < chained_exec_ops.size()) {
+    take_arrivals(/*wait=*/false);
+    std::vector<bool> in_stage = GetRunnableOps(chained_exec_ops, executed);
+    std::vector<xla::ComputationClient::ExecuteChainedOp> stage_ops;
+    std::vector<ChainedValue> stage_values = BuildStageOps(
+        chained_exec_ops, executed, in_stage, root_values, values, &stage_ops);
+    if (stage_ops.empty()) {
+      take_arrivals(/*wait=*/true);
+      continue;
+    }
+    std::vector<xla::ComputationClient::DataPtr> results =
+        x10_device->ExecuteChained(stage_ops);
+    for (size_t i = 0; i < stage_values.size(); ++i) {
+      values[stage_values[i]] = std::move(results[i]);
+    }
+    for (size_t i = 0; i < chained_exec_ops.size(); ++i) {
+      if (in_stage[i]) {
+        executed[i] = true;
+        ++num_executed;
+      }
+    }
+    ++num_stages;
+  }
+  XLA_VALUE_METRIC("OpByOpPipelineStages", num_stages);
+
+  std::vector<xla::ComputationClient::DataPtr> results;
+  results.reserve(root_values.size());
+  for (const ChainedValue& root_value : root_values) {
+    results.push_back(values.at(root_value));
+  }
+  return results;
 }
 
 OpByOpExecutor::AsyncTask OpByOpExecutor::ExecuteAsync(
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <list>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -44,6 +46,9 @@ class OpByOpExecutor {
       absl::Span<const ir::Value> roots, const std::string& device,
       absl::Span<const std::string> devices);
 
+  // Runs the IR graph. The computations missing from the cache are compiled
+  // in parallel, while the ops whose computations are available already run,
+  // and the ops depending on the missing ones run as those get compiled.
   std::vector<xla::ComputationClient::DataPtr> Execute(
       absl::Span<const ir::Value> roots, const std::string& device,
       absl::Span<const std::string> devices);
@@ -57,8 +62,29 @@ class OpByOpExecutor {
       xla::util::Cache<xla::hash_t, xla::ComputationClient::Computation,
                        xla::util::HashReducer>;
 
+  // The computations missing from the cache while building the chained ops,
+  // whose computation is left null until they get compiled.
+  struct PendingCompiles {
+    std::vector<std::string> devices;
+    std::vector<xla::hash_t> cache_keys;
+    // For every computation, the indices of the chained ops running it.
+    std::vector<std::vector<size_t>> op_indices;
+    std::vector<xla::ComputationClient::CompileInstance> instances;
+    // Owns the output shapes the compile instances point to.
+    std::list<xla::Shape> shapes;
+  };
+
   explicit OpByOpExecutor(size_t compile_cache_size);
 
+  std::vector<xla::ComputationClient::ExecuteChainedOp> BuildPendingOps(
+      absl::Span<const ir::Value> roots, const std::string& device,
+      absl::Span<const std::string> devices, PendingCompiles* pending);
+
+  std::vector<xla::ComputationClient::DataPtr> ExecutePipelined(
+      std::vector<xla::ComputationClient::ExecuteChainedOp> chained_exec_ops,
+      std::shared_ptr<PendingCompiles> pending, const std::string& device,
+      size_t num_results);
+
   CompileCache compile_cache_;
 };
 
@@ -0,0 +1,112 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/adam_update.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_updates.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+std::vector<Value> GetOperandList(
+    absl::Span<const Value> weights, absl::Span<const Value> grads,
+    absl::Span<const Value> m, absl::Span<const Value> v,
+    std::initializer_list<Value> hyperparameters,
+    const absl::optional<Value>& grads_finite) {
+  XLA_CHECK_EQ(weights.size(), grads.size());
+  XLA_CHECK_EQ(weights.size(), m.size());
+  XLA_CHECK_EQ(weights.size(), v.size());
+  std::vector<Value> operand_list;
+  operand_list.reserve(4 * weights.size() + hyperparameters.size());
+  for (absl::Span<const Value> values : {weights, grads, m, v}) {
+    operand_list.insert(operand_list.end(), values.begin(), values.end());
+  }
+  operand_list.insert(operand_list.end(), hyperparameters.begin(),
+                      hyperparameters.end());
+  if (grads_finite) {
+    operand_list.push_back(*grads_finite);
+  }
+  return operand_list;
+}
+
+xla::Shape NodeOutputShape(absl::Span<const Value> weights,
+                           absl::Span<const Value> m,
+                           absl::Span<const Value> v) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(3 * weights.size());
+  for (absl::Span<const Value> values : {weights, m, v}) {
+    for (const Value& value : values) {
+      tuple_shapes.push_back(value.shape());
+    }
+  }
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+}  // namespace
+
+AdamUpdate::AdamUpdate(absl::Span<const Value> weights,
+                       absl::Span<const Value> grads, absl::Span<const Value> m,
+                       absl::Span<const Value> v, const Value& learning_rate,
+                       const Value& beta1, const Value& beta2,
+                       const Value& epsilon, const Value& weight_decay,
+                       const absl::optional<Value>& grads_finite)
+    : Node(xla_adam_update,
+           GetOperandList(weights, grads, m, v,
+                          {learning_rate, beta1, beta2, epsilon, weight_decay},
+                          grads_finite),
+           [&]() { return NodeOutputShape(weights, m, v); },
+           /*num_outputs=*/3 * weights.size()),
+      num_weights_(weights.size()) {}
+
+NodePtr AdamUpdate::Clone(OpList operands) const {
+  size_t n = num_weights_;
+  return MakeNode<AdamUpdate>(
+      operands.subspan(0, n), operands.subspan(n, n),
+      operands.subspan(2 * n, n), operands.subspan(3 * n, n),
+      operands.at(4 * n), operands.at(4 * n + 1), operands.at(4 * n + 2),
+      operands.at(4 * n + 3), operands.at(4 * n + 4),
+      operands.size() > 4 * n + 5
+          ? absl::optional<Value>(operands.at(4 * n + 5))
+          : absl::nullopt);
+}
+
+XlaOpVector AdamUpdate::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  absl::Span<const xla::XlaOp> input_span(inputs);
+  size_t n = num_weights_;
+  return ReturnOps(
+      BuildAdamUpdate(input_span.subspan(0, n), input_span.subspan(n, n),
+                      input_span.subspan(2 * n, n),
+                      input_span.subspan(3 * n, n), inputs[4 * n],
+                      inputs[4 * n + 1], inputs[4 * n + 2], inputs[4 * n + 3],
+                      inputs[4 * n + 4],
+                      inputs.size() > 4 * n + 5
+                          ? absl::optional<xla::XlaOp>(inputs[4 * n + 5])
+                          : absl::nullopt),
+      loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -18,6 +18,7 @@
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 
 namespace swift_xla {
@@ -43,24 +44,32 @@ std::vector<Value> GetOperandList(absl::Span<const Value> operands,
   return operand_list;
 }
 
+int GetWireType(const AllReduceOptions& options) {
+  return options.wire_type ? static_cast<int>(*options.wire_type) : -1;
+}
+
 }  // namespace
 
 AllReduce::AllReduce(AllReduceType reduce_type,
                      absl::Span<const Value> operands, const Value& token,
-                     double scale, std::vector<std::vector<xla::int64>> groups)
+                     double scale, std::vector<std::vector<xla::int64>> groups,
+                     AllReduceOptions options)
     : Node(xla_cross_replica_sum, GetOperandList(operands, token),
            [&]() { return NodeOutputShape(operands, token); },
            /*num_outputs=*/operands.size() + 1,
            xla::util::MHash(xla::util::GetEnumValue(reduce_type), scale,
-                            groups)),
+                            groups, GetWireType(options),
+                            options.wire_type_min_elements,
+                            options.host_groups)),
       reduce_type_(reduce_type),
       scale_(scale),
-      groups_(std::move(groups)) {}
+      groups_(std::move(groups)),
+      options_(std::move(options)) {}
 
 NodePtr AllReduce::Clone(OpList operands) const {
   std::vector<Value> operand_list(operands.begin(), operands.end() - 1);
   return MakeNode<AllReduce>(reduce_type_, operand_list, operands.back(),
-                             scale_, groups_);
+                             scale_, groups_, options_);
 }
 
 XlaOpVector AllReduce::Lower(LoweringContext* loctx) const {
@@ -71,8 +80,9 @@ XlaOpVector AllReduce::Lower(LoweringContext* loctx) const {
     inputs.push_back(loctx->GetOutputOp(operand_list[i]));
   }
   xla::XlaOp token = loctx->GetOutputOp(operand_list.back());
-  return ReturnOps(BuildAllReduce(reduce_type_, inputs, token, scale_, groups_),
-                   loctx);
+  return ReturnOps(
+      BuildAllReduce(reduce_type_, inputs, token, scale_, groups_, options_),
+      loctx);
 }
 
 std::string AllReduce::ToString() const {
@@ -85,6 +95,15 @@ std::string AllReduce::ToString() const {
     ss << absl::StrJoin(groups_[i], ", ") << ")";
   }
   ss << ")";
+  if (options_.wire_type) {
+    ss << ", wire_type="
+       << xla::primitive_util::LowercasePrimitiveTypeName(*options_.wire_type)
+       << ", wire_type_min_elements=" << options_.wire_type_min_elements;
+  }
+  if (!options_.host_groups.empty()) {
+    ss << ", host_groups=" << options_.host_groups.size() << "x"
+       << options_.host_groups.front().size();
+  }
   return ss.str();
 }
 
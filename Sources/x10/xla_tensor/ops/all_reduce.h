@@ -27,7 +27,8 @@ class AllReduce : public Node {
  public:
   AllReduce(AllReduceType reduce_type, absl::Span<const Value> operands,
             const Value& token, double scale,
-            std::vector<std::vector<xla::int64>> groups);
+            std::vector<std::vector<xla::int64>> groups,
+            AllReduceOptions options = {});
 
   std::string ToString() const override;
 
@@ -41,10 +42,13 @@ class AllReduce : public Node {
 
   const std::vector<std::vector<xla::int64>>& groups() const { return groups_; }
 
+  const AllReduceOptions& options() const { return options_; }
+
  private:
   AllReduceType reduce_type_;
   double scale_;
   std::vector<std::vector<xla::int64>> groups_;
+  AllReduceOptions options_;
 };
 
 }  // namespace ops
@@ -18,14 +18,32 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 
 namespace swift_xla {
 namespace ir {
 namespace ops {
+namespace {
+
+// Sharded data is seen by the IR as the whole tensor, see sharding_util.h.
+xla::Shape GetDataShape(const xla::ComputationClient::Data& data) {
+  return data.sharding() != nullptr ? data.sharding()->shape : data.shape();
+}
+
+xla::hash_t GetDataHashSeed(const xla::ComputationClient::Data& data) {
+  xla::hash_t seed = 101;
+  if (data.sharding() != nullptr) {
+    seed = xla::util::HashCombine(
+        seed, xla::util::Hash(data.sharding()->sharding.SerializeAsString()));
+  }
+  return seed;
+}
+
+}  // namespace
 
 DeviceData::DeviceData(std::shared_ptr<xla::ComputationClient::Data> data)
-    : Node(xla_device_data, data->shape(), /*num_outputs=*/1,
-           /*hash_seed=*/101),
+    : Node(xla_device_data, GetDataShape(*data), /*num_outputs=*/1,
+           GetDataHashSeed(*data)),
       data_(std::move(data)) {}
 
 std::string DeviceData::ToString() const {
@@ -0,0 +1,82 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/embedding_bag.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& table, const Value& indices) {
+  const xla::Shape& table_shape = table.shape();
+  return xla::ShapeUtil::MakeShape(
+      table_shape.element_type(),
+      {indices.shape().dimensions(0), table_shape.dimensions(1)});
+}
+
+std::vector<Value> GetOperandList(
+    std::vector<Value> operands,
+    const absl::optional<Value>& per_sample_weights) {
+  if (per_sample_weights) {
+    operands.push_back(*per_sample_weights);
+  }
+  return operands;
+}
+
+}  // namespace
+
+EmbeddingBag::EmbeddingBag(const Value& table, const Value& indices,
+                           const absl::optional<Value>& per_sample_weights,
+                           EmbeddingBagMode mode)
+    : Node(xla_embedding_bag,
+           GetOperandList({table, indices}, per_sample_weights),
+           [&]() { return NodeOutputShape(table, indices); },
+           /*num_outputs=*/1, xla::util::MHash(xla::util::GetEnumValue(mode))),
+      mode_(mode) {}
+
+std::string EmbeddingBag::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", mode=" << xla::util::GetEnumValue(mode_);
+  return ss.str();
+}
+
+NodePtr EmbeddingBag::Clone(OpList operands) const {
+  absl::optional<Value> per_sample_weights;
+  if (operands.size() > 2) {
+    per_sample_weights = operands.at(2);
+  }
+  return MakeNode<EmbeddingBag>(operands.at(0), operands.at(1),
+                                per_sample_weights, mode_);
+}
+
+XlaOpVector EmbeddingBag::Lower(LoweringContext* loctx) const {
+  xla::XlaOp table = loctx->GetOutputOp(operand(0));
+  xla::XlaOp indices = loctx->GetOutputOp(operand(1));
+  absl::optional<xla::XlaOp> per_sample_weights;
+  if (operands().size() > 2) {
+    per_sample_weights = loctx->GetOutputOp(operand(2));
+  }
+  return ReturnOp(BuildEmbeddingBag(table, indices, per_sample_weights, mode_),
+                  loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,78 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/embedding_bag_backward.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+std::vector<Value> GetOperandList(
+    std::vector<Value> operands,
+    const absl::optional<Value>& per_sample_weights) {
+  if (per_sample_weights) {
+    operands.push_back(*per_sample_weights);
+  }
+  return operands;
+}
+
+}  // namespace
+
+EmbeddingBagBackward::EmbeddingBagBackward(
+    const Value& grad_output, const Value& table, const Value& indices,
+    const Value& output, const absl::optional<Value>& per_sample_weights,
+    EmbeddingBagMode mode)
+    : Node(xla_embedding_bag_backward,
+           GetOperandList({grad_output, table, indices, output},
+                          per_sample_weights),
+           table.shape(), /*num_outputs=*/1,
+           xla::util::MHash(xla::util::GetEnumValue(mode))),
+      mode_(mode) {}
+
+std::string EmbeddingBagBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", mode=" << xla::util::GetEnumValue(mode_);
+  return ss.str();
+}
+
+NodePtr EmbeddingBagBackward::Clone(OpList operands) const {
+  absl::optional<Value> per_sample_weights;
+  if (operands.size() > 4) {
+    per_sample_weights = operands.at(4);
+  }
+  return MakeNode<EmbeddingBagBackward>(operands.at(0), operands.at(1),
+                                        operands.at(2), operands.at(3),
+                                        per_sample_weights, mode_);
+}
+
+XlaOpVector EmbeddingBagBackward::Lower(LoweringContext* loctx) const {
+  absl::optional<xla::XlaOp> per_sample_weights;
+  if (operands().size() > 4) {
+    per_sample_weights = loctx->GetOutputOp(operand(4));
+  }
+  xla::XlaOp grad_table = BuildEmbeddingBagBackward(
+      loctx->GetOutputOp(operand(0)), loctx->GetOutputOp(operand(1)),
+      loctx->GetOutputOp(operand(2)), loctx->GetOutputOp(operand(3)),
+      per_sample_weights, mode_);
+  return ReturnOp(grad_table, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
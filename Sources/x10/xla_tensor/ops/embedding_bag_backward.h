@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/embedding_bag.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// The table gradient of EmbeddingBag.
+class EmbeddingBagBackward : public Node {
+ public:
+  EmbeddingBagBackward(const Value& grad_output, const Value& table,
+                       const Value& indices, const Value& output,
+                       const absl::optional<Value>& per_sample_weights,
+                       EmbeddingBagMode mode);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  EmbeddingBagMode mode() const { return mode_; }
+
+ private:
+  EmbeddingBagMode mode_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
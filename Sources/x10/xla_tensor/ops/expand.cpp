@@ -15,6 +15,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
 
 #include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
@@ -31,7 +32,12 @@ xla::Shape NodeOutputShape(const Value& input,
       [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
     return BuildExpand(operands[0], size);
   };
-  return InferOutputShape({input.shape()}, lower_for_shape_fn);
+  auto static_shape_fn = [&]() -> xla::Shape {
+    XLA_CHECK_LE(input.shape().rank(), size.size()) << input.shape();
+    return xla::ShapeUtil::MakeShape(input.shape().element_type(), size);
+  };
+  return InferOutputShape({input.shape()}, static_shape_fn,
+                          lower_for_shape_fn);
 }
 
 }  // namespace
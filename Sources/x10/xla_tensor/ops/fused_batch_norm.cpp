@@ -0,0 +1,103 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/fused_batch_norm.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, xla::int64 feature_index) {
+  const xla::Shape& input_shape = input.shape();
+  xla::Shape stats_shape = xla::ShapeUtil::MakeShape(
+      BatchNormComputeType(input_shape.element_type()),
+      {input_shape.dimensions(feature_index)});
+  return xla::ShapeUtil::MakeTupleShape(
+      {input_shape, stats_shape, stats_shape});
+}
+
+std::vector<Value> GetOperandList(const Value& input, const Value& weight,
+                                  const Value& bias,
+                                  const absl::optional<Value>& residual) {
+  std::vector<Value> operand_list = {input, weight, bias};
+  if (residual) {
+    operand_list.push_back(*residual);
+  }
+  return operand_list;
+}
+
+}  // namespace
+
+FusedBatchNorm::FusedBatchNorm(const Value& input, const Value& weight,
+                               const Value& bias,
+                               const absl::optional<Value>& residual,
+                               FusedBatchNormOptions options)
+    : Node(xla_fused_batch_norm, GetOperandList(input, weight, bias, residual),
+           [&]() { return NodeOutputShape(input, options.feature_index); },
+           /*num_outputs=*/3,
+           xla::util::MHash(options.eps_value, options.feature_index,
+                            options.relu, options.cross_replica,
+                            options.replica_groups)),
+      options_(std::move(options)) {}
+
+std::string FusedBatchNorm::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", eps=" << options_.eps_value
+     << ", feature_index=" << options_.feature_index
+     << ", relu=" << options_.relu
+     << ", cross_replica=" << options_.cross_replica;
+  if (!options_.replica_groups.empty()) {
+    ss << ", groups=(";
+    for (size_t i = 0; i < options_.replica_groups.size(); ++i) {
+      ss << (i == 0 ? "(" : ",(");
+      ss << absl::StrJoin(options_.replica_groups[i], ", ") << ")";
+    }
+    ss << ")";
+  }
+  return ss.str();
+}
+
+NodePtr FusedBatchNorm::Clone(OpList operands) const {
+  absl::optional<Value> residual;
+  if (operands.size() > 3) {
+    residual = operands.at(3);
+  }
+  return MakeNode<FusedBatchNorm>(operands.at(0), operands.at(1),
+                                  operands.at(2), residual, options_);
+}
+
+XlaOpVector FusedBatchNorm::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp weight = loctx->GetOutputOp(operand(1));
+  xla::XlaOp bias = loctx->GetOutputOp(operand(2));
+  absl::optional<xla::XlaOp> residual;
+  if (operands().size() > 3) {
+    residual = loctx->GetOutputOp(operand(3));
+  }
+  BatchNormOutput result =
+      BuildFusedBatchNormTraining(input, weight, bias, residual, options_);
+  return ReturnOps({result.output, result.batch_mean, result.batch_variance},
+                   loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
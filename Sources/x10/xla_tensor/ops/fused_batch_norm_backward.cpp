@@ -0,0 +1,85 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/fused_batch_norm_backward.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& grad_output, const Value& input,
+                           const Value& weight) {
+  return xla::ShapeUtil::MakeTupleShape(
+      {input.shape(), weight.shape(), weight.shape(), grad_output.shape()});
+}
+
+}  // namespace
+
+FusedBatchNormBackward::FusedBatchNormBackward(
+    const Value& grad_output, const Value& input, const Value& weight,
+    const Value& mean, const Value& variance, const Value& output,
+    FusedBatchNormOptions options)
+    : Node(xla_fused_batch_norm_backward,
+           {grad_output, input, weight, mean, variance, output},
+           [&]() { return NodeOutputShape(grad_output, input, weight); },
+           /*num_outputs=*/4,
+           xla::util::MHash(options.eps_value, options.feature_index,
+                            options.relu, options.cross_replica,
+                            options.replica_groups)),
+      options_(std::move(options)) {}
+
+std::string FusedBatchNormBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", eps=" << options_.eps_value
+     << ", feature_index=" << options_.feature_index
+     << ", relu=" << options_.relu
+     << ", cross_replica=" << options_.cross_replica;
+  if (!options_.replica_groups.empty()) {
+    ss << ", groups=(";
+    for (size_t i = 0; i < options_.replica_groups.size(); ++i) {
+      ss << (i == 0 ? "(" : ",(");
+      ss << absl::StrJoin(options_.replica_groups[i], ", ") << ")";
+    }
+    ss << ")";
+  }
+  return ss.str();
+}
+
+NodePtr FusedBatchNormBackward::Clone(OpList operands) const {
+  return MakeNode<FusedBatchNormBackward>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3),
+      operands.at(4), operands.at(5), options_);
+}
+
+XlaOpVector FusedBatchNormBackward::Lower(LoweringContext* loctx) const {
+  FusedBatchNormGrads grads = BuildFusedBatchNormBackward(
+      loctx->GetOutputOp(operand(0)), loctx->GetOutputOp(operand(1)),
+      loctx->GetOutputOp(operand(2)), loctx->GetOutputOp(operand(3)),
+      loctx->GetOutputOp(operand(4)), loctx->GetOutputOp(operand(5)),
+      options_);
+  return ReturnOps({grads.grad_input, grads.grad_weight, grads.grad_bias,
+                    grads.grad_activation},
+                   loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
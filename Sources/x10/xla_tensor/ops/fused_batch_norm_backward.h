@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// The gradients of FusedBatchNorm with respect to the input, weight, bias and
+// residual, in this order.
+class FusedBatchNormBackward : public Node {
+ public:
+  FusedBatchNormBackward(const Value& grad_output, const Value& input,
+                         const Value& weight, const Value& mean,
+                         const Value& variance, const Value& output,
+                         FusedBatchNormOptions options);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const FusedBatchNormOptions& options() const { return options_; }
+
+ private:
+  FusedBatchNormOptions options_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
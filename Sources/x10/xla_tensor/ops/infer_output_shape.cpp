@@ -34,6 +34,17 @@ xla::Shape InferOutputShape(absl::Span<const xla::Shape> input_shapes,
   return XlaHelpers::ShapeOfXlaOp(result);
 }
 
+xla::Shape InferOutputShape(absl::Span<const xla::Shape> input_shapes,
+                            const std::function<xla::Shape()>& static_shape_fn,
+                            const LowerForShapeFn& core_lowering_fn) {
+  for (const xla::Shape& shape : input_shapes) {
+    if (!shape.is_static()) {
+      return InferOutputShape(input_shapes, core_lowering_fn);
+    }
+  }
+  return static_shape_fn();
+}
+
 }  // namespace ops
 }  // namespace ir
 }  // namespace swift_xla
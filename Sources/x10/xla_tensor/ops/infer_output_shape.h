@@ -30,6 +30,13 @@ using LowerForShapeFn =
 xla::Shape InferOutputShape(absl::Span<const xla::Shape> input_shapes,
                             const LowerForShapeFn& core_lowering_fn);
 
+// Compute the output shape using the closed-form static_shape_fn when all the
+// input shapes are static, which avoids building a throwaway computation. The
+// lowering is still used to propagate dynamic dimensions.
+xla::Shape InferOutputShape(absl::Span<const xla::Shape> input_shapes,
+                            const std::function<xla::Shape()>& static_shape_fn,
+                            const LowerForShapeFn& core_lowering_fn);
+
 }  // namespace ops
 }  // namespace ir
 }  // namespace swift_xla
@@ -0,0 +1,67 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/layer_norm.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, xla::int64 axis) {
+  const xla::Shape& input_shape = input.shape();
+  xla::Shape stats_shape = xla::ShapeUtil::DeleteDimension(
+      axis, xla::ShapeUtil::ChangeElementType(
+                input_shape, BatchNormComputeType(input_shape.element_type())));
+  return xla::ShapeUtil::MakeTupleShape(
+      {input_shape, stats_shape, stats_shape});
+}
+
+}  // namespace
+
+LayerNorm::LayerNorm(const Value& input, const Value& weight, const Value& bias,
+                     xla::int64 axis, float eps_value)
+    : Node(xla_layer_norm, {input, weight, bias},
+           [&]() { return NodeOutputShape(input, axis); },
+           /*num_outputs=*/3, xla::util::MHash(axis, eps_value)),
+      axis_(axis),
+      eps_value_(eps_value) {}
+
+std::string LayerNorm::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", axis=" << axis_ << ", eps=" << eps_value_;
+  return ss.str();
+}
+
+NodePtr LayerNorm::Clone(OpList operands) const {
+  return MakeNode<LayerNorm>(operands.at(0), operands.at(1), operands.at(2),
+                             axis_, eps_value_);
+}
+
+XlaOpVector LayerNorm::Lower(LoweringContext* loctx) const {
+  LayerNormOutput result = BuildLayerNorm(
+      loctx->GetOutputOp(operand(0)), loctx->GetOutputOp(operand(1)),
+      loctx->GetOutputOp(operand(2)), axis_, eps_value_);
+  return ReturnOps({result.output, result.mean, result.variance}, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Layer normalization along axis, with single pass statistics. The outputs are
+// the normalized input, and the mean and variance in the accumulation type.
+class LayerNorm : public Node {
+ public:
+  LayerNorm(const Value& input, const Value& weight, const Value& bias,
+            xla::int64 axis, float eps_value);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  xla::int64 axis() const { return axis_; }
+
+  float eps_value() const { return eps_value_; }
+
+ private:
+  xla::int64 axis_;
+  float eps_value_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
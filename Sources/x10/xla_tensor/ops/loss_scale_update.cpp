@@ -0,0 +1,99 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/loss_scale_update.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_updates.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+std::vector<Value> GetOperandList(absl::Span<const Value> grads,
+                                  const Value& loss_scale,
+                                  const Value& good_steps) {
+  std::vector<Value> operand_list(grads.begin(), grads.end());
+  operand_list.push_back(loss_scale);
+  operand_list.push_back(good_steps);
+  return operand_list;
+}
+
+xla::Shape NodeOutputShape(absl::Span<const Value> grads,
+                           const Value& loss_scale, const Value& good_steps) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(grads.size() + 3);
+  for (const Value& grad : grads) {
+    tuple_shapes.push_back(grad.shape());
+  }
+  tuple_shapes.push_back(
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::PRED, {}));
+  tuple_shapes.push_back(loss_scale.shape());
+  tuple_shapes.push_back(good_steps.shape());
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+}  // namespace
+
+LossScaleUpdate::LossScaleUpdate(absl::Span<const Value> grads,
+                                 const Value& loss_scale,
+                                 const Value& good_steps,
+                                 xla::int64 growth_interval,
+                                 double growth_factor, double backoff_factor)
+    : Node(xla_loss_scale_update,
+           GetOperandList(grads, loss_scale, good_steps),
+           [&]() { return NodeOutputShape(grads, loss_scale, good_steps); },
+           /*num_outputs=*/grads.size() + 3,
+           xla::util::MHash(growth_interval, growth_factor, backoff_factor)),
+      num_grads_(grads.size()),
+      growth_interval_(growth_interval),
+      growth_factor_(growth_factor),
+      backoff_factor_(backoff_factor) {}
+
+std::string LossScaleUpdate::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", growth_interval=" << growth_interval_
+     << ", growth_factor=" << growth_factor_
+     << ", backoff_factor=" << backoff_factor_;
+  return ss.str();
+}
+
+NodePtr LossScaleUpdate::Clone(OpList operands) const {
+  size_t n = num_grads_;
+  return MakeNode<LossScaleUpdate>(operands.subspan(0, n), operands.at(n),
+                                   operands.at(n + 1), growth_interval_,
+                                   growth_factor_, backoff_factor_);
+}
+
+XlaOpVector LossScaleUpdate::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  size_t n = num_grads_;
+  return ReturnOps(
+      BuildLossScaleUpdate(absl::Span<const xla::XlaOp>(inputs).subspan(0, n),
+                           inputs[n], inputs[n + 1], growth_interval_,
+                           growth_factor_, backoff_factor_),
+      loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
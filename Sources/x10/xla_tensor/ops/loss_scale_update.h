@@ -0,0 +1,59 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// The dynamic loss scaling of a list of gradients, see BuildLossScaleUpdate().
+// The operands are the gradients, followed by the loss scale and the count of
+// the finite steps since its last change. The outputs are the unscaled
+// gradients, the predicate telling whether they are all finite, the new scale
+// and the new count.
+class LossScaleUpdate : public Node {
+ public:
+  LossScaleUpdate(absl::Span<const Value> grads, const Value& loss_scale,
+                  const Value& good_steps, xla::int64 growth_interval,
+                  double growth_factor, double backoff_factor);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  size_t num_grads() const { return num_grads_; }
+
+  xla::int64 growth_interval() const { return growth_interval_; }
+
+  double growth_factor() const { return growth_factor_; }
+
+  double backoff_factor() const { return backoff_factor_; }
+
+ private:
+  size_t num_grads_;
+  xla::int64 growth_interval_;
+  double growth_factor_;
+  double backoff_factor_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
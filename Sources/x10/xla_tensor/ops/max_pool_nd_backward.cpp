@@ -38,8 +38,10 @@ xla::Shape NodeOutputShape(const Value& grad_output, const Value& input,
                                   /*input=*/operands[1], spatial_dim_count,
                                   kernel_size, stride, padding, ceil_mode);
   };
+  // The gradient is scattered over the pooling input.
+  auto static_shape_fn = [&]() -> xla::Shape { return input.shape(); };
   return InferOutputShape({grad_output.shape(), input.shape()},
-                          lower_for_shape_fn);
+                          static_shape_fn, lower_for_shape_fn);
 }
 
 c10::Symbol MaxPoolNdBackwardSymbol(xla::int64 spatial_dim_count) {
@@ -0,0 +1,83 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/nms.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/nms_op.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& boxes, xla::int64 output_size) {
+  // The leading batch dimension, if any.
+  std::vector<xla::int64> batch_sizes(
+      boxes.shape().dimensions().begin(),
+      boxes.shape().dimensions().end() - 2);
+  std::vector<xla::int64> indices_sizes = batch_sizes;
+  indices_sizes.push_back(output_size);
+  return xla::ShapeUtil::MakeTupleShape(
+      {xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, indices_sizes),
+       xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, batch_sizes)});
+}
+
+}  // namespace
+
+Nms::Nms(const Value& boxes, const Value& scores, double score_threshold,
+         double iou_threshold, xla::int64 output_size, xla::int64 tile_size)
+    : Node(xla_nms, {boxes, scores},
+           [&]() { return NodeOutputShape(boxes, output_size); },
+           /*num_outputs=*/2,
+           xla::util::MHash(score_threshold, iou_threshold, output_size,
+                            tile_size)),
+      score_threshold_(score_threshold),
+      iou_threshold_(iou_threshold),
+      output_size_(output_size),
+      tile_size_(tile_size) {}
+
+std::string Nms::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", score_threshold=" << score_threshold_
+     << ", iou_threshold=" << iou_threshold_
+     << ", output_size=" << output_size_ << ", tile_size=" << tile_size_;
+  return ss.str();
+}
+
+NodePtr Nms::Clone(OpList operands) const {
+  return MakeNode<Nms>(operands.at(0), operands.at(1), score_threshold_,
+                       iou_threshold_, output_size_, tile_size_);
+}
+
+XlaOpVector Nms::Lower(LoweringContext* loctx) const {
+  xla::XlaOp boxes = loctx->GetOutputOp(operand(0));
+  xla::XlaOp scores = loctx->GetOutputOp(operand(1));
+  xla::XlaBuilder* builder = boxes.builder();
+  xla::XlaOp score_threshold = XlaHelpers::ScalarValue(
+      score_threshold_, operand(1).shape().element_type(), builder);
+  xla::XlaOp iou_threshold = XlaHelpers::ScalarValue(
+      iou_threshold_, operand(0).shape().element_type(), builder);
+  NmsResult result = BuildTiledNms(boxes, scores, score_threshold,
+                                   iou_threshold, output_size_, tile_size_);
+  return ReturnOps({result.selected_indices, result.num_valid}, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
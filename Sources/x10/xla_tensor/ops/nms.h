@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Tiled non-maximum suppression, see BuildTiledNms(). The outputs are the
+// selected box indices and their number.
+class Nms : public Node {
+ public:
+  Nms(const Value& boxes, const Value& scores, double score_threshold,
+      double iou_threshold, xla::int64 output_size, xla::int64 tile_size);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  double score_threshold() const { return score_threshold_; }
+
+  double iou_threshold() const { return iou_threshold_; }
+
+  xla::int64 output_size() const { return output_size_; }
+
+  xla::int64 tile_size() const { return tile_size_; }
+
+ private:
+  double score_threshold_;
+  double iou_threshold_;
+  xla::int64 output_size_;
+  xla::int64 tile_size_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -28,6 +28,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/xla_lower_util.h"
 #include "tensorflow/compiler/tf2xla/lib/random.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/client/lib/logdet.h"
 #include "tensorflow/compiler/xla/client/lib/math.h"
 #include "tensorflow/compiler/xla/client/lib/matrix.h"
@@ -176,6 +177,103 @@ NodePtr BroadcastTensors(absl::Span<const Value> tensors) {
       std::move(lower_fn), /*num_outputs=*/tensors.size());
 }
 
+NodePtr KvCacheUpdate(const Value& cache, const Value& update,
+                      const Value& position, xla::int64 dim) {
+  auto lower_fn = [dim](const Node& node,
+                        LoweringContext* loctx) -> XlaOpVector {
+    xla::XlaOp xla_cache = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp xla_update = loctx->GetOutputOp(node.operand(1));
+    xla::XlaOp xla_position = loctx->GetOutputOp(node.operand(2));
+    const xla::Shape& position_shape = XlaHelpers::ShapeOfXlaOp(xla_position);
+    std::vector<xla::XlaOp> start_indices(
+        XlaHelpers::ShapeOfXlaOp(xla_cache).rank(),
+        xla::Zero(xla_cache.builder(), position_shape.element_type()));
+    start_indices[dim] = xla_position;
+    return node.ReturnOp(
+        xla::DynamicUpdateSlice(xla_cache, xla_update, start_indices), loctx);
+  };
+  return GenericOp(OpKind(at::aten::xla_dynamic_update_slice),
+                   {cache, update, position}, cache.shape(),
+                   std::move(lower_fn), /*num_outputs=*/1,
+                   xla::util::MHash(dim));
+}
+
+NodePtr Accumulate(const Value& accumulator, const Value& value) {
+  auto lower_fn = [](const Node& node, LoweringContext* loctx) -> XlaOpVector {
+    xla::XlaOp xla_accumulator = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp xla_value = loctx->GetOutputOp(node.operand(1));
+    return node.ReturnOp(xla_accumulator + xla_value, loctx);
+  };
+  return GenericOp(OpKind(at::aten::add), {accumulator, value},
+                   accumulator.shape(), std::move(lower_fn));
+}
+
+NodePtr SetDimensionBound(const Value& input, const Value& size,
+                          xla::int64 dim) {
+  auto lower_fn = [dim](const Node& node,
+                        LoweringContext* loctx) -> XlaOpVector {
+    xla::XlaOp xla_input = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp xla_size = loctx->GetOutputOp(node.operand(1));
+    return node.ReturnOp(
+        xla::SetDimensionSize(
+            xla_input, MaybeConvertTo(xla_size, xla::PrimitiveType::S32), dim),
+        loctx);
+  };
+  xla::Shape shape = input.shape();
+  shape.set_dynamic_dimension(dim, true);
+  return GenericOp(OpKind(at::aten::xla_set_dimension_bound), {input, size},
+                   std::move(shape), std::move(lower_fn), /*num_outputs=*/1,
+                   xla::util::MHash(dim));
+}
+
+NodePtr RemoveDynamicDimension(const Value& input, xla::int64 dim) {
+  auto lower_fn = [dim](const Node& node,
+                        LoweringContext* loctx) -> XlaOpVector {
+    xla::XlaOp xla_input = loctx->GetOutputOp(node.operand(0));
+    const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(xla_input);
+    xla::XlaBuilder* builder = xla_input.builder();
+    xla::XlaOp size = xla::GetDimensionSize(xla_input, dim);
+    // Setting the size of a dimension to its bound, as a constant, makes it
+    // static again.
+    xla::XlaOp padded = xla::SetDimensionSize(
+        xla_input,
+        xla::ConstantR0<xla::int32>(builder, input_shape.dimensions(dim)),
+        dim);
+    xla::XlaOp positions = xla::Iota(
+        builder,
+        xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                  input_shape.dimensions()),
+        dim);
+    return node.ReturnOp(
+        xla::Select(xla::Lt(positions, size), padded, xla::ZerosLike(padded)),
+        loctx);
+  };
+  xla::Shape shape = input.shape();
+  shape.set_dynamic_dimension(dim, false);
+  return GenericOp(OpKind(at::aten::xla_remove_dynamic_dimension), {input},
+                   std::move(shape), std::move(lower_fn), /*num_outputs=*/1,
+                   xla::util::MHash(dim));
+}
+
+NodePtr AllFinite(absl::Span<const Value> inputs) {
+  auto lower_fn = [](const Node& node, LoweringContext* loctx) -> XlaOpVector {
+    xla::XlaBuilder* builder = loctx->builder();
+    xla::XlaComputation and_computation =
+        XlaHelpers::CreateAndComputation(xla::PrimitiveType::PRED);
+    xla::XlaOp finite = xla::ConstantR0<bool>(builder, true);
+    for (const Output& operand : node.operands()) {
+      finite = xla::And(
+          finite, xla::ReduceAll(xla::IsFinite(loctx->GetOutputOp(operand)),
+                                 xla::ConstantR0<bool>(builder, true),
+                                 and_computation));
+    }
+    return node.ReturnOp(finite, loctx);
+  };
+  return GenericOp(OpKind(at::aten::xla_all_finite), inputs,
+                   xla::ShapeUtil::MakeShape(xla::PrimitiveType::PRED, {}),
+                   std::move(lower_fn));
+}
+
 }  // namespace ops
 }  // namespace ir
 }  // namespace swift_xla
@@ -73,6 +73,27 @@ NodePtr LinSpace(at::Scalar start, at::Scalar stop, xla::int64 num,
 
 NodePtr BroadcastTensors(absl::Span<const Value> tensors);
 
+// Writes update into cache, at the scalar position along dim, and at zero
+// along the other dimensions.
+NodePtr KvCacheUpdate(const Value& cache, const Value& update,
+                      const Value& position, xla::int64 dim);
+
+// Adds value, of the same shape, to the accumulator.
+NodePtr Accumulate(const Value& accumulator, const Value& value);
+
+// Marks dim of the input as dynamic, bounded by its static size, with the
+// scalar size as its actual size.
+NodePtr SetDimensionBound(const Value& input, const Value& size,
+                          xla::int64 dim);
+
+// Makes the dynamic dim of the input static at its bound, zeroing the elements
+// past its actual size.
+NodePtr RemoveDynamicDimension(const Value& input, xla::int64 dim);
+
+// Returns a boolean scalar telling whether all the elements of the floating
+// point inputs are finite.
+NodePtr AllFinite(absl::Span<const Value> inputs);
+
 }  // namespace ops
 }  // namespace ir
 }  // namespace swift_xla
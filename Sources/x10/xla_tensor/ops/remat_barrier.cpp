@@ -0,0 +1,85 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/remat_barrier.h"
+
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+// Returns a zero of the given type, computed from the first element of
+// dependency so that it cannot be constant folded.
+xla::XlaOp DependentZero(xla::XlaOp dependency, xla::PrimitiveType type) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(dependency);
+  xla::XlaOp element = dependency;
+  if (shape.rank() > 0) {
+    std::vector<xla::int64> zeros(shape.rank(), 0);
+    std::vector<xla::int64> ones(shape.rank(), 1);
+    element = xla::Reshape(xla::Slice(dependency, zeros, ones, ones), {});
+  }
+  // The flag is 0 or 1, so subtracting it from itself yields an exact zero,
+  // but the algebraic simplifier does not know.
+  xla::XlaOp flag =
+      xla::primitive_util::IsFloatingPointType(shape.element_type())
+          ? xla::ConvertElementType(xla::Eq(element, element), type)
+          : xla::ConvertElementType(
+                xla::Ne(element, xla::Zero(dependency.builder(),
+                                           shape.element_type())),
+                type);
+  return xla::Sub(flag, flag);
+}
+
+xla::XlaOp BuildRematBarrier(xla::XlaOp input, xla::XlaOp dependency) {
+  const xla::Shape& dependency_shape = XlaHelpers::ShapeOfXlaOp(dependency);
+  if (xla::ShapeUtil::IsZeroElementArray(dependency_shape)) {
+    return input;
+  }
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  if (input_shape.element_type() == xla::PrimitiveType::PRED) {
+    xla::XlaOp zero = DependentZero(dependency, xla::PrimitiveType::F32);
+    return xla::Or(input, xla::Ne(zero, xla::Zero(input.builder(),
+                                                  xla::PrimitiveType::F32)));
+  }
+  return xla::Add(input, DependentZero(dependency, input_shape.element_type()));
+}
+
+}  // namespace
+
+RematBarrier::RematBarrier(const Value& input, const Value& dependency)
+    : Node(xla_remat_barrier, {input, dependency}, input.shape(),
+           /*num_outputs=*/1, /*hash_seed=*/0x3c9a41f6e2d5b807) {}
+
+NodePtr RematBarrier::Clone(OpList operands) const {
+  return MakeNode<RematBarrier>(operands.at(0), operands.at(1));
+}
+
+XlaOpVector RematBarrier::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp dependency = loctx->GetOutputOp(operand(1));
+  return ReturnOp(BuildRematBarrier(input, dependency), loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,79 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/resize_bilinear.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/resize_ops.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input,
+                           absl::Span<const xla::int64> spatial_size,
+                           bool channels_last) {
+  xla::Shape output_shape = input.shape();
+  xla::int64 h_dim = channels_last ? 1 : 2;
+  output_shape.set_dimensions(h_dim, spatial_size[0]);
+  output_shape.set_dimensions(h_dim + 1, spatial_size[1]);
+  return output_shape;
+}
+
+}  // namespace
+
+ResizeBilinear::ResizeBilinear(const Value& input,
+                               std::vector<xla::int64> output_size,
+                               bool align_corners, bool half_pixel_centers,
+                               bool channels_last)
+    : Node(xla_resize_bilinear, {input},
+           [&]() { return NodeOutputShape(input, output_size, channels_last); },
+           /*num_outputs=*/1,
+           xla::util::MHash(output_size, align_corners, half_pixel_centers,
+                            channels_last)),
+      output_size_(std::move(output_size)),
+      align_corners_(align_corners),
+      half_pixel_centers_(half_pixel_centers),
+      channels_last_(channels_last) {}
+
+std::string ResizeBilinear::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", output_size=("
+     << absl::StrJoin(output_size_, ", ")
+     << "), align_corners=" << align_corners_
+     << ", half_pixel_centers=" << half_pixel_centers_
+     << ", channels_last=" << channels_last_;
+  return ss.str();
+}
+
+NodePtr ResizeBilinear::Clone(OpList operands) const {
+  return MakeNode<ResizeBilinear>(operands.at(0), output_size_, align_corners_,
+                                  half_pixel_centers_, channels_last_);
+}
+
+XlaOpVector ResizeBilinear::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  return ReturnOp(
+      resize::BuildResizeBilinear(input, output_size_, align_corners_,
+                                  half_pixel_centers_, channels_last_),
+      loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
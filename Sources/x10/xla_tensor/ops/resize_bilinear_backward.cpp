@@ -0,0 +1,81 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/resize_bilinear_backward.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/resize_ops.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& grad_output,
+                           absl::Span<const xla::int64> spatial_size,
+                           bool channels_last) {
+  xla::Shape output_shape = grad_output.shape();
+  xla::int64 h_dim = channels_last ? 1 : 2;
+  output_shape.set_dimensions(h_dim, spatial_size[0]);
+  output_shape.set_dimensions(h_dim + 1, spatial_size[1]);
+  return output_shape;
+}
+
+}  // namespace
+
+ResizeBilinearBackward::ResizeBilinearBackward(
+    const Value& grad_output, std::vector<xla::int64> input_size,
+    bool align_corners, bool half_pixel_centers, bool channels_last)
+    : Node(xla_resize_bilinear_backward, {grad_output},
+           [&]() {
+             return NodeOutputShape(grad_output, input_size, channels_last);
+           },
+           /*num_outputs=*/1,
+           xla::util::MHash(input_size, align_corners, half_pixel_centers,
+                            channels_last)),
+      input_size_(std::move(input_size)),
+      align_corners_(align_corners),
+      half_pixel_centers_(half_pixel_centers),
+      channels_last_(channels_last) {}
+
+std::string ResizeBilinearBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", input_size=("
+     << absl::StrJoin(input_size_, ", ")
+     << "), align_corners=" << align_corners_
+     << ", half_pixel_centers=" << half_pixel_centers_
+     << ", channels_last=" << channels_last_;
+  return ss.str();
+}
+
+NodePtr ResizeBilinearBackward::Clone(OpList operands) const {
+  return MakeNode<ResizeBilinearBackward>(operands.at(0), input_size_,
+                                          align_corners_, half_pixel_centers_,
+                                          channels_last_);
+}
+
+XlaOpVector ResizeBilinearBackward::Lower(LoweringContext* loctx) const {
+  xla::XlaOp grad_output = loctx->GetOutputOp(operand(0));
+  return ReturnOp(resize::BuildResizeBilinearBackward(
+                      grad_output, input_size_, align_corners_,
+                      half_pixel_centers_, channels_last_),
+                  loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
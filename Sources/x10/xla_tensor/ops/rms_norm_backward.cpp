@@ -0,0 +1,55 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rms_norm_backward.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+RmsNormBackward::RmsNormBackward(const Value& grad_output, const Value& input,
+                                 const Value& weight, const Value& inv_rms,
+                                 xla::int64 axis)
+    : Node(xla_rms_norm_backward, {grad_output, input, weight, inv_rms},
+           xla::ShapeUtil::MakeTupleShape({input.shape(), weight.shape()}),
+           /*num_outputs=*/2, xla::util::MHash(axis)),
+      axis_(axis) {}
+
+std::string RmsNormBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", axis=" << axis_;
+  return ss.str();
+}
+
+NodePtr RmsNormBackward::Clone(OpList operands) const {
+  return MakeNode<RmsNormBackward>(operands.at(0), operands.at(1),
+                                   operands.at(2), operands.at(3), axis_);
+}
+
+XlaOpVector RmsNormBackward::Lower(LoweringContext* loctx) const {
+  RmsNormGrads grads = BuildRmsNormBackward(
+      loctx->GetOutputOp(operand(0)), loctx->GetOutputOp(operand(1)),
+      loctx->GetOutputOp(operand(2)), loctx->GetOutputOp(operand(3)), axis_);
+  return ReturnOps({grads.grad_input, grads.grad_weight}, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,53 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rng_normal.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/random.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+RngNormal::RngNormal(const Value& seed, const Value& mean,
+                     const Value& stddev, xla::Shape shape,
+                     xla::uint64 stream)
+    : Node(xla_rng_normal, {seed, mean, stddev}, std::move(shape),
+           /*num_outputs=*/1, xla::util::MHash(stream)),
+      stream_(stream) {}
+
+std::string RngNormal::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", stream=" << stream_;
+  return ss.str();
+}
+
+NodePtr RngNormal::Clone(OpList operands) const {
+  return MakeNode<RngNormal>(operands.at(0), operands.at(1), operands.at(2),
+                             shape(), stream_);
+}
+
+XlaOpVector RngNormal::Lower(LoweringContext* loctx) const {
+  xla::XlaOp seed = loctx->GetOutputOp(operand(0));
+  xla::XlaOp mean = loctx->GetOutputOp(operand(1));
+  xla::XlaOp stddev = loctx->GetOutputOp(operand(2));
+  return ReturnOp(swift_xla::RngNormal(seed, shape(), mean, stddev, stream_),
+                  loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Uniform random values in [minval, maxval), drawn from the stream of the step
+// seed selected by the stream attribute.
+class RngUniform : public Node {
+ public:
+  RngUniform(const Value& seed, const Value& minval, const Value& maxval,
+             xla::Shape shape, xla::uint64 stream);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  xla::uint64 stream() const { return stream_; }
+
+ private:
+  xla::uint64 stream_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
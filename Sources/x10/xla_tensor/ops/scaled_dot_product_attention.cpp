@@ -0,0 +1,118 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scaled_dot_product_attention.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/attention.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& query, const Value& key,
+                           const Value& value, double scale, bool causal,
+                           xla::int64 block_size,
+                           const absl::optional<Value>& valid_length) {
+  auto lower_for_shape_fn =
+      [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    AttentionResult result = BuildScaledDotProductAttention(
+        operands[0], operands[1], operands[2], scale, causal, block_size,
+        operands.size() > 3 ? operands[3] : xla::XlaOp());
+    return xla::Tuple(operands[0].builder(),
+                      {result.output, result.logsumexp});
+  };
+  auto static_shape_fn = [&]() -> xla::Shape {
+    const xla::Shape& query_shape = query.shape();
+    const xla::Shape& value_shape = value.shape();
+    xla::int64 rank = query_shape.rank();
+    std::vector<xla::int64> row_sizes(query_shape.dimensions().begin(),
+                                      query_shape.dimensions().end() - 1);
+    std::vector<xla::int64> output_sizes(row_sizes);
+    output_sizes.push_back(value_shape.dimensions(rank - 1));
+    return xla::ShapeUtil::MakeTupleShape(
+        {xla::ShapeUtil::MakeShape(query_shape.element_type(), output_sizes),
+         xla::ShapeUtil::MakeShape(
+             AttentionComputeType(query_shape.element_type()), row_sizes)});
+  };
+  std::vector<xla::Shape> shapes = {query.shape(), key.shape(), value.shape()};
+  if (valid_length) {
+    shapes.push_back(valid_length->shape());
+  }
+  return InferOutputShape(shapes, static_shape_fn, lower_for_shape_fn);
+}
+
+std::vector<Value> GetOperandList(std::vector<Value> operands,
+                                  const absl::optional<Value>& valid_length) {
+  if (valid_length) {
+    operands.push_back(*valid_length);
+  }
+  return operands;
+}
+
+}  // namespace
+
+ScaledDotProductAttention::ScaledDotProductAttention(
+    const Value& query, const Value& key, const Value& value, double scale,
+    bool causal, xla::int64 block_size,
+    const absl::optional<Value>& valid_length)
+    : Node(xla_scaled_dot_product_attention,
+           GetOperandList({query, key, value}, valid_length),
+           [&]() {
+             return NodeOutputShape(query, key, value, scale, causal,
+                                    block_size, valid_length);
+           },
+           /*num_outputs=*/2, xla::util::MHash(scale, causal, block_size)),
+      scale_(scale),
+      causal_(causal),
+      block_size_(block_size) {}
+
+std::string ScaledDotProductAttention::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", scale=" << scale_ << ", causal=" << causal_
+     << ", block_size=" << block_size_;
+  return ss.str();
+}
+
+NodePtr ScaledDotProductAttention::Clone(OpList operands) const {
+  absl::optional<Value> valid_length;
+  if (operands.size() > 3) {
+    valid_length = operands.at(3);
+  }
+  return MakeNode<ScaledDotProductAttention>(operands.at(0), operands.at(1),
+                                             operands.at(2), scale_, causal_,
+                                             block_size_, valid_length);
+}
+
+XlaOpVector ScaledDotProductAttention::Lower(LoweringContext* loctx) const {
+  xla::XlaOp query = loctx->GetOutputOp(operand(0));
+  xla::XlaOp key = loctx->GetOutputOp(operand(1));
+  xla::XlaOp value = loctx->GetOutputOp(operand(2));
+  xla::XlaOp valid_length;
+  if (operands().size() > 3) {
+    valid_length = loctx->GetOutputOp(operand(3));
+  }
+  AttentionResult result = BuildScaledDotProductAttention(
+      query, key, value, scale_, causal_, block_size_, valid_length);
+  return ReturnOps({result.output, result.logsumexp}, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Fused softmax(query * key^T * scale) * value. The first output is the
+// attention result, the second one the logsumexp of the scores rows, which the
+// backward uses to recompute the attention probabilities. The optional
+// valid_length scalar masks out the key positions at or past it.
+class ScaledDotProductAttention : public Node {
+ public:
+  ScaledDotProductAttention(
+      const Value& query, const Value& key, const Value& value, double scale,
+      bool causal, xla::int64 block_size,
+      const absl::optional<Value>& valid_length = absl::nullopt);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  double scale() const { return scale_; }
+
+  bool causal() const { return causal_; }
+
+  xla::int64 block_size() const { return block_size_; }
+
+ private:
+  double scale_;
+  bool causal_;
+  xla::int64 block_size_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,65 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scaled_dot_product_attention_backward.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/attention.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+ScaledDotProductAttentionBackward::ScaledDotProductAttentionBackward(
+    const Value& grad_output, const Value& query, const Value& key,
+    const Value& value, const Value& output, const Value& logsumexp,
+    double scale, bool causal, xla::int64 block_size)
+    : Node(xla_scaled_dot_product_attention_backward,
+           {grad_output, query, key, value, output, logsumexp},
+           xla::ShapeUtil::MakeTupleShape(
+               {query.shape(), key.shape(), value.shape()}),
+           /*num_outputs=*/3, xla::util::MHash(scale, causal, block_size)),
+      scale_(scale),
+      causal_(causal),
+      block_size_(block_size) {}
+
+std::string ScaledDotProductAttentionBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", scale=" << scale_ << ", causal=" << causal_
+     << ", block_size=" << block_size_;
+  return ss.str();
+}
+
+NodePtr ScaledDotProductAttentionBackward::Clone(OpList operands) const {
+  return MakeNode<ScaledDotProductAttentionBackward>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3),
+      operands.at(4), operands.at(5), scale_, causal_, block_size_);
+}
+
+XlaOpVector ScaledDotProductAttentionBackward::Lower(
+    LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> grads = BuildScaledDotProductAttentionBackward(
+      loctx->GetOutputOp(operand(0)), loctx->GetOutputOp(operand(1)),
+      loctx->GetOutputOp(operand(2)), loctx->GetOutputOp(operand(3)),
+      loctx->GetOutputOp(operand(4)), loctx->GetOutputOp(operand(5)), scale_,
+      causal_, block_size_);
+  return ReturnOps(grads, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
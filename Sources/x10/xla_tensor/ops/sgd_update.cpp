@@ -0,0 +1,115 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sgd_update.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_updates.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+std::vector<Value> GetOperandList(
+    absl::Span<const Value> weights, absl::Span<const Value> grads,
+    absl::Span<const Value> velocities,
+    std::initializer_list<Value> hyperparameters,
+    const absl::optional<Value>& grads_finite) {
+  XLA_CHECK_EQ(weights.size(), grads.size());
+  XLA_CHECK_EQ(weights.size(), velocities.size());
+  std::vector<Value> operand_list;
+  operand_list.reserve(3 * weights.size() + hyperparameters.size());
+  for (absl::Span<const Value> values : {weights, grads, velocities}) {
+    operand_list.insert(operand_list.end(), values.begin(), values.end());
+  }
+  operand_list.insert(operand_list.end(), hyperparameters.begin(),
+                      hyperparameters.end());
+  if (grads_finite) {
+    operand_list.push_back(*grads_finite);
+  }
+  return operand_list;
+}
+
+xla::Shape NodeOutputShape(absl::Span<const Value> weights,
+                           absl::Span<const Value> velocities) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(2 * weights.size());
+  for (absl::Span<const Value> values : {weights, velocities}) {
+    for (const Value& value : values) {
+      tuple_shapes.push_back(value.shape());
+    }
+  }
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+}  // namespace
+
+SgdUpdate::SgdUpdate(absl::Span<const Value> weights,
+                     absl::Span<const Value> grads,
+                     absl::Span<const Value> velocities,
+                     const Value& learning_rate, const Value& momentum,
+                     const Value& weight_decay, bool nesterov,
+                     const absl::optional<Value>& grads_finite)
+    : Node(xla_sgd_update,
+           GetOperandList(weights, grads, velocities,
+                          {learning_rate, momentum, weight_decay},
+                          grads_finite),
+           [&]() { return NodeOutputShape(weights, velocities); },
+           /*num_outputs=*/2 * weights.size(), xla::util::MHash(nesterov)),
+      num_weights_(weights.size()),
+      nesterov_(nesterov) {}
+
+std::string SgdUpdate::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", nesterov=" << nesterov_;
+  return ss.str();
+}
+
+NodePtr SgdUpdate::Clone(OpList operands) const {
+  size_t n = num_weights_;
+  return MakeNode<SgdUpdate>(operands.subspan(0, n), operands.subspan(n, n),
+                             operands.subspan(2 * n, n), operands.at(3 * n),
+                             operands.at(3 * n + 1), operands.at(3 * n + 2),
+                             nesterov_,
+                             operands.size() > 3 * n + 3
+                                 ? absl::optional<Value>(operands.at(3 * n + 3))
+                                 : absl::nullopt);
+}
+
+XlaOpVector SgdUpdate::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  absl::Span<const xla::XlaOp> input_span(inputs);
+  size_t n = num_weights_;
+  return ReturnOps(
+      BuildSgdUpdate(input_span.subspan(0, n), input_span.subspan(n, n),
+                     input_span.subspan(2 * n, n), inputs[3 * n],
+                     inputs[3 * n + 1], inputs[3 * n + 2], nesterov_,
+                     inputs.size() > 3 * n + 3
+                         ? absl::optional<xla::XlaOp>(inputs[3 * n + 3])
+                         : absl::nullopt),
+      loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// The SGD with momentum update of a group of weights, see BuildSgdUpdate().
+// The operands are the weights, gradients and velocities, followed by the
+// scalar hyperparameters and the optional grads_finite predicate. The outputs
+// are the new weights and velocities.
+class SgdUpdate : public Node {
+ public:
+  SgdUpdate(absl::Span<const Value> weights, absl::Span<const Value> grads,
+            absl::Span<const Value> velocities, const Value& learning_rate,
+            const Value& momentum, const Value& weight_decay, bool nesterov,
+            const absl::optional<Value>& grads_finite = absl::nullopt);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  size_t num_weights() const { return num_weights_; }
+
+  bool nesterov() const { return nesterov_; }
+
+ private:
+  size_t num_weights_;
+  bool nesterov_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
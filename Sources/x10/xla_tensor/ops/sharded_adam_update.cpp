@@ -0,0 +1,119 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sharded_adam_update.h"
+
+#include <sstream>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_updates.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+std::vector<Value> GetOperandList(
+    absl::Span<const Value> weights, absl::Span<const Value> grads,
+    std::initializer_list<Value> shards_and_hyperparameters,
+    const absl::optional<Value>& grads_finite) {
+  XLA_CHECK_EQ(weights.size(), grads.size());
+  std::vector<Value> operand_list(weights.begin(), weights.end());
+  operand_list.insert(operand_list.end(), grads.begin(), grads.end());
+  operand_list.insert(operand_list.end(), shards_and_hyperparameters.begin(),
+                      shards_and_hyperparameters.end());
+  if (grads_finite) {
+    operand_list.push_back(*grads_finite);
+  }
+  return operand_list;
+}
+
+xla::Shape NodeOutputShape(absl::Span<const Value> weights,
+                           const Value& m_shard, const Value& v_shard) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(weights.size() + 2);
+  for (const Value& weight : weights) {
+    tuple_shapes.push_back(weight.shape());
+  }
+  tuple_shapes.push_back(m_shard.shape());
+  tuple_shapes.push_back(v_shard.shape());
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+}  // namespace
+
+ShardedAdamUpdate::ShardedAdamUpdate(
+    absl::Span<const Value> weights, absl::Span<const Value> grads,
+    const Value& m_shard, const Value& v_shard, const Value& learning_rate,
+    const Value& beta1, const Value& beta2, const Value& epsilon,
+    const Value& weight_decay, xla::int64 num_shards, double grad_scale,
+    const absl::optional<Value>& grads_finite)
+    : Node(xla_sharded_adam_update,
+           GetOperandList(weights, grads,
+                          {m_shard, v_shard, learning_rate, beta1, beta2,
+                           epsilon, weight_decay},
+                          grads_finite),
+           [&]() { return NodeOutputShape(weights, m_shard, v_shard); },
+           /*num_outputs=*/weights.size() + 2,
+           xla::util::MHash(num_shards, grad_scale)),
+      num_weights_(weights.size()),
+      num_shards_(num_shards),
+      grad_scale_(grad_scale) {}
+
+std::string ShardedAdamUpdate::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", num_shards=" << num_shards_
+     << ", grad_scale=" << grad_scale_;
+  return ss.str();
+}
+
+NodePtr ShardedAdamUpdate::Clone(OpList operands) const {
+  size_t n = num_weights_;
+  return MakeNode<ShardedAdamUpdate>(
+      operands.subspan(0, n), operands.subspan(n, n), operands.at(2 * n),
+      operands.at(2 * n + 1), operands.at(2 * n + 2), operands.at(2 * n + 3),
+      operands.at(2 * n + 4), operands.at(2 * n + 5), operands.at(2 * n + 6),
+      num_shards_, grad_scale_,
+      operands.size() > 2 * n + 7
+          ? absl::optional<Value>(operands.at(2 * n + 7))
+          : absl::nullopt);
+}
+
+XlaOpVector ShardedAdamUpdate::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  absl::Span<const xla::XlaOp> input_span(inputs);
+  size_t n = num_weights_;
+  return ReturnOps(
+      BuildShardedAdamUpdate(
+          input_span.subspan(0, n), input_span.subspan(n, n), inputs[2 * n],
+          inputs[2 * n + 1], inputs[2 * n + 2], inputs[2 * n + 3],
+          inputs[2 * n + 4], inputs[2 * n + 5], inputs[2 * n + 6], num_shards_,
+          grad_scale_,
+          inputs.size() > 2 * n + 7
+              ? absl::optional<xla::XlaOp>(inputs[2 * n + 7])
+              : absl::nullopt),
+      loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,53 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sharding.h"
+
+#include <sstream>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+Sharding::Sharding(const Value& input, xla::OpSharding sharding)
+    : Node(xla_sharding, {input}, input.shape(),
+           /*num_outputs=*/1, xla::util::Hash(sharding.SerializeAsString())),
+      sharding_(std::move(sharding)) {}
+
+std::string Sharding::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", sharding=" << sharding_.ShortDebugString();
+  return ss.str();
+}
+
+NodePtr Sharding::Clone(OpList operands) const {
+  return MakeNode<Sharding>(operands.at(0), sharding_);
+}
+
+XlaOpVector Sharding::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  return ReturnOp(loctx->ShardOp(input, sharding_), loctx);
+}
+
+Sharding* Sharding::Cast(const Node* node) {
+  return NodeCast<Sharding>(node, xla_sharding);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
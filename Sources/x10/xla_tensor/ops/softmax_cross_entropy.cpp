@@ -0,0 +1,74 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/softmax_cross_entropy.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/nll_loss.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& logits) {
+  const xla::Shape& logits_shape = logits.shape();
+  return xla::ShapeUtil::MakeTupleShape(
+      {xla::ShapeUtil::MakeShape(logits_shape.element_type(),
+                                 {logits_shape.dimensions(0)}),
+       logits_shape});
+}
+
+}  // namespace
+
+SoftmaxCrossEntropy::SoftmaxCrossEntropy(const Value& logits,
+                                         const Value& labels, int ignore_index,
+                                         double label_smoothing,
+                                         xla::int64 chunk_size)
+    : Node(xla_softmax_cross_entropy, {logits, labels},
+           NodeOutputShape(logits),
+           /*num_outputs=*/2,
+           xla::util::MHash(ignore_index, label_smoothing, chunk_size)),
+      ignore_index_(ignore_index),
+      label_smoothing_(label_smoothing),
+      chunk_size_(chunk_size) {}
+
+std::string SoftmaxCrossEntropy::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", ignore_index=" << ignore_index_
+     << ", label_smoothing=" << label_smoothing_
+     << ", chunk_size=" << chunk_size_;
+  return ss.str();
+}
+
+NodePtr SoftmaxCrossEntropy::Clone(OpList operands) const {
+  return MakeNode<SoftmaxCrossEntropy>(operands.at(0), operands.at(1),
+                                       ignore_index_, label_smoothing_,
+                                       chunk_size_);
+}
+
+XlaOpVector SoftmaxCrossEntropy::Lower(LoweringContext* loctx) const {
+  xla::XlaOp logits = loctx->GetOutputOp(operand(0));
+  xla::XlaOp labels = loctx->GetOutputOp(operand(1));
+  SoftmaxCrossEntropyResult result = BuildSoftmaxCrossEntropy(
+      logits, labels, ignore_index_, label_smoothing_, chunk_size_);
+  return ReturnOps({result.loss, result.grad_logits}, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Fused log-softmax and cross-entropy of logits against class indices. The
+// first output holds the per example losses, the second one their gradient
+// with respect to the logits.
+class SoftmaxCrossEntropy : public Node {
+ public:
+  SoftmaxCrossEntropy(const Value& logits, const Value& labels,
+                      int ignore_index, double label_smoothing,
+                      xla::int64 chunk_size);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  int ignore_index() const { return ignore_index_; }
+
+  double label_smoothing() const { return label_smoothing_; }
+
+  xla::int64 chunk_size() const { return chunk_size_; }
+
+ private:
+  int ignore_index_;
+  double label_smoothing_;
+  xla::int64 chunk_size_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
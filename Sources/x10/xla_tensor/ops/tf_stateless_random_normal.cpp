@@ -16,6 +16,7 @@
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/random.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/client/lib/math.h"
 #include "tensorflow/compiler/xla/client/lib/prng.h"
@@ -47,10 +48,9 @@ XlaOpVector TfStatelessRandomNormal::Lower(LoweringContext* loctx) const {
       ConvertElementType(seed0, xla::U64) |
       ShiftLeft(ConvertElementType(seed1, xla::U64),
                 ConstantR0WithType(loctx->builder(), xla::U64, 32));
-  xla::XlaOp normal =
-      xla::NormalFloatingPointDistribution(
-          key, initial_state, GetBitGenerator(generator()), shape())
-          .value;
+  xla::XlaOp normal = NormalDistribution(key, initial_state,
+                                         GetBitGenerator(generator()), shape())
+                          .value;
   return ReturnOp(normal, loctx);
 }
 
@@ -0,0 +1,68 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/user_computation.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+size_t GetNumOutputs(const xla::Shape& shape) {
+  return shape.IsTuple() ? xla::ShapeUtil::TupleElementCount(shape) : 1;
+}
+
+}  // namespace
+
+UserComputation::UserComputation(OpKind op, OpList operands,
+                                 ComputationPtr computation)
+    : Node(std::move(op), operands, computation->program_shape().result(),
+           GetNumOutputs(computation->program_shape().result()),
+           computation->hash()),
+      computation_(std::move(computation)) {}
+
+std::string UserComputation::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", computation=" << computation_->name();
+  return ss.str();
+}
+
+NodePtr UserComputation::Clone(OpList operands) const {
+  return MakeNode<UserComputation>(op(), operands, computation_);
+}
+
+XlaOpVector UserComputation::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (auto& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  xla::XlaOp call = loctx->CallComputation(*computation_, inputs);
+  if (!shape().IsTuple()) {
+    return ReturnOp(call, loctx);
+  }
+  std::vector<xla::XlaOp> results;
+  results.reserve(num_outputs());
+  for (size_t i = 0; i < num_outputs(); ++i) {
+    results.push_back(xla::GetTupleElement(call, i));
+  }
+  return ReturnOps(results, loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/computation.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Calls a prebuilt computation on the operands. The node hash covers the
+// computation fingerprint, so calls of equal computations hash the same even
+// when built separately, and the computation is embedded once per lowered
+// graph, see LoweringContext::CallComputation().
+class UserComputation : public Node {
+ public:
+  UserComputation(OpKind op, OpList operands, ComputationPtr computation);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const ComputationPtr& computation() const { return computation_; }
+
+ private:
+  ComputationPtr computation_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
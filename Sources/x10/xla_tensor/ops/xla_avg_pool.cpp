@@ -36,7 +36,19 @@ xla::Shape NodeOutputShape(
     return xla::AvgPool(operands[0], kernel_size, stride, padding, data_format,
                         counts_include_padding);
   };
-  return InferOutputShape({operand.shape()}, lower_for_shape_fn);
+  auto static_shape_fn = [&]() -> xla::Shape {
+    // The padding only covers the spatial dimensions.
+    const xla::Shape& operand_shape = operand.shape();
+    std::vector<std::pair<xla::int64, xla::int64>> full_padding(
+        operand_shape.rank(), {0, 0});
+    for (xla::int64 i = 0; i < data_format.num_spatial_dims(); ++i) {
+      full_padding[data_format.spatial_dimension(i)] = padding[i];
+    }
+    return GetPoolingOutputShape(operand_shape, kernel_size, stride,
+                                 full_padding);
+  };
+  return InferOutputShape({operand.shape()}, static_shape_fn,
+                          lower_for_shape_fn);
 }
 
 }  // namespace
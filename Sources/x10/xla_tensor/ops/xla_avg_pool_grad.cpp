@@ -38,7 +38,12 @@ xla::Shape NodeOutputShape(
                             spatial_padding, data_format,
                             counts_include_padding);
   };
-  return InferOutputShape({out_backprop.shape()}, lower_for_shape_fn);
+  auto static_shape_fn = [&]() -> xla::Shape {
+    return xla::ShapeUtil::MakeShape(out_backprop.shape().element_type(),
+                                     gradients_size);
+  };
+  return InferOutputShape({out_backprop.shape()}, static_shape_fn,
+                          lower_for_shape_fn);
 }
 
 }  // namespace
@@ -19,6 +19,8 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/pooling.h"
+#include "tensorflow/compiler/xla/client/padding.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 
 namespace swift_xla {
 namespace ir {
@@ -30,45 +32,73 @@ xla::Shape NodeOutputShape(const Value& input,
                            absl::Span<const xla::int64> kernel_size,
                            std::vector<xla::int64> strides,
                            xla::Padding padding,
-                           const xla::TensorFormat& data_format) {
+                           const xla::TensorFormat& data_format,
+                           bool with_indices) {
   auto lower_for_shape_fn =
       [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
     XLA_CHECK_EQ(operands.size(), 1)
         << "Unexpected number of operands: " << operands.size();
-    return xla::MaxPool(operands[0], kernel_size, strides, padding,
-                        data_format);
+    xla::XlaOp result = xla::MaxPool(operands[0], kernel_size, strides,
+                                     padding, data_format);
+    if (!with_indices) {
+      return result;
+    }
+    return xla::Tuple(result.builder(),
+                      {result, BuildTilingMaxPoolIndices(
+                                   operands[0], result, kernel_size, strides,
+                                   padding)});
   };
-  return InferOutputShape({input.shape()}, lower_for_shape_fn);
+  auto static_shape_fn = [&]() -> xla::Shape {
+    const xla::Shape& input_shape = input.shape();
+    xla::Shape result_shape = GetPoolingOutputShape(
+        input_shape, kernel_size, strides,
+        xla::MakePadding(input_shape.dimensions(), kernel_size, strides,
+                         padding));
+    if (!with_indices) {
+      return result_shape;
+    }
+    return xla::ShapeUtil::MakeTupleShape(
+        {result_shape, xla::ShapeUtil::ChangeElementType(
+                           result_shape, xla::PrimitiveType::U32)});
+  };
+  return InferOutputShape({input.shape()}, static_shape_fn,
+                          lower_for_shape_fn);
 }
 
 }  // namespace
 
 XlaMaxPool::XlaMaxPool(const Value& input, std::vector<xla::int64> kernel_size,
                        std::vector<xla::int64> strides, xla::Padding padding,
-                       xla::TensorFormat data_format)
+                       xla::TensorFormat data_format, bool with_indices)
     : Node(ir::OpKind(at::aten::xla_max_pool), {input},
            [&]() {
              return NodeOutputShape(input, kernel_size, strides, padding,
-                                    data_format);
+                                    data_format, with_indices);
            },
-           /*num_outputs=*/1,
+           /*num_outputs=*/with_indices ? 2 : 1,
            xla::util::MHash(kernel_size, strides, static_cast<int>(padding),
-                            DataFormatToList(data_format))),
+                            DataFormatToList(data_format), with_indices)),
       kernel_size_(std::move(kernel_size)),
       strides_(std::move(strides)),
       padding_(padding),
-      data_format_(std::move(data_format)) {}
+      data_format_(std::move(data_format)),
+      with_indices_(with_indices) {}
 
 NodePtr XlaMaxPool::Clone(OpList operands) const {
   return MakeNode<XlaMaxPool>(operands.at(0), kernel_size_, strides_, padding_,
-                              data_format_);
+                              data_format_, with_indices_);
 }
 
 XlaOpVector XlaMaxPool::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
   xla::XlaOp output =
       xla::MaxPool(input, kernel_size_, strides_, padding_, data_format_);
-  return ReturnOp(output, loctx);
+  if (!with_indices_) {
+    return ReturnOp(output, loctx);
+  }
+  xla::XlaOp indices = BuildTilingMaxPoolIndices(input, output, kernel_size_,
+                                                 strides_, padding_);
+  return ReturnOps({output, indices}, loctx);
 }
 
 std::string XlaMaxPool::ToString() const {
@@ -77,7 +107,8 @@ std::string XlaMaxPool::ToString() const {
      << absl::StrJoin(kernel_size_, ", ") << "], strides=["
      << absl::StrJoin(strides_, ", ")
      << "], padding=" << static_cast<int>(padding_) << ", data_format=["
-     << absl::StrJoin(DataFormatToList(data_format_), "]");
+     << absl::StrJoin(DataFormatToList(data_format_), "]")
+     << ", with_indices=" << with_indices_;
   return ss.str();
 }
 
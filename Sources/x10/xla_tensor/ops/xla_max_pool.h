@@ -24,11 +24,14 @@ namespace swift_xla {
 namespace ir {
 namespace ops {
 
+// Max pooling. With with_indices, the windows must tile the input, and the
+// second output holds the index of the maximum of every window, see
+// BuildTilingMaxPoolIndices().
 class XlaMaxPool : public Node {
  public:
   XlaMaxPool(const Value& input, std::vector<xla::int64> kernel_size,
              std::vector<xla::int64> strides, xla::Padding padding,
-             xla::TensorFormat data_format);
+             xla::TensorFormat data_format, bool with_indices = false);
 
   NodePtr Clone(OpList operands) const override;
 
@@ -44,12 +47,15 @@ class XlaMaxPool : public Node {
 
   const xla::TensorFormat& data_format() const { return data_format_; }
 
+  bool with_indices() const { return with_indices_; }
+
  private:
   // The parameters of the pooling.
   std::vector<xla::int64> kernel_size_;
   std::vector<xla::int64> strides_;
   xla::Padding padding_;
   xla::TensorFormat data_format_;
+  bool with_indices_;
 };
 
 }  // namespace ops
@@ -53,8 +53,10 @@ xla::Shape NodeOutputShape(const Value& input, const Value& out_backprop,
     return BuildXlaMaxPoolGrad(operands[0], operands[1], kernel_size, strides,
                                padding);
   };
+  // The gradient is scattered over the pooling input.
+  auto static_shape_fn = [&]() -> xla::Shape { return input.shape(); };
   return InferOutputShape({input.shape(), out_backprop.shape()},
-                          lower_for_shape_fn);
+                          static_shape_fn, lower_for_shape_fn);
 }
 
 }  // namespace
@@ -74,7 +76,25 @@ XlaMaxPoolGrad::XlaMaxPoolGrad(const Value& input, const Value& out_backprop,
       strides_(std::move(strides)),
       padding_(padding) {}
 
+XlaMaxPoolGrad::XlaMaxPoolGrad(const Value& input, const Value& out_backprop,
+                               const Value& indices,
+                               std::vector<xla::int64> kernel_size,
+                               std::vector<xla::int64> strides,
+                               xla::Padding padding)
+    : Node(ir::OpKind(at::aten::xla_max_pool_grad),
+           {input, out_backprop, indices}, input.shape(),
+           /*num_outputs=*/1,
+           xla::util::MHash(kernel_size, strides, static_cast<int>(padding))),
+      kernel_size_(std::move(kernel_size)),
+      strides_(std::move(strides)),
+      padding_(padding) {}
+
 NodePtr XlaMaxPoolGrad::Clone(OpList operands) const {
+  if (operands.size() > 2) {
+    return MakeNode<XlaMaxPoolGrad>(operands.at(0), operands.at(1),
+                                    operands.at(2), kernel_size_, strides_,
+                                    padding_);
+  }
   return MakeNode<XlaMaxPoolGrad>(operands.at(0), operands.at(1), kernel_size_,
                                   strides_, padding_);
 }
@@ -82,8 +102,13 @@ NodePtr XlaMaxPoolGrad::Clone(OpList operands) const {
 XlaOpVector XlaMaxPoolGrad::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
   xla::XlaOp out_backprop = loctx->GetOutputOp(operand(1));
-  xla::XlaOp output = BuildXlaMaxPoolGrad(input, out_backprop, kernel_size_,
-                                          strides_, padding_);
+  xla::XlaOp output =
+      operands().size() > 2
+          ? BuildTilingMaxPoolGrad(input, out_backprop,
+                                   loctx->GetOutputOp(operand(2)),
+                                   kernel_size_, strides_, padding_)
+          : BuildXlaMaxPoolGrad(input, out_backprop, kernel_size_, strides_,
+                                padding_);
   return ReturnOp(output, loctx);
 }
 
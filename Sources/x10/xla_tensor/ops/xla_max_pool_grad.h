@@ -23,12 +23,18 @@ namespace swift_xla {
 namespace ir {
 namespace ops {
 
+// Max pooling gradient. Given the indices of a tiling XlaMaxPool, it is
+// computed with BuildTilingMaxPoolGrad() instead of a select-and-scatter.
 class XlaMaxPoolGrad : public Node {
  public:
   XlaMaxPoolGrad(const Value& input, const Value& out_backprop,
                  std::vector<xla::int64> kernel_size,
                  std::vector<xla::int64> strides, xla::Padding padding);
 
+  XlaMaxPoolGrad(const Value& input, const Value& out_backprop,
+                 const Value& indices, std::vector<xla::int64> kernel_size,
+                 std::vector<xla::int64> strides, xla::Padding padding);
+
   NodePtr Clone(OpList operands) const override;
 
   XlaOpVector Lower(LoweringContext* loctx) const override;
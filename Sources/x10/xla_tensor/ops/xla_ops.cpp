@@ -21,6 +21,8 @@ namespace ir {
 namespace ops {
 
 const OpKindWrapper xla_all_to_all(xla_symbols::all_to_all);
+const OpKindWrapper xla_adam_update(xla_symbols::adam_update);
+const OpKindWrapper xla_all_gather(xla_symbols::all_gather);
 const OpKindWrapper xla_as_strided_view_update(
     xla_symbols::as_strided_view_update);
 const OpKindWrapper xla_cast(xla_symbols::cast);
@@ -28,15 +30,43 @@ const OpKindWrapper xla_collective_permute(xla_symbols::collective_permute);
 const OpKindWrapper xla_cross_replica_sum(xla_symbols::cross_replica_sum);
 const OpKindWrapper xla_device_data(xla_symbols::device_data);
 const OpKindWrapper xla_diagonal_view_update(xla_symbols::diagonal_view_update);
+const OpKindWrapper xla_embedding_bag(xla_symbols::embedding_bag);
+const OpKindWrapper xla_embedding_bag_backward(
+    xla_symbols::embedding_bag_backward);
+const OpKindWrapper xla_fused_batch_norm(xla_symbols::fused_batch_norm);
+const OpKindWrapper xla_fused_batch_norm_backward(
+    xla_symbols::fused_batch_norm_backward);
 const OpKindWrapper xla_generic_slice(xla_symbols::generic_slice);
 const OpKindWrapper xla_get_dimensions_size(xla_symbols::get_dimensions_size);
+const OpKindWrapper xla_layer_norm(xla_symbols::layer_norm);
+const OpKindWrapper xla_layer_norm_backward(xla_symbols::layer_norm_backward);
+const OpKindWrapper xla_loss_scale_update(xla_symbols::loss_scale_update);
+const OpKindWrapper xla_moments(xla_symbols::moments);
 const OpKindWrapper xla_moving_average(xla_symbols::moving_average);
 const OpKindWrapper xla_nms(xla_symbols::nms);
 const OpKindWrapper xla_not_supported(xla_symbols::not_supported);
+const OpKindWrapper xla_reduce_scatter(xla_symbols::reduce_scatter);
+const OpKindWrapper xla_remat_barrier(xla_symbols::remat_barrier);
 const OpKindWrapper xla_replication_pad(xla_symbols::replication_pad);
 const OpKindWrapper xla_replication_pad_backward(
     xla_symbols::replication_pad_backward);
+const OpKindWrapper xla_resize_bilinear(xla_symbols::resize_bilinear);
+const OpKindWrapper xla_resize_bilinear_backward(
+    xla_symbols::resize_bilinear_backward);
+const OpKindWrapper xla_rms_norm(xla_symbols::rms_norm);
+const OpKindWrapper xla_rms_norm_backward(xla_symbols::rms_norm_backward);
+const OpKindWrapper xla_rng_normal(xla_symbols::rng_normal);
+const OpKindWrapper xla_rng_uniform(xla_symbols::rng_uniform);
+const OpKindWrapper xla_scaled_dot_product_attention(
+    xla_symbols::scaled_dot_product_attention);
+const OpKindWrapper xla_scaled_dot_product_attention_backward(
+    xla_symbols::scaled_dot_product_attention_backward);
 const OpKindWrapper xla_select(xla_symbols::select);
+const OpKindWrapper xla_sgd_update(xla_symbols::sgd_update);
+const OpKindWrapper xla_sharded_adam_update(xla_symbols::sharded_adam_update);
+const OpKindWrapper xla_sharding(xla_symbols::sharding);
+const OpKindWrapper xla_softmax_cross_entropy(
+    xla_symbols::softmax_cross_entropy);
 const OpKindWrapper xla_tensor_data(xla_symbols::tensor_data);
 const OpKindWrapper xla_token(xla_symbols::token);
 const OpKindWrapper xla_unselect(xla_symbols::unselect);
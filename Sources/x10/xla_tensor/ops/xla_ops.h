@@ -38,20 +38,44 @@ class OpKindWrapper {
 };
 
 extern const OpKindWrapper xla_all_to_all;
+extern const OpKindWrapper xla_adam_update;
+extern const OpKindWrapper xla_all_gather;
 extern const OpKindWrapper xla_as_strided_view_update;
 extern const OpKindWrapper xla_cast;
 extern const OpKindWrapper xla_collective_permute;
 extern const OpKindWrapper xla_cross_replica_sum;
 extern const OpKindWrapper xla_device_data;
 extern const OpKindWrapper xla_diagonal_view_update;
+extern const OpKindWrapper xla_embedding_bag;
+extern const OpKindWrapper xla_embedding_bag_backward;
+extern const OpKindWrapper xla_fused_batch_norm;
+extern const OpKindWrapper xla_fused_batch_norm_backward;
 extern const OpKindWrapper xla_generic_slice;
 extern const OpKindWrapper xla_get_dimensions_size;
+extern const OpKindWrapper xla_layer_norm;
+extern const OpKindWrapper xla_layer_norm_backward;
+extern const OpKindWrapper xla_loss_scale_update;
+extern const OpKindWrapper xla_moments;
 extern const OpKindWrapper xla_moving_average;
 extern const OpKindWrapper xla_nms;
 extern const OpKindWrapper xla_not_supported;
+extern const OpKindWrapper xla_reduce_scatter;
+extern const OpKindWrapper xla_remat_barrier;
 extern const OpKindWrapper xla_replication_pad;
 extern const OpKindWrapper xla_replication_pad_backward;
+extern const OpKindWrapper xla_resize_bilinear;
+extern const OpKindWrapper xla_resize_bilinear_backward;
+extern const OpKindWrapper xla_rms_norm;
+extern const OpKindWrapper xla_rms_norm_backward;
+extern const OpKindWrapper xla_rng_normal;
+extern const OpKindWrapper xla_rng_uniform;
+extern const OpKindWrapper xla_scaled_dot_product_attention;
+extern const OpKindWrapper xla_scaled_dot_product_attention_backward;
 extern const OpKindWrapper xla_select;
+extern const OpKindWrapper xla_sgd_update;
+extern const OpKindWrapper xla_sharded_adam_update;
+extern const OpKindWrapper xla_sharding;
+extern const OpKindWrapper xla_softmax_cross_entropy;
 extern const OpKindWrapper xla_tensor_data;
 extern const OpKindWrapper xla_token;
 extern const OpKindWrapper xla_unselect;
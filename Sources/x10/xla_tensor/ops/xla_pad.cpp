@@ -14,10 +14,11 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_pad.h"
 
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
-#include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/shape_inference.h"
 
 namespace swift_xla {
 namespace ir {
@@ -26,14 +27,8 @@ namespace {
 
 xla::Shape NodeOutputShape(const Value& operand, const Value& padding_value,
                            const xla::PaddingConfig& padding) {
-  auto lower_for_shape_fn =
-      [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
-    CHECK_EQ(operands.size(), 2)
-        << "Unexpected number of operands: " << operands.size();
-    return xla::Pad(operands[0], operands[1], padding);
-  };
-  return InferOutputShape({operand.shape(), padding_value.shape()},
-                          lower_for_shape_fn);
+  return ConsumeValue(xla::ShapeInference::InferPadShape(
+      operand.shape(), padding_value.shape(), padding));
 }
 
 xla::hash_t PaddingConfigHash(const xla::PaddingConfig& padding_config) {
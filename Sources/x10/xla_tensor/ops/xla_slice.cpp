@@ -14,9 +14,10 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_slice.h"
 
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
-#include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
+#include "tensorflow/compiler/xla/service/shape_inference.h"
 
 namespace swift_xla {
 namespace ir {
@@ -27,13 +28,8 @@ xla::Shape NodeOutputShape(const Value& operand,
                            absl::Span<const xla::int64> start_indices,
                            absl::Span<const xla::int64> limit_indices,
                            absl::Span<const xla::int64> strides) {
-  auto lower_for_shape_fn =
-      [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
-    CHECK_EQ(operands.size(), 1)
-        << "Unexpected number of operands: " << operands.size();
-    return xla::Slice(operands[0], start_indices, limit_indices, strides);
-  };
-  return InferOutputShape({operand.shape()}, lower_for_shape_fn);
+  return ConsumeValue(xla::ShapeInference::InferSliceShape(
+      operand.shape(), start_indices, limit_indices, strides));
 }
 
 }  // namespace
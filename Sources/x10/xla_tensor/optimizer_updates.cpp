@@ -0,0 +1,256 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_updates.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace {
+
+xla::PrimitiveType UpdateComputeType(absl::Span<const xla::XlaOp> weights) {
+  XLA_CHECK(!weights.empty());
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(weights.front());
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+// Reshapes the inputs to rank 1 and concatenates them, in the compute type.
+xla::XlaOp Flatten(absl::Span<const xla::XlaOp> inputs,
+                   xla::PrimitiveType type) {
+  std::vector<xla::XlaOp> flat_inputs;
+  flat_inputs.reserve(inputs.size());
+  for (xla::XlaOp input : inputs) {
+    const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+    flat_inputs.push_back(xla::ConvertElementType(
+        xla::Reshape(input, {xla::ShapeUtil::ElementsIn(shape)}), type));
+  }
+  return flat_inputs.size() == 1
+             ? flat_inputs.front()
+             : xla::ConcatInDim(inputs.front().builder(), flat_inputs, 0);
+}
+
+// Splits the output of Flatten() back into tensors with the shapes of the
+// original inputs, appending them to results.
+void Unflatten(xla::XlaOp flat, absl::Span<const xla::XlaOp> inputs,
+               std::vector<xla::XlaOp>* results) {
+  xla::int64 offset = 0;
+  for (xla::XlaOp input : inputs) {
+    const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+    xla::int64 size = xla::ShapeUtil::ElementsIn(shape);
+    xla::XlaOp slice = inputs.size() == 1
+                           ? flat
+                           : xla::Slice(flat, {offset}, {offset + size}, {1});
+    results->push_back(xla::ConvertElementType(
+        xla::Reshape(slice, shape.dimensions()), shape.element_type()));
+    offset += size;
+  }
+}
+
+// Keeps the old values of the update when the gradients are not finite.
+void SkipUnlessFinite(const absl::optional<xla::XlaOp>& grads_finite,
+                      absl::Span<const xla::XlaOp> old_values,
+                      std::vector<xla::XlaOp>* new_values) {
+  if (!grads_finite) {
+    return;
+  }
+  XLA_CHECK_EQ(old_values.size(), new_values->size());
+  for (size_t i = 0; i < old_values.size(); ++i) {
+    (*new_values)[i] =
+        xla::Select(*grads_finite, (*new_values)[i], old_values[i]);
+  }
+}
+
+}  // namespace
+
+std::vector<xla::XlaOp> BuildAdamUpdate(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> m, absl::Span<const xla::XlaOp> v,
+    xla::XlaOp learning_rate, xla::XlaOp beta1, xla::XlaOp beta2,
+    xla::XlaOp epsilon, xla::XlaOp weight_decay,
+    absl::optional<xla::XlaOp> grads_finite) {
+  xla::PrimitiveType type = UpdateComputeType(weights);
+  xla::XlaOp one = xla::One(learning_rate.builder(), type);
+  learning_rate = xla::ConvertElementType(learning_rate, type);
+  beta1 = xla::ConvertElementType(beta1, type);
+  beta2 = xla::ConvertElementType(beta2, type);
+  epsilon = xla::ConvertElementType(epsilon, type);
+  weight_decay = xla::ConvertElementType(weight_decay, type);
+
+  xla::XlaOp flat_weights = Flatten(weights, type);
+  xla::XlaOp flat_grads = Flatten(grads, type);
+  xla::XlaOp flat_m = beta1 * Flatten(m, type) + (one - beta1) * flat_grads;
+  xla::XlaOp flat_v =
+      beta2 * Flatten(v, type) + (one - beta2) * flat_grads * flat_grads;
+  xla::XlaOp update =
+      flat_m / (xla::Sqrt(flat_v) + epsilon) + weight_decay * flat_weights;
+  flat_weights = flat_weights - learning_rate * update;
+
+  std::vector<xla::XlaOp> results;
+  results.reserve(3 * weights.size());
+  Unflatten(flat_weights, weights, &results);
+  Unflatten(flat_m, m, &results);
+  Unflatten(flat_v, v, &results);
+  std::vector<xla::XlaOp> old_values(weights.begin(), weights.end());
+  old_values.insert(old_values.end(), m.begin(), m.end());
+  old_values.insert(old_values.end(), v.begin(), v.end());
+  SkipUnlessFinite(grads_finite, old_values, &results);
+  return results;
+}
+
+std::vector<xla::XlaOp> BuildShardedAdamUpdate(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    xla::XlaOp m_shard, xla::XlaOp v_shard, xla::XlaOp learning_rate,
+    xla::XlaOp beta1, xla::XlaOp beta2, xla::XlaOp epsilon,
+    xla::XlaOp weight_decay, xla::int64 num_shards, double grad_scale,
+    absl::optional<xla::XlaOp> grads_finite) {
+  xla::PrimitiveType type = UpdateComputeType(weights);
+  xla::PrimitiveType weight_type = XlaHelpers::TypeOfXlaOp(weights.front());
+  xla::XlaBuilder* builder = learning_rate.builder();
+  xla::XlaOp flat_weights = Flatten(weights, type);
+  xla::XlaOp flat_grads = Flatten(grads, type);
+  xla::int64 size =
+      xla::ShapeUtil::ElementsIn(XlaHelpers::ShapeOfXlaOp(flat_weights));
+  xla::int64 shard_size = GetOptimizerShardSize(size, num_shards);
+  if (shard_size * num_shards != size) {
+    xla::XlaOp zero = xla::Zero(builder, type);
+    flat_weights =
+        xla::PadInDim(flat_weights, zero, 0, 0, shard_size * num_shards - size);
+    flat_grads =
+        xla::PadInDim(flat_grads, zero, 0, 0, shard_size * num_shards - size);
+  }
+
+  xla::XlaOp grad_shard = flat_grads;
+  xla::XlaOp weight_shard = flat_weights;
+  if (num_shards > 1) {
+    grad_shard = BuildReduceScatterSum(flat_grads, num_shards, /*groups=*/{});
+    xla::XlaOp offset =
+        xla::ConvertElementType(xla::ReplicaId(builder), xla::S64) *
+        xla::ConstantR0<xla::int64>(builder, shard_size);
+    weight_shard = xla::DynamicSlice(flat_weights, {offset}, {shard_size});
+  }
+  if (grad_scale != 1.0) {
+    grad_shard =
+        grad_shard * XlaHelpers::ScalarValue<double>(grad_scale, type, builder);
+  }
+  std::vector<xla::XlaOp> shard_results = BuildAdamUpdate(
+      {weight_shard}, {grad_shard}, {m_shard}, {v_shard}, learning_rate, beta1,
+      beta2, epsilon, weight_decay, grads_finite);
+
+  // The weight slices travel in the weight type, which halves the all-gather
+  // traffic of reduced precision weights.
+  xla::XlaOp new_weights =
+      xla::ConvertElementType(shard_results[0], weight_type);
+  if (num_shards > 1) {
+    new_weights = BuildAllGather(new_weights, num_shards, /*groups=*/{});
+  }
+  if (shard_size * num_shards != size) {
+    new_weights = xla::SliceInDim(new_weights, 0, size, 1, 0);
+  }
+  std::vector<xla::XlaOp> results;
+  results.reserve(weights.size() + 2);
+  Unflatten(new_weights, weights, &results);
+  results.push_back(shard_results[1]);
+  results.push_back(shard_results[2]);
+  return results;
+}
+
+xla::int64 GetOptimizerShardSize(xla::int64 num_elements,
+                                 xla::int64 num_shards) {
+  XLA_CHECK_GT(num_shards, 0);
+  return (num_elements + num_shards - 1) / num_shards;
+}
+
+std::vector<xla::XlaOp> BuildSgdUpdate(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> velocities, xla::XlaOp learning_rate,
+    xla::XlaOp momentum, xla::XlaOp weight_decay, bool nesterov,
+    absl::optional<xla::XlaOp> grads_finite) {
+  xla::PrimitiveType type = UpdateComputeType(weights);
+  learning_rate = xla::ConvertElementType(learning_rate, type);
+  momentum = xla::ConvertElementType(momentum, type);
+  weight_decay = xla::ConvertElementType(weight_decay, type);
+
+  xla::XlaOp flat_weights = Flatten(weights, type);
+  xla::XlaOp flat_grads = Flatten(grads, type) + weight_decay * flat_weights;
+  xla::XlaOp flat_velocities =
+      momentum * Flatten(velocities, type) - learning_rate * flat_grads;
+  xla::XlaOp step =
+      nesterov ? momentum * flat_velocities - learning_rate * flat_grads
+               : flat_velocities;
+  flat_weights = flat_weights + step;
+
+  std::vector<xla::XlaOp> results;
+  results.reserve(2 * weights.size());
+  Unflatten(flat_weights, weights, &results);
+  Unflatten(flat_velocities, velocities, &results);
+  std::vector<xla::XlaOp> old_values(weights.begin(), weights.end());
+  old_values.insert(old_values.end(), velocities.begin(), velocities.end());
+  SkipUnlessFinite(grads_finite, old_values, &results);
+  return results;
+}
+
+std::vector<xla::XlaOp> BuildLossScaleUpdate(absl::Span<const xla::XlaOp> grads,
+                                             xla::XlaOp loss_scale,
+                                             xla::XlaOp good_steps,
+                                             xla::int64 growth_interval,
+                                             double growth_factor,
+                                             double backoff_factor) {
+  xla::XlaBuilder* builder = loss_scale.builder();
+  xla::PrimitiveType scale_type = XlaHelpers::TypeOfXlaOp(loss_scale);
+  xla::PrimitiveType steps_type = XlaHelpers::TypeOfXlaOp(good_steps);
+  xla::XlaComputation and_computation =
+      XlaHelpers::CreateAndComputation(xla::PrimitiveType::PRED);
+  xla::XlaOp finite = xla::ConstantR0<bool>(builder, true);
+  std::vector<xla::XlaOp> results;
+  results.reserve(grads.size() + 3);
+  for (xla::XlaOp grad : grads) {
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(grad);
+    xla::PrimitiveType compute_type = UpdateComputeType({grad});
+    xla::XlaOp inv_scale = xla::ConvertElementType(
+        xla::One(builder, scale_type) / loss_scale, compute_type);
+    xla::XlaOp unscaled =
+        xla::ConvertElementType(grad, compute_type) * inv_scale;
+    finite = xla::And(
+        finite, xla::ReduceAll(xla::IsFinite(unscaled),
+                               xla::ConstantR0<bool>(builder, true),
+                               and_computation));
+    results.push_back(xla::ConvertElementType(unscaled, type));
+  }
+  xla::XlaOp next_steps = good_steps + xla::One(builder, steps_type);
+  xla::XlaOp grow =
+      xla::Ge(next_steps,
+              XlaHelpers::ScalarValue(growth_interval, steps_type, builder));
+  xla::XlaOp zero_steps = xla::Zero(builder, steps_type);
+  xla::XlaOp finite_scale = xla::Select(
+      grow,
+      loss_scale * XlaHelpers::ScalarValue(growth_factor, scale_type, builder),
+      loss_scale);
+  xla::XlaOp backoff_scale =
+      loss_scale * XlaHelpers::ScalarValue(backoff_factor, scale_type, builder);
+  xla::XlaOp new_scale = xla::Select(finite, finite_scale, backoff_scale);
+  xla::XlaOp new_steps = xla::Select(
+      finite, xla::Select(grow, zero_steps, next_steps), zero_steps);
+  results.push_back(finite);
+  results.push_back(new_scale);
+  results.push_back(new_steps);
+  return results;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+// Applies the Adam update, without bias correction, to every weight w with
+// gradient g and moments m and v:
+//   m = beta1 * m + (1 - beta1) * g
+//   v = beta2 * v + (1 - beta2) * g * g
+//   w = w - learning_rate * (m / (sqrt(v) + epsilon) + weight_decay * w)
+// The tensors are flattened and concatenated, so that the update is a single
+// elementwise computation whatever their number. The hyperparameters are
+// scalars. If grads_finite, a scalar predicate, is given, the weights and
+// moments are left unchanged when it is false. Returns the new weights, then
+// the new m and the new v values.
+std::vector<xla::XlaOp> BuildAdamUpdate(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> m, absl::Span<const xla::XlaOp> v,
+    xla::XlaOp learning_rate, xla::XlaOp beta1, xla::XlaOp beta2,
+    xla::XlaOp epsilon, xla::XlaOp weight_decay,
+    absl::optional<xla::XlaOp> grads_finite = absl::nullopt);
+
+// The Adam update of BuildAdamUpdate() for data parallel replicas which only
+// keep a shard of the optimizer state. The flattened and concatenated tensors
+// are padded and split into num_shards slices, one per replica. The local
+// gradients are reduce-scattered, summed and multiplied by grad_scale, so that
+// every replica updates its slice of the weights, and its m and v shards, which
+// are rank 1 tensors of the slice size. The new weight slices are then
+// all-gathered. Returns the new weights, then the new m and v shards.
+std::vector<xla::XlaOp> BuildShardedAdamUpdate(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    xla::XlaOp m_shard, xla::XlaOp v_shard, xla::XlaOp learning_rate,
+    xla::XlaOp beta1, xla::XlaOp beta2, xla::XlaOp epsilon,
+    xla::XlaOp weight_decay, xla::int64 num_shards, double grad_scale,
+    absl::optional<xla::XlaOp> grads_finite = absl::nullopt);
+
+// Returns the size of the optimizer state shards of BuildShardedAdamUpdate(),
+// for weights with num_elements elements in total.
+xla::int64 GetOptimizerShardSize(xla::int64 num_elements,
+                                 xla::int64 num_shards);
+
+// Applies the SGD with momentum update to every weight w with gradient g and
+// velocity u:
+//   g = g + weight_decay * w
+//   u = momentum * u - learning_rate * g
+//   w = w + (nesterov ? momentum * u - learning_rate * g : u)
+// over the concatenation of the flattened tensors, skipped like in
+// BuildAdamUpdate() if grads_finite is false. Returns the new weights, then the
+// new velocities.
+std::vector<xla::XlaOp> BuildSgdUpdate(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> velocities, xla::XlaOp learning_rate,
+    xla::XlaOp momentum, xla::XlaOp weight_decay, bool nesterov,
+    absl::optional<xla::XlaOp> grads_finite = absl::nullopt);
+
+// Dynamic loss scaling. Divides the gradients of a loss multiplied by
+// loss_scale by it, and checks whether they are all finite. If they are, the
+// good_steps count is incremented, and once it reaches growth_interval the
+// scale is multiplied by growth_factor and the count reset. Otherwise the scale
+// is multiplied by backoff_factor and the count reset. Returns the unscaled
+// gradients, then the scalar predicate telling whether they are finite, which
+// the optimizer updates take to skip the step, the new scale and the new count.
+std::vector<xla::XlaOp> BuildLossScaleUpdate(absl::Span<const xla::XlaOp> grads,
+                                             xla::XlaOp loss_scale,
+                                             xla::XlaOp good_steps,
+                                             xla::int64 growth_interval,
+                                             double growth_factor,
+                                             double backoff_factor);
+
+}  // namespace swift_xla
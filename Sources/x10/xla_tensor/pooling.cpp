@@ -109,6 +109,40 @@ std::vector<xla::int64> AdaptiveAvgPoolKernelSize(
   return kernel_size;
 }
 
+// Returns the [input_size, output_size] matrix averaging the windows of an
+// adaptive average pooling along a single dimension.
+xla::XlaOp AdaptiveAvgPoolMatrix(xla::int64 input_size, xla::int64 output_size,
+                                 xla::PrimitiveType type,
+                                 xla::XlaBuilder* builder) {
+  xla::Shape shape = xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                               {input_size, output_size});
+  xla::XlaOp rows = xla::Iota(builder, shape, 0);
+  xla::XlaOp columns = xla::Iota(builder, shape, 1);
+  xla::XlaOp in = XlaHelpers::ScalarValue<xla::int64>(
+      input_size, xla::PrimitiveType::S32, builder);
+  xla::XlaOp out = XlaHelpers::ScalarValue<xla::int64>(
+      output_size, xla::PrimitiveType::S32, builder);
+  xla::XlaOp one = xla::One(builder, xla::PrimitiveType::S32);
+  xla::XlaOp start = xla::Div(xla::Mul(columns, in), out);
+  xla::XlaOp end =
+      xla::Div(xla::Add(xla::Mul(columns + one, in), out - one), out);
+  xla::XlaOp in_window = xla::And(xla::Ge(rows, start), xla::Lt(rows, end));
+  return xla::ConvertElementType(in_window, type) /
+         xla::ConvertElementType(end - start, type);
+}
+
+// Contracts the dimension dim of x with the dimension matrix_dim of matrix,
+// whose other dimension becomes the last one of the result.
+xla::XlaOp ContractWithMatrix(xla::XlaOp x, xla::int64 dim, xla::XlaOp matrix,
+                              xla::int64 matrix_dim) {
+  xla::DotDimensionNumbers dims;
+  dims.add_lhs_contracting_dimensions(dim);
+  dims.add_rhs_contracting_dimensions(matrix_dim);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::DotGeneral(x, matrix, dims, &precision_config);
+}
+
 struct BatchInput {
   xla::XlaOp batch_input;
   xla::int64 original_rank;
@@ -352,8 +386,142 @@ xla::XlaOp ComputeMaxPoolIndices(
   return xla::Reshape(results[result_id], pool_result_shape.dimensions());
 }
 
+// Pads or crops every dimension of the tiling max pooling input to the
+// windows, which cover the whole padded dimensions but their trailing
+// remainder.
+xla::PaddingConfig MakeTilingPaddingConfig(
+    absl::Span<const xla::int64> input_sizes,
+    absl::Span<const xla::int64> kernel_size, xla::Padding padding) {
+  std::vector<std::pair<xla::int64, xla::int64>> pads =
+      xla::MakePadding(input_sizes, kernel_size, kernel_size, padding);
+  xla::PaddingConfig padding_config;
+  for (size_t i = 0; i < input_sizes.size(); ++i) {
+    xla::int64 padded_size = input_sizes[i] + pads[i].first + pads[i].second;
+    xla::int64 tiled_size = padded_size / kernel_size[i] * kernel_size[i];
+    xla::PaddingConfig::PaddingConfigDimension* dims =
+        padding_config.add_dimensions();
+    dims->set_edge_padding_low(pads[i].first);
+    dims->set_edge_padding_high(tiled_size - input_sizes[i] - pads[i].first);
+  }
+  return padding_config;
+}
+
+// Repeats every element of a tiling max pooling result over its window.
+xla::XlaOp UpsampleToWindows(xla::XlaOp pooled,
+                             absl::Span<const xla::int64> kernel_size) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(pooled);
+  std::vector<xla::int64> broadcast_sizes;
+  std::vector<xla::int64> broadcast_dimensions;
+  std::vector<xla::int64> upsampled_sizes;
+  for (xla::int64 i = 0; i < shape.rank(); ++i) {
+    broadcast_dimensions.push_back(broadcast_sizes.size());
+    broadcast_sizes.push_back(shape.dimensions(i));
+    broadcast_sizes.push_back(kernel_size[i]);
+    upsampled_sizes.push_back(shape.dimensions(i) * kernel_size[i]);
+  }
+  return xla::Reshape(
+      xla::BroadcastInDim(pooled, broadcast_sizes, broadcast_dimensions),
+      upsampled_sizes);
+}
+
+// The linear indices of the input elements, padded or cropped to the windows
+// of a tiling max pooling.
+xla::XlaOp TilingInputIndices(const xla::Shape& input_shape,
+                              const xla::PaddingConfig& padding_config,
+                              xla::XlaBuilder* builder) {
+  xla::XlaOp iota = xla::Reshape(
+      xla::Iota(builder,
+                xla::ShapeUtil::MakeShape(
+                    kIndicesType,
+                    {xla::ShapeUtil::ElementsIn(input_shape)}),
+                0),
+      input_shape.dimensions());
+  return xla::Pad(iota, xla::MaxValue(builder, kIndicesType), padding_config);
+}
+
 }  // namespace
 
+bool IsTilingMaxPool(absl::Span<const xla::int64> kernel_size,
+                     absl::Span<const xla::int64> stride) {
+  return kernel_size == stride;
+}
+
+xla::XlaOp BuildTilingMaxPoolIndices(xla::XlaOp input, xla::XlaOp pool_result,
+                                     absl::Span<const xla::int64> kernel_size,
+                                     absl::Span<const xla::int64> stride,
+                                     xla::Padding padding) {
+  XLA_CHECK(IsTilingMaxPool(kernel_size, stride));
+  xla::XlaBuilder* builder = input.builder();
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PaddingConfig padding_config = MakeTilingPaddingConfig(
+      input_shape.dimensions(), kernel_size, padding);
+  xla::XlaOp tiled_input = xla::Pad(
+      input, xla::MinValue(builder, input_shape.element_type()),
+      padding_config);
+  xla::XlaOp tiled_indices =
+      TilingInputIndices(input_shape, padding_config, builder);
+  // The first maximum of every window wins, like with the select-and-scatter
+  // of the gradient.
+  xla::XlaOp max_indices =
+      xla::Select(xla::Eq(tiled_input,
+                          UpsampleToWindows(pool_result, kernel_size)),
+                  tiled_indices, xla::Broadcast(
+                      xla::MaxValue(builder, kIndicesType),
+                      XlaHelpers::SizesOfXlaOp(tiled_indices)));
+  return xla::ReduceWindow(
+      max_indices, xla::MaxValue(builder, kIndicesType),
+      xla::CreateScalarMinComputation(kIndicesType, builder), kernel_size,
+      stride, xla::Padding::kValid);
+}
+
+xla::XlaOp BuildTilingMaxPoolGrad(xla::XlaOp input, xla::XlaOp out_backprop,
+                                  xla::XlaOp indices,
+                                  absl::Span<const xla::int64> kernel_size,
+                                  absl::Span<const xla::int64> stride,
+                                  xla::Padding padding) {
+  XLA_CHECK(IsTilingMaxPool(kernel_size, stride));
+  xla::XlaBuilder* builder = out_backprop.builder();
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PaddingConfig padding_config = MakeTilingPaddingConfig(
+      input_shape.dimensions(), kernel_size, padding);
+  xla::XlaOp tiled_indices =
+      TilingInputIndices(input_shape, padding_config, builder);
+  xla::XlaOp upsampled_grad = UpsampleToWindows(out_backprop, kernel_size);
+  xla::XlaOp upsampled_indices = UpsampleToWindows(indices, kernel_size);
+  xla::XlaOp tiled_grad =
+      xla::Select(xla::Eq(tiled_indices, upsampled_indices), upsampled_grad,
+                  xla::ZerosLike(upsampled_grad));
+  // Undo the tiling padding, cropping the padded positions away and padding
+  // back the trailing remainder.
+  xla::PaddingConfig inverse_config;
+  for (const auto& dims : padding_config.dimensions()) {
+    xla::PaddingConfig::PaddingConfigDimension* inverse_dims =
+        inverse_config.add_dimensions();
+    inverse_dims->set_edge_padding_low(-dims.edge_padding_low());
+    inverse_dims->set_edge_padding_high(-dims.edge_padding_high());
+  }
+  return xla::Pad(tiled_grad,
+                  xla::Zero(builder, XlaHelpers::TypeOfXlaOp(out_backprop)),
+                  inverse_config);
+}
+
+xla::Shape GetPoolingOutputShape(
+    const xla::Shape& input_shape, absl::Span<const xla::int64> kernel_size,
+    absl::Span<const xla::int64> stride,
+    absl::Span<const std::pair<xla::int64, xla::int64>> padding) {
+  XLA_CHECK_EQ(kernel_size.size(), input_shape.rank());
+  XLA_CHECK_EQ(stride.size(), input_shape.rank());
+  XLA_CHECK_EQ(padding.size(), input_shape.rank());
+  std::vector<xla::int64> dimensions(input_shape.rank());
+  for (xla::int64 i = 0; i < input_shape.rank(); ++i) {
+    xla::int64 padded_size =
+        input_shape.dimensions(i) + padding[i].first + padding[i].second;
+    XLA_CHECK_GE(padded_size, kernel_size[i]) << input_shape;
+    dimensions[i] = (padded_size - kernel_size[i]) / stride[i] + 1;
+  }
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(), dimensions);
+}
+
 bool IsSupportedAdaptiveAvgPool2d(absl::Span<const xla::int64> input_size,
                                   absl::Span<const xla::int64> output_size) {
   xla::int64 rank = input_size.size();
@@ -550,10 +718,30 @@ xla::XlaOp BuildAdaptiveAvgPool2d(xla::XlaOp input,
   const auto input_size = XlaHelpers::SizesOfXlaOp(input);
   XLA_CHECK(input_size.size() == 4 || input_size.size() == 3)
       << "Only 4D or 3D tensors supported";
-  const auto kernel_size = AdaptiveAvgPoolKernelSize(input_size, output_size);
-  std::vector<std::pair<xla::int64, xla::int64>> no_padding(2);
   BatchInput batch_input_info =
       CreateBatchInput(input, /*spatial_dim_count=*/2);
+  if (!IsSupportedAdaptiveAvgPool2d(input_size, output_size)) {
+    // Pooling [N, C, H, W] along H gives [N, C, W, OH], then along W gives
+    // [N, C, OH, OW].
+    xla::XlaBuilder* builder = input.builder();
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+    xla::int64 rank = input_size.size();
+    xla::XlaOp pooled_h = ContractWithMatrix(
+        batch_input_info.batch_input, 2,
+        AdaptiveAvgPoolMatrix(input_size[rank - 2], output_size[0], type,
+                              builder),
+        0);
+    xla::XlaOp batch_result = ContractWithMatrix(
+        pooled_h, 2,
+        AdaptiveAvgPoolMatrix(input_size[rank - 1], output_size[1], type,
+                              builder),
+        0);
+    return RemoveTrivialBatch(/*batch=*/batch_result,
+                              /*original_rank=*/batch_input_info.original_rank,
+                              /*spatial_dim_count=*/2);
+  }
+  const auto kernel_size = AdaptiveAvgPoolKernelSize(input_size, output_size);
+  std::vector<std::pair<xla::int64, xla::int64>> no_padding(2);
   xla::XlaOp batch_result = xla::AvgPool(
       /*operand=*/batch_input_info.batch_input,
       /*kernel_size=*/kernel_size,
@@ -566,8 +754,8 @@ xla::XlaOp BuildAdaptiveAvgPool2d(xla::XlaOp input,
                             /*spatial_dim_count=*/2);
 }
 
-xla::XlaOp BuildAdaptiveAvgPool2dBackward(xla::XlaOp out_backprop,
-                                          xla::XlaOp input) {
+xla::XlaOp BuildAdaptiveAvgPool2dBackward(
+    xla::XlaOp out_backprop, absl::Span<const xla::int64> input_size) {
   BatchInput batch_out_backprop_info =
       CreateBatchInput(/*input=*/out_backprop, /*spatial_dim_count=*/2);
   const auto out_backprop_size =
@@ -576,12 +764,32 @@ xla::XlaOp BuildAdaptiveAvgPool2dBackward(xla::XlaOp out_backprop,
       << "Invalid rank of gradient output";
   std::vector<xla::int64> output_size{out_backprop_size[2],
                                       out_backprop_size[3]};
-  auto gradients_size = XlaHelpers::SizesOfXlaOp(input);
+  auto gradients_size = xla::util::ToVector<xla::int64>(input_size);
   XLA_CHECK(gradients_size.size() == 4 || gradients_size.size() == 3)
       << "Only 4D or 3D tensors supported";
   if (gradients_size.size() == 3) {
     gradients_size.insert(gradients_size.begin(), 1);
   }
+  if (!IsSupportedAdaptiveAvgPool2d(gradients_size, output_size)) {
+    // The transposed pooling: [N, C, OH, OW] along OH gives [N, C, OW, H],
+    // then along OW gives [N, C, H, W].
+    xla::XlaBuilder* builder = out_backprop.builder();
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(out_backprop);
+    xla::XlaOp grad_h = ContractWithMatrix(
+        batch_out_backprop_info.batch_input, 2,
+        AdaptiveAvgPoolMatrix(gradients_size[2], output_size[0], type,
+                              builder),
+        1);
+    xla::XlaOp batch_result = ContractWithMatrix(
+        grad_h, 2,
+        AdaptiveAvgPoolMatrix(gradients_size[3], output_size[1], type,
+                              builder),
+        1);
+    return RemoveTrivialBatch(
+        /*batch=*/batch_result,
+        /*original_rank=*/batch_out_backprop_info.original_rank,
+        /*spatial_dim_count=*/2);
+  }
   const auto kernel_size =
       AdaptiveAvgPoolKernelSize(gradients_size, output_size);
   std::vector<std::pair<xla::int64, xla::int64>> no_padding(2);
@@ -18,6 +18,7 @@
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/client/lib/pooling.h"
+#include "tensorflow/compiler/xla/client/padding.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
 
@@ -28,6 +29,13 @@ struct MaxPoolResult {
   xla::XlaOp indices;
 };
 
+// Computes the output shape of a pooling window sliding over the given input
+// shape, with a padding for each of its dimensions.
+xla::Shape GetPoolingOutputShape(
+    const xla::Shape& input_shape, absl::Span<const xla::int64> kernel_size,
+    absl::Span<const xla::int64> stride,
+    absl::Span<const std::pair<xla::int64, xla::int64>> padding);
+
 // Computes max pooling for the given input.
 MaxPoolResult BuildMaxPoolNd(xla::XlaOp input, xla::int64 spatial_dim_count,
                              absl::Span<const xla::int64> kernel_size,
@@ -43,6 +51,28 @@ xla::XlaOp BuildMaxPoolNdBackward(xla::XlaOp out_backprop, xla::XlaOp input,
                                   absl::Span<const xla::int64> padding,
                                   bool ceil_mode);
 
+// Whether the windows of a max pooling with full rank kernel_size and stride
+// tile its input, with the stride equal to the window size in every dimension.
+// The windows of such poolings do not overlap, and their indices and gradient
+// are computed with elementwise ops instead of a select-and-scatter.
+bool IsTilingMaxPool(absl::Span<const xla::int64> kernel_size,
+                     absl::Span<const xla::int64> stride);
+
+// Returns the linear index into input of the maximum of every window of a
+// tiling max pooling, whose result is pool_result.
+xla::XlaOp BuildTilingMaxPoolIndices(xla::XlaOp input, xla::XlaOp pool_result,
+                                     absl::Span<const xla::int64> kernel_size,
+                                     absl::Span<const xla::int64> stride,
+                                     xla::Padding padding);
+
+// Computes the gradient for a tiling max pooling, from the indices returned by
+// BuildTilingMaxPoolIndices().
+xla::XlaOp BuildTilingMaxPoolGrad(xla::XlaOp input, xla::XlaOp out_backprop,
+                                  xla::XlaOp indices,
+                                  absl::Span<const xla::int64> kernel_size,
+                                  absl::Span<const xla::int64> stride,
+                                  xla::Padding padding);
+
 // Computes average pooling for the given input.
 xla::XlaOp BuildAvgPoolNd(xla::XlaOp input, xla::int64 spatial_dim_count,
                           absl::Span<const xla::int64> kernel_size,
@@ -66,16 +96,20 @@ xla::XlaOp BuildMaxUnpoolNdBackward(xla::XlaOp grad_output, xla::XlaOp input,
                                     xla::XlaOp indices,
                                     absl::Span<const xla::int64> output_size);
 
-// Computes adaptive average pooling for the given input and output size.
+// Computes adaptive average pooling for the given input and output size. The
+// window of the output position j along a spatial dimension of size n pooled
+// to size m spans [floor(j * n / m), ceil((j + 1) * n / m)).
 xla::XlaOp BuildAdaptiveAvgPool2d(xla::XlaOp input,
                                   absl::Span<const xla::int64> output_size);
 
-// Computes the gradient for adaptive average pooling.
-xla::XlaOp BuildAdaptiveAvgPool2dBackward(xla::XlaOp out_backprop,
-                                          xla::XlaOp input);
+// Computes the gradient for adaptive average pooling, given the sizes of its
+// input.
+xla::XlaOp BuildAdaptiveAvgPool2dBackward(
+    xla::XlaOp out_backprop, absl::Span<const xla::int64> input_size);
 
-// Returns true if XLA lowering is supported for the given input and output size
-// combination.
+// Returns true if the output size evenly divides the input size, in which case
+// the adaptive average pooling is an average pooling. Otherwise it is computed
+// with a matmul by an averaging matrix along every spatial dimension.
 bool IsSupportedAdaptiveAvgPool2d(absl::Span<const xla::int64> input_size,
                                   absl::Span<const xla::int64> output_size);
 
@@ -14,10 +14,12 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/random.h"
 
+#include <cmath>
 #include <string>
 #include <tuple>
 
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/math.h"
 #include "tensorflow/compiler/xla/client/lib/prng.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
@@ -81,14 +83,38 @@ xla::Shape MakeRngShape(const xla::Shape& shape) {
 
 }  // namespace
 
+xla::RngOutput NormalDistribution(xla::XlaOp key, xla::XlaOp initial_state,
+                                  const xla::BitGeneratorTy& bit_generator,
+                                  const xla::Shape& shape) {
+  static const bool box_muller =
+      xla::sys_util::GetEnvBool("XLA_RNG_BOX_MULLER", false);
+  if (box_muller) {
+    return xla::NormalFloatingPointDistribution(key, initial_state,
+                                                bit_generator, shape);
+  }
+  xla::XlaBuilder* builder = key.builder();
+  xla::PrimitiveType type = shape.element_type();
+  // The uniform values lie in (-1, 1), as ErfInv(-1) is -inf.
+  double minval = type == xla::PrimitiveType::F64 ? std::nextafter(-1.0, 0.0)
+                                                  : std::nextafter(-1.0f, 0.0f);
+  xla::RngOutput output = xla::UniformFloatingPointDistribution(
+      key, initial_state, bit_generator,
+      xla::ConstantR0WithType(builder, type, minval), xla::One(builder, type),
+      shape);
+  output.value =
+      xla::ScalarLike(output.value, std::sqrt(2.0)) * xla::ErfInv(output.value);
+  return output;
+}
+
 xla::XlaOp RngUniform(xla::XlaOp seed, const xla::Shape& shape,
-                      xla::XlaOp minval, xla::XlaOp maxval) {
+                      xla::XlaOp minval, xla::XlaOp maxval,
+                      xla::uint64 stream) {
   xla::XlaOp rng_seed = MakeSeed(seed);
   xla::Shape rng_shape = MakeRngShape(shape);
   xla::XlaOp rng_minval = MakeUniformBoundaryValue(minval);
   xla::XlaOp rng_maxval = MakeUniformBoundaryValue(maxval);
   xla::XlaOp initial_state =
-      xla::Zero(rng_seed.builder(), xla::PrimitiveType::U64);
+      xla::ConstantR0<xla::uint64>(rng_seed.builder(), stream);
   switch (shape.element_type()) {
     case xla::PrimitiveType::BF16: {
       xla::XlaOp rng = xla::UniformFloatingPointDistribution(
@@ -134,41 +160,38 @@ xla::XlaOp RngUniform(xla::XlaOp seed, const xla::Shape& shape,
 }
 
 xla::XlaOp RngNormal(xla::XlaOp seed, const xla::Shape& shape, xla::XlaOp mean,
-                     xla::XlaOp std) {
+                     xla::XlaOp std, xla::uint64 stream) {
   xla::XlaOp rng_seed = MakeSeed(seed);
   xla::Shape rng_shape = MakeRngShape(shape);
   xla::XlaOp initial_state =
-      xla::Zero(rng_seed.builder(), xla::PrimitiveType::U64);
+      xla::ConstantR0<xla::uint64>(rng_seed.builder(), stream);
   switch (shape.element_type()) {
     case xla::PrimitiveType::BF16: {
       xla::XlaOp f32_mean = MaybeConvertTo(mean, xla::PrimitiveType::F32);
       xla::XlaOp f32_std = MaybeConvertTo(std, xla::PrimitiveType::F32);
-      xla::XlaOp rng =
-          xla::NormalFloatingPointDistribution(rng_seed, initial_state,
-                                               GetBitGenerator(), rng_shape)
-              .value;
+      xla::XlaOp rng = NormalDistribution(rng_seed, initial_state,
+                                          GetBitGenerator(), rng_shape)
+                           .value;
       return xla::ConvertElementType(f32_mean + rng * f32_std,
                                      xla::PrimitiveType::BF16);
     }
     case xla::PrimitiveType::F32:
     case xla::PrimitiveType::F64: {
-      xla::XlaOp rng =
-          xla::NormalFloatingPointDistribution(rng_seed, initial_state,
-                                               GetBitGenerator(), rng_shape)
-              .value;
+      xla::XlaOp rng = NormalDistribution(rng_seed, initial_state,
+                                          GetBitGenerator(), rng_shape)
+                           .value;
       return XlaHelpers::PromotedAdd(mean, XlaHelpers::PromotedMul(rng, std));
     }
     case xla::PrimitiveType::C64:
     case xla::PrimitiveType::C128: {
       xla::XlaOp k_seed = XlaHelpers::ScalarValue<xla::uint64>(
           17, XlaHelpers::TypeOfXlaOp(rng_seed), rng_seed.builder());
-      xla::XlaOp rng_real =
-          xla::NormalFloatingPointDistribution(rng_seed, initial_state,
+      xla::XlaOp rng_real = NormalDistribution(rng_seed, initial_state,
                                                GetBitGenerator(), rng_shape)
-              .value;
+                                .value;
       xla::XlaOp rng_imag =
-          xla::NormalFloatingPointDistribution(rng_seed * k_seed, initial_state,
-                                               GetBitGenerator(), rng_shape)
+          NormalDistribution(rng_seed * k_seed, initial_state,
+                             GetBitGenerator(), rng_shape)
               .value;
       xla::XlaOp rng = xla::Complex(rng_real, rng_imag);
       // Variance for normal distribution of the real and imaginary values is
@@ -16,14 +16,29 @@
 
 #pragma once
 
+#include "tensorflow/compiler/xla/client/lib/prng.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
 namespace swift_xla {
 
+// The bit generators are counter based: the seed is used as the key and the
+// stream as the initial counter, so ops sharing a seed but using different
+// streams draw independent values without depending on each other.
 xla::XlaOp RngUniform(xla::XlaOp seed, const xla::Shape& shape,
-                      xla::XlaOp minval, xla::XlaOp maxval);
+                      xla::XlaOp minval, xla::XlaOp maxval,
+                      xla::uint64 stream = 0);
 
 xla::XlaOp RngNormal(xla::XlaOp seed, const xla::Shape& shape, xla::XlaOp mean,
-                     xla::XlaOp std);
+                     xla::XlaOp std, xla::uint64 stream = 0);
+
+// Draws standard normal values of the F32 or F64 shape. Rather than pairing
+// the generated values for the Box-Muller transform, as
+// xla::NormalFloatingPointDistribution does, every uniform value is mapped
+// through the inverse normal CDF on its own, so the whole sampling is
+// elementwise and fuses with the bit generator and the consumers. Setting
+// XLA_RNG_BOX_MULLER switches back to the Box-Muller transform.
+xla::RngOutput NormalDistribution(xla::XlaOp key, xla::XlaOp initial_state,
+                                  const xla::BitGeneratorTy& bit_generator,
+                                  const xla::Shape& shape);
 
 }  // namespace swift_xla
@@ -0,0 +1,226 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/recompile_analyzer.h"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+// Reported differences beyond this count are only summarized.
+constexpr size_t kMaxReportedDifferences = 3;
+
+size_t StructureDistance(const GraphFingerprint& fp1,
+                         const GraphFingerprint& fp2) {
+  size_t common = std::min(fp1.op_kinds.size(), fp2.op_kinds.size());
+  size_t distance = std::max(fp1.op_kinds.size(), fp2.op_kinds.size()) - common;
+  for (size_t i = 0; i < common; ++i) {
+    if (fp1.op_kinds[i] != fp2.op_kinds[i]) {
+      ++distance;
+    }
+  }
+  return distance;
+}
+
+size_t ValueDistance(const GraphFingerprint& fp1,
+                     const GraphFingerprint& fp2) {
+  size_t distance = 0;
+  for (size_t i = 0; i < fp1.parameter_shapes.size(); ++i) {
+    if (!xla::ShapeUtil::Equal(fp1.parameter_shapes[i],
+                               fp2.parameter_shapes[i])) {
+      ++distance;
+    }
+  }
+  for (size_t i = 0; i < fp1.scalar_constants.size(); ++i) {
+    if (fp1.scalar_constants[i] != fp2.scalar_constants[i]) {
+      ++distance;
+    }
+  }
+  return distance;
+}
+
+bool SameStructure(const GraphFingerprint& fp1, const GraphFingerprint& fp2) {
+  return fp1.structure_hash == fp2.structure_hash &&
+         fp1.parameter_shapes.size() == fp2.parameter_shapes.size() &&
+         fp1.scalar_constants.size() == fp2.scalar_constants.size();
+}
+
+std::string ExplainStructureChange(const GraphFingerprint& previous,
+                                   const GraphFingerprint& current) {
+  XLA_COUNTER("RecompileStructureChange", 1);
+  std::stringstream ss;
+  ss << "structural change";
+  size_t common = std::min(previous.op_kinds.size(), current.op_kinds.size());
+  for (size_t i = 0; i < common; ++i) {
+    if (previous.op_kinds[i] != current.op_kinds[i]) {
+      ss << " at node " << i << ": " << previous.op_kinds[i] << " -> "
+         << current.op_kinds[i];
+      break;
+    }
+  }
+  ss << " (" << previous.op_kinds.size() << " -> " << current.op_kinds.size()
+     << " nodes";
+  if (previous.root_kinds != current.root_kinds) {
+    ss << ", roots " << absl::StrJoin(previous.root_kinds, ",") << " -> "
+       << absl::StrJoin(current.root_kinds, ",");
+  }
+  ss << ")";
+  return ss.str();
+}
+
+std::string ExplainValueChange(const GraphFingerprint& previous,
+                               const GraphFingerprint& current) {
+  std::vector<std::string> differences;
+  for (size_t i = 0; i < current.parameter_shapes.size(); ++i) {
+    const xla::Shape& previous_shape = previous.parameter_shapes[i];
+    const xla::Shape& current_shape = current.parameter_shapes[i];
+    if (xla::ShapeUtil::Equal(previous_shape, current_shape)) {
+      continue;
+    }
+    bool dtype_change =
+        previous_shape.element_type() != current_shape.element_type();
+    if (dtype_change) {
+      XLA_COUNTER("RecompileDtypeChange", 1);
+    } else {
+      XLA_COUNTER("RecompileShapeChange", 1);
+    }
+    differences.push_back(absl::StrCat(
+        dtype_change ? "dtype" : "shape", " change of parameter ", i, ": ",
+        xla::ShapeUtil::HumanString(previous_shape), " -> ",
+        xla::ShapeUtil::HumanString(current_shape)));
+  }
+  for (size_t i = 0; i < current.scalar_constants.size(); ++i) {
+    if (previous.scalar_constants[i] != current.scalar_constants[i]) {
+      XLA_COUNTER("RecompileScalarChange", 1);
+      differences.push_back(absl::StrCat("new scalar constant ",
+                                         current.scalar_constants[i], " (was ",
+                                         previous.scalar_constants[i], ")"));
+    }
+  }
+  if (differences.empty()) {
+    XLA_COUNTER("RecompileConfigChange", 1);
+    return "same IR graph, different sync configuration or parameter donation";
+  }
+  size_t reported = std::min(differences.size(), kMaxReportedDifferences);
+  std::string explanation = absl::StrJoin(
+      differences.begin(), differences.begin() + reported, "; ");
+  if (reported < differences.size()) {
+    absl::StrAppend(&explanation, "; and ", differences.size() - reported,
+                    " more differences");
+  }
+  return explanation;
+}
+
+}  // namespace
+
+GraphFingerprint CreateGraphFingerprint(
+    const xla::hash_t& hash, absl::Span<const ir::Node* const> roots,
+    absl::Span<const ir::Node* const> post_order,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters) {
+  GraphFingerprint fingerprint;
+  fingerprint.hash = hash;
+  fingerprint.structure_hash = xla::util::MHash(post_order.size());
+  std::unordered_map<const ir::Node*, size_t> node_index;
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const ir::Node* node = post_order[i];
+    node_index.emplace(node, i);
+    fingerprint.structure_hash = xla::util::HashCombine(
+        fingerprint.structure_hash, node->op().hash());
+    for (auto& output : node->operands()) {
+      auto it = node_index.find(output.node);
+      fingerprint.structure_hash = xla::util::HashCombine(
+          fingerprint.structure_hash,
+          xla::util::MHash(
+              it != node_index.end() ? static_cast<xla::int64>(it->second)
+                                     : -1,
+              static_cast<xla::int64>(output.index)));
+    }
+    fingerprint.op_kinds.push_back(node->op().ToString());
+    const ir::ops::Scalar* scalar = dynamic_cast<const ir::ops::Scalar*>(node);
+    if (scalar != nullptr) {
+      using ir::ops::operator<<;
+      std::stringstream ss;
+      ss << xla::ShapeUtil::HumanString(node->shape()) << "="
+         << scalar->value();
+      fingerprint.scalar_constants.push_back(ss.str());
+    }
+  }
+  for (const ir::Node* root : roots) {
+    fingerprint.root_kinds.push_back(root->op().ToString());
+  }
+  for (auto& parameter : parameters) {
+    fingerprint.parameter_shapes.push_back(parameter->shape());
+  }
+  return fingerprint;
+}
+
+RecompileAnalyzer* RecompileAnalyzer::Get() {
+  static RecompileAnalyzer* analyzer = new RecompileAnalyzer();
+  return analyzer;
+}
+
+RecompileAnalyzer::RecompileAnalyzer() {
+  if (xla::sys_util::GetEnvBool("XLA_EXPLAIN_RECOMPILES", false)) {
+    capacity_ = xla::sys_util::GetEnvInt("XLA_RECOMPILE_HISTORY_SIZE", 64);
+  }
+}
+
+std::string RecompileAnalyzer::Analyze(GraphFingerprint fingerprint) {
+  std::lock_guard<std::mutex> lock(lock_);
+  const GraphFingerprint* nearest = nullptr;
+  bool nearest_same_structure = false;
+  size_t nearest_distance = 0;
+  for (auto& previous : history_) {
+    bool same_structure = SameStructure(previous, fingerprint);
+    size_t distance = same_structure ? ValueDistance(previous, fingerprint)
+                                     : StructureDistance(previous, fingerprint);
+    // Graphs with the same structure are always nearer than the ones with a
+    // different one.
+    if (nearest == nullptr || (same_structure && !nearest_same_structure) ||
+        (same_structure == nearest_same_structure &&
+         distance < nearest_distance)) {
+      nearest = &previous;
+      nearest_same_structure = same_structure;
+      nearest_distance = distance;
+    }
+  }
+  std::stringstream ss;
+  ss << "Compiling IR graph hash " << xla::util::HexHash(fingerprint.hash);
+  if (nearest == nullptr) {
+    ss << ": no previously compiled graph";
+  } else {
+    ss << ", nearest to " << xla::util::HexHash(nearest->hash) << ": "
+       << (nearest_same_structure ? ExplainValueChange(*nearest, fingerprint)
+                                  : ExplainStructureChange(*nearest,
+                                                           fingerprint));
+  }
+  history_.push_back(std::move(fingerprint));
+  if (history_.size() > capacity_) {
+    history_.pop_front();
+  }
+  return ss.str();
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Compact description of a compiled IR graph, used to explain why a graph
+// missed the compilation cache.
+struct GraphFingerprint {
+  xla::hash_t hash;
+  // Hash of the op kinds and of the graph topology, which ignores the shapes
+  // and the values of the scalar constants.
+  xla::hash_t structure_hash;
+  // The op kinds of the graph nodes, in post order.
+  std::vector<std::string> op_kinds;
+  std::vector<std::string> root_kinds;
+  std::vector<xla::Shape> parameter_shapes;
+  // The scalars embedded into the graph as constants (see IsSpecialScalar()),
+  // in post order.
+  std::vector<std::string> scalar_constants;
+};
+
+GraphFingerprint CreateGraphFingerprint(
+    const xla::hash_t& hash, absl::Span<const ir::Node* const> roots,
+    absl::Span<const ir::Node* const> post_order,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters);
+
+// Keeps the fingerprints of the newest XLA_RECOMPILE_HISTORY_SIZE compiled
+// graphs, and explains new compilations as a difference from the nearest one.
+// Enabled with XLA_EXPLAIN_RECOMPILES.
+class RecompileAnalyzer {
+ public:
+  static RecompileAnalyzer* Get();
+
+  bool enabled() const { return capacity_ > 0; }
+
+  // Records the fingerprint of a graph about to be compiled, and returns a
+  // one line explanation of how it differs from the nearest graph compiled
+  // before.
+  std::string Analyze(GraphFingerprint fingerprint);
+
+ private:
+  RecompileAnalyzer();
+
+  std::mutex lock_;
+  size_t capacity_ = 0;
+  std::deque<GraphFingerprint> history_;
+};
+
+}  // namespace swift_xla
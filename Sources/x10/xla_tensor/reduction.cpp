@@ -15,6 +15,8 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 
 #include <cmath>
+#include <functional>
+#include <limits>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
@@ -22,6 +24,8 @@
 #include "tensorflow/compiler/xla/client/lib/arithmetic.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
 
 namespace swift_xla {
 namespace {
@@ -89,6 +93,28 @@ xla::XlaOp GetScaleValue(xla::XlaOp input, xla::XlaOp count,
   return input * scale;
 }
 
+// Merges two (count, mean, m2) Welford partial statistics, with the Chan et
+// al. formula.
+xla::XlaComputation MakeWelfordMergeComputation(xla::PrimitiveType type) {
+  xla::XlaBuilder builder("WelfordMerge");
+  xla::Shape scalar_shape = xla::ShapeUtil::MakeShape(type, {});
+  xla::XlaOp count_a = xla::Parameter(&builder, 0, scalar_shape, "count_a");
+  xla::XlaOp mean_a = xla::Parameter(&builder, 1, scalar_shape, "mean_a");
+  xla::XlaOp m2_a = xla::Parameter(&builder, 2, scalar_shape, "m2_a");
+  xla::XlaOp count_b = xla::Parameter(&builder, 3, scalar_shape, "count_b");
+  xla::XlaOp mean_b = xla::Parameter(&builder, 4, scalar_shape, "mean_b");
+  xla::XlaOp m2_b = xla::Parameter(&builder, 5, scalar_shape, "m2_b");
+  xla::XlaOp zero = xla::Zero(&builder, type);
+  xla::XlaOp count = count_a + count_b;
+  // Both sides can be empty, in the reduction initial values.
+  xla::XlaOp weight_b =
+      xla::Select(xla::Gt(count, zero), count_b / count, zero);
+  xla::XlaOp delta = mean_b - mean_a;
+  xla::Tuple(&builder, {count, mean_a + delta * weight_b,
+                        m2_a + m2_b + delta * delta * count_a * weight_b});
+  return ConsumeValue(builder.Build());
+}
+
 xla::XlaOp AverageValue(xla::XlaOp input, xla::XlaOp reduced) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
   xla::XlaOp num_elements =
@@ -136,6 +162,104 @@ xla::XlaOp CreateProduct(xla::XlaOp input,
   return result;
 }
 
+// Scans up to this size run as a single reduce window spanning the whole
+// dimension, which is O(n^2) work, but one fused operation.
+constexpr xla::int64 kMaxWindowScanSize = 128;
+// Scans up to this size use log-step doubling, which is O(n log n) work in
+// log(n) steps. Larger ones use the work efficient pairwise recursion.
+constexpr xla::int64 kMaxDoublingScanSize = 4096;
+
+// Applies the scalar reducer elementwise to the equally shaped operands.
+xla::XlaOp MapReducer(xla::XlaOp lhs, xla::XlaOp rhs,
+                      const xla::XlaComputation& reducer) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(lhs);
+  return xla::Map(lhs.builder(), {lhs, rhs}, reducer,
+                  xla::util::Iota<xla::int64>(shape.rank()));
+}
+
+// Shifts the input by count positions towards the end of dim, filling the
+// first positions with init.
+xla::XlaOp ShiftInDim(xla::XlaOp input, xla::XlaOp init, xla::int64 dim,
+                      xla::int64 count = 1) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PaddingConfig padding_config = xla::MakeNoPaddingConfig(shape.rank());
+  padding_config.mutable_dimensions(dim)->set_edge_padding_low(count);
+  padding_config.mutable_dimensions(dim)->set_edge_padding_high(-count);
+  return xla::Pad(input, init, padding_config);
+}
+
+// Hillis-Steele scan: after the step with shift s, every position holds the
+// reduction of the 2s positions ending at it.
+xla::XlaOp BuildDoublingScan(xla::XlaOp input, xla::int64 dim,
+                             const xla::XlaComputation& reducer,
+                             xla::XlaOp init) {
+  xla::int64 size = XlaHelpers::ShapeOfXlaOp(input).dimensions(dim);
+  xla::XlaOp result = input;
+  for (xla::int64 shift = 1; shift < size; shift *= 2) {
+    result = MapReducer(ShiftInDim(result, init, dim, shift), result, reducer);
+  }
+  return result;
+}
+
+xla::XlaOp BuildInclusiveScan(xla::XlaOp input, xla::int64 dim,
+                              const xla::XlaComputation& reducer,
+                              xla::XlaOp init) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::int64 size = input_shape.dimensions(dim);
+  if (size <= kMaxDoublingScanSize) {
+    return BuildDoublingScan(input, dim, reducer, init);
+  }
+  // Work efficient scan: reduce adjacent pairs, scan the pair reductions,
+  // which halves the size, and derive the scan of the even positions from the
+  // one of the pairs preceding them. The total work is O(n).
+  xla::XlaOp padded = input;
+  if (size % 2 != 0) {
+    xla::PaddingConfig padding_config =
+        xla::MakeNoPaddingConfig(input_shape.rank());
+    padding_config.mutable_dimensions(dim)->set_edge_padding_high(1);
+    padded = xla::Pad(input, init, padding_config);
+  }
+  xla::int64 half_size = (size + 1) / 2;
+  std::vector<xla::int64> half_dims(input_shape.dimensions().begin(),
+                                    input_shape.dimensions().end());
+  half_dims[dim] = half_size;
+  std::vector<xla::int64> pair_dims(half_dims);
+  pair_dims.insert(pair_dims.begin() + dim + 1, 2);
+  xla::XlaOp pairs = xla::Reshape(padded, pair_dims);
+  xla::XlaOp even =
+      xla::Reshape(xla::SliceInDim(pairs, 0, 1, 1, dim + 1), half_dims);
+  xla::XlaOp odd =
+      xla::Reshape(xla::SliceInDim(pairs, 1, 2, 1, dim + 1), half_dims);
+  xla::XlaOp odd_scan =
+      BuildInclusiveScan(MapReducer(even, odd, reducer), dim, reducer, init);
+  xla::XlaOp even_scan =
+      MapReducer(ShiftInDim(odd_scan, init, dim), even, reducer);
+  pair_dims[dim + 1] = 1;
+  xla::XlaOp result = xla::ConcatInDim(
+      input.builder(),
+      {xla::Reshape(even_scan, pair_dims), xla::Reshape(odd_scan, pair_dims)},
+      dim + 1);
+  half_dims[dim] = 2 * half_size;
+  return xla::SliceInDim(xla::Reshape(result, half_dims), 0, size, 1, dim);
+}
+
+// Reduces the indices of the size entries along dim with 32 bit integers when
+// they fit, which halves the index traffic of the reduction, and converts them
+// to the device type of Long afterwards.
+xla::XlaOp BuildArgReduce(
+    xla::XlaOp operand, xla::int64 dim, xla::int64 size,
+    const std::function<xla::XlaOp(xla::XlaOp, xla::PrimitiveType,
+                                   xla::int64)>& arg_reduce_fn) {
+  xla::PrimitiveType index_type =
+      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr);
+  if (index_type == xla::PrimitiveType::S32 ||
+      size > std::numeric_limits<xla::int32>::max()) {
+    return arg_reduce_fn(operand, index_type, dim);
+  }
+  return xla::ConvertElementType(
+      arg_reduce_fn(operand, xla::PrimitiveType::S32, dim), index_type);
+}
+
 }  // namespace
 
 xla::XlaOp BuildBinaryCrossEntropy(xla::XlaOp input, xla::XlaOp target,
@@ -270,6 +394,15 @@ xla::XlaOp BuildCumulativeComputation(xla::XlaOp input, xla::int64 dim,
                                       xla::XlaOp init, bool exclusive,
                                       bool reverse) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  if (input_shape.dimensions(dim) > kMaxWindowScanSize) {
+    xla::XlaOp result =
+        BuildInclusiveScan(reverse ? xla::Rev(input, {dim}) : input, dim,
+                           reducer, init);
+    if (exclusive) {
+      result = ShiftInDim(result, init, dim);
+    }
+    return reverse ? xla::Rev(result, {dim}) : result;
+  }
   std::vector<xla::int64> window_strides(input_shape.rank(), 1);
   std::vector<xla::int64> window_dims(input_shape.rank(), 1);
   window_dims[dim] = input_shape.dimensions(dim);
@@ -294,33 +427,66 @@ xla::XlaOp BuildMean(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
       .result;
 }
 
+xla::PrimitiveType MomentsComputeType(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+WelfordReduction BuildWelfordReduction(
+    xla::XlaOp input, absl::Span<const xla::int64> dimensions) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = MomentsComputeType(input_shape.element_type());
+  xla::XlaOp values = xla::ConvertElementType(input, type);
+  xla::Shape values_shape =
+      xla::ShapeUtil::ChangeElementType(input_shape, type);
+  xla::XlaBuilder* builder = input.builder();
+  // Every element is a partial statistic of a single value.
+  xla::XlaOp counts =
+      XlaHelpers::ScalarBroadcast<double>(1, values_shape, builder);
+  xla::XlaOp m2s =
+      XlaHelpers::ScalarBroadcast<double>(0, values_shape, builder);
+  xla::XlaOp zero = xla::Zero(builder, type);
+  xla::XlaOp stats =
+      xla::Reduce(builder, {counts, values, m2s}, {zero, zero, zero},
+                  MakeWelfordMergeComputation(type), dimensions);
+  return {xla::GetTupleElement(stats, 0), xla::GetTupleElement(stats, 1),
+          xla::GetTupleElement(stats, 2)};
+}
+
+MomentsResult BuildMoments(xla::XlaOp input,
+                           absl::Span<const xla::int64> dimensions,
+                           bool keep_reduced_dimensions, bool unbiased) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  WelfordReduction stats = BuildWelfordReduction(input, dimensions);
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(stats.count);
+  xla::XlaBuilder* builder = input.builder();
+  xla::XlaOp divisor =
+      unbiased ? stats.count - xla::One(builder, type) : stats.count;
+  // Like the mean of no values, the variance of too few is NaN.
+  xla::XlaOp variance =
+      xla::Select(xla::Gt(divisor, xla::Zero(builder, type)),
+                  stats.m2 / divisor, xla::NanValue(builder, type));
+  MomentsResult result = {stats.mean, variance};
+  if (keep_reduced_dimensions) {
+    std::vector<xla::int64> new_dimensions =
+        GetReductionInfo(input, input_shape, dimensions,
+                         /*keep_reduced_dimensions=*/true)
+            .new_dimensions;
+    result.mean = XlaHelpers::DynamicReshape(result.mean, new_dimensions);
+    result.variance =
+        XlaHelpers::DynamicReshape(result.variance, new_dimensions);
+  }
+  return result;
+}
+
 xla::XlaOp BuildStdDeviation(xla::XlaOp input,
                              absl::Span<const xla::int64> dimensions,
                              bool keep_reduced_dimensions, bool unbiased) {
-  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  xla::XlaOp mean =
-      BuildMean(input, dimensions, /*keep_reduced_dimensions*/ true);
-  xla::XlaOp bcast_mean =
-      xla::BroadcastInDim(mean, input_shape.dimensions(),
-                          xla::util::Iota<xla::int64>(input_shape.rank()));
-  xla::XlaOp input_mean_diff = input - bcast_mean;
-  xla::XlaOp squared_var = input_mean_diff * input_mean_diff;
-  xla::XlaOp squared_result;
-  if (unbiased) {
-    SummationResult sum_result = CreateSummation(
-        squared_var, dimensions, keep_reduced_dimensions, /*scale=*/false);
-    squared_result = GetScaleValue(
-        sum_result.result,
-        sum_result.rinfo.element_count.size -
-            xla::One(input.builder(), XlaHelpers::TypeOfXlaOp(
-                                          sum_result.rinfo.element_count.size)),
-        input_shape.element_type());
-  } else {
-    SummationResult sum_result = CreateSummation(
-        squared_var, dimensions, keep_reduced_dimensions, /*scale=*/true);
-    squared_result = sum_result.result;
-  }
-  return xla::Sqrt(squared_result);
+  MomentsResult moments =
+      BuildMoments(input, dimensions, keep_reduced_dimensions, unbiased);
+  return xla::ConvertElementType(xla::Sqrt(moments.variance),
+                                 XlaHelpers::TypeOfXlaOp(input));
 }
 
 xla::XlaOp BuildSum(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
@@ -392,9 +558,11 @@ xla::XlaOp BuildArgMax(xla::XlaOp input, xla::int64 dim, bool keepdim) {
                                          {xla::ShapeUtil::ElementsIn(*shape)});
     shape = &XlaHelpers::ShapeOfXlaOp(operand);
   }
-  xla::XlaOp result = xla::ArgMaxTwoPass(
-      operand,
-      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr), dim);
+  xla::XlaOp result = BuildArgReduce(
+      operand, dim, shape->dimensions(dim),
+      [](xla::XlaOp operand, xla::PrimitiveType type, xla::int64 dim) {
+        return xla::ArgMaxTwoPass(operand, type, dim);
+      });
   if (keepdim) {
     auto dimensions = xla::util::ToVector<xla::int64>(shape->dimensions());
     dimensions[dim] = 1;
@@ -412,9 +580,11 @@ xla::XlaOp BuildArgMin(xla::XlaOp input, xla::int64 dim, bool keepdim) {
                                          {xla::ShapeUtil::ElementsIn(*shape)});
     shape = &XlaHelpers::ShapeOfXlaOp(operand);
   }
-  xla::XlaOp result = xla::ArgMinTwoPass(
-      operand,
-      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr), dim);
+  xla::XlaOp result = BuildArgReduce(
+      operand, dim, shape->dimensions(dim),
+      [](xla::XlaOp operand, xla::PrimitiveType type, xla::int64 dim) {
+        return xla::ArgMinTwoPass(operand, type, dim);
+      });
   if (keepdim) {
     auto dimensions = xla::util::ToVector<xla::int64>(shape->dimensions());
     dimensions[dim] = 1;
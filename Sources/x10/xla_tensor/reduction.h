@@ -53,6 +53,38 @@ xla::XlaOp BuildMseLossBackward(xla::XlaOp grad_output, xla::XlaOp input,
 xla::XlaOp BuildMean(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
                      bool keep_reduced_dimensions);
 
+// The type the moments of inputs of the given type are accumulated in, F32 for
+// the reduced precision types.
+xla::PrimitiveType MomentsComputeType(xla::PrimitiveType type);
+
+// The partial statistics of a Welford reduction: the number of values, their
+// mean, and the sum of their squared deviations from the mean.
+struct WelfordReduction {
+  xla::XlaOp count;
+  xla::XlaOp mean;
+  xla::XlaOp m2;
+};
+
+// Reduces the dimensions of input listed in dimensions into Welford statistics,
+// with a single variadic reduce merging them with the Chan et al. formula. The
+// statistics are in the MomentsComputeType() of the input type.
+WelfordReduction BuildWelfordReduction(xla::XlaOp input,
+                                       absl::Span<const xla::int64> dimensions);
+
+struct MomentsResult {
+  xla::XlaOp mean;
+  xla::XlaOp variance;
+};
+
+// Builds the mean and the variance of input over the dimensions, in a single
+// pass with BuildWelfordReduction(), instead of a mean followed by a reduction
+// of the squared deviations. The results are in the MomentsComputeType() of
+// the input type. If unbiased is true, the variance is normalized by the number
+// of values minus one.
+MomentsResult BuildMoments(xla::XlaOp input,
+                           absl::Span<const xla::int64> dimensions,
+                           bool keep_reduced_dimensions, bool unbiased);
+
 xla::XlaOp BuildStdDeviation(xla::XlaOp input,
                              absl::Span<const xla::int64> dimensions,
                              bool keep_reduced_dimensions, bool unbiased);
@@ -0,0 +1,215 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a log recorded with XLA_REPLAY_LOG_FILE: every sync of the original
+// run executes its graph again, in order, with the recorded parameter shapes.
+// The graphs are compiled at the syncs which missed the compilation cache in
+// the original run, so the replay goes through the same recompiles. The
+// parameters are zero filled, unless their values were sampled with
+// XLA_REPLAY_LOG_SAMPLE_BYTES.
+//
+// Usage: x10_replay REPLAY_LOG
+// X10_REPLAY_DEVICE runs all the syncs on the given device, instead of the
+// recorded ones. When X10_REPLAY_TRACE_TIME is 1, the host waits for the
+// recorded tracing time before every sync, so that the overlap of tracing and
+// device execution is reproduced as well.
+// The report lists the totals, then per graph, tab separated, the sync and
+// compile counts, the graph size, the compile time and the mean execution and
+// recorded tracing times.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/replay_log.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+using DataPtr = xla::ComputationClient::DataPtr;
+
+struct GraphRecord {
+  size_t syncs = 0;
+  size_t compiles = 0;
+  size_t graph_size = 0;
+  double compile_seconds = 0;
+  double execute_seconds = 0;
+  double trace_seconds = 0;
+};
+
+xla::ComputationClient::Device* GetReplayDevice(const ReplaySync& sync) {
+  static const std::string device =
+      xla::sys_util::GetEnvString("X10_REPLAY_DEVICE", "");
+  return xla::GetX10Device(device.empty() ? sync.device : device);
+}
+
+// Compiles the computation without its parameter donations, since the zero
+// filled parameters are shared by the syncs.
+xla::ComputationClient::ComputationPtr Compile(
+    xla::ComputationClient::Device* device,
+    const xla::XlaComputation& computation) {
+  xla::HloModuleProto proto = computation.proto();
+  proto.clear_input_output_alias();
+  std::vector<xla::ComputationClient::CompileInstance> instances;
+  instances.emplace_back(xla::XlaComputation(std::move(proto)),
+                         /*output_shape=*/nullptr);
+  std::vector<xla::ComputationClient::ComputationPtr> computations =
+      device->Compile({device->name()}, std::move(instances));
+  XLA_CHECK_EQ(computations.size(), 1);
+  return computations.front();
+}
+
+DataPtr TransferParameter(xla::ComputationClient::Device* device,
+                          const xla::Shape& shape,
+                          const std::shared_ptr<xla::Literal>& value) {
+  XLA_CHECK(shape.IsArray()) << "Unsupported parameter shape " << shape;
+  xla::ComputationClient::TensorSource source(
+      shape, [value](const xla::ComputationClient::TensorSource& source,
+                     void* buffer, size_t size) {
+        if (value != nullptr) {
+          XLA_CHECK_EQ(value->size_bytes(), size);
+          std::memcpy(buffer, value->untyped_data(), size);
+        } else {
+          std::memset(buffer, 0, size);
+        }
+      });
+  return device->TransferToServer({source}).front();
+}
+
+// Returns the parameters of the sync. The zero filled ones are transferred
+// once per device and shape, and shared by all the syncs.
+std::vector<DataPtr> GetParameters(
+    xla::ComputationClient::Device* device, const ReplaySync& sync,
+    std::unordered_map<std::string, DataPtr>* zeros) {
+  std::vector<DataPtr> parameters;
+  for (size_t i = 0; i < sync.parameter_shapes.size(); ++i) {
+    const xla::Shape& shape = sync.parameter_shapes[i];
+    if (sync.parameter_values[i] != nullptr) {
+      parameters.push_back(
+          TransferParameter(device, shape, sync.parameter_values[i]));
+      continue;
+    }
+    std::string key = device->name() + "/" +
+                      xla::ShapeUtil::HumanStringWithLayout(shape);
+    auto it = zeros->find(key);
+    if (it == zeros->end()) {
+      it = zeros->emplace(key, TransferParameter(device, shape, nullptr)).first;
+    }
+    parameters.push_back(it->second);
+  }
+  return parameters;
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  XLA_CHECK_EQ(argc, 2) << "Usage: " << argv[0] << " REPLAY_LOG";
+  bool replay_trace_time =
+      xla::sys_util::GetEnvBool("X10_REPLAY_TRACE_TIME", false);
+  swift_xla::ReplayTrace trace = swift_xla::ReadReplayLog(argv[1]);
+  std::unordered_map<xla::hash_t, const xla::XlaComputation*,
+                     xla::util::HashReducer>
+      computations;
+  for (const auto& hash_computation : trace.computations) {
+    computations.emplace(hash_computation.first, &hash_computation.second);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  std::map<std::string, xla::ComputationClient::ComputationPtr> compiled;
+  std::map<std::string, swift_xla::GraphRecord> records;
+  std::unordered_map<std::string, swift_xla::DataPtr> zeros;
+  double trace_seconds = 0;
+  double compile_seconds = 0;
+  double execute_seconds = 0;
+  size_t compiles = 0;
+  Clock::time_point start = Clock::now();
+  for (const swift_xla::ReplaySync& sync : trace.syncs) {
+    xla::ComputationClient::Device* device =
+        swift_xla::GetReplayDevice(sync);
+    std::string graph = xla::util::HexHash(sync.hash);
+    swift_xla::GraphRecord& record = records[graph];
+    record.syncs += 1;
+    record.graph_size = sync.graph_size;
+    record.trace_seconds += 1e-9 * sync.trace_ns;
+    trace_seconds += 1e-9 * sync.trace_ns;
+    if (replay_trace_time) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(sync.trace_ns));
+    }
+
+    std::string key = device->name() + "/" + graph;
+    auto it = compiled.find(key);
+    if (sync.compiled || it == compiled.end()) {
+      auto computation_it = computations.find(sync.hash);
+      XLA_CHECK(computation_it != computations.end())
+          << "Missing graph " << graph << " in " << argv[1];
+      Clock::time_point compile_start = Clock::now();
+      compiled[key] =
+          swift_xla::Compile(device, *computation_it->second);
+      double seconds =
+          std::chrono::duration<double>(Clock::now() - compile_start).count();
+      record.compiles += 1;
+      record.compile_seconds += seconds;
+      compile_seconds += seconds;
+      compiles += 1;
+      it = compiled.find(key);
+    }
+
+    std::vector<swift_xla::DataPtr> parameters =
+        swift_xla::GetParameters(device, sync, &zeros);
+    device->WaitForTransfers(parameters);
+    Clock::time_point execute_start = Clock::now();
+    std::vector<swift_xla::DataPtr> results = device->ExecuteComputation(
+        *it->second, parameters,
+        xla::ComputationClient::ExecuteComputationOptions());
+    device->WaitForTransfers(results);
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - execute_start).count();
+    record.execute_seconds += seconds;
+    execute_seconds += seconds;
+  }
+  double total_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::printf("syncs\t%zu\ngraphs\t%zu\ncompiles\t%zu\n", trace.syncs.size(),
+              records.size(), compiles);
+  std::printf("recorded_trace_seconds\t%.6f\ncompile_seconds\t%.6f\n",
+              trace_seconds, compile_seconds);
+  std::printf("execute_seconds\t%.6f\ntotal_seconds\t%.6f\n\n",
+              execute_seconds, total_seconds);
+  std::printf(
+      "graph\tsyncs\tcompiles\tgraph_size\tcompile_seconds\texecute_us\t"
+      "trace_us\n");
+  for (const auto& graph_record : records) {
+    const swift_xla::GraphRecord& record = graph_record.second;
+    std::printf("%s\t%zu\t%zu\t%zu\t%.6f\t%.1f\t%.1f\n",
+                graph_record.first.c_str(), record.syncs, record.compiles,
+                record.graph_size, record.compile_seconds,
+                record.execute_seconds * 1e6 / record.syncs,
+                record.trace_seconds * 1e6 / record.syncs);
+  }
+  return 0;
+}
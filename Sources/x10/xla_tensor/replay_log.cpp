@@ -0,0 +1,189 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/replay_log.h"
+
+#include <cstdint>
+
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace swift_xla {
+namespace {
+
+// The log is this header followed by records, each starting with its kind.
+// Integers are stored in the host byte order, and strings are prefixed by
+// their 64 bit size.
+constexpr char kReplayLogHeader[] = "X10RPLY1";
+constexpr char kGraphRecord = 'G';
+constexpr char kSyncRecord = 'S';
+
+void WriteInt(std::ostream* stream, std::uint64_t value) {
+  stream->write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void WriteString(std::ostream* stream, const std::string& value) {
+  WriteInt(stream, value.size());
+  stream->write(value.data(), value.size());
+}
+
+void WriteHash(std::ostream* stream, const xla::hash_t& hash) {
+  WriteInt(stream, absl::Uint128High64(hash));
+  WriteInt(stream, absl::Uint128Low64(hash));
+}
+
+std::uint64_t ReadInt(std::istream* stream) {
+  std::uint64_t value = 0;
+  stream->read(reinterpret_cast<char*>(&value), sizeof(value));
+  XLA_CHECK(*stream) << "Truncated replay log";
+  return value;
+}
+
+std::string ReadString(std::istream* stream) {
+  std::string value(ReadInt(stream), '\0');
+  stream->read(&value[0], value.size());
+  XLA_CHECK(*stream) << "Truncated replay log";
+  return value;
+}
+
+xla::hash_t ReadHash(std::istream* stream) {
+  std::uint64_t high = ReadInt(stream);
+  return absl::MakeUint128(high, ReadInt(stream));
+}
+
+}  // namespace
+
+ReplayLog* ReplayLog::Get() {
+  static ReplayLog* replay_log = new ReplayLog();
+  return replay_log;
+}
+
+ReplayLog::ReplayLog() {
+  std::string path = xla::sys_util::GetEnvString("XLA_REPLAY_LOG_FILE", "");
+  if (path.empty()) {
+    return;
+  }
+  sample_bytes_ = xla::sys_util::GetEnvInt("XLA_REPLAY_LOG_SAMPLE_BYTES", 0);
+  file_ = std::make_unique<std::ofstream>(path, std::ios::binary);
+  XLA_CHECK(*file_) << "Unable to create replay log " << path;
+  file_->write(kReplayLogHeader, sizeof(kReplayLogHeader) - 1);
+  last_sync_ns_ = xla::sys_util::NowNs();
+  TF_LOG(INFO) << "Recording the syncs into the replay log " << path;
+}
+
+void ReplayLog::RecordSync(
+    const xla::hash_t& hash, const std::string& device,
+    const xla::XlaComputation& computation, bool compiled, size_t graph_size,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters) {
+  // Sampling waits for the parameters, so it happens before taking the lock,
+  // and is not accounted as tracing time of the next sync.
+  std::vector<std::string> values(parameters.size());
+  std::vector<xla::ComputationClient::DataPtr> sampled;
+  std::vector<size_t> sampled_indices;
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    const xla::Shape& shape = parameters[i]->shape();
+    if (shape.IsArray() &&
+        xla::ShapeUtil::ByteSizeOf(shape) <= sample_bytes_) {
+      sampled.push_back(parameters[i]);
+      sampled_indices.push_back(i);
+    }
+  }
+  if (!sampled.empty()) {
+    std::vector<xla::Literal> literals =
+        xla::ComputationClient::TransferFromServer(sampled);
+    for (size_t i = 0; i < literals.size(); ++i) {
+      xla::Literal literal = literals[i].Relayout(
+          xla::LayoutUtil::GetDefaultLayoutForShape(literals[i].shape()));
+      values[sampled_indices[i]] = literal.ToProto().SerializeAsString();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  xla::int64 now_ns = xla::sys_util::NowNs();
+  if (logged_graphs_.insert(hash).second) {
+    file_->put(kGraphRecord);
+    WriteHash(file_.get(), hash);
+    WriteString(file_.get(), computation.proto().SerializeAsString());
+  }
+  file_->put(kSyncRecord);
+  WriteHash(file_.get(), hash);
+  WriteString(file_.get(), device);
+  file_->put(compiled ? 1 : 0);
+  WriteInt(file_.get(), now_ns - last_sync_ns_);
+  WriteInt(file_.get(), graph_size);
+  WriteInt(file_.get(), parameters.size());
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    WriteString(file_.get(),
+                parameters[i]->shape().ToProto().SerializeAsString());
+    WriteString(file_.get(), values[i]);
+  }
+  // Keep the log usable when the process does not exit cleanly.
+  file_->flush();
+  last_sync_ns_ = xla::sys_util::NowNs();
+}
+
+ReplayTrace ReadReplayLog(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  XLA_CHECK(file) << "Unable to open " << path;
+  std::string header(sizeof(kReplayLogHeader) - 1, '\0');
+  file.read(&header[0], header.size());
+  XLA_CHECK(file && header == kReplayLogHeader)
+      << path << " is not a replay log";
+
+  ReplayTrace trace;
+  for (int kind = file.get(); kind != std::char_traits<char>::eof();
+       kind = file.get()) {
+    xla::hash_t hash = ReadHash(&file);
+    if (kind == kGraphRecord) {
+      xla::HloModuleProto proto;
+      XLA_CHECK(proto.ParseFromString(ReadString(&file)))
+          << "Corrupted graph record in " << path;
+      trace.computations.emplace_back(hash,
+                                      xla::XlaComputation(std::move(proto)));
+      continue;
+    }
+    XLA_CHECK_EQ(kind, kSyncRecord) << "Corrupted replay log " << path;
+    ReplaySync sync;
+    sync.hash = hash;
+    sync.device = ReadString(&file);
+    sync.compiled = file.get() != 0;
+    sync.trace_ns = ReadInt(&file);
+    sync.graph_size = ReadInt(&file);
+    size_t num_parameters = ReadInt(&file);
+    for (size_t i = 0; i < num_parameters; ++i) {
+      xla::ShapeProto shape_proto;
+      XLA_CHECK(shape_proto.ParseFromString(ReadString(&file)))
+          << "Corrupted sync record in " << path;
+      sync.parameter_shapes.emplace_back(shape_proto);
+      std::string value = ReadString(&file);
+      std::shared_ptr<xla::Literal> literal;
+      if (!value.empty()) {
+        xla::LiteralProto literal_proto;
+        XLA_CHECK(literal_proto.ParseFromString(value))
+            << "Corrupted sync record in " << path;
+        literal = std::make_shared<xla::Literal>(
+            xla::Literal::CreateFromProto(literal_proto).ValueOrDie());
+      }
+      sync.parameter_values.push_back(std::move(literal));
+    }
+    trace.syncs.push_back(std::move(sync));
+  }
+  return trace;
+}
+
+}  // namespace swift_xla
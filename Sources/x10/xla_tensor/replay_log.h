@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+
+// A sync of the replay log: the graph it ran, and what it ran it with.
+struct ReplaySync {
+  xla::hash_t hash;
+  std::string device;
+  // Whether the graph missed the compilation cache.
+  bool compiled = false;
+  // Host time since the previous sync, spent tracing the graph.
+  xla::int64 trace_ns = 0;
+  size_t graph_size = 0;
+  std::vector<xla::Shape> parameter_shapes;
+  // The sampled parameter values, empty for the parameters not sampled.
+  std::vector<std::shared_ptr<xla::Literal>> parameter_values;
+};
+
+// Content of a replay log, as read back by ReadReplayLog().
+struct ReplayTrace {
+  // The lowered computations of the graphs, each stored once.
+  std::vector<std::pair<xla::hash_t, xla::XlaComputation>> computations;
+  std::vector<ReplaySync> syncs;
+};
+
+// Records every sync of the process into the compact binary log named by
+// XLA_REPLAY_LOG_FILE: the lowered computation of every distinct graph, once,
+// and for every sync the graph hash, device, tracing time and parameter
+// shapes. Parameters of at most XLA_REPLAY_LOG_SAMPLE_BYTES bytes also get
+// their values recorded, which waits for them to be computed.
+class ReplayLog {
+ public:
+  static ReplayLog* Get();
+
+  bool enabled() const { return file_ != nullptr; }
+
+  void RecordSync(const xla::hash_t& hash, const std::string& device,
+                  const xla::XlaComputation& computation, bool compiled,
+                  size_t graph_size,
+                  absl::Span<const xla::ComputationClient::DataPtr> parameters);
+
+ private:
+  ReplayLog();
+
+  std::mutex lock_;
+  std::unique_ptr<std::ofstream> file_;
+  size_t sample_bytes_ = 0;
+  xla::int64 last_sync_ns_ = 0;
+  std::unordered_set<xla::hash_t, xla::util::HashReducer> logged_graphs_;
+};
+
+ReplayTrace ReadReplayLog(const std::string& path);
+
+}  // namespace swift_xla
@@ -14,12 +14,17 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/resize_ops.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/shape_builder.h"
+#include "tensorflow/compiler/xla/array2d.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
@@ -38,6 +43,119 @@ double ResizeFactor(const xla::Shape& input_shape,
          static_cast<double>(output_shape.dimensions(dim));
 }
 
+
+// Returns the [out_size, in_size] matrix mapping a dimension of in_size values
+// to its out_size bilinear interpolation.
+xla::XlaOp MakeInterpolationMatrix(xla::XlaBuilder* builder,
+                                   xla::int64 in_size, xla::int64 out_size,
+                                   bool align_corners,
+                                   bool half_pixel_centers,
+                                   xla::PrimitiveType type) {
+  double scale = align_corners && out_size > 1
+                     ? static_cast<double>(in_size - 1) / (out_size - 1)
+                     : static_cast<double>(in_size) / out_size;
+  xla::Array2D<float> weights(out_size, in_size, 0.0f);
+  for (xla::int64 i = 0; i < out_size; ++i) {
+    double in_pos = half_pixel_centers ? (i + 0.5) * scale - 0.5 : i * scale;
+    double in_floor = std::floor(in_pos);
+    xla::int64 lower = std::max<xla::int64>(in_floor, 0);
+    xla::int64 upper = std::min<xla::int64>(std::ceil(in_pos), in_size - 1);
+    float lerp = in_pos - in_floor;
+    weights(i, std::min(lower, in_size - 1)) += 1.0f - lerp;
+    weights(i, std::max<xla::int64>(upper, 0)) += lerp;
+  }
+  return xla::ConvertElementType(
+      xla::ConstantR2FromArray2D<float>(builder, weights), type);
+}
+
+// Multiplies the dim dimension of the input by the [out, in] weights.
+xla::XlaOp ResizeDimension(xla::XlaOp input, xla::XlaOp weights,
+                           xla::int64 dim) {
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(input).rank();
+  xla::DotDimensionNumbers dimension_numbers;
+  dimension_numbers.add_lhs_contracting_dimensions(1);
+  dimension_numbers.add_rhs_contracting_dimensions(dim);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  // The resized dimension comes first in the product, move it back in place.
+  xla::XlaOp product =
+      xla::DotGeneral(weights, input, dimension_numbers, &precision_config);
+  std::vector<xla::int64> permutation;
+  permutation.reserve(rank);
+  for (xla::int64 i = 0; i < rank; ++i) {
+    permutation.push_back(i < dim ? i + 1 : (i == dim ? 0 : i));
+  }
+  return xla::Transpose(product, permutation);
+}
+
+// Returns the number of multiply-adds of the separable resize, applying the
+// height first if height_first is true.
+xla::int64 SeparableResizeCost(xla::int64 in_h, xla::int64 in_w,
+                               xla::int64 out_h, xla::int64 out_w,
+                               bool height_first) {
+  return height_first ? out_h * in_h * in_w + out_h * in_w * out_w
+                      : in_h * in_w * out_w + out_h * in_h * out_w;
+}
+
+// The resize kernel is only available on TPU, where the matrix units make the
+// separable resize cheaper unless its products get much larger than the image.
+bool UseSeparableResize(xla::int64 separable_cost, xla::int64 out_h,
+                        xla::int64 out_w) {
+  static xla::int64 matmul_factor =
+      xla::sys_util::GetEnvInt("XLA_RESIZE_MATMUL_FACTOR", 512);
+  DeviceType hw_type = GetCurrentDevice().hw_type;
+  if (hw_type != DeviceType::TPU && hw_type != DeviceType::REMOTE_TPU) {
+    return true;
+  }
+  return separable_cost <= matmul_factor * out_h * out_w;
+}
+
+xla::XlaOp SeparableResize(xla::XlaOp input, xla::int64 h_dim,
+                           xla::int64 in_h, xla::int64 in_w, xla::int64 out_h,
+                           xla::int64 out_w, bool align_corners,
+                           bool half_pixel_centers, bool transposed) {
+  xla::XlaBuilder* builder = input.builder();
+  xla::PrimitiveType type = XlaHelpers::ShapeOfXlaOp(input).element_type();
+  // The backward pass resizes the gradient by the transposed matrices, whose
+  // shapes are that of the forward pass.
+  xla::XlaOp h_weights =
+      transposed ? MakeInterpolationMatrix(builder, out_h, in_h, align_corners,
+                                           half_pixel_centers, type)
+                 : MakeInterpolationMatrix(builder, in_h, out_h, align_corners,
+                                           half_pixel_centers, type);
+  xla::XlaOp w_weights =
+      transposed ? MakeInterpolationMatrix(builder, out_w, in_w, align_corners,
+                                           half_pixel_centers, type)
+                 : MakeInterpolationMatrix(builder, in_w, out_w, align_corners,
+                                           half_pixel_centers, type);
+  if (transposed) {
+    h_weights = xla::Transpose(h_weights, {1, 0});
+    w_weights = xla::Transpose(w_weights, {1, 0});
+  }
+  if (SeparableResizeCost(in_h, in_w, out_h, out_w, /*height_first=*/true) <=
+      SeparableResizeCost(in_h, in_w, out_h, out_w, /*height_first=*/false)) {
+    return ResizeDimension(ResizeDimension(input, h_weights, h_dim), w_weights,
+                           h_dim + 1);
+  }
+  return ResizeDimension(ResizeDimension(input, w_weights, h_dim + 1),
+                         h_weights, h_dim);
+}
+
+// Calls the kernel on an NHWC input, resizing the width first when split.
+xla::XlaOp CallResizeKernel(const std::string& target, xla::XlaOp input,
+                            const xla::Shape& output_shape,
+                            const std::string& backend_config, bool split) {
+  if (split) {
+    xla::Shape partial_shape = output_shape;
+    partial_shape.set_dimensions(
+        1, XlaHelpers::ShapeOfXlaOp(input).dimensions(1));
+    input = xla::CustomCall(input.builder(), target, {input}, partial_shape,
+                            backend_config);
+  }
+  return xla::CustomCall(input.builder(), target, {input}, output_shape,
+                         backend_config);
+}
+
 }  // namespace
 
 xla::Shape GetForwardOutputShape2d(const xla::Shape& input_shape,
@@ -113,5 +231,91 @@ xla::XlaOp LowerBackward2d(const std::string& target, xla::XlaOp input,
   return xla::Transpose(resised, inv_transpose_permute);
 }
 
+xla::XlaOp BuildResizeBilinear(xla::XlaOp input,
+                               absl::Span<const xla::int64> output_size,
+                               bool align_corners, bool half_pixel_centers,
+                               bool channels_last, ResizeLowering lowering) {
+  XLA_CHECK_EQ(output_size.size(), 2);
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  XLA_CHECK_EQ(input_shape.rank(), 4) << input_shape;
+  xla::int64 h_dim = channels_last ? 1 : 2;
+  xla::int64 in_h = input_shape.dimensions(h_dim);
+  xla::int64 in_w = input_shape.dimensions(h_dim + 1);
+  xla::int64 out_h = output_size[0];
+  xla::int64 out_w = output_size[1];
+  if (in_h == out_h && in_w == out_w) {
+    return input;
+  }
+  xla::int64 separable_cost = std::min(
+      SeparableResizeCost(in_h, in_w, out_h, out_w, /*height_first=*/true),
+      SeparableResizeCost(in_h, in_w, out_h, out_w, /*height_first=*/false));
+  bool separable = lowering == ResizeLowering::kCostModel
+                       ? UseSeparableResize(separable_cost, out_h, out_w)
+                       : lowering == ResizeLowering::kSeparable;
+  if (separable) {
+    return SeparableResize(input, h_dim, in_h, in_w, out_h, out_w,
+                           align_corners, half_pixel_centers,
+                           /*transposed=*/false);
+  }
+  xla::Shape output_shape = input_shape;
+  output_shape.set_dimensions(h_dim, out_h);
+  output_shape.set_dimensions(h_dim + 1, out_w);
+  if (!channels_last) {
+    return LowerForward2d("ResizeBilinear", input, output_shape, align_corners,
+                          half_pixel_centers);
+  }
+  return CallResizeKernel("ResizeBilinear", input, output_shape,
+                          GetBackendConfig(align_corners, half_pixel_centers),
+                          /*split=*/lowering == ResizeLowering::kSplitKernel);
+}
+
+xla::XlaOp BuildResizeBilinearBackward(xla::XlaOp grad_output,
+                                       absl::Span<const xla::int64> input_size,
+                                       bool align_corners,
+                                       bool half_pixel_centers,
+                                       bool channels_last,
+                                       ResizeLowering lowering) {
+  static double resize_split_factor =
+      xla::sys_util::GetEnvDouble("XLA_RESIZE_SPLIT_FACTOR", 3.0);
+  XLA_CHECK_EQ(input_size.size(), 2);
+  const xla::Shape& grad_shape = XlaHelpers::ShapeOfXlaOp(grad_output);
+  XLA_CHECK_EQ(grad_shape.rank(), 4) << grad_shape;
+  xla::int64 h_dim = channels_last ? 1 : 2;
+  xla::int64 in_h = input_size[0];
+  xla::int64 in_w = input_size[1];
+  xla::int64 out_h = grad_shape.dimensions(h_dim);
+  xla::int64 out_w = grad_shape.dimensions(h_dim + 1);
+  if (in_h == out_h && in_w == out_w) {
+    return grad_output;
+  }
+  // The transposed products cost the same as the forward ones, with the input
+  // and output sizes swapped.
+  xla::int64 separable_cost = std::min(
+      SeparableResizeCost(out_h, out_w, in_h, in_w, /*height_first=*/true),
+      SeparableResizeCost(out_h, out_w, in_h, in_w, /*height_first=*/false));
+  bool separable = lowering == ResizeLowering::kCostModel
+                       ? UseSeparableResize(separable_cost, out_h, out_w)
+                       : lowering == ResizeLowering::kSeparable;
+  if (separable) {
+    return SeparableResize(grad_output, h_dim, out_h, out_w, in_h, in_w,
+                           align_corners, half_pixel_centers,
+                           /*transposed=*/true);
+  }
+  xla::Shape output_shape = grad_shape;
+  output_shape.set_dimensions(h_dim, in_h);
+  output_shape.set_dimensions(h_dim + 1, in_w);
+  if (!channels_last) {
+    return LowerBackward2d("ResizeBilinearGrad", grad_output, output_shape,
+                           align_corners, half_pixel_centers);
+  }
+  bool split = lowering == ResizeLowering::kCostModel
+                   ? static_cast<double>(out_h) / in_h > resize_split_factor &&
+                         static_cast<double>(out_w) / in_w > resize_split_factor
+                   : lowering == ResizeLowering::kSplitKernel;
+  return CallResizeKernel("ResizeBilinearGrad", grad_output, output_shape,
+                          GetBackendConfig(align_corners, half_pixel_centers),
+                          split);
+}
+
 }  // namespace resize
 }  // namespace swift_xla
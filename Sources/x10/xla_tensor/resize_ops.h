@@ -38,5 +38,27 @@ xla::XlaOp LowerBackward2d(const std::string& target, xla::XlaOp input,
                            const xla::Shape& output_shape, bool align_corners,
                            bool half_pixel_centers);
 
+// The lowerings of the bilinear resizes: the cost model choice, the 1-D
+// interpolation matrix products, and the TPU resize kernel, in one call or,
+// split, one spatial dimension at a time. The kernel choices only apply to the
+// NHWC resizes.
+enum class ResizeLowering { kCostModel, kSeparable, kKernel, kSplitKernel };
+
+// Bilinear resize of the two spatial dimensions of an NHWC input, or of an NCHW
+// one when channels_last is false, with the tf.image.resize_bilinear semantics.
+// Lowers to two 1-D interpolation matrix products, or to the TPU resize kernel
+// when the cost model deems it cheaper.
+xla::XlaOp BuildResizeBilinear(
+    xla::XlaOp input, absl::Span<const xla::int64> output_size,
+    bool align_corners, bool half_pixel_centers, bool channels_last,
+    ResizeLowering lowering = ResizeLowering::kCostModel);
+
+// Returns the input gradient of BuildResizeBilinear(), for an input of the
+// given spatial size.
+xla::XlaOp BuildResizeBilinearBackward(
+    xla::XlaOp grad_output, absl::Span<const xla::int64> input_size,
+    bool align_corners, bool half_pixel_centers, bool channels_last,
+    ResizeLowering lowering = ResizeLowering::kCostModel);
+
 }  // namespace resize
 }  // namespace swift_xla
@@ -16,8 +16,55 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/lib/scatter.h"
+#include "tensorflow/compiler/xla/client/lib/comparators.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 
 namespace swift_xla {
+namespace {
+
+// Shifts input by shift positions along the major dimension, filling the
+// vacated positions with fill.
+xla::XlaOp ShiftRows(xla::XlaOp input, xla::int64 shift, xla::XlaOp fill) {
+  xla::int64 size = XlaHelpers::ShapeOfXlaOp(input).dimensions(0);
+  return xla::PadInDim(xla::SliceInDim(input, 0, size - shift, 1, 0), fill, 0,
+                       shift, 0);
+}
+
+// Returns, for every segment, the number of the sorted rank 1 indices which
+// are lower than it, or not greater than it if inclusive is true. Binary
+// searches all the segments at once, with one gather per step.
+xla::XlaOp CountSortedIndices(xla::XlaOp indices, xla::int64 num_segments,
+                              bool inclusive) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(indices);
+  xla::int64 size = shape.dimensions(0);
+  xla::PrimitiveType type = shape.element_type();
+  xla::XlaBuilder* builder = indices.builder();
+  xla::XlaOp segments = xla::Iota(builder, type, num_segments);
+  xla::XlaOp count = xla::Broadcast(xla::Zero(builder, type), {num_segments});
+  xla::XlaOp last = XlaHelpers::ScalarValue<xla::int64>(size - 1, type,
+                                                        builder);
+  xla::int64 step = 1;
+  while (2 * step <= size) {
+    step *= 2;
+  }
+  for (; step > 0; step /= 2) {
+    xla::XlaOp candidate =
+        count + XlaHelpers::ScalarValue<xla::int64>(step, type, builder);
+    xla::XlaOp position = xla::Clamp(
+        xla::Zero(builder, type), candidate - xla::One(builder, type), last);
+    xla::XlaOp value = xla::TorchIndexSelect(indices, position, 0);
+    xla::XlaOp found = xla::And(
+        inclusive ? xla::Le(value, segments) : xla::Lt(value, segments),
+        xla::Le(candidate, last + xla::One(builder, type)));
+    count = xla::Select(found, candidate, count);
+  }
+  return count;
+}
+
+}  // namespace
 
 xla::XlaOp UnsortedSegmentReduce(
     xla::XlaOp data, xla::XlaOp indices, xla::XlaOp init_value,
@@ -39,4 +86,87 @@ xla::XlaOp UnsortedSegmentReduce(
                                              combiner, data.builder()));
 }
 
+xla::XlaOp SortedSegmentReduce(
+    xla::XlaOp data, xla::XlaOp indices, xla::XlaOp init_value,
+    xla::int64 num_segments,
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combine) {
+  const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  xla::int64 num_indices = xla::ShapeUtil::ElementsIn(indices_shape);
+  std::vector<xla::int64> buffer_size(
+      data_shape.dimensions().begin() + indices_shape.rank(),
+      data_shape.dimensions().end());
+  buffer_size.insert(buffer_size.begin(), num_segments);
+  xla::XlaOp empty_segments = xla::Broadcast(init_value, buffer_size);
+  if (num_indices == 0) {
+    return empty_segments;
+  }
+  std::vector<xla::int64> row_sizes(buffer_size);
+  row_sizes[0] = num_indices;
+  xla::XlaOp rows = XlaHelpers::DynamicReshape(data, row_sizes);
+  xla::XlaOp row_indices = XlaHelpers::DynamicReshape(indices, {num_indices});
+  xla::XlaBuilder* builder = data.builder();
+
+  // Inclusive segmented scan by doubling: as the indices are sorted, a row
+  // and the row shift positions before it being in the same segment means all
+  // the rows in between are in it too.
+  xla::XlaOp no_index = xla::MinValue(builder, indices_shape.element_type());
+  for (xla::int64 shift = 1; shift < num_indices; shift *= 2) {
+    xla::XlaOp same_segment =
+        xla::Eq(row_indices, ShiftRows(row_indices, shift, no_index));
+    rows = xla::Select(xla::BroadcastInDim(same_segment, row_sizes, {0}),
+                       combine(rows, ShiftRows(rows, shift, init_value)),
+                       rows);
+  }
+  xla::XlaOp ends =
+      CountSortedIndices(row_indices, num_segments, /*inclusive=*/true);
+  xla::XlaOp starts =
+      CountSortedIndices(row_indices, num_segments, /*inclusive=*/false);
+  xla::PrimitiveType index_type = indices_shape.element_type();
+  xla::XlaOp last_rows = xla::Max(ends - xla::One(builder, index_type),
+                                  xla::Zero(builder, index_type));
+  return xla::Select(
+      xla::BroadcastInDim(xla::Eq(ends, starts), buffer_size, {0}),
+      empty_segments, xla::TorchIndexSelect(rows, last_rows, 0));
+}
+
+xla::XlaOp SegmentReduce(
+    xla::XlaOp data, xla::XlaOp indices, xla::XlaOp init_value,
+    xla::int64 num_segments,
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combine,
+    bool indices_are_sorted) {
+  static const xla::int64 sort_ratio =
+      xla::sys_util::GetEnvInt("XLA_SEGMENT_SORT_RATIO", 16);
+  if (indices_are_sorted) {
+    return SortedSegmentReduce(data, indices, init_value, num_segments,
+                               combine);
+  }
+  const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  xla::int64 num_indices = xla::ShapeUtil::ElementsIn(indices_shape);
+  if (sort_ratio <= 0 || num_indices < 2 ||
+      num_indices < sort_ratio * num_segments) {
+    return UnsortedSegmentReduce(data, indices, init_value, num_segments,
+                                 combine);
+  }
+  std::vector<xla::int64> row_sizes(
+      data_shape.dimensions().begin() + indices_shape.rank(),
+      data_shape.dimensions().end());
+  row_sizes.insert(row_sizes.begin(), num_indices);
+  xla::XlaBuilder* builder = data.builder();
+  xla::XlaOp row_indices = XlaHelpers::DynamicReshape(indices, {num_indices});
+  xla::XlaOp positions =
+      xla::Iota(builder, xla::PrimitiveType::S32, num_indices);
+  xla::XlaOp sorted = xla::Sort(
+      {row_indices, positions},
+      xla::CreateScalarLtComputation(
+          {indices_shape.element_type(), xla::PrimitiveType::S32}, builder),
+      0, /*is_stable=*/true);
+  xla::XlaOp sorted_rows =
+      xla::TorchIndexSelect(XlaHelpers::DynamicReshape(data, row_sizes),
+                            xla::GetTupleElement(sorted, 1), 0);
+  return SortedSegmentReduce(sorted_rows, xla::GetTupleElement(sorted, 0),
+                             init_value, num_segments, combine);
+}
+
 }  // namespace swift_xla
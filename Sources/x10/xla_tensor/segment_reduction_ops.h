@@ -26,6 +26,24 @@ xla::XlaOp UnsortedSegmentReduce(
     xla::int64 num_segments,
     const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combine);
 
+// Same as UnsortedSegmentReduce(), for indices sorted in increasing order.
+// Every segment gets reduced by a segmented scan and read at its last index,
+// so there are no colliding updates.
+xla::XlaOp SortedSegmentReduce(
+    xla::XlaOp data, xla::XlaOp indices, xla::XlaOp init_value,
+    xla::int64 num_segments,
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combine);
+
+// Reduces with SortedSegmentReduce() if the indices are sorted, or if there
+// are at least XLA_SEGMENT_SORT_RATIO indices per segment, after sorting them,
+// as the colliding updates of the scatter serialize. Uses
+// UnsortedSegmentReduce() otherwise.
+xla::XlaOp SegmentReduce(
+    xla::XlaOp data, xla::XlaOp indices, xla::XlaOp init_value,
+    xla::int64 num_segments,
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combine,
+    bool indices_are_sorted);
+
 }  // namespace swift_xla
 
 #endif  // X10_XLA_TENSOR_SEGMENT_REDUCTION_OPS_H_
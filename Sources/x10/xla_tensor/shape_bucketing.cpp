@@ -0,0 +1,176 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/shape_bucketing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+class BucketingPolicy {
+ public:
+  static BucketingPolicy* Get() {
+    static BucketingPolicy* policy = new BucketingPolicy();
+    return policy;
+  }
+
+  bool empty() const { return buckets_.empty(); }
+
+  std::vector<xla::int64> Apply(absl::Span<const xla::int64> dimensions) {
+    std::vector<xla::int64> bucketed(dimensions.begin(), dimensions.end());
+    xla::int64 rank = dimensions.size();
+    for (auto& dim_buckets : buckets_) {
+      xla::int64 dim = dim_buckets.first < 0 ? dim_buckets.first + rank
+                                             : dim_buckets.first;
+      if (dim >= 0 && dim < rank) {
+        bucketed[dim] = BucketSize(dimensions[dim], dim_buckets.second);
+      }
+    }
+    if (!std::equal(bucketed.begin(), bucketed.end(), dimensions.begin())) {
+      RecordBucketing(dimensions, bucketed);
+    }
+    return bucketed;
+  }
+
+ private:
+  BucketingPolicy() {
+    std::string buckets_env =
+        xla::sys_util::GetEnvString("XLA_SHAPE_BUCKETS", "");
+    if (buckets_env.empty()) {
+      return;
+    }
+    std::vector<std::string> entries = absl::StrSplit(buckets_env, ';');
+    for (const auto& entry : entries) {
+      std::vector<std::string> parts = absl::StrSplit(entry, '=');
+      XLA_CHECK_EQ(parts.size(), 2) << entry;
+      std::vector<xla::int64>& sizes = buckets_[std::stol(parts[0])];
+      std::vector<std::string> sizes_str = absl::StrSplit(parts[1], ',');
+      for (const auto& size_str : sizes_str) {
+        sizes.push_back(std::stol(size_str));
+        XLA_CHECK_GT(sizes.back(), 0) << entry;
+      }
+      XLA_CHECK(std::is_sorted(sizes.begin(), sizes.end())) << entry;
+      TF_VLOG(2) << "Registering shape buckets " << parts[1]
+                 << " for dimension " << parts[0];
+    }
+  }
+
+  static xla::int64 BucketSize(xla::int64 size,
+                               const std::vector<xla::int64>& sizes) {
+    auto it = std::lower_bound(sizes.begin(), sizes.end(), size);
+    if (it != sizes.end()) {
+      return *it;
+    }
+    return (size + sizes.back() - 1) / sizes.back() * sizes.back();
+  }
+
+  // Tracks how many distinct shapes have been folded into the same bucketed
+  // shape. Every shape folded into an already seen bucket is one compilation
+  // which the cache did not have to perform.
+  void RecordBucketing(absl::Span<const xla::int64> dimensions,
+                       absl::Span<const xla::int64> bucketed) {
+    XLA_COUNTER("BucketPaddedElements",
+                xla::util::Multiply<xla::int64>(bucketed) -
+                    xla::util::Multiply<xla::int64>(dimensions));
+    std::lock_guard<std::mutex> lock(lock_);
+    auto& sources =
+        bucket_sources_[std::vector<xla::int64>(bucketed.begin(),
+                                                bucketed.end())];
+    if (sources.insert(xla::util::HashReduce(xla::util::MHash(dimensions)))
+            .second &&
+        sources.size() > 1) {
+      XLA_COUNTER("BucketFoldedShapes", 1);
+    }
+  }
+
+  std::map<xla::int64, std::vector<xla::int64>> buckets_;
+  std::mutex lock_;
+  std::map<std::vector<xla::int64>, absl::flat_hash_set<size_t>>
+      bucket_sources_;
+};
+
+void PadCopy(const char* src, absl::Span<const xla::int64> src_dimensions,
+             const std::vector<xla::int64>& src_strides, char* dst,
+             absl::Span<const xla::int64> dst_dimensions,
+             const std::vector<xla::int64>& dst_strides, size_t dim,
+             size_t element_size) {
+  if (dim + 1 == src_dimensions.size()) {
+    std::memcpy(dst, src, src_dimensions[dim] * element_size);
+    return;
+  }
+  for (xla::int64 i = 0; i < src_dimensions[dim]; ++i) {
+    PadCopy(src + i * src_strides[dim] * element_size, src_dimensions,
+            src_strides, dst + i * dst_strides[dim] * element_size,
+            dst_dimensions, dst_strides, dim + 1, element_size);
+  }
+}
+
+std::vector<xla::int64> RowMajorStrides(
+    absl::Span<const xla::int64> dimensions) {
+  std::vector<xla::int64> strides(dimensions.size(), 1);
+  for (ssize_t i = static_cast<ssize_t>(dimensions.size()) - 2; i >= 0; --i) {
+    strides[i] = strides[i + 1] * dimensions[i + 1];
+  }
+  return strides;
+}
+
+}  // namespace
+
+std::vector<xla::int64> GetBucketedDimensions(
+    absl::Span<const xla::int64> dimensions) {
+  BucketingPolicy* policy = BucketingPolicy::Get();
+  if (policy->empty()) {
+    return std::vector<xla::int64>(dimensions.begin(), dimensions.end());
+  }
+  return policy->Apply(dimensions);
+}
+
+void PadToDimensions(const void* src,
+                     absl::Span<const xla::int64> src_dimensions, void* dst,
+                     absl::Span<const xla::int64> dst_dimensions,
+                     size_t element_size) {
+  XLA_CHECK_EQ(src_dimensions.size(), dst_dimensions.size());
+  std::memset(dst, 0,
+              xla::util::Multiply<xla::int64>(dst_dimensions) * element_size);
+  if (src_dimensions.empty()) {
+    std::memcpy(dst, src, element_size);
+    return;
+  }
+  for (size_t i = 0; i < src_dimensions.size(); ++i) {
+    XLA_CHECK_LE(src_dimensions[i], dst_dimensions[i]);
+    if (src_dimensions[i] == 0) {
+      return;
+    }
+  }
+  PadCopy(static_cast<const char*>(src), src_dimensions,
+          RowMajorStrides(src_dimensions), static_cast<char*>(dst),
+          dst_dimensions, RowMajorStrides(dst_dimensions), /*dim=*/0,
+          element_size);
+}
+
+}  // namespace swift_xla
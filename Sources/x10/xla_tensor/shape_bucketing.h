@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace swift_xla {
+
+// Returns the dimensions padded up to the bucket boundaries configured with
+// XLA_SHAPE_BUCKETS, or the input dimensions if no bucket applies. The format
+// of the variable is DIM=SIZE,...;DIM=SIZE,... where DIM is a dimension index
+// (negative values count from the innermost dimension) and the SIZE list holds
+// the ascending bucket boundaries for it. Sizes above the largest boundary are
+// padded to a multiple of it.
+std::vector<xla::int64> GetBucketedDimensions(
+    absl::Span<const xla::int64> dimensions);
+
+// Copies the row-major src array into dst, which must have room for
+// dst_dimensions elements, filling the area outside of src_dimensions with
+// zeros. Each dst_dimensions entry must be greater or equal than the src one.
+void PadToDimensions(const void* src,
+                     absl::Span<const xla::int64> src_dimensions, void* dst,
+                     absl::Span<const xla::int64> dst_dimensions,
+                     size_t element_size);
+
+}  // namespace swift_xla
@@ -0,0 +1,173 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/sharding_util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+bool IsTiled(const xla::OpSharding& sharding) {
+  return sharding.type() == xla::OpSharding::OTHER;
+}
+
+// Returns the coordinates, within the tile assignment, of the tile held by the
+// partition.
+std::vector<xla::int64> GetTileIndex(const xla::OpSharding& sharding,
+                                     xla::int64 partition) {
+  const auto& devices = sharding.tile_assignment_devices();
+  auto it = std::find(devices.begin(), devices.end(), partition);
+  XLA_CHECK(it != devices.end())
+      << "Partition " << partition << " holds no tile of the sharding";
+  xla::int64 position = it - devices.begin();
+  std::vector<xla::int64> tile_dims(
+      sharding.tile_assignment_dimensions().begin(),
+      sharding.tile_assignment_dimensions().end());
+  std::vector<xla::int64> tile_index(tile_dims.size());
+  for (size_t i = tile_dims.size(); i > 0; --i) {
+    tile_index[i - 1] = position % tile_dims[i - 1];
+    position /= tile_dims[i - 1];
+  }
+  return tile_index;
+}
+
+}  // namespace
+
+xla::int64 GetNumPartitions() {
+  return std::max<xla::int64>(
+      xla::ComputationClient::GetReplicationDevices().size(), 1);
+}
+
+xla::int64 GetPartitionIndex(const Device& device) {
+  const std::vector<std::string>& devices =
+      xla::ComputationClient::GetReplicationDevices();
+  if (devices.empty()) {
+    return 0;
+  }
+  auto it = std::find(devices.begin(), devices.end(), device.ToString());
+  XLA_CHECK(it != devices.end())
+      << "Device " << device << " is not one of the replication devices";
+  return it - devices.begin();
+}
+
+xla::OpSharding CreateTiledSharding(absl::Span<const xla::int64> shard_counts) {
+  xla::int64 num_shards = xla::util::Multiply<xla::int64>(shard_counts);
+  if (num_shards == 1) {
+    return CreateReplicatedSharding();
+  }
+  XLA_CHECK_EQ(num_shards, GetNumPartitions())
+      << "The shard counts must multiply to the number of partitions";
+  xla::OpSharding sharding;
+  sharding.set_type(xla::OpSharding::OTHER);
+  for (xla::int64 count : shard_counts) {
+    XLA_CHECK_GT(count, 0);
+    sharding.add_tile_assignment_dimensions(count);
+  }
+  for (xla::int64 i = 0; i < num_shards; ++i) {
+    sharding.add_tile_assignment_devices(i);
+  }
+  return sharding;
+}
+
+xla::OpSharding CreateReplicatedSharding() {
+  xla::OpSharding sharding;
+  sharding.set_type(xla::OpSharding::REPLICATED);
+  return sharding;
+}
+
+xla::Shape GetShardShape(const xla::Shape& shape,
+                         const xla::OpSharding& sharding) {
+  if (!IsTiled(sharding)) {
+    return shape;
+  }
+  XLA_CHECK_EQ(sharding.tile_assignment_dimensions_size(), shape.rank());
+  xla::Shape shard_shape(shape);
+  for (xla::int64 i = 0; i < shape.rank(); ++i) {
+    xla::int64 count = sharding.tile_assignment_dimensions(i);
+    XLA_CHECK_EQ(shape.dimensions(i) % count, 0)
+        << "Dimension " << i << " of " << shape << " cannot be split into "
+        << count << " shards";
+    shard_shape.set_dimensions(i, shape.dimensions(i) / count);
+  }
+  return shard_shape;
+}
+
+at::Tensor GetShardTensor(const at::Tensor& tensor,
+                          const xla::OpSharding& sharding,
+                          xla::int64 partition) {
+  if (!IsTiled(sharding) || tensor.rank() == 0) {
+    return tensor;
+  }
+  XLA_CHECK_EQ(sharding.tile_assignment_dimensions_size(), tensor.rank());
+  std::vector<xla::int64> tile_index = GetTileIndex(sharding, partition);
+  std::vector<xla::int64> sizes(tensor.shape().begin(), tensor.shape().end());
+  std::vector<xla::int64> shard_sizes(sizes.size());
+  std::vector<xla::int64> offsets(sizes.size());
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    xla::int64 count = sharding.tile_assignment_dimensions(i);
+    XLA_CHECK_EQ(sizes[i] % count, 0)
+        << "Dimension " << i << " of size " << sizes[i]
+        << " cannot be split into " << count << " shards";
+    shard_sizes[i] = sizes[i] / count;
+    offsets[i] = tile_index[i] * shard_sizes[i];
+  }
+  std::vector<xla::int64> strides = ComputeArrayStrides(sizes);
+  size_t element_size = at::internal::GetSizeof(tensor.scalar_type());
+  // The shard is copied one row of its minor dimension at a time.
+  size_t row_bytes = shard_sizes.back() * element_size;
+  xla::int64 num_rows =
+      xla::util::Multiply<xla::int64>(shard_sizes) / shard_sizes.back();
+  const char* src = static_cast<const char*>(tensor.buffer().raw_data());
+  auto copy_rows = [&](char* dest) {
+    std::vector<xla::int64> row_index(sizes.size(), 0);
+    for (xla::int64 row = 0; row < num_rows; ++row) {
+      xla::int64 src_offset = 0;
+      for (size_t i = 0; i < sizes.size(); ++i) {
+        src_offset += (offsets[i] + row_index[i]) * strides[i];
+      }
+      std::memcpy(dest + row * row_bytes, src + src_offset * element_size,
+                  row_bytes);
+      for (size_t i = sizes.size() - 1; i > 0; --i) {
+        if (++row_index[i - 1] < shard_sizes[i - 1]) {
+          break;
+        }
+        row_index[i - 1] = 0;
+      }
+    }
+  };
+  std::vector<int64_t> shard_shape(shard_sizes.begin(), shard_sizes.end());
+  size_t num_elements = num_rows * shard_sizes.back();
+  switch (tensor.scalar_type()) {
+#define SHARD_CASE(name, aten_name, DType)                        \
+  case at::ScalarType::aten_name: {                               \
+    std::unique_ptr<DType[]> data(new DType[num_elements]);       \
+    copy_rows(reinterpret_cast<char*>(data.get()));               \
+    return at::Tensor(std::move(data), std::move(shard_shape));   \
+  }
+    LIST_SCALAR_TYPES(SHARD_CASE)
+#undef SHARD_CASE
+  }
+  XLA_ERROR() << "Unsupported scalar type: " << tensor.scalar_type();
+}
+
+}  // namespace swift_xla
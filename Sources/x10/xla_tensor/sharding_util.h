@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace swift_xla {
+
+// SPMD partitioning of the tensors too large for a single device. The graphs
+// holding sharding annotations get compiled with the XLA SPMD partitioner into
+// one program, run by every replication device as one of its partitions, and
+// the device data of a sharded tensor only holds the shard of its partition.
+
+// Returns the number of partitions, which are the replication devices.
+xla::int64 GetNumPartitions();
+
+// Returns the index of the device among the partitions.
+xla::int64 GetPartitionIndex(const Device& device);
+
+// Returns the sharding splitting dimension i of a tensor into shard_counts[i]
+// shards, whose tiles are assigned to the partitions in row-major order. The
+// sharding is replicated if all the counts are one.
+xla::OpSharding CreateTiledSharding(absl::Span<const xla::int64> shard_counts);
+
+xla::OpSharding CreateReplicatedSharding();
+
+// Returns the shape of the shards of a tensor of the given shape.
+xla::Shape GetShardShape(const xla::Shape& shape,
+                         const xla::OpSharding& sharding);
+
+// Returns the shard of the host tensor which the given partition holds.
+at::Tensor GetShardTensor(const at::Tensor& tensor,
+                          const xla::OpSharding& sharding,
+                          xla::int64 partition);
+
+}  // namespace swift_xla
@@ -0,0 +1,460 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// End-to-end step time benchmarks. Representative models are traced through
+// the C API the Swift bindings use, and every step is synced like
+// LazyTensorBarrier() does. For each model the JSON report on stdout has:
+// - the cold start: the first step, including the lowering and compilation;
+// - the warm start: a step after the in-memory computation cache is cleared,
+//   which is served by the persistent cache if XLA_PERSISTENT_CACHE_DIR is
+//   set, and recompiled from scratch otherwise;
+// - the steady state: the percentiles of the step times, recorded as a metric.
+//
+// Usage: x10_step_benchmark [substring of the model names to run]
+// X10_STEP_BENCHMARK_STEPS sets the number of steady state steps, and
+// X10_STEP_BENCHMARK_LABEL a label copied to the report (ie, the commit).
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "swift_bindings/device_wrapper.h"
+#include "swift_bindings/xla_tensor_wrapper.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+
+// Gives the step benchmarks access to the computation cache of XLATensor.
+class XLATensorStepBenchmarks {
+ public:
+  static void ClearComputationCache() {
+    XLATensor::GetComputationCache()->Clear();
+  }
+};
+
+namespace {
+
+using Tensor = std::shared_ptr<XLATensor>;
+
+Tensor Wrap(XLATensor* tensor) { return Tensor(tensor, destroyTensor); }
+
+Int64ArrayRef ArrayRef(const std::vector<int64_t>& values) {
+  return Int64ArrayRef{values.data(), values.size()};
+}
+
+// The model parameters and inputs are random, their values do not matter.
+Tensor Rand(const std::vector<int64_t>& sizes) {
+  static int64_t seed = 0;
+  return Wrap(XLATensor_rand(ArrayRef(sizes), seed++));
+}
+
+Tensor Scalar(double value, const Device& device) {
+  XLAScalar scalar;
+  scalar.tag = XLAScalarTypeTag_d;
+  scalar.value.d = value;
+  return Wrap(XLATensor_makeScalar(scalar, XLATensorScalarType_Float,
+                                   ConvertDevice(device)));
+}
+
+Tensor Add(const Tensor& a, const Tensor& b) {
+  return Wrap(XLATensor_add(a.get(), b.get()));
+}
+
+Tensor Sub(const Tensor& a, const Tensor& b) {
+  return Wrap(XLATensor_sub(a.get(), b.get()));
+}
+
+Tensor Mul(const Tensor& a, const Tensor& b) {
+  return Wrap(XLATensor_mul(a.get(), b.get()));
+}
+
+Tensor MatMul(const Tensor& a, const Tensor& b) {
+  return Wrap(XLATensor_matmul(a.get(), b.get()));
+}
+
+Tensor Relu(const Tensor& a) { return Wrap(XLATensor_relu(a.get())); }
+
+Tensor Reshape(const Tensor& a, const std::vector<int64_t>& sizes) {
+  return Wrap(XLATensor_resize_value(a.get(), ArrayRef(sizes)));
+}
+
+Tensor Permute(const Tensor& a, const std::vector<int64_t>& dims) {
+  return Wrap(XLATensor_permute_value(a.get(), ArrayRef(dims)));
+}
+
+Tensor Mean(const Tensor& a, const std::vector<int64_t>& dims,
+            bool keep_reduced_dimensions) {
+  return Wrap(
+      XLATensor_mean(a.get(), ArrayRef(dims), keep_reduced_dimensions));
+}
+
+// Normalizes the input over dims, without the scale and offset.
+Tensor Normalize(const Tensor& input, const std::vector<int64_t>& dims,
+                 const Tensor& epsilon) {
+  Tensor centered = Sub(input, Mean(input, dims, true));
+  Tensor variance = Mean(Mul(centered, centered), dims, true);
+  return Mul(centered, Wrap(XLATensor_rsqrt(Add(variance, epsilon).get())));
+}
+
+Tensor Conv3x3(const Tensor& input, const Tensor& filter) {
+  std::vector<int64_t> ones = {1, 1, 1, 1};
+  return Wrap(XLATensor_tf_Conv(input.get(), filter.get(),
+                                /*depthwise=*/false, ArrayRef(ones),
+                                TFPadding_SAME, ArrayRef({}),
+                                TFDataFormat_NHWC, ArrayRef(ones)));
+}
+
+// A model traced one training step at a time. The step holds the forward pass
+// and a loss scaled update of every parameter, which stands in for the backward
+// pass and optimizer: it keeps the whole forward pass in the step graph, and
+// the parameters on the device from a step to the next.
+class Model {
+ public:
+  explicit Model(const Device& device)
+      : learning_rate_(Scalar(1e-3, device)) {}
+
+  virtual ~Model() = default;
+
+  void Step() {
+    Tensor loss = Forward();
+    Tensor scale = Mul(learning_rate_, loss);
+    for (Tensor& parameter : parameters_) {
+      parameter = Sub(parameter, Mul(scale, parameter));
+    }
+  }
+
+ protected:
+  // Traces the forward pass, returning the scalar loss.
+  virtual Tensor Forward() = 0;
+
+  Tensor AddParameter(const std::vector<int64_t>& sizes) {
+    parameters_.push_back(Rand(sizes));
+    return parameters_.back();
+  }
+
+  const Tensor& parameter(size_t index) const { return parameters_[index]; }
+
+ private:
+  Tensor learning_rate_;
+  std::vector<Tensor> parameters_;
+};
+
+// A three layer perceptron classifying a batch of flattened 28x28 images.
+class Mlp : public Model {
+ public:
+  explicit Mlp(const Device& device)
+      : Model(device), input_(Rand({kBatch, 784})) {
+    AddParameter({784, 1024});
+    AddParameter({1024});
+    AddParameter({1024, 1024});
+    AddParameter({1024});
+    AddParameter({1024, 10});
+  }
+
+ protected:
+  Tensor Forward() override {
+    Tensor hidden = Relu(Add(MatMul(input_, parameter(0)), parameter(1)));
+    hidden = Relu(Add(MatMul(hidden, parameter(2)), parameter(3)));
+    Tensor log_probs =
+        Wrap(XLATensor_log_softmax(MatMul(hidden, parameter(4)).get(), 1));
+    return Wrap(XLATensor_neg(Mean(log_probs, {0, 1}, false).get()));
+  }
+
+ private:
+  static constexpr int64_t kBatch = 64;
+
+  Tensor input_;
+};
+
+// A ResNet basic block: two 3x3 convolutions with normalization, and the
+// residual connection.
+class ResNetBlock : public Model {
+ public:
+  explicit ResNetBlock(const Device& device)
+      : Model(device),
+        input_(Rand({8, 56, 56, kChannels})),
+        epsilon_(Scalar(1e-5, device)) {
+    AddParameter({3, 3, kChannels, kChannels});
+    AddParameter({3, 3, kChannels, kChannels});
+  }
+
+ protected:
+  Tensor Forward() override {
+    std::vector<int64_t> batch_dims = {0, 1, 2};
+    Tensor hidden =
+        Relu(Normalize(Conv3x3(input_, parameter(0)), batch_dims, epsilon_));
+    hidden = Normalize(Conv3x3(hidden, parameter(1)), batch_dims, epsilon_);
+    Tensor output = Relu(Add(hidden, input_));
+    return Mean(Mul(output, output), {0, 1, 2, 3}, false);
+  }
+
+ private:
+  static constexpr int64_t kChannels = 64;
+
+  Tensor input_;
+  Tensor epsilon_;
+};
+
+// A transformer encoder layer: multi-head self-attention and a feed-forward
+// network, each followed by the residual connection and layer normalization.
+class TransformerLayer : public Model {
+ public:
+  explicit TransformerLayer(const Device& device)
+      : Model(device),
+        input_(Rand({kBatch * kLength, kModel})),
+        scale_(Scalar(1.0 / 8.0, device)),
+        epsilon_(Scalar(1e-5, device)) {
+    for (int i = 0; i < 4; ++i) {
+      AddParameter({kModel, kModel});
+    }
+    AddParameter({kModel, 4 * kModel});
+    AddParameter({4 * kModel, kModel});
+  }
+
+ protected:
+  Tensor Forward() override {
+    std::vector<int64_t> feature_dims = {1};
+    Tensor query = SplitHeads(MatMul(input_, parameter(0)));
+    Tensor key = SplitHeads(MatMul(input_, parameter(1)));
+    Tensor value = SplitHeads(MatMul(input_, parameter(2)));
+    Tensor scores =
+        Mul(MatMul(query, Permute(key, {0, 1, 3, 2})), scale_);
+    Tensor attention =
+        MatMul(Wrap(XLATensor_softmax(scores.get(), 3)), value);
+    attention = Reshape(Permute(attention, {0, 2, 1, 3}),
+                        {kBatch * kLength, kModel});
+    Tensor hidden = Normalize(
+        Add(MatMul(attention, parameter(3)), input_), feature_dims, epsilon_);
+    Tensor feed_forward =
+        MatMul(Relu(MatMul(hidden, parameter(4))), parameter(5));
+    Tensor output = Normalize(Add(feed_forward, hidden), feature_dims,
+                              epsilon_);
+    return Mean(Mul(output, output), {0, 1}, false);
+  }
+
+ private:
+  static constexpr int64_t kBatch = 8;
+  static constexpr int64_t kLength = 128;
+  static constexpr int64_t kModel = 512;
+  static constexpr int64_t kHeads = 8;
+
+  // Reshapes [batch * length, model] to [batch, heads, length, model / heads].
+  Tensor SplitHeads(const Tensor& input) {
+    return Permute(Reshape(input, {kBatch, kLength, kHeads, kModel / kHeads}),
+                   {0, 2, 1, 3});
+  }
+
+  Tensor input_;
+  Tensor scale_;
+  Tensor epsilon_;
+};
+
+// An embedding lookup, lowered as a one-hot matmul, followed by a perceptron
+// predicting a score per example.
+class EmbeddingMlp : public Model {
+ public:
+  explicit EmbeddingMlp(const Device& device)
+      : Model(device),
+        one_(Scalar(1, device)),
+        zero_(Scalar(0, device)) {
+    std::vector<int32_t> indices(kBatch);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      indices[i] = static_cast<int32_t>((i * 7919) % kVocabulary);
+    }
+    size_t shape[] = {indices.size()};
+    indices_ = Wrap(copyTensor(XLATensorScalarType_Int32, indices.data(),
+                               indices.size(), shape, 1,
+                               ConvertDevice(device)));
+    AddParameter({kVocabulary, 64});
+    AddParameter({64, 256});
+    AddParameter({256});
+    AddParameter({256, 1});
+  }
+
+ protected:
+  Tensor Forward() override {
+    Tensor one_hot = Wrap(XLATensor_tf_OneHot(
+        indices_.get(), one_.get(), zero_.get(), kVocabulary, -1));
+    Tensor embeddings = MatMul(one_hot, parameter(0));
+    Tensor hidden =
+        Relu(Add(MatMul(embeddings, parameter(1)), parameter(2)));
+    Tensor scores = MatMul(hidden, parameter(3));
+    return Mean(Mul(scores, scores), {0, 1}, false);
+  }
+
+ private:
+  static constexpr int64_t kBatch = 256;
+  static constexpr int64_t kVocabulary = 10000;
+
+  Tensor one_;
+  Tensor zero_;
+  Tensor indices_;
+};
+
+struct ModelSpec {
+  std::string name;
+  std::function<std::unique_ptr<Model>(const Device&)> create_fn;
+};
+
+template <typename T>
+ModelSpec MakeModelSpec(std::string name) {
+  return {std::move(name), [](const Device& device) {
+            return std::unique_ptr<Model>(new T(device));
+          }};
+}
+
+double CompileSeconds() {
+  xla::metrics::MetricData* data = xla::metrics::GetMetric("CompileTime");
+  return data != nullptr ? data->Accumulator() * 1e-9 : 0.0;
+}
+
+xla::int64 CounterValue(const std::string& name) {
+  xla::metrics::CounterData* data = xla::metrics::GetCounter(name);
+  return data != nullptr ? data->Value() : 0;
+}
+
+struct StepResult {
+  double seconds = 0;
+  double compile_seconds = 0;
+};
+
+// Traces a step of the model and syncs it on the device, waiting for it.
+StepResult RunStep(Model* model, const Device& device) {
+  double compile_seconds = CompileSeconds();
+  xla::int64 start = xla::sys_util::NowNs();
+  model->Step();
+  XLATensor::SyncLiveTensorsGraph(&device, /*devices=*/{}, /*wait=*/true);
+  XLATensor::MarkStep(&device);
+  StepResult result;
+  result.seconds = 1e-9 * (xla::sys_util::NowNs() - start);
+  result.compile_seconds = CompileSeconds() - compile_seconds;
+  return result;
+}
+
+void AppendJsonString(const std::string& str, std::stringstream* ss) {
+  (*ss) << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      (*ss) << '\\';
+    }
+    (*ss) << c;
+  }
+  (*ss) << '"';
+}
+
+void AppendStepResult(const char* name, const StepResult& result,
+                      std::stringstream* ss) {
+  (*ss) << "\"" << name << "\": {\"step_seconds\": " << result.seconds
+        << ", \"compile_seconds\": " << result.compile_seconds << "}";
+}
+
+// Returns the nearest rank quantile of the sorted values.
+double Quantile(const std::vector<double>& sorted_values, double quantile) {
+  size_t rank = static_cast<size_t>(quantile * sorted_values.size());
+  return sorted_values[std::min(rank, sorted_values.size() - 1)];
+}
+
+void BenchmarkModel(const ModelSpec& spec, const Device& device, size_t steps,
+                    std::stringstream* ss) {
+  std::unique_ptr<Model> model = spec.create_fn(device);
+  XLATensor::SyncLiveTensorsGraph(&device, /*devices=*/{}, /*wait=*/true);
+  StepResult cold_start = RunStep(model.get(), device);
+  XLATensorStepBenchmarks::ClearComputationCache();
+  StepResult warm_start = RunStep(model.get(), device);
+
+  // The step times are recorded as a metric, which also exposes them through
+  // the metrics report of the run.
+  std::string metric_name = "BenchmarkStepTime." + spec.name;
+  xla::metrics::Metric metric(metric_name, xla::metrics::MetricFnTime, steps);
+  xla::int64 recompiles = CounterValue("UncachedCompile");
+  for (size_t i = 0; i < steps; ++i) {
+    metric.AddSample(RunStep(model.get(), device).seconds * 1e9);
+  }
+  recompiles = CounterValue("UncachedCompile") - recompiles;
+
+  std::vector<double> step_seconds;
+  for (const xla::metrics::Sample& sample :
+       metric.Samples(/*accumulator=*/nullptr, /*total_samples=*/nullptr)) {
+    step_seconds.push_back(sample.value * 1e-9);
+  }
+  std::sort(step_seconds.begin(), step_seconds.end());
+  XLA_CHECK(!step_seconds.empty());
+  double mean = metric.Accumulator() * 1e-9 / steps;
+
+  (*ss) << "{\"name\": ";
+  AppendJsonString(spec.name, ss);
+  (*ss) << ", ";
+  AppendStepResult("cold_start", cold_start, ss);
+  (*ss) << ", ";
+  AppendStepResult("warm_start", warm_start, ss);
+  (*ss) << ", \"steady_state\": {\"steps\": " << steps
+        << ", \"mean_seconds\": " << mean
+        << ", \"min_seconds\": " << step_seconds.front()
+        << ", \"p50_seconds\": " << Quantile(step_seconds, 0.5)
+        << ", \"p90_seconds\": " << Quantile(step_seconds, 0.9)
+        << ", \"p99_seconds\": " << Quantile(step_seconds, 0.99)
+        << ", \"max_seconds\": " << step_seconds.back()
+        << ", \"recompiles\": " << recompiles << "}}";
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+  size_t steps = xla::sys_util::GetEnvInt("X10_STEP_BENCHMARK_STEPS", 50);
+  XLA_CHECK_GT(steps, 0);
+  // XLATensor_rand() creates the parameters on the default device.
+  swift_xla::Device device = *swift_xla::GetDefaultDevice();
+  std::vector<swift_xla::ModelSpec> specs = {
+      swift_xla::MakeModelSpec<swift_xla::Mlp>("mlp"),
+      swift_xla::MakeModelSpec<swift_xla::ResNetBlock>("resnet_block"),
+      swift_xla::MakeModelSpec<swift_xla::TransformerLayer>(
+          "transformer_layer"),
+      swift_xla::MakeModelSpec<swift_xla::EmbeddingMlp>("embedding_mlp"),
+  };
+
+  std::stringstream ss;
+  ss << "{\"label\": ";
+  swift_xla::AppendJsonString(
+      xla::sys_util::GetEnvString("X10_STEP_BENCHMARK_LABEL", ""), &ss);
+  ss << ", \"device\": ";
+  swift_xla::AppendJsonString(device.ToString(), &ss);
+  ss << ", \"persistent_cache\": "
+     << (xla::sys_util::GetEnvString("XLA_PERSISTENT_CACHE_DIR", "").empty()
+             ? "false"
+             : "true")
+     << ", \"models\": [";
+  bool first = true;
+  for (const swift_xla::ModelSpec& spec : specs) {
+    if (spec.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    if (!first) {
+      ss << ", ";
+    }
+    first = false;
+    swift_xla::BenchmarkModel(spec, device, steps, &ss);
+  }
+  ss << "]}";
+  std::printf("%s\n", ss.str().c_str());
+  return 0;
+}
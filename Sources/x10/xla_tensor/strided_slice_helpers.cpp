@@ -14,9 +14,14 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/strided_slice_helpers.h"
 
+#include <cstdlib>
+#include <memory>
+
 #include "tensorflow/compiler/tf2xla/xla_tensor/debug_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/util/strided_slice_op.h"
@@ -38,9 +43,36 @@ tensorflow::Tensor MakeRank1Tensor(absl::Span<const xla::int64> values) {
   return t;
 }
 
-}  // namespace
+// Fills the canonical slice of the spec. The elements selected along a
+// dimension with a negative stride are sliced in increasing order, from the
+// last one selected, and the dimension is then reversed.
+void CanonicalizeSlice(StridedSliceSpec* spec) {
+  for (size_t i = 0; i < spec->strides.size(); ++i) {
+    xla::int64 stride = spec->strides[i];
+    xla::int64 size = spec->processing_sizes[i];
+    xla::int64 abs_stride = std::abs(stride);
+    xla::int64 begin = 0;
+    xla::int64 end = 0;
+    if (size > 0) {
+      begin = stride > 0 ? spec->begin[i]
+                         : spec->begin[i] - (size - 1) * abs_stride;
+      end = begin + (size - 1) * abs_stride + 1;
+    }
+    spec->slice_begin.push_back(begin);
+    spec->slice_end.push_back(end);
+    spec->slice_strides.push_back(abs_stride);
+    if (stride < 0 && size > 1) {
+      spec->reverse_dims.push_back(i);
+    }
+  }
+}
 
-StridedSliceSpec ComputeIndexingBoundsAndStrides(
+StridedSliceSpec ComputeSpec(
+    absl::Span<const xla::int64> input_sizes,
+    absl::Span<const xla::int64> begin, absl::Span<const xla::int64> end,
+    absl::Span<const xla::int64> strides, xla::int32 begin_mask,
+    xla::int32 end_mask, xla::int32 ellipsis_mask, xla::int32 new_axis_mask,
+    xla::int32 shrink_axis_mask) {
     absl::Span<const xla::int64> input_sizes,
     absl::Span<const xla::int64> begin, absl::Span<const xla::int64> end,
     absl::Span<const xla::int64> strides, xla::int32 begin_mask,
@@ -67,8 +99,41 @@ StridedSliceSpec ComputeIndexingBoundsAndStrides(
   tensorflow::TensorShape final_shape;
   XLA_CHECK(partial_final_shape.AsTensorShape(&final_shape))
       << "Unexpected incomplete final shape";
-  return {begin_spec, end_spec, strides_spec, processing_shape.dim_sizes(),
-          final_shape.dim_sizes()};
+  StridedSliceSpec spec = {begin_spec, end_spec, strides_spec,
+                           processing_shape.dim_sizes(),
+                           final_shape.dim_sizes()};
+  CanonicalizeSlice(&spec);
+  return spec;
+}
+
+using SpecCache =
+    xla::util::Cache<xla::hash_t, StridedSliceSpec, xla::util::HashReducer>;
+
+SpecCache* GetSpecCache() {
+  static SpecCache* cache = new SpecCache(4096);
+  return cache;
+}
+
+}  // namespace
+
+StridedSliceSpec ComputeIndexingBoundsAndStrides(
+    absl::Span<const xla::int64> input_sizes,
+    absl::Span<const xla::int64> begin, absl::Span<const xla::int64> end,
+    absl::Span<const xla::int64> strides, xla::int32 begin_mask,
+    xla::int32 end_mask, xla::int32 ellipsis_mask, xla::int32 new_axis_mask,
+    xla::int32 shrink_axis_mask) {
+  xla::hash_t key =
+      xla::util::MHash(input_sizes, begin, end, strides, begin_mask, end_mask,
+                       ellipsis_mask, new_axis_mask, shrink_axis_mask);
+  SpecCache* cache = GetSpecCache();
+  std::shared_ptr<StridedSliceSpec> spec = cache->Get(key);
+  if (spec == nullptr) {
+    spec = cache->Add(key, std::make_shared<StridedSliceSpec>(ComputeSpec(
+                               input_sizes, begin, end, strides, begin_mask,
+                               end_mask, ellipsis_mask, new_axis_mask,
+                               shrink_axis_mask)));
+  }
+  return *spec;
 }
 
 }  // namespace swift_xla
@@ -30,10 +30,17 @@ struct StridedSliceSpec {
   absl::InlinedVector<xla::int64, 4> strides;
   absl::InlinedVector<xla::int64, 4> processing_sizes;
   absl::InlinedVector<xla::int64, 4> final_sizes;
+  // The same slice as a single xla::Slice with positive strides, tight to the
+  // selected elements, followed by the reversal of reverse_dims and a reshape
+  // from processing_sizes to final_sizes.
+  absl::InlinedVector<xla::int64, 4> slice_begin;
+  absl::InlinedVector<xla::int64, 4> slice_end;
+  absl::InlinedVector<xla::int64, 4> slice_strides;
+  absl::InlinedVector<xla::int64, 4> reverse_dims;
 };
 
 // Compute the slice parameters and output size to be used when lowering an
-// indexing operation.
+// indexing operation. The specs are cached by input sizes and slice arguments.
 StridedSliceSpec ComputeIndexingBoundsAndStrides(
     absl::Span<const xla::int64> input_sizes,
     absl::Span<const xla::int64> begin, absl::Span<const xla::int64> end,
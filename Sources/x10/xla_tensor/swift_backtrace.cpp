@@ -18,6 +18,8 @@
 #include <unistd.h>
 
 #include <climits>
+#include <mutex>
+#include <unordered_map>
 
 #include "absl/base/call_once.h"
 #include "absl/debugging/stacktrace.h"
@@ -39,34 +41,59 @@ void InitializeSymbolizer() {
   absl::InitializeSymbolizer(self);
 }
 
+std::string SymbolizeAddress(void* address) {
+  static std::mutex* mutex = new std::mutex();
+  static auto* symbols = new std::unordered_map<void*, std::string>();
+  std::lock_guard<std::mutex> lock(*mutex);
+  auto it = symbols->find(address);
+  if (it == symbols->end()) {
+    char func_name[1024];
+    bool success = absl::Symbolize(address, func_name, sizeof(func_name));
+    it = symbols->emplace(address, success ? func_name : "(unknown)").first;
+  }
+  return it->second;
+}
+
 }  // namespace
 
 std::vector<SourceLocation> GetSwiftFrames() {
-  absl::call_once(g_symbolizer_init_once, InitializeSymbolizer);
-  std::vector<SourceLocation> frames;
+  return SymbolizeFrames(CaptureRawFrames());
+}
+
+RawFrames CaptureRawFrames() {
   int max_depth = 256;
-  std::vector<void*> func_addr(max_depth);
-  char func_name[1024];
-  int depth = absl::GetStackTrace(func_addr.data(), max_depth, 0);
-  for (int i = 0; i < depth; ++i) {
-    bool success = absl::Symbolize(func_addr[i], func_name, sizeof(func_name));
+  RawFrames frames;
+  frames.addresses.resize(max_depth);
+  int depth = absl::GetStackTrace(frames.addresses.data(), max_depth, 1);
+  frames.addresses.resize(depth);
+  frames.addresses.shrink_to_fit();
+  return frames;
+}
+
+std::vector<SourceLocation> SymbolizeFrames(const RawFrames& frames) {
+  absl::call_once(g_symbolizer_init_once, InitializeSymbolizer);
+  std::vector<SourceLocation> locations;
+  locations.reserve(frames.addresses.size());
+  for (void* address : frames.addresses) {
     SourceLocation location;
-    if (success) {
-      location.function = func_name;
-    } else {
-      location.function = "(unknown)";
-    }
-    frames.push_back(location);
+    location.function = SymbolizeAddress(address);
+    locations.push_back(std::move(location));
   }
-  return frames;
+  return locations;
 }
 #else
 std::vector<SourceLocation> GetSwiftFrames() {
-  std::vector<SourceLocation> frames;
+  return SymbolizeFrames(CaptureRawFrames());
+}
+
+RawFrames CaptureRawFrames() { return RawFrames(); }
+
+std::vector<SourceLocation> SymbolizeFrames(const RawFrames& frames) {
+  std::vector<SourceLocation> locations;
   SourceLocation location;
   location.function = "(unknown)";
-  frames.push_back(location);
-  return frames;
+  locations.push_back(location);
+  return locations;
 }
 #endif
 
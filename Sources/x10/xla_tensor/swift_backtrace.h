@@ -26,8 +26,20 @@ struct SourceLocation {
   std::string function;
 };
 
+// The return addresses of a call stack, which are cheap to capture and only
+// get symbolized when the frames are actually needed.
+struct RawFrames {
+  std::vector<void*> addresses;
+};
+
 std::vector<SourceLocation> GetSwiftFrames();
 
+RawFrames CaptureRawFrames();
+
+// Symbolization results are cached by address, so symbolizing many stacks
+// captured from the same call sites is cheap.
+std::vector<SourceLocation> SymbolizeFrames(const RawFrames& frames);
+
 std::ostream& operator<<(std::ostream& stream,
                          const std::vector<SourceLocation>& frames);
 
@@ -18,38 +18,68 @@
 #include <atomic>
 #include <cmath>
 #include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <exception>
 #include <functional>
+#include <future>
+#include <limits>
+#include <map>
 #include <mutex>
 #include <set>
+#include <sstream>
 #include <stdexcept>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_map.h"
 #include "absl/container/node_hash_set.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/compile_profile.h"
+#include "tensorflow/compiler/xla/xla_client/computation_bundle.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/env_vars.h"
+#include "tensorflow/compiler/xla/xla_client/event_tracer.h"
+#include "tensorflow/compiler/xla/xla_client/execution_profile.h"
+#include "tensorflow/compiler/xla/xla_client/mesh_service.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/persistent_cache.h"
+#include "tensorflow/compiler/xla/xla_client/step_profiler.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/unique.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/all_reduce_combiner.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/debug_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/host_evaluation.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/host_fallback.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_dump_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/mixed_precision.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/node_allocator.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/op_by_op_executor.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/cast.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sharding.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/recompile_analyzer.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/replay_log.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/sharding_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/swift_backtrace.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/public/version.h"
 
 namespace swift_xla {
 namespace ir {
@@ -70,14 +100,61 @@ struct HashDevice {
   size_t operator()(const Device& device) const { return device.hash(); }
 };
 
+// Identifies the IR value of a scalar literal, expanded to the dimensions.
+struct ScalarIrKey {
+  bool floating_point;
+  // The bits of the integral or floating point value.
+  xla::int64 bits;
+  xla::PrimitiveType type;
+  std::vector<xla::int64> dimensions;
+
+  bool operator==(const ScalarIrKey& other) const {
+    return floating_point == other.floating_point && bits == other.bits &&
+           type == other.type && dimensions == other.dimensions;
+  }
+};
+
+struct HashScalarIrKey {
+  size_t operator()(const ScalarIrKey& key) const {
+    return xla::util::HashReduce(
+        xla::util::MHash(key.floating_point, key.bits,
+                         static_cast<int>(key.type), key.dimensions));
+  }
+};
+
 struct TlsData {
-  void Reset() { trim_counter = 0; }
+  void Reset() {
+    trim_counter = 0;
+    trim_armed_counter = 0;
+    trim_armed = false;
+  }
 
   size_t trim_counter = 0;
+  // Number of graph size checks since the pending graph crossed the size
+  // limit, while waiting for a cut boundary.
+  size_t trim_armed_counter = 0;
+  bool trim_armed = false;
 };
 
 thread_local TlsData g_tls_data;
 
+// The trace context of the current thread, see XLATensor::SetTraceContext().
+thread_local xla::int64 g_trace_context = 0;
+
+size_t NextUseTick() {
+  static std::atomic<size_t> use_clock(1);
+  return use_clock.fetch_add(1);
+}
+
+// Hashes of the IR nodes the pending graph has been cut at. They survive across
+// steps, so that the same cuts get taken again and produce the same (cached)
+// graphs.
+struct GraphCutState {
+  absl::node_hash_set<xla::hash_t> cut_hashes;
+};
+
+thread_local GraphCutState g_graph_cut_state;
+
 struct TraceletState {
   absl::node_hash_map<xla::hash_t, std::vector<xla::hash_t>> tracelet_by_prefix;
   absl::node_hash_set<xla::hash_t> cutpoints;
@@ -116,34 +193,99 @@ c10::optional<size_t> FindTraceDivergence(
 // so. Only operations which _use_ device data (computations, and transfer from
 // server) need to wait for asynchronous operations to complete (barrier).
 
+// Every trace context has its own lock of the device, so that the syncs of
+// different trace contexts run concurrently.
 class DeviceLocker {
  public:
-  explicit DeviceLocker(Device device) : device_(std::move(device)) {}
+  DeviceLocker(Device device, xla::int64 trace_context)
+      : device_(std::move(device)),
+        name_(trace_context == 0
+                  ? device_.ToString()
+                  : absl::StrCat(device_.ToString(), ".", trace_context)),
+        wait_metric_(absl::StrCat("DeviceLockWaitTime.", name_),
+                     xla::metrics::MetricFnTime),
+        hold_metric_(absl::StrCat("DeviceLockHoldTime.", name_),
+                     xla::metrics::MetricFnTime),
+        barrier_metric_(absl::StrCat("DeviceBarrierWaitTime.", name_),
+                        xla::metrics::MetricFnTime),
+        waiters_metric_(absl::StrCat("DeviceLockWaiters.", name_),
+                        xla::metrics::MetricFnValue),
+        contention_event_(absl::StrCat("DeviceLockContention.", name_)) {}
 
   const Device& device() const { return device_; }
 
   void Lock() {
+    XLA_TRACE_SPAN("DeviceLockerLock");
+    XLA_STEP_TIMER(kDeviceLockWait);
+    xla::int64 start = xla::sys_util::NowNs();
     std::unique_lock<std::mutex> lock(mutex_);
+    bool contended = locked_;
+    // The number of threads found ahead, waiting for the device.
+    waiters_metric_.AddSample(start, waiters_);
+    ++waiters_;
     cv_.wait(lock, [this] { return !locked_; });
+    --waiters_;
+    xla::int64 now = xla::sys_util::NowNs();
+    wait_metric_.AddSample(now, now - start);
+    if (contended && TraceContention()) {
+      xla::metrics::EventTracer::Get()->Record(contention_event_.c_str(), start,
+                                               now);
+    }
     CheckResetException();
     locked_ = true;
+    locked_at_ = now;
   }
 
   void Unlock(std::exception_ptr exptr) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    locked_ = false;
-    exptr_ = std::move(exptr);
-    cv_.notify_all();
+    std::vector<std::function<void(std::exception_ptr)>> callbacks;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      xla::int64 now = xla::sys_util::NowNs();
+      hold_metric_.AddSample(now, now - locked_at_);
+      locked_ = false;
+      callbacks.swap(unlock_callbacks_);
+      // The callbacks observe the status, like the barriers they replace.
+      exptr_ = callbacks.empty() ? std::move(exptr) : nullptr;
+      cv_.notify_all();
+    }
+    for (auto& callback : callbacks) {
+      callback(exptr);
+    }
   }
 
   void Barrier() {
+    xla::metrics::TimedSection timed(&barrier_metric_);
+    XLA_STEP_TIMER(kDeviceLockWait);
     std::unique_lock<std::mutex> lock(mutex_);
     cv_.wait(lock, [this] { return !locked_; });
     cv_.notify_all();
     CheckResetException();
   }
 
+  // Runs fn once the device is unlocked, right away if it is, instead of
+  // blocking a thread in Barrier(). fn gets the exception Barrier() would
+  // throw, if any.
+  void WhenUnlocked(std::function<void(std::exception_ptr)> fn) {
+    std::exception_ptr exptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (locked_) {
+        unlock_callbacks_.push_back(std::move(fn));
+        return;
+      }
+      exptr = std::move(exptr_);
+      exptr_ = nullptr;
+    }
+    fn(std::move(exptr));
+  }
+
  private:
+  static bool TraceContention() {
+    static const bool trace_contention =
+        xla::sys_util::GetEnvBool("XLA_TRACE_DEVICE_LOCK_CONTENTION", false);
+    return trace_contention;
+  }
+
   void CheckResetException() {
     std::exception_ptr exptr = std::move(exptr_);
     exptr_ = nullptr;
@@ -153,10 +295,23 @@ class DeviceLocker {
   }
 
   Device device_;
+  // The device, followed by the trace context unless it is the default one.
+  std::string name_;
   std::mutex mutex_;
   std::condition_variable cv_;
   bool locked_ = false;
   std::exception_ptr exptr_;
+  std::vector<std::function<void(std::exception_ptr)>> unlock_callbacks_;
+  // Time at which the current owner of the lock acquired it.
+  xla::int64 locked_at_ = 0;
+  xla::int64 waiters_ = 0;
+  xla::metrics::Metric wait_metric_;
+  xla::metrics::Metric hold_metric_;
+  xla::metrics::Metric barrier_metric_;
+  xla::metrics::Metric waiters_metric_;
+  // Name of the trace event for contended locks, which must outlive the
+  // tracer.
+  std::string contention_event_;
 };
 
 class DeviceLockerArena {
@@ -166,11 +321,15 @@ class DeviceLockerArena {
     return arena;
   }
 
-  std::shared_ptr<DeviceLocker> GetLocker(const Device& device) {
+  std::shared_ptr<DeviceLocker> GetLocker(const Device& device,
+                                          xla::int64 trace_context) {
     std::lock_guard<std::mutex> lock(mutex_);
-    auto it = lockers_.find(device);
+    auto key = std::make_pair(device, trace_context);
+    auto it = lockers_.find(key);
     if (it == lockers_.end()) {
-      it = lockers_.emplace(device, std::make_shared<DeviceLocker>(device))
+      it = lockers_
+               .emplace(key,
+                        std::make_shared<DeviceLocker>(device, trace_context))
                .first;
     }
     return it->second;
@@ -178,11 +337,13 @@ class DeviceLockerArena {
 
  private:
   std::mutex mutex_;
-  std::map<Device, std::shared_ptr<DeviceLocker>> lockers_;
+  std::map<std::pair<Device, xla::int64>, std::shared_ptr<DeviceLocker>>
+      lockers_;
 };
 
-xla::util::ExceptionCleanup LockDevice(const Device& device) {
-  auto locker = DeviceLockerArena::Get()->GetLocker(device);
+xla::util::ExceptionCleanup LockDevice(const Device& device,
+                                       xla::int64 trace_context) {
+  auto locker = DeviceLockerArena::Get()->GetLocker(device, trace_context);
   locker->Lock();
   return xla::util::ExceptionCleanup(
       [locker =
@@ -191,29 +352,138 @@ xla::util::ExceptionCleanup LockDevice(const Device& device) {
       });
 }
 
-void DeviceBarrier(const Device& device) {
-  auto locker = DeviceLockerArena::Get()->GetLocker(device);
+void DeviceBarrier(const Device& device, xla::int64 trace_context) {
+  auto locker = DeviceLockerArena::Get()->GetLocker(device, trace_context);
   locker->Barrier();
 }
 
-// Use a set to impose an order on the device locking sequence (ABBA
+void WhenDeviceUnlocked(const Device& device, xla::int64 trace_context,
+                        std::function<void(std::exception_ptr)> fn) {
+  auto locker = DeviceLockerArena::Get()->GetLocker(device, trace_context);
+  locker->WhenUnlocked(std::move(fn));
+}
+
+// Use sets to impose an order on the device locking sequence (ABBA
 // prevention).
 std::vector<xla::util::ExceptionCleanup> LockDevices(
-    const std::set<Device>& devices) {
+    const std::set<Device>& devices,
+    const std::set<xla::int64>& trace_contexts) {
   std::vector<xla::util::ExceptionCleanup> unlocker;
-  unlocker.reserve(devices.size());
+  unlocker.reserve(devices.size() * trace_contexts.size());
   for (auto& device : devices) {
-    unlocker.emplace_back(LockDevice(device));
+    for (xla::int64 trace_context : trace_contexts) {
+      unlocker.emplace_back(LockDevice(device, trace_context));
+    }
   }
   return unlocker;
 }
 
+// The queue of the ops dispatched eagerly to a device, see
+// XLATensor::ApplyEagerDispatch(). While it holds ops, the queue holds the
+// device lock, so the barriers of the tensor reads wait for the ops queued
+// ahead of them, while the tracing thread keeps queueing ops without waiting
+// for the device.
+class EagerDispatchQueue {
+ public:
+  EagerDispatchQueue(Device device, xla::int64 trace_context)
+      : device_(std::move(device)), trace_context_(trace_context) {}
+
+  // Queues the computation of root, into the device data placeholder.
+  void Enqueue(ir::Value root, xla::ComputationClient::DataPtr data) {
+    bool start = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ops_.push_back({std::move(root), std::move(data)});
+      XLA_VALUE_METRIC("EagerDispatchQueueDepth", ops_.size());
+      start = !running_;
+      running_ = true;
+    }
+    if (start) {
+      auto unlocker = std::make_shared<xla::util::ExceptionCleanup>(
+          LockDevice(device_, trace_context_));
+      xla::env::ScheduleClosure([this, unlocker]() { Run(unlocker.get()); });
+    }
+  }
+
+ private:
+  struct Op {
+    ir::Value root;
+    xla::ComputationClient::DataPtr data;
+  };
+
+  // Runs the queued ops in order, until the queue is empty. The ops queued
+  // after a failed one depend on its result, so they are dropped, and the
+  // failure is reported by the next barrier of the device.
+  void Run(xla::util::ExceptionCleanup* unlocker) {
+    std::exception_ptr exptr;
+    std::string device = device_.ToString();
+    while (true) {
+      Op op;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ops_.empty()) {
+          running_ = false;
+          break;
+        }
+        op = std::move(ops_.front());
+        ops_.pop_front();
+      }
+      if (exptr != nullptr) {
+        continue;
+      }
+      try {
+        std::vector<xla::ComputationClient::DataPtr> results =
+            OpByOpExecutor::Get()->Execute({op.root}, device, {});
+        op.data->Assign(*results.front());
+      } catch (...) {
+        exptr = std::current_exception();
+      }
+    }
+    unlocker->SetStatus(std::move(exptr));
+  }
+
+  Device device_;
+  xla::int64 trace_context_;
+  std::mutex mutex_;
+  std::deque<Op> ops_;
+  bool running_ = false;
+};
+
+class EagerDispatchQueueArena {
+ public:
+  static EagerDispatchQueueArena* Get() {
+    static EagerDispatchQueueArena* arena = new EagerDispatchQueueArena();
+    return arena;
+  }
+
+  EagerDispatchQueue* GetQueue(const Device& device,
+                               xla::int64 trace_context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_pair(device, trace_context);
+    auto it = queues_.find(key);
+    if (it == queues_.end()) {
+      it = queues_
+               .emplace(key, absl::make_unique<EagerDispatchQueue>(
+                                 device, trace_context))
+               .first;
+    }
+    return it->second.get();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<std::pair<Device, xla::int64>, std::unique_ptr<EagerDispatchQueue>>
+      queues_;
+};
+
 class XlaDataCacheArena {
  public:
   struct TensorHasher {
     size_t operator()(const at::Tensor& tensor) const {
-      return xla::util::HashReduce(xla::util::HashCombine(
-          xla::util::GetEnumValue(tensor.scalar_type()), TensorHash(tensor)));
+      // Large tensors are only sampled, TensorComparer does the full check.
+      static const size_t kMaxHashedBytes =
+          xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_HASHED_BYTES", 4096);
+      return xla::util::HashReduce(TensorFingerprint(tensor, kMaxHashedBytes));
     };
   };
   struct TensorComparer {
@@ -222,17 +492,31 @@ class XlaDataCacheArena {
       return tensor1.equal(tensor2);
     }
   };
+  // Weighs cached device data by the cost of uploading it again, which is a
+  // fixed per transfer latency, expressed in bytes, plus the data size. This
+  // favors the many small scalars over the few large tensors.
+  struct XlaDataWeigher {
+    double Cost(const xla::ComputationClient::Data& data) const {
+      static const double kTransferLatencyBytes = 64 * 1024;
+      return kTransferLatencyBytes + Size(data);
+    }
+
+    size_t Size(const xla::ComputationClient::Data& data) const {
+      return xla::ShapeUtil::ByteSizeOf(data.shape());
+    }
+  };
 
   using XlaDataCache =
-      xla::util::Cache<at::Tensor, xla::ComputationClient::Data, TensorHasher,
-                       TensorComparer>;
+      xla::util::CostAwareCache<at::Tensor, xla::ComputationClient::Data,
+                                XlaDataWeigher, TensorHasher, TensorComparer>;
 
-  explicit XlaDataCacheArena(size_t max_cache_size)
-      : max_cache_size_(max_cache_size) {
+  XlaDataCacheArena(size_t max_cache_size, size_t max_cache_bytes)
+      : max_cache_size_(max_cache_size), max_cache_bytes_(max_cache_bytes) {
     for (const std::string& device_string :
          xla::ComputationClient::AllDevices()) {
       swift_xla::Device device(device_string);
-      std::unique_ptr<XlaDataCache> cache(new XlaDataCache(max_cache_size_));
+      std::unique_ptr<XlaDataCache> cache(
+          new XlaDataCache(max_cache_size_, max_cache_bytes_));
       device_caches_.emplace(device, std::move(cache));
     }
   }
@@ -246,17 +530,30 @@ class XlaDataCacheArena {
 
  private:
   size_t max_cache_size_ = 0;
+  size_t max_cache_bytes_ = 0;
   absl::flat_hash_map<Device, std::unique_ptr<XlaDataCache>, HashDevice>
       device_caches_;
 };
 
 XlaDataCacheArena::XlaDataCache* GetXlaDataCache(const Device& device) {
   static const size_t kMaxCacheSize =
-      xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_SIZE", 128);
-  static XlaDataCacheArena* arena = new XlaDataCacheArena(kMaxCacheSize);
+      xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_SIZE", 4096);
+  static const size_t kMaxCacheBytes =
+      xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_BYTES", 64 * 1024 * 1024);
+  static XlaDataCacheArena* arena =
+      new XlaDataCacheArena(kMaxCacheSize, kMaxCacheBytes);
   return arena->Get(device);
 }
 
+// Returns whether non scalar tensors of the given size are routed through the
+// device data cache, so that inputs re-sent at every step, like masks or
+// positional tables, are only uploaded once.
+bool IsCacheableTensorSize(size_t size) {
+  static const size_t kMaxCachedTensorBytes = xla::sys_util::GetEnvInt(
+      "XLA_DEVDATA_CACHE_MAX_TENSOR_BYTES", 1024 * 1024);
+  return size <= kMaxCachedTensorBytes;
+}
+
 static at::Tensor ToTensor(at::Scalar value, at::ScalarType scalar_type) {
   switch (scalar_type) {
 #define TO_TENSOR_CASE(name, aten_name, DType)   \
@@ -282,10 +579,20 @@ xla::ComputationClient::DataPtr GetDeviceData(const at::Tensor& tensor,
   XlaDataCacheArena::XlaDataCache* cache = GetXlaDataCache(device);
   xla::ComputationClient::DataPtr device_data = cache->Get(tensor);
   if (device_data == nullptr) {
+    // Scalars which change at every step, like learning rates, are batched
+    // into a single transfer before the computation using them.
+    static const bool batch_scalars =
+        xla::sys_util::GetEnvBool("XLA_BATCH_SCALAR_TRANSFERS", true);
     at::Tensor tensor_copy = tensor.dup();
-    device_data = TensorToXlaData(tensor_copy, device);
+    device_data = batch_scalars ? TensorToXlaDataDeferred(tensor_copy, device)
+                                : TensorToXlaData(tensor_copy, device);
+    device_data->SetMemoryKind(xla::metrics::MemoryKind::kCache);
     cache->Add(std::move(tensor_copy), device_data);
     XLA_COUNTER("DeviceDataCacheMiss", 1);
+    XLA_COUNTER("DeviceDataCacheMissBytes", tensor.buffer().raw_size());
+  } else {
+    XLA_COUNTER("DeviceDataCacheHit", 1);
+    XLA_COUNTER("DeviceDataCacheHitBytes", tensor.buffer().raw_size());
   }
   return device_data;
 }
@@ -310,34 +617,335 @@ bool IsSpecialScalar(at::Scalar value) {
   return false;
 }
 
+bool UseTensorHandleArena() {
+  static const bool use_arena =
+      xla::sys_util::GetEnvBool("XLA_TENSOR_HANDLE_ARENA", true);
+  return use_arena;
+}
+
+bool DropUploadedHostData() {
+  static const bool drop_host_data =
+      xla::sys_util::GetEnvBool("XLA_DROP_UPLOADED_HOST_DATA", true);
+  return drop_host_data;
+}
+
 bool ShouldSyncIrValue(const ir::Value& ir_value) {
   return ir_value->op() != ir::ops::xla_not_supported;
 }
 
+// Identifies the TensorFlow build which lowered the computations kept on disk.
+std::string GetBuildFingerprint() {
+  return absl::StrCat(tf_git_version(), "/", tf_compiler_version());
+}
+
+// Returns the on-disk tier of the computation cache, or nullptr if
+// XLA_PERSISTENT_CACHE_DIR is not set. Entries are invalidated whenever the
+// TensorFlow build they have been produced with changes.
+const xla::util::PersistentCache* GetPersistentCache() {
+  static const std::string* folder = new std::string(
+      xla::sys_util::GetEnvString("XLA_PERSISTENT_CACHE_DIR", ""));
+  if (folder->empty()) {
+    return nullptr;
+  }
+  static const xla::util::PersistentCache* cache =
+      new xla::util::PersistentCache(*folder, GetBuildFingerprint());
+  return cache;
+}
+
+// Returns the mesh service tier of the computation cache, or nullptr if
+// XLA_MESH_COMPUTATION_SHARING is not set. The first host of a multi-host run
+// asking for a graph lowers it, and the others fetch its computation instead.
+xla::service::MeshClient* GetComputationSharingClient() {
+  static const bool sharing =
+      xla::sys_util::GetEnvBool("XLA_MESH_COMPUTATION_SHARING", false);
+  return sharing ? xla::service::MeshClient::Get() : nullptr;
+}
+
+// Every XLA_MESH_STEP_REPORT steps, sends the step records of the steps since
+// the previous report to the mesh service, which tracks how much slower the
+// slowest replicas are.
+void MaybeReportStepTimings(xla::int64 step) {
+  static const xla::int64 report_period =
+      xla::sys_util::GetEnvInt("XLA_MESH_STEP_REPORT", 0);
+  xla::service::MeshClient* client =
+      report_period > 0 ? xla::service::MeshClient::Get() : nullptr;
+  if (client == nullptr || step % report_period != 0) {
+    return;
+  }
+  static const std::string* replica = new std::string(absl::StrCat(
+      xla::sys_util::GetEnvString(xla::env::kEnvLocalWorker, ""), "/",
+      xla::sys_util::GetEnvString(xla::env::kEnvMpDevice, "")));
+  std::vector<xla::metrics::StepRecord> records =
+      xla::metrics::StepProfiler::Get()->GetRecords();
+  std::vector<xla::service::grpc::StepTiming> timings;
+  for (const xla::metrics::StepRecord& record : records) {
+    if (record.step <= step - report_period) {
+      continue;
+    }
+    auto category_ns = [&](xla::metrics::StepCategory category) {
+      return record.category_ns[static_cast<size_t>(category)];
+    };
+    xla::service::grpc::StepTiming timing;
+    timing.set_step(record.step);
+    timing.set_wall_ns(record.wall_ns);
+    timing.set_trace_ns(category_ns(xla::metrics::StepCategory::kTrace));
+    timing.set_idle_ns(record.idle_ns);
+    timing.set_device_wait_ns(
+        category_ns(xla::metrics::StepCategory::kDeviceLockWait) +
+        category_ns(xla::metrics::StepCategory::kFetchTensorData));
+    timings.push_back(std::move(timing));
+  }
+  if (timings.empty()) {
+    return;
+  }
+  xla::env::ScheduleIoClosure([client, timings = std::move(timings)]() {
+    client->ReportStepTimings(*replica, timings);
+  });
+}
+
+xla::hash_t GetPersistentCacheKey(const xla::hash_t& hash,
+                                  const Device& device) {
+  xla::hash_t key =
+      xla::util::MHash(hash, xla::util::GetEnumValue(device.hw_type));
+  // AMP changes the lowering of the same graph.
+  xla::PrimitiveType amp_type = GetAmpType();
+  return amp_type != xla::PRIMITIVE_TYPE_INVALID
+             ? xla::util::MHash(key, static_cast<int>(amp_type))
+             : key;
+}
+
+// Tracks the graph hashes whose compilation has been pushed to the background
+// (XLA_ASYNC_COMPILE), or is run by another replica, so that following steps
+// and the other replicas hitting the same graph do not compile it again.
+struct AsyncCompileState {
+  std::mutex lock;
+  std::condition_variable cv;
+  std::set<xla::hash_t> pending;
+};
+
+AsyncCompileState* GetAsyncCompileState() {
+  static AsyncCompileState* state = new AsyncCompileState();
+  return state;
+}
+
+// Returns false if a background compilation for hash is already in flight.
+bool MarkCompilePending(const xla::hash_t& hash) {
+  AsyncCompileState* state = GetAsyncCompileState();
+  std::lock_guard<std::mutex> lock(state->lock);
+  return state->pending.insert(hash).second;
+}
+
+void ClearCompilePending(const xla::hash_t& hash) {
+  AsyncCompileState* state = GetAsyncCompileState();
+  {
+    std::lock_guard<std::mutex> lock(state->lock);
+    state->pending.erase(hash);
+  }
+  state->cv.notify_all();
+}
+
+// Blocks until no compilation for hash is in flight.
+void WaitCompilePending(const xla::hash_t& hash) {
+  AsyncCompileState* state = GetAsyncCompileState();
+  std::unique_lock<std::mutex> lock(state->lock);
+  state->cv.wait(lock, [&] { return state->pending.count(hash) == 0; });
+}
+
+// Replicas of a data parallel step trace structurally identical graphs, which
+// share the graph hash, and so the computation cache entry. When syncing
+// across replication devices, only the first replica missing the cache lowers
+// and compiles the graph, while the others wait for it, and then run the
+// cached computation with their own parameters. Background compilation
+// (XLA_ASYNC_COMPILE) already dedups the replicas compilations on its own.
+bool ShareReplicaCompiles(absl::Span<const std::string> devices) {
+  static const bool share_compiles =
+      xla::sys_util::GetEnvBool("XLA_SHARE_REPLICA_COMPILES", true) &&
+      !xla::sys_util::GetEnvBool("XLA_ASYNC_COMPILE", false);
+  return share_compiles && devices.size() > 1;
+}
+
+// Replicated computations are compiled for the replica set they run on, so
+// once the data parallel world gets resized, the same graph synced across the
+// new replica set needs its own computation cache entry. The replicated graph
+// hashes are recorded before the replica set gets mixed in, so that
+// PrecompileForReplicaSet() can compile the cached graphs for another replica
+// set without tracing and lowering them again.
+struct ReplicatedGraphs {
+  std::mutex lock;
+  std::set<xla::hash_t> hashes;
+};
+
+ReplicatedGraphs* GetReplicatedGraphs() {
+  static ReplicatedGraphs* graphs = new ReplicatedGraphs();
+  return graphs;
+}
+
+xla::hash_t GetReplicaSetHash(const xla::hash_t& hash,
+                              absl::Span<const std::string> devices) {
+  return xla::util::HashCombine(hash, xla::util::Hash(devices));
+}
+
+void MixReplicaSet(absl::Span<const std::string> devices, xla::hash_t* hash) {
+  if (devices.empty()) {
+    return;
+  }
+  {
+    ReplicatedGraphs* graphs = GetReplicatedGraphs();
+    std::lock_guard<std::mutex> lock(graphs->lock);
+    graphs->hashes.insert(*hash);
+  }
+  *hash = GetReplicaSetHash(*hash, devices);
+}
+
+// With tiered compilation, the graphs missing the computation cache are first
+// compiled with the low optimization profile, and recompiled with full
+// optimization only once they have been executed this many times, as most of
+// the distinct graphs (eval steps, one-offs) only run a handful of times.
+// Returns 0 if tiered compilation is disabled.
+xla::int64 GetTieredCompileThreshold() {
+  static const xla::int64 threshold =
+      xla::sys_util::GetEnvInt("XLA_TIERED_COMPILE_THRESHOLD", 0);
+  return threshold;
+}
+
+// Tells whether the device data of the tensor, once synced, only holds the
+// shard of its partition.
+bool IsShardedTensor(const XLATensor& tensor) {
+  xla::ComputationClient::DataPtr xla_data = tensor.CurrentXlaData();
+  if (xla_data != nullptr) {
+    return xla_data->sharding() != nullptr;
+  }
+  ir::Value ir_value = tensor.CurrentIrValue();
+  const ir::ops::Sharding* sharding =
+      ir_value ? ir::ops::Sharding::Cast(ir_value.node.get()) : nullptr;
+  return sharding != nullptr &&
+         sharding->sharding().type() == xla::OpSharding::OTHER;
+}
+
+// Groups the indices of the tensors which are scalars with a pending graph,
+// by type, keeping the groups with more than one scalar.
+std::vector<std::vector<size_t>> GroupPendingScalars(
+    const std::vector<XLATensor>& tensors) {
+  static const bool pack_scalars =
+      xla::sys_util::GetEnvBool("XLA_PACK_SCALAR_FETCHES", true);
+  std::map<std::pair<at::ScalarType, xla::PrimitiveType>, std::vector<size_t>>
+      groups;
+  if (pack_scalars) {
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      ir::Value ir_value = tensors[i].CurrentIrValue();
+      if (!ir_value || ir_value.shape().rank() != 0 ||
+          ir::ops::DeviceData::Cast(ir_value.node.get()) != nullptr) {
+        continue;
+      }
+      groups[{tensors[i].dtype(), ir_value.shape().element_type()}].push_back(
+          i);
+    }
+  }
+  std::vector<std::vector<size_t>> packs;
+  for (auto& type_indices : groups) {
+    if (type_indices.second.size() > 1) {
+      packs.push_back(std::move(type_indices.second));
+    }
+  }
+  return packs;
+}
+
+// Stacks scalars of the same type into a vector.
+ir::Value PackScalars(absl::Span<const ir::Value> values) {
+  xla::Shape shape = xla::ShapeUtil::MakeShape(
+      values.front().shape().element_type(),
+      {static_cast<xla::int64>(values.size())});
+  auto lower_fn = [](const ir::Node& node,
+                     ir::LoweringContext* loctx) -> ir::XlaOpVector {
+    std::vector<xla::XlaOp> operands;
+    for (const ir::Output& operand : node.operands()) {
+      operands.push_back(xla::Reshape(loctx->GetOutputOp(operand), {1}));
+    }
+    return node.ReturnOp(xla::ConcatInDim(loctx->builder(), operands, 0),
+                         loctx);
+  };
+  return ir::ops::GenericOp(ir::OpKind(at::aten::cat), values,
+                            std::move(shape), std::move(lower_fn));
+}
+
+// Returns the scalar at the index of the vector.
+at::Tensor UnpackScalar(const at::Tensor& packed, size_t index) {
+  switch (packed.scalar_type()) {
+#define DEFINE_UNPACK_CASE(name, aten_name, type)               \
+  case at::ScalarType::aten_name: {                             \
+    std::unique_ptr<type[]> data(new type[1]);                  \
+    data[0] = packed.data<type>()[index];                       \
+    return at::Tensor(std::move(data), std::vector<int64_t>()); \
+  }
+    LIST_SCALAR_TYPES(DEFINE_UNPACK_CASE)
+#undef DEFINE_UNPACK_CASE
+  }
+}
+
 }  // namespace
 
+struct DeviceDataInfo : public xla::ComputationClient::Data::Info {
+  DeviceDataInfo(xla::int64 tensor_id, bool read_only,
+                 c10::optional<at::Tensor> host_value = c10::nullopt)
+      : tensor_id(tensor_id),
+        read_only(read_only),
+        host_value(std::move(host_value)) {}
+
+  xla::int64 tensor_id = 0;
+  bool read_only = false;
+  // The value of the data, for the data uploaded from host scalars.
+  c10::optional<at::Tensor> host_value;
+  // Whether the buffer gets donated once dead, even without the aliasing
+  // enabled.
+  bool in_place = false;
+};
+
 // The DeviceContextArena holds per device live information and statistics,
 // among which the XLA tensors which are currently alive in the system. This is
 // used to create XLA computation "barriers" in order to flush pending
 // operations and ensure the same XLA computations are created during the
-// training loops.
+// training loops. Every trace context has its own device contexts: the
+// tensors are registered within the ones of the trace context they belong to,
+// and the other operations use the ones of the trace context of the calling
+// thread.
 class XLATensor::DeviceContextArena {
-  struct DeviceContext {
+  // The live tensors of a device are spread across independently locked
+  // shards, and every thread registers its tensors within its own shard, so
+  // that replica threads tracing concurrently do not contend on a lock.
+  static const size_t kNumTensorShards = 32;
+
+  struct TensorShard {
     std::mutex lock;
     absl::flat_hash_map<xla::int64, std::weak_ptr<Data>> tensors_data;
+    // The tensors which may hold no device data, and so need a sync. Entries
+    // are added whenever the device data of a tensor gets dropped, and only
+    // removed once a walk finds the tensor synced, or destroyed.
+    absl::flat_hash_set<xla::int64> pending_ids;
+  };
+
+  struct DeviceContext {
+    std::mutex lock;
+    TensorShard tensor_shards[kNumTensorShards];
     xla::uint64 seed = 101;
     xla::uint64 running_seed = 101;
+    // Number of random streams handed out since the last seed change. Random
+    // ops derive their stream from (seed, stream), which only depends on the
+    // order of the ops within a step.
+    xla::uint64 rng_stream = 0;
     ir::Value seed_ir_value;
+    xla::int64 step_count = 0;
+    // The scalar literals traced since the last step, which share their
+    // nodes instead of creating one per use.
+    absl::flat_hash_map<ScalarIrKey, ir::Value, HashScalarIrKey> scalars;
+    // The numerics guard of the latest guarded sync.
+    std::shared_ptr<Data> numerics_guard;
   };
 
+  using DeviceContexts =
+      absl::flat_hash_map<Device, DeviceContext*, HashDevice>;
+
  public:
-  DeviceContextArena() {
-    for (const std::string& device_string :
-         xla::ComputationClient::AllDevices()) {
-      swift_xla::Device device(device_string);
-      device_contexts_.emplace(device, new DeviceContext);
-    }
-  }
+  DeviceContextArena() : device_contexts_(CreateDeviceContexts()) {}
 
   static DeviceContextArena* Get() {
     static DeviceContextArena* arena = new DeviceContextArena();
@@ -345,31 +953,85 @@ class XLATensor::DeviceContextArena {
   }
 
   void RegisterTensor(std::shared_ptr<Data> data) {
-    DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.emplace(data->unique_id, data);
+    DeviceContext* devctx =
+        GetDeviceContext(data->device, data->trace_context);
+    // The shard is recorded within the data, as it can be destroyed by a
+    // thread other than the one which created it.
+    data->registry_shard = GetThreadTensorShard();
+    TensorShard* shard = &devctx->tensor_shards[data->registry_shard];
+    std::lock_guard<std::mutex> lock(shard->lock);
+    if (data->xla_data == nullptr) {
+      shard->pending_ids.insert(data->unique_id);
+    }
+    shard->tensors_data.emplace(data->unique_id, data);
     XLA_COUNTER("CreateXlaTensor", 1);
   }
 
+  void MarkPending(const Data& data) {
+    DeviceContext* devctx = GetDeviceContext(data.device, data.trace_context);
+    TensorShard* shard = &devctx->tensor_shards[data.registry_shard];
+    std::lock_guard<std::mutex> lock(shard->lock);
+    shard->pending_ids.insert(data.unique_id);
+  }
+
   void UnregisterTensor(Data* data) {
-    DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.erase(data->unique_id);
+    DeviceContext* devctx =
+        GetDeviceContext(data->device, data->trace_context);
+    TensorShard* shard = &devctx->tensor_shards[data->registry_shard];
+    std::lock_guard<std::mutex> lock(shard->lock);
+    shard->tensors_data.erase(data->unique_id);
+    shard->pending_ids.erase(data->unique_id);
     XLA_COUNTER("DestroyXlaTensor", 1);
   }
 
   std::vector<XLATensor> GetLiveTensors(const Device* device) {
     std::vector<XLATensor> tensors;
     auto fn = [&](DeviceContext* devctx) {
-      std::lock_guard<std::mutex> lock(devctx->lock);
-      for (auto& uid_wptr : devctx->tensors_data) {
-        std::shared_ptr<Data> data = uid_wptr.second.lock();
-        if (data != nullptr) {
-          tensors.push_back(XLATensor(std::move(data)));
+      for (auto& shard : devctx->tensor_shards) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        for (auto& uid_wptr : shard.tensors_data) {
+          std::shared_ptr<Data> data = uid_wptr.second.lock();
+          if (data != nullptr) {
+            tensors.push_back(XLATensor(std::move(data)));
+          }
+        }
+      }
+    };
+    ForAllDeviceContexts(fn, device);
+    std::sort(tensors.begin(), tensors.end(), [](const XLATensor& a,
+                                                 const XLATensor& b) {
+      return a.GetUniqueId() < b.GetUniqueId();
+    });
+    return tensors;
+  }
+
+  // Returns the live tensors without device data, which are the only ones a
+  // sync has to look at. The walk only visits the pending sets, and prunes the
+  // tensors which got synced since they have been added.
+  std::vector<XLATensor> GetPendingTensors(const Device* device) {
+    std::vector<XLATensor> tensors;
+    size_t num_pruned = 0;
+    auto fn = [&](DeviceContext* devctx) {
+      for (auto& shard : devctx->tensor_shards) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        for (auto it = shard.pending_ids.begin();
+             it != shard.pending_ids.end();) {
+          auto data_it = shard.tensors_data.find(*it);
+          std::shared_ptr<Data> data = data_it != shard.tensors_data.end()
+                                           ? data_it->second.lock()
+                                           : nullptr;
+          if (data == nullptr || data->xla_data != nullptr) {
+            shard.pending_ids.erase(it++);
+            ++num_pruned;
+          } else {
+            tensors.push_back(XLATensor(std::move(data)));
+            ++it;
+          }
         }
       }
     };
     ForAllDeviceContexts(fn, device);
+    XLA_COUNTER("PrunedPendingTensors", num_pruned);
     std::sort(tensors.begin(), tensors.end(), [](const XLATensor& a,
                                                  const XLATensor& b) {
       return a.GetUniqueId() < b.GetUniqueId();
@@ -383,32 +1045,140 @@ class XLATensor::DeviceContextArena {
     return devctx->running_seed;
   }
 
+  ir::Value GetRngSeed(const Device& device) {
+    DeviceContext* devctx = GetDeviceContext(device);
+    std::lock_guard<std::mutex> lock(devctx->lock);
+    if (!devctx->seed_ir_value) {
+      // The seed is fed as device data, so that stepping it does not change
+      // the graph hash.
+      xla::ComputationClient::DataPtr data = TensorToXlaData(
+          swift_xla::ToTensor(static_cast<xla::int64>(devctx->seed),
+                              at::ScalarType::Long),
+          device);
+      data->SetInfo(std::make_shared<DeviceDataInfo>(/*tensor_id=*/-1,
+                                                     /*read_only=*/true));
+      devctx->seed_ir_value =
+          ir::MakeNode<ir::ops::DeviceData>(std::move(data));
+    }
+    return devctx->seed_ir_value;
+  }
+
+  xla::uint64 GetNextRngStream(const Device& device) {
+    DeviceContext* devctx = GetDeviceContext(device);
+    std::lock_guard<std::mutex> lock(devctx->lock);
+    XLA_COUNTER("RngStreams", 1);
+    return devctx->rng_stream++;
+  }
+
   void SetRngSeed(const Device* device, xla::uint64 seed) {
     auto fn = [&](DeviceContext* devctx) {
       std::lock_guard<std::mutex> lock(devctx->lock);
       devctx->seed = seed;
       devctx->running_seed = devctx->seed;
+      devctx->rng_stream = 0;
       devctx->seed_ir_value = ir::Value();
     };
     ForAllDeviceContexts(fn, device);
   }
 
-  void StepRngSeed(const Device* device) {
+  void MarkStep(const Device* device) {
     auto fn = [&](DeviceContext* devctx) {
       std::lock_guard<std::mutex> lock(devctx->lock);
       devctx->seed = 1012031 + devctx->seed * 7012063;
       devctx->running_seed = devctx->seed;
+      devctx->rng_stream = 0;
       devctx->seed_ir_value = ir::Value();
+      devctx->scalars.clear();
+      ++devctx->step_count;
     };
     ForAllDeviceContexts(fn, device);
   }
 
+  // Returns the IR value of the scalar literal traced since the last step, or
+  // the one make_fn creates, which is kept while the device holds fewer than
+  // XLA_SCALAR_IR_CACHE_SIZE scalars.
+  ir::Value GetScalarIrValue(const Device& device, ScalarIrKey key,
+                             const std::function<ir::Value()>& make_fn) {
+    static const size_t max_scalars =
+        xla::sys_util::GetEnvInt("XLA_SCALAR_IR_CACHE_SIZE", 1024);
+    DeviceContext* devctx = GetDeviceContext(device);
+    {
+      std::lock_guard<std::mutex> lock(devctx->lock);
+      auto it = devctx->scalars.find(key);
+      if (it != devctx->scalars.end()) {
+        XLA_COUNTER("ScalarIrCacheHit", 1);
+        return it->second;
+      }
+    }
+    // Creating the value can upload it to the device, so it happens outside
+    // of the lock.
+    ir::Value ir_value = make_fn();
+    std::lock_guard<std::mutex> lock(devctx->lock);
+    if (devctx->scalars.size() < max_scalars) {
+      ir_value = devctx->scalars.emplace(std::move(key), ir_value)
+                     .first->second;
+    }
+    XLA_COUNTER("ScalarIrCacheMiss", 1);
+    return ir_value;
+  }
+
+  void SetNumericsGuard(const Device& device, std::shared_ptr<Data> guard) {
+    DeviceContext* devctx = GetDeviceContext(device);
+    std::lock_guard<std::mutex> lock(devctx->lock);
+    devctx->numerics_guard = std::move(guard);
+  }
+
+  std::shared_ptr<Data> GetNumericsGuard(const Device& device) {
+    DeviceContext* devctx = GetDeviceContext(device);
+    std::lock_guard<std::mutex> lock(devctx->lock);
+    return devctx->numerics_guard;
+  }
+
+  xla::int64 GetStepCount(const Device& device) {
+    DeviceContext* devctx = GetDeviceContext(device);
+    std::lock_guard<std::mutex> lock(devctx->lock);
+    return devctx->step_count;
+  }
+
  private:
+  static size_t GetThreadTensorShard() {
+    static std::atomic<size_t> next_shard(0);
+    thread_local size_t shard = next_shard++ % kNumTensorShards;
+    return shard;
+  }
+
+  static DeviceContexts CreateDeviceContexts() {
+    DeviceContexts device_contexts;
+    for (const std::string& device_string :
+         xla::ComputationClient::AllDevices()) {
+      swift_xla::Device device(device_string);
+      device_contexts.emplace(device, new DeviceContext);
+    }
+    return device_contexts;
+  }
+
+  // The device contexts of the default trace context are created upfront, and
+  // looked up without locking.
+  DeviceContexts* GetTraceDeviceContexts(xla::int64 trace_context) {
+    if (trace_context == 0) {
+      return &device_contexts_;
+    }
+    std::lock_guard<std::mutex> lock(trace_contexts_lock_);
+    auto it = trace_device_contexts_.find(trace_context);
+    if (it == trace_device_contexts_.end()) {
+      it = trace_device_contexts_
+               .emplace(trace_context, CreateDeviceContexts())
+               .first;
+    }
+    return &it->second;
+  }
+
   std::vector<DeviceContext*> GetAllDeviceContexts() {
+    DeviceContexts* device_contexts = GetTraceDeviceContexts(g_trace_context);
     std::vector<DeviceContext*> all_device_contexts;
-    all_device_contexts.reserve(device_contexts_.size());
-    for (auto& device_contexts : device_contexts_) {
-      all_device_contexts.push_back(device_contexts.second);
+    all_device_contexts.reserve(device_contexts->size());
+    for (auto& device_context : *device_contexts) {
+      all_device_contexts.push_back(device_context.second);
     }
     return all_device_contexts;
   }
@@ -424,26 +1194,35 @@ class XLATensor::DeviceContextArena {
     }
   }
 
-  DeviceContext* GetDeviceContext(const Device& device) {
-    auto it = device_contexts_.find(device);
-    XLA_CHECK(it != device_contexts_.end())
+  DeviceContext* GetDeviceContext(const Device& device,
+                                  xla::int64 trace_context) {
+    DeviceContexts* device_contexts = GetTraceDeviceContexts(trace_context);
+    auto it = device_contexts->find(device);
+    XLA_CHECK(it != device_contexts->end())
         << "No such device: " << device.ToString();
     return it->second;
   }
 
-  absl::flat_hash_map<Device, DeviceContext*, HashDevice> device_contexts_;
-};
-
-struct DeviceDataInfo : public xla::ComputationClient::Data::Info {
-  DeviceDataInfo(xla::int64 tensor_id, bool read_only)
-      : tensor_id(tensor_id), read_only(read_only) {}
+  DeviceContext* GetDeviceContext(const Device& device) {
+    return GetDeviceContext(device, g_trace_context);
+  }
 
-  xla::int64 tensor_id = 0;
-  bool read_only = false;
+  DeviceContexts device_contexts_;
+  std::mutex trace_contexts_lock_;
+  // The device contexts of the other trace contexts, which are never
+  // destroyed, so that the pointers handed out stay valid.
+  std::map<xla::int64, DeviceContexts> trace_device_contexts_;
 };
 
 XLATensor::Data::~Data() { DeviceContextArena::Get()->UnregisterTensor(this); }
 
+void XLATensor::Data::ResetXlaData() {
+  if (xla_data != nullptr) {
+    xla_data = nullptr;
+    DeviceContextArena::Get()->MarkPending(*this);
+  }
+}
+
 XLATensor::Async::Async(
     SyncTensorCollection* coll,
     std::vector<xla::ComputationClient::DataPtr> parameters_data,
@@ -502,29 +1281,40 @@ XLATensor XLATensor::Create(
 XLATensor XLATensor::Create(
     ir::Value ir_value, const Device& device,
     c10::optional<at::ScalarType> logical_element_type) {
+  ir_value =
+      MaybeRunOnHost(std::move(ir_value), device, logical_element_type);
   XLATensor xtensor(std::move(ir_value), device, logical_element_type);
   DeviceContextArena::Get()->RegisterTensor(xtensor.data_ptr());
   return xtensor;
 }
 
 XLATensor::XLATensor(const at::Tensor& tensor, const Device& device)
-    : data_(std::make_shared<Data>(tensor, device)) {}
+    : data_(MakeData(tensor, device)) {}
 
 XLATensor::XLATensor(xla::ComputationClient::DataPtr xla_data,
                      c10::optional<at::ScalarType> logical_element_type)
-    : data_(std::make_shared<Data>(xla_data,
+    : data_(MakeData(xla_data,
                                    Device(xla_data->device()->device_id()),
                                    logical_element_type)) {}
 
 XLATensor::XLATensor(ir::Value ir_value, const Device& device,
                      c10::optional<at::ScalarType> logical_element_type)
-    : data_(std::make_shared<Data>(std::move(ir_value), device,
+    : data_(MakeData(std::move(ir_value), device,
                                    logical_element_type)) {
   TryLimitGraphSize();
 }
 
 XLATensor::XLATensor(std::shared_ptr<Data> data) : data_(std::move(data)) {}
 
+template <typename... Args>
+std::shared_ptr<XLATensor::Data> XLATensor::MakeData(Args&&... args) {
+  if (UseTensorHandleArena()) {
+    return std::allocate_shared<Data>(ir::NodeAllocator<Data>(),
+                                      std::forward<Args>(args)...);
+  }
+  return std::make_shared<Data>(std::forward<Args>(args)...);
+}
+
 XLATensor::Data* XLATensor::data() const {
   XLA_CHECK(data_ != nullptr) << "Trying to access a null cursor";
   return data_.get();
@@ -548,6 +1338,9 @@ at::ScalarType XLATensor::physical_scalar_type() const {
 
 xla::util::MaybeRef<xla::Shape> XLATensor::shape() const {
   if (data()->xla_data != nullptr) {
+    if (data()->xla_data->sharding() != nullptr) {
+      return data()->xla_data->sharding()->shape;
+    }
     return data()->xla_data->shape();
   }
   if (data()->ir_value) {
@@ -580,6 +1373,7 @@ xla::ComputationClient::DataPtr XLATensor::GetXlaData() {
       XLA_CHECK(xla_data->HasValue())
           << "Trying to access XLA data while an async operation is in flight: "
           << xla_data->shape();
+      data()->last_use = NextUseTick();
       return xla_data;
     }
   }
@@ -591,7 +1385,17 @@ xla::ComputationClient::DataPtr XLATensor::GetXlaData() {
   } else {
     XLA_CHECK(data()->tensor_data);
     data()->xla_data = TensorToXlaData(*data()->tensor_data, GetDevice());
+    if (data()->evicted) {
+      data()->evicted = false;
+      XLA_COUNTER("RestoredTensors", 1);
+    } else if (DropUploadedHostData() && !data()->keep_host_data &&
+               !IsCacheableTensorSize(
+                   data()->tensor_data->buffer().raw_size())) {
+      data()->tensor_data.reset();
+      XLA_COUNTER("DroppedHostData", 1);
+    }
   }
+  data()->last_use = NextUseTick();
   return data()->xla_data;
 }
 
@@ -623,13 +1427,13 @@ void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data,
   // trimming.
   AssignIrValue(ir::Value());
   if (sync) {
-    data()->tensor_data = absl::nullopt;
+    data()->tensor_data.reset();
   }
 }
 
 void XLATensor::SetIrValue(ir::Value ir_value) {
-  data()->xla_data = nullptr;
-  data()->tensor_data = absl::nullopt;
+  data()->ResetXlaData();
+  data()->tensor_data.reset();
   AssignIrValue(std::move(ir_value));
   TryLimitGraphSize();
 }
@@ -649,22 +1453,59 @@ void XLATensor::AssignIrValue(ir::Value ir_value) const {
 }
 
 void XLATensor::TryLimitGraphSize() {
-  if (ApplyTraceletCutpoint()) {
+  if (ApplyEagerDispatch() || ApplyTraceletCutpoint()) {
     return;
   }
+  if (!data()->ir_value) {
+    return;
+  }
+  // Cuts are only taken at nodes whose hash lands on a stable boundary, or at
+  // nodes which have been cut at before. Since the node hash depends only on
+  // the structure of the graph, the same trace gets cut at the same points at
+  // every step, and the resulting graphs hit the compilation cache.
   static const size_t kCheckFrequency =
       xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_CHECK_FREQUENCY", 5000);
   static const size_t kMaxPendingGraphSize =
       xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_SIZE", 100000);
-  if (data()->ir_value && ++g_tls_data.trim_counter % kCheckFrequency == 0) {
+  static const size_t kBoundaryModulus = std::max<size_t>(
+      xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_BOUNDARY_MODULUS", 64), 1);
+  xla::hash_t hash = data()->ir_value.node->hash();
+  if (g_graph_cut_state.cut_hashes.count(hash) > 0) {
+    XLA_COUNTER("TrimIrGraphReusedCut", 1);
+    CutPendingGraph(hash);
+    return;
+  }
+  if (g_tls_data.trim_armed) {
+    bool boundary = static_cast<size_t>(hash % kBoundaryModulus) == 0;
+    if (boundary || ++g_tls_data.trim_armed_counter >= kCheckFrequency) {
+      if (!boundary) {
+        // No boundary node showed up in a reasonable time, cut anyway to
+        // bound the graph size.
+        XLA_COUNTER("TrimIrGraphForcedCut", 1);
+      }
+      CutPendingGraph(hash);
+    }
+    return;
+  }
+  if (++g_tls_data.trim_counter % kCheckFrequency == 0) {
     size_t graph_size = ir::Util::GetGraphSize({data()->ir_value.node.get()});
     if (graph_size > kMaxPendingGraphSize) {
-      XLA_COUNTER("TrimIrGraph", 1);
-      ApplyPendingGraph();
+      g_tls_data.trim_armed = true;
+      g_tls_data.trim_armed_counter = 0;
     }
   }
 }
 
+void XLATensor::CutPendingGraph(xla::hash_t hash) {
+  XLA_COUNTER("TrimIrGraph", 1);
+  g_graph_cut_state.cut_hashes.insert(hash);
+  XLA_VALUE_METRIC("TrimIrGraphCutHashes",
+                   g_graph_cut_state.cut_hashes.size());
+  g_tls_data.trim_armed = false;
+  g_tls_data.trim_armed_counter = 0;
+  ApplyPendingGraph();
+}
+
 ir::Value XLATensor::GetIrValue() const {
   ir::Value ir_value = CurrentIrValue();
   if (ir_value) {
@@ -679,10 +1520,51 @@ ir::Value XLATensor::GetIrValue() const {
     // which wants the XLA data will still find it, w/out having to fetch it via
     // a computation client from-server call.
     AssignIrValue(CreateTensorNode(xla_data, /*read_only=*/false));
+    data()->last_use = NextUseTick();
     return data()->ir_value;
   }
   c10::optional<at::Tensor> tensor_data = CurrentTensorData();
   XLA_CHECK(tensor_data);
+  if (data()->evicted) {
+    // The host copy is kept, so evicting the restored device data again does
+    // not need to fetch it.
+    data()->xla_data = TensorToXlaData(*tensor_data, GetDevice());
+    data()->evicted = false;
+    data()->last_use = NextUseTick();
+    XLA_COUNTER("RestoredTensors", 1);
+    AssignIrValue(CreateTensorNode(data()->xla_data, /*read_only=*/false));
+    return data()->ir_value;
+  }
+  if (tensor_data->rank() > 0 &&
+      !IsCacheableTensorSize(tensor_data->buffer().raw_size()) &&
+      ShouldNarrowLongTensor(*tensor_data, GetDevice())) {
+    // The narrowed device data is kept along the host copy, so that the
+    // physical type of the tensor is the 32 bit one.
+    xla::Shape shape =
+        CreateComputationShapeFromTensor(*tensor_data, &GetDevice());
+    shape.set_element_type(xla::PrimitiveType::S32);
+    data()->xla_data = TensorToXlaData(*tensor_data, shape, GetDevice());
+    data()->last_use = NextUseTick();
+    XLA_COUNTER("NarrowedLongUploads", 1);
+    AssignIrValue(CreateTensorNode(data()->xla_data, /*read_only=*/false));
+    return data()->ir_value;
+  }
+  if (tensor_data->rank() > 0 &&
+      !IsCacheableTensorSize(tensor_data->buffer().raw_size()) &&
+      DropUploadedHostData() && !data()->keep_host_data) {
+    // The upload is done once TensorToXlaData() returns, so the device data
+    // becomes the only copy, and the host one (which may reference the Swift
+    // buffer) is released. Reading the tensor back fetches it again.
+    {
+      XLA_TIMED("IrValueTensorToXlaData");
+      data()->xla_data = TensorToXlaData(*tensor_data, GetDevice());
+    }
+    data()->tensor_data.reset();
+    data()->last_use = NextUseTick();
+    XLA_COUNTER("DroppedHostData", 1);
+    AssignIrValue(CreateTensorNode(data()->xla_data, /*read_only=*/false));
+    return data()->ir_value;
+  }
   AssignIrValue(GetIrValueForTensor(*tensor_data, GetDevice()));
   return data()->ir_value;
 }
@@ -692,17 +1574,23 @@ ir::Value XLATensor::CurrentIrValue() const {
 }
 
 void XLATensor::SetTensorData(at::Tensor tensor_data) {
-  data()->tensor_data = std::move(tensor_data);
+  data()->SetTensorData(std::move(tensor_data));
 }
 
+void XLATensor::KeepHostData() { data()->keep_host_data = true; }
+
 c10::optional<at::Tensor> XLATensor::CurrentTensorData() const {
-  return data()->tensor_data;
+  if (data()->tensor_data == nullptr) {
+    return c10::nullopt;
+  }
+  return *data()->tensor_data;
 }
 
 ir::Value XLATensor::GetIrValueForTensor(const at::Tensor& tensor,
                                          const Device& device) const {
   xla::ComputationClient::DataPtr data;
   bool read_only = false;
+  c10::optional<at::Tensor> host_value;
   if (tensor.rank() == 0) {
     at::Scalar value = tensor.item();
     if (IsSpecialScalar(value)) {
@@ -712,24 +1600,23 @@ ir::Value XLATensor::GetIrValueForTensor(const at::Tensor& tensor,
     }
     data = GetDeviceData(tensor, device);
     read_only = true;
+    host_value = tensor;
+  } else if (IsCacheableTensorSize(tensor.buffer().raw_size())) {
+    // Cached device data is shared, so it must not be donated.
+    data = GetDeviceData(tensor, device);
+    read_only = true;
   } else {
     XLA_TIMED("IrValueTensorToXlaData");
     data = TensorToXlaData(tensor, device);
   }
-  return CreateTensorNode(std::move(data), read_only);
+  return CreateTensorNode(std::move(data), read_only, std::move(host_value));
 }
 
 ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
                                          xla::PrimitiveType type,
                                          const Device& device) {
-  if (IsSpecialScalar(value)) {
-    return ir::ops::ScalarOp(std::move(value), type);
-  }
-  xla::ComputationClient::DataPtr data =
-      GetDeviceData(value, TensorTypeFromXlaType(type), device);
-  data->SetInfo(
-      std::make_shared<DeviceDataInfo>(/*tensor_id=*/-1, /*read_only=*/true));
-  return ir::MakeNode<ir::ops::DeviceData>(std::move(data));
+  return GetIrValueForScalar(value, type, absl::Span<const xla::int64>(),
+                             device);
 }
 
 ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
@@ -741,16 +1628,37 @@ ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
 ir::Value XLATensor::GetIrValueForScalar(
     at::Scalar value, xla::PrimitiveType type,
     absl::Span<const xla::int64> dimensions, const Device& device) {
-  ir::Value ir_value = GetIrValueForScalar(value, type, device);
-  if (!dimensions.empty()) {
-    ir_value = ir::MakeNode<ir::ops::Expand>(
-        ir_value, xla::util::ToVector<xla::int64>(dimensions));
+  ScalarIrKey key{value.isFloatingPoint(), 0, type,
+                  xla::util::ToVector<xla::int64>(dimensions)};
+  if (key.floating_point) {
+    double scalar_value = value.toDouble();
+    std::memcpy(&key.bits, &scalar_value, sizeof(key.bits));
+  } else {
+    key.bits = value.toLong();
   }
-  return ir_value;
-}
-
-ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
-                                         const xla::Shape& shape,
+  auto make_fn = [&]() {
+    ir::Value ir_value;
+    if (IsSpecialScalar(value)) {
+      ir_value = ir::ops::ScalarOp(value, type);
+    } else {
+      at::Tensor tensor = ToTensor(value, TensorTypeFromXlaType(type));
+      xla::ComputationClient::DataPtr data = GetDeviceData(tensor, device);
+      data->SetInfo(std::make_shared<DeviceDataInfo>(
+          /*tensor_id=*/-1, /*read_only=*/true, std::move(tensor)));
+      ir_value = ir::MakeNode<ir::ops::DeviceData>(std::move(data));
+    }
+    if (!dimensions.empty()) {
+      ir_value = ir::MakeNode<ir::ops::Expand>(
+          ir_value, xla::util::ToVector<xla::int64>(dimensions));
+    }
+    return ir_value;
+  };
+  return DeviceContextArena::Get()->GetScalarIrValue(device, std::move(key),
+                                                     make_fn);
+}
+
+ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
+                                         const xla::Shape& shape,
                                          const Device& device) {
   return GetIrValueForScalar(value, shape.element_type(), shape.dimensions(),
                              device);
@@ -770,10 +1678,17 @@ at::Tensor XLATensor::ToTensor(bool detached) {
   at::Tensor tensor(std::unique_ptr<at::AnyScalarBuffer>(nullptr), {});
   c10::optional<at::Tensor> tensor_data = CurrentTensorData();
   if (!tensor_data) {
-    DeviceBarrier(GetDevice());
-    // The GetXlaData() call will trigger an ApplyPendingGraph() if an IR Node
-    // is available on the tensor.
-    std::vector<at::Tensor> tensors = XlaDataToTensors({GetXlaData()}, dtype());
+    DeviceBarrier(GetDevice(), data()->trace_context);
+    std::vector<at::Tensor> tensors;
+    if (IsShardedTensor(*this)) {
+      // Only a graph gathering the shards can fetch the whole tensor.
+      std::vector<XLATensor> sharded_tensors({*this});
+      tensors = GetTensorsFused(&sharded_tensors);
+    } else {
+      // The GetXlaData() call will trigger an ApplyPendingGraph() if an IR
+      // Node is available on the tensor.
+      tensors = XlaDataToTensors({GetXlaData()}, dtype());
+    }
     tensor = std::move(tensors.front());
     if (!detached) {
       SetTensorData(tensor);
@@ -784,7 +1699,7 @@ at::Tensor XLATensor::ToTensor(bool detached) {
       if (data()->ir_value || data()->xla_data != nullptr) {
         // If we have other authoritive sources, just drop our reference and
         // transfer it to the caller.
-        data()->tensor_data = absl::nullopt;
+        data()->tensor_data.reset();
       } else {
         // Otherwise we need to make a copy to prevent the caller changing our
         // version.
@@ -795,6 +1710,119 @@ at::Tensor XLATensor::ToTensor(bool detached) {
   return tensor;
 }
 
+std::shared_future<at::Tensor> XLATensor::ToTensorAsync() {
+  auto promise = std::make_shared<std::promise<at::Tensor>>();
+  std::shared_future<at::Tensor> future = promise->get_future().share();
+  c10::optional<at::Tensor> tensor_data = CurrentTensorData();
+  if (tensor_data) {
+    promise->set_value(std::move(*tensor_data));
+    return future;
+  }
+  if (CurrentXlaData() == nullptr) {
+    std::vector<XLATensor> tensors({*this});
+    SyncTensorsGraph(&tensors, {}, /*wait=*/false, /*sync_xla_data=*/false);
+  }
+  // The data might still be a placeholder for the computation just scheduled,
+  // so the fetch is scheduled on the IO thread pool once the device unlocks,
+  // rather than having an IO thread wait on the device barrier.
+  xla::ComputationClient::DataPtr xla_data = CurrentXlaData();
+  XLA_CHECK(xla_data != nullptr);
+  XLA_COUNTER("ToTensorAsync", 1);
+  auto fetchfn = [promise, xla_data = std::move(xla_data),
+                  type = dtype()](std::exception_ptr exptr) {
+    try {
+      if (exptr != nullptr) {
+        std::rethrow_exception(exptr);
+      }
+      std::vector<at::Tensor> tensors = XlaDataToTensors({xla_data}, type);
+      promise->set_value(std::move(tensors.front()));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  };
+  WhenDeviceUnlocked(GetDevice(), data()->trace_context,
+                     [fetchfn = std::move(fetchfn)](std::exception_ptr exptr) {
+                       xla::env::ScheduleIoClosure(
+                           [fetchfn, exptr = std::move(exptr)]() {
+                             fetchfn(exptr);
+                           });
+                     });
+  return future;
+}
+
+std::string XLATensor::ExportDeviceData() {
+  ApplyPendingGraph();
+  xla::ComputationClient::DataPtr xla_data = CurrentXlaData();
+  XLA_CHECK(xla_data != nullptr);
+  xla::ComputationClient::Device* xla_device = xla::GetX10Device(GetDevice());
+  xla_device->WaitForTransfers({xla_data});
+  return xla_device->ExportData(xla_data);
+}
+
+void XLATensor::UnexportDeviceData(const Device& device,
+                                   const std::string& handle) {
+  xla::GetX10Device(device)->UnexportData(handle);
+}
+
+XLATensor XLATensor::ImportDeviceData(const std::string& handle,
+                                      at::ScalarType type,
+                                      absl::Span<const xla::int64> dimensions,
+                                      const Device& device) {
+  xla::Shape shape = MakeArrayShapeFromDimensions(
+      dimensions, /*dynamic_dimensions=*/{},
+      MakeXlaPrimitiveType(type, &device), device.hw_type);
+  return Create(xla::GetX10Device(device)->ImportData(handle, shape), type);
+}
+
+void XLATensor::Freeze(std::vector<XLATensor>* tensors) {
+  static const xla::int64 max_constant_bytes = xla::sys_util::GetEnvInt(
+      "XLA_FROZEN_CONSTANT_MAX_BYTES", 16 * 1024 * 1024);
+  SyncTensorsGraph(tensors, /*devices=*/{}, /*wait=*/true,
+                   /*sync_xla_data=*/true);
+  std::vector<XLATensor*> frozen;
+  std::vector<xla::ComputationClient::DataPtr> fetched_data;
+  std::vector<at::ScalarType> fetched_types;
+  std::vector<size_t> fetched_indices;
+  for (XLATensor& tensor : *tensors) {
+    ir::Value ir_value = tensor.CurrentIrValue();
+    if (ir_value && ir_value->op() == ir::OpKind(at::prim::Constant)) {
+      continue;
+    }
+    // Tensors with device data are left out of the syncs, which would
+    // otherwise compute the constant as an output, and replace it with the
+    // resulting device data.
+    xla::ComputationClient::DataPtr xla_data = tensor.GetXlaData();
+    if (xla_data->sharding() != nullptr ||
+        xla::ShapeUtil::ByteSizeOf(xla_data->shape()) > max_constant_bytes) {
+      // Sharded or too large to be embedded, the tensor stays a parameter of
+      // the graphs.
+      continue;
+    }
+    if (!tensor.CurrentTensorData()) {
+      fetched_indices.push_back(frozen.size());
+      fetched_data.push_back(std::move(xla_data));
+      fetched_types.push_back(tensor.dtype());
+    }
+    frozen.push_back(&tensor);
+  }
+  std::vector<at::Tensor> fetched =
+      XlaDataToTensors(fetched_data, fetched_types);
+  for (size_t i = 0; i < fetched_indices.size(); ++i) {
+    frozen[fetched_indices[i]]->SetTensorData(std::move(fetched[i]));
+  }
+  for (XLATensor* tensor : frozen) {
+    xla::Shape shape = tensor->shape().get();
+    xla::Literal literal = GetTensorLiteral(*tensor->CurrentTensorData(),
+                                            &shape, &tensor->GetDevice());
+    // The device data, if any, is kept for the reads of the tensor. Since the
+    // constant node hashes its value, the graphs using the frozen tensor get
+    // their own computation cache entries, and updating the tensor brings
+    // back the ones of the graphs using it as a parameter.
+    tensor->AssignIrValue(ir::MakeNode<ir::ops::Constant>(std::move(literal)));
+  }
+  XLA_COUNTER("FrozenTensors", frozen.size());
+}
+
 void XLATensor::ShallowCopyTo(XLATensor* dest) const {
   dest->SetIrValue(GetIrValue());
 }
@@ -811,15 +1839,17 @@ std::vector<XLATensor> XLATensor::GetLiveTensors(const Device* device) {
 std::vector<xla::ComputationClient::DataPtr> XLATensor::GatherTensorsXlaData(
     const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices,
     absl::Span<const xla::ComputationClient::DataPtr> tensors_data) {
+  // The indices are in the order of the synced graph outputs, not ascending.
+  std::vector<ssize_t> output_indices(tensors.size(), -1);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    output_indices[indices[i]] = i;
+  }
   std::vector<xla::ComputationClient::DataPtr> result_tensors_data;
-  size_t indices_index = 0;
   for (size_t i = 0; i < tensors.size(); ++i) {
-    if (indices_index < indices.size() && i == indices[indices_index]) {
-      // If we are at the current index (it means that the tensor at index
-      // 'i' had an IR node to sync, use the XLA data held within the Async
-      // object.
-      result_tensors_data.push_back(tensors_data[indices_index]);
-      ++indices_index;
+    if (output_indices[i] >= 0) {
+      // If the tensor at index 'i' had an IR node to sync, use the XLA data
+      // held within the Async object.
+      result_tensors_data.push_back(tensors_data[output_indices[i]]);
     } else if (!tensors[i].CurrentTensorData()) {
       xla::ComputationClient::DataPtr xla_data = tensors[i].CurrentXlaData();
       XLA_CHECK(xla_data != nullptr);
@@ -829,6 +1859,35 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::GatherTensorsXlaData(
   return result_tensors_data;
 }
 
+std::vector<at::Tensor> XLATensor::FetchTensors(
+    const std::vector<XLATensor>& tensors,
+    absl::Span<const xla::ComputationClient::DataPtr> tensors_data) {
+  std::vector<c10::optional<at::Tensor>> tensors_host_data;
+  std::vector<at::ScalarType> element_types;
+  tensors_host_data.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    tensors_host_data.push_back(tensor.CurrentTensorData());
+    if (!tensors_host_data.back()) {
+      element_types.push_back(tensor.dtype());
+    }
+  }
+  std::vector<at::Tensor> fetched =
+      XlaDataToTensors(tensors_data, element_types);
+  std::vector<at::Tensor> results;
+  size_t fetched_index = 0;
+  results.reserve(tensors.size());
+  for (auto& tensor_data : tensors_host_data) {
+    if (tensor_data) {
+      results.push_back(std::move(*tensor_data));
+    } else {
+      XLA_CHECK_LT(fetched_index, fetched.size());
+      results.push_back(std::move(fetched[fetched_index]));
+      ++fetched_index;
+    }
+  }
+  return results;
+}
+
 std::vector<at::Tensor> XLATensor::GetTensorsOpByOp(
     std::vector<XLATensor>* tensors) {
   SyncTensorsConfig config;
@@ -846,65 +1905,232 @@ std::vector<at::Tensor> XLATensor::GetTensorsOpByOp(
 
   std::vector<xla::ComputationClient::DataPtr> tensors_data =
       GatherTensorsXlaData(*tensors, coll.indices, async_tensors_data);
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::TransferFromServer(tensors_data);
-  std::vector<at::Tensor> results;
-  size_t literals_index = 0;
-  results.reserve(tensors->size());
-  for (size_t i = 0; i < tensors->size(); ++i) {
-    c10::optional<at::Tensor> tensor_data = (*tensors)[i].CurrentTensorData();
-    if (tensor_data) {
-      results.push_back(*tensor_data);
-    } else {
-      XLA_CHECK_LT(literals_index, literals.size());
-      results.push_back(MakeTensorFromXlaLiteral(literals[literals_index],
-                                                 (*tensors)[i].dtype()));
-      ++literals_index;
-    }
-  }
-  return results;
+  return FetchTensors(*tensors, tensors_data);
 }
 
 std::vector<at::Tensor> XLATensor::GetTensors(std::vector<XLATensor>* tensors) {
   static const bool op_by_op =
       xla::sys_util::GetEnvBool("XLA_GET_TENSORS_OPBYOP", false);
-  return op_by_op ? GetTensorsOpByOp(tensors) : GetTensorsFused(tensors);
+  std::vector<at::Tensor> results;
+  if (GetTensorsOnHost(tensors, &results)) {
+    return results;
+  }
+  if (op_by_op) {
+    return GetTensorsOpByOp(tensors);
+  }
+  std::vector<XLATensor> guarded_tensors;
+  if (!AppendNumericsGuard(*tensors, &guarded_tensors)) {
+    return GetTensorsFused(tensors);
+  }
+  // The guard is fetched along with the values, packed with the other
+  // pending boolean scalars, and kept on the host.
+  results = GetTensorsFused(&guarded_tensors);
+  guarded_tensors.back().SetTensorData(std::move(results.back()));
+  results.pop_back();
+  return results;
+}
+
+bool XLATensor::AppendNumericsGuard(const std::vector<XLATensor>& tensors,
+                                    std::vector<XLATensor>* guarded_tensors) {
+  static const bool numerics_guard =
+      xla::sys_util::GetEnvBool("XLA_NUMERICS_GUARD", false);
+  if (!numerics_guard) {
+    return false;
+  }
+  std::vector<ir::Value> values;
+  const XLATensor* guarded = nullptr;
+  for (const XLATensor& tensor : tensors) {
+    ir::Value ir_value = tensor.CurrentIrValue();
+    if (tensor.CurrentXlaData() != nullptr || !ir_value ||
+        !ShouldSyncIrValue(ir_value) ||
+        ir::ops::DeviceData::Cast(ir_value.node.get()) != nullptr ||
+        !xla::primitive_util::IsFloatingPointType(
+            ir_value.shape().element_type())) {
+      continue;
+    }
+    values.push_back(std::move(ir_value));
+    guarded = &tensor;
+  }
+  if (values.empty()) {
+    return false;
+  }
+  XLATensor guard =
+      guarded->CreateFrom(ir::ops::AllFinite(values), at::ScalarType::Bool);
+  DeviceContextArena::Get()->SetNumericsGuard(guard.GetDevice(),
+                                              guard.data_ptr());
+  *guarded_tensors = tensors;
+  guarded_tensors->push_back(std::move(guard));
+  XLA_COUNTER("NumericsGuards", 1);
+  return true;
+}
+
+XLATensor XLATensor::NumericsGuard(const Device& device) {
+  std::shared_ptr<Data> guard =
+      DeviceContextArena::Get()->GetNumericsGuard(device);
+  if (guard == nullptr) {
+    return Create(at::Scalar(static_cast<int64_t>(1)), at::ScalarType::Bool,
+                  device);
+  }
+  return XLATensor(std::move(guard));
+}
+
+bool XLATensor::GetTensorsOnHost(std::vector<XLATensor>* tensors,
+                                 std::vector<at::Tensor>* results) {
+  std::vector<ir::Value> roots;
+  std::vector<size_t> indices;
+  for (size_t i = 0; i < tensors->size(); ++i) {
+    const XLATensor& tensor = (*tensors)[i];
+    ir::Value ir_value = tensor.CurrentIrValue();
+    if (ir_value && ir::ops::DeviceData::Cast(ir_value.node.get()) == nullptr) {
+      roots.push_back(std::move(ir_value));
+      indices.push_back(i);
+    } else if (!tensor.CurrentTensorData()) {
+      return false;
+    }
+  }
+  if (roots.empty()) {
+    return false;
+  }
+  auto host_value_fn = [](const xla::ComputationClient::Data& data)
+      -> absl::optional<xla::Literal> {
+    const DeviceDataInfo* info = dynamic_cast<DeviceDataInfo*>(data.info());
+    if (info == nullptr || !info->host_value) {
+      return absl::nullopt;
+    }
+    return GetTensorLiteral(*info->host_value, &data.shape(), nullptr);
+  };
+  absl::optional<std::vector<xla::Literal>> values = ir::EvaluateOnHost(
+      roots, (*tensors)[indices.front()].GetDevice(), host_value_fn);
+  if (!values) {
+    return false;
+  }
+  for (size_t i = 0; i < indices.size(); ++i) {
+    XLATensor& tensor = (*tensors)[indices[i]];
+    at::Tensor value = MakeTensorFromXlaLiteral((*values)[i], tensor.dtype());
+    // Like a sync, the value replaces the pending graph of the tensor.
+    tensor.data()->ResetXlaData();
+    tensor.AssignIrValue(ir::Value());
+    tensor.SetTensorData(std::move(value));
+  }
+  results->clear();
+  for (const XLATensor& tensor : *tensors) {
+    results->push_back(*tensor.CurrentTensorData());
+  }
+  return true;
 }
 
 std::vector<at::Tensor> XLATensor::GetTensorsFused(
     std::vector<XLATensor>* tensors) {
+  // The sharded tensors are fetched through replicated copies, for which the
+  // SPMD partitioner gathers the shards.
+  std::vector<XLATensor> unsharded_tensors;
+  for (size_t i = 0; i < tensors->size(); ++i) {
+    const XLATensor& tensor = (*tensors)[i];
+    if (!IsShardedTensor(tensor)) {
+      continue;
+    }
+    if (unsharded_tensors.empty()) {
+      unsharded_tensors = *tensors;
+    }
+    unsharded_tensors[i] = tensor.CreateFrom(ir::MakeNode<ir::ops::Sharding>(
+        tensor.GetIrValue(), CreateReplicatedSharding()));
+  }
+  if (!unsharded_tensors.empty()) {
+    tensors = &unsharded_tensors;
+  }
+  // The pending scalars of each type also get stacked into a vector by the
+  // synced graph, and come back with a single transfer of it.
+  std::vector<std::vector<size_t>> packs = GroupPendingScalars(*tensors);
+  std::vector<XLATensor> synced_tensors = *tensors;
+  // The pack of each tensor, and its position in it, or -1.
+  std::vector<ssize_t> pack_indices(tensors->size(), -1);
+  std::vector<size_t> pack_positions(tensors->size(), 0);
+  for (size_t i = 0; i < packs.size(); ++i) {
+    std::vector<ir::Value> values;
+    for (size_t j = 0; j < packs[i].size(); ++j) {
+      values.push_back((*tensors)[packs[i][j]].GetIrValue());
+      pack_indices[packs[i][j]] = i;
+      pack_positions[packs[i][j]] = j;
+    }
+    synced_tensors.push_back(
+        (*tensors)[packs[i].front()].CreateFrom(PackScalars(values)));
+    XLA_COUNTER("PackedScalarFetches", values.size());
+  }
   SyncTensorsConfig config;
   config.force_xla_data = false;
-  auto async = SyncTensorsGraphInternal(tensors, {}, config);
+  auto async = SyncTensorsGraphInternal(&synced_tensors, {}, config);
   if (async != nullptr) {
     async->mwait.Wait();
   }
   std::vector<xla::ComputationClient::DataPtr> tensors_data =
       GatherTensorsXlaData(
-          *tensors,
+          synced_tensors,
           async != nullptr ? async->indices : absl::Span<const size_t>(),
           async != nullptr
               ? async->tensors_data
               : absl::Span<const xla::ComputationClient::DataPtr>());
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::TransferFromServer(tensors_data);
+  if (packs.empty()) {
+    return FetchTensors(synced_tensors, tensors_data);
+  }
+  // Fetches the tensors outside of the packs, then the packs.
+  std::vector<XLATensor> fetched_tensors;
+  std::vector<xla::ComputationClient::DataPtr> fetched_data;
+  size_t data_index = 0;
+  for (size_t i = 0; i < synced_tensors.size(); ++i) {
+    bool has_data = !synced_tensors[i].CurrentTensorData();
+    if (i < pack_indices.size() && pack_indices[i] >= 0) {
+      data_index += has_data ? 1 : 0;
+      continue;
+    }
+    fetched_tensors.push_back(synced_tensors[i]);
+    if (has_data) {
+      fetched_data.push_back(tensors_data[data_index]);
+      ++data_index;
+    }
+  }
+  std::vector<at::Tensor> fetched =
+      FetchTensors(fetched_tensors, fetched_data);
+  size_t num_unpacked = fetched.size() - packs.size();
   std::vector<at::Tensor> results;
-  size_t literals_index = 0;
   results.reserve(tensors->size());
+  size_t unpacked_index = 0;
   for (size_t i = 0; i < tensors->size(); ++i) {
-    c10::optional<at::Tensor> tensor_data = (*tensors)[i].CurrentTensorData();
-    if (tensor_data) {
-      results.push_back(*tensor_data);
+    if (pack_indices[i] >= 0) {
+      results.push_back(UnpackScalar(fetched[num_unpacked + pack_indices[i]],
+                                     pack_positions[i]));
     } else {
-      XLA_CHECK_LT(literals_index, literals.size());
-      results.push_back(MakeTensorFromXlaLiteral(literals[literals_index],
-                                                 (*tensors)[i].dtype()));
-      ++literals_index;
+      results.push_back(std::move(fetched[unpacked_index]));
+      ++unpacked_index;
     }
   }
   return results;
 }
 
+std::vector<xla::ComputationClient::DataPtr> XLATensor::SnapshotTensorsData(
+    std::vector<XLATensor>* tensors, std::function<void()>* wait_fn) {
+  SyncTensorsConfig config;
+  std::shared_ptr<Async> async = SyncTensorsGraphInternal(tensors, {}, config);
+  std::vector<xla::ComputationClient::DataPtr> tensors_data;
+  tensors_data.reserve(tensors->size());
+  for (XLATensor& tensor : *tensors) {
+    // With force_xla_data all the synced tensors hold device data, possibly a
+    // placeholder, and GetXlaData() only has to handle the device data nodes.
+    xla::ComputationClient::DataPtr xla_data = tensor.CurrentXlaData();
+    tensors_data.push_back(xla_data != nullptr ? std::move(xla_data)
+                                               : tensor.GetXlaData());
+  }
+  *wait_fn = [async, tensors_data]() {
+    if (async != nullptr) {
+      async->Wait();
+    }
+    // The tensors which were already device data may still be uploading.
+    for (const xla::ComputationClient::DataPtr& xla_data : tensors_data) {
+      xla_data->device()->WaitForTransfers({xla_data});
+    }
+  };
+  return tensors_data;
+}
+
 std::vector<XLATensor> XLATensor::CreateTensors(
     const std::vector<at::Tensor>& tensors,
     const std::vector<std::string>& devices) {
@@ -924,9 +2150,22 @@ std::vector<XLATensor> XLATensor::CreateTensors(
   return xla_tensors;
 }
 
-ir::Value XLATensor::CreateTensorNode(xla::ComputationClient::DataPtr data,
-                                      bool read_only) const {
-  data->SetInfo(std::make_shared<DeviceDataInfo>(GetUniqueId(), read_only));
+ir::Value XLATensor::CreateTensorNode(
+    xla::ComputationClient::DataPtr data, bool read_only,
+    c10::optional<at::Tensor> host_value) const {
+  // The data shared with other processes must keep its value.
+  read_only = read_only || data->IsShared();
+  auto info = std::make_shared<DeviceDataInfo>(GetUniqueId(), read_only,
+                                               std::move(host_value));
+  info->in_place = !read_only && this->data()->donate_in_place;
+  data->SetInfo(std::move(info));
+  if (IsNarrowedLongData(data->shape(), dtype(), GetDevice())) {
+    // The graphs see the Long values with their usual type, the conversion
+    // fusing into the operations which read them.
+    return ir::MakeNode<ir::ops::Cast>(
+        ir::MakeNode<ir::ops::DeviceData>(std::move(data)),
+        at::ScalarType::Long);
+  }
   return ir::MakeNode<ir::ops::DeviceData>(std::move(data));
 }
 
@@ -940,8 +2179,24 @@ std::vector<XLATensor> XLATensor::MakeOutputTensors(ir::NodePtr node) const {
 }
 
 XLATensor XLATensor::CopyTensorToDevice(const Device& device) {
-  // TODO: This can be optimized via proper XRT/XLA computation.
-  return Create(ToTensor(/*detached=*/true), device);
+  static const bool async_copy =
+      xla::sys_util::GetEnvBool("XLA_ASYNC_DEVICE_COPY", true);
+  if (!async_copy || CurrentTensorData() || IsShardedTensor(*this)) {
+    // TODO: This can be optimized via proper XRT/XLA computation.
+    return Create(ToTensor(/*detached=*/true), device);
+  }
+  // The pending graph of the tensor is scheduled on its device, and the copy
+  // goes through the host on the IO thread pool once it ran. The destination
+  // gets a placeholder, which the computations using it wait for, so neither
+  // device blocks the caller.
+  std::vector<XLATensor> tensors({*this});
+  std::function<void()> wait_fn;
+  xla::ComputationClient::DataPtr source_data =
+      SnapshotTensorsData(&tensors, &wait_fn).front();
+  return Create(
+      XlaDataToDeviceAsync(std::move(source_data), dtype(), std::move(wait_fn),
+                           device),
+      dtype());
 }
 
 XLATensor XLATensor::CreateFrom(ir::Value ir_value) const {
@@ -974,7 +2229,7 @@ XLATensor XLATensor::CreateFrom(ir::Value ir_value, const Device& device,
 }
 
 void XLATensor::ApplyPendingGraph() {
-  DeviceBarrier(GetDevice());
+  DeviceBarrier(GetDevice(), data()->trace_context);
   // This method is called to ensure that the tensor data is available on
   // device, so that a call to CurrentXlaData() returns a valid pointer.
   if (CurrentXlaData() == nullptr) {
@@ -985,9 +2240,13 @@ void XLATensor::ApplyPendingGraph() {
 
 XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
     const std::vector<XLATensor>& tensors, const SyncTensorsConfig& config) {
+  XLA_TRACE_SPAN("CollectSyncTensors");
+  XLA_STEP_TIMER(kSyncCollection);
   xla::util::Unique<Device> unique_device;
+  std::set<xla::int64> trace_contexts;
   for (size_t i = 0; i < tensors.size(); ++i) {
     unique_device.set(tensors[i].GetDevice());
+    trace_contexts.insert(tensors[i].data()->trace_context);
   }
   SyncTensorCollection coll;
   if (!unique_device) {
@@ -1006,18 +2265,18 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
              << " ...";
   {
     XLA_TIMED("DeviceLockWait");
-    coll.unlocker = LockDevices(unique_device.AsSet());
+    coll.unlocker = LockDevices(unique_device.AsSet(), trace_contexts);
   }
   TF_VLOG(4) << "Waiting on device barrier for device " << coll.device
              << " done!";
+  std::vector<std::pair<xla::hash_t, size_t>> root_hashes;
   for (size_t i = 0; i < tensors.size(); ++i) {
     if (tensors[i].CurrentXlaData() == nullptr) {
       ir::Value ir_value = tensors[i].CurrentIrValue();
       if (ir_value) {
         if (ShouldSyncIrValue(ir_value)) {
           // Add only tensors which need to be synced.
-          coll.hash = xla::util::HashCombine(coll.hash, ir_value.hash());
-          coll.indices.push_back(i);
+          root_hashes.emplace_back(ir_value.hash(), i);
         }
       } else if (config.force_xla_data) {
         // The tensor only has at::Tensor data. We need to queue it for a
@@ -1029,6 +2288,15 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
       }
     }
   }
+  // The roots are ordered by hash instead of by position within tensors, so
+  // that syncing the same values in a different order, or among different
+  // other tensors, builds the same graph, with the same parameter order. The
+  // outputs go back to their tensors through coll.indices.
+  std::sort(root_hashes.begin(), root_hashes.end());
+  for (const auto& hash_index : root_hashes) {
+    coll.hash = xla::util::HashCombine(coll.hash, hash_index.first);
+    coll.indices.push_back(hash_index.second);
+  }
   // Mix the hash with the resource domain hashes as compile handles are only
   // valid within a domain (usually a single host).
   coll.hash = xla::util::MHash(
@@ -1052,6 +2320,7 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
 
 XLATensor::ComputationCache::TypePtr XLATensor::LookupCachedCompile(
     const std::vector<XLATensor>& tensors, const xla::hash_t& hash) {
+  XLA_STEP_TIMER(kCacheLookup);
   ComputationCache::TypePtr cached_computation =
       GetComputationCache()->Get(hash);
   if (cached_computation == nullptr) {
@@ -1076,8 +2345,14 @@ std::shared_ptr<XLATensor::Async> XLATensor::TryRunCachedSync(
   if (cached_computation == nullptr) {
     return nullptr;
   }
-  XLA_VALUE_METRIC("TensorsGraphSize", po_data->post_order.size());
-  TF_VLOG(5) << "TensorsGraphSize=" << po_data->post_order.size();
+  XLA_VALUE_METRIC("TensorsGraphSize", cached_computation->graph_size);
+  TF_VLOG(5) << "TensorsGraphSize=" << cached_computation->graph_size;
+  if (ReplayLog::Get()->enabled()) {
+    ReplayLog::Get()->RecordSync(
+        coll->hash, coll->device.ToString(),
+        cached_computation->computation->computation(), /*compiled=*/false,
+        cached_computation->graph_size, po_data->parameters_data);
+  }
 
   return ScheduleSyncTensorsGraph(
       tensors, coll, std::move(po_data->parameters_data),
@@ -1087,11 +2362,14 @@ std::shared_ptr<XLATensor::Async> XLATensor::TryRunCachedSync(
 XLATensor::ComputationCache* XLATensor::GetComputationCache() {
   static const size_t kMaxCacheSize =
       xla::sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 1024);
-  static ComputationCache* cache = new ComputationCache(kMaxCacheSize);
+  static const size_t kMaxCacheBytes =
+      xla::sys_util::GetEnvInt("XLA_COMPILATION_CACHE_BYTES", 0);
+  static ComputationCache* cache =
+      new ComputationCache(kMaxCacheSize, kMaxCacheBytes);
   return cache;
 }
 
-XLATensor::PostOrderData XLATensor::RunPostOrder(
+std::vector<const ir::Node*> XLATensor::CollectRootNodes(
     const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices) {
   std::vector<const ir::Node*> roots;
   roots.reserve(indices.size());
@@ -1099,25 +2377,53 @@ XLATensor::PostOrderData XLATensor::RunPostOrder(
     ir::Value ir_value = tensors.at(index).CurrentIrValue();
     roots.push_back(ir_value.node.get());
   }
-  PostOrderData po_data;
-  po_data.post_order = ir::Util::ComputePostOrder(roots, &po_data.emission_map);
+  return roots;
+}
+
+void XLATensor::CollectParametersData(absl::Span<const ir::Node* const> nodes,
+                                      PostOrderData* po_data) {
   absl::node_hash_map<xla::ComputationClient::Data::OpaqueHandle, size_t>
       data_handles;
-  for (auto node : po_data.post_order) {
+  for (auto node : nodes) {
     const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
     if (device_data != nullptr) {
+      // Prefetched data only gets its handle once the upload is done, unless
+      // pipelined execution keys parameters by data object.
+      if (!xla::ComputationClient::PipelinedExecution()) {
+        device_data->data()->device()->WaitForTransfers({device_data->data()});
+      }
       xla::ComputationClient::Data::OpaqueHandle handle =
-          device_data->data()->GetOpaqueHandle();
+          LoweringContext::GetParameterKey(device_data->data());
       auto it = data_handles.find(handle);
       if (it != data_handles.end()) {
-        po_data.parameter_sequence.push_back(it->second);
+        po_data->parameter_sequence.push_back(it->second);
       } else {
-        po_data.parameter_sequence.push_back(po_data.parameters_data.size());
-        data_handles[handle] = po_data.parameters_data.size();
-        po_data.parameters_data.push_back(device_data->data());
+        po_data->parameter_sequence.push_back(po_data->parameters_data.size());
+        data_handles[handle] = po_data->parameters_data.size();
+        po_data->parameters_data.push_back(device_data->data());
       }
     }
   }
+}
+
+XLATensor::PostOrderData XLATensor::RunPostOrder(
+    const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices) {
+  XLA_TRACE_SPAN("RunPostOrder");
+  XLA_STEP_TIMER(kPostOrder);
+  std::vector<const ir::Node*> roots = CollectRootNodes(tensors, indices);
+  PostOrderData po_data;
+  po_data.post_order = ir::Util::ComputePostOrder(roots, &po_data.emission_map);
+  CollectParametersData(po_data.post_order, &po_data);
+  return po_data;
+}
+
+XLATensor::PostOrderData XLATensor::RunLeafOrder(
+    const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices) {
+  XLA_TRACE_SPAN("RunLeafOrder");
+  XLA_STEP_TIMER(kPostOrder);
+  std::vector<const ir::Node*> roots = CollectRootNodes(tensors, indices);
+  PostOrderData po_data;
+  CollectParametersData(ir::Util::ComputeLeafOrder(roots), &po_data);
   return po_data;
 }
 
@@ -1134,6 +2440,7 @@ std::vector<ir::Value> XLATensor::CollectRoots(
 std::vector<xla::ComputationClient::DataPtr> XLATensor::FetchTensorData(
     std::vector<XLATensor>* tensors, const SyncTensorsConfig& config,
     absl::Span<const size_t> indices) {
+  XLA_STEP_TIMER(kFetchTensorData);
   std::vector<xla::ComputationClient::DataPtr> tensors_data;
   tensors_data.reserve(indices.size());
   for (auto index : indices) {
@@ -1152,8 +2459,24 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::FetchTensorData(
       const Device& tensor_device = tensor.GetDevice();
       xla::Shape shape =
           MakeShapeWithDeviceLayout(tensor.shape(), tensor_device.hw_type);
-      xla_data = xla::GetX10Device(tensor_device)
-                     ->CreateDataPlaceholder(std::move(shape));
+      // A tiled sharding annotation at the root is the sharding of the
+      // result, and the device only gets its shard.
+      ir::Value ir_value = tensor.CurrentIrValue();
+      const ir::ops::Sharding* sharding =
+          ir_value ? ir::ops::Sharding::Cast(ir_value.node.get()) : nullptr;
+      if (sharding != nullptr &&
+          sharding->sharding().type() == xla::OpSharding::OTHER) {
+        xla_data = xla::GetX10Device(tensor_device)
+                       ->CreateDataPlaceholder(
+                           GetShardShape(shape, sharding->sharding()));
+        xla_data->set_sharding(
+            std::make_shared<xla::ComputationClient::Data::Sharding>(
+                xla::ComputationClient::Data::Sharding{sharding->sharding(),
+                                                       std::move(shape)}));
+      } else {
+        xla_data = xla::GetX10Device(tensor_device)
+                       ->CreateDataPlaceholder(std::move(shape));
+      }
       tensor.SetXlaData(xla_data, config.sync_xla_data);
     }
     tensors_data.emplace_back(std::move(xla_data));
@@ -1172,13 +2495,40 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
 
   auto syncfn = [async, hash = coll->hash]() {
     xla::ComputationClient::ExecuteComputationOptions options;
+    XLA_STEP_TIMER(kDispatch);
     try {
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " ...";
+      if (xla::ComputationClient::PipelinedExecution() &&
+          std::all_of(async->tensors_data.begin(), async->tensors_data.end(),
+                      [](const xla::ComputationClient::DataPtr& data) {
+                        return data != nullptr;
+                      })) {
+        // The device locks get released as soon as the execution is enqueued,
+        // and the users of the tensors data wait for it to be assigned. Only
+        // the enqueue time gets recorded in the execution profile.
+        xla::int64 start_ns = xla::sys_util::NowNs();
+        xla::GetX10Device(async->device)
+            ->ExecuteComputationPipelined(
+                async->cached_computation->computation,
+                async->parameters_data, async->tensors_data, options);
+        RecordExecutionProfile(hash, async->device,
+                               async->cached_computation->computation,
+                               xla::sys_util::NowNs() - start_ns);
+        MaybeScheduleOptimizedRecompile(hash, async->device,
+                                        async->cached_computation);
+        return;
+      }
+      xla::int64 start_ns = xla::sys_util::NowNs();
       auto results =
           xla::GetX10Device(async->device)
               ->ExecuteComputation(*async->cached_computation->computation,
                                    async->parameters_data, options);
+      RecordExecutionProfile(hash, async->device,
+                             async->cached_computation->computation,
+                             xla::sys_util::NowNs() - start_ns);
+      MaybeScheduleOptimizedRecompile(hash, async->device,
+                                      async->cached_computation);
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " done!";
 
@@ -1234,29 +2584,267 @@ void XLATensor::SyncTensorsGraph(std::vector<XLATensor>* tensors,
       async.Wait();
     }
   } else {
+    std::vector<XLATensor> guarded_tensors;
+    if (AppendNumericsGuard(*tensors, &guarded_tensors)) {
+      tensors = &guarded_tensors;
+    }
     auto async = SyncTensorsGraphInternal(tensors, devices, config);
     if (wait && async != nullptr) {
       async->mwait.Wait();
+      xla::GetX10Device(async->device)->WaitForTransfers(async->tensors_data);
     }
   }
 }
 
+void XLATensor::PrecompileTensorsGraphs(
+    absl::Span<const std::vector<XLATensor>* const> tensor_groups,
+    absl::Span<const std::string> devices, bool sync_xla_data) {
+  SyncTensorsConfig config;
+  config.sync_xla_data = sync_xla_data;
+  struct PendingCompile {
+    Device device;
+    xla::hash_t hash;
+    xla::XlaComputation computation;
+    size_t num_parameters;
+    size_t emitted_nodes;
+    bool persisted;
+  };
+  // Lowering walks the IR graphs, so it runs here, while the compilations run
+  // in parallel.
+  std::vector<PendingCompile> pending;
+  for (auto* tensors : tensor_groups) {
+    SyncTensorCollection coll = CollectSyncTensors(*tensors, config);
+    if (coll.indices.empty()) {
+      continue;
+    }
+    PostOrderData po_data = RunPostOrder(*tensors, coll.indices);
+    coll.hash = xla::util::HashCombine(
+        coll.hash, xla::util::Hash(po_data.parameter_sequence));
+    CollectDonatableParameters(&coll, &po_data);
+    MixReplicaSet(devices, &coll.hash);
+    if (GetComputationCache()->Get(coll.hash) != nullptr ||
+        !MarkCompilePending(coll.hash)) {
+      continue;
+    }
+    size_t emitted_nodes = 0;
+    bool persisted = false;
+    xla::XlaComputation computation =
+        BuildComputation(*tensors, coll, &po_data, &emitted_nodes, &persisted);
+    pending.push_back({coll.device, coll.hash, std::move(computation),
+                       po_data.parameters_data.size(), emitted_nodes,
+                       persisted});
+  }
+  XLA_COUNTER("PrecompiledGraphs", pending.size());
+
+  xla::util::MultiWait mwait(pending.size());
+  for (auto& compile : pending) {
+    auto compilefn = [&compile, devices]() {
+      xla::util::ExceptionCleanup clear_pending(
+          [&](xla::util::ExceptionCleanup::StatusType) {
+            ClearCompilePending(compile.hash);
+          });
+      GetComputationCache()->Add(
+          compile.hash,
+          CompileLowered(devices, compile.device, compile.hash,
+                         std::move(compile.computation), compile.num_parameters,
+                         compile.emitted_nodes,
+                         compile.persisted ? nullptr : GetPersistentCache()));
+    };
+    xla::env::ScheduleIoClosure(mwait.Completer(std::move(compilefn)));
+  }
+  mwait.Wait();
+}
+
+XLATensor XLATensor::CreatePlaceholder(
+    at::ScalarType type, absl::Span<const xla::int64> dimensions,
+    const Device& device) {
+  xla::Shape shape = MakeArrayShapeFromDimensions(
+      dimensions, /*dynamic_dimensions=*/{},
+      MakeXlaPrimitiveType(type, &device), device.hw_type);
+  return Create(
+      xla::GetX10Device(device)->CreateDataPlaceholder(std::move(shape)),
+      type);
+}
+
+void XLATensor::ExportTensorsGraphs(
+    absl::Span<const std::vector<XLATensor>* const> tensor_groups,
+    absl::Span<const std::string> devices, bool sync_xla_data,
+    const std::string& path) {
+  PrecompileTensorsGraphs(tensor_groups, devices, sync_xla_data);
+  SyncTensorsConfig config;
+  config.sync_xla_data = sync_xla_data;
+  std::vector<xla::util::ComputationBundleEntry> entries;
+  for (auto* tensors : tensor_groups) {
+    SyncTensorCollection coll = CollectSyncTensors(*tensors, config);
+    if (coll.indices.empty()) {
+      continue;
+    }
+    PostOrderData po_data = RunPostOrder(*tensors, coll.indices);
+    coll.hash = xla::util::HashCombine(
+        coll.hash, xla::util::Hash(po_data.parameter_sequence));
+    CollectDonatableParameters(&coll, &po_data);
+    MixReplicaSet(devices, &coll.hash);
+    ComputationCache::TypePtr cached_computation =
+        GetComputationCache()->Get(coll.hash);
+    XLA_CHECK(cached_computation != nullptr)
+        << "Graph hash " << xla::util::HexHash(coll.hash)
+        << " is still being compiled, or has been evicted from the cache";
+    const xla::XlaComputation& computation =
+        cached_computation->computation->computation();
+    xla::ProgramShape program_shape =
+        ConsumeValue(computation.GetProgramShape());
+    entries.push_back(
+        {coll.hash, coll.device.ToString(), computation,
+         MakeShapeWithDeviceLayout(program_shape.result(),
+                                   coll.device.hw_type),
+         cached_computation->graph_size});
+  }
+  XLA_CHECK_OK(xla::util::WriteComputationBundle(path, GetBuildFingerprint(),
+                                                 entries));
+  XLA_COUNTER("ExportedGraphs", entries.size());
+}
+
+void XLATensor::LoadComputationBundle(const std::string& path,
+                                      absl::Span<const std::string> devices) {
+  std::vector<xla::util::ComputationBundleEntry> entries = ConsumeValue(
+      xla::util::ReadComputationBundle(path, GetBuildFingerprint()));
+  std::vector<xla::util::ComputationBundleEntry*> pending;
+  for (auto& entry : entries) {
+    Device device(entry.device);
+    xla::ProgramShape program_shape =
+        ConsumeValue(entry.computation.GetProgramShape());
+    if (!xla::ShapeUtil::Equal(
+            MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type),
+            entry.result_shape)) {
+      // The layouts depend on the environment too, so the executable would not
+      // be the one the graph runs with here. Let the first step compile it.
+      TF_LOG(WARNING) << "Skipping graph hash "
+                      << xla::util::HexHash(entry.hash)
+                      << " of computation bundle " << path
+                      << ", whose result layout does not match this process";
+      XLA_COUNTER("BundledGraphLayoutMismatch", 1);
+      continue;
+    }
+    if (GetComputationCache()->Get(entry.hash) != nullptr ||
+        !MarkCompilePending(entry.hash)) {
+      continue;
+    }
+    pending.push_back(&entry);
+  }
+  XLA_COUNTER("LoadedBundledGraphs", pending.size());
+
+  xla::util::MultiWait mwait(pending.size());
+  for (auto* entry : pending) {
+    auto compilefn = [entry, devices]() {
+      xla::util::ExceptionCleanup clear_pending(
+          [&](xla::util::ExceptionCleanup::StatusType) {
+            ClearCompilePending(entry->hash);
+          });
+      size_t num_parameters = ConsumeValue(entry->computation.GetProgramShape())
+                                  .parameters_size();
+      GetComputationCache()->Add(
+          entry->hash,
+          CompileLowered(devices, Device(entry->device), entry->hash,
+                         std::move(entry->computation), num_parameters,
+                         entry->emitted_nodes, /*persistent_cache=*/nullptr));
+    };
+    xla::env::ScheduleIoClosure(mwait.Completer(std::move(compilefn)));
+  }
+  mwait.Wait();
+}
+
+void XLATensor::PrecompileForReplicaSet(
+    absl::Span<const std::string> devices,
+    absl::Span<const std::string> new_devices) {
+  XLA_CHECK(!new_devices.empty());
+  std::vector<xla::hash_t> hashes;
+  {
+    ReplicatedGraphs* graphs = GetReplicatedGraphs();
+    std::lock_guard<std::mutex> lock(graphs->lock);
+    hashes.assign(graphs->hashes.begin(), graphs->hashes.end());
+  }
+  std::vector<std::string> compile_devices(new_devices.begin(),
+                                           new_devices.end());
+  size_t num_scheduled = 0;
+  for (const xla::hash_t& hash : hashes) {
+    ComputationCache::TypePtr cached_computation =
+        GetComputationCache()->Get(GetReplicaSetHash(hash, devices));
+    xla::hash_t new_hash = GetReplicaSetHash(hash, new_devices);
+    if (cached_computation == nullptr ||
+        GetComputationCache()->Get(new_hash) != nullptr ||
+        !MarkCompilePending(new_hash)) {
+      continue;
+    }
+    // The lowered computation does not depend on the replica set, only the
+    // executable does.
+    auto compilefn = [cached_computation, new_hash, compile_devices]() {
+      xla::util::ExceptionCleanup clear_pending(
+          [&](xla::util::ExceptionCleanup::StatusType) {
+            ClearCompilePending(new_hash);
+          });
+      xla::XlaComputation computation =
+          cached_computation->computation->computation();
+      size_t num_parameters =
+          ConsumeValue(computation.GetProgramShape()).parameters_size();
+      GetComputationCache()->Add(
+          new_hash,
+          CompileLowered(compile_devices, Device(compile_devices.front()),
+                         new_hash, std::move(computation), num_parameters,
+                         cached_computation->graph_size,
+                         /*persistent_cache=*/nullptr));
+    };
+    xla::env::ScheduleIoClosure(std::move(compilefn));
+    ++num_scheduled;
+  }
+  XLA_COUNTER("ReplicaSetPrecompiles", num_scheduled);
+}
+
 void XLATensor::SyncLiveTensorsGraph(const Device* device,
                                      absl::Span<const std::string> devices,
                                      bool wait) {
-  auto tensors = GetLiveTensors(device);
+  // Only the tensors without device data have something to sync, so the walk
+  // is bounded by the pending tensors rather than by all the live ones.
+  auto tensors = DeviceContextArena::Get()->GetPendingTensors(device);
+  // Tensors released by their owners after the pending list was taken are only
+  // referenced by the list itself. Nobody can read their values anymore, so
+  // drop them instead of materializing them as graph outputs.
+  size_t num_pending = tensors.size();
+  tensors.erase(std::remove_if(tensors.begin(), tensors.end(),
+                               [](const XLATensor& tensor) {
+                                 return tensor.data_.use_count() == 1;
+                               }),
+                tensors.end());
+  XLA_COUNTER("PrunedDeadTensors", num_pending - tensors.size());
   if (tensors.empty()) {
     return;
   }
-  TF_VLOG(4) << tensors.size() << " live tensors: devices=("
+  TF_VLOG(4) << tensors.size() << " pending tensors: devices=("
              << absl::StrJoin(devices, ",") << ")";
-  SyncTensorsGraph(&tensors, devices, wait, /*sync_xla_data=*/true);
+  if (device != nullptr) {
+    SyncTensorsGraph(&tensors, devices, wait, /*sync_xla_data=*/true);
+    return;
+  }
+  // A sync graph runs on a single device, so without a device the pending
+  // tensors are synced as one independent graph per device.
+  std::map<Device, std::vector<XLATensor>> device_tensors;
+  for (XLATensor& tensor : tensors) {
+    device_tensors[tensor.GetDevice()].push_back(std::move(tensor));
+  }
+  for (auto& device_and_tensors : device_tensors) {
+    SyncTensorsGraph(&device_and_tensors.second, devices, wait,
+                     /*sync_xla_data=*/true);
+  }
 }
 
 void XLATensor::MarkStep(const Device* device) {
   XLA_COUNTER("MarkStep", 1);
-  DeviceContextArena::Get()->StepRngSeed(device);
+  xla::metrics::CounterData* mark_step = xla::metrics::GetCounter("MarkStep");
+  xla::metrics::StepProfiler::Get()->EndStep(mark_step->Value());
+  MaybeReportStepTimings(mark_step->Value());
+  DeviceContextArena::Get()->MarkStep(device);
   ir::ScopePusher::ResetScopes();
+  ir::NodeArena::MarkStep();
+  ir::TrimTracedNodes();
   g_tls_data.Reset();
 }
 
@@ -1288,15 +2876,11 @@ XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
   auto async = std::make_shared<Async>(std::move(coll), std::move(tensors_data),
                                        std::move(roots), devices);
 
-  auto syncfn = [async]() -> xla::Status {
+  auto syncfn = [async](OpByOpExecutor::AsyncTask& execution) -> xla::Status {
     xla::Status status;
     try {
-      TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
-                 << xla::util::HexHash(async->coll.hash) << " on device "
-                 << async->coll.device << " ...";
       std::vector<xla::ComputationClient::DataPtr> results =
-          OpByOpExecutor::Get()->Execute(
-              async->roots, async->coll.device.ToString(), async->devices);
+          execution.Wait().ConsumeValue();
       TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
                  << xla::util::HexHash(async->coll.hash) << " on device "
                  << async->coll.device << " done!";
@@ -1314,13 +2898,98 @@ XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
     }
     return status;
   };
-  OpByOpAsync async_op(std::move(syncfn));
-  return async_op.Schedule();
+  TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
+             << xla::util::HexHash(async->coll.hash) << " on device "
+             << async->coll.device << " ...";
+  return OpByOpExecutor::Get()
+      ->ExecuteAsync(async->roots, async->coll.device.ToString(),
+                     async->devices)
+      .Then(std::move(syncfn));
 }
 
-void XLATensor::BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
-                                        absl::Span<const size_t> indices,
-                                        ir::LoweringContext* lowering_ctx) {
+void XLATensor::CollectDonatableParameters(SyncTensorCollection* coll,
+                                           PostOrderData* po_data) {
+  static const bool enable_aliasing =
+      xla::sys_util::GetEnvBool("XLA_ENABLE_PARAM_ALIASING", false);
+  static const bool donate_dead =
+      xla::sys_util::GetEnvBool("XLA_DONATE_DEAD_PARAMETERS", true);
+  po_data->donatable_parameters.clear();
+  po_data->pinned_parameters.clear();
+  if (!coll->config.sync_xla_data) {
+    return;
+  }
+  // The buffers of the tensors updated in place get donated even without the
+  // aliasing enabled, as they are meant to never be copied.
+  bool has_in_place = false;
+  for (auto& data : po_data->parameters_data) {
+    DeviceDataInfo* data_info = dynamic_cast<DeviceDataInfo*>(data->info());
+    if (data_info != nullptr && data_info->in_place) {
+      has_in_place = true;
+      break;
+    }
+  }
+  if (!enable_aliasing && !has_in_place) {
+    return;
+  }
+  for (size_t i = 0; i < po_data->parameters_data.size(); ++i) {
+    if (IsCheckpointPinned(po_data->parameters_data[i].get())) {
+      po_data->pinned_parameters.push_back(i);
+    }
+  }
+  if (!po_data->pinned_parameters.empty()) {
+    coll->hash = xla::util::HashCombine(
+        coll->hash, xla::util::Hash(po_data->pinned_parameters));
+  }
+  bool donate_all = enable_aliasing && donate_dead;
+  if (!donate_all && !has_in_place) {
+    return;
+  }
+  // Same reasoning as for the aliasing in BuildComputation(): at the step
+  // barrier the graph covers all the pending IR of the live tensors, so the
+  // only other references to the parameter buffers are the device data held by
+  // the live tensors themselves.
+  absl::node_hash_set<const xla::ComputationClient::Data*> held_data;
+  for (const XLATensor& tensor : GetLiveTensors(&coll->device)) {
+    xla::ComputationClient::DataPtr xla_data = tensor.CurrentXlaData();
+    if (xla_data != nullptr) {
+      held_data.insert(xla_data.get());
+      continue;
+    }
+    ir::Value ir_value = tensor.CurrentIrValue();
+    if (!ir_value) {
+      continue;
+    }
+    const ir::ops::DeviceData* device_data =
+        ir::ops::DeviceData::Cast(ir_value.node.get());
+    if (device_data != nullptr) {
+      held_data.insert(device_data->data().get());
+    } else if (!ShouldSyncIrValue(ir_value)) {
+      // A pending graph which this sync does not materialize might still read
+      // any of the parameters.
+      return;
+    }
+  }
+  for (size_t i = 0; i < po_data->parameters_data.size(); ++i) {
+    const xla::ComputationClient::DataPtr& data = po_data->parameters_data[i];
+    DeviceDataInfo* data_info = dynamic_cast<DeviceDataInfo*>(data->info());
+    if (data_info != nullptr && !data_info->read_only &&
+        (donate_all || data_info->in_place) &&
+        held_data.count(data.get()) == 0 &&
+        !IsCheckpointPinned(data.get())) {
+      po_data->donatable_parameters.push_back(i);
+    }
+  }
+  if (!po_data->donatable_parameters.empty()) {
+    coll->hash = xla::util::HashCombine(
+        coll->hash, xla::util::Hash(po_data->donatable_parameters));
+  }
+}
+
+void XLATensor::BuildInputOutputAliases(
+    const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices,
+    absl::Span<const size_t> donatable_parameters,
+    absl::Span<const size_t> pinned_parameters, bool donate_only,
+    ir::LoweringContext* lowering_ctx) {
   absl::node_hash_map<xla::int64, size_t> output_tensor_id_map;
   for (size_t i = 0; i < indices.size(); ++i) {
     size_t tensor_index = indices[i];
@@ -1330,7 +2999,16 @@ void XLATensor::BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
   const std::vector<xla::ComputationClient::DataPtr>& parameters_data =
       lowering_ctx->GetParametersData();
   std::vector<ssize_t> alias_map(indices.size(), -1);
-  for (size_t i = 0; i < parameters_data.size(); ++i) {
+  std::vector<bool> aliased_parameters(parameters_data.size(), false);
+  // The buffers held by a pending checkpoint must keep their value until it is
+  // written.
+  for (size_t i : pinned_parameters) {
+    aliased_parameters[i] = true;
+  }
+  for (size_t i = 0; i < parameters_data.size() && !donate_only; ++i) {
+    if (aliased_parameters[i]) {
+      continue;
+    }
     DeviceDataInfo* data_info =
         dynamic_cast<DeviceDataInfo*>(parameters_data[i]->info());
     if (data_info != nullptr && !data_info->read_only) {
@@ -1344,6 +3022,7 @@ void XLATensor::BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
           lowering_ctx->builder()->SetUpAlias(
               {static_cast<xla::int64>(output_index)}, i, {});
           alias_map[output_index] = i;
+          aliased_parameters[i] = true;
 
           TF_VLOG(6) << "Aliased paramter " << i << " with output "
                      << output_index << ": " << parameters_data[i]->shape();
@@ -1351,26 +3030,153 @@ void XLATensor::BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
       }
     }
   }
+  // Buffers of dead parameters (typically the previous values of the
+  // parameters and optimizer state, whose tensors have been overwritten by new
+  // ones) can be donated to any output of the same shape.
+  size_t donated_count = 0;
+  for (size_t i : donatable_parameters) {
+    if (aliased_parameters[i]) {
+      continue;
+    }
+    for (size_t output_index = 0; output_index < alias_map.size();
+         ++output_index) {
+      if (alias_map[output_index] >= 0) {
+        continue;
+      }
+      xla::XlaOp root = lowering_ctx->GetResult(output_index);
+      if (parameters_data[i]->shape() == XlaHelpers::ShapeOfXlaOp(root)) {
+        lowering_ctx->builder()->SetUpAlias(
+            {static_cast<xla::int64>(output_index)}, i, {});
+        alias_map[output_index] = i;
+        aliased_parameters[i] = true;
+        ++donated_count;
+
+        TF_VLOG(6) << "Donated dead paramter " << i << " to output "
+                   << output_index << ": " << parameters_data[i]->shape();
+        break;
+      }
+    }
+  }
   XLA_VALUE_METRIC("InputOutputAliasCount", alias_map.size());
+  XLA_VALUE_METRIC("DonatedParameterCount", donated_count);
 }
 
-XLATensor::CompilationResult XLATensor::Compile(
-    const std::vector<XLATensor>& tensors,
-    absl::Span<const std::string> devices, const SyncTensorCollection& coll,
-    PostOrderData* po_data) {
+xla::XlaComputation XLATensor::BuildComputation(
+    const std::vector<XLATensor>& tensors, const SyncTensorCollection& coll,
+    PostOrderData* po_data, size_t* emitted_nodes, bool* persisted) {
   static const bool enable_aliasing =
       xla::sys_util::GetEnvBool("XLA_ENABLE_PARAM_ALIASING", false);
-  xla::util::Unique<Device> unique_device;
+  if (RecompileAnalyzer::Get()->enabled()) {
+    TF_LOG(INFO) << RecompileAnalyzer::Get()->Analyze(CreateGraphFingerprint(
+        coll.hash, CollectRootNodes(tensors, coll.indices),
+        po_data->post_order, po_data->parameters_data));
+  }
+  const xla::util::PersistentCache* persistent_cache = GetPersistentCache();
+  xla::hash_t persistent_key = GetPersistentCacheKey(coll.hash, coll.device);
+  std::unique_ptr<xla::XlaComputation> persisted_computation =
+      persistent_cache != nullptr ? persistent_cache->Get(persistent_key)
+                                  : nullptr;
+  if (persisted_computation != nullptr &&
+      ConsumeValue(persisted_computation->GetProgramShape())
+              .parameters_size() != po_data->parameters_data.size()) {
+    // Hash collision, or an entry written by an incompatible lowering. Drop it
+    // and lower the graph from scratch.
+    XLA_COUNTER("PersistentCacheInvalidated", 1);
+    persistent_cache->Erase(persistent_key);
+    persisted_computation = nullptr;
+  }
+  if (persisted_computation != nullptr) {
+    TF_VLOG(3) << "Loaded IR graph hash " << xla::util::HexHash(coll.hash)
+               << " from the persistent cache";
+    *emitted_nodes = po_data->post_order.size();
+    *persisted = true;
+    return std::move(*persisted_computation);
+  }
+  xla::service::MeshClient* sharing_client = GetComputationSharingClient();
+  std::string shared_key;
+  if (sharing_client != nullptr) {
+    // The graph hash mixes in the resource domain of the host, so the hosts
+    // share the computation under the hash of what the lowering depends on.
+    xla::hash_t key =
+        xla::util::MHash(coll.config.sync_xla_data,
+                         xla::util::Hash(po_data->donatable_parameters),
+                         xla::util::Hash(po_data->pinned_parameters));
+    for (const ir::Value& root : CollectRoots(tensors, coll.indices)) {
+      key = xla::util::HashCombine(key, root.hash());
+    }
+    shared_key = absl::StrCat(
+        "computation/", GetBuildFingerprint(), "/",
+        xla::util::HexHash(GetPersistentCacheKey(key, coll.device)));
+    absl::optional<std::string> shared =
+        sharing_client->AcquireArtifact(shared_key);
+    xla::HloModuleProto proto;
+    if (shared && proto.ParseFromString(*shared)) {
+      xla::XlaComputation computation(std::move(proto));
+      if (ConsumeValue(computation.GetProgramShape()).parameters_size() ==
+          po_data->parameters_data.size()) {
+        TF_VLOG(3) << "Fetched IR graph hash " << xla::util::HexHash(coll.hash)
+                   << " from the mesh service";
+        XLA_COUNTER("SharedComputationFetches", 1);
+        *emitted_nodes = po_data->post_order.size();
+        *persisted = false;
+        return computation;
+      }
+      XLA_COUNTER("SharedComputationInvalidated", 1);
+    }
+  }
+
+  XLA_TRACE_SPAN("BuildComputation");
+  static const bool combine_all_reduces =
+      xla::sys_util::GetEnvBool("XLA_COMBINE_ALL_REDUCES", true);
+  std::vector<ir::Value> root_values = CollectRoots(tensors, coll.indices);
+  std::vector<ir::Value> combined_roots;
+  if (combine_all_reduces) {
+    combined_roots =
+        ir::CombineIndependentAllReduces(root_values, po_data->post_order);
+  }
+  // The combined graph is only alive within this function, so it does not
+  // replace the post order of po_data.
+  absl::Span<const ir::Node* const> post_order = po_data->post_order;
+  std::vector<const ir::Node*> combined_post_order;
+  ir::Util::EmissionMap emission_map;
+  if (!combined_roots.empty()) {
+    // The parameters are numbered in lowering order, which has to follow the
+    // one of the original graph for the numbering to match the one of the
+    // cached syncs, which never build the combined graph. Device data nodes
+    // are leaves, so they can be lowered first.
+    std::vector<const ir::Node*> combined_root_nodes;
+    for (const ir::Value& root : combined_roots) {
+      combined_root_nodes.push_back(root.node.get());
+    }
+    for (const ir::Node* node : po_data->post_order) {
+      if (node->operands().empty()) {
+        combined_post_order.push_back(node);
+      }
+    }
+    for (const ir::Node* node :
+         ir::Util::ComputePostOrder(combined_root_nodes, &emission_map)) {
+      if (!node->operands().empty()) {
+        combined_post_order.push_back(node);
+      }
+    }
+    post_order = combined_post_order;
+    root_values = std::move(combined_roots);
+  } else {
+    emission_map = std::move(po_data->emission_map);
+  }
+  std::vector<ir::Output> roots;
+  roots.reserve(root_values.size());
+  for (const ir::Value& ir_value : root_values) {
+    roots.emplace_back(ir_value.node.get(), ir_value.index);
+  }
   ir::RootLoweringContext lowering_ctx("SyncTensorsGraph", coll.device,
-                                       po_data->post_order,
-                                       std::move(po_data->emission_map));
-  for (auto index : coll.indices) {
-    ir::Value ir_value = tensors[index].CurrentIrValue();
-    xla::XlaOp root = lowering_ctx.GetOutputOp(ir_value);
-    lowering_ctx.AddResult(root);
-    unique_device.set(tensors[index].GetDevice());
-  }
-  if (enable_aliasing && coll.config.sync_xla_data) {
+                                       post_order, std::move(emission_map),
+                                       roots);
+  for (auto& root : roots) {
+    lowering_ctx.AddResult(lowering_ctx.GetOutputOp(root));
+  }
+  if (coll.config.sync_xla_data &&
+      (enable_aliasing || !po_data->donatable_parameters.empty())) {
     // We can only alias at the step barrier, when force_xla_data is true.
     // Consider the case:
     //   1. Tensor A(DEVICE_DATA)
@@ -1395,39 +3201,243 @@ XLATensor::CompilationResult XLATensor::Compile(
     // will later fetch the new value of A, which is incorrect.
     // But, when we issue a step barrier (force_xla_data == true) we have to
     // turn everything into DEVICE_DATA, so we can activate aliasing.
-    BuildInputOutputAliases(tensors, coll.indices, &lowering_ctx);
+    // Without XLA_ENABLE_PARAM_ALIASING, the donatable parameters are the ones
+    // of the tensors updated in place, and only they get aliased.
+    BuildInputOutputAliases(tensors, coll.indices,
+                            po_data->donatable_parameters,
+                            po_data->pinned_parameters,
+                            /*donate_only=*/!enable_aliasing, &lowering_ctx);
+  }
+  *emitted_nodes = lowering_ctx.GetEmittedNodeCount();
+  *persisted = false;
+  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+  if (sharing_client != nullptr) {
+    sharing_client->PublishArtifact(shared_key,
+                                    computation.proto().SerializeAsString());
   }
+  return computation;
+}
 
-  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+XLATensor::CompilationResult XLATensor::Compile(
+    const std::vector<XLATensor>& tensors,
+    absl::Span<const std::string> devices, const SyncTensorCollection& coll,
+    PostOrderData* po_data) {
+  XLA_STEP_TIMER(kCompile);
+  size_t emitted_nodes = 0;
+  bool persisted = false;
+  xla::XlaComputation computation =
+      BuildComputation(tensors, coll, po_data, &emitted_nodes, &persisted);
+  return {/*device=*/coll.device,
+          /*emitted_nodes=*/emitted_nodes,
+          /*cached_computation=*/
+          CompileLowered(devices, coll.device, coll.hash,
+                         std::move(computation),
+                         po_data->parameters_data.size(), emitted_nodes,
+                         persisted ? nullptr : GetPersistentCache(),
+                         /*fast_compile=*/GetTieredCompileThreshold() > 0),
+          /*parameters_data=*/std::move(po_data->parameters_data)};
+}
+
+void XLATensor::MaybeScheduleOptimizedRecompile(
+    const xla::hash_t& hash, const std::string& device,
+    const ComputationCache::TypePtr& cached_computation) {
+  if (!cached_computation->fast_compiled ||
+      xla::metrics::ExecutionProfile::Get()->GetExecutionCount(hash) <
+          GetTieredCompileThreshold() ||
+      !MarkCompilePending(hash)) {
+    return;
+  }
+  XLA_COUNTER("TieredRecompiles", 1);
+  auto compilefn = [hash, device, cached_computation]() {
+    const xla::ComputationClient::Computation& computation =
+        *cached_computation->computation;
+    try {
+      GetComputationCache()->Add(
+          hash, CompileLowered(computation.devices(), Device(device), hash,
+                               computation.computation(),
+                               computation.program_shape().parameters_size(),
+                               cached_computation->graph_size,
+                               /*persistent_cache=*/nullptr));
+    } catch (const std::exception& ex) {
+      TF_LOG(ERROR) << "Optimized recompilation of IR graph hash "
+                    << xla::util::HexHash(hash) << " failed: " << ex.what();
+    }
+    ClearCompilePending(hash);
+  };
+  xla::env::ScheduleClosure(std::move(compilefn));
+}
+
+void XLATensor::RecordExecutionProfile(
+    const xla::hash_t& hash, const std::string& device,
+    const xla::ComputationClient::ComputationPtr& computation,
+    xla::int64 execute_time_ns) {
+  xla::metrics::CounterData* mark_step = xla::metrics::GetCounter("MarkStep");
+  xla::int64 step = mark_step != nullptr ? mark_step->Value() : 0;
+  xla::metrics::ExecutionProfile::Get()->Record(hash, device, computation,
+                                                execute_time_ns, step);
+}
+
+void XLATensor::RecordCompileProfile(const Device& device,
+                                     const xla::hash_t& hash,
+                                     const xla::XlaComputation& computation,
+                                     size_t emitted_nodes,
+                                     double compile_time) {
+  static const double compile_time_threshold = xla::sys_util::GetEnvDouble(
+      "XLA_COMPILE_TIME_THRESHOLD", std::numeric_limits<double>::max());
+  xla::metrics::CompileRecord record;
+  record.hash = hash;
+  record.device = device.ToString();
+  record.timestamp_ns = xla::sys_util::NowNs();
+  record.compile_time = compile_time;
+  for (auto& hlo_computation : computation.proto().computations()) {
+    record.hlo_instructions += hlo_computation.instructions_size();
+  }
+  record.emitted_nodes = emitted_nodes;
+  std::stringstream ss;
+  ss << GetSwiftFrames();
+  record.frames = ss.str();
+  if (compile_time > compile_time_threshold) {
+    record.hlo_text =
+        ConsumeValue(xla::util::GetComputationHloText(computation));
+  }
+  xla::metrics::CompileProfile::Get()->Record(std::move(record));
+}
+
+XLATensor::ComputationCache::TypePtr XLATensor::CompileLowered(
+    absl::Span<const std::string> devices, const Device& device,
+    const xla::hash_t& hash, xla::XlaComputation computation,
+    size_t num_parameters, size_t emitted_nodes,
+    const xla::util::PersistentCache* persistent_cache, bool fast_compile) {
+  XLA_STEP_TIMER(kCompile);
   xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
   xla::Shape shape =
-      MakeShapeWithDeviceLayout(program_shape.result(), coll.device.hw_type);
+      MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+  // SPMD partitioned computations are compiled for all the partitions.
+  if (devices.empty() && xla::util::HasShardings(computation)) {
+    devices = xla::ComputationClient::GetReplicationDevices();
+  }
 
   std::vector<xla::ComputationClient::CompileInstance> instances;
   instances.push_back({std::move(computation), &shape});
+  instances.back().fast_compile = fast_compile;
 
-  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
-             << " on device " << coll.device << " ...";
+  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(hash)
+             << " on device " << device << " ...";
+  xla::int64 start_time = xla::sys_util::NowNs();
   std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
       computations =
-          xla::GetX10Device(coll.device.ToString())
+          xla::GetX10Device(device.ToString())
               ->Compile(xla::ComputationClient::GetCompilationDevices(
-                            coll.device.ToString(), devices),
+                            device.ToString(), devices),
                         std::move(instances));
-  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
-             << " on device " << coll.device << " done!";
+  double compile_time = (xla::sys_util::NowNs() - start_time) * 1e-9;
+  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(hash)
+             << " on device " << device << " done!";
   TF_VLOG(5)
-      << "Graph hash " << xla::util::HexHash(coll.hash)
-      << " is computation hash "
+      << "Graph hash " << xla::util::HexHash(hash) << " is computation hash "
       << xla::util::HexHash(xla::util::Hash(
              computations.front()->computation().proto().SerializeAsString()));
-  XLA_CHECK_EQ(program_shape.parameters_size(),
-               po_data->parameters_data.size());
+  XLA_CHECK_EQ(program_shape.parameters_size(), num_parameters);
+  RecordCompileProfile(device, hash, computations.front()->computation(),
+                       emitted_nodes, compile_time);
+  for (const xla::Shape& shape :
+       computations.front()->compiled_parameter_shapes()) {
+    RecordParameterLayout(shape, device.hw_type);
+  }
+  if (persistent_cache != nullptr) {
+    persistent_cache->Add(GetPersistentCacheKey(hash, device),
+                          computations.front()->computation());
+  }
+  auto cached_computation = std::make_shared<CachedComputation>(
+      std::move(computations.front()), emitted_nodes, compile_time);
+  cached_computation->fast_compiled = fast_compile;
+  return cached_computation;
+}
 
-  return {/*device=*/coll.device,
-          /*emitted_nodes=*/lowering_ctx.GetEmittedNodeCount(),
-          /*computation=*/std::move(computations.front()),
-          /*parameters_data=*/std::move(po_data->parameters_data)};
+bool XLATensor::TryScheduleAsyncCompile(
+    const std::vector<XLATensor>& tensors,
+    absl::Span<const std::string> devices, const SyncTensorCollection& coll,
+    PostOrderData* po_data) {
+  static const bool async_compile =
+      xla::sys_util::GetEnvBool("XLA_ASYNC_COMPILE", false);
+  if (!async_compile) {
+    return false;
+  }
+  if (!MarkCompilePending(coll.hash)) {
+    // Already being compiled by an earlier step.
+    XLA_COUNTER("AsyncCompilePending", 1);
+    return true;
+  }
+  size_t emitted_nodes = 0;
+  bool persisted = false;
+  auto computation = std::make_shared<xla::XlaComputation>(
+      BuildComputation(tensors, coll, po_data, &emitted_nodes, &persisted));
+  XLA_VALUE_METRIC("TensorsGraphSize", emitted_nodes);
+  XLA_COUNTER("AsyncCompile", 1);
+
+  auto compilefn = [computation, device = coll.device,
+                    hash = coll.hash,
+                    devices = std::vector<std::string>(devices.begin(),
+                                                       devices.end()),
+                    num_parameters = po_data->parameters_data.size(),
+                    emitted_nodes, persisted]() {
+    try {
+      GetComputationCache()->Add(
+          hash, CompileLowered(devices, device, hash, std::move(*computation),
+                               num_parameters, emitted_nodes,
+                               persisted ? nullptr : GetPersistentCache()));
+    } catch (const std::exception& ex) {
+      TF_LOG(ERROR) << "Background compilation of IR graph hash "
+                    << xla::util::HexHash(hash) << " failed: " << ex.what();
+    }
+    ClearCompilePending(hash);
+  };
+  xla::env::ScheduleClosure(std::move(compilefn));
+  return true;
+}
+
+std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraphOpByOp(
+    std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
+    SyncTensorCollection* coll) {
+  std::vector<ir::Value> roots = CollectRoots(*tensors, coll->indices);
+  auto tensors_data = FetchTensorData(tensors, coll->config, coll->indices);
+  std::shared_ptr<Async> async = std::make_shared<Async>(
+      coll, /*parameters_data=*/std::vector<xla::ComputationClient::DataPtr>(),
+      std::move(tensors_data), /*cached_computation=*/nullptr);
+
+  auto syncfn = [async, hash = coll->hash](
+                    OpByOpExecutor::AsyncTask& execution) {
+    try {
+      std::vector<xla::ComputationClient::DataPtr> results =
+          execution.Wait().ConsumeValue();
+      TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
+                 << xla::util::HexHash(hash) << " on device " << async->device
+                 << " done!";
+
+      for (size_t i = 0; i < results.size(); ++i) {
+        if (async->tensors_data[i] != nullptr) {
+          async->tensors_data[i]->Assign(*results[i]);
+        } else {
+          async->tensors_data[i] = std::move(results[i]);
+        }
+      }
+    } catch (...) {
+      std::exception_ptr exptr = std::current_exception();
+      for (auto& unlocker : async->unlocker) {
+        unlocker.SetStatus(exptr);
+      }
+    }
+    async->mwait.Done();
+    return true;
+  };
+
+  TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
+             << xla::util::HexHash(coll->hash) << " on device "
+             << async->device << " ...";
+  OpByOpExecutor::Get()
+      ->ExecuteAsync(roots, async->device, devices)
+      .Then(std::move(syncfn));
+  return async;
 }
 
 std::shared_ptr<XLATensor::Async> XLATensor::SyncTensorsGraphInternal(
@@ -1439,26 +3449,73 @@ std::shared_ptr<XLATensor::Async> XLATensor::SyncTensorsGraphInternal(
   }
   DebugUtil::SaveTensorsGraphInfo("ScheduleSyncTensorsGraph", *tensors,
                                   &coll.indices);
+  MaybeEvictTensors(coll.device);
 
-  PostOrderData po_data = RunPostOrder(*tensors, coll.indices);
-  InsertTraceletCutpoint(po_data);
+  // The full post-order and emission map are only needed for lowering, and
+  // tracelet detection. In steady state the graph is found in the computation
+  // cache, so only walk the graph leaves to collect the parameters, and build
+  // the post-order when the cache lookup fails.
+  static const bool tracelets =
+      xla::sys_util::GetEnvBool("XLA_TRACELETS", false);
+  PostOrderData po_data = tracelets ? RunPostOrder(*tensors, coll.indices)
+                                    : RunLeafOrder(*tensors, coll.indices);
+  InsertTraceletCutpoint(po_data, coll.device);
   coll.hash = xla::util::HashCombine(
       coll.hash, xla::util::Hash(po_data.parameter_sequence));
+  CollectDonatableParameters(&coll, &po_data);
+  MixReplicaSet(devices, &coll.hash);
   TF_VLOG(4) << "Parameter sequence graph hash "
              << xla::util::HexHash(coll.hash);
   std::shared_ptr<Async> async = TryRunCachedSync(tensors, &coll, &po_data);
   if (async != nullptr) {
     return async;
   }
+  absl::optional<xla::util::ExceptionCleanup> clear_pending;
+  if (ShareReplicaCompiles(devices)) {
+    if (!MarkCompilePending(coll.hash)) {
+      WaitCompilePending(coll.hash);
+      async = TryRunCachedSync(tensors, &coll, &po_data);
+      if (async != nullptr) {
+        XLA_COUNTER("SharedReplicaCompile", 1);
+        return async;
+      }
+      // The other replica failed to compile the graph, or it already got
+      // evicted, so compile it here.
+    } else {
+      clear_pending.emplace(
+          [hash = coll.hash](xla::util::ExceptionCleanup::StatusType) {
+            ClearCompilePending(hash);
+          });
+    }
+  }
+  if (!tracelets) {
+    std::vector<size_t> donatable_parameters =
+        std::move(po_data.donatable_parameters);
+    std::vector<size_t> pinned_parameters =
+        std::move(po_data.pinned_parameters);
+    po_data = RunPostOrder(*tensors, coll.indices);
+    po_data.donatable_parameters = std::move(donatable_parameters);
+    po_data.pinned_parameters = std::move(pinned_parameters);
+  }
+  if (TryScheduleAsyncCompile(*tensors, devices, coll, &po_data)) {
+    // The fused computation will be picked up from the cache by a later step,
+    // once the background compilation completes.
+    return ScheduleSyncTensorsGraphOpByOp(tensors, devices, &coll);
+  }
 
   CompilationResult compile_result = Compile(*tensors, devices, coll, &po_data);
 
   XLA_VALUE_METRIC("TensorsGraphSize", compile_result.emitted_nodes);
   TF_VLOG(5) << "TensorsGraphSize=" << compile_result.emitted_nodes;
 
-  auto cached_computation = std::make_shared<CachedComputation>(
-      std::move(compile_result.computation));
+  auto cached_computation = std::move(compile_result.cached_computation);
   GetComputationCache()->Add(coll.hash, cached_computation);
+  if (ReplayLog::Get()->enabled()) {
+    ReplayLog::Get()->RecordSync(
+        coll.hash, compile_result.device.ToString(),
+        cached_computation->computation->computation(), /*compiled=*/true,
+        compile_result.emitted_nodes, compile_result.parameters_data);
+  }
 
   return ScheduleSyncTensorsGraph(
       tensors, &coll, std::move(compile_result.parameters_data),
@@ -1470,6 +3527,112 @@ xla::int64 XLATensor::GetNextTensorId() {
   return id_generator->fetch_add(1);
 }
 
+void XLATensor::MaybeEvictTensors(const Device& device) {
+  static const double threshold =
+      xla::sys_util::GetEnvDouble("XLA_EVICTION_THRESHOLD", 0.9);
+  static const double target =
+      xla::sys_util::GetEnvDouble("XLA_EVICTION_TARGET", 0.75);
+  if (threshold <= 0) {
+    return;
+  }
+  xla::ComputationClient::Device* xla_device = xla::GetX10Device(device);
+  xla::int64 limit = xla_device->GetMemoryLimit();
+  xla::int64 in_use = xla_device->GetMemoryInUse();
+  if (limit <= 0 || in_use < 0 || in_use <= threshold * limit) {
+    return;
+  }
+  xla::int64 evicted = EvictTensors(
+      device, in_use - static_cast<xla::int64>(target * limit));
+  TF_VLOG(3) << "Evicted " << evicted << " bytes from " << device.ToString()
+             << " with " << in_use << " of " << limit << " bytes in use";
+}
+
+xla::int64 XLATensor::EvictTensors(const Device& device, xla::int64 bytes) {
+  XLA_TIMED("EvictTensors");
+  std::vector<XLATensor> candidates;
+  for (XLATensor& tensor : DeviceContextArena::Get()->GetLiveTensors(&device)) {
+    Data* data = tensor.data();
+    const xla::ComputationClient::DataPtr& xla_data = data->xla_data;
+    if (xla_data == nullptr || !xla_data->HasValue() ||
+        xla_data->sharding() != nullptr || xla_data->IsShared() ||
+        IsCheckpointPinned(xla_data.get())) {
+      continue;
+    }
+    // A tensor used by a pending graph holds its device data within a device
+    // data node, which is fine as long as nothing else holds the node.
+    long expected_uses = 1;
+    if (data->ir_value) {
+      const ir::ops::DeviceData* device_data =
+          ir::ops::DeviceData::Cast(data->ir_value.node.get());
+      if (device_data == nullptr || device_data->data() != xla_data ||
+          data->ir_value.node.use_count() != 1) {
+        continue;
+      }
+      ++expected_uses;
+    }
+    if (xla_data.use_count() == expected_uses) {
+      candidates.push_back(std::move(tensor));
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const XLATensor& a, const XLATensor& b) {
+              return a.data()->last_use < b.data()->last_use;
+            });
+  xla::int64 evicted_bytes = 0;
+  std::vector<XLATensor> evicted;
+  std::vector<xla::ComputationClient::DataPtr> fetched_data;
+  std::vector<at::ScalarType> fetched_types;
+  std::vector<size_t> fetched_indices;
+  for (XLATensor& tensor : candidates) {
+    if (evicted_bytes >= bytes) {
+      break;
+    }
+    const xla::ComputationClient::DataPtr& xla_data = tensor.data()->xla_data;
+    evicted_bytes += xla::ShapeUtil::ByteSizeOf(xla_data->shape());
+    if (!tensor.data()->tensor_data) {
+      fetched_indices.push_back(evicted.size());
+      fetched_data.push_back(xla_data);
+      fetched_types.push_back(tensor.dtype());
+    }
+    evicted.push_back(std::move(tensor));
+  }
+  std::vector<at::Tensor> fetched =
+      XlaDataToTensors(fetched_data, fetched_types);
+  for (size_t i = 0; i < fetched_indices.size(); ++i) {
+    evicted[fetched_indices[i]].data()->SetTensorData(std::move(fetched[i]));
+  }
+  fetched_data.clear();
+  for (XLATensor& tensor : evicted) {
+    tensor.AssignIrValue(ir::Value());
+    tensor.data()->ResetXlaData();
+    tensor.data()->evicted = true;
+  }
+  XLA_COUNTER("EvictedTensors", evicted.size());
+  XLA_COUNTER("EvictedBytes", evicted_bytes);
+  return evicted_bytes;
+}
+
+ir::Value XLATensor::GetRngSeed(const Device& device) {
+  return DeviceContextArena::Get()->GetRngSeed(device);
+}
+
+xla::uint64 XLATensor::GetNextRngStream(const Device& device) {
+  return DeviceContextArena::Get()->GetNextRngStream(device);
+}
+
+void* XLATensor::operator new(size_t size) {
+  return UseTensorHandleArena() ? ir::NodeArena::Allocate(size)
+                                : ::operator new(size);
+}
+
+void XLATensor::operator delete(void* ptr, size_t size) {
+  if (UseTensorHandleArena()) {
+    ir::NodeArena::Free(ptr, size);
+  } else {
+    ::operator delete(ptr);
+  }
+}
+
 void XLATensor::SetRngSeed(const Device* device, xla::uint64 seed) {
   DeviceContextArena::Get()->SetRngSeed(device, seed);
 }
@@ -1478,6 +3641,48 @@ xla::uint64 XLATensor::GetRunningSeed(const Device& device) {
   return DeviceContextArena::Get()->GetRunningSeed(device);
 }
 
+xla::int64 XLATensor::GetStepCount(const Device& device) {
+  return DeviceContextArena::Get()->GetStepCount(device);
+}
+
+xla::int64 XLATensor::CreateTraceContext() {
+  static std::atomic<xla::int64>* id_generator = new std::atomic<xla::int64>(1);
+  XLA_COUNTER("CreateTraceContext", 1);
+  return id_generator->fetch_add(1);
+}
+
+void XLATensor::SetTraceContext(xla::int64 trace_context) {
+  g_trace_context = trace_context;
+}
+
+xla::int64 XLATensor::GetTraceContext() { return g_trace_context; }
+
+bool XLATensor::ApplyEagerDispatch() {
+  static const bool eager =
+      xla::sys_util::GetEnvBool("XLA_EAGER_ASYNC_DISPATCH", false);
+  if (!eager) {
+    return false;
+  }
+  ir::Value ir_value = CurrentIrValue();
+  if (!ir_value || !ShouldSyncIrValue(ir_value) ||
+      ir::ops::DeviceData::Cast(ir_value.node.get()) != nullptr) {
+    return false;
+  }
+  // Like the asynchronous syncs, the tensor gets a placeholder right away,
+  // which the later ops use as their operand, and which the queue assigns
+  // once the op ran.
+  const Device& device = GetDevice();
+  xla::ComputationClient::DataPtr xla_data =
+      xla::GetX10Device(device)->CreateDataPlaceholder(
+          MakeShapeWithDeviceLayout(shape(), device.hw_type));
+  EagerDispatchQueueArena::Get()
+      ->GetQueue(device, data()->trace_context)
+      ->Enqueue(std::move(ir_value), xla_data);
+  SetXlaData(std::move(xla_data));
+  XLA_COUNTER("EagerDispatches", 1);
+  return true;
+}
+
 bool XLATensor::ApplyTraceletCutpoint() {
   static const bool tracelets =
       xla::sys_util::GetEnvBool("XLA_TRACELETS", false);
@@ -1496,7 +3701,8 @@ bool XLATensor::ApplyTraceletCutpoint() {
   return false;
 }
 
-void XLATensor::InsertTraceletCutpoint(const PostOrderData& po_data) {
+void XLATensor::InsertTraceletCutpoint(const PostOrderData& po_data,
+                                       const Device& device) {
   // Wait for steady state: don't trigger any tracelet detection for the first
   // two steps.
   static const xla::int64 kSteadyStateStep = 3;
@@ -1549,7 +3755,9 @@ void XLATensor::InsertTraceletCutpoint(const PostOrderData& po_data) {
       const auto cutpoint_it = po_trace.begin() + *divergent_node;
       g_tracelet_state.tracelet_by_prefix[trace_key] =
           std::vector<xla::hash_t>(po_trace.begin(), cutpoint_it);
-      g_tracelet_state.cutpoints.insert(*(cutpoint_it - 1));
+      if (g_tracelet_state.cutpoints.insert(*(cutpoint_it - 1)).second) {
+        MaybeScheduleSpeculativeCompile(po_data, *divergent_node - 1, device);
+      }
     }
   } else {
     const auto tracelet_it_ok =
@@ -1559,4 +3767,69 @@ void XLATensor::InsertTraceletCutpoint(const PostOrderData& po_data) {
   g_tracelet_state.prev_uncached_compile = uncached_compile->Value();
 }
 
+void XLATensor::MaybeScheduleSpeculativeCompile(const PostOrderData& po_data,
+                                                size_t cutpoint_index,
+                                                const Device& device) {
+  static const bool speculative_compile =
+      xla::sys_util::GetEnvBool("XLA_SPECULATIVE_COMPILE", false);
+  if (!speculative_compile || cutpoint_index >= po_data.post_order.size()) {
+    return;
+  }
+  const ir::Node* cutpoint = po_data.post_order[cutpoint_index];
+  if (cutpoint->num_outputs() != 1) {
+    return;
+  }
+  // The post order only holds raw pointers, so find an owning reference among
+  // the users of the cutpoint node, to keep its graph alive while lowering.
+  ir::NodePtr node;
+  for (size_t i = cutpoint_index + 1; i < po_data.post_order.size() && !node;
+       ++i) {
+    for (const ir::NodePtr& operand :
+         po_data.post_order[i]->operand_nodes()) {
+      if (operand.get() == cutpoint) {
+        node = operand;
+        break;
+      }
+    }
+  }
+  if (node == nullptr) {
+    return;
+  }
+  XLA_COUNTER("SpeculativeCompile", 1);
+
+  // Once the cutpoint is registered, the following steps will materialize the
+  // cutpoint node with ApplyPendingGraph(), so compute the same graph hash
+  // which SyncTensorsGraphInternal() will come up with for it.
+  auto compilefn = [node, device]() {
+    SyncTensorsConfig config;
+    config.sync_xla_data = false;
+    ir::Value ir_value(node, 0);
+    xla::hash_t hash = xla::util::HashCombine(
+        xla::util::MHash(config.force_xla_data), ir_value.hash());
+    hash = xla::util::MHash(hash, xla::GetX10Device(device)->ResourceDomain());
+
+    ir::RootLoweringContext lowering_ctx("SyncTensorsGraph", device);
+    lowering_ctx.AddResult(lowering_ctx.GetOutputOp(ir_value));
+    hash = xla::util::HashCombine(
+        hash, xla::util::Hash(lowering_ctx.GetParameterSequence()));
+    if (GetComputationCache()->Get(hash) != nullptr ||
+        !MarkCompilePending(hash)) {
+      return;
+    }
+    try {
+      GetComputationCache()->Add(
+          hash, CompileLowered(/*devices=*/{}, device, hash,
+                               ConsumeValue(lowering_ctx.Build()),
+                               lowering_ctx.GetParametersData().size(),
+                               lowering_ctx.GetEmittedNodeCount(),
+                               GetPersistentCache()));
+    } catch (const std::exception& ex) {
+      TF_LOG(ERROR) << "Speculative compilation of IR graph hash "
+                    << xla::util::HexHash(hash) << " failed: " << ex.what();
+    }
+    ClearCompilePending(hash);
+  };
+  xla::env::ScheduleClosure(std::move(compilefn));
+}
+
 }  // namespace swift_xla
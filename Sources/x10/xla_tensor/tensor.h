@@ -16,13 +16,20 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 
+#include "absl/memory/memory.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/computation.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/embedding_bag.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
@@ -34,7 +41,9 @@
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/memory_accounting.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/persistent_cache.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/core/util/mirror_pad_mode.h"
 #include "tensorflow/core/util/padding.h"
@@ -60,6 +69,12 @@ class XLATensor {
   // Creates an empty/null tensor.
   XLATensor() = default;
 
+  // The C API heap allocates one tensor per traced op, so heap allocated
+  // tensors come from the IR node arena instead of the general allocator
+  // (XLA_TENSOR_HANDLE_ARENA).
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
   bool is_null() const { return data_ptr() == nullptr; }
 
   size_t generation() const { return data()->generation; }
@@ -70,6 +85,44 @@ class XLATensor {
 
   at::Tensor ToTensor(bool detached);
 
+  // Schedules the pending IR operations of the tensor, if any, for
+  // asynchronous execution, and returns a future which becomes ready once the
+  // device data has been transferred to host from the IO thread pool. Unlike
+  // ToTensor(), the fetched value is not cached within the tensor.
+  std::shared_future<at::Tensor> ToTensorAsync();
+
+  // Exports the device data of the tensor, computing it first if needed, for
+  // the other processes of the host to import with ImportDeviceData() instead
+  // of uploading their own copies, like the weights of the model replicas
+  // served from the same GPU. The data stays alive, whatever happens to the
+  // tensor, until UnexportDeviceData() gets the returned handle.
+  std::string ExportDeviceData();
+
+  // Freezes the tensors, like the weights of an inference model, into the
+  // graphs using them: they get lowered as constants rather than parameters,
+  // so that the compiler folds the computations depending only on them, like
+  // transposed weights and fused batch norm scales, and picks their layouts.
+  // The tensors are computed first if needed. Updating a frozen tensor
+  // unfreezes it. Tensors larger than XLA_FROZEN_CONSTANT_MAX_BYTES, and
+  // sharded ones, stay parameters.
+  static void Freeze(std::vector<XLATensor>* tensors);
+
+  // Returns the numerics guard of the latest sync of the device, see
+  // AppendNumericsGuard(), or true if no sync got guarded yet. Reading it
+  // after a fetch of the step values costs no transfer, as the guard comes
+  // back with them.
+  static XLATensor NumericsGuard(const Device& device);
+
+  static void UnexportDeviceData(const Device& device,
+                                 const std::string& handle);
+
+  // Creates a tensor of the device data exported by another process, which
+  // the computations read but never alias with their outputs.
+  static XLATensor ImportDeviceData(const std::string& handle,
+                                    at::ScalarType type,
+                                    absl::Span<const xla::int64> dimensions,
+                                    const Device& device);
+
   void ShallowCopyTo(XLATensor* dest) const;
 
   at::ScalarType dtype() const;
@@ -106,6 +159,11 @@ class XLATensor {
 
   c10::optional<at::Tensor> CurrentTensorData() const;
 
+  // Keeps the host value the tensor got created from after its upload, which
+  // otherwise drops it under XLA_DROP_UPLOADED_HOST_DATA, so that reading the
+  // tensor back does not fetch it from the device.
+  void KeepHostData();
+
   // Applies the queue of operations in preparation for using the data.
   void ApplyPendingGraph();
 
@@ -124,12 +182,35 @@ class XLATensor {
       at::Scalar value, const xla::Shape& shape,
       c10::optional<at::ScalarType> logical_element_type, const Device& device);
 
+  // Returns the seed of the current step for the device. Random ops combine it
+  // with a stream from GetNextRngStream() rather than chaining off each other.
   static ir::Value GetRngSeed(const Device& device);
 
+  static xla::uint64 GetNextRngStream(const Device& device);
+
   static void SetRngSeed(const Device* device, xla::uint64 seed);
 
   static xla::uint64 GetRunningSeed(const Device& device);
 
+  // Returns the number of steps marked on the device within the current trace
+  // context.
+  static xla::int64 GetStepCount(const Device& device);
+
+  // Creates a trace context, with its own live tensors, random seeds and step
+  // counters on every device. The tensors belong to the trace context their
+  // thread was in when they got created, and the syncs of different trace
+  // contexts lock the devices independently, so independent models, like the
+  // ones served from the same process, trace and run concurrently on the same
+  // device while sharing the computation cache. The trace contexts live as
+  // long as the process.
+  static xla::int64 CreateTraceContext();
+
+  // Sets the trace context of the current thread, which is 0, the default one,
+  // unless set otherwise.
+  static void SetTraceContext(xla::int64 trace_context);
+
+  static xla::int64 GetTraceContext();
+
   // Dispatches a comparison operator, setting the logical type of the result
   // appropriately.
   static XLATensor DispatchComparisonOp(c10::Symbol kind,
@@ -159,10 +240,51 @@ class XLATensor {
                                absl::Span<const std::string> devices, bool wait,
                                bool sync_xla_data);
 
+  // Compiles, concurrently, the graphs which SyncTensorsGraph() would run for
+  // each of the tensor groups (ie, the train and eval steps), and adds them to
+  // the computation cache, without executing them. Graphs already in the cache
+  // or being compiled are skipped.
+  static void PrecompileTensorsGraphs(
+      absl::Span<const std::vector<XLATensor>* const> tensor_groups,
+      absl::Span<const std::string> devices, bool sync_xla_data);
+
+  // Creates a tensor of device data without a value, which stands for an
+  // uploaded input of the graphs traced for PrecompileTensorsGraphs(), since
+  // the graphs only depend on the shapes of their inputs. The graphs using it
+  // can be compiled, but not executed.
+  static XLATensor CreatePlaceholder(at::ScalarType type,
+                                     absl::Span<const xla::int64> dimensions,
+                                     const Device& device);
+
+  // Writes the computations which SyncTensorsGraph() would run for each of the
+  // tensor groups into a bundle file at path, precompiling the ones which are
+  // not cached yet. Serving processes load the bundle with
+  // LoadComputationBundle() at startup, so that their first steps hit the
+  // computation cache instead of lowering and compiling the graphs.
+  static void ExportTensorsGraphs(
+      absl::Span<const std::vector<XLATensor>* const> tensor_groups,
+      absl::Span<const std::string> devices, bool sync_xla_data,
+      const std::string& path);
+
+  // Compiles, concurrently, the computations of the bundle written by
+  // ExportTensorsGraphs() and adds them to the computation cache. Entries whose
+  // device layouts differ from the ones this process would pick are skipped.
+  static void LoadComputationBundle(const std::string& path,
+                                    absl::Span<const std::string> devices);
+
+  // Compiles, in the background, the cached graphs replicated across devices
+  // for the new_devices replica set, so that the steps following a resize of
+  // the data parallel world to new_devices hit the computation cache. Graphs
+  // which only run on a single device do not depend on the replica set.
+  static void PrecompileForReplicaSet(
+      absl::Span<const std::string> devices,
+      absl::Span<const std::string> new_devices);
+
   // Makes sure that any outstanding IR operation accumulated over live tensors,
   // gets turned into device data. If wait is true, the sync operation will be
   // run synchronously. The devices argument, if not empty, tells the devices
-  // which should be partecipating into the replicated computation.
+  // which should be partecipating into the replicated computation. Without a
+  // device, the pending tensors of every device are synced independently.
   static void SyncLiveTensorsGraph(const Device* device,
                                    absl::Span<const std::string> devices,
                                    bool wait);
@@ -179,6 +301,13 @@ class XLATensor {
   // tensors must be on the same device.
   static std::vector<at::Tensor> GetTensors(std::vector<XLATensor>* tensors);
 
+  // Schedules the computation of the pending IR operations of the tensors,
+  // like SyncTensorsGraph() without waiting, and returns their device data,
+  // which can still be in flight. wait_fn is set to a function waiting for it.
+  // The returned handles keep the buffers alive after the tensors get updated.
+  static std::vector<xla::ComputationClient::DataPtr> SnapshotTensorsData(
+      std::vector<XLATensor>* tensors, std::function<void()>* wait_fn);
+
   // Operation which creates XLA tensors out of CPU tensors by batching the
   // requests to the computation servers.
   static std::vector<XLATensor> CreateTensors(
@@ -188,6 +317,12 @@ class XLATensor {
   //////////////////////////////////////////////////////////////////////////////
   // XLA dedicated operators follows here, listed in alphabetical order.
   //////////////////////////////////////////////////////////////////////////////
+  // Concatenates along dim the inputs of the shard_count replicas of every
+  // group, after waiting on the token. Returns the result and the new token.
+  static std::pair<XLATensor, ir::Value> all_gather(
+      const XLATensor& input, const ir::Value& token, xla::int64 dim,
+      xla::int64 shard_count, std::vector<std::vector<xla::int64>> groups);
+
   static std::pair<XLATensor, ir::Value> all_reduce(
       const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
       double scale, std::vector<std::vector<xla::int64>> groups);
@@ -195,7 +330,8 @@ class XLATensor {
   static std::pair<std::vector<XLATensor>, ir::Value> all_reduce(
       const std::vector<XLATensor>& inputs, const ir::Value& token,
       AllReduceType reduce_type, double scale,
-      std::vector<std::vector<xla::int64>> groups);
+      std::vector<std::vector<xla::int64>> groups,
+      const AllReduceOptions& options = {});
 
   static ir::Value all_reduce_(XLATensor& input, const ir::Value& token,
                                AllReduceType reduce_type, double scale,
@@ -206,6 +342,18 @@ class XLATensor {
                                AllReduceType reduce_type, double scale,
                                std::vector<std::vector<xla::int64>> groups);
 
+  // Reduces the inputs in buckets of at most bucket_bytes, starting from the
+  // last input, with every bucket waiting on the previous one via the token.
+  // Gradients are listed in forward order and become ready in the reverse one
+  // during the backward pass, so the first buckets can be reduced while the
+  // backward computation of the following ones is still running. A
+  // bucket_bytes of zero reduces all the inputs at once.
+  static std::pair<std::vector<XLATensor>, ir::Value> all_reduce_bucketed(
+      const std::vector<XLATensor>& inputs, const ir::Value& token,
+      AllReduceType reduce_type, double scale,
+      std::vector<std::vector<xla::int64>> groups, xla::int64 bucket_bytes,
+      const AllReduceOptions& options = {});
+
   static std::pair<XLATensor, ir::Value> all_to_all(
       const XLATensor& input, const ir::Value& token,
       xla::int64 split_dimension, xla::int64 concat_dimension,
@@ -218,6 +366,15 @@ class XLATensor {
   static XLATensor get_dimensions_size(const XLATensor& input,
                                        std::vector<xla::int64> dimensions);
 
+  // Reduces the input over the shard_count replicas of every group, after
+  // waiting on the token, and returns the slice along dim which belongs to
+  // this replica, scaled, together with the new token. Unlike an all_reduce
+  // followed by a slice, every replica only receives its own slice.
+  static std::pair<XLATensor, ir::Value> reduce_scatter(
+      const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
+      double scale, xla::int64 dim, xla::int64 shard_count,
+      std::vector<std::vector<xla::int64>> groups);
+
   static std::vector<XLATensor> user_computation(
       const std::string& opname, absl::Span<const XLATensor> inputs,
       ComputationPtr computation);
@@ -225,6 +382,49 @@ class XLATensor {
   //////////////////////////////////////////////////////////////////////////////
   // ATEN operators follows here, listed in alphabetical order.
   //////////////////////////////////////////////////////////////////////////////
+  // Applies the Adam update, see BuildAdamUpdate(), to the weights and moments
+  // in place. The tensors are grouped by device and element type, and every
+  // group gets a single update over the concatenation of its tensors,
+  // regardless of their number. If grads_finite is given, the update is skipped
+  // when it is false.
+  static void adam_update_(std::vector<XLATensor>* weights,
+                           std::vector<XLATensor>* first_moments,
+                           std::vector<XLATensor>* second_moments,
+                           const std::vector<XLATensor>& grads,
+                           const XLATensor& learning_rate,
+                           const XLATensor& beta1, const XLATensor& beta2,
+                           const XLATensor& epsilon,
+                           const XLATensor& weight_decay,
+                           const XLATensor* grads_finite = nullptr);
+
+  // Same as adam_update_(), for moments which live in host memory between the
+  // steps. The weights are updated in buckets of XLA_OFFLOAD_BUCKET_BYTES of
+  // moments, each a separate computation: the moments of the next bucket are
+  // uploaded while the current one runs, and the updated moments are fetched
+  // back in the background, leaving only a few buckets on the device at once.
+  // The moments are host resident when this returns.
+  static void adam_update_offloaded_(std::vector<XLATensor>* weights,
+                                     std::vector<XLATensor>* first_moments,
+                                     std::vector<XLATensor>* second_moments,
+                                     const std::vector<XLATensor>& grads,
+                                     const XLATensor& learning_rate,
+                                     const XLATensor& beta1,
+                                     const XLATensor& beta2,
+                                     const XLATensor& epsilon,
+                                     const XLATensor& weight_decay,
+                                     const XLATensor* grads_finite = nullptr);
+
+  // Adds the values to the accumulators in place, for the gradient
+  // accumulation across micro-steps. Like the cache of kv_cache_update_(), the
+  // buffers of the accumulators are donated to their new values at the step
+  // barriers, even without XLA_ENABLE_PARAM_ALIASING. With reset, the
+  // accumulators get zeroed instead and the sums are returned, so the last
+  // micro-step of a round hands them over while the next round reuses the
+  // same buffers. Returns nothing otherwise.
+  static std::vector<XLATensor> accumulate_(
+      std::vector<XLATensor>* accumulators,
+      const std::vector<XLATensor>& values, bool reset);
+
   static XLATensor annotate(const XLATensor& input, std::string annotation);
 
   static void arange_out(XLATensor& out, at::Scalar start, at::Scalar end,
@@ -234,6 +434,78 @@ class XLATensor {
   static std::vector<XLATensor> broadcast_tensors(
       absl::Span<const XLATensor> tensors);
 
+  // Applies the dynamic loss scaling, see BuildLossScaleUpdate(), unscaling the
+  // gradients and updating the loss scale and its count of finite steps in
+  // place. Returns the boolean tensor telling whether the gradients are finite,
+  // to be passed to the optimizer update.
+  static XLATensor loss_scale_update_(std::vector<XLATensor>* grads,
+                                      XLATensor* loss_scale,
+                                      XLATensor* good_steps,
+                                      xla::int64 growth_interval,
+                                      double growth_factor,
+                                      double backoff_factor);
+
+  // Applies the SGD with momentum update, see BuildSgdUpdate(), to the weights
+  // and velocities in place, grouping and skipping like adam_update_() does.
+  static void sgd_update_(std::vector<XLATensor>* weights,
+                          std::vector<XLATensor>* velocities,
+                          const std::vector<XLATensor>& grads,
+                          const XLATensor& learning_rate,
+                          const XLATensor& momentum,
+                          const XLATensor& weight_decay, bool nesterov,
+                          const XLATensor* grads_finite = nullptr);
+
+  // Writes update into the fixed capacity cache, at the scalar position along
+  // dim. Once the previous value of the cache is dead, its buffer is donated to
+  // the new value at the step barriers, even without XLA_ENABLE_PARAM_ALIASING,
+  // so that the key and value caches of autoregressive decoding are not copied
+  // at every step.
+  static void kv_cache_update_(XLATensor& cache, const XLATensor& update,
+                               const XLATensor& position, xla::int64 dim);
+
+  // Marks dim of the input, padded up to a bound, as dynamic with the scalar
+  // size as its actual size. The graph gets hashed and compiled for the bound,
+  // the size being one of its parameters, and the XLA dynamic padder makes the
+  // ops reading the input ignore the padding, so that a single executable
+  // serves every size up to the bound.
+  static XLATensor set_dimension_bound(const XLATensor& input,
+                                       const XLATensor& size, xla::int64 dim);
+
+  // Makes the dynamic dim of the input static at its bound, with zeros past
+  // its actual size. The tensors with dynamic dimensions must go through it
+  // before their values are fetched.
+  static XLATensor remove_dynamic_dimension(const XLATensor& input,
+                                            xla::int64 dim);
+
+  // Splits dimension i of the input into shard_counts[i] shards across the
+  // partitions, see sharding_util.h. The counts must multiply to the number
+  // of partitions, or all be one.
+  static XLATensor shard(const XLATensor& input,
+                         absl::Span<const xla::int64> shard_counts);
+
+  // Applies the Adam update to weights replicated across the replication
+  // devices, which only keep a shard of the moments, see
+  // BuildShardedAdamUpdate(). The moment shards are rank 1 tensors, whose size
+  // is given by sharded_optimizer_shard_size(). The grads are the local ones of
+  // the replica, their sum over the replicas gets multiplied by grad_scale.
+  // The weights must share their device and element type.
+  static void sharded_adam_update_(std::vector<XLATensor>* weights,
+                                   XLATensor* first_moment_shard,
+                                   XLATensor* second_moment_shard,
+                                   const std::vector<XLATensor>& grads,
+                                   const XLATensor& learning_rate,
+                                   const XLATensor& beta1,
+                                   const XLATensor& beta2,
+                                   const XLATensor& epsilon,
+                                   const XLATensor& weight_decay,
+                                   double grad_scale,
+                                   const XLATensor* grads_finite = nullptr);
+
+  // Returns the size of the optimizer state shards of the weights, when
+  // sharded across the replication devices.
+  static xla::int64 sharded_optimizer_shard_size(
+      const std::vector<XLATensor>& weights);
+
   static XLATensor tf_StatelessRandomNormal(absl::Span<const xla::int64> size,
                                             const XLATensor& seeds,
                                             const Device& device,
@@ -261,18 +533,112 @@ class XLATensor {
       absl::Span<const std::pair<xla::int64, xla::int64>> spatial_padding,
       const xla::TensorFormat& data_format, const bool counts_include_padding);
 
+  static XLATensor xla_embedding_bag(
+      const XLATensor& table, const XLATensor& indices,
+      const absl::optional<XLATensor>& per_sample_weights,
+      EmbeddingBagMode mode);
+
+  static XLATensor xla_embedding_bag_backward(
+      const XLATensor& grad_output, const XLATensor& table,
+      const XLATensor& indices, const XLATensor& output,
+      const absl::optional<XLATensor>& per_sample_weights,
+      EmbeddingBagMode mode);
+
+  // Returns the normalized input, and the batch mean and variance.
+  static std::tuple<XLATensor, XLATensor, XLATensor> xla_fused_batch_norm(
+      const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+      const absl::optional<XLATensor>& residual,
+      const FusedBatchNormOptions& options);
+
+  // Returns the input, weight, bias and residual gradients.
+  static std::tuple<XLATensor, XLATensor, XLATensor, XLATensor>
+  xla_fused_batch_norm_backward(const XLATensor& grad_output,
+                                const XLATensor& input, const XLATensor& weight,
+                                const XLATensor& mean,
+                                const XLATensor& variance,
+                                const XLATensor& output,
+                                const FusedBatchNormOptions& options);
+
+  // Returns the normalized input, and the mean and variance of every position
+  // of the other dimensions.
+  static std::tuple<XLATensor, XLATensor, XLATensor> xla_layer_norm(
+      const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+      xla::int64 axis, double eps);
+
+  // Returns the input, weight and bias gradients.
+  static std::tuple<XLATensor, XLATensor, XLATensor> xla_layer_norm_backward(
+      const XLATensor& grad_output, const XLATensor& input,
+      const XLATensor& weight, const XLATensor& mean,
+      const XLATensor& variance, xla::int64 axis, double eps);
+
+  // Returns the normalized input, and the inverse root mean square of every
+  // position of the other dimensions.
+  static std::tuple<XLATensor, XLATensor> xla_rms_norm(const XLATensor& input,
+                                                       const XLATensor& weight,
+                                                       xla::int64 axis,
+                                                       double eps);
+
+  // Returns the input and weight gradients.
+  static std::tuple<XLATensor, XLATensor> xla_rms_norm_backward(
+      const XLATensor& grad_output, const XLATensor& input,
+      const XLATensor& weight, const XLATensor& inv_rms, xla::int64 axis);
+
   static XLATensor xla_max_pool(const XLATensor& input,
                                 absl::Span<const xla::int64> kernel_size,
                                 absl::Span<const xla::int64> stride,
                                 xla::Padding padding,
                                 const xla::TensorFormat& data_format);
 
+  // Unless output is still traced from a pooling of input which saved the
+  // indices of its maxima, the gradient is computed with a select-and-scatter
+  // over input.
   static XLATensor xla_max_pool_grad(const XLATensor& input,
+                                     const XLATensor& output,
                                      const XLATensor& out_backprop,
                                      absl::Span<const xla::int64> kernel_size,
                                      absl::Span<const xla::int64> stride,
                                      xla::Padding padding);
 
+  // Returns the selected box indices and their number, see BuildTiledNms().
+  static std::pair<XLATensor, XLATensor> xla_nms(
+      const XLATensor& boxes, const XLATensor& scores, double score_threshold,
+      double iou_threshold, xla::int64 output_size, xla::int64 tile_size);
+
+  // Returns the attention output and the logsumexp of the score rows. The key
+  // positions at or past the scalar valid_length, if any, are masked out.
+  static std::pair<XLATensor, XLATensor> xla_scaled_dot_product_attention(
+      const XLATensor& query, const XLATensor& key, const XLATensor& value,
+      double scale, bool causal, xla::int64 block_size,
+      const absl::optional<XLATensor>& valid_length = absl::nullopt);
+
+  // Returns the query, key and value gradients.
+  static std::tuple<XLATensor, XLATensor, XLATensor>
+  xla_scaled_dot_product_attention_backward(
+      const XLATensor& grad_output, const XLATensor& query,
+      const XLATensor& key, const XLATensor& value, const XLATensor& output,
+      const XLATensor& logsumexp, double scale, bool causal,
+      xla::int64 block_size);
+
+  static XLATensor xla_resize_bilinear(const XLATensor& input,
+                                       std::vector<xla::int64> output_size,
+                                       bool align_corners,
+                                       bool half_pixel_centers,
+                                       bool channels_last);
+
+  static XLATensor xla_resize_bilinear_backward(
+      const XLATensor& grad_output, std::vector<xla::int64> input_size,
+      bool align_corners, bool half_pixel_centers, bool channels_last);
+
+  // Returns random values of the given size, drawn from the next stream of the
+  // step seed of the device the distribution parameters live on.
+  static XLATensor xla_rng_normal(absl::Span<const xla::int64> size,
+                                  const XLATensor& mean,
+                                  const XLATensor& stddev);
+
+  static XLATensor xla_rng_uniform(absl::Span<const xla::int64> size,
+                                   const XLATensor& minval,
+                                   const XLATensor& maxval);
+
   static XLATensor xla_pad(const XLATensor& input, at::Scalar padding_value,
                            xla::PaddingConfig padding_config);
 
@@ -281,11 +647,21 @@ class XLATensor {
                              absl::Span<const xla::int64> limit_indices,
                              absl::Span<const xla::int64> stride);
 
+  // Returns the per example softmax cross-entropy losses of logits against the
+  // labels class indices, and their logits gradient.
+  static std::pair<XLATensor, XLATensor> xla_softmax_cross_entropy(
+      const XLATensor& logits, const XLATensor& labels, int ignore_index,
+      double label_smoothing, xla::int64 chunk_size);
+
   static XLATensor xla_truncated_normal(const XLATensor& input);
 
   static XLATensor xla_replica_id(const Device& device);
 
  private:
+  // The benchmarks time, and reset, the sync internals directly.
+  friend class XLATensorBenchmarks;
+  friend class XLATensorStepBenchmarks;
+
   struct SyncTensorsConfig {
     // Whether we want to force XLA data on the target tensors (hence trimming
     // the IR graph above them).
@@ -299,6 +675,8 @@ class XLATensor {
     SyncTensorCollection() : hash(0) {}
 
     SyncTensorsConfig config;
+    // The indices of the tensors to sync, in the order of the graph outputs,
+    // which is the order of their IR hashes.
     std::vector<size_t> indices;
     xla::hash_t hash;
     std::vector<xla::util::ExceptionCleanup> unlocker;
@@ -310,25 +688,66 @@ class XLATensor {
     ir::Util::EmissionMap emission_map;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
     std::vector<size_t> parameter_sequence;
-  };
-
-  struct CompilationResult {
-    Device device;
-    size_t emitted_nodes = 0;
-    std::shared_ptr<xla::ComputationClient::Computation> computation;
-    std::vector<xla::ComputationClient::DataPtr> parameters_data;
+    // Indices (within parameters_data) of the parameters whose buffers are
+    // not referenced by any live tensor, and can be donated to the outputs.
+    std::vector<size_t> donatable_parameters;
+    // Indices (within parameters_data) of the parameters whose buffers are
+    // held by a pending checkpoint, and must not be aliased to the outputs.
+    std::vector<size_t> pinned_parameters;
   };
 
   struct CachedComputation {
     CachedComputation(
-        std::shared_ptr<xla::ComputationClient::Computation> computation)
-        : computation(std::move(computation)) {}
+        std::shared_ptr<xla::ComputationClient::Computation> computation,
+        size_t graph_size, double compile_time)
+        : computation(std::move(computation)),
+          graph_size(graph_size),
+          compile_time(compile_time),
+          size(this->computation->computation().proto().ByteSizeLong()),
+          memory(xla::metrics::MemoryAccounting::Get()->Track(
+              this->computation->devices().empty()
+                  ? std::string()
+                  : this->computation->devices().front(),
+              xla::metrics::MemoryKind::kExecutable, size)) {}
 
     std::shared_ptr<xla::ComputationClient::Computation> computation;
+    // Number of IR nodes emitted when lowering the computation.
+    size_t graph_size = 0;
+    // Seconds spent by the backend compiling the computation.
+    double compile_time = 0;
+    // The size of the computation HLO, used as a proxy for the size of the
+    // executable, which the computation client does not expose.
+    size_t size = 0;
+    std::shared_ptr<xla::metrics::MemoryAccounting::Allocation> memory;
+    // Whether the computation has been compiled with the low optimization
+    // profile, and so gets recompiled once it turns out to run often.
+    bool fast_compiled = false;
+  };
+
+  // Weighs cached computations by the time it would take to recompile them.
+  struct CachedComputationWeigher {
+    double Cost(const CachedComputation& computation) const {
+      // Keep a floor, so that trivially cheap computations still get ranked by
+      // access frequency.
+      return std::max(computation.compile_time, 1e-6);
+    }
+
+    size_t Size(const CachedComputation& computation) const {
+      return computation.size;
+    }
   };
 
   using ComputationCache =
-      xla::util::Cache<xla::hash_t, CachedComputation, xla::util::HashReducer>;
+      xla::util::CostAwareCache<xla::hash_t, CachedComputation,
+                                CachedComputationWeigher,
+                                xla::util::HashReducer>;
+
+  struct CompilationResult {
+    Device device;
+    size_t emitted_nodes = 0;
+    std::shared_ptr<CachedComputation> cached_computation;
+    std::vector<xla::ComputationClient::DataPtr> parameters_data;
+  };
 
   struct Async {
     Async(SyncTensorCollection* coll,
@@ -350,34 +769,66 @@ class XLATensor {
   // This is the core XLA tensor data structure where all the tensor data is
   // held. The XLA tensor is nothing more than a shared pointer to a Data
   // object.
+  // Every traced op result gets its own Data, so the fields are ordered to
+  // avoid padding, and the host value, which most traced tensors never have,
+  // is held out of line.
   struct Data {
     Data(xla::ComputationClient::DataPtr xla_data, const Device& device,
          c10::optional<at::ScalarType> logical_element_type)
         : xla_data(std::move(xla_data)),
-          logical_element_type(logical_element_type),
           device(device),
-          unique_id(GetNextTensorId()) {}
+          unique_id(GetNextTensorId()),
+          trace_context(GetTraceContext()),
+          logical_element_type(logical_element_type) {}
     Data(ir::Value ir_value, const Device& device,
          c10::optional<at::ScalarType> logical_element_type)
         : ir_value(std::move(ir_value)),
-          logical_element_type(logical_element_type),
           device(device),
-          unique_id(GetNextTensorId()) {}
+          unique_id(GetNextTensorId()),
+          trace_context(GetTraceContext()),
+          logical_element_type(logical_element_type) {}
     Data(at::Tensor tensor_data, const Device& device)
-        : logical_element_type(tensor_data.scalar_type()),
-          tensor_data(std::move(tensor_data)),
-          device(device),
-          unique_id(GetNextTensorId()) {}
+        : device(device),
+          unique_id(GetNextTensorId()),
+          trace_context(GetTraceContext()),
+          logical_element_type(tensor_data.scalar_type()) {
+      SetTensorData(std::move(tensor_data));
+    }
 
     ~Data();
 
+    // Drops the device data, recording the tensor as pending a sync. The
+    // device data must only be dropped through here, since the syncs of the
+    // live tensors only look at the pending ones.
+    void ResetXlaData();
+
+    void SetTensorData(at::Tensor value) {
+      tensor_data = absl::make_unique<at::Tensor>(std::move(value));
+    }
+
     xla::ComputationClient::DataPtr xla_data;
     ir::Value ir_value;
-    c10::optional<at::ScalarType> logical_element_type;
-    c10::optional<at::Tensor> tensor_data;
+    std::unique_ptr<at::Tensor> tensor_data;
     const Device device;
     const xla::int64 unique_id = 0;
+    // The trace context the tensor got created within.
+    const xla::int64 trace_context = 0;
     size_t generation = 1;
+    // The DeviceContextArena shard the tensor is registered within.
+    size_t registry_shard = 0;
+    // The tick of the last use of the device data, which orders the eviction
+    // candidates under device memory pressure.
+    size_t last_use = 0;
+    c10::optional<at::ScalarType> logical_element_type;
+    // Whether the device data got evicted, leaving tensor_data as the only
+    // copy, until it gets uploaded again.
+    bool evicted = false;
+    // Whether tensor_data outlives the upload of the tensor, see
+    // KeepHostData().
+    bool keep_host_data = false;
+    // Whether the device data buffer gets donated to the next value of the
+    // tensor, see kv_cache_update_().
+    bool donate_in_place = false;
   };
 
   XLATensor(const at::Tensor& tensor, const Device& device);
@@ -387,6 +838,11 @@ class XLATensor {
             c10::optional<at::ScalarType> logical_element_type = absl::nullopt);
   XLATensor(std::shared_ptr<Data> data);
 
+  // Allocates the Data and its reference counts in a single block, which
+  // comes from the IR node arena like the heap allocated tensors.
+  template <typename... Args>
+  static std::shared_ptr<Data> MakeData(Args&&... args);
+
   Data* data() const;
 
   std::shared_ptr<Data> data_ptr() const { return data_; }
@@ -400,9 +856,15 @@ class XLATensor {
 
   void SetTensorData(at::Tensor tensor_data);
 
-  ir::Value CreateTensorNode(xla::ComputationClient::DataPtr data,
-                             bool read_only) const;
+  // The host value, if given, is the one of the data, which lets tiny graphs
+  // using it be evaluated on the host.
+  ir::Value CreateTensorNode(
+      xla::ComputationClient::DataPtr data, bool read_only,
+      c10::optional<at::Tensor> host_value = c10::nullopt) const;
 
+  // Copies the tensor to another device. With XLA_ASYNC_DEVICE_COPY, the
+  // default, the copy runs in the background, after the pending graph of the
+  // tensor, and the returned tensor holds a placeholder until it is done.
   XLATensor CopyTensorToDevice(const Device& device);
 
  public:
@@ -426,6 +888,10 @@ class XLATensor {
   //     a = a + b
   void TryLimitGraphSize();
 
+  // Materializes the pending graph of this tensor, recording the hash of its
+  // IR node as a cut point for the subsequent steps.
+  void CutPendingGraph(xla::hash_t hash);
+
   std::vector<XLATensor> MakeOutputTensors(ir::NodePtr node) const;
 
   ir::Value GetIrValueForTensor(const at::Tensor& tensor,
@@ -443,6 +909,26 @@ class XLATensor {
   static std::vector<at::Tensor> GetTensorsFused(
       std::vector<XLATensor>* tensors);
 
+  // With XLA_NUMERICS_GUARD, sets guarded_tensors to the tensors followed by
+  // a boolean scalar telling whether the floating point values their sync
+  // computes are all finite, which becomes the numerics guard of the device.
+  // Returns false, leaving guarded_tensors untouched, if the guard is
+  // disabled or the sync computes no floating point value.
+  static bool AppendNumericsGuard(const std::vector<XLATensor>& tensors,
+                                  std::vector<XLATensor>* guarded_tensors);
+
+  // Evaluates the pending graphs of the tensors on the host when they are
+  // tiny, and all their device data has a host copy, and replaces them with
+  // their values. Returns false if the tensors must be synced on the device.
+  static bool GetTensorsOnHost(std::vector<XLATensor>* tensors,
+                               std::vector<at::Tensor>* results);
+
+  // Fetches the values of the tensors, taking them from the host copies when
+  // available, and from tensors_data (one per missing host copy) otherwise.
+  static std::vector<at::Tensor> FetchTensors(
+      const std::vector<XLATensor>& tensors,
+      absl::Span<const xla::ComputationClient::DataPtr> tensors_data);
+
   // Runs an asynchronous syn operation using the op-by-op executor.
   using OpByOpAsync = xla::util::AsyncTask<xla::Status>;
   static OpByOpAsync SyncTensorsGraphOpByOp(
@@ -476,9 +962,20 @@ class XLATensor {
       std::vector<xla::ComputationClient::DataPtr> parameters_data,
       std::string device, ComputationCache::TypePtr cached_computation);
 
+  static std::vector<const ir::Node*> CollectRootNodes(
+      const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices);
+
+  static void CollectParametersData(absl::Span<const ir::Node* const> nodes,
+                                    PostOrderData* po_data);
+
   static PostOrderData RunPostOrder(const std::vector<XLATensor>& tensors,
                                     absl::Span<const size_t> indices);
 
+  // Same as RunPostOrder(), but only fills the parameters data and sequence,
+  // which is all a computation cache lookup needs.
+  static PostOrderData RunLeafOrder(const std::vector<XLATensor>& tensors,
+                                    absl::Span<const size_t> indices);
+
   static ComputationCache::TypePtr LookupCachedCompile(
       const std::vector<XLATensor>& tensors, const xla::hash_t& hash);
 
@@ -486,21 +983,104 @@ class XLATensor {
       std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
       PostOrderData* po_data);
 
-  static void BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
-                                      absl::Span<const size_t> indices,
-                                      ir::LoweringContext* lowering_ctx);
+  // Fills po_data->donatable_parameters with the parameters which are dead
+  // after the step, and po_data->pinned_parameters with the ones held by a
+  // pending checkpoint, and mixes them into the collection hash, as they change
+  // the aliasing the computation gets compiled with. Without
+  // XLA_ENABLE_PARAM_ALIASING, only the dead parameters of the tensors updated
+  // in place, see kv_cache_update_(), are donatable.
+  static void CollectDonatableParameters(SyncTensorCollection* coll,
+                                         PostOrderData* po_data);
+
+  // Aliases the parameters to the outputs of the same tensors, and donates the
+  // donatable_parameters to the remaining outputs of the same shape. With
+  // donate_only, only the donation happens.
+  static void BuildInputOutputAliases(
+      const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices,
+      absl::Span<const size_t> donatable_parameters,
+      absl::Span<const size_t> pinned_parameters, bool donate_only,
+      ir::LoweringContext* lowering_ctx);
 
   static CompilationResult Compile(const std::vector<XLATensor>& tensors,
                                    absl::Span<const std::string> devices,
                                    const SyncTensorCollection& coll,
                                    PostOrderData* po_data);
 
+  // Lowers the graph rooted at the collection tensors, or loads it from the
+  // persistent cache, in which case persisted is set to true.
+  static xla::XlaComputation BuildComputation(
+      const std::vector<XLATensor>& tensors, const SyncTensorCollection& coll,
+      PostOrderData* po_data, size_t* emitted_nodes, bool* persisted);
+
+  // Stores the statistics of a finished compilation, together with the frames
+  // of the current call site, into the compile profile.
+  static void RecordCompileProfile(const Device& device,
+                                   const xla::hash_t& hash,
+                                   const xla::XlaComputation& computation,
+                                   size_t emitted_nodes, double compile_time);
+
+  // Accounts an execution of the computation compiled from the IR graph with
+  // the given hash into the execution profile.
+  static void RecordExecutionProfile(
+      const xla::hash_t& hash, const std::string& device,
+      const xla::ComputationClient::ComputationPtr& computation,
+      xla::int64 execute_time_ns);
+
+  // Compiles an already lowered computation. When persistent_cache is not
+  // null, the lowered computation is also stored on disk. If fast_compile is
+  // set, the backend spends less time optimizing the computation.
+  static ComputationCache::TypePtr CompileLowered(
+      absl::Span<const std::string> devices, const Device& device,
+      const xla::hash_t& hash, xla::XlaComputation computation,
+      size_t num_parameters, size_t emitted_nodes,
+      const xla::util::PersistentCache* persistent_cache,
+      bool fast_compile = false);
+
+  // Once a computation compiled with the low optimization profile has been
+  // executed XLA_TIERED_COMPILE_THRESHOLD times, recompiles it in the
+  // background with full optimization, and replaces it in the cache.
+  static void MaybeScheduleOptimizedRecompile(
+      const xla::hash_t& hash, const std::string& device,
+      const ComputationCache::TypePtr& cached_computation);
+
+  // If XLA_ASYNC_COMPILE is enabled, lowers the graph and pushes its
+  // compilation to the background, returning true. The caller is then
+  // expected to run the current step op-by-op.
+  static bool TryScheduleAsyncCompile(const std::vector<XLATensor>& tensors,
+                                      absl::Span<const std::string> devices,
+                                      const SyncTensorCollection& coll,
+                                      PostOrderData* po_data);
+
+  // Runs the graph of an already collected set of tensors through the
+  // op-by-op executor, with the same completion semantics as
+  // ScheduleSyncTensorsGraph().
+  static std::shared_ptr<Async> ScheduleSyncTensorsGraphOpByOp(
+      std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
+      SyncTensorCollection* coll);
+
   static std::shared_ptr<Async> SyncTensorsGraphInternal(
       std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
       const SyncTensorsConfig& config);
 
   static xla::int64 GetNextTensorId();
 
+  // When the device memory in use crosses XLA_EVICTION_THRESHOLD of the device
+  // memory, evicts the least recently used device data of the live tensors of
+  // the device, down to XLA_EVICTION_TARGET of it.
+  static void MaybeEvictTensors(const Device& device);
+
+  // Moves the device data of the least recently used live tensors of the device
+  // to host memory, until at least bytes are released. Only the device data
+  // referenced by nothing but its tensor is considered, as evicting the other
+  // one would not release it. Returns the bytes released.
+  static xla::int64 EvictTensors(const Device& device, xla::int64 bytes);
+
+  // With XLA_EAGER_ASYNC_DISPATCH, queues the computation of the pending IR
+  // value of the tensor on its device right away, to run op by op, and gives
+  // the tensor the device data it is computed into. Returns whether the value
+  // got dispatched.
+  bool ApplyEagerDispatch();
+
   // Check if the current node is a cutpoint (by hash) and apply pending graph -
   // in other words, cut the trace - and return true iff that's the case.
   bool ApplyTraceletCutpoint();
@@ -511,7 +1091,15 @@ class XLATensor {
   // unrolled sequences of code despite the body being identical. The hope is to
   // reach a steady state in which no new tracelets are created after a
   // relatively small number of cuts.
-  static void InsertTraceletCutpoint(const PostOrderData& po_data);
+  static void InsertTraceletCutpoint(const PostOrderData& po_data,
+                                     const Device& device);
+
+  // When XLA_SPECULATIVE_COMPILE is enabled, lowers and compiles in the
+  // background the graph rooted at a newly inserted tracelet cutpoint, so that
+  // it is already in the computation cache when the next step materializes it.
+  static void MaybeScheduleSpeculativeCompile(const PostOrderData& po_data,
+                                              size_t cutpoint_index,
+                                              const Device& device);
 
   std::shared_ptr<Data> data_;
 };
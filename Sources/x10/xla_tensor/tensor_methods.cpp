@@ -13,7 +13,11 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <deque>
 #include <functional>
+#include <future>
+#include <map>
+#include <numeric>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
@@ -22,24 +26,54 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/adam_update.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_gather.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_reduce.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/annotate.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/embedding_bag.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/embedding_bag_backward.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/fused_batch_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/fused_batch_norm_backward.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/layer_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/layer_norm_backward.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/loss_scale_update.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/nms.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/reduce_scatter.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/replica_id.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/resize_bilinear.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/resize_bilinear_backward.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rms_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rms_norm_backward.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rng_normal.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rng_uniform.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scaled_dot_product_attention.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scaled_dot_product_attention_backward.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sgd_update.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sharded_adam_update.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sharding.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/softmax_cross_entropy.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_stateless_random_normal.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/user_computation.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_avg_pool.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_avg_pool_grad.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_max_pool.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_max_pool_grad.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_pad.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_slice.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_updates.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/pooling.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/shape_builder.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/sharding_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 
@@ -82,6 +116,15 @@ void CheckRank(const XLATensor& t, xla::int64 expected_rank,
       << " (while checking arguments for " << tag << ")";
 }
 
+void CheckShardGroups(const std::vector<std::vector<xla::int64>>& groups,
+                      xla::int64 shard_count) {
+  XLA_CHECK_GT(shard_count, 0);
+  for (auto& group : groups) {
+    XLA_CHECK_EQ(group.size(), shard_count)
+        << "Every replica group must hold one replica per shard";
+  }
+}
+
 template <typename T>
 void CheckShapeDimensions(const T& size) {
   XLA_CHECK(std::all_of(size.begin(), size.end(), [](xla::int64 dim) {
@@ -176,22 +219,278 @@ void CheckIsIntegralOrPred(const xla::Shape& shape,
       << shape;
 }
 
+// Groups the indices of the tensors by device and element type, in a
+// deterministic order.
+std::vector<std::vector<size_t>> GroupByDeviceAndType(
+    const std::vector<XLATensor>& tensors) {
+  std::map<std::pair<Device, xla::PrimitiveType>, std::vector<size_t>> groups;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    groups[{tensors[i].GetDevice(), tensors[i].shape().get().element_type()}]
+        .push_back(i);
+  }
+  std::vector<std::vector<size_t>> result;
+  result.reserve(groups.size());
+  for (auto& device_type_indices : groups) {
+    result.push_back(std::move(device_type_indices.second));
+  }
+  return result;
+}
+
+std::vector<ir::Value> GetIrValues(const std::vector<XLATensor>& tensors,
+                                   absl::Span<const size_t> indices) {
+  std::vector<ir::Value> values;
+  values.reserve(indices.size());
+  for (size_t index : indices) {
+    values.push_back(tensors[index].GetIrValue());
+  }
+  return values;
+}
+
+// Returns the IR value of the hyperparameter, on the given device.
+ir::Value GetHyperparameter(const XLATensor& hyperparameter,
+                            const Device& device) {
+  if (hyperparameter.GetDevice() == device) {
+    return hyperparameter.GetIrValue();
+  }
+  XLATensor copy = hyperparameter;
+  return XLATensor::to(copy, device, c10::nullopt).GetIrValue();
+}
+
+absl::optional<ir::Value> GetOptionalHyperparameter(
+    const XLATensor* hyperparameter, const Device& device) {
+  if (hyperparameter == nullptr) {
+    return absl::nullopt;
+  }
+  return GetHyperparameter(*hyperparameter, device);
+}
+
+xla::int64 GetOffloadBucketBytes() {
+  static const xla::int64 bucket_bytes =
+      xla::sys_util::GetEnvInt("XLA_OFFLOAD_BUCKET_BYTES", 64 << 20);
+  return bucket_bytes;
+}
+
+// Whether the tiling max poolings save the indices of their maxima for their
+// gradient, trading the memory holding the indices until the backward pass for
+// a gradient without select-and-scatter.
+bool MaxPoolGradFromIndices() {
+  static const bool from_indices =
+      xla::sys_util::GetEnvBool("XLA_MAX_POOL_GRAD_INDICES", false);
+  return from_indices;
+}
+
+// Returns the indices output of the tiling max pooling of input which produced
+// output, if output is still traced.
+absl::optional<ir::Value> GetMaxPoolIndices(const XLATensor& input,
+                                            const XLATensor& output) {
+  ir::Value output_value = output.GetIrValue();
+  const ir::ops::XlaMaxPool* pool =
+      dynamic_cast<const ir::ops::XlaMaxPool*>(output_value.node.get());
+  if (pool == nullptr || !pool->with_indices() || output_value.index != 0) {
+    return absl::nullopt;
+  }
+  ir::Value input_value = input.GetIrValue();
+  if (pool->operand(0).node != input_value.node.get() ||
+      pool->operand(0).index != input_value.index) {
+    return absl::nullopt;
+  }
+  return ir::Value(output_value.node, 1);
+}
+
+// Splits the indices of the weights into consecutive buckets, each holding at
+// most bucket_bytes of moments, or a single weight.
+std::vector<std::vector<size_t>> GetOffloadBuckets(
+    const std::vector<XLATensor>& moments, xla::int64 bucket_bytes) {
+  std::vector<std::vector<size_t>> buckets;
+  xla::int64 current_bytes = 0;
+  for (size_t i = 0; i < moments.size(); ++i) {
+    xla::int64 bytes = 2 * xla::ShapeUtil::ByteSizeOf(moments[i].shape().get());
+    if (buckets.empty() || current_bytes + bytes > bucket_bytes) {
+      buckets.emplace_back();
+      current_bytes = 0;
+    }
+    buckets.back().push_back(i);
+    current_bytes += bytes;
+  }
+  return buckets;
+}
+
+bool IsHostResident(const XLATensor& tensor) {
+  return tensor.CurrentXlaData() == nullptr && !tensor.CurrentIrValue() &&
+         tensor.CurrentTensorData();
+}
+
 }  // namespace
 
 //////////////////////////////////////////////////////////////////////////////
 // XLA dedicated operators follows here, listed in alphabetical order.
 //////////////////////////////////////////////////////////////////////////////
+void XLATensor::adam_update_(std::vector<XLATensor>* weights,
+                             std::vector<XLATensor>* first_moments,
+                             std::vector<XLATensor>* second_moments,
+                             const std::vector<XLATensor>& grads,
+                             const XLATensor& learning_rate,
+                             const XLATensor& beta1, const XLATensor& beta2,
+                             const XLATensor& epsilon,
+                             const XLATensor& weight_decay,
+                             const XLATensor* grads_finite) {
+  XLA_CHECK_EQ(weights->size(), grads.size());
+  XLA_CHECK_EQ(weights->size(), first_moments->size());
+  XLA_CHECK_EQ(weights->size(), second_moments->size());
+  for (const std::vector<size_t>& indices : GroupByDeviceAndType(*weights)) {
+    const Device& device = (*weights)[indices.front()].GetDevice();
+    ir::NodePtr node = ir::MakeNode<ir::ops::AdamUpdate>(
+        GetIrValues(*weights, indices), GetIrValues(grads, indices),
+        GetIrValues(*first_moments, indices),
+        GetIrValues(*second_moments, indices),
+        GetHyperparameter(learning_rate, device),
+        GetHyperparameter(beta1, device), GetHyperparameter(beta2, device),
+        GetHyperparameter(epsilon, device),
+        GetHyperparameter(weight_decay, device),
+        GetOptionalHyperparameter(grads_finite, device));
+    size_t n = indices.size();
+    for (size_t i = 0; i < n; ++i) {
+      (*weights)[indices[i]].SetInPlaceIrValue(ir::Value(node, i));
+      (*first_moments)[indices[i]].SetInPlaceIrValue(ir::Value(node, n + i));
+      (*second_moments)[indices[i]].SetInPlaceIrValue(
+          ir::Value(node, 2 * n + i));
+    }
+    XLA_VALUE_METRIC("FusedOptimizerUpdateSize", n);
+  }
+}
+
+void XLATensor::adam_update_offloaded_(
+    std::vector<XLATensor>* weights, std::vector<XLATensor>* first_moments,
+    std::vector<XLATensor>* second_moments, const std::vector<XLATensor>& grads,
+    const XLATensor& learning_rate, const XLATensor& beta1,
+    const XLATensor& beta2, const XLATensor& epsilon,
+    const XLATensor& weight_decay, const XLATensor* grads_finite) {
+  XLA_CHECK_EQ(weights->size(), grads.size());
+  XLA_CHECK_EQ(weights->size(), first_moments->size());
+  XLA_CHECK_EQ(weights->size(), second_moments->size());
+  // Every bucket is a separate computation, so the pending graph of the
+  // gradients is materialized once, instead of once per bucket.
+  std::vector<XLATensor> inputs(grads);
+  if (grads_finite != nullptr) {
+    inputs.push_back(*grads_finite);
+  }
+  SyncTensorsGraph(&inputs, {}, /*wait=*/false, /*sync_xla_data=*/true);
+
+  auto prefetch = [&](const std::vector<size_t>& bucket) {
+    for (size_t i : bucket) {
+      for (XLATensor* moment : {&(*first_moments)[i], &(*second_moments)[i]}) {
+        if (IsHostResident(*moment)) {
+          moment->SetXlaData(TensorToXlaDataAsync(*moment->CurrentTensorData(),
+                                                  moment->GetDevice()),
+                             /*sync=*/true);
+        }
+      }
+    }
+  };
+  // The updated moments of a bucket, and their values being fetched.
+  using WriteBack =
+      std::pair<std::vector<XLATensor>,
+                std::shared_future<std::vector<at::Tensor>>>;
+  std::deque<WriteBack> write_backs;
+  auto complete_write_back = [&]() {
+    WriteBack& write_back = write_backs.front();
+    std::vector<at::Tensor> values = write_back.second.get();
+    for (size_t i = 0; i < values.size(); ++i) {
+      Data* data = write_back.first[i].data();
+      data->ResetXlaData();
+      data->SetTensorData(std::move(values[i]));
+    }
+    write_backs.pop_front();
+  };
+
+  std::vector<std::vector<size_t>> buckets =
+      GetOffloadBuckets(*first_moments, GetOffloadBucketBytes());
+  if (!buckets.empty()) {
+    prefetch(buckets.front());
+  }
+  for (size_t b = 0; b < buckets.size(); ++b) {
+    if (b + 1 < buckets.size()) {
+      prefetch(buckets[b + 1]);
+    }
+    std::vector<XLATensor> bucket_weights;
+    std::vector<XLATensor> bucket_first_moments;
+    std::vector<XLATensor> bucket_second_moments;
+    std::vector<XLATensor> bucket_grads;
+    for (size_t i : buckets[b]) {
+      bucket_weights.push_back((*weights)[i]);
+      bucket_first_moments.push_back((*first_moments)[i]);
+      bucket_second_moments.push_back((*second_moments)[i]);
+      bucket_grads.push_back(grads[i]);
+    }
+    adam_update_(&bucket_weights, &bucket_first_moments, &bucket_second_moments,
+                 bucket_grads, learning_rate, beta1, beta2, epsilon,
+                 weight_decay, grads_finite);
+    std::vector<XLATensor> moments(std::move(bucket_first_moments));
+    moments.insert(moments.end(), bucket_second_moments.begin(),
+                   bucket_second_moments.end());
+    std::vector<XLATensor> outputs(moments);
+    outputs.insert(outputs.end(), bucket_weights.begin(),
+                   bucket_weights.end());
+    SyncTensorsConfig config;
+    std::shared_ptr<Async> async =
+        SyncTensorsGraphInternal(&outputs, {}, config);
+
+    std::vector<xla::ComputationClient::DataPtr> moments_data;
+    std::vector<at::ScalarType> moment_types;
+    for (const XLATensor& moment : moments) {
+      moments_data.push_back(moment.CurrentXlaData());
+      moment_types.push_back(moment.dtype());
+    }
+    auto promise = std::make_shared<std::promise<std::vector<at::Tensor>>>();
+    write_backs.emplace_back(std::move(moments),
+                             promise->get_future().share());
+    auto fetchfn = [promise, async, moments_data = std::move(moments_data),
+                    moment_types = std::move(moment_types)]() {
+      try {
+        if (async != nullptr) {
+          async->Wait();
+        }
+        promise->set_value(XlaDataToTensors(moments_data, moment_types));
+      } catch (...) {
+        promise->set_exception(std::current_exception());
+      }
+    };
+    xla::env::ScheduleIoClosure(std::move(fetchfn));
+    // Bounds the buckets held on the device to the prefetched one, the running
+    // one and the ones being fetched.
+    while (write_backs.size() > 2) {
+      complete_write_back();
+    }
+    XLA_COUNTER("OffloadedOptimizerBuckets", 1);
+  }
+  while (!write_backs.empty()) {
+    complete_write_back();
+  }
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::all_gather(
+    const XLATensor& input, const ir::Value& token, xla::int64 dim,
+    xla::int64 shard_count, std::vector<std::vector<xla::int64>> groups) {
+  CheckShardGroups(groups, shard_count);
+  ir::NodePtr node = ir::MakeNode<ir::ops::AllGather>(
+      input.GetIrValue(), token,
+      XlaHelpers::GetCanonicalDimensionIndex(dim, input.shape().get().rank()),
+      shard_count, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
 std::pair<std::vector<XLATensor>, ir::Value> XLATensor::all_reduce(
     const std::vector<XLATensor>& inputs, const ir::Value& token,
     AllReduceType reduce_type, double scale,
-    std::vector<std::vector<xla::int64>> groups) {
+    std::vector<std::vector<xla::int64>> groups,
+    const AllReduceOptions& options) {
   std::vector<ir::Value> input_values;
   input_values.reserve(inputs.size());
   for (const XLATensor& input : inputs) {
     input_values.push_back(input.GetIrValue());
   }
   ir::NodePtr node = ir::MakeNode<ir::ops::AllReduce>(
-      reduce_type, input_values, token, scale, std::move(groups));
+      reduce_type, input_values, token, scale, std::move(groups), options);
   std::vector<XLATensor> results;
   std::vector<ir::Value> tokens;
   for (size_t i = 0; i < inputs.size(); ++i) {
@@ -200,6 +499,71 @@ std::pair<std::vector<XLATensor>, ir::Value> XLATensor::all_reduce(
   return {results, ir::Value(node, inputs.size())};
 }
 
+std::pair<std::vector<XLATensor>, ir::Value> XLATensor::all_reduce_bucketed(
+    const std::vector<XLATensor>& inputs, const ir::Value& token,
+    AllReduceType reduce_type, double scale,
+    std::vector<std::vector<xla::int64>> groups, xla::int64 bucket_bytes,
+    const AllReduceOptions& options) {
+  if (bucket_bytes <= 0) {
+    return all_reduce(inputs, token, reduce_type, scale, std::move(groups),
+                      options);
+  }
+  std::vector<XLATensor> results(inputs.size());
+  ir::Value chained_token = token;
+  size_t bucket_end = inputs.size();
+  while (bucket_end > 0) {
+    size_t bucket_start = bucket_end - 1;
+    xla::int64 size =
+        xla::ShapeUtil::ByteSizeOfElements(inputs[bucket_start].shape());
+    while (bucket_start > 0) {
+      xla::int64 next_size = xla::ShapeUtil::ByteSizeOfElements(
+          inputs[bucket_start - 1].shape());
+      if (size + next_size > bucket_bytes) {
+        break;
+      }
+      size += next_size;
+      --bucket_start;
+    }
+    std::vector<XLATensor> bucket(inputs.begin() + bucket_start,
+                                  inputs.begin() + bucket_end);
+    auto reduced =
+        all_reduce(bucket, chained_token, reduce_type, scale, groups, options);
+    XLA_COUNTER("AllReduceBuckets", 1);
+    XLA_VALUE_METRIC("AllReduceBucketBytes", size);
+    for (size_t i = 0; i < bucket.size(); ++i) {
+      results[bucket_start + i] = std::move(reduced.first[i]);
+    }
+    chained_token = std::move(reduced.second);
+    bucket_end = bucket_start;
+  }
+  return {results, chained_token};
+}
+
+std::vector<XLATensor> XLATensor::accumulate_(
+    std::vector<XLATensor>* accumulators, const std::vector<XLATensor>& values,
+    bool reset) {
+  XLA_CHECK_EQ(accumulators->size(), values.size());
+  std::vector<XLATensor> sums;
+  for (size_t i = 0; i < values.size(); ++i) {
+    XLATensor& accumulator = (*accumulators)[i];
+    xla::Shape shape = accumulator.shape();
+    XLA_CHECK(xla::ShapeUtil::Compatible(shape, values[i].shape()))
+        << shape << " vs. " << values[i].shape().get();
+    ir::Value sum =
+        ir::ops::Accumulate(accumulator.GetIrValue(), values[i].GetIrValue());
+    accumulator.data()->donate_in_place = true;
+    if (reset) {
+      sums.push_back(accumulator.CreateFrom(sum));
+      accumulator.SetInPlaceIrValue(
+          GetIrValueForScalar(0, shape, accumulator.GetDevice()));
+    } else {
+      accumulator.SetInPlaceIrValue(sum);
+    }
+  }
+  XLA_VALUE_METRIC("AccumulatedTensors", values.size());
+  return sums;
+}
+
 XLATensor XLATensor::annotate(const XLATensor& input, std::string annotation) {
   return input.CreateFrom(
       ir::MakeNode<ir::ops::Annotate>(input.GetIrValue(), annotation));
@@ -222,6 +586,193 @@ std::vector<XLATensor> XLATensor::broadcast_tensors(
   return tensors.front().MakeOutputTensors(node);
 }
 
+XLATensor XLATensor::loss_scale_update_(std::vector<XLATensor>* grads,
+                                        XLATensor* loss_scale,
+                                        XLATensor* good_steps,
+                                        xla::int64 growth_interval,
+                                        double growth_factor,
+                                        double backoff_factor) {
+  const Device& device = loss_scale->GetDevice();
+  std::vector<ir::Value> grad_values;
+  grad_values.reserve(grads->size());
+  for (const XLATensor& grad : *grads) {
+    XLA_CHECK_EQ(grad.GetDevice(), device);
+    grad_values.push_back(grad.GetIrValue());
+  }
+  ir::NodePtr node = ir::MakeNode<ir::ops::LossScaleUpdate>(
+      grad_values, loss_scale->GetIrValue(),
+      GetHyperparameter(*good_steps, device), growth_interval, growth_factor,
+      backoff_factor);
+  size_t n = grads->size();
+  for (size_t i = 0; i < n; ++i) {
+    (*grads)[i].SetInPlaceIrValue(ir::Value(node, i));
+  }
+  loss_scale->SetInPlaceIrValue(ir::Value(node, n + 1));
+  good_steps->SetInPlaceIrValue(ir::Value(node, n + 2));
+  return Create(ir::Value(node, n), device, at::ScalarType::Bool);
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::reduce_scatter(
+    const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
+    double scale, xla::int64 dim, xla::int64 shard_count,
+    std::vector<std::vector<xla::int64>> groups) {
+  CheckShardGroups(groups, shard_count);
+  ir::NodePtr node = ir::MakeNode<ir::ops::ReduceScatter>(
+      reduce_type, input.GetIrValue(), token, scale,
+      XlaHelpers::GetCanonicalDimensionIndex(dim, input.shape().get().rank()),
+      shard_count, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+std::vector<XLATensor> XLATensor::user_computation(
+    const std::string& opname, absl::Span<const XLATensor> inputs,
+    ComputationPtr computation) {
+  XLA_CHECK(!inputs.empty());
+  std::vector<ir::Value> input_values;
+  input_values.reserve(inputs.size());
+  for (auto& input : inputs) {
+    input_values.push_back(input.GetIrValue());
+  }
+  ir::NodePtr node = ir::MakeNode<ir::ops::UserComputation>(
+      ir::OpKind::Get(opname), input_values, std::move(computation));
+  return inputs.front().MakeOutputTensors(node);
+}
+
+void XLATensor::sgd_update_(std::vector<XLATensor>* weights,
+                            std::vector<XLATensor>* velocities,
+                            const std::vector<XLATensor>& grads,
+                            const XLATensor& learning_rate,
+                            const XLATensor& momentum,
+                            const XLATensor& weight_decay, bool nesterov,
+                            const XLATensor* grads_finite) {
+  XLA_CHECK_EQ(weights->size(), grads.size());
+  XLA_CHECK_EQ(weights->size(), velocities->size());
+  for (const std::vector<size_t>& indices : GroupByDeviceAndType(*weights)) {
+    const Device& device = (*weights)[indices.front()].GetDevice();
+    ir::NodePtr node = ir::MakeNode<ir::ops::SgdUpdate>(
+        GetIrValues(*weights, indices), GetIrValues(grads, indices),
+        GetIrValues(*velocities, indices),
+        GetHyperparameter(learning_rate, device),
+        GetHyperparameter(momentum, device),
+        GetHyperparameter(weight_decay, device), nesterov,
+        GetOptionalHyperparameter(grads_finite, device));
+    size_t n = indices.size();
+    for (size_t i = 0; i < n; ++i) {
+      (*weights)[indices[i]].SetInPlaceIrValue(ir::Value(node, i));
+      (*velocities)[indices[i]].SetInPlaceIrValue(ir::Value(node, n + i));
+    }
+    XLA_VALUE_METRIC("FusedOptimizerUpdateSize", n);
+  }
+}
+
+void XLATensor::kv_cache_update_(XLATensor& cache, const XLATensor& update,
+                                 const XLATensor& position, xla::int64 dim) {
+  XLA_CHECK_EQ(position.shape().get().rank(), 0) << position.shape().get();
+  xla::int64 canonical_dim =
+      XlaHelpers::GetCanonicalDimensionIndex(dim, cache.shape().get().rank());
+  cache.data()->donate_in_place = true;
+  cache.SetInPlaceIrValue(ir::ops::KvCacheUpdate(
+      cache.GetIrValue(), update.GetIrValue(),
+      GetHyperparameter(position, cache.GetDevice()), canonical_dim));
+}
+
+XLATensor XLATensor::set_dimension_bound(const XLATensor& input,
+                                         const XLATensor& size,
+                                         xla::int64 dim) {
+  XLA_CHECK_EQ(size.shape().get().rank(), 0) << size.shape().get();
+  xla::int64 canonical_dim =
+      XlaHelpers::GetCanonicalDimensionIndex(dim, input.shape().get().rank());
+  XLA_COUNTER("BoundedDynamicDimensions", 1);
+  return input.CreateFrom(ir::ops::SetDimensionBound(
+      input.GetIrValue(), GetHyperparameter(size, input.GetDevice()),
+      canonical_dim));
+}
+
+XLATensor XLATensor::remove_dynamic_dimension(const XLATensor& input,
+                                              xla::int64 dim) {
+  xla::int64 canonical_dim =
+      XlaHelpers::GetCanonicalDimensionIndex(dim, input.shape().get().rank());
+  return input.CreateFrom(
+      ir::ops::RemoveDynamicDimension(input.GetIrValue(), canonical_dim));
+}
+
+XLATensor XLATensor::shard(const XLATensor& input,
+                           absl::Span<const xla::int64> shard_counts) {
+  xla::Shape shape = input.shape();
+  XLA_CHECK_EQ(shard_counts.size(), shape.rank())
+      << "Expected a shard count for every dimension of " << shape;
+  xla::OpSharding sharding = CreateTiledSharding(shard_counts);
+  const Device& device = input.GetDevice();
+  Data* data = input.data();
+  if (data->tensor_data && data->xla_data == nullptr && !data->ir_value &&
+      sharding.type() == xla::OpSharding::OTHER) {
+    // A host tensor is never uploaded whole, the device only gets its shard.
+    xla::ComputationClient::DataPtr xla_data = TensorToXlaData(
+        GetShardTensor(*data->tensor_data, sharding, GetPartitionIndex(device)),
+        device);
+    xla_data->set_sharding(
+        std::make_shared<xla::ComputationClient::Data::Sharding>(
+            xla::ComputationClient::Data::Sharding{
+                sharding, MakeShapeWithDeviceLayout(shape, device.hw_type)}));
+    XLA_COUNTER("ShardedUploads", 1);
+    return Create(std::move(xla_data), data->logical_element_type);
+  }
+  return input.CreateFrom(
+      ir::MakeNode<ir::ops::Sharding>(input.GetIrValue(), std::move(sharding)));
+}
+
+void XLATensor::sharded_adam_update_(
+    std::vector<XLATensor>* weights, XLATensor* first_moment_shard,
+    XLATensor* second_moment_shard, const std::vector<XLATensor>& grads,
+    const XLATensor& learning_rate, const XLATensor& beta1,
+    const XLATensor& beta2, const XLATensor& epsilon,
+    const XLATensor& weight_decay, double grad_scale,
+    const XLATensor* grads_finite) {
+  XLA_CHECK(!weights->empty());
+  XLA_CHECK_EQ(GroupByDeviceAndType(*weights).size(), 1)
+      << "The weights of a sharded update must share device and type";
+  xla::int64 shard_size = sharded_optimizer_shard_size(*weights);
+  for (const XLATensor* shard : {first_moment_shard, second_moment_shard}) {
+    const xla::Shape& shape = shard->shape();
+    XLA_CHECK(shape.rank() == 1 && shape.dimensions(0) == shard_size)
+        << "Expected moment shards of shape [" << shard_size << "], got "
+        << shape;
+  }
+  const Device& device = weights->front().GetDevice();
+  std::vector<size_t> indices(weights->size());
+  std::iota(indices.begin(), indices.end(), 0);
+  ir::NodePtr node = ir::MakeNode<ir::ops::ShardedAdamUpdate>(
+      GetIrValues(*weights, indices), GetIrValues(grads, indices),
+      first_moment_shard->GetIrValue(), second_moment_shard->GetIrValue(),
+      GetHyperparameter(learning_rate, device),
+      GetHyperparameter(beta1, device), GetHyperparameter(beta2, device),
+      GetHyperparameter(epsilon, device),
+      GetHyperparameter(weight_decay, device),
+      std::max<xla::int64>(
+          xla::ComputationClient::GetReplicationDevices().size(), 1),
+      grad_scale, GetOptionalHyperparameter(grads_finite, device));
+  size_t n = weights->size();
+  for (size_t i = 0; i < n; ++i) {
+    (*weights)[i].SetInPlaceIrValue(ir::Value(node, i));
+  }
+  first_moment_shard->SetInPlaceIrValue(ir::Value(node, n));
+  second_moment_shard->SetInPlaceIrValue(ir::Value(node, n + 1));
+  XLA_VALUE_METRIC("FusedOptimizerUpdateSize", n);
+  XLA_COUNTER("ShardedOptimizerUpdates", 1);
+}
+
+xla::int64 XLATensor::sharded_optimizer_shard_size(
+    const std::vector<XLATensor>& weights) {
+  xla::int64 num_elements = 0;
+  for (const XLATensor& weight : weights) {
+    num_elements += xla::ShapeUtil::ElementsIn(weight.shape());
+  }
+  return GetOptimizerShardSize(
+      num_elements,
+      std::max<xla::int64>(
+          xla::ComputationClient::GetReplicationDevices().size(), 1));
+}
+
 XLATensor XLATensor::tf_StatelessRandomNormal(absl::Span<const xla::int64> size,
                                               const XLATensor& seeds,
                                               const Device& device,
@@ -292,26 +843,256 @@ XLATensor XLATensor::xla_avg_pool_grad(
       data_format, counts_include_padding));
 }
 
+XLATensor XLATensor::xla_embedding_bag(
+    const XLATensor& table, const XLATensor& indices,
+    const absl::optional<XLATensor>& per_sample_weights,
+    EmbeddingBagMode mode) {
+  absl::optional<ir::Value> weights_value;
+  if (per_sample_weights) {
+    weights_value = per_sample_weights->GetIrValue();
+  }
+  return table.CreateFrom(ir::MakeNode<ir::ops::EmbeddingBag>(
+      table.GetIrValue(), indices.GetIrValue(), weights_value, mode));
+}
+
+XLATensor XLATensor::xla_embedding_bag_backward(
+    const XLATensor& grad_output, const XLATensor& table,
+    const XLATensor& indices, const XLATensor& output,
+    const absl::optional<XLATensor>& per_sample_weights,
+    EmbeddingBagMode mode) {
+  absl::optional<ir::Value> weights_value;
+  if (per_sample_weights) {
+    weights_value = per_sample_weights->GetIrValue();
+  }
+  return table.CreateFrom(ir::MakeNode<ir::ops::EmbeddingBagBackward>(
+      grad_output.GetIrValue(), table.GetIrValue(), indices.GetIrValue(),
+      output.GetIrValue(), weights_value, mode));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor> XLATensor::xla_fused_batch_norm(
+    const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+    const absl::optional<XLATensor>& residual,
+    const FusedBatchNormOptions& options) {
+  absl::optional<ir::Value> residual_value;
+  if (residual) {
+    residual_value = residual->GetIrValue();
+  }
+  FusedBatchNormOptions canonical_options = options;
+  canonical_options.feature_index = XlaHelpers::GetCanonicalDimensionIndex(
+      options.feature_index, input.shape().get().rank());
+  ir::NodePtr node = ir::MakeNode<ir::ops::FusedBatchNorm>(
+      input.GetIrValue(), weight.GetIrValue(), bias.GetIrValue(),
+      residual_value, canonical_options);
+  // The statistics are kept in the accumulation type, which is wider than the
+  // input type for reduced precision inputs.
+  ir::Value mean(node, 1);
+  at::ScalarType stats_type =
+      TensorTypeFromXlaType(mean.shape().element_type());
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         input.CreateFrom(mean, stats_type),
+                         input.CreateFrom(ir::Value(node, 2), stats_type));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor, XLATensor>
+XLATensor::xla_fused_batch_norm_backward(
+    const XLATensor& grad_output, const XLATensor& input,
+    const XLATensor& weight, const XLATensor& mean, const XLATensor& variance,
+    const XLATensor& output, const FusedBatchNormOptions& options) {
+  FusedBatchNormOptions canonical_options = options;
+  canonical_options.feature_index = XlaHelpers::GetCanonicalDimensionIndex(
+      options.feature_index, input.shape().get().rank());
+  ir::NodePtr node = ir::MakeNode<ir::ops::FusedBatchNormBackward>(
+      grad_output.GetIrValue(), input.GetIrValue(), weight.GetIrValue(),
+      mean.GetIrValue(), variance.GetIrValue(), output.GetIrValue(),
+      canonical_options);
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         weight.CreateFrom(ir::Value(node, 1)),
+                         weight.CreateFrom(ir::Value(node, 2)),
+                         grad_output.CreateFrom(ir::Value(node, 3)));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor> XLATensor::xla_layer_norm(
+    const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+    xla::int64 axis, double eps) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::LayerNorm>(
+      input.GetIrValue(), weight.GetIrValue(), bias.GetIrValue(),
+      XlaHelpers::GetCanonicalDimensionIndex(axis, input.shape().get().rank()),
+      eps);
+  ir::Value mean(node, 1);
+  at::ScalarType stats_type =
+      TensorTypeFromXlaType(mean.shape().element_type());
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         input.CreateFrom(mean, stats_type),
+                         input.CreateFrom(ir::Value(node, 2), stats_type));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor> XLATensor::xla_layer_norm_backward(
+    const XLATensor& grad_output, const XLATensor& input,
+    const XLATensor& weight, const XLATensor& mean, const XLATensor& variance,
+    xla::int64 axis, double eps) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::LayerNormBackward>(
+      grad_output.GetIrValue(), input.GetIrValue(), weight.GetIrValue(),
+      mean.GetIrValue(), variance.GetIrValue(),
+      XlaHelpers::GetCanonicalDimensionIndex(axis, input.shape().get().rank()),
+      eps);
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         weight.CreateFrom(ir::Value(node, 1)),
+                         weight.CreateFrom(ir::Value(node, 2)));
+}
+
+std::tuple<XLATensor, XLATensor> XLATensor::xla_rms_norm(
+    const XLATensor& input, const XLATensor& weight, xla::int64 axis,
+    double eps) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::RmsNorm>(
+      input.GetIrValue(), weight.GetIrValue(),
+      XlaHelpers::GetCanonicalDimensionIndex(axis, input.shape().get().rank()),
+      eps);
+  ir::Value inv_rms(node, 1);
+  return std::make_tuple(
+      input.CreateFrom(ir::Value(node, 0)),
+      input.CreateFrom(inv_rms,
+                       TensorTypeFromXlaType(inv_rms.shape().element_type())));
+}
+
+std::tuple<XLATensor, XLATensor> XLATensor::xla_rms_norm_backward(
+    const XLATensor& grad_output, const XLATensor& input,
+    const XLATensor& weight, const XLATensor& inv_rms, xla::int64 axis) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::RmsNormBackward>(
+      grad_output.GetIrValue(), input.GetIrValue(), weight.GetIrValue(),
+      inv_rms.GetIrValue(),
+      XlaHelpers::GetCanonicalDimensionIndex(axis, input.shape().get().rank()));
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         weight.CreateFrom(ir::Value(node, 1)));
+}
+
 XLATensor XLATensor::xla_max_pool(const XLATensor& input,
                                   absl::Span<const xla::int64> kernel_size,
                                   absl::Span<const xla::int64> stride,
                                   xla::Padding padding,
                                   const xla::TensorFormat& data_format) {
-  return input.CreateFrom(ir::MakeNode<ir::ops::XlaMaxPool>(
+  bool with_indices =
+      MaxPoolGradFromIndices() && IsTilingMaxPool(kernel_size, stride);
+  return input.CreateFrom(ir::Value(ir::MakeNode<ir::ops::XlaMaxPool>(
       input.GetIrValue(), XlaHelpers::I64List(kernel_size),
-      XlaHelpers::I64List(stride), padding, data_format));
+      XlaHelpers::I64List(stride), padding, data_format, with_indices)));
 }
 
 XLATensor XLATensor::xla_max_pool_grad(const XLATensor& input,
+                                       const XLATensor& output,
                                        const XLATensor& out_backprop,
                                        absl::Span<const xla::int64> kernel_size,
                                        absl::Span<const xla::int64> stride,
                                        xla::Padding padding) {
+  absl::optional<ir::Value> indices = GetMaxPoolIndices(input, output);
+  if (indices) {
+    return out_backprop.CreateFrom(ir::MakeNode<ir::ops::XlaMaxPoolGrad>(
+        input.GetIrValue(), out_backprop.GetIrValue(), *indices,
+        XlaHelpers::I64List(kernel_size), XlaHelpers::I64List(stride),
+        padding));
+  }
   return out_backprop.CreateFrom(ir::MakeNode<ir::ops::XlaMaxPoolGrad>(
       input.GetIrValue(), out_backprop.GetIrValue(),
       XlaHelpers::I64List(kernel_size), XlaHelpers::I64List(stride), padding));
 }
 
+std::pair<XLATensor, XLATensor> XLATensor::xla_nms(
+    const XLATensor& boxes, const XLATensor& scores, double score_threshold,
+    double iou_threshold, xla::int64 output_size, xla::int64 tile_size) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::Nms>(
+      boxes.GetIrValue(), scores.GetIrValue(), score_threshold, iou_threshold,
+      output_size, tile_size);
+  return std::make_pair(
+      boxes.CreateFrom(ir::Value(node, 0), at::ScalarType::Int),
+      boxes.CreateFrom(ir::Value(node, 1), at::ScalarType::Int));
+}
+
+XLATensor XLATensor::xla_resize_bilinear(const XLATensor& input,
+                                         std::vector<xla::int64> output_size,
+                                         bool align_corners,
+                                         bool half_pixel_centers,
+                                         bool channels_last) {
+  return input.CreateFrom(ir::MakeNode<ir::ops::ResizeBilinear>(
+      input.GetIrValue(), std::move(output_size), align_corners,
+      half_pixel_centers, channels_last));
+}
+
+XLATensor XLATensor::xla_resize_bilinear_backward(
+    const XLATensor& grad_output, std::vector<xla::int64> input_size,
+    bool align_corners, bool half_pixel_centers, bool channels_last) {
+  return grad_output.CreateFrom(ir::MakeNode<ir::ops::ResizeBilinearBackward>(
+      grad_output.GetIrValue(), std::move(input_size), align_corners,
+      half_pixel_centers, channels_last));
+}
+
+XLATensor XLATensor::xla_rng_normal(absl::Span<const xla::int64> size,
+                                    const XLATensor& mean,
+                                    const XLATensor& stddev) {
+  const Device& device = mean.GetDevice();
+  xla::Shape shape = MakeArrayShapeFromDimensions(
+      size, /*dynamic_dimensions=*/{}, mean.shape().get().element_type(),
+      device.hw_type);
+  return mean.CreateFrom(ir::MakeNode<ir::ops::RngNormal>(
+      GetRngSeed(device), mean.GetIrValue(), stddev.GetIrValue(),
+      std::move(shape), GetNextRngStream(device)));
+}
+
+XLATensor XLATensor::xla_rng_uniform(absl::Span<const xla::int64> size,
+                                     const XLATensor& minval,
+                                     const XLATensor& maxval) {
+  const Device& device = minval.GetDevice();
+  xla::Shape shape = MakeArrayShapeFromDimensions(
+      size, /*dynamic_dimensions=*/{}, minval.shape().get().element_type(),
+      device.hw_type);
+  return minval.CreateFrom(ir::MakeNode<ir::ops::RngUniform>(
+      GetRngSeed(device), minval.GetIrValue(), maxval.GetIrValue(),
+      std::move(shape), GetNextRngStream(device)));
+}
+
+std::pair<XLATensor, XLATensor> XLATensor::xla_scaled_dot_product_attention(
+    const XLATensor& query, const XLATensor& key, const XLATensor& value,
+    double scale, bool causal, xla::int64 block_size,
+    const absl::optional<XLATensor>& valid_length) {
+  absl::optional<ir::Value> valid_length_value;
+  if (valid_length) {
+    valid_length_value = GetHyperparameter(*valid_length, query.GetDevice());
+  }
+  ir::NodePtr node = ir::MakeNode<ir::ops::ScaledDotProductAttention>(
+      query.GetIrValue(), key.GetIrValue(), value.GetIrValue(), scale, causal,
+      block_size, valid_length_value);
+  // The logsumexp is kept in the compute type, which is wider than the query
+  // type for reduced precision inputs.
+  ir::Value logsumexp(node, 1);
+  at::ScalarType logsumexp_type =
+      TensorTypeFromXlaType(logsumexp.shape().element_type());
+  return std::make_pair(query.CreateFrom(ir::Value(node, 0)),
+                        query.CreateFrom(logsumexp, logsumexp_type));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor>
+XLATensor::xla_scaled_dot_product_attention_backward(
+    const XLATensor& grad_output, const XLATensor& query, const XLATensor& key,
+    const XLATensor& value, const XLATensor& output,
+    const XLATensor& logsumexp, double scale, bool causal,
+    xla::int64 block_size) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::ScaledDotProductAttentionBackward>(
+      grad_output.GetIrValue(), query.GetIrValue(), key.GetIrValue(),
+      value.GetIrValue(), output.GetIrValue(), logsumexp.GetIrValue(), scale,
+      causal, block_size);
+  return std::make_tuple(query.CreateFrom(ir::Value(node, 0)),
+                         key.CreateFrom(ir::Value(node, 1)),
+                         value.CreateFrom(ir::Value(node, 2)));
+}
+
+std::pair<XLATensor, XLATensor> XLATensor::xla_softmax_cross_entropy(
+    const XLATensor& logits, const XLATensor& labels, int ignore_index,
+    double label_smoothing, xla::int64 chunk_size) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::SoftmaxCrossEntropy>(
+      logits.GetIrValue(), labels.GetIrValue(), ignore_index, label_smoothing,
+      chunk_size);
+  return std::make_pair(logits.CreateFrom(ir::Value(node, 0)),
+                        logits.CreateFrom(ir::Value(node, 1)));
+}
+
 XLATensor XLATensor::xla_replica_id(const Device& device) {
   return XLATensor::Create(ir::MakeNode<ir::ops::ReplicaId>(), device);
 }
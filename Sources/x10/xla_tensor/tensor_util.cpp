@@ -14,18 +14,31 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
 #include <functional>
+#include <limits>
 #include <list>
 #include <numeric>
-#include <thread>
 
+#include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/memory_accounting.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/convert_kernels.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/xla/literal_util.h"
@@ -230,6 +243,74 @@ void CopyData<tensorflow::bfloat16, at::BFloat16>(tensorflow::bfloat16* dest,
   CheckedMemcpy<tensorflow::bfloat16, at::BFloat16>(dest, source, n);
 }
 
+// The host copies in flight. Concurrent copies, like the ones the converters
+// scheduled by LocalDevice::TransferToServer() run for every tensor, share the
+// compute pool threads rather than each one splitting itself across them.
+std::atomic<xla::int64> g_active_copies(0);
+
+class ActiveCopyScope {
+ public:
+  ActiveCopyScope() { g_active_copies.fetch_add(1); }
+
+  ~ActiveCopyScope() { g_active_copies.fetch_sub(1); }
+};
+
+// Returns the number of threads a copy of num_bytes should be split across,
+// giving every thread at least min_thread_bytes. The copy gets its share of
+// the compute pool, which excludes the other copies in flight and the closures
+// already waiting for a worker.
+xla::int64 GetCopyParts(xla::int64 num_bytes, xla::int64 min_thread_bytes) {
+  xla::int64 busy = std::max<xla::int64>(g_active_copies.load(), 1) +
+                    xla::env::GetQueuedClosures();
+  xla::int64 max_parts = std::max<xla::int64>(
+      xla::env::GetThreadPoolSize() / busy, 1);
+  return std::min<xla::int64>(
+      max_parts, std::max<xla::int64>(num_bytes / min_thread_bytes, 1));
+}
+
+// The minimum number of bytes a thread is assigned by the contiguous and the
+// strided copies. The strided ones have a lower bound, as they move fewer bytes
+// per cycle.
+xla::int64 GetMinContiguousThreadBytes() {
+  static const xla::int64 min_thread_bytes = xla::sys_util::GetEnvInt(
+      "XLA_COPY_MIN_THREAD_BYTES", 4 * 1024 * 1024);
+  return min_thread_bytes;
+}
+
+xla::int64 GetMinStridedThreadBytes() {
+  return std::max<xla::int64>(GetMinContiguousThreadBytes() / 8, 1);
+}
+
+// Copies n contiguous elements with the vectorized conversion kernel of the
+// element types, splitting large copies across threads.
+template <typename SType, typename DType>
+void VectorizedCopy(DType* dest, const SType* source, xla::int64 n) {
+  auto convert_fn = [dest, source](xla::int64 start, xla::int64 count) {
+    xla::int64 converted = VectorConversion<DType, SType>::Convert(
+        dest + start, source + start, count);
+    StridedCopy(dest + start + converted, 1, source + start + converted, 1,
+                count - converted);
+  };
+  xla::int64 num_parts =
+      GetCopyParts(n * std::max(sizeof(SType), sizeof(DType)),
+                   GetMinContiguousThreadBytes());
+  if (num_parts == 1) {
+    convert_fn(0, n);
+    return;
+  }
+  xla::int64 part_size = (n + num_parts - 1) / num_parts;
+  xla::util::MultiWait mwait(num_parts);
+  for (xla::int64 i = 0; i < num_parts; ++i) {
+    auto copy_fn = [&, i]() {
+      xla::int64 start = i * part_size;
+      convert_fn(start, std::max<xla::int64>(
+                            std::min<xla::int64>(part_size, n - start), 0));
+    };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(copy_fn)));
+  }
+  mwait.Wait();
+}
+
 std::vector<xla::int64> GetIterationDimensions(const xla::Shape& shape) {
   // We want to favor the most minor dimension as core iteration dimension, as
   // this walks one of the two tensors buffers in a cache friendly fashion.
@@ -262,14 +343,13 @@ struct CopyPartition {
   std::vector<xla::int64> limit;
 };
 
+// Splits the copy of element_size bytes elements along its largest dimension,
+// other than the strided_copy_dimension one. If that is the tiled_dimension,
+// the parts are aligned to multiples of tile_size.
 std::vector<CopyPartition> CreateCopyPartitions(
-    absl::Span<const xla::int64> dimensions,
-    xla::int64 strided_copy_dimension) {
-  // The minimum number of elements copy that can be assigned to a thread.
-  static const xla::int64 kMinThreadElements = 100000;
-  // Use at most 50% of the available cores.
-  xla::int64 max_parts =
-      std::max<xla::int64>(std::thread::hardware_concurrency() / 2, 1);
+    absl::Span<const xla::int64> dimensions, size_t element_size,
+    xla::int64 strided_copy_dimension, xla::int64 tiled_dimension = -1,
+    xla::int64 tile_size = 1) {
   // Find the maximum dimension which is not the strided copy dimension.
   xla::int64 max_dim = -1;
   for (xla::int64 i = 0; i < dimensions.size(); ++i) {
@@ -280,11 +360,14 @@ std::vector<CopyPartition> CreateCopyPartitions(
   }
 
   xla::int64 num_elements = xla::util::Multiply<xla::int64>(dimensions);
-  xla::int64 max_dim_unit_elements = num_elements / dimensions[max_dim];
+  xla::int64 num_parts =
+      GetCopyParts(num_elements * element_size, GetMinStridedThreadBytes());
   xla::int64 max_dim_size = dimensions[max_dim];
-  xla::int64 part_size =
-      std::max<xla::int64>(std::max<xla::int64>(max_dim_size / max_parts, 1),
-                           kMinThreadElements / max_dim_unit_elements);
+  xla::int64 part_size = std::max<xla::int64>(
+      (max_dim_size + num_parts - 1) / num_parts, 1);
+  if (max_dim == tiled_dimension) {
+    part_size = (part_size + tile_size - 1) / tile_size * tile_size;
+  }
   std::vector<CopyPartition> parts;
   xla::int64 csize = 0;
   while (csize < max_dim_size) {
@@ -324,6 +407,78 @@ void SlicedCopy(absl::Span<const xla::int64> dimensions, const SType* src_data,
   }
 }
 
+// The side of the square tiles TiledCopy() transposes, small enough for both
+// the source and destination tiles to stay within the L1 cache.
+constexpr xla::int64 kCopyTileSize = 32;
+
+template <typename SType, typename DType>
+void TransposeTile(DType* dest, xla::int64 dest_stride, const SType* source,
+                   xla::int64 source_stride, xla::int64 rows,
+                   xla::int64 cols) {
+  if (std::is_same<SType, DType>::value && sizeof(SType) == 4 &&
+      TransposeTile32(reinterpret_cast<uint32_t*>(dest), dest_stride,
+                      reinterpret_cast<const uint32_t*>(source), source_stride,
+                      rows, cols)) {
+    return;
+  }
+  Caster<SType> caster;
+  for (xla::int64 c = 0; c < cols; ++c) {
+    for (xla::int64 r = 0; r < rows; ++r) {
+      dest[c * dest_stride + r] =
+          caster.template cast<DType>(source[r * source_stride + c]);
+    }
+  }
+}
+
+// Copies the partition of a tensor whose source and destination layouts have
+// different most minor dimensions. Walking either of them would make the
+// accesses to the other tensor strided, so the plane of the two minor
+// dimensions is transposed by square tiles, which keeps both sides of the
+// copy within the cache.
+template <typename SType, typename DType>
+void TiledCopy(absl::Span<const xla::int64> dimensions, const SType* src_data,
+               absl::Span<const xla::int64> src_strides, DType* dest_data,
+               absl::Span<const xla::int64> dest_strides,
+               xla::int64 src_minor, xla::int64 dest_minor,
+               const CopyPartition& part) {
+  std::vector<xla::int64> outer_dims;
+  for (xla::int64 dim = 0; dim < dimensions.size(); ++dim) {
+    if (dim != src_minor && dim != dest_minor) {
+      outer_dims.push_back(dim);
+    }
+  }
+  xla::int64 src_row_stride = src_strides[dest_minor];
+  xla::int64 dest_row_stride = dest_strides[src_minor];
+  xla::int64 num_rows = part.limit[dest_minor] - part.base[dest_minor];
+  xla::int64 num_cols = part.limit[src_minor] - part.base[src_minor];
+  std::vector<xla::int64> indices(part.base);
+  while (true) {
+    const SType* src_plane =
+        src_data + GetFlatTensorOffset(src_strides, indices);
+    DType* dest_plane = dest_data + GetFlatTensorOffset(dest_strides, indices);
+    for (xla::int64 r = 0; r < num_rows; r += kCopyTileSize) {
+      for (xla::int64 c = 0; c < num_cols; c += kCopyTileSize) {
+        TransposeTile(dest_plane + c * dest_row_stride + r, dest_row_stride,
+                      src_plane + r * src_row_stride + c, src_row_stride,
+                      std::min(kCopyTileSize, num_rows - r),
+                      std::min(kCopyTileSize, num_cols - c));
+      }
+    }
+    size_t n = 0;
+    for (; n < outer_dims.size(); ++n) {
+      xla::int64 dim = outer_dims[n];
+      indices[dim] += 1;
+      if (indices[dim] < part.limit[dim]) {
+        break;
+      }
+      indices[dim] = part.base[dim];
+    }
+    if (n == outer_dims.size()) {
+      break;
+    }
+  }
+}
+
 template <typename SType, typename DType>
 void CopyTensors(const void* src_buffer, const xla::Shape& src_shape,
                  void* dest_buffer, size_t dest_buffer_size,
@@ -336,25 +491,44 @@ void CopyTensors(const void* src_buffer, const xla::Shape& src_shape,
 
   const SType* src_data = reinterpret_cast<const SType*>(src_buffer);
   DType* dest_data = reinterpret_cast<DType*>(dest_buffer);
+  ActiveCopyScope active_copy;
   if (src_shape.layout().minor_to_major() ==
       dest_shape.layout().minor_to_major()) {
-    CopyData<DType, SType>(dest_data, src_data, total_elements,
-                           typename CopyType < NeedCast<SType>::value ||
-                               NeedCast<DType>::value > ::type());
+    if (VectorConversion<DType, SType>::value) {
+      VectorizedCopy<SType, DType>(dest_data, src_data, total_elements);
+    } else {
+      CopyData<DType, SType>(dest_data, src_data, total_elements,
+                             typename CopyType < NeedCast<SType>::value ||
+                                 NeedCast<DType>::value > ::type());
+    }
   } else if (total_elements > 0) {
     // We issue a multi-threaded copy by slicing the bigger dimension and
     // assigning its copy to different threads. This code is only valid for
     // ranks >= 2, but the layout check above covers the case.
     std::vector<xla::int64> src_strides = ComputeShapeStrides(src_shape);
     std::vector<xla::int64> dest_strides = ComputeShapeStrides(dest_shape);
+    xla::int64 src_minor = src_shape.layout().minor_to_major(0);
+    xla::int64 dest_minor = dest_shape.layout().minor_to_major(0);
     std::vector<xla::int64> iter_dims = GetIterationDimensions(dest_shape);
+    size_t element_size = std::max(sizeof(SType), sizeof(DType));
     std::vector<CopyPartition> parts =
-        CreateCopyPartitions(dest_shape.dimensions(), iter_dims.front());
+        src_minor != dest_minor
+            ? CreateCopyPartitions(dest_shape.dimensions(), element_size,
+                                   dest_minor, src_minor, kCopyTileSize)
+            : CreateCopyPartitions(dest_shape.dimensions(), element_size,
+                                   iter_dims.front());
     xla::util::MultiWait mwait(parts.size());
     for (size_t i = 0; i < parts.size(); ++i) {
       auto copy_fn = [&, i]() {
-        SlicedCopy<SType, DType>(dest_shape.dimensions(), src_data, src_strides,
-                                 dest_data, dest_strides, iter_dims, parts[i]);
+        if (src_minor != dest_minor) {
+          TiledCopy<SType, DType>(dest_shape.dimensions(), src_data,
+                                  src_strides, dest_data, dest_strides,
+                                  src_minor, dest_minor, parts[i]);
+        } else {
+          SlicedCopy<SType, DType>(dest_shape.dimensions(), src_data,
+                                   src_strides, dest_data, dest_strides,
+                                   iter_dims, parts[i]);
+        }
       };
       xla::env::ScheduleClosure(mwait.Completer(std::move(copy_fn)));
     }
@@ -485,7 +659,7 @@ void PopulateTensorBuffer(const at::Tensor& tensor,
 }
 
 template <typename SType, typename DType>
-at::Tensor XlaLiteralToTensor(const xla::Literal& literal,
+at::Tensor XlaLiteralToTensor(const xla::LiteralBase& literal,
                               at::ScalarType atype) {
   std::vector<int64_t> dimensions =
       xla::util::ToVector<int64_t>(literal.shape().dimensions());
@@ -502,7 +676,7 @@ at::Tensor XlaLiteralToTensor(const xla::Literal& literal,
 }
 
 template <typename SType>
-at::Tensor XlaLiteralToTensorHelper(const xla::Literal& literal,
+at::Tensor XlaLiteralToTensorHelper(const xla::LiteralBase& literal,
                                     at::ScalarType dest_element_type) {
   switch (dest_element_type) {
     case at::ScalarType::Bool:
@@ -531,8 +705,192 @@ at::Tensor XlaLiteralToTensorHelper(const xla::Literal& literal,
   }
 }
 
+template <typename T>
+at::Tensor AllocateTensor(std::vector<int64_t> dimensions) {
+  std::unique_ptr<T[]> data(new T[at::GetLenFromShape(dimensions)]);
+  return at::Tensor(std::move(data), std::move(dimensions));
+}
+
+// Returns whether tensors of the given scalar type store their elements as
+// the given XLA type does.
+bool IsSameElementType(xla::PrimitiveType xla_type, at::ScalarType type) {
+  switch (type) {
+    case at::ScalarType::Bool:
+      return xla_type == xla::PrimitiveType::PRED;
+    case at::ScalarType::Byte:
+      return xla_type == xla::PrimitiveType::U8;
+    case at::ScalarType::Char:
+      return xla_type == xla::PrimitiveType::S8;
+    case at::ScalarType::Short:
+      return xla_type == xla::PrimitiveType::S16;
+    case at::ScalarType::Int:
+      return xla_type == xla::PrimitiveType::S32;
+    case at::ScalarType::Long:
+      return xla_type == xla::PrimitiveType::S64;
+    case at::ScalarType::Float:
+      return xla_type == xla::PrimitiveType::F32;
+    case at::ScalarType::Double:
+      return xla_type == xla::PrimitiveType::F64;
+    case at::ScalarType::BFloat16:
+      return xla_type == xla::PrimitiveType::BF16;
+    case at::ScalarType::Half:
+      return xla_type == xla::PrimitiveType::F16;
+    default:
+      return false;
+  }
+}
+
+// Returns the tensor memory if it already matches the element type and layout
+// of the device shape byte by byte, or nullptr if it has to go through
+// PopulateTensorBuffer().
+const void* GetTransferableTensorData(const at::Tensor& tensor,
+                                      const xla::Shape& dest_shape,
+                                      const Device& device) {
+  xla::Shape src_shape = MakeSwiftTensorLayout(
+      XlaHelpers::I64List(tensor.shape()), /*dynamic_dimensions=*/{},
+      XlaTypeFromTensorType(tensor.scalar_type(), device));
+  if (!xla::ShapeUtil::Equal(src_shape, dest_shape) ||
+      tensor.buffer().raw_size() != xla::ShapeUtil::ByteSizeOf(dest_shape)) {
+    return nullptr;
+  }
+  return tensor.buffer().raw_data();
+}
+
+// Accounts the device data uploaded from the host as parameter memory.
+std::vector<xla::ComputationClient::DataPtr> AsParameters(
+    std::vector<xla::ComputationClient::DataPtr> handles) {
+  for (auto& handle : handles) {
+    handle->SetMemoryKind(xla::metrics::MemoryKind::kParameter);
+  }
+  return handles;
+}
+
+// A read only memory mapping of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) : path_(path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    XLA_CHECK_GE(fd, 0) << "Unable to open " << path << ": "
+                        << std::strerror(errno);
+    struct stat st;
+    int stat_result = fstat(fd, &st);
+    int stat_errno = errno;
+    if (stat_result == 0 && st.st_size > 0) {
+      size_ = st.st_size;
+      data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    int mmap_errno = errno;
+    close(fd);
+    XLA_CHECK_EQ(stat_result, 0)
+        << "Unable to stat " << path << ": " << std::strerror(stat_errno);
+    XLA_CHECK(data_ != MAP_FAILED)
+        << "Unable to map " << path << ": " << std::strerror(mmap_errno);
+  }
+
+  ~MappedFile() {
+    if (size_ > 0) {
+      munmap(data_, size_);
+    }
+  }
+
+  const std::string& path() const { return path_; }
+
+  const char* data() const { return static_cast<const char*>(data_); }
+
+  size_t size() const { return size_; }
+
+  // Starts reading the range from the disk in the background.
+  void Prefetch(size_t offset, size_t length) const {
+    Advise(offset, length, MADV_WILLNEED);
+  }
+
+  // Drops the pages of the range from the process, once they are uploaded.
+  void Release(size_t offset, size_t length) const {
+    Advise(offset, length, MADV_DONTNEED);
+  }
+
+ private:
+  void Advise(size_t offset, size_t length, int advice) const {
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t begin = offset - offset % page_size;
+    size_t end = std::min(offset + length, size_);
+    if (begin < end) {
+      // The advice is a hint, the upload is correct whether it works or not.
+      madvise(static_cast<char*>(data_) + begin, end - begin, advice);
+    }
+  }
+
+  std::string path_;
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+size_t GetMaxInflightCheckpointBytes() {
+  static const size_t max_bytes = xla::sys_util::GetEnvInt(
+      "XLA_CHECKPOINT_INFLIGHT_BYTES", 1024 * 1024 * 1024);
+  return max_bytes;
+}
+
+size_t GetFileTensorBytes(const FileTensorSpec& spec) {
+  return at::internal::GetSizeof(spec.type) *
+         xla::util::Multiply<size_t>(spec.dims);
+}
+
+// Creates a tensor borrowing the mapped file memory.
+at::Tensor MakeMappedTensor(const MappedFile& file,
+                            const FileTensorSpec& spec) {
+  size_t num_bytes = GetFileTensorBytes(spec);
+  XLA_CHECK_LE(spec.offset + num_bytes, file.size())
+      << "Tensor at offset " << spec.offset << " with " << num_bytes
+      << " bytes exceeds the size of " << file.path();
+  const char* data = file.data() + spec.offset;
+  size_t num_elements = xla::util::Multiply<size_t>(spec.dims);
+  switch (spec.type) {
+#define DEFINE_MAPPED_CASE(name, aten_name, DType)                             \
+  case at::ScalarType::aten_name: {                                            \
+    XLA_CHECK_EQ(reinterpret_cast<uintptr_t>(data) % alignof(DType), 0)        \
+        << "Misaligned tensor at offset " << spec.offset << " of "             \
+        << file.path();                                                        \
+    return at::Tensor(std::make_unique<at::NonOwnedAnyScalarBuffer<DType>>(    \
+                          reinterpret_cast<const DType*>(data), num_elements), \
+                      spec.dims);                                              \
+  }
+    LIST_SCALAR_TYPES(DEFINE_MAPPED_CASE)
+#undef DEFINE_MAPPED_CASE
+  }
+  XLA_ERROR() << "Invalid scalar type";
+}
+
 }  // namespace
 
+at::Tensor AllocateTensor(at::ScalarType type,
+                          std::vector<int64_t> dimensions) {
+  switch (type) {
+    case at::ScalarType::Bool:
+      return AllocateTensor<bool>(std::move(dimensions));
+    case at::ScalarType::Byte:
+      return AllocateTensor<uint8_t>(std::move(dimensions));
+    case at::ScalarType::Char:
+      return AllocateTensor<int8_t>(std::move(dimensions));
+    case at::ScalarType::Short:
+      return AllocateTensor<int16_t>(std::move(dimensions));
+    case at::ScalarType::Int:
+      return AllocateTensor<int32_t>(std::move(dimensions));
+    case at::ScalarType::Long:
+      return AllocateTensor<int64_t>(std::move(dimensions));
+    case at::ScalarType::Float:
+      return AllocateTensor<float>(std::move(dimensions));
+    case at::ScalarType::Double:
+      return AllocateTensor<double>(std::move(dimensions));
+    case at::ScalarType::BFloat16:
+      return AllocateTensor<at::BFloat16>(std::move(dimensions));
+    case at::ScalarType::Half:
+      return AllocateTensor<at::Half>(std::move(dimensions));
+    default:
+      XLA_ERROR() << "Unsupported scalar type: " << type;
+  }
+}
+
 std::vector<xla::int64> ComputeShapeStrides(const xla::Shape& shape) {
   std::vector<xla::int64> strides(shape.rank());
   xla::int64 stride = 1;
@@ -552,7 +910,7 @@ std::vector<xla::int64> ComputeArrayStrides(
   return strides;
 }
 
-at::Tensor MakeTensorFromXlaLiteral(const xla::Literal& literal,
+at::Tensor MakeTensorFromXlaLiteral(const xla::LiteralBase& literal,
                                     at::ScalarType dest_element_type) {
   switch (literal.shape().element_type()) {
     case xla::PrimitiveType::PRED:
@@ -599,8 +957,10 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
 
   std::vector<xla::ComputationClient::TensorSource> source_tensors;
   source_tensors.emplace_back(shape, std::move(populate_fn));
+  source_tensors.back().data = GetTransferableTensorData(tensor, shape, device);
 
-  auto handles = xla::GetX10Device(device)->TransferToServer(source_tensors);
+  auto handles = AsParameters(
+      xla::GetX10Device(device)->TransferToServer(source_tensors));
   XLA_CHECK_EQ(handles.size(), 1);
   return std::move(handles.front());
 }
@@ -611,6 +971,244 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
       tensor, CreateComputationShapeFromTensor(tensor, &device), device);
 }
 
+xla::ComputationClient::TensorSource TensorToTensorSource(
+    const at::Tensor& tensor, const Device& device) {
+  xla::Shape shape = CreateComputationShapeFromTensor(tensor, &device);
+  // The populate function owns a reference to the tensor data, which keeps it
+  // alive until the transfer is done.
+  auto populate_fn = [tensor, device](
+                         const xla::ComputationClient::TensorSource& source,
+                         void* dest_buffer, size_t dest_buffer_size) {
+    PopulateTensorBuffer(tensor, source.shape, dest_buffer, dest_buffer_size,
+                         device);
+  };
+  xla::ComputationClient::TensorSource source(shape, std::move(populate_fn));
+  source.data = GetTransferableTensorData(tensor, shape, device);
+  return source;
+}
+
+xla::ComputationClient::DataPtr TensorToXlaDataAsync(const at::Tensor& tensor,
+                                                     const Device& device) {
+  std::vector<xla::ComputationClient::TensorSource> source_tensors;
+  source_tensors.push_back(TensorToTensorSource(tensor, device));
+
+  auto handles = AsParameters(
+      x10_device->TransferToServerAsync(std::move(source_tensors)));
+  XLA_CHECK_EQ(handles.size(), 1);
+  return std::move(handles.front());
+}
+
+xla::ComputationClient::DataPtr TensorToXlaDataDeferred(
+    const at::Tensor& tensor, const Device& device) {
+  xla::ComputationClient::DataPtr handle =
+      xla::GetX10Device(device)->TransferToServerDeferred(
+          TensorToTensorSource(tensor, device));
+  handle->SetMemoryKind(xla::metrics::MemoryKind::kParameter);
+  return handle;
+}
+
+xla::ComputationClient::DataPtr XlaDataToDeviceAsync(
+    xla::ComputationClient::DataPtr xla_data, at::ScalarType element_type,
+    std::function<void()> wait_fn, const Device& device) {
+  xla::Shape shape = MakeArrayShapeFromDimensions(
+      xla_data->shape().dimensions(), /*dynamic_dimensions=*/{},
+      MakeXlaPrimitiveType(element_type, &device), device.hw_type);
+  xla::ComputationClient::Device* x10_device = xla::GetX10Device(device);
+  if (xla::ShapeUtil::Compatible(shape, xla_data->shape()) &&
+      x10_device->CanTransferFromDevice(*xla_data->device())) {
+    return AsParameters({x10_device->TransferFromDeviceAsync(
+                            std::move(xla_data), std::move(wait_fn))})
+        .front();
+  }
+  auto populate_fn = [xla_data, element_type, wait_fn = std::move(wait_fn),
+                      device](
+                         const xla::ComputationClient::TensorSource& source,
+                         void* dest_buffer, size_t dest_buffer_size) {
+    wait_fn();
+    at::Tensor tensor = XlaDataToTensors({xla_data}, element_type).front();
+    PopulateTensorBuffer(tensor, source.shape, dest_buffer, dest_buffer_size,
+                         device);
+  };
+  std::vector<xla::ComputationClient::TensorSource> source_tensors;
+  source_tensors.emplace_back(std::move(shape), std::move(populate_fn));
+  auto handles = AsParameters(xla::GetX10Device(device)->TransferToServerAsync(
+      std::move(source_tensors)));
+  XLA_CHECK_EQ(handles.size(), 1);
+  XLA_COUNTER("AsyncDeviceCopies", 1);
+  return std::move(handles.front());
+}
+
+std::pair<at::Tensor, at::Tensor> QuantizeTensorPerChannel(
+    const at::Tensor& tensor, xla::int64 channel_dim) {
+  XLA_CHECK(tensor.scalar_type() == at::ScalarType::Float)
+      << "Only float tensors can be quantized";
+  const std::vector<int64_t>& dims = tensor.shape();
+  XLA_CHECK(channel_dim >= 0 && channel_dim < dims.size())
+      << "Invalid channel dimension " << channel_dim << " for rank "
+      << dims.size();
+  // View the tensor as [outer, channels, inner], with the channel in the
+  // middle, so that a single pass handles any channel dimension.
+  int64_t channels = dims[channel_dim];
+  int64_t inner = std::accumulate(dims.begin() + channel_dim + 1, dims.end(),
+                                  int64_t(1), std::multiplies<int64_t>());
+  int64_t outer = std::accumulate(dims.begin(), dims.begin() + channel_dim,
+                                  int64_t(1), std::multiplies<int64_t>());
+  absl::Span<const float> values = tensor.data<float>();
+  std::unique_ptr<float[]> scales(new float[channels]());
+  for (int64_t o = 0; o < outer; ++o) {
+    for (int64_t c = 0; c < channels; ++c) {
+      const float* row = values.data() + (o * channels + c) * inner;
+      for (int64_t i = 0; i < inner; ++i) {
+        scales[c] = std::max(scales[c], std::abs(row[i]));
+      }
+    }
+  }
+  for (int64_t c = 0; c < channels; ++c) {
+    // All zero channels get a unit scale, which quantizes them exactly.
+    scales[c] = scales[c] > 0 ? scales[c] / 127.0f : 1.0f;
+  }
+  std::unique_ptr<int8_t[]> quantized(new int8_t[values.size()]);
+  for (int64_t o = 0; o < outer; ++o) {
+    for (int64_t c = 0; c < channels; ++c) {
+      size_t offset = (o * channels + c) * inner;
+      float inv_scale = 1.0f / scales[c];
+      for (int64_t i = 0; i < inner; ++i) {
+        float value = std::round(values[offset + i] * inv_scale);
+        quantized[offset + i] =
+            static_cast<int8_t>(std::min(std::max(value, -127.0f), 127.0f));
+      }
+    }
+  }
+  return std::make_pair(at::Tensor(std::move(quantized), dims),
+                        at::Tensor(std::move(scales), {channels}));
+}
+
+std::pair<xla::ComputationClient::DataPtr, xla::ComputationClient::DataPtr>
+QuantizedTensorToXlaData(const at::Tensor& tensor, xla::int64 channel_dim,
+                         const Device& device) {
+  XLA_COUNTER("QuantizedUploads", 1);
+  std::pair<at::Tensor, at::Tensor> quantized =
+      QuantizeTensorPerChannel(tensor, channel_dim);
+  std::vector<xla::ComputationClient::TensorSource> source_tensors;
+  source_tensors.push_back(TensorToTensorSource(quantized.first, device));
+  source_tensors.push_back(TensorToTensorSource(quantized.second, device));
+  auto handles = AsParameters(
+      xla::GetX10Device(device)->TransferToServer(source_tensors));
+  XLA_CHECK_EQ(handles.size(), 2);
+  return std::make_pair(std::move(handles[0]), std::move(handles[1]));
+}
+
+std::vector<xla::ComputationClient::DataPtr> FileToXlaData(
+    const std::string& path, absl::Span<const FileTensorSpec> specs,
+    const Device& device) {
+  XLA_TIMED("FileToXlaData");
+  MappedFile file(path);
+  // Split the tensors in batches of up to max_bytes, uploaded one after the
+  // other. The tensors of a batch are copied in parallel by TransferToServer()
+  // and the disk reads of the next batch overlap with the current upload.
+  size_t max_bytes = GetMaxInflightCheckpointBytes();
+  std::vector<std::pair<size_t, size_t>> batches;
+  for (size_t start = 0; start < specs.size();) {
+    size_t end = start;
+    size_t batch_bytes = 0;
+    do {
+      batch_bytes += GetFileTensorBytes(specs[end]);
+      ++end;
+    } while (end < specs.size() &&
+             batch_bytes + GetFileTensorBytes(specs[end]) <= max_bytes);
+    batches.emplace_back(start, end);
+    start = end;
+  }
+  auto advise_batch = [&](size_t batch, bool prefetch) {
+    for (size_t i = batches[batch].first; i < batches[batch].second; ++i) {
+      size_t num_bytes = GetFileTensorBytes(specs[i]);
+      if (prefetch) {
+        file.Prefetch(specs[i].offset, num_bytes);
+      } else {
+        file.Release(specs[i].offset, num_bytes);
+      }
+    }
+  };
+  std::vector<xla::ComputationClient::DataPtr> handles;
+  handles.reserve(specs.size());
+  for (size_t batch = 0; batch < batches.size(); ++batch) {
+    if (batch == 0) {
+      advise_batch(batch, /*prefetch=*/true);
+    }
+    if (batch + 1 < batches.size()) {
+      advise_batch(batch + 1, /*prefetch=*/true);
+    }
+    std::vector<xla::ComputationClient::TensorSource> source_tensors;
+    for (size_t i = batches[batch].first; i < batches[batch].second; ++i) {
+      source_tensors.push_back(
+          TensorToTensorSource(MakeMappedTensor(file, specs[i]), device));
+    }
+    std::vector<xla::ComputationClient::DataPtr> batch_handles = AsParameters(
+        xla::GetX10Device(device)->TransferToServer(source_tensors));
+    XLA_CHECK_EQ(batch_handles.size(), source_tensors.size());
+    for (auto& handle : batch_handles) {
+      handles.push_back(std::move(handle));
+    }
+    advise_batch(batch, /*prefetch=*/false);
+    XLA_COUNTER("CheckpointBatches", 1);
+  }
+  return handles;
+}
+
+std::vector<size_t> GetFileTensorOffsets(
+    absl::Span<const xla::ComputationClient::DataPtr> xla_data) {
+  // Keep every tensor aligned for the vector loads of any element type.
+  constexpr size_t kAlignment = 64;
+  std::vector<size_t> offsets;
+  offsets.reserve(xla_data.size());
+  size_t offset = 0;
+  for (const auto& data : xla_data) {
+    offsets.push_back(offset);
+    offset += xla::ShapeUtil::ByteSizeOf(data->shape());
+    offset = (offset + kAlignment - 1) / kAlignment * kAlignment;
+  }
+  return offsets;
+}
+
+void XlaDataToFile(absl::Span<const xla::ComputationClient::DataPtr> xla_data,
+                   absl::Span<const size_t> offsets, const std::string& path) {
+  XLA_TIMED("XlaDataToFile");
+  XLA_CHECK_EQ(xla_data.size(), offsets.size());
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  XLA_CHECK_GE(fd, 0) << "Unable to create " << path << ": "
+                      << std::strerror(errno);
+  xla::util::StatusCleanup close_fd([fd](xla::Status) { close(fd); });
+  // The consumer can run concurrently on several tensors, so it only records
+  // the first error, which is reported once the transfers are over.
+  std::atomic<int> write_errno(0);
+  auto consumer_fn = [&](size_t index, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    off_t offset = offsets[index];
+    while (size > 0) {
+      ssize_t written = pwrite(fd, bytes, size, offset);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        int expected = 0;
+        write_errno.compare_exchange_strong(expected, errno);
+        return;
+      }
+      bytes += written;
+      offset += written;
+      size -= written;
+    }
+  };
+  xla::ComputationClient::TransferFromServerStreaming(
+      xla_data, GetMaxInflightCheckpointBytes(), /*destination_fn=*/nullptr,
+      consumer_fn);
+  XLA_CHECK_EQ(write_errno.load(), 0)
+      << "Unable to write " << path << ": "
+      << std::strerror(write_errno.load());
+  XLA_CHECK_EQ(fsync(fd), 0)
+      << "Unable to sync " << path << ": " << std::strerror(errno);
+}
+
 std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
     const std::vector<at::Tensor>& tensors, const std::string& device) {
   std::vector<xla::ComputationClient::TensorSource> source_tensors;
@@ -624,8 +1222,11 @@ std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
                                dest_buffer_size, device_id);
         };
     source_tensors.emplace_back(std::move(shape), std::move(populate_fn));
+    source_tensors.back().data = GetTransferableTensorData(
+        tensors[i], source_tensors.back().shape, device_id);
   }
-  return xla::GetX10Device(device)->TransferToServer(source_tensors);
+  return AsParameters(
+      xla::GetX10Device(device)->TransferToServer(source_tensors));
 }
 
 xla::Literal GetTensorLiteral(const at::Tensor& tensor, const xla::Shape* shape,
@@ -648,14 +1249,48 @@ xla::Literal GetTensorLiteral(const at::Tensor& tensor, const xla::Shape* shape,
 std::vector<at::Tensor> XlaDataToTensors(
     absl::Span<const xla::ComputationClient::DataPtr> xla_data,
     at::ScalarType dest_element_type) {
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::TransferFromServer(xla_data);
-  std::vector<at::Tensor> tensors;
-  tensors.reserve(literals.size());
-  for (auto& literal : literals) {
-    tensors.push_back(MakeTensorFromXlaLiteral(literal, dest_element_type));
+  std::vector<at::ScalarType> dest_element_types(xla_data.size(),
+                                                 dest_element_type);
+  return XlaDataToTensors(xla_data, dest_element_types);
+}
+
+std::vector<at::Tensor> XlaDataToTensors(
+    absl::Span<const xla::ComputationClient::DataPtr> xla_data,
+    absl::Span<const at::ScalarType> dest_element_types) {
+  XLA_CHECK_EQ(xla_data.size(), dest_element_types.size());
+  std::vector<absl::optional<at::Tensor>> tensors(xla_data.size());
+  auto destination_fn = [&](size_t index, const xla::Shape& shape) -> void* {
+    if (!IsSameElementType(shape.element_type(), dest_element_types[index])) {
+      return nullptr;
+    }
+    XLA_COUNTER("DirectTensorTransfers", 1);
+    tensors[index] = AllocateTensor(
+        dest_element_types[index],
+        xla::util::ToVector<int64_t>(shape.dimensions()));
+    return const_cast<void*>(tensors[index]->buffer().raw_data());
+  };
+  auto consumer_fn = [&](size_t index, const void* data, size_t size) {
+    if (tensors[index]) {
+      return;
+    }
+    const xla::Shape& shape = xla_data[index]->shape();
+    xla::BorrowingLiteral literal(
+        static_cast<const char*>(data),
+        xla::ShapeUtil::MakeShapeWithDescendingLayout(shape.element_type(),
+                                                      shape.dimensions()));
+    tensors[index] =
+        MakeTensorFromXlaLiteral(literal, dest_element_types[index]);
+  };
+  xla::ComputationClient::TransferFromServerStreaming(
+      xla_data, std::numeric_limits<size_t>::max(), destination_fn,
+      consumer_fn);
+
+  std::vector<at::Tensor> results;
+  results.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    results.push_back(std::move(*tensor));
   }
-  return tensors;
+  return results;
 }
 
 xla::hash_t TensorHash(const at::Tensor& tensor) {
@@ -687,6 +1322,29 @@ xla::hash_t TensorHash(const at::Tensor& tensor) {
   }
 }
 
+xla::hash_t TensorFingerprint(const at::Tensor& tensor,
+                              size_t max_hashed_bytes) {
+  static const size_t kNumSamples = 16;
+  const char* data = static_cast<const char*>(tensor.buffer().raw_data());
+  size_t size = tensor.buffer().raw_size();
+  xla::hash_t hash =
+      xla::util::HashCombine(xla::util::GetEnumValue(tensor.scalar_type()),
+                             xla::util::Hash(tensor.shape()));
+  if (size <= max_hashed_bytes) {
+    return xla::util::HashCombine(hash, xla::util::DataHash(data, size));
+  }
+  // The first sample is at the start of the data and the last one at its end,
+  // so that the head and tail, which often differ between batches, are seen.
+  size_t sample_size = std::max<size_t>(max_hashed_bytes / kNumSamples, 1);
+  size_t stride = (size - sample_size) / (kNumSamples - 1);
+  for (size_t i = 0; i < kNumSamples; ++i) {
+    size_t offset = i + 1 < kNumSamples ? i * stride : size - sample_size;
+    hash = xla::util::HashCombine(
+        hash, xla::util::DataHash(data + offset, sample_size));
+  }
+  return hash;
+}
+
 std::vector<xla::Shape> GetComponentShapes(const xla::Shape& shape) {
   std::vector<xla::Shape> component_shapes;
   if (shape.IsTuple()) {
@@ -714,6 +1372,32 @@ xla::Shape MakeShapeWithDeviceLayout(const xla::Shape& shape,
   return device_shape;
 }
 
+bool ShouldNarrowLongTensor(const at::Tensor& tensor, const Device& device) {
+  static const bool narrow_long_uploads =
+      xla::sys_util::GetEnvBool("XLA_NARROW_LONG_UPLOADS", false);
+  if (!narrow_long_uploads || tensor.scalar_type() != at::ScalarType::Long ||
+      MakeXlaPrimitiveType(at::ScalarType::Long, &device) ==
+          xla::PrimitiveType::S32) {
+    return false;
+  }
+  for (int64_t value : tensor.data<int64_t>()) {
+    if (value < std::numeric_limits<xla::int32>::min() ||
+        value > std::numeric_limits<xla::int32>::max()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IsNarrowedLongData(const xla::Shape& shape,
+                        at::ScalarType logical_element_type,
+                        const Device& device) {
+  return logical_element_type == at::ScalarType::Long &&
+         shape.element_type() == xla::PrimitiveType::S32 &&
+         MakeXlaPrimitiveType(at::ScalarType::Long, &device) !=
+             xla::PrimitiveType::S32;
+}
+
 xla::Shape CreateComputationShapeFromTensor(const at::Tensor& tensor,
                                             const Device* device) {
   Device xla_device = GetDeviceOrCurrent(device);
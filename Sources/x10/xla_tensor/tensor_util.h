@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/types/span.h"
@@ -34,13 +36,20 @@ std::vector<xla::int64> ComputeShapeStrides(const xla::Shape& shape);
 std::vector<xla::int64> ComputeArrayStrides(absl::Span<const xla::int64> sizes);
 
 // Converts an XLA literal to an at::Tensor of the given element type.
-at::Tensor MakeTensorFromXlaLiteral(const xla::Literal& literal,
+at::Tensor MakeTensorFromXlaLiteral(const xla::LiteralBase& literal,
                                     at::ScalarType dest_element_type);
 
 std::vector<at::Tensor> XlaDataToTensors(
     absl::Span<const xla::ComputationClient::DataPtr> xla_data,
     at::ScalarType dest_element_type);
 
+// Fetches the device data as tensors of the given element types. The data
+// whose device element type matches the tensor one is transferred straight
+// into the tensor buffer, without going through an xla::Literal.
+std::vector<at::Tensor> XlaDataToTensors(
+    absl::Span<const xla::ComputationClient::DataPtr> xla_data,
+    absl::Span<const at::ScalarType> dest_element_types);
+
 // Uploads an ATEN tensor data to the device and fetches the corresponding
 // device data handle.
 xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
@@ -50,12 +59,85 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
 xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
                                                 const Device& device);
 
+// Allocates an uninitialized tensor of the given element type.
+at::Tensor AllocateTensor(at::ScalarType type, std::vector<int64_t> dimensions);
+
+// Same as TensorToXlaData(), but the upload runs in the background. The
+// returned handle is a placeholder, which computations using it wait on.
+xla::ComputationClient::DataPtr TensorToXlaDataAsync(const at::Tensor& tensor,
+                                                     const Device& device);
+
+// Same as TensorToXlaData(), but the upload is batched with the other deferred
+// ones of the device, and sent before the first computation or transfer back
+// to the host which follows.
+xla::ComputationClient::DataPtr TensorToXlaDataDeferred(
+    const at::Tensor& tensor, const Device& device);
+
+// Copies the device data to another device in the background, once wait_fn
+// returns. Devices which can read each other memory, like GPUs with peer
+// access, copy directly. Otherwise the data is fetched as a tensor of the
+// given element type, and uploaded to device. The returned handle is a
+// placeholder, which computations using it wait on.
+xla::ComputationClient::DataPtr XlaDataToDeviceAsync(
+    xla::ComputationClient::DataPtr xla_data, at::ScalarType element_type,
+    std::function<void()> wait_fn, const Device& device);
+
+// Quantizes a float tensor to int8, with a symmetric scale for every index
+// along channel_dim, set to the largest magnitude of the channel divided by
+// 127. Returns the quantized tensor and the float scales, so that the i-th
+// channel is approximated by the quantized values times the i-th scale.
+std::pair<at::Tensor, at::Tensor> QuantizeTensorPerChannel(
+    const at::Tensor& tensor, xla::int64 channel_dim);
+
+// Same as TensorToXlaData(), but quantizes the float tensor per channel
+// first, and uploads both the int8 values and the scales, which take a quarter
+// of the memory and transfer bandwidth of the float tensor.
+std::pair<xla::ComputationClient::DataPtr, xla::ComputationClient::DataPtr>
+QuantizedTensorToXlaData(const at::Tensor& tensor, xla::int64 channel_dim,
+                         const Device& device);
+
+// A tensor stored in a file, as the raw bytes of its elements in row major
+// order, starting at offset.
+struct FileTensorSpec {
+  at::ScalarType type;
+  std::vector<int64_t> dims;
+  size_t offset = 0;
+};
+
+// Uploads the tensors stored in the file at path to the device. The file is
+// memory mapped, so the tensors are read straight from the page cache into the
+// transfer staging buffers. Tensors are uploaded in parallel, in batches of at
+// most XLA_CHECKPOINT_INFLIGHT_BYTES (1GB by default), while the next batch
+// gets read from the disk.
+std::vector<xla::ComputationClient::DataPtr> FileToXlaData(
+    const std::string& path, absl::Span<const FileTensorSpec> specs,
+    const Device& device);
+
+// Returns the offsets at which XlaDataToFile() writes the device data, which
+// are aligned to 64 bytes.
+std::vector<size_t> GetFileTensorOffsets(
+    absl::Span<const xla::ComputationClient::DataPtr> xla_data);
+
+// Writes the device data to the file at path, the i-th one starting at
+// offsets[i], as the raw bytes of its device element type in row major order.
+// The data is streamed to the host with at most XLA_CHECKPOINT_INFLIGHT_BYTES
+// of it in flight.
+void XlaDataToFile(absl::Span<const xla::ComputationClient::DataPtr> xla_data,
+                   absl::Span<const size_t> offsets, const std::string& path);
+
 // Wraps a concrete tensor into a computation client TensorSource.
 xla::ComputationClient::TensorSource TensorToTensorSource(
     const at::Tensor& tensor, const Device& device);
 
 xla::hash_t TensorHash(const at::Tensor& tensor);
 
+// Returns a cheap fingerprint of the tensor type, shape and contents. Tensors
+// holding up to max_hashed_bytes are hashed in full, larger ones by evenly
+// spaced samples adding up to max_hashed_bytes. Tensors with the same
+// fingerprint can still differ, so users must compare them on a match.
+xla::hash_t TensorFingerprint(const at::Tensor& tensor,
+                              size_t max_hashed_bytes);
+
 // Retrieves the device data handles by parallel uploading data onto the
 // corresponding devices.
 std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
@@ -81,6 +163,18 @@ xla::Shape MakeShapeWithDeviceLayout(const xla::Shape& shape,
 xla::Shape CreateComputationShapeFromTensor(const at::Tensor& tensor,
                                             const Device* device);
 
+// Whether the Long tensor gets uploaded as 32 bit integers, which halves its
+// transfer and device memory, and the memory traffic of the gathers it
+// indexes. This is the case with XLA_NARROW_LONG_UPLOADS when all its values
+// fit, and never with XLA_USE_32BIT_LONG, which narrows all the Long values.
+bool ShouldNarrowLongTensor(const at::Tensor& tensor, const Device& device);
+
+// Whether the data holding values of the logical_element_type has been
+// narrowed by ShouldNarrowLongTensor().
+bool IsNarrowedLongData(const xla::Shape& shape,
+                        at::ScalarType logical_element_type,
+                        const Device& device);
+
 at::ScalarType TensorTypeFromXlaType(xla::PrimitiveType xla_type);
 
 xla::PrimitiveType TensorTypeToRawXlaType(at::ScalarType scalar_type);
@@ -0,0 +1,278 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host to device transfer bandwidth benchmarks, over f32 tensors from 4 bytes
+// to X10_TRANSFER_BENCHMARK_MAX_BYTES (4GB by default):
+// - HostCopy: the staging copies into the transfer buffers, as a plain memcpy,
+//   in the device layout, converted to bf16, and into transposed and permuted
+//   layouts (the tiled and sliced paths of CopyTensors());
+// - TransferToServer: a single tensor, read directly or through the staging
+//   copy, a batch of 64 tensors, and the tensor split over 2 to 8 threads;
+// - TransferFromServer: a single tensor back to the host;
+// - copyTensor and copyTensorAndMakeResident, until the data is on device.
+// The bandwidths count the f32 bytes of the tensors. When
+// X10_TRANSFER_BENCHMARK_PEAK_GBPS is set to the PCIe or DMA bandwidth of the
+// machine, they are also reported as a percentage of it.
+//
+// Usage: x10_transfer_benchmark [substring of the benchmark names to run]
+// X10_BENCHMARK_MIN_SECONDS sets the minimum time spent in every benchmark.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "swift_bindings/device_wrapper.h"
+#include "swift_bindings/xla_tensor_wrapper.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+namespace {
+
+using DataPtr = xla::ComputationClient::DataPtr;
+using TensorSource = xla::ComputationClient::TensorSource;
+
+constexpr size_t kBatchSize = 64;
+
+double GetMinSeconds() {
+  static const double min_seconds =
+      xla::sys_util::GetEnvDouble("X10_BENCHMARK_MIN_SECONDS", 0.2);
+  return min_seconds;
+}
+
+double GetPeakGbps() {
+  static const double peak_gbps =
+      xla::sys_util::GetEnvDouble("X10_TRANSFER_BENCHMARK_PEAK_GBPS", 0.0);
+  return peak_gbps;
+}
+
+std::string FormatBytes(size_t bytes) {
+  static const char* const kUnits[] = {"B", "KB", "MB", "GB"};
+  size_t unit = 0;
+  while (unit + 1 < 4 && bytes >= 1024 && bytes % 1024 == 0) {
+    bytes /= 1024;
+    ++unit;
+  }
+  return std::to_string(bytes) + kUnits[unit];
+}
+
+// Runs fn, which moves bytes bytes, in batches of growing size until the
+// minimum time is spent, and prints the bandwidth.
+void RunBenchmark(const std::string& filter, const std::string& name,
+                  size_t bytes, const std::function<void()>& fn) {
+  if (name.find(filter) == std::string::npos) {
+    return;
+  }
+  using Clock = std::chrono::steady_clock;
+  fn();
+  size_t calls = 0;
+  size_t batch = 1;
+  double seconds = 0;
+  while (seconds < GetMinSeconds()) {
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < batch; ++i) {
+      fn();
+    }
+    seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    calls += batch;
+    batch *= 2;
+  }
+  double gbps = static_cast<double>(bytes) * calls / seconds * 1e-9;
+  std::printf("%-48s %10zu calls %12.1f us/call %10.3f GB/s", name.c_str(),
+              calls, seconds * 1e6 / calls, gbps);
+  if (GetPeakGbps() > 0) {
+    std::printf(" %6.1f%% of peak", 100.0 * gbps / GetPeakGbps());
+  }
+  std::printf("\n");
+}
+
+// Wraps the host buffer into a tensor of the given sizes, without copying it.
+at::Tensor MakeTensor(const float* data, std::vector<int64_t> sizes) {
+  size_t count = at::GetLenFromShape(sizes);
+  return at::Tensor(std::make_unique<at::NonOwnedAnyScalarBuffer<float>>(
+                        data, count * sizeof(float)),
+                    std::move(sizes));
+}
+
+// Returns a source of the tensor with the given element type and layout,
+// which PopulateTensorBuffer() converts the tensor to.
+TensorSource MakeLayoutSource(const at::Tensor& tensor, const Device& device,
+                              xla::PrimitiveType type,
+                              absl::Span<const xla::int64> minor_to_major) {
+  TensorSource source = TensorToTensorSource(tensor, device);
+  source.shape = xla::ShapeUtil::MakeShapeWithLayout(
+      type, XlaHelpers::I64List(tensor.shape()), minor_to_major);
+  source.data = nullptr;
+  return source;
+}
+
+// Times the staging copies of count floats into a host buffer.
+void BenchmarkHostCopies(const std::string& filter, const Device& device,
+                         const float* data, size_t count, void* staging) {
+  size_t bytes = count * sizeof(float);
+  std::string suffix = "/" + FormatBytes(bytes);
+  RunBenchmark(filter, "HostCopy/Memcpy" + suffix, bytes,
+               [&]() { std::memcpy(staging, data, bytes); });
+
+  at::Tensor tensor = MakeTensor(data, {static_cast<int64_t>(count)});
+  TensorSource source = TensorToTensorSource(tensor, device);
+  size_t staged_bytes = xla::ShapeUtil::ByteSizeOf(source.shape);
+  RunBenchmark(filter, "HostCopy/DeviceLayout" + suffix, bytes, [&]() {
+    source.populate_fn(source, staging, staged_bytes);
+  });
+  TensorSource bf16_source =
+      MakeLayoutSource(tensor, device, xla::PrimitiveType::BF16, {0});
+  RunBenchmark(filter, "HostCopy/ToBF16" + suffix, bytes, [&]() {
+    bf16_source.populate_fn(bf16_source, staging, count * 2);
+  });
+
+  // The layout changes need at least two dimensions of 16 elements.
+  if (count % 256 != 0) {
+    return;
+  }
+  int64_t rows = static_cast<int64_t>(count / 16);
+  at::Tensor matrix = MakeTensor(data, {rows, 16});
+  TensorSource transposed_source =
+      MakeLayoutSource(matrix, device, xla::PrimitiveType::F32, {0, 1});
+  RunBenchmark(filter, "HostCopy/Transposed" + suffix, bytes, [&]() {
+    transposed_source.populate_fn(transposed_source, staging, bytes);
+  });
+  at::Tensor cube = MakeTensor(data, {rows / 16, 16, 16});
+  TensorSource permuted_source =
+      MakeLayoutSource(cube, device, xla::PrimitiveType::F32, {2, 0, 1});
+  RunBenchmark(filter, "HostCopy/Permuted" + suffix, bytes, [&]() {
+    permuted_source.populate_fn(permuted_source, staging, bytes);
+  });
+}
+
+// Returns the sources of parts equal slices of count floats.
+std::vector<TensorSource> MakeSlicedSources(const float* data, size_t count,
+                                            size_t parts,
+                                            const Device& device) {
+  std::vector<TensorSource> sources;
+  size_t part_count = count / parts;
+  for (size_t i = 0; i < parts; ++i) {
+    sources.push_back(TensorToTensorSource(
+        MakeTensor(data + i * part_count,
+                   {static_cast<int64_t>(part_count)}),
+        device));
+  }
+  return sources;
+}
+
+void BenchmarkTransfers(const std::string& filter, const Device& device,
+                        const float* data, size_t count) {
+  size_t bytes = count * sizeof(float);
+  std::string suffix = "/" + FormatBytes(bytes);
+  xla::ComputationClient::Device* x10_device = xla::GetX10Device(device);
+  at::Tensor tensor = MakeTensor(data, {static_cast<int64_t>(count)});
+
+  std::vector<TensorSource> sources = {TensorToTensorSource(tensor, device)};
+  std::vector<DataPtr> handles;
+  RunBenchmark(filter, "TransferToServer/Single" + suffix, bytes,
+               [&]() { handles = x10_device->TransferToServer(sources); });
+  std::vector<TensorSource> staged_sources = sources;
+  staged_sources.front().data = nullptr;
+  RunBenchmark(filter, "TransferToServer/Staged" + suffix, bytes,
+               [&]() { x10_device->TransferToServer(staged_sources); });
+  if (count >= kBatchSize) {
+    std::vector<TensorSource> batch_sources =
+        MakeSlicedSources(data, count, kBatchSize, device);
+    RunBenchmark(filter, "TransferToServer/Batch64" + suffix, bytes,
+                 [&]() { x10_device->TransferToServer(batch_sources); });
+  }
+  for (size_t num_threads : {2, 4, 8}) {
+    if (count < num_threads) {
+      continue;
+    }
+    std::vector<TensorSource> thread_sources =
+        MakeSlicedSources(data, count, num_threads, device);
+    RunBenchmark(
+        filter,
+        "TransferToServer/Threads" + std::to_string(num_threads) + suffix,
+        bytes, [&]() {
+          std::vector<std::thread> threads;
+          for (const TensorSource& source : thread_sources) {
+            threads.emplace_back([&]() {
+              x10_device->TransferToServer(
+                  absl::Span<const TensorSource>(&source, 1));
+            });
+          }
+          for (std::thread& thread : threads) {
+            thread.join();
+          }
+        });
+  }
+  if (!handles.empty()) {
+    RunBenchmark(filter, "TransferFromServer" + suffix, bytes, [&]() {
+      xla::ComputationClient::TransferFromServer(handles);
+    });
+  }
+
+  CDevice cdevice = ConvertDevice(device);
+  size_t shape[] = {count};
+  RunBenchmark(filter, "copyTensor" + suffix, bytes, [&]() {
+    XLATensor* xla_tensor =
+        copyTensor(XLATensorScalarType_Float, data, count, shape, 1, cdevice);
+    x10_device->WaitForTransfers({xla_tensor->GetXlaData()});
+    destroyTensor(xla_tensor);
+  });
+  for (bool to_reduced_precision : {false, true}) {
+    std::string name = to_reduced_precision
+                           ? "copyTensorAndMakeResident/ToBF16"
+                           : "copyTensorAndMakeResident";
+    RunBenchmark(filter, name + suffix, bytes, [&]() {
+      XLATensor* xla_tensor = copyTensorAndMakeResident(
+          XLATensorScalarType_Float, data, count, shape, 1, cdevice,
+          to_reduced_precision);
+      x10_device->WaitForTransfers({xla_tensor->GetXlaData()});
+      destroyTensor(xla_tensor);
+    });
+  }
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+  size_t max_bytes = xla::sys_util::GetEnvInt(
+      "X10_TRANSFER_BENCHMARK_MAX_BYTES", 4LL << 30);
+  XLA_CHECK_GE(max_bytes, sizeof(float));
+  swift_xla::Device device = *swift_xla::GetDefaultDevice();
+  std::printf("Device %s, %zu compute pool threads\n",
+              device.ToString().c_str(), xla::env::GetThreadPoolSize());
+
+  std::vector<float> data(max_bytes / sizeof(float), 1.0f);
+  std::vector<char> staging(max_bytes);
+  for (size_t bytes = sizeof(float); bytes <= max_bytes; bytes *= 4) {
+    size_t count = bytes / sizeof(float);
+    swift_xla::BenchmarkHostCopies(filter, device, data.data(), count,
+                                   staging.data());
+    swift_xla::BenchmarkTransfers(filter, device, data.data(), count);
+  }
+  return 0;
+}
@@ -15,6 +15,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/xla_lower_util.h"
 
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
@@ -22,6 +23,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/random.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/client/lib/arithmetic.h"
@@ -86,6 +88,148 @@ bool ShouldUseDenseScatter(const Device& device, const xla::Shape& input_shape,
   return false;
 }
 
+// The cost of a sort pass over one element, on top of its comparisons, in
+// units of one comparison. It makes the two stage top-k only pay off for the
+// larger inputs.
+double SortPassCost(DeviceType hw_type) {
+  static const double tpu_cost =
+      xla::sys_util::GetEnvDouble("XLA_TPU_TOPK_SORT_PASS_COST", 16);
+  static const double cost =
+      xla::sys_util::GetEnvDouble("XLA_TOPK_SORT_PASS_COST", 4);
+  return hw_type == DeviceType::TPU || hw_type == DeviceType::REMOTE_TPU
+             ? tpu_cost
+             : cost;
+}
+
+double SortCost(xla::int64 rows, xla::int64 length, double pass_cost) {
+  return static_cast<double>(rows) * length *
+         (std::log2(static_cast<double>(length)) + pass_cost);
+}
+
+// The candidates every block keeps for the final sort. The approximate top-k
+// only keeps a share of k per block, twice as many candidates as needed
+// overall, and misses the results which crowd into a single block.
+xla::int64 TopKPerBlock(xla::int64 k, xla::int64 num_blocks,
+                        bool approximate) {
+  if (!approximate) {
+    return k;
+  }
+  return std::min(k, std::max<xla::int64>(
+                         1, xla::CeilOfRatio<xla::int64>(2 * k, num_blocks)));
+}
+
+// Returns the block size of the two stage top-k of k out of size elements, or
+// zero if a single sort is cheaper. Every block gets sorted on its own and
+// keeps its top candidates, and a second sort picks the top k out of those.
+xla::int64 TopKBlockSize(xla::int64 size, xla::int64 k, bool approximate) {
+  static const xla::int64 forced_block_size =
+      xla::sys_util::GetEnvInt("XLA_TOPK_BLOCK_SIZE", -1);
+  if (forced_block_size >= 0) {
+    return forced_block_size < size && 2 * k <= forced_block_size
+               ? forced_block_size
+               : 0;
+  }
+  double pass_cost = SortPassCost(GetCurrentDevice().hw_type);
+  double best_cost = SortCost(1, size, pass_cost);
+  xla::int64 best_block_size = 0;
+  for (xla::int64 block_size = 64; 2 * block_size <= size; block_size *= 2) {
+    xla::int64 num_blocks = xla::CeilOfRatio(size, block_size);
+    xla::int64 per_block = TopKPerBlock(k, num_blocks, approximate);
+    if (2 * per_block > block_size) {
+      continue;
+    }
+    double cost = SortCost(num_blocks, block_size, pass_cost) +
+                  SortCost(1, num_blocks * per_block, pass_cost);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_block_size = block_size;
+    }
+  }
+  return best_block_size;
+}
+
+// Sorts the values and their indices along the minor dimension, the ties in
+// index order, and keeps the first k of them.
+std::pair<xla::XlaOp, xla::XlaOp> SortPrefix(xla::XlaOp values,
+                                             xla::XlaOp indices, xla::int64 k,
+                                             bool largest) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(values);
+  xla::int64 dim = shape.rank() - 1;
+  auto value_order = [largest](xla::XlaOp lhs, xla::XlaOp rhs,
+                               absl::Span<const xla::int64> broadcast_dims) {
+    return largest ? xla::Gt(lhs, rhs, broadcast_dims)
+                   : xla::Lt(lhs, rhs, broadcast_dims);
+  };
+  auto index_order = [](xla::XlaOp lhs, xla::XlaOp rhs,
+                        absl::Span<const xla::int64> broadcast_dims) {
+    return xla::Lt(lhs, rhs, broadcast_dims);
+  };
+  xla::XlaComputation comparator = xla::CreateScalarComparisonComputation(
+      "TopKComparator", {shape.element_type(), xla::PrimitiveType::S32},
+      {value_order, index_order}, values.builder());
+  xla::XlaOp sort_result = xla::Sort({values, indices}, comparator, dim);
+  return {xla::SliceInDim(xla::GetTupleElement(sort_result, 0), 0, k, 1, dim),
+          xla::SliceInDim(xla::GetTupleElement(sort_result, 1), 0, k, 1, dim)};
+}
+
+// Two stage top-k along dim, see TopKBlockSize(). The other dimensions are
+// batch ones, so a batch of top-k shares the same two sorts.
+std::vector<xla::XlaOp> CreateBlockTopK(xla::XlaOp input, xla::int64 k,
+                                        xla::int64 dim, bool largest,
+                                        xla::int64 block_size,
+                                        bool approximate) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::int64 rank = shape.rank();
+  xla::int64 size = shape.dimensions(dim);
+  std::vector<xla::int64> permutation;
+  for (xla::int64 i = 0; i < rank; ++i) {
+    if (i != dim) {
+      permutation.push_back(i);
+    }
+  }
+  permutation.push_back(dim);
+  xla::XlaOp values = xla::Transpose(input, permutation);
+  std::vector<xla::int64> sizes = XlaHelpers::SizesOfXlaOp(values);
+  xla::XlaOp indices = xla::Iota(
+      input.builder(),
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, sizes), rank - 1);
+
+  // The padding sorts after all the elements, and after the ties with them,
+  // as its index is the largest.
+  xla::int64 num_blocks = xla::CeilOfRatio(size, block_size);
+  xla::int64 padding = num_blocks * block_size - size;
+  if (padding > 0) {
+    xla::XlaOp pad_value =
+        largest ? xla::MinValue(input.builder(), shape.element_type())
+                : xla::MaxValue(input.builder(), shape.element_type());
+    values = xla::PadInDim(values, pad_value, rank - 1, 0, padding);
+    indices = xla::PadInDim(
+        indices,
+        XlaHelpers::ScalarValue<xla::int64>(size, xla::PrimitiveType::S32,
+                                            input.builder()),
+        rank - 1, 0, padding);
+  }
+  std::vector<xla::int64> block_sizes(sizes.begin(), sizes.end() - 1);
+  block_sizes.push_back(num_blocks);
+  block_sizes.push_back(block_size);
+  xla::int64 per_block = TopKPerBlock(k, num_blocks, approximate);
+  std::tie(values, indices) =
+      SortPrefix(XlaHelpers::DynamicReshape(values, block_sizes),
+                 XlaHelpers::DynamicReshape(indices, block_sizes), per_block,
+                 largest);
+
+  std::vector<xla::int64> candidate_sizes(sizes.begin(), sizes.end() - 1);
+  candidate_sizes.push_back(num_blocks * per_block);
+  std::tie(values, indices) =
+      SortPrefix(XlaHelpers::DynamicReshape(values, candidate_sizes),
+                 XlaHelpers::DynamicReshape(indices, candidate_sizes), k,
+                 largest);
+  std::vector<xla::int64> inverse_permutation =
+      xla::InversePermutation(permutation);
+  return {xla::Transpose(values, inverse_permutation),
+          xla::Transpose(indices, inverse_permutation)};
+}
+
 xla::XlaOp DotExpand(xla::XlaOp op, const xla::Shape& op_shape,
                      const xla::Shape& to_shape) {
   xla::int64 rank_delta = to_shape.rank() - op_shape.rank();
@@ -206,6 +350,8 @@ bool ScatterRequiresPadding(const xla::Shape& input_shape,
   return requires_padding;
 }
 
+}  // namespace
+
 xla::XlaOp XlaDenseScatter(xla::XlaOp input, xla::XlaOp index, xla::XlaOp src,
                            xla::int64 dim, const ScatterOptions& options) {
   // Contribute back this code to xla::TorchScatterDense() once this has reached
@@ -275,6 +421,8 @@ xla::XlaOp XlaDenseScatter(xla::XlaOp input, xla::XlaOp index, xla::XlaOp src,
   });
 }
 
+namespace {
+
 std::vector<xla::XlaOp> BuildConditionIndices(xla::XlaOp condition) {
   ConditionMaskData cmd = CreateConditionMaskData(condition);
   std::vector<xla::XlaOp> to_sort = {cmd.r1_condition_int};
@@ -305,6 +453,36 @@ std::vector<xla::XlaOp> BuildConditionIndices(xla::XlaOp condition) {
 
 }  // namespace
 
+xla::XlaOp XlaSparseScatter(xla::XlaOp input, xla::XlaOp index,
+                            xla::XlaOp source, xla::int64 dim,
+                            const ScatterOptions& options) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::Shape index_shape = XlaHelpers::ShapeOfXlaOp(index);
+  xla::ShapeUtil::AppendMajorDimension(1, &index_shape);
+  std::vector<xla::XlaOp> to_concat;
+  to_concat.reserve(input_shape.rank());
+  for (xla::int64 i = 0; i < input_shape.rank(); ++i) {
+    if (i == dim) {
+      to_concat.push_back(
+          XlaHelpers::DynamicReshape(index, index_shape.dimensions()));
+    } else {
+      to_concat.push_back(xla::Iota(input.builder(), index_shape, i));
+    }
+  }
+  xla::XlaOp scatter_indices =
+      xla::ConcatInDim(input.builder(), to_concat, input_shape.rank());
+  xla::ScatterDimensionNumbers scatter_dnums;
+  scatter_dnums.set_index_vector_dim(input_shape.rank());
+  for (xla::int64 i = 0; i < input_shape.rank(); ++i) {
+    scatter_dnums.add_inserted_window_dims(i);
+    scatter_dnums.add_scatter_dims_to_operand_dims(i);
+  }
+  return xla::Scatter(
+      input, scatter_indices, source,
+      MakeScatterComputation(options.combiner, input_shape.element_type()),
+      scatter_dnums);
+}
+
 xla::XlaOp PadToSize(xla::XlaOp input, absl::Span<const xla::int64> size,
                      absl::optional<xla::XlaOp> pad_value) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
@@ -363,8 +541,20 @@ std::vector<xla::XlaOp> CreateTopK(xla::XlaOp input, xla::int64 k,
                                    xla::int64 dim, bool largest,
                                    bool /* sorted */) {
   // Here 'k' is 1 based (1...).
+  static const bool approximate =
+      xla::sys_util::GetEnvBool("XLA_APPROXIMATE_TOPK", false);
   const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
   XLA_CHECK_LE(k, shape.dimensions(dim));
+  xla::int64 block_size = TopKBlockSize(shape.dimensions(dim), k, approximate);
+  if (block_size > 0) {
+    std::vector<xla::XlaOp> results =
+        CreateBlockTopK(input, k, dim, largest, block_size, approximate);
+    // aten::topk() wants Long tensors as indices.
+    return {results[0], xla::ConvertElementType(
+                            results[1],
+                            GetDevicePrimitiveType(xla::PrimitiveType::S64,
+                                                   /*device=*/nullptr))};
+  }
   xla::Shape iota_shape =
       xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, shape.dimensions());
   xla::XlaOp iota = xla::Iota(input.builder(), iota_shape, dim);
@@ -644,33 +834,31 @@ xla::XlaOp CreateScatter(const Device& device, xla::XlaOp input,
     std::vector<xla::int64> base_indices(source_shape.rank(), 0);
     source_op = BuildSlice(source_op, base_indices, index_shape.dimensions());
   }
-  if (ShouldUseDenseScatter(device, input_shape, index_shape)) {
+  auto build_fn = [&](xla::XlaBuilder* builder, bool dense) {
+    xla::XlaOp bench_input =
+        xla::Broadcast(xla::Zero(builder, input_shape.element_type()),
+                       input_shape.dimensions());
+    xla::XlaOp bench_source =
+        xla::Broadcast(xla::Zero(builder, input_shape.element_type()),
+                       index_shape.dimensions());
+    xla::XlaOp bench_index = MakeBenchmarkIndices(
+        builder, index_shape, dim, input_shape.dimensions(dim));
+    // The init value belongs to the outer builder, so it cannot be reused.
+    ScatterOptions bench_options = options;
+    bench_options.init_value = absl::nullopt;
+    return dense ? XlaDenseScatter(bench_input, bench_index, bench_source,
+                                   dim, bench_options)
+                 : XlaSparseScatter(bench_input, bench_index, bench_source,
+                                    dim, bench_options);
+  };
+  if (UseDenseIndexedLowering("scatter", device, input_shape, index_shape,
+                              dim,
+                              ShouldUseDenseScatter(device, input_shape,
+                                                    index_shape),
+                              build_fn)) {
     return XlaDenseScatter(input, index, source_op, dim, options);
   }
-
-  xla::ShapeUtil::AppendMajorDimension(1, &index_shape);
-  std::vector<xla::XlaOp> to_concat;
-  to_concat.reserve(input_shape.rank());
-  for (xla::int64 i = 0; i < input_shape.rank(); ++i) {
-    if (i == dim) {
-      to_concat.push_back(
-          XlaHelpers::DynamicReshape(index, index_shape.dimensions()));
-    } else {
-      to_concat.push_back(xla::Iota(input.builder(), index_shape, i));
-    }
-  }
-  xla::XlaOp scatter_indices =
-      xla::ConcatInDim(input.builder(), to_concat, input_shape.rank());
-  xla::ScatterDimensionNumbers scatter_dnums;
-  scatter_dnums.set_index_vector_dim(input_shape.rank());
-  for (xla::int64 i = 0; i < input_shape.rank(); ++i) {
-    scatter_dnums.add_inserted_window_dims(i);
-    scatter_dnums.add_scatter_dims_to_operand_dims(i);
-  }
-  return xla::Scatter(
-      input, scatter_indices, source_op,
-      MakeScatterComputation(options.combiner, input_shape.element_type()),
-      scatter_dnums);
+  return XlaSparseScatter(input, index, source_op, dim, options);
 }
 
 xla::XlaOp CreatePut(const Device& device, xla::XlaOp input, xla::XlaOp index,
@@ -89,6 +89,15 @@ xla::XlaOp CreateScatter(const Device& device, xla::XlaOp input,
                          xla::XlaOp index, xla::XlaOp source, xla::int64 dim,
                          const ScatterOptions& options);
 
+// The dense and sparse lowerings CreateScatter() chooses from. The dense one
+// compares every index with the whole scattered dimension.
+xla::XlaOp XlaDenseScatter(xla::XlaOp input, xla::XlaOp index, xla::XlaOp src,
+                           xla::int64 dim, const ScatterOptions& options);
+
+xla::XlaOp XlaSparseScatter(xla::XlaOp input, xla::XlaOp index,
+                            xla::XlaOp source, xla::int64 dim,
+                            const ScatterOptions& options);
+
 xla::XlaOp CreatePut(const Device& device, xla::XlaOp input, xla::XlaOp index,
                      xla::XlaOp source, bool accumulate);
 
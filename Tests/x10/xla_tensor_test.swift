@@ -1,3 +1,4 @@
+import Foundation
 import TensorFlow
 import XCTest
 
@@ -98,6 +99,769 @@ final class MultiDeviceAPITests: XCTestCase {
     })[0] as! Tensor<Float>
     XCTAssertEqual(res.scalarized(), 63)
   }
+
+  func testMultiStep() {
+    let inputs = Tensor<Float>([1, 2, 3, 4], on: .defaultXLA)
+    let res = (_RawXLA.multiStep(steps: 4,
+               state: [Tensor<Float>(0.5, on: .defaultXLA)],
+               stackedInputs: [inputs]) { state, inputs in
+      let a = state[0] as! Tensor<Float>
+      let x = inputs[0] as! Tensor<Float>
+      return [a * 2 + x]
+    })[0] as! Tensor<Float>
+    XCTAssertEqual(res.scalarized(), 34)
+  }
+
+  func testPrefetch() {
+    let scalars: [Float] = [1, 2, 3, 4, 5, 6]
+    let prefetched = scalars.withUnsafeBufferPointer {
+      Tensor<Float>(shape: [3, 2], scalars: $0, prefetchingOn: .defaultXLA)
+    }
+    let expected = Tensor<Float>(shape: [3, 2], scalars: scalars, on: .defaultXLA)
+    XCTAssertEqual((prefetched + 1).scalars, (expected + 1).scalars)
+  }
+
+  func testRematerialization() {
+    let x = Tensor<Float>([[1, -2], [3, 4]], on: .defaultXLA)
+    func layer(_ x: Tensor<Float>) -> Tensor<Float> { relu(matmul(x, x)).exp() }
+    let expected = gradient(at: x) { x in layer(layer(x)).sum() }
+    let rematerialized = gradient(at: x) { x in
+      layer(withRematerialization(x, layer)).sum()
+    }
+    XCTAssertEqual(rematerialized.scalars, expected.scalars)
+  }
+
+  func testScaledDotProductAttention() {
+    let q = Tensor<Float>(randomNormal: [2, 4, 3], seed: (1, 2), on: .defaultXLA)
+    let k = Tensor<Float>(randomNormal: [2, 4, 3], seed: (3, 4), on: .defaultXLA)
+    let v = Tensor<Float>(randomNormal: [2, 4, 5], seed: (5, 6), on: .defaultXLA)
+    func attention(_ q: Tensor<Float>, _ k: Tensor<Float>, _ v: Tensor<Float>) -> Tensor<Float> {
+      matmul(softmax(matmul(q, k, transposed: true) * 0.5), v)
+    }
+    let (expected, expectedPullback) = valueWithPullback(at: q, k, v, in: attention)
+    let (fused, fusedPullback) = valueWithPullback(at: q, k, v) {
+      scaledDotProductAttention(query: $0, key: $1, value: $2, scale: 0.5, blockSize: 2)
+    }
+    XCTAssertTrue(fused.isAlmostEqual(to: expected, tolerance: 1e-5))
+    let seed = Tensor<Float>(ones: expected.shape, on: .defaultXLA)
+    let expectedGrads = expectedPullback(seed)
+    let fusedGrads = fusedPullback(seed)
+    XCTAssertTrue(fusedGrads.0.isAlmostEqual(to: expectedGrads.0, tolerance: 1e-5))
+    XCTAssertTrue(fusedGrads.1.isAlmostEqual(to: expectedGrads.1, tolerance: 1e-5))
+    XCTAssertTrue(fusedGrads.2.isAlmostEqual(to: expectedGrads.2, tolerance: 1e-5))
+  }
+
+  func testEmbeddingBag() {
+    let table = Tensor<Float>([[1, 2], [3, -4], [5, 6], [-7, 8]], on: .defaultXLA)
+    let indices = Tensor<Int32>([[0, 2, -1], [1, 1, 3]], on: .defaultXLA)
+    let weights = Tensor<Float>([[1, 2, 3], [0.5, 1, 2]], on: .defaultXLA)
+    let (sum, sumPullback) = valueWithPullback(at: table) {
+      embeddingBag($0, indices: indices, perSampleWeights: weights)
+    }
+    XCTAssertEqual(sum, Tensor([[11, 14], [-9.5, 10]], on: .defaultXLA))
+    XCTAssertEqual(
+      sumPullback(Tensor(ones: [2, 2], on: .defaultXLA)),
+      Tensor([[1, 1], [1.5, 1.5], [2, 2], [2, 2]], on: .defaultXLA))
+    let (maxima, maxPullback) = valueWithPullback(at: table) {
+      embeddingBag($0, indices: indices, mode: .max)
+    }
+    XCTAssertEqual(maxima, Tensor([[5, 6], [3, 8]], on: .defaultXLA))
+    XCTAssertEqual(
+      maxPullback(Tensor([[1, 2], [3, 4]], on: .defaultXLA)),
+      Tensor([[0, 0], [3, 0], [1, 2], [0, 4]], on: .defaultXLA))
+  }
+
+  func testBatchedScalars() {
+    let x = Tensor<Float>([1, 2, 3], on: .defaultXLA)
+    let tensors = [x * 2, x.sum(), Tensor<Float>([4, 5], on: .defaultTFEager), x + 1]
+    let scalars = tensors._xlaScalars()
+    XCTAssertEqual(scalars.count, tensors.count)
+    for (values, tensor) in zip(scalars, tensors) {
+      XCTAssertEqual(values, tensor.scalars)
+    }
+  }
+
+  func testScalarsAsync() {
+    let x = Tensor<Float>([1, 2, 3], on: .defaultXLA)
+    let pending = (x * x + 1)._xlaScalarsAsync()
+    XCTAssertEqual(pending.wait(), [2, 5, 10])
+    XCTAssertTrue(pending.isReady)
+    XCTAssertEqual(pending.wait(), [2, 5, 10])
+  }
+
+  func testRandomStreams() {
+    func sample() -> (Tensor<Float>, Tensor<Float>) {
+      _xlaSetRandomSeed(42, on: .defaultXLA)
+      let zero = Tensor<Float>(0, on: .defaultXLA)
+      let one = Tensor<Float>(1, on: .defaultXLA)
+      return (
+        _xlaRandomUniform([64], lowerBound: zero, upperBound: one),
+        _xlaRandomNormal([64], mean: zero, standardDeviation: one)
+      )
+    }
+    let (uniform, normal) = sample()
+    let (uniformAgain, normalAgain) = sample()
+    XCTAssertEqual(uniform.scalars, uniformAgain.scalars)
+    XCTAssertEqual(normal.scalars, normalAgain.scalars)
+    XCTAssertNotEqual(uniform.scalars, normal.scalars)
+    XCTAssert(uniform.scalars.allSatisfy { $0 >= 0 && $0 < 1 })
+  }
+
+  func testNonMaxSuppression() {
+    let boxes = Tensor<Float>(
+      [[0, 0, 1, 1], [0, 0.1, 1, 1.1], [0, 2, 1, 3], [0, 2.1, 1, 3.1], [0, 5, 1, 6]],
+      on: .defaultXLA)
+    let scores = Tensor<Float>([0.9, 0.8, 0.7, 0.6, 0.95], on: .defaultXLA)
+    let result = nonMaxSuppression(boxes: boxes, scores: scores, maxOutputSize: 4, tileSize: 2)
+    XCTAssertEqual(result.selectedIndices, Tensor([4, 0, 2, 0], on: .defaultXLA))
+    XCTAssertEqual(result.validCount, Tensor(3, on: .defaultXLA))
+    let batched = nonMaxSuppression(
+      boxes: Tensor(stacking: [boxes, boxes]), scores: Tensor(stacking: [scores, -scores]),
+      maxOutputSize: 2, iouThreshold: 0.5, scoreThreshold: -0.65, tileSize: 2)
+    XCTAssertEqual(batched.selectedIndices, Tensor([[4, 0], [3, 0]], on: .defaultXLA))
+    XCTAssertEqual(batched.validCount, Tensor([2, 1], on: .defaultXLA))
+  }
+
+  func testResizeBilinear() {
+    let images = Tensor<Float>(randomNormal: [2, 5, 7, 3], seed: (1, 2), on: .defaultTFEager)
+    let seed = Tensor<Float>(randomNormal: [2, 9, 4, 3], seed: (3, 4), on: .defaultTFEager)
+    func resizeAndPullback(_ images: Tensor<Float>, _ seed: Tensor<Float>) -> (
+      Tensor<Float>, Tensor<Float>
+    ) {
+      let (resized, pullback) = valueWithPullback(at: images) {
+        resize(images: $0, size: (newHeight: 9, newWidth: 4))
+      }
+      return (resized, pullback(seed))
+    }
+    let expected = resizeAndPullback(images, seed)
+    let actual = resizeAndPullback(
+      Tensor(copying: images, to: .defaultXLA), Tensor(copying: seed, to: .defaultXLA))
+    XCTAssertTrue(
+      Tensor(copying: actual.0, to: .defaultTFEager).isAlmostEqual(
+        to: expected.0, tolerance: 1e-5))
+    XCTAssertTrue(
+      Tensor(copying: actual.1, to: .defaultTFEager).isAlmostEqual(
+        to: expected.1, tolerance: 1e-5))
+  }
+
+  func testConvBiasActivation() {
+    let x = Tensor<Float>(randomNormal: [2, 6, 5, 3], seed: (1, 2), on: .defaultXLA)
+    let filter = Tensor<Float>(randomNormal: [3, 3, 3, 4], seed: (3, 4), on: .defaultXLA)
+    let bias = Tensor<Float>([0.5, -1, 0, 2], on: .defaultXLA)
+    let fused = _RawXLA.conv2DBiasActivation(
+      x, filter: filter, bias: bias, strides: [1, 2, 1, 1], padding: .same,
+      explicitPaddings: [], relu: true)
+    let expected = relu(conv2D(x, filter: filter, strides: (1, 2, 1, 1), padding: .same) + bias)
+    XCTAssertEqual(fused.shape, expected.shape)
+    XCTAssert(fused.isAlmostEqual(to: expected, tolerance: 1e-5))
+  }
+
+  func testQuantizedMatmul() {
+    let x = Tensor<Float>(randomNormal: [3, 8], seed: (1, 2), on: .defaultXLA)
+    let w = Tensor<Float>(randomNormal: [8, 5], seed: (3, 4))
+    let (weight, scale) = _RawXLA.quantizePerChannel(w, channelAxis: 1, on: .defaultXLA)
+    XCTAssertEqual(weight.shape, [8, 5])
+    XCTAssertEqual(scale.shape, [5])
+    let dequantized = Tensor<Float>(weight) * scale
+    XCTAssert(dequantized.isAlmostEqual(to: Tensor(copying: w, to: .defaultXLA), tolerance: 2e-2))
+    let quantized = _RawXLA.quantizedMatmul(x, weight: weight, scale: scale)
+    XCTAssert(quantized.isAlmostEqual(to: matmul(x, dequantized), tolerance: 1e-4))
+  }
+
+  func testSaveTensorsAsync() {
+    var a = Tensor<Float>(randomNormal: [2, 3], seed: (1, 2), on: .defaultXLA)
+    let b = Tensor<Float>(randomNormal: [5], seed: (3, 4), on: .defaultXLA)
+    let c = a.sum(alongAxes: 1) * 2
+    let saved = [a, c].map { $0.scalars }
+    let path = NSTemporaryDirectory() + "/x10_checkpoint_test.bin"
+    let checkpoint = _RawXLA.saveTensors([a, b, c], toFile: path, shardIndex: 0, shardCount: 2)
+    // The snapshot keeps the values the tensors had when the checkpoint started.
+    a += 1
+    LazyTensorBarrier()
+    checkpoint.wait()
+    XCTAssertEqual(checkpoint.offsets.count, 2)
+    let loaded: [Tensor<Float>] = _RawXLA.loadTensors(
+      fromFile: path, offsets: checkpoint.offsets, shapes: [[2, 3], [2, 1]], on: .defaultXLA)
+    XCTAssertEqual(loaded.map { $0.scalars }, saved)
+  }
+
+  func testFusedBatchNorm() {
+    let x = Tensor<Float>(randomNormal: [4, 3, 2], seed: (1, 2), on: .defaultXLA) * 3 + 1
+    let r = Tensor<Float>(randomNormal: [4, 3, 2], seed: (3, 4), on: .defaultXLA)
+    let scale = Tensor<Float>([0.5, 1, 2], on: .defaultXLA)
+    let offset = Tensor<Float>([0, 0.1, -0.2], on: .defaultXLA)
+    func batchNorm(
+      _ x: Tensor<Float>, _ r: Tensor<Float>, _ scale: Tensor<Float>, _ offset: Tensor<Float>
+    ) -> Tensor<Float> {
+      let moments = x.moments(alongAxes: [0, 2])
+      let normalized = (x - moments.mean) * rsqrt(moments.variance + 0.001)
+      return relu(normalized * scale.reshaped(to: [3, 1]) + offset.reshaped(to: [3, 1]) + r)
+    }
+    let (expected, expectedPullback) = valueWithPullback(at: x, r, scale, offset, in: batchNorm)
+    let (fused, fusedPullback) = valueWithPullback(at: x, r, scale, offset) {
+      fusedBatchNorm($0, adding: $1, scale: $2, offset: $3, axis: 1, relu: true)
+    }
+    XCTAssertTrue(fused.isAlmostEqual(to: expected, tolerance: 1e-5))
+    let seed = Tensor<Float>(randomNormal: expected.shape, seed: (5, 6), on: .defaultXLA)
+    let expectedGrads = expectedPullback(seed)
+    let fusedGrads = fusedPullback(seed)
+    XCTAssertTrue(fusedGrads.0.isAlmostEqual(to: expectedGrads.0, tolerance: 1e-4))
+    XCTAssertTrue(fusedGrads.1.isAlmostEqual(to: expectedGrads.1, tolerance: 1e-5))
+    XCTAssertTrue(fusedGrads.2.isAlmostEqual(to: expectedGrads.2, tolerance: 1e-4))
+    XCTAssertTrue(fusedGrads.3.isAlmostEqual(to: expectedGrads.3, tolerance: 1e-4))
+  }
+
+  func testAdamUpdate() {
+    let weights = [
+      Tensor<Float>([[1, -2], [3, 4]], on: .defaultXLA), Tensor<Float>([0.5], on: .defaultXLA),
+    ]
+    let grads = weights.map { $0 * 0.1 - 0.2 }
+    let m = weights.map { $0 * 0.3 }
+    let v = weights.map { $0.squared() }
+    let scalar = { (x: Float) in Tensor<Float>(x, on: .defaultXLA) }
+    let updated = _RawXLA.adamUpdate(
+      weights: weights, grads: grads, firstMoments: m, secondMoments: v,
+      learningRate: scalar(0.01), beta1: scalar(0.9), beta2: scalar(0.999),
+      epsilon: scalar(1e-6), weightDecay: scalar(0.01))
+    for i in weights.indices {
+      let expectedM = 0.9 * m[i] + 0.1 * grads[i]
+      let expectedV = 0.999 * v[i] + 0.001 * grads[i] * grads[i]
+      let expectedWeight =
+        weights[i] - 0.01 * (expectedM / (sqrt(expectedV) + 1e-6) + 0.01 * weights[i])
+      XCTAssertTrue(updated.firstMoments[i].isAlmostEqual(to: expectedM))
+      XCTAssertTrue(updated.secondMoments[i].isAlmostEqual(to: expectedV))
+      XCTAssertTrue(updated.weights[i].isAlmostEqual(to: expectedWeight))
+    }
+  }
+
+  func testAdamUpdateOffloaded() {
+    let weights = [
+      Tensor<Float>([[1, -2], [3, 4]], on: .defaultXLA), Tensor<Float>([0.5], on: .defaultXLA),
+    ]
+    let grads = weights.map { $0 * 0.1 - 0.2 }
+    let scalar = { (x: Float) in Tensor<Float>(x, on: .defaultXLA) }
+    let zeros = weights.map { $0 * 0 }
+    var expected = (weights: weights, firstMoments: zeros, secondMoments: zeros)
+    var offloaded = expected
+    for _ in 0..<2 {
+      expected = _RawXLA.adamUpdate(
+        weights: expected.weights, grads: grads, firstMoments: expected.firstMoments,
+        secondMoments: expected.secondMoments, learningRate: scalar(0.01), beta1: scalar(0.9),
+        beta2: scalar(0.999), epsilon: scalar(1e-6), weightDecay: scalar(0.01))
+      offloaded = _RawXLA.adamUpdate(
+        weights: offloaded.weights, grads: grads, firstMoments: offloaded.firstMoments,
+        secondMoments: offloaded.secondMoments, learningRate: scalar(0.01), beta1: scalar(0.9),
+        beta2: scalar(0.999), epsilon: scalar(1e-6), weightDecay: scalar(0.01),
+        offloadingMoments: true)
+    }
+    for i in weights.indices {
+      XCTAssertTrue(offloaded.firstMoments[i].isAlmostEqual(to: expected.firstMoments[i]))
+      XCTAssertTrue(offloaded.secondMoments[i].isAlmostEqual(to: expected.secondMoments[i]))
+      XCTAssertTrue(offloaded.weights[i].isAlmostEqual(to: expected.weights[i]))
+    }
+  }
+
+  func testLossScaleUpdate() {
+    let scalar = { (x: Float) in Tensor<Float>(x, on: .defaultXLA) }
+    let weights = [Tensor<Float>([1, -2], on: .defaultXLA)]
+    let velocities = [Tensor<Float>([0, 0], on: .defaultXLA)]
+    let finite = _RawXLA.lossScaleUpdate(
+      grads: [Tensor<Float>([8, -4], on: .defaultXLA)], lossScale: scalar(4),
+      goodSteps: scalar(1), growthInterval: 2)
+    XCTAssertEqual(finite.grads[0].scalars, [2, -1])
+    XCTAssertEqual(finite.gradsFinite.scalarized(), true)
+    XCTAssertEqual(finite.lossScale.scalarized(), 8)
+    XCTAssertEqual(finite.goodSteps.scalarized(), 0)
+    let overflow = _RawXLA.lossScaleUpdate(
+      grads: [Tensor<Float>([.infinity, 1], on: .defaultXLA)], lossScale: scalar(4),
+      goodSteps: scalar(1), growthInterval: 2)
+    XCTAssertEqual(overflow.gradsFinite.scalarized(), false)
+    XCTAssertEqual(overflow.lossScale.scalarized(), 2)
+    XCTAssertEqual(overflow.goodSteps.scalarized(), 0)
+    let skipped = _RawXLA.sgdUpdate(
+      weights: weights, grads: overflow.grads, velocities: velocities,
+      learningRate: scalar(0.1), momentum: scalar(0.9), weightDecay: scalar(0),
+      nesterov: false, gradsFinite: overflow.gradsFinite)
+    XCTAssertEqual(skipped.weights[0].scalars, weights[0].scalars)
+    XCTAssertEqual(skipped.velocities[0].scalars, velocities[0].scalars)
+  }
+
+  func testSoftmaxCrossEntropy() {
+    let logits = Tensor<Float>(randomNormal: [3, 8], seed: (1, 2), on: .defaultXLA)
+    let labels = Tensor<Int32>([1, 7, 4], on: .defaultXLA)
+    let oneHot = Tensor<Float>(oneHotAtIndices: labels, depth: 8) * 0.9 + 0.1 / 8
+    let logProbabilities = logSoftmax(logits)
+    let expectedLoss = -(oneHot * logProbabilities).sum(squeezingAxes: 1)
+    let expectedBackprop = exp(logProbabilities) - oneHot
+    let (loss, backprop) = _RawXLA.sparseSoftmaxCrossEntropyWithLogits(
+      features: logits, labels: labels, ignoreIndex: 4, labelSmoothing: 0.1, chunkSize: 4)
+    let valid = Tensor<Float>([1, 1, 0], on: .defaultXLA)
+    XCTAssertTrue(loss.isAlmostEqual(to: expectedLoss * valid, tolerance: 1e-5))
+    XCTAssertTrue(
+      backprop.isAlmostEqual(
+        to: expectedBackprop * valid.expandingShape(at: 1), tolerance: 1e-5))
+  }
+
+  func testShard() {
+    let x = Tensor<Float>(shape: [2, 3], scalars: [1, 2, 3, 4, 5, 6], on: .defaultXLA)
+    let sharded = _RawXLA.shard(x, shardCounts: [1, 1])
+    XCTAssertEqual((sharded * 2 + 1).scalars, [3, 5, 7, 9, 11, 13])
+    XCTAssertEqual(sharded.shape, [2, 3])
+  }
+
+  func testShardedAdamUpdate() {
+    let weights = [
+      Tensor<Float>([[1, -2], [3, 4]], on: .defaultXLA), Tensor<Float>([0.5], on: .defaultXLA),
+    ]
+    let grads = weights.map { $0 * 0.1 - 0.2 }
+    let scalar = { (x: Float) in Tensor<Float>(x, on: .defaultXLA) }
+    let momentCount = _RawXLA.shardedAdamMomentCount(weights: weights)
+    XCTAssertEqual(momentCount, 5)
+    let zeros = Tensor<Float>(zeros: [momentCount], on: .defaultXLA)
+    let sharded = _RawXLA.shardedAdamUpdate(
+      weights: weights, grads: grads, firstMoments: zeros, secondMoments: zeros,
+      learningRate: scalar(0.01), beta1: scalar(0.9), beta2: scalar(0.999),
+      epsilon: scalar(1e-6), weightDecay: scalar(0.01), gradScale: 0.5)
+    let expected = _RawXLA.adamUpdate(
+      weights: weights, grads: grads.map { $0 * 0.5 },
+      firstMoments: weights.map { Tensor<Float>(zerosLike: $0) },
+      secondMoments: weights.map { Tensor<Float>(zerosLike: $0) },
+      learningRate: scalar(0.01), beta1: scalar(0.9), beta2: scalar(0.999),
+      epsilon: scalar(1e-6), weightDecay: scalar(0.01))
+    for i in weights.indices {
+      XCTAssertTrue(sharded.weights[i].isAlmostEqual(to: expected.weights[i]))
+    }
+    let expectedM = Tensor<Float>(
+      concatenating: expected.firstMoments.map { $0.reshaped(to: [-1]) })
+    XCTAssertTrue(sharded.firstMoments.isAlmostEqual(to: expectedM))
+  }
+
+  func testReduceScatterAllGather() {
+    let x = Tensor<Float>([[1, 2], [3, 4]], on: .defaultXLA)
+    let scattered = _RawXLA.reduceScatter(x, alongAxis: 1, shardCount: 1, scale: 0.5)
+    XCTAssertEqual(scattered.shape, [2, 2])
+    XCTAssertEqual(scattered.scalars, [0.5, 1, 1.5, 2])
+    let gathered = _RawXLA.allGather(scattered, alongAxis: 0, shardCount: 1)
+    XCTAssertEqual(gathered.scalars, [0.5, 1, 1.5, 2])
+  }
+
+  func testStridedSliceNegativeStrides() {
+    let x = Tensor<Float>(shape: [2, 6], scalars: (0..<12).map { Float($0) }, on: .defaultXLA)
+    let index = { (values: [Int32]) in Tensor<Int32>(values) }
+    let sliced = _RawXLA.stridedSlice(
+      x, begin: index([0, 5]), end: index([2, 0]), strides: index([1, -2]))
+    XCTAssertEqual(sliced.shape, [2, 3])
+    XCTAssertEqual(sliced.scalars, [5, 3, 1, 11, 9, 7])
+    let shrunk = _RawXLA.stridedSlice(
+      x, begin: index([1, 5]), end: index([2, 0]), strides: index([1, -2]), shrinkAxisMask: 1)
+    XCTAssertEqual(shrunk.shape, [3])
+    XCTAssertEqual(shrunk.scalars, [11, 9, 7])
+  }
+
+  func testPipelineSchedule() {
+    let step = { (m: Int, f: Bool) in _XLAPipeline.Step(microbatch: m, isForward: f) }
+    let schedule = _XLAPipeline.schedule(stageCount: 2, microbatchCount: 3)
+    XCTAssertEqual(
+      schedule[0],
+      [
+        step(0, true), step(1, true), step(0, false), step(2, true), step(1, false),
+        step(2, false),
+      ])
+    XCTAssertEqual(
+      schedule[1],
+      [
+        step(0, true), step(0, false), step(1, true), step(1, false), step(2, true),
+        step(2, false),
+      ])
+    let pipeline = _XLAPipeline(devices: [Device.defaultXLA, Device.defaultXLA])
+    var activations = [Tensor<Float>](repeating: Tensor(0, on: .defaultXLA), count: 3)
+    var outputs = [Tensor<Float>](repeating: Tensor(0, on: .defaultXLA), count: 3)
+    pipeline.run(
+      microbatchCount: 3,
+      forward: { stage, microbatch in
+        if stage == 0 {
+          activations[microbatch] = Tensor<Float>(Float(microbatch), on: .defaultXLA) + 1
+        } else {
+          outputs[microbatch] = activations[microbatch] * 2
+        }
+      },
+      backward: { _, _ in })
+    XCTAssertEqual(outputs.map { $0.scalarized() }, [2, 4, 6])
+  }
+
+  func testGrowableBuffer() {
+    var buffer = _XLAGrowableBuffer<Float>(shape: [2, 3], axis: 1, on: .defaultXLA)
+    XCTAssertEqual(buffer.capacity, 4)
+    buffer.append(Tensor<Float>([[1, 2], [3, 4]], on: .defaultXLA))
+    buffer.append(Tensor<Float>([[5, 6, 7], [8, 9, 10]], on: .defaultXLA))
+    XCTAssertEqual(buffer.count, 5)
+    XCTAssertEqual(buffer.capacity, 8)
+    XCTAssertEqual(buffer.values.scalars, [1, 2, 5, 6, 7, 3, 4, 8, 9, 10])
+    XCTAssertEqual(buffer.validMask.scalars, [true, true, true, true, true, false, false, false])
+  }
+
+  func testBlockTopK() {
+    let input = Tensor<Float>(randomNormal: [2, 5000], seed: (7, 8), on: .defaultXLA)
+    let (values, indices) = _RawXLA.topk(input: input, k: 5, dim: 1, largest: true)
+    let scalars = input.scalars
+    for row in 0..<2 {
+      let rowScalars = Array(scalars[(row * 5000)..<((row + 1) * 5000)])
+      let expected = rowScalars.enumerated().sorted { $0.element > $1.element }.prefix(5)
+      XCTAssertEqual(values[row].scalars, expected.map { $0.element })
+      XCTAssertEqual(indices[row].scalars, expected.map { Int64($0.offset) })
+    }
+  }
+
+  func testSortedSegmentSum() {
+    let data = Tensor<Float>(
+      [[1, 2], [3, 4], [5, 6], [7, 8], [9, 10], [11, 12]], on: .defaultXLA)
+    let segmentIds = Tensor<Int32>([0, 0, 2, 2, 2, 4], on: .defaultXLA)
+    let expected: [Float] = [4, 6, 0, 0, 21, 24, 0, 0, 11, 12]
+    let sorted = _RawXLA.unsortedSegmentSum(
+      data: data, segmentIds: segmentIds, numSegments: 5, indicesAreSorted: true)
+    XCTAssertEqual(sorted.scalars, expected)
+    let unsorted = _RawXLA.unsortedSegmentSum(
+      data: data, segmentIds: segmentIds, numSegments: 5)
+    XCTAssertEqual(unsorted.scalars, expected)
+  }
+
+  func testCastAndBroadcastFolding() {
+    let x = Tensor<Float>([1.5, -2, 3.25], on: .defaultXLA)
+    let roundTrip = Tensor<Float>(Tensor<Double>(x))
+    XCTAssertEqual(roundTrip.scalars, x.scalars)
+    let truncated = Tensor<Float>(Tensor<Int32>(Tensor<Double>(x)))
+    XCTAssertEqual(truncated.scalars, [1, -2, 3])
+    let broadcast = x.broadcasted(to: [4, 3])
+    XCTAssertEqual(broadcast.sum(squeezingAxes: 0).scalars, [6, -8, 13])
+    XCTAssertEqual(broadcast.sum(alongAxes: 0).shape, [1, 3])
+    XCTAssertEqual(broadcast.mean(squeezingAxes: 0).scalars, x.scalars)
+    XCTAssertEqual(broadcast.sum(squeezingAxes: 1).scalars, [2.75, 2.75, 2.75, 2.75])
+  }
+
+  func testLayerNormAndMoments() {
+    let x = Tensor<Float>(randomNormal: [3, 4, 5], seed: (1, 2), on: .defaultXLA)
+    let scale = Tensor<Float>(randomNormal: [4], seed: (3, 4), on: .defaultXLA)
+    let offset = Tensor<Float>(randomNormal: [4], seed: (5, 6), on: .defaultXLA)
+    func reference(_ x: Tensor<Float>, _ scale: Tensor<Float>, _ offset: Tensor<Float>)
+      -> Tensor<Float>
+    {
+      let moments = x.moments(alongAxes: 1)
+      let inv = rsqrt(moments.variance + 0.001) * scale.reshaped(to: [1, 4, 1])
+      return (x - moments.mean) * inv + offset.reshaped(to: [1, 4, 1])
+    }
+    let (expected, expectedPullback) = valueWithPullback(at: x, scale, offset, in: reference)
+    let (fused, fusedPullback) = valueWithPullback(at: x, scale, offset) {
+      fusedLayerNorm($0, scale: $1, offset: $2, axis: 1)
+    }
+    XCTAssertTrue(fused.isAlmostEqual(to: expected, tolerance: 1e-5))
+    let seed = Tensor<Float>(randomNormal: expected.shape, seed: (7, 8), on: .defaultXLA)
+    let expectedGrads = expectedPullback(seed)
+    let fusedGrads = fusedPullback(seed)
+    XCTAssertTrue(fusedGrads.0.isAlmostEqual(to: expectedGrads.0, tolerance: 1e-4))
+    XCTAssertTrue(fusedGrads.1.isAlmostEqual(to: expectedGrads.1, tolerance: 1e-4))
+    XCTAssertTrue(fusedGrads.2.isAlmostEqual(to: expectedGrads.2, tolerance: 1e-4))
+    let moments = x.moments(squeezingAxes: 0, 2)
+    let (mean, variance) = _RawXLA.moments(x, reductionIndices: [0, -1], keepDims: false)
+    XCTAssertTrue(mean.isAlmostEqual(to: moments.mean, tolerance: 1e-5))
+    XCTAssertTrue(variance.isAlmostEqual(to: moments.variance, tolerance: 1e-5))
+    XCTAssertTrue(
+      x.standardDeviation(squeezingAxes: 1).isAlmostEqual(
+        to: sqrt(x.moments(squeezingAxes: 1).variance), tolerance: 1e-5))
+  }
+
+  func testRMSNorm() {
+    let x = Tensor<Float>(randomNormal: [3, 5], seed: (1, 2), on: .defaultXLA)
+    let scale = Tensor<Float>(randomNormal: [5], seed: (3, 4), on: .defaultXLA)
+    func reference(_ x: Tensor<Float>, _ scale: Tensor<Float>) -> Tensor<Float> {
+      x * rsqrt((x * x).mean(alongAxes: 1) + 1e-6) * scale
+    }
+    let (expected, expectedPullback) = valueWithPullback(at: x, scale, in: reference)
+    let (fused, fusedPullback) = valueWithPullback(at: x, scale) {
+      fusedRMSNorm($0, scale: $1)
+    }
+    XCTAssertTrue(fused.isAlmostEqual(to: expected, tolerance: 1e-5))
+    let seed = Tensor<Float>(randomNormal: expected.shape, seed: (5, 6), on: .defaultXLA)
+    let expectedGrads = expectedPullback(seed)
+    let fusedGrads = fusedPullback(seed)
+    XCTAssertTrue(fusedGrads.0.isAlmostEqual(to: expectedGrads.0, tolerance: 1e-4))
+    XCTAssertTrue(fusedGrads.1.isAlmostEqual(to: expectedGrads.1, tolerance: 1e-4))
+  }
+
+  func testAdaptiveAvgPool() {
+    // The windows of 3 rows pooled to 2 are [0, 2) and [1, 3), and both columns are pooled.
+    let x = Tensor<Float>(shape: [1, 1, 3, 2], scalars: [1, 2, 3, 4, 5, 9], on: .defaultXLA)
+    let (pooled, pullback) = valueWithPullback(at: x) {
+      adaptiveAvgPool2D($0, outputSize: (height: 2, width: 1))
+    }
+    XCTAssertEqual(pooled.shape, [1, 1, 2, 1])
+    XCTAssertEqual(pooled.scalars, [2.5, 5.25])
+    let grad = pullback(Tensor(ones: pooled.shape, on: .defaultXLA))
+    XCTAssertEqual(grad.scalars, [0.25, 0.25, 0.5, 0.5, 0.25, 0.25])
+  }
+
+  func testKvCache() {
+    var keys = Tensor<Float>(zeros: [1, 4, 3], on: .defaultXLA)
+    var values = Tensor<Float>(zeros: [1, 4, 2], on: .defaultXLA)
+    let newKeys = Tensor<Float>(randomNormal: [1, 3, 3], seed: (1, 2), on: .defaultXLA)
+    let newValues = Tensor<Float>(randomNormal: [1, 3, 2], seed: (3, 4), on: .defaultXLA)
+    for position in 0..<3 {
+      let index = Tensor<Int32>(Int32(position), on: .defaultXLA)
+      keys = _RawXLA.kvCacheUpdate(
+        keys, newKeys.slice(lowerBounds: [0, position, 0], sizes: [1, 1, 3]), at: index,
+        alongAxis: 1)
+      values = _RawXLA.kvCacheUpdate(
+        values, newValues.slice(lowerBounds: [0, position, 0], sizes: [1, 1, 2]), at: index,
+        alongAxis: 1)
+      LazyTensorBarrier()
+    }
+    XCTAssertEqual(keys.slice(lowerBounds: [0, 0, 0], sizes: [1, 3, 3]), newKeys)
+    XCTAssertEqual(keys.slice(lowerBounds: [0, 3, 0], sizes: [1, 1, 3]).sum().scalarized(), 0)
+    let query = Tensor<Float>(randomNormal: [1, 1, 3], seed: (5, 6), on: .defaultXLA)
+    let expected = matmul(softmax(matmul(query, newKeys, transposed: true) * 0.5), newValues)
+    let attention = _RawXLA.cachedAttention(
+      query: query, key: keys, value: values,
+      validLength: Tensor<Int32>(3, on: .defaultXLA), scale: 0.5, blockSize: 2)
+    XCTAssertTrue(attention.isAlmostEqual(to: expected, tolerance: 1e-5))
+  }
+
+  func testGradientAccumulator() {
+    struct Gradients: KeyPathIterable {
+      var weight: Tensor<Float>
+      var bias: Tensor<Float>
+      var count: Tensor<Int32>
+    }
+    func gradients(_ step: Float) -> Gradients {
+      return Gradients(
+        weight: Tensor<Float>([step, 2 * step], on: .defaultXLA),
+        bias: Tensor<Float>(step, on: .defaultXLA),
+        count: Tensor<Int32>(Int32(step), on: .defaultXLA))
+    }
+    var accumulator = _XLAGradientAccumulator(microSteps: 3, like: gradients(0))
+    for round in 0..<2 {
+      XCTAssertNil(accumulator.accumulate(gradients(Float(3 * round + 1))))
+      LazyTensorBarrier()
+      XCTAssertNil(accumulator.accumulate(gradients(Float(3 * round + 2))))
+      LazyTensorBarrier()
+      XCTAssertEqual(
+        accumulator.accumulated.weight.scalars, [Float(6 * round + 3), Float(12 * round + 6)])
+      let means = accumulator.accumulate(gradients(Float(3 * round + 3)))!
+      XCTAssertEqual(means.weight.scalars, [Float(3 * round + 2), Float(6 * round + 4)])
+      XCTAssertEqual(means.bias.scalarized(), Float(3 * round + 2))
+      XCTAssertEqual(means.count.scalarized(), Int32(3 * round + 3))
+      XCTAssertEqual(accumulator.microStep, 0)
+      XCTAssertEqual(accumulator.accumulated.weight.scalars, [0, 0])
+    }
+  }
+
+  func testTraceContexts() {
+    let context = _XLATraceContext()
+    XCTAssertEqual(_XLATraceContext.current, .default)
+    let steps = context.stepCount(on: .defaultXLA)
+    let x = context.withCurrent { () -> Tensor<Float> in
+      XCTAssertEqual(_XLATraceContext.current, context)
+      let x = Tensor<Float>([1, 2], on: .defaultXLA) * 3
+      LazyTensorBarrier()
+      return x
+    }
+    XCTAssertEqual(_XLATraceContext.current, .default)
+    XCTAssertEqual(context.stepCount(on: .defaultXLA), steps + 1)
+    LazyTensorBarrier()
+    XCTAssertEqual(context.stepCount(on: .defaultXLA), steps + 1)
+    XCTAssertEqual(x.scalars, [3, 6])
+  }
+
+  func testOutlined() {
+    let weights = [
+      Tensor<Float>([[1, 2], [3, 4]], on: .defaultXLA),
+      Tensor<Float>([[0, 1], [1, 0]], on: .defaultXLA),
+    ]
+    var x = Tensor<Float>([[1, 1]], on: .defaultXLA)
+    var expected = x
+    for weight in weights {
+      x = _RawXLA.outlined([x]) { inputs in
+        [relu(matmul(inputs[0] as! Tensor<Float>, weight) - 1)]
+      }[0] as! Tensor<Float>
+      expected = relu(matmul(expected, weight) - 1)
+    }
+    XCTAssertEqual(x.scalars, expected.scalars)
+  }
+
+  func testWarmUp() {
+    let graph = { (inputs: [Tensor<Float>]) -> [AnyTensor] in
+      [(inputs[0] * 2 + 1).sum(squeezingAxes: 0)]
+    }
+    _RawXLA.warmUp(signatures: [[[2, 3]], [[4, 3]]], on: .defaultXLA, graph)
+    let x = Tensor<Float>(ones: [4, 3], on: .defaultXLA)
+    let y = graph([x])[0] as! Tensor<Float>
+    XCTAssertEqual(y.scalars, [12, 12, 12])
+  }
+
+  func testFlatParameters() {
+    var model = Dense<Float>(
+      weight: Tensor<Float>([[1, 2], [3, 4]], on: .defaultXLA),
+      bias: Tensor<Float>([5, 6], on: .defaultXLA), activation: identity)
+    var flat = _XLAFlatParameters(&model)
+    XCTAssertEqual(flat.scalarCount, 6)
+    XCTAssertEqual(flat.storage.scalars, [1, 2, 3, 4, 5, 6])
+    let gradients = Dense<Float>.TangentVector(
+      weight: Tensor<Float>([[1, 1], [1, 1]], on: .defaultXLA),
+      bias: Tensor<Float>([2, 2], on: .defaultXLA))
+    XCTAssertEqual(flat.packed(gradients).scalars, [1, 1, 1, 1, 2, 2])
+    flat.update(&model, along: gradients) { parameters, gradients in
+      parameters - 0.5 * gradients
+    }
+    XCTAssertEqual(model.weight.scalars, [0.5, 1.5, 2.5, 3.5])
+    XCTAssertEqual(model.bias.scalars, [4, 5])
+  }
+
+  func testInputPipeline() {
+    let pipeline = _XLAInputPipeline(
+      fields: [
+        _XLAInputPipeline.Field(Float.self, sampleShape: [2]),
+        _XLAInputPipeline.Field(Int32.self, sampleShape: []),
+      ],
+      on: .defaultXLA, depth: 2)
+    let features: [Float] = [1, 2, 3, 4, 5, 6]
+    let labels: [Int32] = [7, 8, 9]
+    features.withUnsafeBufferPointer { features in
+      labels.withUnsafeBufferPointer { labels in
+        pipeline.enqueue(
+          (0..<3).map { i in
+            [
+              UnsafeRawPointer(features.baseAddress! + 2 * i),
+              UnsafeRawPointer(labels.baseAddress! + i),
+            ]
+          })
+      }
+    }
+    let batch = pipeline.dequeue()
+    XCTAssertEqual(batch.count, 2)
+    let batchFeatures: Tensor<Float> = batch.tensor(0)
+    XCTAssertEqual(batchFeatures.shape, [3, 2])
+    XCTAssertEqual(batchFeatures.scalars, [1, 2, 3, 4, 5, 6])
+    XCTAssertEqual(batch.tensor(1, as: Int32.self).scalars, [7, 8, 9])
+  }
+
+  func testBoundedDynamicDimension() {
+    for size in 2...4 {
+      let x = _RawXLA.boundedDynamicTensor(
+        shape: [size, 2], scalars: (0..<(2 * size)).map { Float($0) }, alongAxis: 0, bound: 8,
+        on: .defaultXLA)
+      let doubled = _RawXLA.removeDynamicDimension(x * 2, alongAxis: 0)
+      XCTAssertEqual(doubled.shape, [8, 2])
+      XCTAssertEqual(
+        doubled.scalars,
+        (0..<(2 * size)).map { Float(2 * $0) } + [Float](repeating: 0, count: 16 - 2 * size))
+      let sums = _RawXLA.removeDynamicDimension(x.sum(squeezingAxes: 1), alongAxis: 0)
+      XCTAssertEqual(sums.scalars.prefix(size).reduce(0, +), Float(size * (2 * size - 1)))
+    }
+  }
+
+  func testFreeze() {
+    var weight = Tensor<Float>([[1, 2], [3, 4]], on: .defaultXLA) * 2
+    _RawXLA.freeze([weight])
+    XCTAssertEqual(weight.scalars, [2, 4, 6, 8])
+    let x = Tensor<Float>([[1, 1]], on: .defaultXLA)
+    XCTAssertEqual(matmul(x, weight.transposed()).scalars, [6, 14])
+    weight += 1
+    XCTAssertEqual(matmul(x, weight.transposed()).scalars, [8, 16])
+  }
+
+  func testNumericsGuard() {
+    let x = Tensor<Float>([1, 0], on: .defaultXLA)
+    let finite = x * 2
+    XCTAssertEqual(finite.scalars, [2, 0])
+    XCTAssertEqual(_RawXLA.numericsGuard(on: x.device).scalars, [true])
+    let overflowed = 1 / x
+    XCTAssertEqual(overflowed.scalars, [1, Float.infinity])
+    // Without XLA_NUMERICS_GUARD the syncs are not guarded, and the guard stays true.
+    let guarded = ProcessInfo.processInfo.environment["XLA_NUMERICS_GUARD"] == "1"
+    XCTAssertEqual(_RawXLA.numericsGuard(on: x.device).scalars, [!guarded])
+  }
+
+  func testDropUploadedHostData() {
+    // Larger than the device data cache threshold, so the host copies get dropped once uploaded.
+    let scalars = (0..<(1 << 19)).map { Float($0 % 7) }
+    let dropped = Tensor<Float>(shape: [scalars.count], scalars: scalars, on: .defaultXLA)
+    let kept = Tensor<Float>(shape: [scalars.count], scalars: scalars, on: .defaultXLA)
+    _RawXLA.keepHostData([kept])
+    XCTAssertEqual((dropped + kept).scalars, scalars.map { $0 * 2 })
+    XCTAssertEqual(dropped.scalars, scalars)
+    XCTAssertEqual(kept.scalars, scalars)
+  }
+
+  func testPadFoldingIntoWindows() {
+    let x = Tensor<Float>(shape: [1, 2, 2, 1], scalars: [1, 2, 3, 4], on: .defaultXLA)
+    let sizes = [(before: 0, after: 0), (1, 1), (1, 1), (0, 0)]
+    let filter = Tensor<Float>(ones: [3, 3, 1, 1], on: .defaultXLA)
+    XCTAssertEqual(
+      conv2D(x.padded(forSizes: sizes), filter: filter, strides: (1, 1, 1, 1), padding: .valid)
+        .scalars,
+      conv2D(x, filter: filter, strides: (1, 1, 1, 1), padding: .same).scalars)
+    XCTAssertEqual(
+      avgPool2D(
+        x.padded(forSizes: sizes), filterSize: (1, 2, 2, 1), strides: (1, 2, 2, 1),
+        padding: .valid
+      ).scalars, [0.25, 0.5, 0.75, 1])
+    XCTAssertEqual(
+      maxPool2D(
+        x.padded(forSizes: sizes, with: -Float.infinity), filterSize: (1, 3, 3, 1),
+        strides: (1, 1, 1, 1), padding: .valid
+      ).scalars, [4, 4, 4, 4])
+  }
+
+  func testPreferredDataFormat() {
+    let x = Tensor<Float>(
+      shape: [1, 2, 4, 4], scalars: (0..<32).map { Float($0) }, on: .defaultXLA)
+    let filter = Tensor<Float>(
+      shape: [3, 3, 2, 3], scalars: (0..<54).map { Float($0 % 7) }, on: .defaultXLA)
+    func network() -> Tensor<Float> {
+      let conv = _RawXLA.conv2D(
+        x, filter: filter, strides: [1, 1, 1, 1], padding: .same, explicitPaddings: [],
+        dataFormat: .nchw)
+      return _RawXLA.avgPool(
+        value: conv, ksize: [1, 1, 2, 2], strides: [1, 1, 2, 2], padding: .valid,
+        dataFormat: .nchw)
+    }
+    let expected = network()
+    let result = withPreferredDataFormat(.nhwc) { network() }
+    XCTAssertEqual(result.shape, expected.shape)
+    XCTAssertEqual(result.scalars, expected.scalars)
+  }
+
+  func testSmallMatrixLinearAlgebra() {
+    // The 3x3 matrices take the unrolled kernels, and the 6x6 ones the decompositions.
+    for n in [3, 6] {
+      let m = Tensor<Float>(randomNormal: [2, n, n], seed: (1, 2), on: .defaultXLA)
+      let eye = Tensor<Float>(ones: [2, n], on: .defaultXLA).diagonal()
+      let a = matmul(m, transposed: false, m, transposed: true) + Float(n) * eye
+      let b = Tensor<Float>(randomNormal: [2, n, 2], seed: (3, 4), on: .defaultXLA)
+      let inverse = _Raw.matrixInverse(a)
+      XCTAssert(matmul(a, inverse).isAlmostEqual(to: eye, tolerance: 1e-4))
+      let l = _Raw.cholesky(a)
+      XCTAssert(matmul(l, transposed: false, l, transposed: true).isAlmostEqual(
+        to: a, tolerance: 1e-4))
+      XCTAssertEqual(l.scalars, l.bandPart(subdiagonalCount: -1, superdiagonalCount: 0).scalars)
+      let x = _Raw.matrixTriangularSolve(matrix: l, rhs: b, lower: true, adjoint: true)
+      XCTAssert(matmul(l, transposed: true, x, transposed: false).isAlmostEqual(
+        to: b, tolerance: 1e-4))
+      let y = _Raw.matrixSolve(matrix: m, rhs: b, adjoint: false)
+      XCTAssert(matmul(m, y).isAlmostEqual(to: b, tolerance: 1e-3))
+    }
+  }
+
+  func testFusedDropout() {
+    let normal = Tensor<Float>(randomNormal: [64, 256], seed: (1, 2), on: .defaultXLA)
+    XCTAssertEqual(normal.mean().scalarized(), 0, accuracy: 0.05)
+    XCTAssertEqual(normal.standardDeviation().scalarized(), 1, accuracy: 0.05)
+    let x = Tensor<Float>(ones: [8, 32], on: .defaultXLA)
+    let output = _xlaFusedDropout(x, probability: 0.5, seed: (3, 4))
+    XCTAssertEqual(output.scalars, _xlaFusedDropout(x, probability: 0.5, seed: (3, 4)).scalars)
+    XCTAssert(output.scalars.allSatisfy { $0 == 0 || $0 == 2 })
+    XCTAssert(output.scalars.contains(0) && output.scalars.contains(2))
+    let gradient = x.gradient { _xlaFusedDropout($0, probability: 0.5, seed: (3, 4)).sum() }
+    XCTAssertEqual(gradient.scalars, output.scalars)
+  }
 }
 
 extension MultiDeviceAPITests {
@@ -108,6 +872,51 @@ extension MultiDeviceAPITests {
     ("testSyncLiveTensors", testSyncLiveTensors),
     ("testCrossReplicaSum", testCrossReplicaSum),
     ("testFunctionalWhile", testFunctionalWhile),
+    ("testMultiStep", testMultiStep),
+    ("testPrefetch", testPrefetch),
+    ("testRematerialization", testRematerialization),
+    ("testScaledDotProductAttention", testScaledDotProductAttention),
+    ("testEmbeddingBag", testEmbeddingBag),
+    ("testNonMaxSuppression", testNonMaxSuppression),
+    ("testBatchedScalars", testBatchedScalars),
+    ("testScalarsAsync", testScalarsAsync),
+    ("testRandomStreams", testRandomStreams),
+    ("testResizeBilinear", testResizeBilinear),
+    ("testConvBiasActivation", testConvBiasActivation),
+    ("testQuantizedMatmul", testQuantizedMatmul),
+    ("testSaveTensorsAsync", testSaveTensorsAsync),
+    ("testFusedBatchNorm", testFusedBatchNorm),
+    ("testAdamUpdate", testAdamUpdate),
+    ("testAdamUpdateOffloaded", testAdamUpdateOffloaded),
+    ("testLossScaleUpdate", testLossScaleUpdate),
+    ("testSoftmaxCrossEntropy", testSoftmaxCrossEntropy),
+    ("testShard", testShard),
+    ("testShardedAdamUpdate", testShardedAdamUpdate),
+    ("testReduceScatterAllGather", testReduceScatterAllGather),
+    ("testStridedSliceNegativeStrides", testStridedSliceNegativeStrides),
+    ("testPipelineSchedule", testPipelineSchedule),
+    ("testGrowableBuffer", testGrowableBuffer),
+    ("testLayerNormAndMoments", testLayerNormAndMoments),
+    ("testRMSNorm", testRMSNorm),
+    ("testAdaptiveAvgPool", testAdaptiveAvgPool),
+    ("testKvCache", testKvCache),
+    ("testGradientAccumulator", testGradientAccumulator),
+    ("testTraceContexts", testTraceContexts),
+    ("testOutlined", testOutlined),
+    ("testWarmUp", testWarmUp),
+    ("testFlatParameters", testFlatParameters),
+    ("testInputPipeline", testInputPipeline),
+    ("testBoundedDynamicDimension", testBoundedDynamicDimension),
+    ("testFreeze", testFreeze),
+    ("testBlockTopK", testBlockTopK),
+    ("testSortedSegmentSum", testSortedSegmentSum),
+    ("testCastAndBroadcastFolding", testCastAndBroadcastFolding),
+    ("testNumericsGuard", testNumericsGuard),
+    ("testDropUploadedHostData", testDropUploadedHostData),
+    ("testPadFoldingIntoWindows", testPadFoldingIntoWindows),
+    ("testPreferredDataFormat", testPreferredDataFormat),
+    ("testSmallMatrixLinearAlgebra", testSmallMatrixLinearAlgebra),
+    ("testFusedDropout", testFusedDropout),
   ]
 }
 